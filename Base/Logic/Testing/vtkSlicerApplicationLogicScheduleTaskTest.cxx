@@ -0,0 +1,184 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Slicer includes
+#include "vtkSlicerApplicationLogic.h"
+#include "vtkSlicerTask.h"
+#include "vtkMRMLCoreTestingMacros.h"
+
+// VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+
+// ITK includes
+#include <itkSimpleFastMutexLock.h>
+
+// ITKSYS includes
+#include <itksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+class vtkTestTaskLogic : public vtkMRMLAbstractLogic
+{
+public:
+  static vtkTestTaskLogic *New();
+  vtkTypeMacro(vtkTestTaskLogic, vtkMRMLAbstractLogic);
+
+  /// Record the task ID (passed as client data) and keep the thread busy for a while
+  void RunTask(void* clientdata)
+    {
+    this->Lock.Lock();
+    ++this->NumberOfRunningTasks;
+    this->MaximumNumberOfRunningTasks = std::max(this->MaximumNumberOfRunningTasks, this->NumberOfRunningTasks);
+    this->Lock.Unlock();
+
+    itksys::SystemTools::Delay(100);
+
+    this->Lock.Lock();
+    --this->NumberOfRunningTasks;
+    this->ExecutedTaskIDs.push_back(*static_cast<int*>(clientdata));
+    this->Lock.Unlock();
+    }
+
+  itk::SimpleFastMutexLock Lock;
+  int NumberOfRunningTasks;
+  int MaximumNumberOfRunningTasks;
+  std::vector<int> ExecutedTaskIDs;
+
+protected:
+  vtkTestTaskLogic() : NumberOfRunningTasks(0), MaximumNumberOfRunningTasks(0) {}
+  ~vtkTestTaskLogic() {}
+};
+vtkStandardNewMacro(vtkTestTaskLogic);
+
+//----------------------------------------------------------------------------
+void TaskCompletedCallback(vtkObject* vtkNotUsed(caller), unsigned long vtkNotUsed(eid),
+                           void* clientData, void* vtkNotUsed(callData))
+{
+  ++(*static_cast<int*>(clientData));
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkSlicerTask> CreateTask(vtkTestTaskLogic* logic, int* taskID, int priority,
+                                          vtkCallbackCommand* completedCallback)
+{
+  vtkSmartPointer<vtkSlicerTask> task = vtkSmartPointer<vtkSlicerTask>::New();
+  task->SetTaskFunction(logic, (vtkSlicerTask::TaskFunctionPointer)
+    &vtkTestTaskLogic::RunTask, taskID);
+  task->SetTypeToProcessing();
+  task->SetPriority(priority);
+  task->AddObserver(vtkSlicerTask::TaskCompletedEvent, completedCallback);
+  return task;
+}
+
+//----------------------------------------------------------------------------
+bool WaitForCompletedTasks(vtkSlicerApplicationLogic* appLogic, int* numberOfCompletedTasks, int expected)
+{
+  for (int i = 0; i < 500 && *numberOfCompletedTasks < expected; ++i)
+    {
+    itksys::SystemTools::Delay(20);
+    // completion events are invoked from the main thread
+    appLogic->ProcessModified();
+    }
+  return *numberOfCompletedTasks == expected;
+}
+
+int concurrentExecution();
+int prioritiesAndCancellation();
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkSlicerApplicationLogicScheduleTaskTest(int vtkNotUsed(argc), char * vtkNotUsed(argv)[] )
+{
+  CHECK_EXIT_SUCCESS(concurrentExecution());
+  CHECK_EXIT_SUCCESS(prioritiesAndCancellation());
+  return EXIT_SUCCESS;
+}
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+int concurrentExecution()
+{
+  vtkNew<vtkSlicerApplicationLogic> appLogic;
+  vtkNew<vtkTestTaskLogic> logic;
+  vtkNew<vtkCallbackCommand> completedCallback;
+  int numberOfCompletedTasks = 0;
+  completedCallback->SetCallback(TaskCompletedCallback);
+  completedCallback->SetClientData(&numberOfCompletedTasks);
+
+  // Tasks cannot be scheduled before the threads are created
+  int taskIDs[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+  CHECK_INT(appLogic->ScheduleTask(CreateTask(logic.GetPointer(), &taskIDs[0], 0, completedCallback.GetPointer())), false);
+
+  appLogic->SetNumberOfProcessingThreads(4);
+  appLogic->CreateProcessingThread();
+  for (int i = 0; i < 8; ++i)
+    {
+    CHECK_INT(appLogic->ScheduleTask(CreateTask(logic.GetPointer(), &taskIDs[i], 0, completedCallback.GetPointer())), true);
+    }
+  CHECK_BOOL(WaitForCompletedTasks(appLogic.GetPointer(), &numberOfCompletedTasks, 8), true);
+  CHECK_INT(static_cast<int>(logic->ExecutedTaskIDs.size()), 8);
+  CHECK_INT(appLogic->GetNumberOfQueuedTasks(), 0);
+  CHECK_BOOL(logic->MaximumNumberOfRunningTasks > 1, true);
+
+  appLogic->TerminateProcessingThread();
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int prioritiesAndCancellation()
+{
+  vtkNew<vtkSlicerApplicationLogic> appLogic;
+  vtkNew<vtkTestTaskLogic> logic;
+  vtkNew<vtkCallbackCommand> completedCallback;
+  int numberOfCompletedTasks = 0;
+  completedCallback->SetCallback(TaskCompletedCallback);
+  completedCallback->SetClientData(&numberOfCompletedTasks);
+
+  appLogic->SetNumberOfProcessingThreads(1);
+  appLogic->CreateProcessingThread();
+
+  // The first task keeps the thread busy while the others are queued
+  int taskIDs[4] = { 0, 1, 2, 3 };
+  appLogic->ScheduleTask(CreateTask(logic.GetPointer(), &taskIDs[0], 0, completedCallback.GetPointer()));
+  itksys::SystemTools::Delay(20);
+  appLogic->ScheduleTask(CreateTask(logic.GetPointer(), &taskIDs[1], 0, completedCallback.GetPointer()));
+  vtkSmartPointer<vtkSlicerTask> canceledTask = CreateTask(logic.GetPointer(), &taskIDs[2], 5, completedCallback.GetPointer());
+  appLogic->ScheduleTask(canceledTask);
+  canceledTask->Cancel();
+  appLogic->ScheduleTask(CreateTask(logic.GetPointer(), &taskIDs[3], 10, completedCallback.GetPointer()));
+
+  CHECK_BOOL(WaitForCompletedTasks(appLogic.GetPointer(), &numberOfCompletedTasks, 4), true);
+  // Canceled task is reported as completed but not executed, higher priority task is executed first
+  CHECK_INT(static_cast<int>(logic->ExecutedTaskIDs.size()), 3);
+  CHECK_INT(logic->ExecutedTaskIDs[0], 0);
+  CHECK_INT(logic->ExecutedTaskIDs[1], 3);
+  CHECK_INT(logic->ExecutedTaskIDs[2], 1);
+
+  appLogic->TerminateProcessingThread();
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
@@ -47,12 +47,45 @@
 # include <sys/resource.h>
 #endif
 
+#include <deque>
 #include <queue>
 
 //----------------------------------------------------------------------------
-class ProcessingTaskQueue : public std::queue<vtkSmartPointer<vtkSlicerTask> > {};
+class ProcessingTaskQueue : public std::deque<vtkSmartPointer<vtkSlicerTask> >
+{
+public:
+  /// Insert the task after all the tasks that have the same or higher priority
+  void PushByPriority(vtkSlicerTask* task)
+  {
+    iterator it = this->begin();
+    while (it != this->end() && (*it)->GetPriority() >= task->GetPriority())
+      {
+      ++it;
+      }
+    this->insert(it, task);
+  }
+};
 class ModifiedQueue : public std::queue<vtkSmartPointer<vtkObject> > {};
 
+//----------------------------------------------------------------------------
+/// Task queue of a processing or networking thread
+class ProcessingTaskWorker
+{
+public:
+  ProcessingTaskWorker(vtkSlicerApplicationLogic* appLogic, int type)
+    : AppLogic(appLogic), Type(type), ThreadId(-1)
+  {
+  }
+
+  vtkSlicerApplicationLogic* AppLogic;
+  /// vtkSlicerTask::Processing or vtkSlicerTask::Networking
+  int Type;
+  int ThreadId;
+  /// Queued tasks ordered by decreasing priority, protected by the
+  /// TaskSchedulerLock of the application logic
+  ProcessingTaskQueue Tasks;
+};
+
 //----------------------------------------------------------------------------
 class DataRequest
 {
@@ -200,10 +233,13 @@ vtkStandardNewMacro(vtkSlicerApplicationLogic);
 vtkSlicerApplicationLogic::vtkSlicerApplicationLogic()
 {
   this->ProcessingThreader = itk::MultiThreader::New();
-  this->ProcessingThreadId = -1;
   this->ProcessingThreadActive = false;
-  this->ProcessingThreadActiveLock = itk::MutexLock::New();
-  this->ProcessingTaskQueueLock = itk::MutexLock::New();
+  this->CompletedTaskQueueLock = itk::MutexLock::New();
+  this->TaskAvailableCondition = itk::ConditionVariable::New();
+  this->NumberOfProcessingThreads = std::max(1, std::min(4, itk::MultiThreader::GetGlobalDefaultNumberOfThreads()));
+  this->NumberOfQueuedProcessingTasks = 0;
+  this->NumberOfQueuedNetworkingTasks = 0;
+  this->NextProcessingWorker = 0;
 
   this->ModifiedQueueActive = false;
   this->ModifiedQueueActiveLock = itk::MutexLock::New();
@@ -217,7 +253,7 @@ vtkSlicerApplicationLogic::vtkSlicerApplicationLogic()
   this->WriteDataQueueActiveLock = itk::MutexLock::New();
   this->WriteDataQueueLock = itk::MutexLock::New();
 
-  this->InternalTaskQueue = new ProcessingTaskQueue;
+  this->CompletedTaskQueue = new ProcessingTaskQueue;
   this->InternalModifiedQueue = new ModifiedQueue;
 
   this->InternalReadDataQueue = new ReadDataQueue;
@@ -228,22 +264,11 @@ vtkSlicerApplicationLogic::vtkSlicerApplicationLogic()
 vtkSlicerApplicationLogic::~vtkSlicerApplicationLogic()
 {
   // Note that TerminateThread does not kill a thread, it only waits
-  // for the thread to finish.  We need to signal the thread that we
+  // for the thread to finish.  We need to signal the threads that we
   // want to terminate
-  if (this->ProcessingThreadId != -1 && this->ProcessingThreader)
-    {
-    // Signal the processingThread that we are terminating.
-    this->ProcessingThreadActiveLock->Lock();
-    this->ProcessingThreadActive = false;
-    this->ProcessingThreadActiveLock->Unlock();
-
-    // Wait for the thread to finish and clean up the state of the threader
-    this->ProcessingThreader->TerminateThread( this->ProcessingThreadId );
-
-    this->ProcessingThreadId = -1;
-    }
+  this->TerminateProcessingThread();
 
-  delete this->InternalTaskQueue;
+  delete this->CompletedTaskQueue;
 
   this->ModifiedQueueLock->Lock();
   while (!(*this->InternalModifiedQueue).empty())
@@ -322,36 +347,27 @@ void vtkSlicerApplicationLogic::PrintSelf(ostream& os, vtkIndent indent)
 //----------------------------------------------------------------------------
 void vtkSlicerApplicationLogic::CreateProcessingThread()
 {
-  if (this->ProcessingThreadId == -1)
+  if (this->TaskWorkers.empty())
     {
-    this->ProcessingThreadActiveLock->Lock();
+    this->TaskSchedulerLock.Lock();
     this->ProcessingThreadActive = true;
-    this->ProcessingThreadActiveLock->Unlock();
-
-    this->ProcessingThreadId
-      = this->ProcessingThreader
-      ->SpawnThread(vtkSlicerApplicationLogic::ProcessingThreaderCallback,
-                    this);
-
-    // Start four network threads (TODO: make the number of threads a setting)
-    this->NetworkingThreadIDs.push_back ( this->ProcessingThreader
-          ->SpawnThread(vtkSlicerApplicationLogic::NetworkingThreaderCallback,
-                    this) );
-    /*
-     * TODO: it looks like curl is not thread safe by default
-     * - maybe there's a setting that cmcurl can have
-     *   similar to the --enable-threading of the standard curl build
-     *
-    this->NetworkingThreadIDs.push_back ( this->ProcessingThreader
-          ->SpawnThread(vtkSlicerApplicationLogic::NetworkingThreaderCallback,
-                    this) );
-    this->NetworkingThreadIDs.push_back ( this->ProcessingThreader
-          ->SpawnThread(vtkSlicerApplicationLogic::NetworkingThreaderCallback,
-                    this) );
-    this->NetworkingThreadIDs.push_back ( this->ProcessingThreader
-          ->SpawnThread(vtkSlicerApplicationLogic::NetworkingThreaderCallback,
-                    this) );
-    */
+    this->TaskSchedulerLock.Unlock();
+
+    for (int i = 0; i < this->NumberOfProcessingThreads; ++i)
+      {
+      this->TaskWorkers.push_back(new ProcessingTaskWorker(this, vtkSlicerTask::Processing));
+      }
+    // Only one network thread is started, as curl is not thread safe by default
+    // (maybe there's a setting that cmcurl can have similar to the --enable-threading
+    // of the standard curl build)
+    this->TaskWorkers.push_back(new ProcessingTaskWorker(this, vtkSlicerTask::Networking));
+
+    for (std::vector<ProcessingTaskWorker*>::iterator workerIt = this->TaskWorkers.begin();
+      workerIt != this->TaskWorkers.end(); ++workerIt)
+      {
+      (*workerIt)->ThreadId = this->ProcessingThreader
+        ->SpawnThread(vtkSlicerApplicationLogic::ProcessingThreaderCallback, *workerIt);
+      }
 
     // Setup the communication channel back to the main thread
     this->ModifiedQueueActiveLock->Lock();
@@ -374,7 +390,7 @@ void vtkSlicerApplicationLogic::CreateProcessingThread()
 //----------------------------------------------------------------------------
 void vtkSlicerApplicationLogic::TerminateProcessingThread()
 {
-  if (this->ProcessingThreadId != -1)
+  if (!this->TaskWorkers.empty())
     {
     this->ModifiedQueueActiveLock->Lock();
     this->ModifiedQueueActive = false;
@@ -388,22 +404,30 @@ void vtkSlicerApplicationLogic::TerminateProcessingThread()
     this->WriteDataQueueActive = false;
     this->WriteDataQueueActiveLock->Unlock();
 
-    this->ProcessingThreadActiveLock->Lock();
+    // Wake up all the sleeping threads so that they notice that they have to stop
+    this->TaskSchedulerLock.Lock();
     this->ProcessingThreadActive = false;
-    this->ProcessingThreadActiveLock->Unlock();
-
-    this->ProcessingThreader->TerminateThread( this->ProcessingThreadId );
-    this->ProcessingThreadId = -1;
-
-    std::vector<int>::const_iterator idIterator;
-    idIterator = this->NetworkingThreadIDs.begin();
-    while (idIterator != this->NetworkingThreadIDs.end())
+    this->TaskAvailableCondition->Broadcast();
+    this->TaskSchedulerLock.Unlock();
+
+    // Wait for all the threads to finish and clean up the state of the threader.
+    // Workers are deleted only after all the threads are joined, because a thread
+    // that is still running may access the queue of any worker (see TakeTask).
+    std::vector<ProcessingTaskWorker*>::iterator workerIt;
+    for (workerIt = this->TaskWorkers.begin(); workerIt != this->TaskWorkers.end(); ++workerIt)
+      {
+      this->ProcessingThreader->TerminateThread( (*workerIt)->ThreadId );
+      }
+    for (workerIt = this->TaskWorkers.begin(); workerIt != this->TaskWorkers.end(); ++workerIt)
       {
-      this->ProcessingThreader->TerminateThread( *idIterator );
-      ++idIterator;
+      delete *workerIt;
       }
-    this->NetworkingThreadIDs.clear();
+    this->TaskWorkers.clear();
 
+    this->TaskSchedulerLock.Lock();
+    this->NumberOfQueuedProcessingTasks = 0;
+    this->NumberOfQueuedNetworkingTasks = 0;
+    this->TaskSchedulerLock.Unlock();
     }
 }
 
@@ -431,169 +455,161 @@ vtkSlicerApplicationLogic
   ret = ret; // dummy code to use the return value and avoid a compiler warning
 #endif
 
-  // pull out the reference to the appLogic
-  vtkSlicerApplicationLogic *appLogic
-    = (vtkSlicerApplicationLogic*)
+  // pull out the worker of this thread
+  ProcessingTaskWorker *worker
+    = (ProcessingTaskWorker*)
     (((itk::MultiThreader::ThreadInfoStruct *)(arg))->UserData);
 
-  // Tell the app to start processing any tasks slated for the
-  // processing thread
-  appLogic->ProcessProcessingTasks();
+  // Tell the app to start processing any tasks slated for this thread
+  worker->AppLogic->ProcessTasks(worker);
 
   return ITK_THREAD_RETURN_VALUE;
 }
 
 //----------------------------------------------------------------------------
-void vtkSlicerApplicationLogic::ProcessProcessingTasks()
+void vtkSlicerApplicationLogic::ProcessTasks( ProcessingTaskWorker* worker )
 {
-  int active = true;
-  vtkSmartPointer<vtkSlicerTask> task = 0;
+  int& numberOfQueuedTasks = (worker->Type == vtkSlicerTask::Networking ?
+    this->NumberOfQueuedNetworkingTasks : this->NumberOfQueuedProcessingTasks);
 
-  while (active)
+  while (true)
     {
-    // Check to see if we should be shutting down
-    this->ProcessingThreadActiveLock->Lock();
-    active = this->ProcessingThreadActive;
-    this->ProcessingThreadActiveLock->Unlock();
-
+    // Sleep until a task is scheduled or the threads are terminated. The
+    // task is taken in the same critical section, so a woken thread either
+    // gets a task or goes back to sleep.
+    vtkSmartPointer<vtkSlicerTask> task;
+    this->TaskSchedulerLock.Lock();
+    while (this->ProcessingThreadActive && numberOfQueuedTasks == 0)
+      {
+      this->TaskAvailableCondition->Wait(&this->TaskSchedulerLock);
+      }
+    int active = this->ProcessingThreadActive;
     if (active)
       {
-      // pull a task off the queue
-      this->ProcessingTaskQueueLock->Lock();
-      if ((*this->InternalTaskQueue).size() > 0)
-        {
-        // std::cout << "Number of queued tasks: " << (*this->InternalTaskQueue).size() << std::endl;
-
-        // only handle processing tasks in this thread
-        task = (*this->InternalTaskQueue).front();
-        if ( task->GetType() == vtkSlicerTask::Processing )
-          {
-          (*this->InternalTaskQueue).pop();
-          }
-        else
-          {
-          task = NULL;
-          }
-        }
-      this->ProcessingTaskQueueLock->Unlock();
-
-      // process the task (should this be in a separate thread?)
-      if (task)
-        {
-        task->Execute();
-        task = 0;
-        }
+      task = this->TakeTask(worker);
+      }
+    this->TaskSchedulerLock.Unlock();
+    if (!active)
+      {
+      break;
+      }
+    if (!task)
+      {
+      continue;
+      }
+    if (!task->GetCanceled())
+      {
+      task->Execute();
       }
 
-    // busy wait
-    itksys::SystemTools::Delay(100);
+    // Notify the main thread
+    this->CompletedTaskQueueLock->Lock();
+    this->CompletedTaskQueue->push_back(task);
+    this->CompletedTaskQueueLock->Unlock();
     }
 }
 
-ITK_THREAD_RETURN_TYPE
-vtkSlicerApplicationLogic
-::NetworkingThreaderCallback( void *arg )
-{
-
-#ifdef ITK_USE_WIN32_THREADS
-  // Adjust the priority of this thread
-  SetThreadPriority(GetCurrentThread(),
-                    THREAD_PRIORITY_BELOW_NORMAL);
-#endif
-
-#ifdef ITK_USE_PTHREADS
-  // Adjust the priority of all PROCESS level threads.  Not a perfect solution.
-  int which = PRIO_PROCESS;
-  id_t pid;
-  int priority = 20;
-  int ret;
-
-  pid = getpid();
-  ret = setpriority(which, pid, priority);
-  ret = ret; // dummy code to use the return value and avoid a compiler warning
-#endif
-
-  // pull out the reference to the appLogic
-  vtkSlicerApplicationLogic *appLogic
-    = (vtkSlicerApplicationLogic*)
-    (((itk::MultiThreader::ThreadInfoStruct *)(arg))->UserData);
-
-  // Tell the app to start processing any tasks slated for the
-  // processing thread
-  appLogic->ProcessNetworkingTasks();
-
-  return ITK_THREAD_RETURN_VALUE;
-}
-
 //----------------------------------------------------------------------------
-void vtkSlicerApplicationLogic::ProcessNetworkingTasks()
+vtkSmartPointer<vtkSlicerTask> vtkSlicerApplicationLogic::TakeTask( ProcessingTaskWorker* worker )
 {
-  int active = true;
-  vtkSmartPointer<vtkSlicerTask> task = 0;
-
-  while (active)
+  // The front task of each queue has the highest priority of the queue.
+  // Pick the highest priority one among the queues the worker can take
+  // from, its own queue first so that it wins between equal priorities.
+  ProcessingTaskWorker* source = (worker->Tasks.empty() ? NULL : worker);
+  if (worker->Type == vtkSlicerTask::Processing)
     {
-    // Check to see if we should be shutting down
-    this->ProcessingThreadActiveLock->Lock();
-    active = this->ProcessingThreadActive;
-    this->ProcessingThreadActiveLock->Unlock();
-
-    if (active)
+    for (std::vector<ProcessingTaskWorker*>::iterator workerIt = this->TaskWorkers.begin();
+      workerIt != this->TaskWorkers.end(); ++workerIt)
       {
-      // pull a task off the queue
-      this->ProcessingTaskQueueLock->Lock();
-      if ((*this->InternalTaskQueue).size() > 0)
+      ProcessingTaskWorker* otherWorker = *workerIt;
+      if (otherWorker == worker || otherWorker->Type != vtkSlicerTask::Processing
+        || otherWorker->Tasks.empty())
         {
-        // std::cout << "Number of queued tasks: " << (*this->InternalTaskQueue).size() << std::endl;
-        task = (*this->InternalTaskQueue).front();
-        if ( task->GetType() == vtkSlicerTask::Networking )
-          {
-          (*this->InternalTaskQueue).pop();
-          }
-        else
-          {
-          task = NULL;
-          }
+        continue;
         }
-      this->ProcessingTaskQueueLock->Unlock();
-
-      // process the task (should this be in a separate thread?)
-      if (task)
+      if (!source
+        || otherWorker->Tasks.front()->GetPriority() > source->Tasks.front()->GetPriority())
         {
-        task->Execute();
-        task = 0;
+        source = otherWorker;
         }
       }
+    }
+  if (!source)
+    {
+    return NULL;
+    }
 
-    // busy wait
-    itksys::SystemTools::Delay(100);
+  vtkSmartPointer<vtkSlicerTask> task = source->Tasks.front();
+  source->Tasks.pop_front();
+  if (worker->Type == vtkSlicerTask::Networking)
+    {
+    --this->NumberOfQueuedNetworkingTasks;
+    }
+  else
+    {
+    --this->NumberOfQueuedProcessingTasks;
     }
+  return task;
 }
 
 //----------------------------------------------------------------------------
 int vtkSlicerApplicationLogic::ScheduleTask( vtkSlicerTask *task )
 {
-  int active;
-
-  // std::cout << "Scheduling a task ";
-
-  // only schedule a task if the processing task is up
-  this->ProcessingThreadActiveLock->Lock();
-  active = this->ProcessingThreadActive;
-  this->ProcessingThreadActiveLock->Unlock();
+  // only schedule a task if the processing threads are up
+  this->TaskSchedulerLock.Lock();
+  if (!this->ProcessingThreadActive || !task || this->TaskWorkers.empty())
+    {
+    this->TaskSchedulerLock.Unlock();
+    // could not schedule the task
+    return false;
+    }
 
-  if (active)
+  // Networking tasks are executed in the networking thread (last worker),
+  // processing tasks are distributed between the processing threads
+  ProcessingTaskWorker* worker = this->TaskWorkers.back();
+  if (task->GetType() != vtkSlicerTask::Networking)
     {
-    this->ProcessingTaskQueueLock->Lock();
-    (*this->InternalTaskQueue).push( task );
-    //std::cout << (*this->InternalTaskQueue).size() << std::endl;
-    this->ProcessingTaskQueueLock->Unlock();
+    worker = this->TaskWorkers[this->NextProcessingWorker % this->NumberOfProcessingThreads];
+    this->NextProcessingWorker = (this->NextProcessingWorker + 1) % this->NumberOfProcessingThreads;
+    }
+  worker->Tasks.PushByPriority( task );
 
-    return true;
+  // Wake up the threads
+  if (worker->Type == vtkSlicerTask::Networking)
+    {
+    ++this->NumberOfQueuedNetworkingTasks;
     }
+  else
+    {
+    ++this->NumberOfQueuedProcessingTasks;
+    }
+  this->TaskAvailableCondition->Broadcast();
+  this->TaskSchedulerLock.Unlock();
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerApplicationLogic::GetNumberOfQueuedTasks()
+{
+  this->TaskSchedulerLock.Lock();
+  int numberOfQueuedTasks = this->NumberOfQueuedProcessingTasks + this->NumberOfQueuedNetworkingTasks;
+  this->TaskSchedulerLock.Unlock();
+  return numberOfQueuedTasks;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerApplicationLogic::ProcessCompletedTasks()
+{
+  ProcessingTaskQueue completedTasks;
+  this->CompletedTaskQueueLock->Lock();
+  completedTasks.swap(*this->CompletedTaskQueue);
+  this->CompletedTaskQueueLock->Unlock();
 
-  // could not schedule the task
-  return false;
+  for (ProcessingTaskQueue::iterator taskIt = completedTasks.begin(); taskIt != completedTasks.end(); ++taskIt)
+    {
+    (*taskIt)->InvokeEvent(vtkSlicerTask::TaskCompletedEvent);
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -729,6 +745,8 @@ void vtkSlicerApplicationLogic::ProcessModified()
     return;
     }
 
+  this->ProcessCompletedTasks();
+
   vtkSmartPointer<vtkObject> obj = 0;
   // pull an object off the queue to modify
   this->ModifiedQueueLock->Lock();
@@ -26,8 +26,10 @@
 
 // VTK includes
 #include <vtkCollection.h>
+#include <vtkSmartPointer.h>
 
 // ITK includes
+#include <itkConditionVariable.h>
 #include <itkMultiThreader.h>
 #include <itkMutexLock.h>
 
@@ -38,6 +40,7 @@ class vtkDataIOManagerLogic;
 class vtkSlicerTask;
 class ModifiedQueue;
 class ProcessingTaskQueue;
+class ProcessingTaskWorker;
 class ReadDataQueue;
 class ReadDataRequest;
 class WriteDataQueue;
@@ -69,11 +72,22 @@ class VTK_SLICER_BASE_LOGIC_EXPORT vtkSlicerApplicationLogic
   /// (display it in the Fiducials GUI)
   void PropagateFiducialListSelection();
 
-  /// Create a thread for processing
+  /// Create the threads for processing: NumberOfProcessingThreads threads
+  /// for processing tasks and one thread for networking tasks.
   void CreateProcessingThread();
 
-  /// Shutdown the processing thread
+  /// Shutdown the processing threads. Tasks that are still queued are discarded.
   void TerminateProcessingThread();
+
+  /// Number of threads that execute processing tasks (for example CLI modules)
+  /// concurrently. Must be set before CreateProcessingThread() is called.
+  /// Default is the number of processors, but at most 4.
+  vtkSetClampMacro(NumberOfProcessingThreads, int, 1, 64);
+  vtkGetMacro(NumberOfProcessingThreads, int);
+
+  /// Return the number of scheduled tasks that have not been started yet.
+  int GetNumberOfQueuedTasks();
+
   /// List of events potentially fired by the application logic
   enum RequestEvents
     {
@@ -87,9 +101,15 @@ class VTK_SLICER_BASE_LOGIC_EXPORT vtkSlicerApplicationLogic
       RequestProcessedEvent
     };
 
-  /// Schedule a task to run in the processing thread. Returns true if
+  /// Schedule a task to run in a processing thread. Returns true if
   /// task was successfully scheduled. ScheduleTask() is called from the
-  /// main thread to run something in the processing thread.
+  /// main thread to run something in a processing thread.
+  /// Processing tasks are distributed between the processing threads, and
+  /// idle threads take over queued tasks from busy threads. Networking tasks
+  /// are executed one after the other in the networking thread.
+  /// Tasks with higher priority are started first (\sa vtkSlicerTask::SetPriority).
+  /// When the task is completed, vtkSlicerTask::TaskCompletedEvent is invoked
+  /// on the task in the main thread (from ProcessModified()).
   int ScheduleTask( vtkSlicerTask* );
 
   /// Request a Modified call on an object.  This method allows a
@@ -150,6 +170,7 @@ class VTK_SLICER_BASE_LOGIC_EXPORT vtkSlicerApplicationLogic
   /// in the main thread of the application because calls to Modified()
   /// can cause an update to the GUI. (Method needs to be public to fit
   /// in the event callback chain.)
+  /// Completion events of the executed tasks are invoked here as well.
   void ProcessModified();
 
   /// Process a request to read data and set it on a referenced node.
@@ -198,17 +219,22 @@ protected:
   vtkSlicerApplicationLogic();
   ~vtkSlicerApplicationLogic();
 
-  /// Callback used by a MultiThreader to start a processing thread
+  /// Callback used by a MultiThreader to start a processing or networking thread
   static ITK_THREAD_RETURN_TYPE ProcessingThreaderCallback( void * );
 
-  /// Callback used by a MultiThreader to start a networking thread
-  static ITK_THREAD_RETURN_TYPE NetworkingThreaderCallback( void * );
+  /// Task processing loop that is run in a processing or networking thread.
+  /// The thread sleeps while there is no task to execute.
+  void ProcessTasks( ProcessingTaskWorker* worker );
 
-  /// Task processing loop that is run in the processing thread
-  void ProcessProcessingTasks();
+  /// Take the highest priority task that the worker can execute: a
+  /// processing worker also steals from the queues of the other processing
+  /// workers, and its own queue is preferred between tasks of the same
+  /// priority. Must be called with TaskSchedulerLock locked.
+  vtkSmartPointer<vtkSlicerTask> TakeTask( ProcessingTaskWorker* worker );
 
-  /// Networking Task processing loop that is run in a networking thread
-  void ProcessNetworkingTasks();
+  /// Invoke the completion event of the tasks that have been executed.
+  /// Called from the main thread.
+  void ProcessCompletedTasks();
 
   /// Process a request to read data into a node.  This method is
   /// called by ProcessReadData() in the application main thread
@@ -229,8 +255,11 @@ private:
   void operator=(const vtkSlicerApplicationLogic&);
 
   itk::MultiThreader::Pointer ProcessingThreader;
-  itk::MutexLock::Pointer ProcessingThreadActiveLock;
-  itk::MutexLock::Pointer ProcessingTaskQueueLock;
+  itk::MutexLock::Pointer CompletedTaskQueueLock;
+  /// Protects ProcessingThreadActive, the task queues of the workers and
+  /// the number of queued tasks, used with TaskAvailableCondition
+  itk::SimpleMutexLock TaskSchedulerLock;
+  itk::ConditionVariable::Pointer TaskAvailableCondition;
   itk::MutexLock::Pointer ModifiedQueueActiveLock;
   itk::MutexLock::Pointer ModifiedQueueLock;
   itk::MutexLock::Pointer ReadDataQueueActiveLock;
@@ -238,14 +267,18 @@ private:
   itk::MutexLock::Pointer WriteDataQueueActiveLock;
   itk::MutexLock::Pointer WriteDataQueueLock;
   vtkTimeStamp RequestTimeStamp;
-  int ProcessingThreadId;
-  std::vector<int> NetworkingThreadIDs;
+  int NumberOfProcessingThreads;
   int ProcessingThreadActive;
   int ModifiedQueueActive;
   int ReadDataQueueActive;
   int WriteDataQueueActive;
 
-  ProcessingTaskQueue* InternalTaskQueue;
+  /// Processing workers followed by the networking worker
+  std::vector<ProcessingTaskWorker*> TaskWorkers;
+  int NumberOfQueuedProcessingTasks;
+  int NumberOfQueuedNetworkingTasks;
+  int NextProcessingWorker;
+  ProcessingTaskQueue* CompletedTaskQueue;
   ModifiedQueue*       InternalModifiedQueue;
   ReadDataQueue*       InternalReadDataQueue;
   WriteDataQueue*      InternalWriteDataQueue;
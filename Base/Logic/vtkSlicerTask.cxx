@@ -12,6 +12,8 @@ vtkSlicerTask::vtkSlicerTask()
   this->TaskObject = 0;
   this->TaskFunction = 0;
   this->Type = vtkSlicerTask::Undefined;
+  this->Priority = 0;
+  this->Canceled = 0;
 }
 //----------------------------------------------------------------------------
 vtkSlicerTask::~vtkSlicerTask()
@@ -41,4 +43,7 @@ void vtkSlicerTask::Execute()
 void vtkSlicerTask::PrintSelf(ostream& os, vtkIndent indent)
 {
   Superclass::PrintSelf(os, indent);
+  os << indent << "Type: " << this->GetTypeAsString() << "\n";
+  os << indent << "Priority: " << this->Priority << "\n";
+  os << indent << "Canceled: " << this->Canceled << "\n";
 }
@@ -1,6 +1,7 @@
 #ifndef __vtkSlicerTask_h
 #define __vtkSlicerTask_h
 
+#include "vtkCommand.h"
 #include "vtkObject.h"
 #include "vtkSmartPointer.h"
 #include "vtkMRMLAbstractLogic.h"
@@ -23,6 +24,25 @@ public:
   /// Execute the task.
   virtual void Execute();
 
+  /// Event invoked in the main thread after the task has been executed
+  /// (or skipped because it was canceled) by the application logic.
+  enum
+    {
+    TaskCompletedEvent = vtkCommand::UserEvent + 1
+    };
+
+  ///
+  /// Priority of the task. Queued tasks with higher priority are executed first,
+  /// tasks with the same priority are executed in the order they were scheduled.
+  vtkSetMacro (Priority, int);
+  vtkGetMacro (Priority, int);
+
+  ///
+  /// Request cancellation of the task. A canceled task is not executed if it has
+  /// not been started yet. Long running task functions may also check GetCanceled().
+  void Cancel() { this->Canceled = 1; };
+  int GetCanceled() { return this->Canceled; };
+
   ///
   /// The type of task - this can be used, for example, to decide
   /// how many concurrent threads should be allowed
@@ -60,6 +80,8 @@ private:
   void *TaskClientData;
 
   int Type;
+  int Priority;
+  volatile int Canceled;
 
 };
 #endif
@@ -21,6 +21,8 @@
 #include "qSlicerApplicationHelper.h"
 
 // Qt includes
+#include <QDir>
+#include <QFileInfo>
 #include <QSettings>
 
 // Slicer includes
@@ -128,6 +130,15 @@ void qSlicerApplicationHelper::setupModuleFactoryManager(qSlicerModuleFactoryMan
 
     qSlicerCLIExecutableModuleFactory* cliExecutableFactory = new qSlicerCLIExecutableModuleFactory();
     cliExecutableFactory->setTempDirectory(tempDirectory);
+    // Cache the XML descriptions of the executables next to the settings
+    // so that they are not all run with "--xml" at each startup.
+    if (app->userSettings()->value("Modules/CacheCLIXmlDescriptions", true).toBool())
+      {
+      QFileInfo revisionUserSettingsFileInfo(app->revisionUserSettings()->fileName());
+      cliExecutableFactory->setXmlDescriptionCacheFilePath(
+        revisionUserSettingsFileInfo.dir().filePath(
+          revisionUserSettingsFileInfo.completeBaseName() + "-CLIXmlDescriptions.cache"));
+      }
     moduleFactoryManager->registerFactory(cliExecutableFactory, preferExecutableCLIs ? 1 : 0);
 
     if (!options->disableBuiltInModules() &&
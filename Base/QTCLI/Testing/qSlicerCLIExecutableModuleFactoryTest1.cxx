@@ -19,16 +19,97 @@
 ==============================================================================*/
 
 // QT includes
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 
 // SlicerQt includes
+#include <qSlicerAbstractCoreModule.h>
 #include <qSlicerCLIExecutableModuleFactory.h>
 
 // STD includes
 
 #include "vtkMRMLCoreTestingMacros.h"
 
-int qSlicerCLIExecutableModuleFactoryTest1(int, char * [] )
+namespace
 {
+
+const char CachedTitle[] = "Cached Command Line Module Test";
+
+//-----------------------------------------------------------------------------
+QByteArray readFile(const QString& filePath)
+{
+  QFile file(filePath);
+  if (!file.open(QIODevice::ReadOnly))
+    {
+    return QByteArray();
+    }
+  return file.readAll();
+}
+
+//-----------------------------------------------------------------------------
+bool writeFile(const QString& filePath, const QByteArray& content)
+{
+  QFile file(filePath);
+  return file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+    && file.write(content) == content.size();
+}
+
+//-----------------------------------------------------------------------------
+/// Write a cache with a single entry for \a executablePath, in the format
+/// of qSlicerCLIExecutableModuleFactory. \a sizeOffset is added to the size
+/// of the executable to make the entry stale.
+bool writeCache(const QString& cacheFilePath, const QString& executablePath, qint64 sizeOffset)
+{
+  QFileInfo info(executablePath);
+  QByteArray xmlDescription = QString(
+    "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+    "<executable><category>Testing</category><title>%1</title></executable>\n")
+    .arg(CachedTitle).toUtf8();
+  QByteArray content;
+  QDataStream stream(&content, QIODevice::WriteOnly);
+  stream.setVersion(QDataStream::Qt_4_6);
+  stream << quint32(0x534c4358) << qint32(1) << qint32(1)
+         << executablePath << qint64(info.size() + sizeOffset)
+         << qint64(info.lastModified().toMSecsSinceEpoch()) << xmlDescription;
+  return writeFile(cacheFilePath, content);
+}
+
+//-----------------------------------------------------------------------------
+/// Instantiate the module of \a executablePath with a new factory that uses
+/// \a cacheFilePath and return the title of the module.
+QString instantiatedModuleTitle(const QString& cacheFilePath, const QString& executablePath)
+{
+  qSlicerCLIExecutableModuleFactory factory;
+  factory.setXmlDescriptionCacheFilePath(cacheFilePath);
+  QString key = factory.registerFileItem(QFileInfo(executablePath));
+  if (key.isEmpty())
+    {
+    return QString();
+    }
+  qSlicerAbstractCoreModule* module = factory.instantiate(key);
+  if (!module)
+    {
+    return QString();
+    }
+  QString title = module->title();
+  factory.uninstantiate(key);
+  return title;
+}
+
+} // end of anonymous namespace
+
+//-----------------------------------------------------------------------------
+int qSlicerCLIExecutableModuleFactoryTest1(int argc, char * argv[] )
+{
+  if (argc < 3)
+    {
+    std::cerr << "Usage: " << argv[0] << " /path/to/CLIModule4Test /path/to/temp" << std::endl;
+    return EXIT_FAILURE;
+    }
+
   QStringList executableNames;
   executableNames << "Threshold.exe"
                   << "Threshold";
@@ -48,5 +129,61 @@ int qSlicerCLIExecutableModuleFactoryTest1(int, char * [] )
       }
     }
 
+  if (!factory.xmlDescriptionCacheFilePath().isEmpty())
+    {
+    std::cerr << __LINE__ << " - XML description cache must be disabled by default" << std::endl;
+    return EXIT_FAILURE;
+    }
+  QString cacheFilePath("CLIXmlDescriptions.cache");
+  factory.setXmlDescriptionCacheFilePath(cacheFilePath);
+  if (factory.xmlDescriptionCacheFilePath() != cacheFilePath)
+    {
+    std::cerr << __LINE__ << " - Error in setXmlDescriptionCacheFilePath()" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Copy the executable so that it has no XML description file next to it
+  QDir tempDir(QString::fromLocal8Bit(argv[2]));
+  QFileInfo sourceExecutable(QString::fromLocal8Bit(argv[1]));
+  QString executablePath = tempDir.filePath(sourceExecutable.fileName());
+  QFile::remove(executablePath);
+  CHECK_BOOL(QFile::copy(sourceExecutable.absoluteFilePath(), executablePath), true);
+  cacheFilePath = tempDir.filePath("qSlicerCLIExecutableModuleFactoryTest1.cache");
+  QFile::remove(cacheFilePath);
+  QString expectedTitle("Command Line Module Test");
+
+  // Missing cache: the executable is run and the cache is written
+  CHECK_BOOL(instantiatedModuleTitle(cacheFilePath, executablePath) == expectedTitle, true);
+  QByteArray cacheContent = readFile(cacheFilePath);
+  CHECK_BOOL(cacheContent.isEmpty(), false);
+  CHECK_BOOL(instantiatedModuleTitle(cacheFilePath, executablePath) == expectedTitle, true);
+  CHECK_BOOL(readFile(cacheFilePath) == cacheContent, true);
+
+  // Cache hit: the cached description is used, the cache is not rewritten
+  CHECK_BOOL(writeCache(cacheFilePath, executablePath, 0), true);
+  QByteArray hitCacheContent = readFile(cacheFilePath);
+  CHECK_BOOL(instantiatedModuleTitle(cacheFilePath, executablePath) == CachedTitle, true);
+  CHECK_BOOL(readFile(cacheFilePath) == hitCacheContent, true);
+
+  // Executable changed since it was cached: the entry is replaced
+  CHECK_BOOL(writeCache(cacheFilePath, executablePath, 1), true);
+  CHECK_BOOL(instantiatedModuleTitle(cacheFilePath, executablePath) == expectedTitle, true);
+  CHECK_BOOL(readFile(cacheFilePath) == cacheContent, true);
+
+  // Corrupted or truncated cache: ignored and rewritten
+  CHECK_BOOL(writeFile(cacheFilePath, QByteArray("not a cache")), true);
+  CHECK_BOOL(instantiatedModuleTitle(cacheFilePath, executablePath) == expectedTitle, true);
+  CHECK_BOOL(readFile(cacheFilePath) == cacheContent, true);
+  CHECK_BOOL(writeFile(cacheFilePath, hitCacheContent.left(hitCacheContent.size() - 10)), true);
+  CHECK_BOOL(instantiatedModuleTitle(cacheFilePath, executablePath) == expectedTitle, true);
+  CHECK_BOOL(readFile(cacheFilePath) == cacheContent, true);
+
+  // No temporary file is left behind
+  CHECK_INT(tempDir.entryList(QStringList() << "qSlicerCLIExecutableModuleFactoryTest1.cache*",
+                              QDir::Files).count(), 1);
+
+  QFile::remove(cacheFilePath);
+  QFile::remove(executablePath);
+
   return EXIT_SUCCESS;
 }
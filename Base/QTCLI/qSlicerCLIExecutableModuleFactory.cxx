@@ -19,7 +19,14 @@
 ==============================================================================*/
 
 // Qt includes
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QHash>
 #include <QProcess>
+#include <QQueue>
+#include <QThread>
 
 // SlicerQt includes
 #include "qSlicerCLIExecutableModuleFactory.h"
@@ -28,9 +35,406 @@
 #include "qSlicerUtils.h"
 #include <vtkSlicerCLIModuleLogic.h>
 
+// STD includes
+#ifdef Q_OS_WIN
+# include <windows.h>
+#else
+# include <cstdio>
+#endif
+
+namespace
+{
+
+const int CLIProcessTimeoutInMs = 5000;
+
+const quint32 XmlDescriptionCacheMagic = 0x534c4358; // "SLCX"
+const qint32 XmlDescriptionCacheVersion = 1;
+
+//-----------------------------------------------------------------------------
+/// Result of running a CLI executable with "--xml"
+struct qSlicerCLIXmlDescriptionProbe
+{
+  QString XmlDescription;
+  QStringList Errors;
+  QStringList Warnings;
+};
+
+//-----------------------------------------------------------------------------
+QString xmlModuleDescriptionFilePath(const QString& executablePath)
+{
+  QFileInfo info = QFileInfo(executablePath);
+  return QDir(info.path()).filePath(info.baseName() + ".xml");
+}
+
+//-----------------------------------------------------------------------------
+/// Move \a sourcePath to \a destinationPath, replacing the existing file in
+/// a single step: the destination is never missing nor partially written.
+bool replaceFile(const QString& sourcePath, const QString& destinationPath)
+{
+#ifdef Q_OS_WIN
+  return MoveFileExW(
+    reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(sourcePath).utf16()),
+    reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(destinationPath).utf16()),
+    MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+  return ::rename(QFile::encodeName(sourcePath).constData(),
+                  QFile::encodeName(destinationPath).constData()) == 0;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+void startXmlDescriptionProbe(QProcess& cli, const QString& executablePath)
+{
+  QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+  env.insert("ITK_AUTOLOAD_PATH", "");
+  cli.setProcessEnvironment(env);
+  cli.setWorkingDirectory(QFileInfo(executablePath).path());
+  cli.start(executablePath, QStringList(QString("--xml")));
+}
+
+//-----------------------------------------------------------------------------
+QString processErrorString(QProcess::ProcessError error)
+{
+  QString errorString;
+  switch(error)
+    {
+    case QProcess::FailedToStart:
+      errorString = QLatin1String(
+            "The process failed to start. Either the invoked program is missing, or "
+            "you may have insufficient permissions to invoke the program.");
+      break;
+    case QProcess::Crashed:
+      errorString = QLatin1String(
+            "The process crashed some time after starting successfully.");
+      break;
+    case QProcess::Timedout:
+      errorString = QString(
+            "The process timed out after %1 msecs.").arg(CLIProcessTimeoutInMs);
+      break;
+    case QProcess::WriteError:
+      errorString = QLatin1String(
+            "An error occurred when attempting to read from the process. "
+            "For example, the process may not be running.");
+      break;
+    case QProcess::ReadError:
+      errorString = QLatin1String(
+            "An error occurred when attempting to read from the process. "
+            "For example, the process may not be running.");
+      break;
+    case QProcess::UnknownError:
+      errorString = QLatin1String(
+            "Failed to execute process. An unknown error occurred.");
+      break;
+    }
+  return errorString;
+}
+
+//-----------------------------------------------------------------------------
+/// Wait for a process started with startXmlDescriptionProbe() and collect
+/// its XML description.
+void finishXmlDescriptionProbe(QProcess& cli, const QString& executablePath,
+                               qSlicerCLIXmlDescriptionProbe& probe)
+{
+  bool res = cli.waitForFinished(CLIProcessTimeoutInMs);
+  if (!res)
+    {
+    probe.Errors << QString("CLI executable: %1").arg(executablePath);
+    probe.Errors << processErrorString(cli.error());
+    if (cli.state() != QProcess::NotRunning)
+      {
+      cli.kill();
+      cli.waitForFinished();
+      }
+    return;
+    }
+  QString errors = cli.readAllStandardError();
+  if (!errors.isEmpty())
+    {
+    probe.Errors << QString("CLI executable: %1").arg(executablePath);
+    probe.Errors << errors;
+    // TODO: More investigation for the following behavior:
+    // on my machine (Ubuntu 10.04 with ITKv4), having standard error trims the
+    // standard output results. The following readAllStandardOutput() is then
+    // missing chars and makes the XML invalid. I'm not sure if it's just on my
+    // machine so there is a chance it succeeds to parse the XML description
+    // on other machines.
+    }
+  QString xmlDescription = cli.readAllStandardOutput();
+  if (xmlDescription.isEmpty())
+    {
+    probe.Errors << QString("CLI executable: %1").arg(executablePath);
+    probe.Errors << QLatin1String("Failed to retrieve Xml Description");
+    return;
+    }
+  if (!xmlDescription.startsWith("<?xml"))
+    {
+    probe.Warnings << QString("CLI executable: %1").arg(executablePath);
+    probe.Warnings << QLatin1String("XML description doesn't start right away.");
+    probe.Warnings << QString("Output before '<?xml' is [%1]").arg(
+                        xmlDescription.mid(0, xmlDescription.indexOf("<?xml")));
+    xmlDescription.remove(0, xmlDescription.indexOf("<?xml"));
+    }
+  probe.XmlDescription = xmlDescription;
+}
+
+} // end of anonymous namespace
+
+//-----------------------------------------------------------------------------
+// qSlicerCLIExecutableModuleFactoryPrivate
+
+//-----------------------------------------------------------------------------
+class qSlicerCLIExecutableModuleFactoryPrivate
+{
+  Q_DECLARE_PUBLIC(qSlicerCLIExecutableModuleFactory);
+protected:
+  qSlicerCLIExecutableModuleFactory* const q_ptr;
+public:
+  typedef qSlicerCLIExecutableModuleFactoryPrivate Self;
+  qSlicerCLIExecutableModuleFactoryPrivate(qSlicerCLIExecutableModuleFactory& object);
+
+  /// Return the result of running \a executablePath with "--xml".
+  /// The first call probes all the registered executables that have no
+  /// XML description file: cached descriptions are reused and the other
+  /// executables are run concurrently.
+  /// Return false if \a executablePath is not a registered executable.
+  bool probedXmlDescription(const QString& executablePath,
+                            qSlicerCLIXmlDescriptionProbe& probe);
+
+protected:
+  struct CachedXmlDescription
+  {
+    CachedXmlDescription() : Size(0), LastModified(0) {}
+    qint64 Size;
+    qint64 LastModified;
+    QByteArray XmlDescription;
+  };
+
+  bool isCachedXmlDescriptionValid(const QString& executablePath)const;
+  void probeXmlDescriptions();
+  void readXmlDescriptionCache();
+  void writeXmlDescriptionCache()const;
+
+private:
+  QString TempDirectory;
+  QString XmlDescriptionCacheFilePath;
+
+  bool XmlDescriptionsProbed;
+  QHash<QString, CachedXmlDescription> XmlDescriptionCache;
+  QHash<QString, qSlicerCLIXmlDescriptionProbe> XmlDescriptionProbes;
+};
+
+//-----------------------------------------------------------------------------
+qSlicerCLIExecutableModuleFactoryPrivate::qSlicerCLIExecutableModuleFactoryPrivate(qSlicerCLIExecutableModuleFactory& object)
+:q_ptr(&object)
+{
+  this->TempDirectory = QDir::tempPath();
+  this->XmlDescriptionsProbed = false;
+}
+
+//-----------------------------------------------------------------------------
+bool qSlicerCLIExecutableModuleFactoryPrivate::probedXmlDescription(
+  const QString& executablePath, qSlicerCLIXmlDescriptionProbe& probe)
+{
+  if (!this->XmlDescriptionsProbed)
+    {
+    this->XmlDescriptionsProbed = true;
+    this->probeXmlDescriptions();
+    }
+  if (!this->XmlDescriptionProbes.contains(executablePath))
+    {
+    return false;
+    }
+  // Descriptions are only needed once: instantiating the module again
+  // (e.g. after a reload) runs the executable again.
+  probe = this->XmlDescriptionProbes.take(executablePath);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool qSlicerCLIExecutableModuleFactoryPrivate::isCachedXmlDescriptionValid(
+  const QString& executablePath)const
+{
+  if (!this->XmlDescriptionCache.contains(executablePath))
+    {
+    return false;
+    }
+  CachedXmlDescription cachedDescription =
+    this->XmlDescriptionCache.value(executablePath);
+  QFileInfo info(executablePath);
+  return cachedDescription.Size == info.size()
+    && cachedDescription.LastModified == info.lastModified().toMSecsSinceEpoch();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerCLIExecutableModuleFactoryPrivate::probeXmlDescriptions()
+{
+  Q_Q(qSlicerCLIExecutableModuleFactory);
+  this->readXmlDescriptionCache();
+
+  QQueue<QString> executablesToProbe;
+  QHash<QString, CachedXmlDescription> currentCache;
+  foreach(const QString& key, q->itemKeys())
+    {
+    QString executablePath = q->path(key);
+    if (executablePath.isEmpty()
+        || QFile::exists(xmlModuleDescriptionFilePath(executablePath)))
+      {
+      continue;
+      }
+    if (this->isCachedXmlDescriptionValid(executablePath))
+      {
+      currentCache[executablePath] = this->XmlDescriptionCache[executablePath];
+      this->XmlDescriptionProbes[executablePath].XmlDescription =
+        QString::fromUtf8(currentCache[executablePath].XmlDescription);
+      continue;
+      }
+    executablesToProbe.enqueue(executablePath);
+    }
+  // Drop the entries of the executables that are not registered anymore.
+  bool cacheModified = (currentCache.count() != this->XmlDescriptionCache.count());
+
+  // Run up to idealThreadCount() executables at a time. Each process is given
+  // the whole timeout once it is waited for: the output of the processes
+  // that are not waited for is not read, which may block them.
+  int maximumNumberOfProcesses = qMax(1, QThread::idealThreadCount());
+  QQueue<QPair<QString, QProcess*> > runningProbes;
+  while (!executablesToProbe.isEmpty() || !runningProbes.isEmpty())
+    {
+    while (!executablesToProbe.isEmpty()
+           && runningProbes.count() < maximumNumberOfProcesses)
+      {
+      QString executablePath = executablesToProbe.dequeue();
+      QProcess* cli = new QProcess;
+      startXmlDescriptionProbe(*cli, executablePath);
+      runningProbes.enqueue(qMakePair(executablePath, cli));
+      }
+    QPair<QString, QProcess*> runningProbe = runningProbes.dequeue();
+    const QString& executablePath = runningProbe.first;
+    qSlicerCLIXmlDescriptionProbe& probe = this->XmlDescriptionProbes[executablePath];
+    finishXmlDescriptionProbe(*runningProbe.second, executablePath, probe);
+    delete runningProbe.second;
+
+    // Executables that fail or print errors are not cached so that the
+    // problems are reported at each startup.
+    if (!probe.XmlDescription.isEmpty() && probe.Errors.isEmpty())
+      {
+      QFileInfo info(executablePath);
+      CachedXmlDescription& cachedDescription = currentCache[executablePath];
+      cachedDescription.Size = info.size();
+      cachedDescription.LastModified = info.lastModified().toMSecsSinceEpoch();
+      cachedDescription.XmlDescription = probe.XmlDescription.toUtf8();
+      }
+    cacheModified = true;
+    }
+
+  this->XmlDescriptionCache = currentCache;
+  if (cacheModified)
+    {
+    this->writeXmlDescriptionCache();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerCLIExecutableModuleFactoryPrivate::readXmlDescriptionCache()
+{
+  this->XmlDescriptionCache.clear();
+  if (this->XmlDescriptionCacheFilePath.isEmpty())
+    {
+    return;
+    }
+  QFile cacheFile(this->XmlDescriptionCacheFilePath);
+  if (!cacheFile.open(QIODevice::ReadOnly))
+    {
+    return;
+    }
+  // Read the whole file at once and parse it from memory.
+  QByteArray content = cacheFile.readAll();
+  cacheFile.close();
+
+  QDataStream stream(content);
+  stream.setVersion(QDataStream::Qt_4_6);
+  quint32 magic = 0;
+  qint32 version = 0;
+  qint32 count = 0;
+  stream >> magic >> version >> count;
+  if (magic != XmlDescriptionCacheMagic
+      || version != XmlDescriptionCacheVersion
+      || count < 0)
+    {
+    return;
+    }
+  QHash<QString, CachedXmlDescription> cache;
+  for (qint32 i = 0; i < count; ++i)
+    {
+    QString executablePath;
+    CachedXmlDescription cachedDescription;
+    stream >> executablePath >> cachedDescription.Size
+           >> cachedDescription.LastModified >> cachedDescription.XmlDescription;
+    if (stream.status() != QDataStream::Ok)
+      {
+      // Truncated or corrupted: ignore the whole cache
+      return;
+      }
+    cache[executablePath] = cachedDescription;
+    }
+  this->XmlDescriptionCache = cache;
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerCLIExecutableModuleFactoryPrivate::writeXmlDescriptionCache()const
+{
+  if (this->XmlDescriptionCacheFilePath.isEmpty())
+    {
+    return;
+    }
+  QByteArray content;
+  QDataStream stream(&content, QIODevice::WriteOnly);
+  stream.setVersion(QDataStream::Qt_4_6);
+  stream << XmlDescriptionCacheMagic << XmlDescriptionCacheVersion
+         << static_cast<qint32>(this->XmlDescriptionCache.count());
+  QHash<QString, CachedXmlDescription>::const_iterator it;
+  for (it = this->XmlDescriptionCache.constBegin();
+       it != this->XmlDescriptionCache.constEnd(); ++it)
+    {
+    stream << it.key() << it.value().Size << it.value().LastModified
+           << it.value().XmlDescription;
+    }
+
+  // Write a temporary file first and rename it over the cache so that
+  // concurrent Slicer instances read either the previous or the new cache,
+  // never a partially written or a missing one.
+  QDir().mkpath(QFileInfo(this->XmlDescriptionCacheFilePath).absolutePath());
+  QString temporaryFilePath = QString("%1.%2.tmp")
+    .arg(this->XmlDescriptionCacheFilePath).arg(QCoreApplication::applicationPid());
+  QFile temporaryFile(temporaryFilePath);
+  if (!temporaryFile.open(QIODevice::WriteOnly | QIODevice::Truncate)
+      || temporaryFile.write(content) != content.size())
+    {
+    qWarning() << "Failed to write CLI XML description cache" << temporaryFilePath;
+    temporaryFile.close();
+    QFile::remove(temporaryFilePath);
+    return;
+    }
+  temporaryFile.close();
+  if (!replaceFile(temporaryFilePath, this->XmlDescriptionCacheFilePath))
+    {
+    // e.g. the cache is opened by another instance on Windows: keep the
+    // previous cache, it is updated again at the next startup.
+    qWarning() << "Failed to replace CLI XML description cache" << this->XmlDescriptionCacheFilePath;
+    QFile::remove(temporaryFilePath);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// qSlicerCLIExecutableModuleFactoryItem
+
 //-----------------------------------------------------------------------------
 qSlicerCLIExecutableModuleFactoryItem::qSlicerCLIExecutableModuleFactoryItem(
-  const QString& newTempDirectory) : TempDirectory(newTempDirectory)
+  const QString& newTempDirectory,
+  qSlicerCLIExecutableModuleFactoryPrivate* factoryPrivate)
+  : TempDirectory(newTempDirectory)
+  , CLIModule(0)
+  , FactoryPrivate(factoryPrivate)
 {
 }
 
@@ -43,8 +447,7 @@ bool qSlicerCLIExecutableModuleFactoryItem::load()
 //-----------------------------------------------------------------------------
 QString qSlicerCLIExecutableModuleFactoryItem::xmlModuleDescriptionFilePath()
 {
-  QFileInfo info = QFileInfo(this->path());
-  return QDir(info.path()).filePath(info.baseName() + ".xml");
+  return ::xmlModuleDescriptionFilePath(this->path());
 }
 
 //-----------------------------------------------------------------------------
@@ -99,80 +502,23 @@ qSlicerAbstractCoreModule* qSlicerCLIExecutableModuleFactoryItem::instanciator()
 //-----------------------------------------------------------------------------
 QString qSlicerCLIExecutableModuleFactoryItem::runCLIWithXmlArgument()
 {
-  ctkScopedCurrentDir scopedCurrentDir(QFileInfo(this->path()).path());
-
-  int cliProcessTimeoutInMs = 5000;
-  QProcess cli;
-  QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
-  env.insert("ITK_AUTOLOAD_PATH", "");
-  cli.setProcessEnvironment(env);
-  cli.start(this->path(), QStringList(QString("--xml")));
-  bool res = cli.waitForFinished(cliProcessTimeoutInMs);
-  if (!res)
+  qSlicerCLIXmlDescriptionProbe probe;
+  if (!this->FactoryPrivate
+      || !this->FactoryPrivate->probedXmlDescription(this->path(), probe))
     {
-    this->appendInstantiateErrorString(QString("CLI executable: %1").arg(this->path()));
-    QString errorString;
-    switch(cli.error())
-      {
-      case QProcess::FailedToStart:
-        errorString = QLatin1String(
-              "The process failed to start. Either the invoked program is missing, or "
-              "you may have insufficient permissions to invoke the program.");
-        break;
-      case QProcess::Crashed:
-        errorString = QLatin1String(
-              "The process crashed some time after starting successfully.");
-        break;
-      case QProcess::Timedout:
-        errorString = QString(
-              "The process timed out after %1 msecs.").arg(cliProcessTimeoutInMs);
-        break;
-      case QProcess::WriteError:
-        errorString = QLatin1String(
-              "An error occurred when attempting to read from the process. "
-              "For example, the process may not be running.");
-        break;
-      case QProcess::ReadError:
-        errorString = QLatin1String(
-              "An error occurred when attempting to read from the process. "
-              "For example, the process may not be running.");
-        break;
-      case QProcess::UnknownError:
-        errorString = QLatin1String(
-              "Failed to execute process. An unknown error occurred.");
-        break;
-      }
-    this->appendInstantiateErrorString(errorString);
-    return 0;
-    }
-  QString errors = cli.readAllStandardError();
-  if (!errors.isEmpty())
-    {
-    this->appendInstantiateErrorString(QString("CLI executable: %1").arg(this->path()));
-    this->appendInstantiateErrorString(errors);
-    // TODO: More investigation for the following behavior:
-    // on my machine (Ubuntu 10.04 with ITKv4), having standard error trims the
-    // standard output results. The following readAllStandardOutput() is then
-    // missing chars and makes the XML invalid. I'm not sure if it's just on my
-    // machine so there is a chance it succeeds to parse the XML description
-    // on other machines.
+    QProcess cli;
+    startXmlDescriptionProbe(cli, this->path());
+    finishXmlDescriptionProbe(cli, this->path(), probe);
     }
-  QString xmlDescription = cli.readAllStandardOutput();
-  if (xmlDescription.isEmpty())
+  foreach(const QString& error, probe.Errors)
     {
-    this->appendInstantiateErrorString(QString("CLI executable: %1").arg(this->path()));
-    this->appendInstantiateErrorString("Failed to retrieve Xml Description");
-    return QString();
+    this->appendInstantiateErrorString(error);
     }
-  if (!xmlDescription.startsWith("<?xml"))
+  foreach(const QString& warning, probe.Warnings)
     {
-    this->appendInstantiateWarningString(QString("CLI executable: %1").arg(this->path()));
-    this->appendInstantiateWarningString(QLatin1String("XML description doesn't start right away."));
-    this->appendInstantiateWarningString(QString("Output before '<?xml' is [%1]").arg(
-                                           xmlDescription.mid(0, xmlDescription.indexOf("<?xml"))));
-    xmlDescription.remove(0, xmlDescription.indexOf("<?xml"));
+    this->appendInstantiateWarningString(warning);
     }
-  return xmlDescription;
+  return probe.XmlDescription;
 }
 
 //-----------------------------------------------------------------------------
@@ -182,30 +528,6 @@ void qSlicerCLIExecutableModuleFactoryItem::uninstantiate()
   this->ctkAbstractFactoryFileBasedItem<qSlicerAbstractCoreModule>::uninstantiate();
 }
 
-//-----------------------------------------------------------------------------
-// qSlicerCLIExecutableModuleFactoryPrivate
-
-//-----------------------------------------------------------------------------
-class qSlicerCLIExecutableModuleFactoryPrivate
-{
-  Q_DECLARE_PUBLIC(qSlicerCLIExecutableModuleFactory);
-protected:
-  qSlicerCLIExecutableModuleFactory* const q_ptr;
-public:
-  typedef qSlicerCLIExecutableModuleFactoryPrivate Self;
-  qSlicerCLIExecutableModuleFactoryPrivate(qSlicerCLIExecutableModuleFactory& object);
-
-private:
-  QString TempDirectory;
-};
-
-//-----------------------------------------------------------------------------
-qSlicerCLIExecutableModuleFactoryPrivate::qSlicerCLIExecutableModuleFactoryPrivate(qSlicerCLIExecutableModuleFactory& object)
-:q_ptr(&object)
-{
-  this->TempDirectory = QDir::tempPath();
-}
-
 //-----------------------------------------------------------------------------
 // qSlicerCLIExecutableModuleFactory
 
@@ -246,7 +568,7 @@ ctkAbstractFactoryItem<qSlicerAbstractCoreModule>* qSlicerCLIExecutableModuleFac
 ::createFactoryFileBasedItem()
 {
   Q_D(qSlicerCLIExecutableModuleFactory);
-  return new qSlicerCLIExecutableModuleFactoryItem(d->TempDirectory);
+  return new qSlicerCLIExecutableModuleFactoryItem(d->TempDirectory, d);
 }
 
 //-----------------------------------------------------------------------------
@@ -261,3 +583,17 @@ void qSlicerCLIExecutableModuleFactory::setTempDirectory(const QString& newTempD
   Q_D(qSlicerCLIExecutableModuleFactory);
   d->TempDirectory = newTempDirectory;
 }
+
+//-----------------------------------------------------------------------------
+void qSlicerCLIExecutableModuleFactory::setXmlDescriptionCacheFilePath(const QString& filePath)
+{
+  Q_D(qSlicerCLIExecutableModuleFactory);
+  d->XmlDescriptionCacheFilePath = filePath;
+}
+
+//-----------------------------------------------------------------------------
+QString qSlicerCLIExecutableModuleFactory::xmlDescriptionCacheFilePath()const
+{
+  Q_D(const qSlicerCLIExecutableModuleFactory);
+  return d->XmlDescriptionCacheFilePath;
+}
@@ -25,6 +25,7 @@
 #include "qSlicerAbstractCoreModule.h"
 #include "qSlicerBaseQTCLIExport.h"
 class qSlicerCLIModule;
+class qSlicerCLIExecutableModuleFactoryPrivate;
 
 // CTK includes
 #include <ctkPimpl.h>
@@ -35,7 +36,8 @@ class qSlicerCLIExecutableModuleFactoryItem
   : public ctkAbstractFactoryFileBasedItem<qSlicerAbstractCoreModule>
 {
 public:
-  qSlicerCLIExecutableModuleFactoryItem(const QString& newTempDirectory);
+  qSlicerCLIExecutableModuleFactoryItem(const QString& newTempDirectory,
+    qSlicerCLIExecutableModuleFactoryPrivate* factoryPrivate = 0);
   virtual bool load();
   virtual void uninstantiate();
 protected:
@@ -47,10 +49,11 @@ protected:
 private:
   QString TempDirectory;
   qSlicerCLIModule* CLIModule;
+  /// Factory the item has been created by. Used to retrieve the XML
+  /// descriptions probed for all the items at once.
+  qSlicerCLIExecutableModuleFactoryPrivate* FactoryPrivate;
 };
 
-class qSlicerCLIExecutableModuleFactoryPrivate;
-
 //-----------------------------------------------------------------------------
 class Q_SLICER_BASE_QTCLI_EXPORT qSlicerCLIExecutableModuleFactory :
   public ctkAbstractFileBasedFactory<qSlicerAbstractCoreModule>
@@ -71,6 +74,15 @@ public:
 
   void setTempDirectory(const QString& newTempDirectory);
 
+  /// Set the file where the XML descriptions of the executables are cached
+  /// between sessions. An entry is reused as long as the size and the last
+  /// modification time of its executable are unchanged; the stale and missing
+  /// entries are obtained by running the executables with "--xml", several of
+  /// them at a time.
+  /// Empty by default: no cache is used.
+  void setXmlDescriptionCacheFilePath(const QString& filePath);
+  QString xmlDescriptionCacheFilePath()const;
+
 protected:
   virtual bool isValidFile(const QFileInfo& file)const;
 
@@ -17,6 +17,9 @@
 // SlicerExecutionModel includes
 #include <ModuleDescription.h>
 
+// MRMLIDImageIO includes
+#include <itkMRMLSharedMemoryImageIO.h>
+
 // MRML includes
 #include <vtkEventBroker.h>
 #include <vtkMRMLColorNode.h>
@@ -31,16 +34,24 @@
 #include <vtkMRMLModelStorageNode.h>
 #include <vtkMRMLTransformNode.h>
 #include <vtkMRMLSubjectHierarchyNode.h>
+#include <vtkMRMLVolumeNode.h>
 
 // VTK includes
 #include <vtkCallbackCommand.h>
+#include <vtkImageData.h>
 #include <vtkIntArray.h>
 #include <vtkMultiThreader.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
 #include <vtkStringArray.h>
 #include <vtksys/SystemTools.hxx>
 
+// ITK includes
+#include <itkMutexLockHolder.h>
+#include <itkSimpleFastMutexLock.h>
+
 // ITKSYS includes
 #include <itksys/Process.h>
 #include <itksys/SystemTools.hxx>
@@ -57,6 +68,7 @@
 #include <algorithm>
 #include <cassert>
 #include <ctime>
+#include <fstream>
 #include <set>
 
 #ifdef _WIN32
@@ -82,6 +94,228 @@ struct DigitsToCharacters
 typedef std::pair<vtkSlicerCLIModuleLogic *, vtkMRMLCommandLineModuleNode *> LogicNodePair;
 class MRMLIDMap : public std::map<std::string, std::string> {};
 
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Modules are run by several threads of the application logic. Standard streams
+// and environment variables are shared by the whole process: shared object modules
+// (that redirect std::cout and std::cerr) and the change of ITK_AUTOLOAD_PATH when
+// an executable module is started must not run concurrently. Executable modules
+// still run in parallel once their process is started.
+itk::SimpleFastMutexLock ProcessStateLock;
+
+//----------------------------------------------------------------------------
+// Volumes that can be exchanged with executable CLIs through shared memory.
+// Diffusion volumes need their measurement frame and gradients, they are
+// still written to files.
+bool IsSharedMemoryTransferPossible(vtkMRMLNode* node)
+{
+  if (!node)
+    {
+    return false;
+    }
+  std::string className = node->GetClassName();
+  return className == "vtkMRMLScalarVolumeNode"
+    || className == "vtkMRMLLabelMapVolumeNode"
+    || className == "vtkMRMLVectorVolumeNode";
+}
+
+//----------------------------------------------------------------------------
+int VTKScalarTypeToITKComponentType(int scalarType)
+{
+  switch (scalarType)
+    {
+    case VTK_FLOAT: return itk::ImageIOBase::FLOAT;
+    case VTK_DOUBLE: return itk::ImageIOBase::DOUBLE;
+    case VTK_INT: return itk::ImageIOBase::INT;
+    case VTK_UNSIGNED_INT: return itk::ImageIOBase::UINT;
+    case VTK_SHORT: return itk::ImageIOBase::SHORT;
+    case VTK_UNSIGNED_SHORT: return itk::ImageIOBase::USHORT;
+    case VTK_LONG: return itk::ImageIOBase::LONG;
+    case VTK_UNSIGNED_LONG: return itk::ImageIOBase::ULONG;
+    case VTK_CHAR: return itk::ImageIOBase::CHAR;
+    case VTK_SIGNED_CHAR: return itk::ImageIOBase::CHAR;
+    case VTK_UNSIGNED_CHAR: return itk::ImageIOBase::UCHAR;
+    default: return itk::ImageIOBase::UNKNOWNCOMPONENTTYPE;
+    }
+}
+
+//----------------------------------------------------------------------------
+int ITKComponentTypeToVTKScalarType(int componentType)
+{
+  switch (componentType)
+    {
+    case itk::ImageIOBase::FLOAT: return VTK_FLOAT;
+    case itk::ImageIOBase::DOUBLE: return VTK_DOUBLE;
+    case itk::ImageIOBase::INT: return VTK_INT;
+    case itk::ImageIOBase::UINT: return VTK_UNSIGNED_INT;
+    case itk::ImageIOBase::SHORT: return VTK_SHORT;
+    case itk::ImageIOBase::USHORT: return VTK_UNSIGNED_SHORT;
+    case itk::ImageIOBase::LONG: return VTK_LONG;
+    case itk::ImageIOBase::ULONG: return VTK_UNSIGNED_LONG;
+    case itk::ImageIOBase::CHAR: return VTK_CHAR;
+    case itk::ImageIOBase::UCHAR: return VTK_UNSIGNED_CHAR;
+    default: return VTK_VOID;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Return a number that is hard to guess, used in the name of the shared
+// memory segments.
+unsigned int GetRandomNumber()
+{
+  unsigned int value = 0;
+#ifndef _WIN32
+  std::ifstream urandom("/dev/urandom", std::ios::in | std::ios::binary);
+  if (urandom.read(reinterpret_cast<char*>(&value), sizeof(value)))
+    {
+    return value;
+    }
+#endif
+  return static_cast<unsigned int>(time(NULL)) ^ (static_cast<unsigned int>(clock()) << 16);
+}
+
+//----------------------------------------------------------------------------
+/// Remove the shared memory segments exchanged with a CLI when the execution
+/// of the CLI ends, whether it succeeded or not.
+class SharedMemorySegmentsRemover
+{
+public:
+  SharedMemorySegmentsRemover(const std::set<std::string>& fileNames)
+    : FileNames(fileNames)
+  {
+  }
+  ~SharedMemorySegmentsRemover()
+  {
+    std::set<std::string>::const_iterator it;
+    for (it = this->FileNames.begin(); it != this->FileNames.end(); ++it)
+      {
+      // Output segments are missing if the CLI failed before writing them
+      itk::MRMLSharedMemoryImageIO::RemoveSegment(it->c_str());
+      }
+  }
+private:
+  const std::set<std::string>& FileNames;
+};
+
+//----------------------------------------------------------------------------
+// Copy the image of a volume node into a new shared memory segment.
+// The geometry is converted from RAS to LPS.
+bool WriteVolumeToSharedMemory(vtkMRMLVolumeNode* volumeNode, const std::string& fileName)
+{
+  vtkImageData* imageData = volumeNode ? volumeNode->GetImageData() : NULL;
+  if (!imageData || !imageData->GetPointData()->GetScalars())
+    {
+    return false;
+    }
+
+  itk::MRMLSharedMemoryImageHeader header;
+  itk::MRMLSharedMemoryImageIO::InitializeHeader(header);
+  header.ComponentType = VTKScalarTypeToITKComponentType(imageData->GetScalarType());
+  if (header.ComponentType == itk::ImageIOBase::UNKNOWNCOMPONENTTYPE)
+    {
+    return false;
+    }
+  header.NumberOfComponents = imageData->GetNumberOfScalarComponents();
+
+  int dimensions[3] = { 0, 0, 0 };
+  imageData->GetDimensions(dimensions);
+  double directions[3][3];
+  volumeNode->GetIJKToRASDirections(directions);
+  double* spacing = volumeNode->GetSpacing();
+  double* origin = volumeNode->GetOrigin();
+  unsigned long long numberOfVoxels = 1;
+  for (int i = 0; i < 3; ++i)
+    {
+    double rasToLps = (i < 2 ? -1.0 : 1.0);
+    header.Dimensions[i] = dimensions[i];
+    header.Spacing[i] = spacing[i];
+    header.Origin[i] = rasToLps * origin[i];
+    for (int j = 0; j < 3; ++j)
+      {
+      header.Direction[i][j] = rasToLps * directions[i][j];
+      }
+    numberOfVoxels *= dimensions[i];
+    }
+  header.DataSize = numberOfVoxels * header.NumberOfComponents * imageData->GetScalarSize();
+
+  void* data = itk::MRMLSharedMemoryImageIO::CreateSegment(fileName.c_str(), header);
+  if (!data)
+    {
+    return false;
+    }
+  // The image of the node is not allocated in shared memory, the module
+  // process can only access a copy of it.
+  memcpy(data, imageData->GetScalarPointer(), static_cast<size_t>(header.DataSize));
+  itk::MRMLSharedMemoryImageIO::ReleaseSegment(data);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Replace the image of a volume node by the content of a shared memory
+// segment written by a CLI.
+bool ReadVolumeFromSharedMemory(vtkMRMLVolumeNode* volumeNode, const std::string& fileName)
+{
+  if (!volumeNode)
+    {
+    return false;
+    }
+  itk::MRMLSharedMemoryImageHeader header;
+  const void* data = itk::MRMLSharedMemoryImageIO::OpenSegment(fileName.c_str(), header);
+  if (!data)
+    {
+    return false;
+    }
+  int scalarType = ITKComponentTypeToVTKScalarType(header.ComponentType);
+  if (scalarType == VTK_VOID || header.NumberOfComponents == 0)
+    {
+    itk::MRMLSharedMemoryImageIO::ReleaseSegment(data);
+    return false;
+    }
+
+  vtkSmartPointer<vtkImageData> imageData = vtkSmartPointer<vtkImageData>::New();
+  imageData->SetDimensions(static_cast<int>(header.Dimensions[0]),
+                           static_cast<int>(header.Dimensions[1]),
+                           static_cast<int>(header.Dimensions[2]));
+  imageData->AllocateScalars(scalarType, header.NumberOfComponents);
+  unsigned long long dataSize = static_cast<unsigned long long>(imageData->GetNumberOfPoints())
+    * header.NumberOfComponents * imageData->GetScalarSize();
+  if (dataSize != header.DataSize)
+    {
+    itk::MRMLSharedMemoryImageIO::ReleaseSegment(data);
+    return false;
+    }
+  // The segment is removed as soon as the module execution ends, while the
+  // image of the node may be used much longer: copy the voxels.
+  memcpy(imageData->GetScalarPointer(), data, static_cast<size_t>(dataSize));
+  itk::MRMLSharedMemoryImageIO::ReleaseSegment(data);
+
+  double spacing[3];
+  double origin[3];
+  double directions[3][3];
+  for (int i = 0; i < 3; ++i)
+    {
+    double lpsToRas = (i < 2 ? -1.0 : 1.0);
+    spacing[i] = header.Spacing[i];
+    origin[i] = lpsToRas * header.Origin[i];
+    for (int j = 0; j < 3; ++j)
+      {
+      directions[i][j] = lpsToRas * header.Direction[i][j];
+      }
+    }
+
+  int wasModifying = volumeNode->StartModify();
+  volumeNode->SetSpacing(spacing);
+  volumeNode->SetOrigin(origin);
+  volumeNode->SetIJKToRASDirections(directions);
+  volumeNode->SetAndObserveImageData(imageData);
+  volumeNode->EndModify(wasModifying);
+  return true;
+}
+
+} // end of anonymous namespace
+
 //---------------------------------------------------------------------------
 class vtkSlicerCLIRescheduleCallback : public vtkCallbackCommand
 {
@@ -135,7 +369,9 @@ public:
       }
     else
       {
-      std::remove(this->ThreadIDs.begin(), this->ThreadIDs.end(), id);
+      this->ThreadIDs.erase(
+        std::remove(this->ThreadIDs.begin(), this->ThreadIDs.end(), id),
+        this->ThreadIDs.end());
       }
   }
 protected:
@@ -325,8 +561,37 @@ public:
   int DeleteTemporaryFiles;
 
   int RedirectModuleStreams;
+  int SharedMemoryDataExchange;
 
   itk::MutexLock::Pointer ProcessesKillLock;
+
+  /// Number of shared memory segments created by this logic, used to give
+  /// each segment a unique name.
+  itk::MutexLock::Pointer SharedMemorySegmentCountLock;
+  unsigned int SharedMemorySegmentCount;
+
+  /// Return a unique "shm:" filename for an image exchanged with an
+  /// executable CLI.
+  std::string ConstructSharedMemoryFileName()
+  {
+    this->SharedMemorySegmentCountLock->Lock();
+    unsigned int segmentIndex = this->SharedMemorySegmentCount++;
+    this->SharedMemorySegmentCountLock->Unlock();
+
+    // POSIX segment names are short on some platforms (31 characters on
+    // Mac OS X), do not include the node ID.
+    std::ostringstream fileName;
+    fileName << "shm:/slicer-";
+#ifdef _WIN32
+    fileName << GetCurrentProcessId();
+#else
+    fileName << getpid();
+#endif
+    // Random suffix: other users cannot guess the name and create the
+    // segment before Slicer or the module does.
+    fileName << "-" << segmentIndex << "-" << std::hex << GetRandomNumber();
+    return fileName.str();
+  }
   std::vector<itksysProcess*> Processes;
 
   typedef std::vector<std::pair<int, vtkMRMLCommandLineModuleNode*> > RequestType;
@@ -423,8 +688,11 @@ vtkSlicerCLIModuleLogic::vtkSlicerCLIModuleLogic()
   this->Internal = new vtkInternal();
 
   this->Internal->ProcessesKillLock = itk::MutexLock::New();
+  this->Internal->SharedMemorySegmentCountLock = itk::MutexLock::New();
+  this->Internal->SharedMemorySegmentCount = 0;
   this->Internal->DeleteTemporaryFiles = 1;
   this->Internal->RedirectModuleStreams = 1;
+  this->Internal->SharedMemoryDataExchange = 0;
   this->Internal->RescheduleCallback =
     vtkSmartPointer<vtkSlicerCLIRescheduleCallback>::New();
   this->Internal->RescheduleCallback->SetCLIModuleLogic(this);
@@ -447,6 +715,8 @@ vtkSlicerCLIModuleLogic::~vtkSlicerCLIModuleLogic()
 void vtkSlicerCLIModuleLogic::PrintSelf(ostream& os, vtkIndent indent)
 {
   Superclass::PrintSelf(os, indent);
+  os << indent << "SharedMemoryDataExchange: "
+     << this->Internal->SharedMemoryDataExchange << "\n";
 }
 
 //-----------------------------------------------------------------------------
@@ -540,6 +810,35 @@ int vtkSlicerCLIModuleLogic::GetRedirectModuleStreams() const
   return this->Internal->RedirectModuleStreams;
 }
 
+//----------------------------------------------------------------------------
+void vtkSlicerCLIModuleLogic::SharedMemoryDataExchangeOn()
+{
+  this->SetSharedMemoryDataExchange(static_cast<int>(1));
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCLIModuleLogic::SharedMemoryDataExchangeOff()
+{
+  this->SetSharedMemoryDataExchange(static_cast<int>(0));
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCLIModuleLogic::SetSharedMemoryDataExchange(int value)
+{
+  vtkDebugMacro(<< this->GetClassName() << " (" << this << "): setting SharedMemoryDataExchange to " << value);
+  if (this->Internal->SharedMemoryDataExchange != value)
+    {
+    this->Internal->SharedMemoryDataExchange = value;
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerCLIModuleLogic::GetSharedMemoryDataExchange() const
+{
+  return this->Internal->SharedMemoryDataExchange;
+}
+
 //----------------------------------------------------------------------------
 std::string
 vtkSlicerCLIModuleLogic
@@ -1018,6 +1317,33 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
   // vector of files to delete
   std::set<std::string> filesToDelete;
 
+  // Images of executable modules are exchanged through shared memory
+  // segments if the ITK plugin that reads and writes them is available.
+  std::string sharedMemoryPluginPath;
+  if (commandType == CommandLineModule
+      && this->Internal->SharedMemoryDataExchange
+      && itk::MRMLSharedMemoryImageIO::IsSharedMemorySupported())
+    {
+    std::string itkFactoriesPath;
+    itksys::SystemTools::GetEnv("ITK_AUTOLOAD_PATH", itkFactoriesPath);
+    std::string pluginPath =
+      itkFactoriesPath + "/" + MRMLSharedMemoryIO_ITKFACTORIES_SUBDIR;
+    if (!itkFactoriesPath.empty()
+        && itksys::SystemTools::FileIsDirectory(pluginPath.c_str()))
+      {
+      sharedMemoryPluginPath = pluginPath;
+      }
+    }
+
+  // shared memory segments exchanged with the module, and the temporary
+  // files to use instead if an input segment cannot be created
+  std::set<std::string> sharedMemorySegments;
+  MRMLIDToFileNameMap sharedMemoryFallbackFiles;
+  // Shared memory segments are not temporary files: they are always
+  // removed, even on error, as they would otherwise use memory until reboot.
+  // The content of the output segments is copied in the nodes.
+  SharedMemorySegmentsRemover sharedMemorySegmentsRemover(sharedMemorySegments);
+
   // iterators for parameter groups
   std::vector<ModuleParameterGroup>::iterator pgbeginit
     = node0->GetModuleDescription().GetParameterGroups().begin();
@@ -1067,7 +1393,19 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
                                              (*pit).GetFileExtensions(),
                                              commandType);
 
-        filesToDelete.insert(fname);
+        if (!sharedMemoryPluginPath.empty() && (*pit).GetTag() == "image"
+            && (*pit).GetType() != "dynamic-contrast-enhanced"
+            && IsSharedMemoryTransferPossible(
+                 this->GetMRMLScene()->GetNodeByID(id.c_str())))
+          {
+          sharedMemoryFallbackFiles[id] = fname;
+          fname = this->Internal->ConstructSharedMemoryFileName();
+          sharedMemorySegments.insert(fname);
+          }
+        else
+          {
+          filesToDelete.insert(fname);
+          }
         if ((*pit).GetChannel() == "input")
           {
           nodesToWrite[id] = fname;
@@ -1215,6 +1553,25 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
         }
       }
 
+    // Images exchanged through shared memory are copied in their
+    // segment. Fall back to a temporary file if it cannot be created.
+    if (sharedMemorySegments.find((*id2fn0).second) != sharedMemorySegments.end())
+      {
+      if (WriteVolumeToSharedMemory(vtkMRMLVolumeNode::SafeDownCast(nd), (*id2fn0).second))
+        {
+        out = 0;
+        }
+      else
+        {
+        vtkWarningMacro("Unable to create shared memory segment "
+                        << (*id2fn0).second << " for " << nd->GetID()
+                        << ", using a temporary file instead.");
+        sharedMemorySegments.erase((*id2fn0).second);
+        nodesToWrite[(*id2fn0).first] = sharedMemoryFallbackFiles[(*id2fn0).first];
+        filesToDelete.insert((*id2fn0).second);
+        }
+      }
+
     // if the file is to be written, then write it
     if (out)
       {
@@ -1922,6 +2279,9 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
     //
     //
 
+    // The environment is restored as soon as the process is started
+    ProcessStateLock.Lock();
+
     // Unset ITK_AUTOLOAD_PATH environment variable to prevent the CLI from
     // loading the itkMRMLIDIOPlugin plugin because executable CLIs read images
     // from file and not from shared memory. Worst the plugin in the CLI
@@ -1929,9 +2289,15 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
     // statically linked to the executable.
     // Historically, there was an nvidia driver bug that causes the module
     // to fail on exit with undefined symbol.
+    // If images are exchanged through shared memory segments, only the
+    // shared memory plugin (that depends on ITK only) is made available.
      std::string saveITKAutoLoadPath;
      itksys::SystemTools::GetEnv("ITK_AUTOLOAD_PATH", saveITKAutoLoadPath);
      std::string emptyString("ITK_AUTOLOAD_PATH=");
+     if (!sharedMemorySegments.empty())
+       {
+       emptyString += sharedMemoryPluginPath;
+       }
      int putSuccess =
        itksys::SystemTools::PutEnv(const_cast <char *> (emptyString.c_str()));
      if (!putSuccess)
@@ -1943,7 +2309,9 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
     //
     itksysProcess *process = itksysProcess_New();
 
+    this->Internal->ProcessesKillLock->Lock();
     this->Internal->Processes.push_back(process);
+    this->Internal->ProcessesKillLock->Unlock();
 
     // setup the command
     itksysProcess_SetCommand(process, command);
@@ -1965,6 +2333,7 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
       {
       vtkErrorMacro( "Unable to restore ITK_AUTOLOAD_PATH. ");
       }
+    ProcessStateLock.Unlock();
 
     // Wait for the command to finish
     char *tbuffer;
@@ -1990,9 +2359,11 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
       // Check to see if the plugin was cancelled
       if (node0->GetModuleDescription().GetProcessInformation()->Abort)
         {
+        this->Internal->ProcessesKillLock->Lock();
         itksysProcess_Kill(process);
         this->Internal->Processes.erase(
               std::find(this->Internal->Processes.begin(), this->Internal->Processes.end(), process));
+        this->Internal->ProcessesKillLock->Unlock();
         node0->GetModuleDescription().GetProcessInformation()->Progress = 0;
         node0->GetModuleDescription().GetProcessInformation()->StageProgress =0;
         this->GetApplicationLogic()->RequestModified( node0 );
@@ -2246,6 +2617,10 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
     //
     //
 
+    // Shared object modules use the standard streams and the global state of
+    // the libraries of the application, they are run one at a time.
+    itk::MutexLockHolder<itk::SimpleFastMutexLock> processStateLockHolder(ProcessStateLock);
+
     std::ostringstream coutstringstream;
     std::ostringstream cerrstringstream;
     std::streambuf* origcoutrdbuf = std::cout.rdbuf();
@@ -2476,6 +2851,30 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
         }
 
         bool deleteFile = this->GetDeleteTemporaryFiles();
+        if (sharedMemorySegments.find((*id2fn0).second) != sharedMemorySegments.end())
+          {
+          // The image was written by the module in a shared memory segment:
+          // import it directly in the node, the same way shared object
+          // modules do through itkMRMLIDImageIO, and let the application
+          // logic only update the display. Node events are invoked from the
+          // main thread.
+          vtkMRMLVolumeNode* volumeNode = vtkMRMLVolumeNode::SafeDownCast(
+            this->GetMRMLScene()->GetNodeByID((*id2fn0).first));
+          if (volumeNode)
+            {
+            this->Internal->StartRescheduleNodeEvents(volumeNode);
+            this->Internal->RescheduleCallback->RescheduleEventsFromThreadID(
+              vtkMultiThreader::GetCurrentThreadID(), true);
+            if (!ReadVolumeFromSharedMemory(volumeNode, (*id2fn0).second))
+              {
+              vtkErrorMacro("ERROR reading shared memory segment " << (*id2fn0).second);
+              }
+            this->Internal->RescheduleCallback->RescheduleEventsFromThreadID(
+              vtkMultiThreader::GetCurrentThreadID(), false);
+            this->Internal->StopRescheduleNodeEvents(volumeNode);
+            }
+          deleteFile = false;
+          }
         int requestUID = this->GetApplicationLogic()
           ->RequestReadData((*id2fn0).first.c_str(), (*id2fn0).second.c_str(),
                             displayData, deleteFile);
@@ -82,6 +82,17 @@ public:
   void SetRedirectModuleStreams(int value);
   int GetRedirectModuleStreams() const;
 
+  /// Exchange the scalar, label map and vector volumes of executable CLIs
+  /// through shared memory segments instead of temporary files.
+  /// Temporary files are still used on platforms without POSIX shared
+  /// memory, when the shared memory ITK plugin is not found or when a
+  /// segment cannot be created.
+  /// Off by default: the CLI must read its images with ITK.
+  virtual void SharedMemoryDataExchangeOn();
+  virtual void SharedMemoryDataExchangeOff();
+  void SetSharedMemoryDataExchange(int value);
+  int GetSharedMemoryDataExchange() const;
+
   /// Schedules the command line module to run.
   /// The CLI is scheduled to be run in a separate thread. This methods
   /// is non blocking and returns immediately.
@@ -20,6 +20,7 @@
 
 // Qt includes
 #include <QDir>
+#include <QElapsedTimer>
 
 // SlicerQt includes
 #include "qSlicerCoreApplication.h"
@@ -60,6 +61,21 @@ public:
   QMap<QString, qSlicerModuleFactory*> RegisteredModules;
   QMap<QString, QStringList> ModuleDependees;
 
+  /// Add the time elapsed since the last call to resetElapsedTime() or
+  /// addElapsedTime() to the time spent by \a factory.
+  /// Callers reset before the work they measure, so time spent outside of
+  /// the factories is not attributed to any of them.
+  void addElapsedTime(QMap<qSlicerModuleFactory*, qint64>& times,
+                      qSlicerModuleFactory* factory);
+  /// Restart the accumulation of elapsed time
+  void resetElapsedTime();
+
+  QElapsedTimer Timer;
+  qint64 LastElapsedTime;
+  /// Time in ms spent by each factory to register and instantiate modules
+  QMap<qSlicerModuleFactory*, qint64> RegistrationTimes;
+  QMap<qSlicerModuleFactory*, qint64> InstantiationTimes;
+
   bool Verbose;
 };
 
@@ -69,6 +85,23 @@ qSlicerAbstractModuleFactoryManagerPrivate::qSlicerAbstractModuleFactoryManagerP
   : q_ptr(&object)
 {
   this->Verbose = false;
+  this->Timer.start();
+  this->LastElapsedTime = 0;
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerAbstractModuleFactoryManagerPrivate::addElapsedTime(
+  QMap<qSlicerModuleFactory*, qint64>& times, qSlicerModuleFactory* factory)
+{
+  qint64 elapsedTime = this->Timer.elapsed();
+  times[factory] += elapsedTime - this->LastElapsedTime;
+  this->LastElapsedTime = elapsedTime;
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerAbstractModuleFactoryManagerPrivate::resetElapsedTime()
+{
+  this->LastElapsedTime = this->Timer.elapsed();
 }
 
 //-----------------------------------------------------------------------------
@@ -87,6 +120,7 @@ void qSlicerAbstractModuleFactoryManagerPrivate::printAdditionalInfo()
   qDebug() << "Registered modules:" << q->registeredModuleNames();
   qDebug() << "Ignored modules:" << q->ignoredModuleNames();
   qDebug() << "Instantiated modules:" << q->instantiatedModuleNames();
+  q->printFactoryTimings();
 }
 
 //-----------------------------------------------------------------------------
@@ -172,6 +206,8 @@ void qSlicerAbstractModuleFactoryManager::unregisterFactory(qSlicerModuleFactory
   Q_D(qSlicerAbstractModuleFactoryManager);
   Q_ASSERT(d->Factories.contains(factory));
   d->Factories.remove(factory);
+  d->RegistrationTimes.remove(factory);
+  d->InstantiationTimes.remove(factory);
   delete factory;
 }
 
@@ -254,7 +290,9 @@ void qSlicerAbstractModuleFactoryManager::registerModules()
   // \todo: don't support factories other than filebased factories
   foreach(qSlicerModuleFactory* factory, d->notFileBasedFactories())
     {
+    d->resetElapsedTime();
     factory->registerItems();
+    d->addElapsedTime(d->RegistrationTimes, factory);
     foreach(const QString& moduleName, factory->itemKeys())
       {
       if (d->Verbose)
@@ -301,7 +339,10 @@ void qSlicerAbstractModuleFactoryManager::registerModule(const QFileInfo& file)
       {
       qDebug() << " checking file: " << file.absoluteFilePath() << " as a " << typeid(*factory).name();
       }
-    if (!factory->isValidFile(file))
+    d->resetElapsedTime();
+    bool validFile = factory->isValidFile(file);
+    d->addElapsedTime(d->RegistrationTimes, factory);
+    if (!validFile)
       {
       continue;
       }
@@ -348,7 +389,9 @@ void qSlicerAbstractModuleFactoryManager::registerModule(const QFileInfo& file)
     emit moduleIgnored(moduleName);
     return;
     }
+  d->resetElapsedTime();
   QString registeredModuleName = moduleFactory->registerFileItem(file);
+  d->addElapsedTime(d->RegistrationTimes, moduleFactory);
   if (registeredModuleName != moduleName)
     {
     //qDebug() << "Ignore module" << moduleName;
@@ -386,6 +429,11 @@ void qSlicerAbstractModuleFactoryManager::instantiateModules()
   signal(SIGINT, SIG_DFL);
   #endif
 
+  if (d->Verbose)
+    {
+    this->printFactoryTimings();
+    }
+
   emit this->modulesInstantiated(this->instantiatedModuleNames());
 }
 
@@ -400,7 +448,9 @@ qSlicerAbstractCoreModule* qSlicerAbstractModuleFactoryManager
     qCritical() << "Fail to instantiate module " << moduleName << " (not registered)";
     return 0;
     }
+  d->resetElapsedTime();
   qSlicerAbstractCoreModule* module = factory->instantiate(moduleName);
+  d->addElapsedTime(d->InstantiationTimes, factory);
   if (!module)
     {
     qCritical() << "Fail to instantiate module " << moduleName;
@@ -424,6 +474,25 @@ qSlicerAbstractCoreModule* qSlicerAbstractModuleFactoryManager
   return module;
 }
 
+//-----------------------------------------------------------------------------
+void qSlicerAbstractModuleFactoryManager::printFactoryTimings()const
+{
+  Q_D(const qSlicerAbstractModuleFactoryManager);
+  qDebug() << "Module factory timings:";
+  qint64 totalTime = 0;
+  foreach(qSlicerModuleFactory* factory, d->Factories.keys())
+    {
+    qint64 registrationTime = d->RegistrationTimes.value(factory);
+    qint64 instantiationTime = d->InstantiationTimes.value(factory);
+    totalTime += registrationTime + instantiationTime;
+    qDebug() << "\t" << typeid(*factory).name() << ":"
+             << factory->itemKeys().count() << "modules,"
+             << "registration:" << registrationTime << "ms,"
+             << "instantiation:" << instantiationTime << "ms";
+    }
+  qDebug() << "\tTotal:" << totalTime << "ms";
+}
+
 //-----------------------------------------------------------------------------
 QStringList qSlicerAbstractModuleFactoryManager::registeredModuleNames() const
 {
@@ -96,6 +96,13 @@ public:
   /// Print internal state using qDebug()
   virtual void printAdditionalInfo();
 
+  /// Print, for each factory, the number of registered modules and the time
+  /// spent registering and instantiating them.
+  /// Automatically printed by instantiateModules() if verbose module
+  /// discovery is enabled.
+  /// \sa setVerboseModuleDiscovery()
+  void printFactoryTimings()const;
+
   /// \brief Register a \a factory
   /// The factory will be deleted when unregistered
   /// (e.g. in ~qSlicerAbstractModuleFactoryManager())
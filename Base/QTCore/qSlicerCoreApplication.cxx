@@ -92,6 +92,9 @@
 #endif
 #include <vtkMRMLScene.h>
 
+// vtkITK includes
+#include <vtkITKArchetypeImageSeriesReader.h>
+
 // VTK includes
 #include <vtkNew.h>
 #include <vtksys/SystemTools.hxx>
@@ -369,6 +372,16 @@ void qSlicerCoreApplicationPrivate::initDataIO()
   this->DataIOManagerLogic->SetMRMLApplicationLogic(this->AppLogic);
   this->DataIOManagerLogic->SetAndObserveDataIOManager(
     this->MRMLRemoteIOLogic->GetDataIOManager());
+
+  // Keep the headers used to group DICOM files next to the settings so
+  // that a study loaded again in a later session is not parsed again.
+  if (q->userSettings()->value("Volumes/CacheDICOMHeaders", true).toBool())
+    {
+    QFileInfo revisionUserSettingsFileInfo(q->revisionUserSettings()->fileName());
+    vtkITKArchetypeImageSeriesReader::SetDICOMHeaderCacheFileName(
+      revisionUserSettingsFileInfo.dir().filePath(
+        revisionUserSettingsFileInfo.completeBaseName() + "-DICOMHeaders.cache").toLocal8Bit());
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -157,6 +157,12 @@ bool qSlicerNodeWriter::write(const qSlicerIO::IOProperties& properties)
     {
     snode->SetUseCompression(properties["useCompression"].toInt());
     }
+  if (properties.value("deferWrite", false).toBool())
+    {
+    // The caller writes the data, e.g. with vtkMRMLScene::WriteStorableNodes()
+    this->setWrittenNodes(QStringList() << node->GetID());
+    return true;
+    }
   bool res = snode->WriteData(node);
 
   if (res)
@@ -60,6 +60,9 @@ public:
 
   /// Write the node referenced by "nodeID" into the "fileName" file.
   /// Optionally, "useCompression" can be specified.
+  /// If "deferWrite" is true, the storage node is only set up and the data
+  /// is left to be written by the caller (see
+  /// vtkMRMLScene::WriteStorableNodes()).
   /// Return true on success, false otherwise.
   /// Create a storage node if the storable node doesn't have any.
   virtual bool write(const qSlicerIO::IOProperties& properties);
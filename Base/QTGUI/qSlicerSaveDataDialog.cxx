@@ -36,6 +36,7 @@
 #include "qSlicerApplication.h"
 #include "qSlicerCoreIOManager.h"
 #include "qSlicerFileWriterOptionsWidget.h"
+#include "qSlicerNodeWriter.h"
 #include "qSlicerSaveDataDialog_p.h"
 #include "qSlicerLayoutManager.h"
 #include "qMRMLUtils.h"
@@ -49,6 +50,7 @@
 #include <vtkDataFileFormatHelper.h> // for GetFileExtensionFromFormatString()
 //#include <vtkMRMLHierarchyNode.h>
 #include <vtkMRMLScene.h>
+#include <vtkMRMLStorableNode.h>
 #include <vtkMRMLStorageNode.h>
 #include <vtkMRMLSceneViewNode.h>
 
@@ -810,6 +812,10 @@ bool qSlicerSaveDataDialogPrivate::saveNodes()
   QMessageBox::StandardButton forceOverwrite = QMessageBox::Ignore;
   QList<qSlicerIO::IOProperties> files;
   const int sceneRow = this->findSceneRow();
+  // Nodes whose storage node is set up by their writer and that are written
+  // all together afterwards
+  std::vector<vtkMRMLStorableNode*> deferredNodes;
+  QList<int> deferredRows;
   for (int row = 0; row < this->FileWidget->rowCount(); ++row)
     {
     // only save nodes here
@@ -891,7 +897,18 @@ bool qSlicerSaveDataDialogPrivate::saveNodes()
     savingParameters["nodeID"] = QString(node->GetID());
     savingParameters["fileName"] = file.absoluteFilePath();
     savingParameters["fileFormat"] = format;
+    bool deferWrite = this->canDeferWrite(node);
+    if (deferWrite)
+      {
+      savingParameters["deferWrite"] = true;
+      }
     bool res = coreIOManager->saveNodes(fileType, savingParameters);
+    if (res && deferWrite)
+      {
+      deferredNodes.push_back(vtkMRMLStorableNode::SafeDownCast(node));
+      deferredRows << row;
+      continue;
+      }
 
     // node has failed to be written
     if (!res)
@@ -911,9 +928,59 @@ bool qSlicerSaveDataDialogPrivate::saveNodes()
     nodeNameItem->setCheckState(Qt::Unchecked);
     nodeStatusItem->setText("Not Modified");
     }
+
+  // Write the independent data files concurrently
+  std::vector<int> writeSuccess;
+  this->MRMLScene->WriteStorableNodes(deferredNodes, &writeSuccess);
+  for (int i = 0; i < deferredRows.count(); ++i)
+    {
+    int row = deferredRows[i];
+    if (!writeSuccess[i])
+      {
+      QMessageBox::StandardButton answer =
+        QMessageBox::question(this, tr("Saving node..."),
+                              tr("Cannot write data file: %1.\n"
+                                 "Do you want to continue saving?").arg(this->file(row).absoluteFilePath()),
+                              QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes);
+      if (answer == QMessageBox::No)
+        {
+        return false;
+        }
+      }
+    this->FileWidget->item(row, NodeNameColumn)->setCheckState(Qt::Unchecked);
+    this->FileWidget->item(row, NodeStatusColumn)->setText("Not Modified");
+    }
   return true;
 }
 
+//-----------------------------------------------------------------------------
+bool qSlicerSaveDataDialogPrivate::canDeferWrite(vtkMRMLNode* node)const
+{
+  // Nodes of scene views are not in the scene
+  if (!vtkMRMLStorableNode::SafeDownCast(node) ||
+      this->MRMLScene->GetNodeByID(node->GetID()) != node)
+    {
+    return false;
+    }
+  qSlicerCoreIOManager* coreIOManager =
+    qSlicerCoreApplication::application()->coreIOManager();
+  bool canDefer = false;
+  foreach(qSlicerFileWriter* writer, coreIOManager->writers(coreIOManager->fileWriterFileType(node)))
+    {
+    if (!writer->canWriteObject(node))
+      {
+      continue;
+      }
+    // Other writers may not only write the storage node data
+    if (!qobject_cast<qSlicerNodeWriter*>(writer))
+      {
+      return false;
+      }
+    canDefer = true;
+    }
+  return canDefer;
+}
+
 //-----------------------------------------------------------------------------
 QFileInfo qSlicerSaveDataDialogPrivate::file(int row)const
 {
@@ -90,6 +90,9 @@ protected:
 
   int               findSceneRow()const;
   bool              mustSceneBeSaved()const;
+  /// Return true if the node data can be written with the other nodes by
+  /// vtkMRMLScene::WriteStorableNodes() instead of by its writer.
+  bool              canDeferWrite(vtkMRMLNode* node)const;
   bool              prepareForSaving();
   void              restoreAfterSaving();
   void              setSceneRootDirectory(const QString& rootDirectory);
@@ -0,0 +1,160 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRML includes
+#include "vtkEventBroker.h"
+#include "vtkMRMLCoreTestingMacros.h"
+#include "vtkMRMLModelNode.h"
+#include "vtkObservation.h"
+
+// VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkNew.h>
+
+// STD includes
+#include <sstream>
+
+namespace
+{
+
+int coalescing();
+int profiling();
+
+//---------------------------------------------------------------------------
+struct CallbackCounter
+{
+  CallbackCounter() : NumberOfCalls(0), NumberOfModifiedEvents(0) {}
+  int NumberOfCalls;
+  int NumberOfModifiedEvents;
+};
+
+//---------------------------------------------------------------------------
+void CountCallback(vtkObject* vtkNotUsed(caller), unsigned long eid,
+                   void* clientData, void* vtkNotUsed(callData))
+{
+  CallbackCounter* counter = reinterpret_cast<CallbackCounter*>(clientData);
+  ++counter->NumberOfCalls;
+  if (eid == vtkCommand::ModifiedEvent)
+    {
+    ++counter->NumberOfModifiedEvents;
+    }
+}
+
+} // end of anonymous namespace
+
+//---------------------------------------------------------------------------
+int vtkEventBrokerTest1(int vtkNotUsed(argc), char * vtkNotUsed(argv)[] )
+{
+  CHECK_EXIT_SUCCESS(coalescing());
+  CHECK_EXIT_SUCCESS(profiling());
+  return EXIT_SUCCESS;
+}
+
+namespace
+{
+
+//---------------------------------------------------------------------------
+int coalescing()
+{
+  vtkEventBroker* broker = vtkEventBroker::GetInstance();
+
+  vtkNew<vtkMRMLModelNode> subject;
+  vtkNew<vtkMRMLModelNode> observer;
+  CallbackCounter counter;
+  vtkNew<vtkCallbackCommand> callback;
+  callback->SetCallback(CountCallback);
+  callback->SetClientData(&counter);
+  vtkObservation* observation = broker->AddObservation(
+    subject.GetPointer(), vtkCommand::AnyEvent, observer.GetPointer(), callback.GetPointer());
+  CHECK_NOT_NULL(observation);
+
+  broker->SetEventModeToAsynchronous();
+  int callData[10];
+  for (int i = 0; i < 10; ++i)
+    {
+    subject->InvokeEvent(vtkCommand::ModifiedEvent, &callData[i]);
+    }
+  broker->ProcessEventQueue();
+  // Without coalescing, each distinct call data is kept
+  CHECK_INT(counter.NumberOfModifiedEvents, 10);
+
+  counter = CallbackCounter();
+  broker->AddCoalescedEvent(vtkCommand::ModifiedEvent);
+  CHECK_BOOL(broker->IsEventCoalesced(vtkCommand::ModifiedEvent), true);
+  unsigned long numberOfCoalescedCalls = broker->GetNumberOfCoalescedCalls();
+  for (int i = 0; i < 10; ++i)
+    {
+    subject->InvokeEvent(vtkCommand::UserEvent, &callData[i]);
+    subject->InvokeEvent(vtkCommand::ModifiedEvent, &callData[i]);
+    }
+  CHECK_INT(static_cast<int>(observation->GetCallDataList()->size()), 11);
+  CHECK_POINTER(observation->GetCallDataList()->back().CallData, &callData[9]);
+  CHECK_INT(static_cast<int>(broker->GetNumberOfCoalescedCalls() - numberOfCoalescedCalls), 9);
+  broker->ProcessEventQueue();
+  CHECK_INT(counter.NumberOfModifiedEvents, 1);
+  CHECK_INT(counter.NumberOfCalls, 11);
+
+  broker->RemoveAllCoalescedEvents();
+  CHECK_BOOL(broker->IsEventCoalesced(vtkCommand::ModifiedEvent), false);
+  broker->SetEventModeToSynchronous();
+  broker->RemoveObservation(observation);
+
+  return EXIT_SUCCESS;
+}
+
+//---------------------------------------------------------------------------
+int profiling()
+{
+  vtkEventBroker* broker = vtkEventBroker::GetInstance();
+  broker->ResetProfile();
+  broker->ProfilingOn();
+
+  vtkNew<vtkMRMLModelNode> subject;
+  vtkNew<vtkMRMLModelNode> observer;
+  CallbackCounter counter;
+  vtkNew<vtkCallbackCommand> callback;
+  callback->SetCallback(CountCallback);
+  callback->SetClientData(&counter);
+  vtkObservation* observation = broker->AddObservation(
+    subject.GetPointer(), vtkCommand::ModifiedEvent, observer.GetPointer(), callback.GetPointer());
+
+  for (int i = 0; i < 5; ++i)
+    {
+    subject->Modified();
+    }
+  broker->ProfilingOff();
+  subject->Modified();
+  CHECK_INT(counter.NumberOfCalls, 6);
+
+  std::stringstream csv;
+  broker->WriteProfile(csv);
+  std::string header;
+  std::getline(csv, header);
+  CHECK_STD_STRING(header, "Observer,Subject,Event,NumberOfCalls,TotalTime,MeanTime,MaximumTime");
+  std::string row;
+  std::getline(csv, row);
+  CHECK_BOOL(row.find("vtkMRMLModelNode,vtkMRMLModelNode,ModifiedEvent,5,") == 0, true);
+
+  broker->ResetProfile();
+  std::stringstream emptyCSV;
+  broker->WriteProfile(emptyCSV);
+  std::getline(emptyCSV, header);
+  CHECK_BOOL(std::getline(emptyCSV, row).good(), false);
+
+  broker->RemoveObservation(observation);
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
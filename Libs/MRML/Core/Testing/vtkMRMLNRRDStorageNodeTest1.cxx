@@ -13,9 +13,24 @@
 #include "vtkMRMLCoreTestingMacros.h"
 #include "vtkMRMLNRRDStorageNode.h"
 
+// STD includes
+#include <sstream>
+
 int vtkMRMLNRRDStorageNodeTest1(int , char * [])
 {
   vtkNew<vtkMRMLNRRDStorageNode> node1;
   EXERCISE_ALL_BASIC_MRML_METHODS(node1.GetPointer());
+
+  // Compression preset is saved in the scene
+  node1->SetCompressionPreset(vtkMRMLStorageNode::CompressionMinimumSize);
+  std::stringstream xml;
+  node1->WriteXML(xml, 0);
+  CHECK_BOOL(xml.str().find(" compressionPreset=\"MinimumSize\"") != std::string::npos, true);
+
+  vtkNew<vtkMRMLNRRDStorageNode> node2;
+  const char* atts[] = { "compressionPreset", "Fastest", NULL };
+  node2->ReadXMLAttributes(atts);
+  CHECK_INT(node2->GetCompressionPreset(), vtkMRMLStorageNode::CompressionFastest);
+
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,133 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+#include "vtkMRMLLabelMapVolumeNode.h"
+#include "vtkMRMLScalarVolumeNode.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkNew.h>
+
+// STD includes
+#include <sstream>
+
+//----------------------------------------------------------------------------
+// Image pyramid of scalar and label volumes
+int vtkMRMLScalarVolumeNodeTest3(int , char * [] )
+{
+  // 65x64x1 image, value = x + 100 * y
+  vtkNew<vtkImageData> imageData;
+  imageData->SetDimensions(65, 64, 1);
+  imageData->AllocateScalars(VTK_SHORT, 1);
+  int* dims = imageData->GetDimensions();
+  for (int y = 0; y < dims[1]; y++)
+    {
+    for (int x = 0; x < dims[0]; x++)
+      {
+      short* pixel = static_cast<short*>(imageData->GetScalarPointer(x, y, 0));
+      pixel[0] = static_cast<short>(x + 100 * y);
+      }
+    }
+
+  // The pyramid is disabled by default
+  vtkNew<vtkMRMLScalarVolumeNode> volumeNode;
+  CHECK_BOOL(volumeNode->GetImageDataPyramidEnabled(), false);
+  volumeNode->SetAndObserveImageData(imageData.GetPointer());
+  CHECK_INT(volumeNode->GetMaximumImageDataPyramidLevel(), 0);
+  CHECK_NULL(volumeNode->GetImageDataPyramidLevel(1));
+
+  // It is saved in the scene
+  volumeNode->SetImageDataPyramidEnabled(true);
+  std::stringstream xml;
+  volumeNode->WriteXML(xml, 0);
+  CHECK_BOOL(xml.str().find("imageDataPyramidEnabled=\"true\"") != std::string::npos, true);
+  const char* atts[] = { "imageDataPyramidEnabled", "false", NULL };
+  volumeNode->ReadXMLAttributes(atts);
+  CHECK_BOOL(volumeNode->GetImageDataPyramidEnabled(), false);
+  vtkNew<vtkMRMLScalarVolumeNode> copiedVolumeNode;
+  copiedVolumeNode->Copy(volumeNode.GetPointer());
+  CHECK_BOOL(copiedVolumeNode->GetImageDataPyramidEnabled(), false);
+  volumeNode->SetImageDataPyramidEnabled(true);
+
+  // 65 -> 33 -> 17 -> 9: the coarsest level has at least 16 voxels
+  CHECK_INT(volumeNode->GetMaximumImageDataPyramidLevel(), 2);
+  CHECK_POINTER(volumeNode->GetImageDataPyramidLevel(0), imageData.GetPointer());
+  CHECK_NULL(volumeNode->GetImageDataPyramidLevel(3));
+
+  vtkImageData* level1 = volumeNode->GetImageDataPyramidLevel(1);
+  CHECK_NOT_NULL(level1);
+  int* level1Dims = level1->GetDimensions();
+  CHECK_INT(level1Dims[0], 33);
+  CHECK_INT(level1Dims[1], 32);
+  CHECK_INT(level1Dims[2], 1);
+  CHECK_DOUBLE(level1->GetSpacing()[0], 2.);
+  CHECK_DOUBLE(level1->GetSpacing()[2], 1.);
+  // averaged voxels are at the center of the 2x2 blocks
+  CHECK_DOUBLE(level1->GetOrigin()[0], 0.5);
+  CHECK_DOUBLE(level1->GetOrigin()[1], 0.5);
+  CHECK_DOUBLE(level1->GetOrigin()[2], 0.);
+  // (2+3+102+103)/4 = 52.5
+  CHECK_INT(*static_cast<short*>(level1->GetScalarPointer(1, 0, 0)), 53);
+  // last column has a single voxel per row: (64+164)/2
+  CHECK_INT(*static_cast<short*>(level1->GetScalarPointer(32, 0, 0)), 114);
+
+  vtkImageData* level2 = volumeNode->GetImageDataPyramidLevel(2);
+  CHECK_NOT_NULL(level2);
+  CHECK_INT(level2->GetDimensions()[0], 17);
+  CHECK_DOUBLE(level2->GetSpacing()[1], 4.);
+  CHECK_DOUBLE(level2->GetOrigin()[0], 1.5);
+
+  // Levels are cached until the image data is modified
+  CHECK_POINTER(volumeNode->GetImageDataPyramidLevel(1), level1);
+  *static_cast<short*>(imageData->GetScalarPointer(0, 0, 0)) = 1000;
+  imageData->Modified();
+  level1 = volumeNode->GetImageDataPyramidLevel(1);
+  // (1000+1+100+101)/4 = 300.5
+  CHECK_INT(*static_cast<short*>(level1->GetScalarPointer(0, 0, 0)), 301);
+
+  // Only the requested axes are downsampled
+  CHECK_INT(volumeNode->GetMaximumImageDataPyramidLevel(vtkMRMLScalarVolumeNode::AxisJ), 2);
+  CHECK_INT(volumeNode->GetMaximumImageDataPyramidLevel(vtkMRMLScalarVolumeNode::AxisK), 0);
+  vtkImageData* levelJ = volumeNode->GetImageDataPyramidLevel(1, vtkMRMLScalarVolumeNode::AxisJ);
+  CHECK_NOT_NULL(levelJ);
+  CHECK_INT(levelJ->GetDimensions()[0], 65);
+  CHECK_INT(levelJ->GetDimensions()[1], 32);
+  CHECK_DOUBLE(levelJ->GetSpacing()[0], 1.);
+  CHECK_DOUBLE(levelJ->GetSpacing()[1], 2.);
+  CHECK_DOUBLE(levelJ->GetOrigin()[0], 0.);
+  CHECK_DOUBLE(levelJ->GetOrigin()[1], 0.5);
+  // (2+102)/2
+  CHECK_INT(*static_cast<short*>(levelJ->GetScalarPointer(2, 0, 0)), 52);
+  // levels of other axes are kept
+  CHECK_POINTER(volumeNode->GetImageDataPyramidLevel(1), level1);
+
+  volumeNode->SetImageDataPyramidEnabled(false);
+  CHECK_INT(volumeNode->GetMaximumImageDataPyramidLevel(), 0);
+  CHECK_NULL(volumeNode->GetImageDataPyramidLevel(1));
+
+  // Labels are subsampled
+  vtkNew<vtkMRMLLabelMapVolumeNode> labelMapNode;
+  labelMapNode->SetImageDataPyramidEnabled(true);
+  labelMapNode->SetAndObserveImageData(imageData.GetPointer());
+  vtkImageData* labelLevel1 = labelMapNode->GetImageDataPyramidLevel(1);
+  CHECK_NOT_NULL(labelLevel1);
+  CHECK_DOUBLE(labelLevel1->GetOrigin()[0], 0.);
+  CHECK_DOUBLE(labelLevel1->GetSpacing()[0], 2.);
+  CHECK_INT(*static_cast<short*>(labelLevel1->GetScalarPointer(1, 1, 0)), 202);
+
+  return EXIT_SUCCESS;
+}
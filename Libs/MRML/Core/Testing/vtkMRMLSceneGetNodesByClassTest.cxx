@@ -0,0 +1,244 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+#include "vtkMRMLLabelMapVolumeNode.h"
+#include "vtkMRMLModelDisplayNode.h"
+#include "vtkMRMLModelNode.h"
+#include "vtkMRMLScalarVolumeNode.h"
+#include "vtkMRMLScene.h"
+
+// VTK includes
+#include <vtkCollection.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+int queries();
+int insertAndRemove();
+int traversal();
+int queryPerformance(int nodeCount);
+
+} // end of anonymous namespace
+
+//---------------------------------------------------------------------------
+int vtkMRMLSceneGetNodesByClassTest(int argc, char * argv[] )
+{
+  CHECK_EXIT_SUCCESS(queries());
+  CHECK_EXIT_SUCCESS(insertAndRemove());
+  CHECK_EXIT_SUCCESS(traversal());
+
+  // The query timing on a large scene is not run by default.
+  // Usage: vtkMRMLSceneGetNodesByClassTest --benchmark [nodeCount]
+  if (vtkAddonTestingUtilities::IsBenchmarkRequested(argc, argv))
+    {
+    int nodeCount = (argc > 2 ? atoi(argv[2]) : 50000);
+    CHECK_EXIT_SUCCESS(queryPerformance(nodeCount));
+    }
+  return EXIT_SUCCESS;
+}
+
+namespace
+{
+
+//---------------------------------------------------------------------------
+int queries()
+{
+  vtkNew<vtkMRMLScene> scene;
+
+  vtkNew<vtkMRMLScalarVolumeNode> scalarVolumeNode;
+  scene->AddNode(scalarVolumeNode.GetPointer());
+  vtkNew<vtkMRMLModelNode> modelNode;
+  scene->AddNode(modelNode.GetPointer());
+
+  // Query the classes before and after adding nodes so that both the index
+  // creation and the index update are exercised.
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLVolumeNode"), 1);
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLLabelMapVolumeNode"), 0);
+
+  vtkNew<vtkMRMLLabelMapVolumeNode> labelMapVolumeNode;
+  scene->AddNode(labelMapVolumeNode.GetPointer());
+
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLVolumeNode"), 2);
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLScalarVolumeNode"), 2);
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLLabelMapVolumeNode"), 1);
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLModelNode"), 1);
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLNode"), 3);
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLInvalidClassName"), 0);
+
+  CHECK_POINTER(scene->GetNthNodeByClass(0, "vtkMRMLVolumeNode"), scalarVolumeNode.GetPointer());
+  CHECK_POINTER(scene->GetNthNodeByClass(1, "vtkMRMLVolumeNode"), labelMapVolumeNode.GetPointer());
+  CHECK_NULL(scene->GetNthNodeByClass(2, "vtkMRMLVolumeNode"));
+
+  std::vector<vtkMRMLNode*> nodes;
+  CHECK_INT(scene->GetNodesByClass("vtkMRMLDisplayableNode", nodes), 3);
+  CHECK_POINTER(nodes[0], scalarVolumeNode.GetPointer());
+  CHECK_POINTER(nodes[1], modelNode.GetPointer());
+  CHECK_POINTER(nodes[2], labelMapVolumeNode.GetPointer());
+
+  vtkSmartPointer<vtkCollection> collection =
+    vtkSmartPointer<vtkCollection>::Take(scene->GetNodesByClass("vtkMRMLVolumeNode"));
+  CHECK_INT(collection->GetNumberOfItems(), 2);
+
+  scene->RemoveNode(scalarVolumeNode.GetPointer());
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLVolumeNode"), 1);
+  CHECK_POINTER(scene->GetNthNodeByClass(0, "vtkMRMLVolumeNode"), labelMapVolumeNode.GetPointer());
+
+  scene->Clear(1);
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLVolumeNode"), 0);
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLNode"), 0);
+
+  return EXIT_SUCCESS;
+}
+
+//---------------------------------------------------------------------------
+int insertAndRemove()
+{
+  vtkNew<vtkMRMLScene> scene;
+
+  vtkNew<vtkMRMLModelNode> modelNode1;
+  scene->AddNode(modelNode1.GetPointer());
+  vtkNew<vtkMRMLModelNode> modelNode2;
+  scene->AddNode(modelNode2.GetPointer());
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLModelNode"), 2);
+
+  // Nodes inserted in the middle of the scene must keep the scene order.
+  vtkNew<vtkMRMLModelNode> modelNode3;
+  scene->InsertBeforeNode(modelNode2.GetPointer(), modelNode3.GetPointer());
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLModelNode"), 3);
+  for (int i = 0; i < 3; ++i)
+    {
+    CHECK_POINTER(scene->GetNthNodeByClass(i, "vtkMRMLModelNode"), scene->GetNthNode(i));
+    }
+
+  // Modifying the collection directly must be detected.
+  vtkNew<vtkMRMLModelDisplayNode> displayNode;
+  scene->GetNodes()->AddItem(displayNode.GetPointer());
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLDisplayNode"), 1);
+  scene->GetNodes()->RemoveItem(displayNode.GetPointer());
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLDisplayNode"), 0);
+
+  scene->RemoveNode(modelNode3.GetPointer());
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLModelNode"), 2);
+  CHECK_POINTER(scene->GetNthNodeByClass(0, "vtkMRMLModelNode"), modelNode1.GetPointer());
+  CHECK_POINTER(scene->GetNthNodeByClass(1, "vtkMRMLModelNode"), modelNode2.GetPointer());
+
+  return EXIT_SUCCESS;
+}
+
+//---------------------------------------------------------------------------
+int traversal()
+{
+  vtkNew<vtkMRMLScene> scene;
+  std::vector<vtkSmartPointer<vtkMRMLNode> > volumeNodes;
+  for (int i = 0; i < 5; ++i)
+    {
+    vtkNew<vtkMRMLModelNode> modelNode;
+    scene->AddNode(modelNode.GetPointer());
+    vtkSmartPointer<vtkMRMLNode> volumeNode = vtkSmartPointer<vtkMRMLScalarVolumeNode>::New();
+    scene->AddNode(volumeNode);
+    volumeNodes.push_back(volumeNode);
+    }
+
+  scene->InitTraversal();
+  int count = 0;
+  vtkMRMLNode* node = scene->GetNextNodeByClass("vtkMRMLVolumeNode");
+  while (node)
+    {
+    CHECK_POINTER(node, volumeNodes[count]);
+    ++count;
+    if (count == 2)
+      {
+      // Removing the current node must not break the traversal
+      scene->RemoveNode(node);
+      }
+    node = scene->GetNextNodeByClass("vtkMRMLVolumeNode");
+    }
+  CHECK_INT(count, 5);
+
+  // GetNextNode() and GetNextNodeByClass() share the traversal position
+  scene->InitTraversal();
+  CHECK_NOT_NULL(scene->GetNextNode());
+  CHECK_POINTER(scene->GetNextNode(), volumeNodes[0]);
+  CHECK_POINTER(scene->GetNextNodeByClass("vtkMRMLVolumeNode"), volumeNodes[1]);
+  CHECK_BOOL(scene->GetNextNode()->IsA("vtkMRMLModelNode"), true);
+  CHECK_POINTER(scene->GetNextNodeByClass("vtkMRMLVolumeNode"), volumeNodes[3]);
+
+  return EXIT_SUCCESS;
+}
+
+//---------------------------------------------------------------------------
+int queryPerformance(int nodeCount)
+{
+  // This test is for performance
+  vtkNew<vtkMRMLScene> scene;
+  scene->StartState(vtkMRMLScene::BatchProcessState);
+  for (int i = 0; i < nodeCount / 2; ++i)
+    {
+    vtkNew<vtkMRMLModelNode> modelNode;
+    scene->AddNode(modelNode.GetPointer());
+    vtkNew<vtkMRMLModelDisplayNode> displayNode;
+    scene->AddNode(displayNode.GetPointer());
+    }
+  vtkNew<vtkMRMLScalarVolumeNode> volumeNode;
+  scene->AddNode(volumeNode.GetPointer());
+  scene->EndState(vtkMRMLScene::BatchProcessState);
+
+  const int queryCount = 1000;
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  for (int i = 0; i < queryCount; ++i)
+    {
+    CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLVolumeNode"), 1);
+    CHECK_POINTER(scene->GetNthNodeByClass(0, "vtkMRMLVolumeNode"), volumeNode.GetPointer());
+    std::vector<vtkMRMLNode*> nodes;
+    scene->GetNodesByClass("vtkMRMLVolumeNode", nodes);
+    scene->InitTraversal();
+    CHECK_POINTER(scene->GetNextNodeByClass("vtkMRMLVolumeNode"), volumeNode.GetPointer());
+    }
+  timer->StopTimer();
+  REPORT_MEASUREMENT("vtkMRMLScene-GetNodesByClassPerformance-" << nodeCount, timer->GetElapsedTime());
+
+  // Iterate over all the nodes of a large class like a node combobox does.
+  timer->StartTimer();
+  int modelNodeCount = scene->GetNumberOfNodesByClass("vtkMRMLModelNode");
+  CHECK_INT(modelNodeCount, nodeCount / 2);
+  for (int i = 0; i < modelNodeCount; ++i)
+    {
+    CHECK_NOT_NULL(scene->GetNthNodeByClass(i, "vtkMRMLModelNode"));
+    }
+  timer->StopTimer();
+  REPORT_MEASUREMENT("vtkMRMLScene-GetNthNodeByClassPerformance-" << nodeCount, timer->GetElapsedTime());
+
+  // Removing nodes must stay proportional to the number of removed nodes.
+  timer->StartTimer();
+  scene->Clear(1);
+  timer->StopTimer();
+  REPORT_MEASUREMENT("vtkMRMLScene-ClearPerformance-" << nodeCount, timer->GetElapsedTime());
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLModelNode"), 0);
+
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
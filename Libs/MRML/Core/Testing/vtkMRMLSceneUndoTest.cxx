@@ -0,0 +1,302 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+#include "vtkMRMLModelNode.h"
+#include "vtkMRMLScene.h"
+#include "vtkMRMLTableNode.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkNew.h>
+#include <vtkTable.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+namespace
+{
+
+int undoRedo();
+int undoRemovedNode();
+int sharedCopies();
+int tableCopyMemorySize();
+int maximumLevels();
+int maximumMemorySize();
+int undoPerformance(int nodeCount);
+
+} // end of anonymous namespace
+
+//---------------------------------------------------------------------------
+int vtkMRMLSceneUndoTest(int argc, char * argv[] )
+{
+  CHECK_EXIT_SUCCESS(undoRedo());
+  CHECK_EXIT_SUCCESS(undoRemovedNode());
+  CHECK_EXIT_SUCCESS(sharedCopies());
+  CHECK_EXIT_SUCCESS(tableCopyMemorySize());
+  CHECK_EXIT_SUCCESS(maximumLevels());
+  CHECK_EXIT_SUCCESS(maximumMemorySize());
+
+  // The undo timing on a large scene is not run by default.
+  // Usage: vtkMRMLSceneUndoTest --benchmark [nodeCount]
+  if (vtkAddonTestingUtilities::IsBenchmarkRequested(argc, argv))
+    {
+    int nodeCount = (argc > 2 ? atoi(argv[2]) : 10000);
+    CHECK_EXIT_SUCCESS(undoPerformance(nodeCount));
+    }
+  return EXIT_SUCCESS;
+}
+
+namespace
+{
+
+//---------------------------------------------------------------------------
+int undoRedo()
+{
+  vtkNew<vtkMRMLScene> scene;
+  scene->SetUndoOn();
+
+  vtkNew<vtkMRMLModelNode> modelNode;
+  modelNode->SetName("Before");
+  scene->AddNode(modelNode.GetPointer());
+
+  scene->SaveStateForUndo(modelNode.GetPointer());
+  modelNode->SetName("After");
+  CHECK_INT(scene->GetNumberOfUndoLevels(), 1);
+
+  scene->Undo();
+  CHECK_STRING(modelNode->GetName(), "Before");
+  CHECK_INT(scene->GetNumberOfUndoLevels(), 0);
+  CHECK_INT(scene->GetNumberOfRedoLevels(), 1);
+
+  scene->Redo();
+  CHECK_STRING(modelNode->GetName(), "After");
+  CHECK_INT(scene->GetNumberOfUndoLevels(), 1);
+  CHECK_INT(scene->GetNumberOfRedoLevels(), 0);
+
+  CHECK_BOOL(scene->GetLastSaveStateForUndoTime() >= 0., true);
+  CHECK_BOOL(scene->GetLastUndoTime() >= 0., true);
+  CHECK_BOOL(scene->GetLastRedoTime() >= 0., true);
+
+  return EXIT_SUCCESS;
+}
+
+//---------------------------------------------------------------------------
+int undoRemovedNode()
+{
+  vtkNew<vtkMRMLScene> scene;
+  scene->SetUndoOn();
+
+  vtkNew<vtkMRMLModelNode> modelNode;
+  modelNode->SetName("Model");
+  scene->AddNode(modelNode.GetPointer());
+  std::string modelNodeID = modelNode->GetID();
+
+  scene->SaveStateForUndo();
+  scene->RemoveNode(modelNode.GetPointer());
+  CHECK_NULL(scene->GetNodeByID(modelNodeID));
+
+  scene->Undo();
+  CHECK_NOT_NULL(scene->GetNodeByID(modelNodeID));
+  CHECK_STRING(scene->GetNodeByID(modelNodeID)->GetName(), "Model");
+
+  scene->Redo();
+  CHECK_NULL(scene->GetNodeByID(modelNodeID));
+
+  return EXIT_SUCCESS;
+}
+
+//---------------------------------------------------------------------------
+int sharedCopies()
+{
+  vtkNew<vtkMRMLScene> scene;
+  scene->SetUndoOn();
+
+  vtkNew<vtkMRMLModelNode> modelNode;
+  scene->AddNode(modelNode.GetPointer());
+
+  scene->SaveStateForUndo(modelNode.GetPointer());
+  vtkIdType firstStateMemorySize = scene->GetUndoStackMemorySize();
+  CHECK_BOOL(firstStateMemorySize > 0, true);
+
+  // The node is not modified: the second state shares the node copy and the
+  // list of scene nodes with the first state.
+  scene->SaveStateForUndo(modelNode.GetPointer());
+  vtkIdType secondStateMemorySize = scene->GetUndoStackMemorySize() - firstStateMemorySize;
+  CHECK_BOOL(secondStateMemorySize < firstStateMemorySize / 2, true);
+
+  // Once modified, the node must be copied again.
+  modelNode->SetName("Modified");
+  scene->SaveStateForUndo(modelNode.GetPointer());
+  vtkIdType thirdStateMemorySize = scene->GetUndoStackMemorySize()
+    - firstStateMemorySize - secondStateMemorySize;
+  CHECK_BOOL(thirdStateMemorySize > secondStateMemorySize, true);
+
+  modelNode->SetName("Modified again");
+  scene->Undo();
+  CHECK_STRING(modelNode->GetName(), "Modified");
+  scene->Undo();
+  CHECK_BOOL(modelNode->GetName() == 0 || strcmp(modelNode->GetName(), "Modified") != 0, true);
+
+  scene->ClearUndoStack();
+  scene->ClearRedoStack();
+  CHECK_INT(static_cast<int>(scene->GetUndoStackMemorySize()), 0);
+
+  return EXIT_SUCCESS;
+}
+
+//---------------------------------------------------------------------------
+int tableCopyMemorySize()
+{
+  vtkNew<vtkMRMLScene> scene;
+  scene->SetUndoOn();
+
+  vtkNew<vtkMRMLTableNode> tableNode;
+  scene->AddNode(tableNode.GetPointer());
+  scene->SaveStateForUndo(tableNode.GetPointer());
+  vtkIdType emptyTableStateMemorySize = scene->GetUndoStackMemorySize();
+  scene->ClearUndoStack();
+
+  // Tables are deep copied, their content must be accounted for.
+  const vtkIdType numberOfValues = 100000;
+  vtkNew<vtkDoubleArray> column;
+  column->SetName("Values");
+  column->SetNumberOfValues(numberOfValues);
+  column->FillComponent(0, 1.0);
+  tableNode->GetTable()->AddColumn(column.GetPointer());
+  tableNode->Modified();
+  scene->SaveStateForUndo(tableNode.GetPointer());
+  vtkIdType tableStateMemorySize = scene->GetUndoStackMemorySize();
+  CHECK_BOOL(tableStateMemorySize - emptyTableStateMemorySize
+    >= numberOfValues * static_cast<vtkIdType>(sizeof(double)), true);
+
+  return EXIT_SUCCESS;
+}
+
+//---------------------------------------------------------------------------
+int maximumLevels()
+{
+  vtkNew<vtkMRMLScene> scene;
+  scene->SetUndoOn();
+  scene->SetUndoStackSize(5);
+
+  vtkNew<vtkMRMLModelNode> modelNode;
+  scene->AddNode(modelNode.GetPointer());
+
+  for (int i = 0; i < 10; ++i)
+    {
+    std::stringstream ss;
+    ss << "Model" << i;
+    scene->SaveStateForUndo(modelNode.GetPointer());
+    modelNode->SetName(ss.str().c_str());
+    }
+  CHECK_INT(scene->GetNumberOfUndoLevels(), 5);
+  CHECK_INT(scene->GetNumberOfDiscardedUndoLevels(), 5);
+
+  // The most recent states are kept
+  scene->Undo();
+  CHECK_STRING(modelNode->GetName(), "Model8");
+
+  // Lowering the limit discards the oldest states immediately
+  CHECK_INT(scene->GetNumberOfUndoLevels(), 4);
+  scene->SetUndoStackSize(2);
+  CHECK_INT(scene->GetNumberOfUndoLevels(), 2);
+  CHECK_INT(scene->GetNumberOfDiscardedUndoLevels(), 7);
+  scene->Undo();
+  CHECK_STRING(modelNode->GetName(), "Model7");
+
+  return EXIT_SUCCESS;
+}
+
+//---------------------------------------------------------------------------
+int maximumMemorySize()
+{
+  vtkNew<vtkMRMLScene> scene;
+  scene->SetUndoOn();
+
+  vtkNew<vtkMRMLModelNode> modelNode;
+  scene->AddNode(modelNode.GetPointer());
+
+  scene->SaveStateForUndo(modelNode.GetPointer());
+  vtkIdType stateMemorySize = scene->GetUndoStackMemorySize();
+  scene->ClearUndoStack();
+
+  const vtkIdType maximumMemorySize = 3 * stateMemorySize;
+  scene->SetMaximumUndoStackMemorySize(maximumMemorySize);
+  for (int i = 0; i < 20; ++i)
+    {
+    std::stringstream ss;
+    ss << "Model" << i;
+    scene->SaveStateForUndo(modelNode.GetPointer());
+    modelNode->SetName(ss.str().c_str());
+    CHECK_BOOL(scene->GetUndoStackMemorySize() <= maximumMemorySize, true);
+    }
+  CHECK_BOOL(scene->GetNumberOfUndoLevels() >= 1, true);
+  CHECK_BOOL(scene->GetNumberOfUndoLevels() < 20, true);
+  CHECK_INT(scene->GetNumberOfDiscardedUndoLevels(), 20 - scene->GetNumberOfUndoLevels());
+
+  // Lowering the limit discards the oldest states immediately, the most
+  // recent one is always kept
+  scene->SetMaximumUndoStackMemorySize(1);
+  CHECK_INT(scene->GetNumberOfUndoLevels(), 1);
+  CHECK_INT(scene->GetNumberOfDiscardedUndoLevels(), 19);
+  scene->Undo();
+  CHECK_STRING(modelNode->GetName(), "Model18");
+
+  return EXIT_SUCCESS;
+}
+
+//---------------------------------------------------------------------------
+int undoPerformance(int nodeCount)
+{
+  // This test is for performance
+  vtkNew<vtkMRMLScene> scene;
+  for (int i = 0; i < nodeCount; ++i)
+    {
+    vtkNew<vtkMRMLModelNode> modelNode;
+    scene->AddNode(modelNode.GetPointer());
+    }
+  scene->SetUndoOn();
+  vtkMRMLNode* modelNode = scene->GetNthNodeByClass(0, "vtkMRMLModelNode");
+
+  const int stateCount = 100;
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  for (int i = 0; i < stateCount; ++i)
+    {
+    scene->SaveStateForUndo(modelNode);
+    modelNode->Modified();
+    }
+  timer->StopTimer();
+  REPORT_MEASUREMENT("vtkMRMLScene-SaveStateForUndoPerformance-" << nodeCount, timer->GetElapsedTime());
+  REPORT_INTEGER_MEASUREMENT("vtkMRMLScene-UndoStackMemorySize-" << nodeCount, scene->GetUndoStackMemorySize());
+
+  timer->StartTimer();
+  for (int i = 0; i < stateCount; ++i)
+    {
+    scene->Undo();
+    }
+  timer->StopTimer();
+  REPORT_MEASUREMENT("vtkMRMLScene-UndoPerformance-" << nodeCount, timer->GetElapsedTime());
+  CHECK_INT(scene->GetNumberOfUndoLevels(), 0);
+
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
@@ -0,0 +1,191 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH)
+  All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Program:   3D Slicer
+
+=========================================================================auto=*/
+
+#include "vtkMRMLCoreTestingMacros.h"
+#include "vtkMRMLModelNode.h"
+#include "vtkMRMLModelStorageNode.h"
+#include "vtkMRMLScene.h"
+
+// VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+#include <vtkTimerLog.h>
+
+// VTKSYS includes
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Events must be invoked by the thread calling WriteStorableNodes()
+struct EventData
+{
+  vtkMultiThreaderIDType ThreadID;
+  int NumberOfEvents;
+  int NumberOfEventsFromOtherThreads;
+  double Progress;
+};
+
+//----------------------------------------------------------------------------
+void CountEvent(vtkObject* vtkNotUsed(caller), unsigned long event, void* clientData, void* callData)
+{
+  EventData* eventData = static_cast<EventData*>(clientData);
+  ++eventData->NumberOfEvents;
+  if (!vtkMultiThreader::ThreadsEqual(eventData->ThreadID, vtkMultiThreader::GetCurrentThreadID()))
+    {
+    ++eventData->NumberOfEventsFromOtherThreads;
+    }
+  if (event == vtkCommand::ProgressEvent)
+    {
+    eventData->Progress = *static_cast<double*>(callData);
+    }
+}
+
+//----------------------------------------------------------------------------
+void InitializeEventData(EventData& eventData)
+{
+  eventData.ThreadID = vtkMultiThreader::GetCurrentThreadID();
+  eventData.NumberOfEvents = 0;
+  eventData.NumberOfEventsFromOtherThreads = 0;
+  eventData.Progress = 0.;
+}
+
+//----------------------------------------------------------------------------
+int WriteModels(vtkMRMLScene* scene, const std::string& tempDir,
+                const std::vector<vtkMRMLStorableNode*>& nodes, int numberOfThreads,
+                bool benchmark = false)
+{
+  for (size_t i = 0; i < nodes.size(); ++i)
+    {
+    std::stringstream fileName;
+    fileName << tempDir << "/vtkMRMLSceneWriteStorableNodesTest_" << numberOfThreads
+             << "_" << i << ".vtk";
+    vtksys::SystemTools::RemoveFile(fileName.str().c_str());
+    nodes[i]->GetStorageNode()->SetFileName(fileName.str().c_str());
+    }
+
+  scene->SetNumberOfWriteThreads(numberOfThreads);
+  std::vector<int> writeSuccess;
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  CHECK_BOOL(scene->WriteStorableNodes(nodes, &writeSuccess), true);
+  timer->StopTimer();
+  if (benchmark)
+    {
+    REPORT_MEASUREMENT("WriteStorableNodes-threads" << numberOfThreads, timer->GetElapsedTime());
+    }
+
+  CHECK_INT(static_cast<int>(writeSuccess.size()), static_cast<int>(nodes.size()));
+  for (size_t i = 0; i < nodes.size(); ++i)
+    {
+    CHECK_INT(writeSuccess[i], 1);
+    CHECK_BOOL(vtksys::SystemTools::FileExists(nodes[i]->GetStorageNode()->GetFileName(), true), true);
+    }
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkMRMLSceneWriteStorableNodesTest(int argc, char * argv[])
+{
+  if (argc < 2)
+    {
+    std::cerr << "Usage: " << argv[0] << " /path/to/temp [--benchmark]" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::string tempDir = argv[1];
+  // The write times are only reported on request
+  bool benchmark = vtkAddonTestingUtilities::IsBenchmarkRequested(argc, argv, 2);
+
+  vtkNew<vtkMRMLScene> scene;
+  scene->SetRootDirectory(tempDir.c_str());
+
+  std::vector<vtkMRMLStorableNode*> nodes;
+  std::vector<vtkSmartPointer<vtkMRMLModelNode> > modelNodes;
+  for (int i = 0; i < 8; ++i)
+    {
+    // models of different sizes
+    vtkNew<vtkSphereSource> sphereSource;
+    sphereSource->SetThetaResolution(50 + 50 * i);
+    sphereSource->SetPhiResolution(50 + 50 * i);
+    sphereSource->Update();
+    vtkSmartPointer<vtkMRMLModelNode> modelNode = vtkSmartPointer<vtkMRMLModelNode>::New();
+    modelNode->SetAndObservePolyData(sphereSource->GetOutput());
+    CHECK_NOT_NULL(scene->AddNode(modelNode));
+    modelNode->AddDefaultStorageNode();
+    CHECK_NOT_NULL(modelNode->GetStorageNode());
+    modelNodes.push_back(modelNode);
+    nodes.push_back(modelNode);
+    }
+
+  CHECK_EXIT_SUCCESS(WriteModels(scene.GetPointer(), tempDir, nodes, 1, benchmark));
+
+  // Progress is reported by the calling thread
+  EventData progressData;
+  InitializeEventData(progressData);
+  vtkNew<vtkCallbackCommand> progressCallback;
+  progressCallback->SetCallback(CountEvent);
+  progressCallback->SetClientData(&progressData);
+  scene->AddObserver(vtkCommand::ProgressEvent, progressCallback.GetPointer());
+  CHECK_EXIT_SUCCESS(WriteModels(scene.GetPointer(), tempDir, nodes, 4, benchmark));
+  scene->RemoveObserver(progressCallback.GetPointer());
+  CHECK_BOOL(progressData.NumberOfEvents > 0, true);
+  CHECK_INT(progressData.NumberOfEventsFromOtherThreads, 0);
+  CHECK_DOUBLE(progressData.Progress, 1.);
+
+  // Nodes larger than the budget are written alone
+  scene->SetMaximumConcurrentWriteSize(1);
+  CHECK_EXIT_SUCCESS(WriteModels(scene.GetPointer(), tempDir, nodes, 4));
+  scene->SetMaximumConcurrentWriteSize(0);
+
+  // Failures are reported per node
+  vtkNew<vtkMRMLModelNode> nodeWithoutStorageNode;
+  scene->AddNode(nodeWithoutStorageNode.GetPointer());
+  // the storage node reports an error for unknown file extensions
+  std::string invalidFileName = tempDir + "/vtkMRMLSceneWriteStorableNodesTest.invalid";
+  modelNodes[1]->GetStorageNode()->SetFileName(invalidFileName.c_str());
+  std::vector<vtkMRMLStorableNode*> invalidNodes;
+  invalidNodes.push_back(modelNodes[0]);
+  invalidNodes.push_back(nodeWithoutStorageNode.GetPointer());
+  invalidNodes.push_back(modelNodes[1]);
+  // Errors of a node written by another thread are reported by the calling thread
+  EventData errorData;
+  InitializeEventData(errorData);
+  vtkNew<vtkCallbackCommand> errorCallback;
+  errorCallback->SetCallback(CountEvent);
+  errorCallback->SetClientData(&errorData);
+  modelNodes[1]->GetStorageNode()->AddObserver(vtkCommand::ErrorEvent, errorCallback.GetPointer());
+  std::vector<int> writeSuccess;
+  TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+  CHECK_BOOL(scene->WriteStorableNodes(invalidNodes, &writeSuccess), false);
+  TESTING_OUTPUT_ASSERT_ERRORS_MINIMUM(2);
+  TESTING_OUTPUT_ASSERT_ERRORS_END();
+  CHECK_BOOL(errorData.NumberOfEvents > 0, true);
+  CHECK_INT(errorData.NumberOfEventsFromOtherThreads, 0);
+  CHECK_INT(static_cast<int>(writeSuccess.size()), 3);
+  CHECK_INT(writeSuccess[0], 1);
+  CHECK_INT(writeSuccess[1], 0);
+  CHECK_INT(writeSuccess[2], 0);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,232 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH)
+  All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Program:   3D Slicer
+
+=========================================================================auto=*/
+
+#include "vtkMRMLCoreTestingMacros.h"
+#include "vtkMRMLScene.h"
+#include "vtkMRMLSegmentationNode.h"
+#include "vtkMRMLSegmentationStorageNode.h"
+
+// SegmentationCore includes
+#include "vtkOrientedImageData.h"
+#include "vtkSegment.h"
+#include "vtkSegmentation.h"
+#include "vtkSegmentationConverter.h"
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// VTKSYS includes
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <vector>
+
+namespace
+{
+
+const int NUMBER_OF_SEGMENTS = 4;
+
+//----------------------------------------------------------------------------
+void GetSegmentBox(int segmentIndex, int box[6])
+{
+  box[0] = segmentIndex * 6 + 1;
+  box[1] = segmentIndex * 6 + 3;
+  box[2] = 5;
+  box[3] = 10;
+  box[4] = 5;
+  box[5] = 10;
+}
+
+//----------------------------------------------------------------------------
+void FillBox(vtkOrientedImageData* imageData, const int box[6], unsigned char value)
+{
+  for (int z = box[4]; z <= box[5]; ++z)
+    {
+    for (int y = box[2]; y <= box[3]; ++y)
+      {
+      for (int x = box[0]; x <= box[1]; ++x)
+        {
+        *static_cast<unsigned char*>(imageData->GetScalarPointer(x, y, z)) = value;
+        }
+      }
+    }
+  imageData->Modified();
+}
+
+//----------------------------------------------------------------------------
+int GetSegmentVoxel(vtkSegmentation* segmentation, const std::string& segmentId, int x, int y, int z)
+{
+  vtkNew<vtkOrientedImageData> labelmap;
+  if (!segmentation->GetBinaryLabelmapRepresentation(segmentId, labelmap.GetPointer()))
+    {
+    return -1;
+    }
+  int* extent = labelmap->GetExtent();
+  if (x < extent[0] || x > extent[1] || y < extent[2] || y > extent[3] || z < extent[4] || z > extent[5])
+    {
+    return 0;
+    }
+  return static_cast<int>(labelmap->GetScalarComponentAsDouble(x, y, z, 0));
+}
+
+//----------------------------------------------------------------------------
+int CheckSegments(vtkSegmentation* segmentation, const std::vector<std::string>& segmentIDs)
+{
+  CHECK_INT(segmentation->GetNumberOfSegments(), static_cast<int>(segmentIDs.size()));
+  for (size_t i = 0; i < segmentIDs.size(); ++i)
+    {
+    int box[6] = { 0, -1, 0, -1, 0, -1 };
+    GetSegmentBox(static_cast<int>(i), box);
+    CHECK_INT(GetSegmentVoxel(segmentation, segmentIDs[i], box[0], 7, 7), 1);
+    CHECK_INT(GetSegmentVoxel(segmentation, segmentIDs[i], box[0] + 6, 7, 7), 0);
+    CHECK_INT(GetSegmentVoxel(segmentation, segmentIDs[i], box[0] - 6, 7, 7), 0);
+    }
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int WriteAndRead(vtkMRMLScene* scene, vtkMRMLSegmentationNode* segmentationNode, const std::string& fileName,
+                 bool sharedLabelmapLayers, vtkMRMLSegmentationNode* readSegmentationNode)
+{
+  vtksys::SystemTools::RemoveFile(fileName.c_str());
+  vtkNew<vtkMRMLSegmentationStorageNode> storageNode;
+  scene->AddNode(storageNode.GetPointer());
+  storageNode->SetSharedLabelmapLayers(sharedLabelmapLayers);
+  storageNode->SetFileName(fileName.c_str());
+  CHECK_INT(storageNode->WriteData(segmentationNode), 1);
+
+  vtkNew<vtkMRMLSegmentationStorageNode> readStorageNode;
+  scene->AddNode(readStorageNode.GetPointer());
+  readStorageNode->SetFileName(fileName.c_str());
+  CHECK_INT(readStorageNode->ReadData(readSegmentationNode), 1);
+  // Layout of the file is preserved when the segmentation is saved again
+  CHECK_BOOL(readStorageNode->GetSharedLabelmapLayers(), sharedLabelmapLayers);
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkMRMLSegmentationStorageNodeTest1(int argc, char * argv[])
+{
+  if (argc != 2)
+    {
+    std::cerr << "Usage: " << argv[0] << " /path/to/temp" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::string tempDir = argv[1];
+
+  vtkNew<vtkMRMLScene> scene;
+
+  // Segmentation with non-overlapping segments that share a labelmap in memory
+  vtkNew<vtkMRMLSegmentationNode> segmentationNode;
+  scene->AddNode(segmentationNode.GetPointer());
+  vtkSegmentation* segmentation = segmentationNode->GetSegmentation();
+  segmentation->SetMasterRepresentationName(
+    vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+  for (int i = 0; i < NUMBER_OF_SEGMENTS; ++i)
+    {
+    vtkNew<vtkOrientedImageData> labelmap;
+    labelmap->SetExtent(0, 31, 0, 15, 0, 15);
+    labelmap->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+    int wholeBox[6] = { 0, 31, 0, 15, 0, 15 };
+    FillBox(labelmap.GetPointer(), wholeBox, 0);
+    int box[6] = { 0, -1, 0, -1, 0, -1 };
+    GetSegmentBox(i, box);
+    FillBox(labelmap.GetPointer(), box, 1);
+    vtkNew<vtkSegment> segment;
+    segment->AddRepresentation(
+      vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName(), labelmap.GetPointer());
+    segmentation->AddSegment(segment.GetPointer());
+    }
+  std::vector<std::string> segmentIDs;
+  segmentation->GetSegmentIDs(segmentIDs);
+  CHECK_BOOL(segmentation->CollapseBinaryLabelmaps(), true);
+  CHECK_INT(segmentation->GetNumberOfLayers(), 1);
+  CHECK_EXIT_SUCCESS(CheckSegments(segmentation, segmentIDs));
+
+  //////////////////////////////////////////////////////////////////////////
+  // Default: one frame per segment, segments are not shared after reading
+
+  std::string fileName = tempDir + "/vtkMRMLSegmentationStorageNodeTest1.seg.nrrd";
+  vtkNew<vtkMRMLSegmentationNode> separateSegmentationNode;
+  scene->AddNode(separateSegmentationNode.GetPointer());
+  CHECK_EXIT_SUCCESS(WriteAndRead(scene.GetPointer(), segmentationNode.GetPointer(), fileName,
+    false, separateSegmentationNode.GetPointer()));
+  vtkSegmentation* separateSegmentation = separateSegmentationNode->GetSegmentation();
+  CHECK_EXIT_SUCCESS(CheckSegments(separateSegmentation, segmentIDs));
+  CHECK_INT(separateSegmentation->GetNumberOfLayers(), NUMBER_OF_SEGMENTS);
+  CHECK_BOOL(separateSegmentation->IsSharedBinaryLabelmap(segmentIDs[0]), false);
+
+  //////////////////////////////////////////////////////////////////////////
+  // Shared labelmap layers are only written if requested
+
+  vtkNew<vtkMRMLSegmentationNode> sharedSegmentationNode;
+  scene->AddNode(sharedSegmentationNode.GetPointer());
+  CHECK_EXIT_SUCCESS(WriteAndRead(scene.GetPointer(), segmentationNode.GetPointer(), fileName,
+    true, sharedSegmentationNode.GetPointer()));
+  vtkSegmentation* sharedSegmentation = sharedSegmentationNode->GetSegmentation();
+  CHECK_EXIT_SUCCESS(CheckSegments(sharedSegmentation, segmentIDs));
+  CHECK_INT(sharedSegmentation->GetNumberOfLayers(), 1);
+  CHECK_BOOL(sharedSegmentation->IsSharedBinaryLabelmap(segmentIDs[0]), true);
+
+  //////////////////////////////////////////////////////////////////////////
+  // Editing a segment of the loaded segmentation does not change the other segments
+
+  CHECK_BOOL(sharedSegmentation->SeparateSegmentLabelmap(segmentIDs[1]), true);
+  vtkOrientedImageData* editedLabelmap = vtkOrientedImageData::SafeDownCast(
+    sharedSegmentation->GetSegment(segmentIDs[1])->GetRepresentation(
+    vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()));
+  CHECK_NOT_NULL(editedLabelmap);
+  int editedBox[6] = { 0, -1, 0, -1, 0, -1 };
+  GetSegmentBox(1, editedBox);
+  editedBox[0] -= 6;
+  editedBox[1] += 6;
+  FillBox(editedLabelmap, editedBox, 1);
+  int segment0Box[6] = { 0, -1, 0, -1, 0, -1 };
+  GetSegmentBox(0, segment0Box);
+  int segment2Box[6] = { 0, -1, 0, -1, 0, -1 };
+  GetSegmentBox(2, segment2Box);
+  CHECK_INT(GetSegmentVoxel(sharedSegmentation, segmentIDs[1], segment0Box[0], 7, 7), 1);
+  CHECK_INT(GetSegmentVoxel(sharedSegmentation, segmentIDs[1], segment2Box[0], 7, 7), 1);
+  CHECK_INT(GetSegmentVoxel(sharedSegmentation, segmentIDs[0], segment0Box[0], 7, 7), 1);
+  CHECK_INT(GetSegmentVoxel(sharedSegmentation, segmentIDs[0], segment2Box[0], 7, 7), 0);
+  CHECK_INT(GetSegmentVoxel(sharedSegmentation, segmentIDs[2], segment2Box[0], 7, 7), 1);
+  CHECK_INT(GetSegmentVoxel(sharedSegmentation, segmentIDs[2], segment0Box[0], 7, 7), 0);
+  CHECK_INT(GetSegmentVoxel(sharedSegmentation, segmentIDs[3], editedBox[0], 7, 7), 0);
+
+  //////////////////////////////////////////////////////////////////////////
+  // Removing a segment does not change the other segments
+
+  sharedSegmentation->RemoveSegment(segmentIDs[2]);
+  CHECK_INT(sharedSegmentation->GetNumberOfSegments(), 3);
+  CHECK_INT(GetSegmentVoxel(sharedSegmentation, segmentIDs[0], segment0Box[0], 7, 7), 1);
+  int segment3Box[6] = { 0, -1, 0, -1, 0, -1 };
+  GetSegmentBox(3, segment3Box);
+  CHECK_INT(GetSegmentVoxel(sharedSegmentation, segmentIDs[3], segment3Box[0], 7, 7), 1);
+  CHECK_INT(GetSegmentVoxel(sharedSegmentation, segmentIDs[3], segment2Box[0], 7, 7), 0);
+
+  // Edited segmentation can be saved and read again
+  vtkNew<vtkMRMLSegmentationNode> editedSegmentationNode;
+  scene->AddNode(editedSegmentationNode.GetPointer());
+  CHECK_EXIT_SUCCESS(WriteAndRead(scene.GetPointer(), sharedSegmentationNode.GetPointer(), fileName,
+    true, editedSegmentationNode.GetPointer()));
+  vtkSegmentation* editedSegmentation = editedSegmentationNode->GetSegmentation();
+  CHECK_INT(editedSegmentation->GetNumberOfSegments(), 3);
+  CHECK_INT(GetSegmentVoxel(editedSegmentation, segmentIDs[1], segment0Box[0], 7, 7), 1);
+  CHECK_INT(GetSegmentVoxel(editedSegmentation, segmentIDs[0], segment0Box[0], 7, 7), 1);
+  CHECK_INT(GetSegmentVoxel(editedSegmentation, segmentIDs[3], segment3Box[0], 7, 7), 1);
+  CHECK_INT(GetSegmentVoxel(editedSegmentation, segmentIDs[0], segment2Box[0], 7, 7), 0);
+
+  return EXIT_SUCCESS;
+}
@@ -24,9 +24,22 @@
 #include "vtkMRMLTableNode.h"
 #include "vtkMRMLTableSQLiteStorageNode.h"
 
+#include "vtkDoubleArray.h"
 #include "vtkFloatArray.h"
+#include "vtkIntArray.h"
+#include "vtkSQLiteDatabase.h"
+#include "vtkSQLiteQuery.h"
+#include "vtkStringArray.h"
 #include "vtkTable.h"
 #include "vtkTestErrorObserver.h"
+#include "vtkTimerLog.h"
+#include "vtkTypeInt64Array.h"
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cstdlib>
+#include <sstream>
+#include <string>
 
 // ITKSYS includes
 #include <itksys/SystemTools.hxx>
@@ -43,7 +56,73 @@ static int removeFile(char *fileName)
   return removed;
 }
 
-int vtkMRMLTableSQLiteStorageNodeTest(int , char * [] )
+//---------------------------------------------------------------------------
+static int writeReadPerformance(int numberOfRows, int numberOfColumns, bool benchmark)
+{
+  vtkNew<vtkTable> table;
+  for (int j = 0; j < numberOfColumns; ++j)
+    {
+    vtkSmartPointer<vtkDataArray> column;
+    if (j % 2)
+      {
+      column = vtkSmartPointer<vtkIntArray>::New();
+      }
+    else
+      {
+      column = vtkSmartPointer<vtkDoubleArray>::New();
+      }
+    std::stringstream ss;
+    ss << "Measurement" << j;
+    column->SetName(ss.str().c_str());
+    column->SetNumberOfTuples(numberOfRows);
+    for (int i = 0; i < numberOfRows; ++i)
+      {
+      column->SetComponent(i, 0, i * 0.5 + j);
+      }
+    table->AddColumn(column);
+    }
+
+  vtkNew<vtkMRMLTableNode> tableNode;
+  tableNode->SetAndObserveTable(table.GetPointer());
+  vtkNew<vtkMRMLTableSQLiteStorageNode> storageNode;
+  storageNode->SetFileName("testSQLitePerformance.db");
+  storageNode->SetTableName("Measurements");
+  removeFile(storageNode->GetFileName());
+
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  int written = storageNode->WriteData(tableNode.GetPointer());
+  timer->StopTimer();
+  if (benchmark)
+    {
+    REPORT_MEASUREMENT("vtkMRMLTableSQLiteStorageNode-WritePerformance-" << numberOfRows << "x" << numberOfColumns,
+      timer->GetElapsedTime());
+    }
+
+  vtkNew<vtkMRMLTableNode> readTableNode;
+  timer->StartTimer();
+  int read = storageNode->ReadData(readTableNode.GetPointer());
+  timer->StopTimer();
+  if (benchmark)
+    {
+    REPORT_MEASUREMENT("vtkMRMLTableSQLiteStorageNode-ReadPerformance-" << numberOfRows << "x" << numberOfColumns,
+      timer->GetElapsedTime());
+    }
+  removeFile(storageNode->GetFileName());
+
+  CHECK_BOOL(written != 0, true);
+  CHECK_BOOL(read != 0, true);
+  CHECK_INT(readTableNode->GetNumberOfColumns(), numberOfColumns);
+  CHECK_INT(readTableNode->GetNumberOfRows(), numberOfRows);
+  vtkIdType lastRow = numberOfRows - 1;
+  CHECK_DOUBLE(readTableNode->GetTable()->GetValue(lastRow, 0).ToDouble(), lastRow * 0.5);
+  CHECK_INT(readTableNode->GetTable()->GetValue(lastRow, 1).ToInt(), static_cast<int>(lastRow * 0.5 + 1));
+
+  return EXIT_SUCCESS;
+}
+
+//---------------------------------------------------------------------------
+int vtkMRMLTableSQLiteStorageNodeTest(int argc, char * argv[] )
 {
   vtkNew<vtkMRMLScene> scene;
 
@@ -114,6 +193,74 @@ int vtkMRMLTableSQLiteStorageNodeTest(int , char * [] )
   // clean up
   removeFile(storageNode->GetFileName());
 
+  // Strings are bound to the insert statement: quotes need no escaping
+  vtkNew<vtkTable> stringTable;
+  vtkNew<vtkStringArray> arrNames;
+  arrNames->SetName("Name");
+  arrNames->InsertNextValue("it's quoted");
+  arrNames->InsertNextValue("plain");
+  stringTable->AddColumn(arrNames.GetPointer());
+  tableNode->SetAndObserveTable(stringTable.GetPointer());
+  storageNode->SetTableName("Names");
+  CHECK_BOOL(storageNode->WriteData(tableNode.GetPointer()) != 0, true);
+  tableNode->RemoveAllColumns();
+  CHECK_BOOL(storageNode->ReadData(tableNode.GetPointer()) != 0, true);
+  CHECK_INT(tableNode->GetNumberOfRows(), 2);
+  CHECK_STD_STRING(tableNode->GetTable()->GetValue(0, 0).ToString(), "it's quoted");
+  removeFile(storageNode->GetFileName());
+
+  // 64-bit integers are written and read exactly, above 2^31 and even above 2^53
+  const vtkTypeInt64 largeValue = (static_cast<vtkTypeInt64>(1) << 53) + 1;
+  const vtkTypeInt64 above32BitValue = (static_cast<vtkTypeInt64>(1) << 31) + 5;
+  vtkNew<vtkTable> integerTable;
+  vtkNew<vtkTypeInt64Array> arrIDs;
+  arrIDs->SetName("ID");
+  arrIDs->InsertNextValue(largeValue);
+  arrIDs->InsertNextValue(-largeValue);
+  arrIDs->InsertNextValue(above32BitValue);
+  integerTable->AddColumn(arrIDs.GetPointer());
+  tableNode->SetAndObserveTable(integerTable.GetPointer());
+  storageNode->SetTableName("IDs");
+  CHECK_BOOL(storageNode->WriteData(tableNode.GetPointer()) != 0, true);
+  {
+  std::string dbname = std::string("sqlite://") + storageNode->GetFileName();
+  vtkSmartPointer<vtkSQLiteDatabase> database = vtkSmartPointer<vtkSQLiteDatabase>::Take(
+    vtkSQLiteDatabase::SafeDownCast(vtkSQLiteDatabase::CreateFromURL(dbname.c_str())));
+  CHECK_NOT_NULL(database.GetPointer());
+  CHECK_BOOL(database->Open(0, vtkSQLiteDatabase::USE_EXISTING), true);
+  vtkSmartPointer<vtkSQLiteQuery> query = vtkSmartPointer<vtkSQLiteQuery>::Take(
+    vtkSQLiteQuery::SafeDownCast(database->GetQueryInstance()));
+  // vtkSQLiteQuery reads integers as 32-bit int, check the stored text
+  query->SetQuery("SELECT CAST(ID AS TEXT) FROM IDs");
+  CHECK_BOOL(query->Execute(), true);
+  CHECK_BOOL(query->NextRow(), true);
+  CHECK_BOOL(query->DataValue(0).ToTypeInt64() == largeValue, true);
+  CHECK_BOOL(query->NextRow(), true);
+  CHECK_BOOL(query->DataValue(0).ToTypeInt64() == -largeValue, true);
+  query = 0;
+  database->Close();
+  }
+  tableNode->RemoveAllColumns();
+  CHECK_BOOL(storageNode->ReadData(tableNode.GetPointer()) != 0, true);
+  CHECK_INT(tableNode->GetNumberOfRows(), 3);
+  vtkTypeInt64Array* readIDs = vtkTypeInt64Array::SafeDownCast(tableNode->GetTable()->GetColumn(0));
+  CHECK_NOT_NULL(readIDs);
+  CHECK_BOOL(readIDs->GetValue(0) == largeValue, true);
+  CHECK_BOOL(readIDs->GetValue(1) == -largeValue, true);
+  CHECK_BOOL(readIDs->GetValue(2) == above32BitValue, true);
+  removeFile(storageNode->GetFileName());
+
+  // The write and read times are only reported on request, pass the number
+  // of rows to benchmark large tables (e.g. 1000000 for a 10^6 x 20 table).
+  // Usage: vtkMRMLTableSQLiteStorageNodeTest --benchmark [numberOfRows]
+  bool benchmark = vtkAddonTestingUtilities::IsBenchmarkRequested(argc, argv);
+  int numberOfRows = 10000;
+  if (benchmark && argc > 2)
+    {
+    numberOfRows = atoi(argv[2]);
+    }
+  CHECK_EXIT_SUCCESS(writeReadPerformance(numberOfRows, 20, benchmark));
+
   std::cout << "vtkMRMLTableSQLiteStorageNodeTest completed successfully" << std::endl;
   return EXIT_SUCCESS;
 }
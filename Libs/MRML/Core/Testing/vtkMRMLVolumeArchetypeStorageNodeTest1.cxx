@@ -13,9 +13,18 @@
 #include "vtkMRMLCoreTestingMacros.h"
 #include "vtkMRMLVolumeArchetypeStorageNode.h"
 
+// STD includes
+#include <sstream>
+
 int vtkMRMLVolumeArchetypeStorageNodeTest1(int , char * [] )
 {
   vtkNew<vtkMRMLVolumeArchetypeStorageNode> node1;
   EXERCISE_ALL_BASIC_MRML_METHODS(node1.GetPointer());
+
+  // The writer cannot select a compression level, the preset is not saved
+  std::stringstream xml;
+  node1->WriteXML(xml, 0);
+  CHECK_BOOL(xml.str().find("compressionPreset") == std::string::npos, true);
+
   return EXIT_SUCCESS;
 }
@@ -22,6 +22,10 @@
 #include <vtkObjectFactory.h>
 #include <vtkTimerLog.h>
 
+// STD includes
+#include <algorithm>
+#include <sstream>
+
 vtkCxxSetObjectMacro(vtkEventBroker, TimerLog, vtkTimerLog);
 
 //----------------------------------------------------------------------------
@@ -96,6 +100,8 @@ vtkEventBroker::vtkEventBroker()
   this->EventNestingLevel = 0;
   this->TimerLog = vtkTimerLog::New();
   this->CompressCallData = 0;
+  this->NumberOfCoalescedCalls = 0;
+  this->Profiling = 0;
   this->LogFileName = NULL;
   this->ScriptHandler = NULL;
   this->ScriptHandlerClientData = NULL;
@@ -752,7 +758,25 @@ void vtkEventBroker::QueueObservation ( vtkObservation *observation,
   // If the event is not currently in the queue, add it and keep a flag.
   //
   vtkObservation::CallType call(eid, callData);
-  if ( this->GetCompressCallData() &&
+  if ( this->IsEventCoalesced(eid) )
+    {
+    std::deque< vtkObservation::CallType >* callDataList = observation->GetCallDataList();
+    std::deque< vtkObservation::CallType >::iterator dataIter;
+    for (dataIter = callDataList->begin(); dataIter != callDataList->end();)
+      {
+      if ( dataIter->EventID == eid )
+        {
+        dataIter = callDataList->erase(dataIter);
+        ++this->NumberOfCoalescedCalls;
+        }
+      else
+        {
+        ++dataIter;
+        }
+      }
+    callDataList->push_back( call );
+    }
+  else if ( this->GetCompressCallData() &&
        observation->GetEvent() != vtkCommand::AnyEvent)
     {
     observation->GetCallDataList()->clear();
@@ -843,6 +867,10 @@ void vtkEventBroker::InvokeObservation ( vtkObservation *observation,
   observation->SetTotalElapsedTime (observation->GetTotalElapsedTime() + elapsedTime);
   observation->SetLastElapsedTime (elapsedTime);
   this->LogEvent (observation);
+  if ( this->Profiling )
+    {
+    this->AddToProfile (observation, eid, elapsedTime);
+    }
 
   // clear reference to observation (may cause delete)
   observation->Delete();
@@ -883,6 +911,175 @@ void vtkEventBroker::ProcessEventQueue ()
     }
 }
 
+//----------------------------------------------------------------------------
+void vtkEventBroker::AddCoalescedEvent(unsigned long eid)
+{
+  if (this->CoalescedEvents.insert(eid).second)
+    {
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkEventBroker::RemoveCoalescedEvent(unsigned long eid)
+{
+  if (this->CoalescedEvents.erase(eid))
+    {
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkEventBroker::RemoveAllCoalescedEvents()
+{
+  if (!this->CoalescedEvents.empty())
+    {
+    this->CoalescedEvents.clear();
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkEventBroker::IsEventCoalesced(unsigned long eid)
+{
+  return !this->CoalescedEvents.empty()
+    && this->CoalescedEvents.find(eid) != this->CoalescedEvents.end();
+}
+
+//----------------------------------------------------------------------------
+bool vtkEventBroker::ProfileKey::operator<(const ProfileKey& other)const
+{
+  if (this->EventID != other.EventID)
+    {
+    return this->EventID < other.EventID;
+    }
+  if (this->ObserverName != other.ObserverName)
+    {
+    return this->ObserverName < other.ObserverName;
+    }
+  return this->SubjectClassName < other.SubjectClassName;
+}
+
+//----------------------------------------------------------------------------
+void vtkEventBroker::AddToProfile(vtkObservation *observation,
+                                  unsigned long eid, double elapsedTime)
+{
+  ProfileKey key;
+  if ( observation->GetScript() != NULL )
+    {
+    key.ObserverName = observation->GetScript();
+    }
+  else if ( observation->GetObserver() )
+    {
+    key.ObserverName = observation->GetObserver()->GetClassName();
+    }
+  else
+    {
+    key.ObserverName = "No observer class";
+    }
+  key.SubjectClassName = observation->GetSubject() ?
+    observation->GetSubject()->GetClassName() : "";
+  key.EventID = eid;
+
+  ProfileEntry& entry = this->Profile[key];
+  ++entry.NumberOfCalls;
+  entry.TotalElapsedTime += elapsedTime;
+  entry.MaximumElapsedTime = std::max(entry.MaximumElapsedTime, elapsedTime);
+}
+
+//----------------------------------------------------------------------------
+void vtkEventBroker::ResetProfile()
+{
+  this->Profile.clear();
+}
+
+namespace
+{
+//----------------------------------------------------------------------------
+std::string ToCSVField(const std::string& value)
+{
+  if (value.find_first_of(",\"\n") == std::string::npos)
+    {
+    return value;
+    }
+  std::string field = "\"";
+  for (std::string::const_iterator it = value.begin(); it != value.end(); ++it)
+    {
+    if (*it == '"')
+      {
+      field += '"';
+      }
+    field += *it;
+    }
+  field += '"';
+  return field;
+}
+
+//----------------------------------------------------------------------------
+typedef std::pair<double, std::string> ProfileRow;
+bool CompareProfileRows(const ProfileRow& row1, const ProfileRow& row2)
+{
+  return row1.first > row2.first;
+}
+}
+
+//----------------------------------------------------------------------------
+void vtkEventBroker::WriteProfile(ostream& os)
+{
+  std::vector<ProfileRow> rows;
+  std::map<ProfileKey, ProfileEntry>::const_iterator it;
+  for (it = this->Profile.begin(); it != this->Profile.end(); ++it)
+    {
+    const ProfileKey& key = it->first;
+    const ProfileEntry& entry = it->second;
+    std::stringstream eventName;
+    const char* eventString = vtkCommand::GetStringFromEventId(key.EventID);
+    if ( !strcmp(eventString, "NoEvent") )
+      {
+      eventName << key.EventID;
+      }
+    else
+      {
+      eventName << eventString;
+      }
+    std::stringstream row;
+    row << ToCSVField(key.ObserverName) << ","
+        << ToCSVField(key.SubjectClassName) << ","
+        << ToCSVField(eventName.str()) << ","
+        << entry.NumberOfCalls << ","
+        << entry.TotalElapsedTime << ","
+        << entry.TotalElapsedTime / entry.NumberOfCalls << ","
+        << entry.MaximumElapsedTime;
+    rows.push_back(ProfileRow(entry.TotalElapsedTime, row.str()));
+    }
+  std::stable_sort(rows.begin(), rows.end(), CompareProfileRows);
+
+  os << "Observer,Subject,Event,NumberOfCalls,TotalTime,MeanTime,MaximumTime\n";
+  for (std::vector<ProfileRow>::const_iterator rowIt = rows.begin();
+       rowIt != rows.end(); ++rowIt)
+    {
+    os << rowIt->second << "\n";
+    }
+}
+
+//----------------------------------------------------------------------------
+int vtkEventBroker::WriteProfileFile(const char* fileName)
+{
+  if (!fileName)
+    {
+    vtkErrorMacro("WriteProfileFile: no file name");
+    return 0;
+    }
+  std::ofstream profileFile(fileName);
+  if (!profileFile.is_open())
+    {
+    vtkErrorMacro("WriteProfileFile: could not open " << fileName);
+    return 0;
+    }
+  this->WriteProfile(profileFile);
+  return profileFile.good() ? 1 : 0;
+}
+
 //----------------------------------------------------------------------------
 void vtkEventBroker::PrintSelf(ostream& os, vtkIndent indent)
 {
@@ -892,6 +1089,16 @@ void vtkEventBroker::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "NumberOfQueueObservations: " << this->GetNumberOfQueuedObservations() << "\n";
   os << indent << "EventMode: " << this->GetEventModeAsString() << "\n";
   os << indent << "EventLogging: " << this->EventLogging << "\n";
+  os << indent << "CompressCallData: " << this->CompressCallData << "\n";
+  os << indent << "CoalescedEvents:";
+  for (std::set<unsigned long>::const_iterator it = this->CoalescedEvents.begin();
+       it != this->CoalescedEvents.end(); ++it)
+    {
+    os << " " << *it;
+    }
+  os << "\n";
+  os << indent << "NumberOfCoalescedCalls: " << this->NumberOfCoalescedCalls << "\n";
+  os << indent << "Profiling: " << this->Profiling << "\n";
   os << indent << "EventNestingLevel: " << this->EventNestingLevel << "\n";
   os << indent << "LogFileName: " <<
     (this->LogFileName ? this->LogFileName : "(none)") << "\n";
@@ -28,6 +28,7 @@ class vtkTimerLog;
 #include <set>
 #include <map>
 #include <fstream>
+#include <string>
 
 class vtkCollection;
 class vtkCallbackCommand;
@@ -233,6 +234,46 @@ public:
   vtkGetMacro (CompressCallData, int);
   vtkSetMacro (CompressCallData, int);
 
+  /// Event coalescing
+  ///
+  /// In asynchronous mode, a queued observation that receives a coalesced
+  /// event again only keeps the latest call data of that event: a burst of
+  /// ModifiedEvent during an interaction results in a single invocation of
+  /// each observer callback when the queue is processed.
+  /// The call is moved to the end of the calls of the observation so that
+  /// it is invoked in the order of the latest events.
+  /// Unlike CompressCallData, this also applies to observations of AnyEvent
+  /// and leaves the calls of the other events untouched.
+  /// No event is coalesced by default.
+  void AddCoalescedEvent(unsigned long eid);
+  void RemoveCoalescedEvent(unsigned long eid);
+  void RemoveAllCoalescedEvents();
+  bool IsEventCoalesced(unsigned long eid);
+
+  /// Number of calls that have been dropped because a more recent call of
+  /// the same coalesced event was queued for the same observation.
+  vtkGetMacro (NumberOfCoalescedCalls, unsigned long);
+
+  /// Profiling
+  ///
+  /// When profiling is on, the number of invocations, the total and the
+  /// maximum elapsed time are recorded for each observer class, subject
+  /// class and event (in synchronous mode, the time includes the nested
+  /// invocations). Profiling is off by default.
+  vtkBooleanMacro (Profiling, int);
+  vtkSetMacro (Profiling, int);
+  vtkGetMacro (Profiling, int);
+
+  /// Clear the recorded profile
+  void ResetProfile();
+
+  /// Write the recorded profile as comma separated values, one row per
+  /// observer callback, sorted by decreasing total time.
+  /// Times are in seconds.
+  void WriteProfile(ostream& os);
+  /// Write the recorded profile into a CSV file. Return 0 on failure.
+  int WriteProfileFile(const char* fileName);
+
   ///
   /// Sets the method pointer to be used for processing script observations
   void SetScriptHandler ( void (*scriptHandler) (const char* script, void *clientData), void *clientData )
@@ -286,6 +327,29 @@ protected:
   int EventMode;
   int CompressCallData;
 
+  std::set<unsigned long> CoalescedEvents;
+  unsigned long NumberOfCoalescedCalls;
+
+  /// Record the time spent in an invocation of the observation
+  void AddToProfile(vtkObservation *observation, unsigned long eid, double elapsedTime);
+
+  struct ProfileKey
+  {
+    std::string ObserverName;
+    std::string SubjectClassName;
+    unsigned long EventID;
+    bool operator<(const ProfileKey& other)const;
+  };
+  struct ProfileEntry
+  {
+    ProfileEntry() : NumberOfCalls(0), TotalElapsedTime(0.), MaximumElapsedTime(0.) {}
+    unsigned long NumberOfCalls;
+    double TotalElapsedTime;
+    double MaximumElapsedTime;
+  };
+  int Profiling;
+  std::map<ProfileKey, ProfileEntry> Profile;
+
   std::ofstream LogFile;
 private:
   /// DetachObservations is a fast (but dangerous) method to delete all the
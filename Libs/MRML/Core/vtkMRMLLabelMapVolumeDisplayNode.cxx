@@ -96,6 +96,12 @@ vtkAlgorithmOutput* vtkMRMLLabelMapVolumeDisplayNode::GetOutputImageDataConnecti
   return this->MapToColors->GetOutputPort();
 }
 
+//---------------------------------------------------------------------------
+vtkScalarsToColors* vtkMRMLLabelMapVolumeDisplayNode::GetLookupTable()
+{
+  return this->MapToColors->GetLookupTable();
+}
+
 //---------------------------------------------------------------------------
 void vtkMRMLLabelMapVolumeDisplayNode::UpdateImageDataPipeline()
 {
@@ -19,6 +19,7 @@
 
 class vtkImageAlgorithm;
 class vtkImageMapToColors;
+class vtkScalarsToColors;
 
 /// \brief MRML node for representing a volume display attributes.
 ///
@@ -56,6 +57,10 @@ class VTK_MRML_EXPORT vtkMRMLLabelMapVolumeDisplayNode : public vtkMRMLVolumeDis
 
   virtual void UpdateImageDataPipeline();
 
+  /// Get the lookup table used to map the labels to colors.
+  /// Its range is adjusted so that each label has its own color.
+  vtkScalarsToColors* GetLookupTable();
+
 protected:
   vtkMRMLLabelMapVolumeDisplayNode();
   virtual ~vtkMRMLLabelMapVolumeDisplayNode();
@@ -56,6 +56,10 @@ class VTK_MRML_EXPORT vtkMRMLLabelMapVolumeNode : public vtkMRMLScalarVolumeNode
 protected:
   vtkMRMLLabelMapVolumeNode();
   ~vtkMRMLLabelMapVolumeNode();
+
+  ///
+  /// Labels are subsampled, never averaged
+  virtual bool GetImageDataPyramidAveraging() { return false; }
   vtkMRMLLabelMapVolumeNode(const vtkMRMLLabelMapVolumeNode&);
   void operator=(const vtkMRMLLabelMapVolumeNode&);
 };
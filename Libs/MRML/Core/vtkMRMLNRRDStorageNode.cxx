@@ -56,6 +56,8 @@ void vtkMRMLNRRDStorageNode::WriteXML(ostream& of, int nIndent)
   std::stringstream ss;
   ss << this->CenterImage;
   of << indent << " centerImage=\"" << ss.str() << "\"";
+  of << indent << " compressionPreset=\""
+     << this->GetCompressionPresetAsString(this->CompressionPreset) << "\"";
 
 }
 
@@ -78,6 +80,18 @@ void vtkMRMLNRRDStorageNode::ReadXMLAttributes(const char** atts)
       ss << attValue;
       ss >> this->CenterImage;
       }
+    else if (!strcmp(attName, "compressionPreset"))
+      {
+      int preset = this->GetCompressionPresetFromString(attValue);
+      if (preset >= 0)
+        {
+        this->CompressionPreset = preset;
+        }
+      else
+        {
+        vtkWarningMacro("ReadXMLAttributes: unknown compression preset " << attValue);
+        }
+      }
     }
 
   this->EndModify(disabledModify);
@@ -116,6 +130,67 @@ bool vtkMRMLNRRDStorageNode::CanReadInReferenceNode(vtkMRMLNode *refNode)
          refNode->IsA("vtkMRMLDiffusionTensorVolumeNode");
 }
 
+//----------------------------------------------------------------------------
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Return true if the header read by the reader matches the node type
+bool IsNRRDKindMatchingNode(vtkNRRDReader* reader, vtkMRMLNode* refNode)
+{
+  if ( refNode->IsA("vtkMRMLDiffusionTensorVolumeNode") )
+    {
+    return reader->GetPointDataType() == vtkDataSetAttributes::TENSORS;
+    }
+  else if ( refNode->IsA("vtkMRMLDiffusionWeightedVolumeNode"))
+    {
+    const char *value = reader->GetHeaderValue("modality");
+    return value != NULL
+      && reader->GetPointDataType() == vtkDataSetAttributes::SCALARS
+      && !strcmp(value,"DWMRI");
+    }
+  else if ( refNode->IsA("vtkMRMLVectorVolumeNode") )
+    {
+    return reader->GetPointDataType() == vtkDataSetAttributes::VECTORS
+      || reader->GetPointDataType() == vtkDataSetAttributes::NORMALS;
+    }
+  else if ( refNode->IsA("vtkMRMLScalarVolumeNode") )
+    {
+    return reader->GetPointDataType() == vtkDataSetAttributes::SCALARS &&
+      (reader->GetNumberOfComponents() == 1 || reader->GetNumberOfComponents()==3);
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+bool vtkMRMLNRRDStorageNode::CanReadHeader(vtkMRMLNode *refNode)
+{
+  if (!this->CanReadInReferenceNode(refNode))
+    {
+    return false;
+    }
+  if (this->GetFileName() == NULL)
+    {
+    // Remote files are downloaded by ReadData, the header can't be read yet.
+    return this->GetURI() != NULL;
+    }
+  std::string fullName = this->GetFullNameFromFileName();
+  if (fullName.empty())
+    {
+    return false;
+    }
+  vtkNew<vtkNRRDReader> reader;
+  if (!reader->CanReadFile(fullName.c_str()))
+    {
+    return false;
+    }
+  reader->SetFileName(fullName.c_str());
+  reader->UpdateInformation();
+  return IsNRRDKindMatchingNode(reader.GetPointer(), refNode);
+}
+
 //----------------------------------------------------------------------------
 int vtkMRMLNRRDStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
 {
@@ -188,46 +263,15 @@ int vtkMRMLNRRDStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
   reader->UpdateInformation();
 
   // Check type
-  if ( refNode->IsA("vtkMRMLDiffusionTensorVolumeNode") )
-    {
-    if ( ! (reader->GetPointDataType() == vtkDataSetAttributes::TENSORS))
-      {
-      vtkErrorMacro("ReadData: MRMLVolumeNode does not match file kind");
-      return 0;
-      }
-    }
-  else if ( refNode->IsA("vtkMRMLDiffusionWeightedVolumeNode"))
-    {
-    vtkDebugMacro("ReadData: Checking we have right info in file");
-    const char *value = reader->GetHeaderValue("modality");
-    if (value == NULL)
-      {
-      return 0;
-      }
-    if ( ! (reader->GetPointDataType() == vtkDataSetAttributes::SCALARS &&
-            !strcmp(value,"DWMRI") ) )
-      {
-      vtkErrorMacro("ReadData: MRMLVolumeNode does not match file kind");
-      return 0;
-      }
-    }
-  else if ( refNode->IsA("vtkMRMLVectorVolumeNode") )
+  if (refNode->IsA("vtkMRMLDiffusionWeightedVolumeNode")
+      && reader->GetHeaderValue("modality") == NULL)
     {
-    if (! (reader->GetPointDataType() == vtkDataSetAttributes::VECTORS
-           || reader->GetPointDataType() == vtkDataSetAttributes::NORMALS))
-      {
-      vtkErrorMacro("ReadData: MRMLVolumeNode does not match file kind");
-      return 0;
-      }
+    return 0;
     }
-  else if ( refNode->IsA("vtkMRMLScalarVolumeNode") )
+  if (!IsNRRDKindMatchingNode(reader.GetPointer(), refNode))
     {
-    if (!(reader->GetPointDataType() == vtkDataSetAttributes::SCALARS &&
-        (reader->GetNumberOfComponents() == 1 || reader->GetNumberOfComponents()==3) ))
-      {
-      vtkErrorMacro("ReadData: MRMLVolumeNode does not match file kind");
-      return 0;
-      }
+    vtkErrorMacro("ReadData: MRMLVolumeNode does not match file kind");
+    return 0;
     }
 
   reader->Update();
@@ -368,6 +412,20 @@ int vtkMRMLNRRDStorageNode::WriteDataInternal(vtkMRMLNode *refNode)
   writer->SetFileName(fullName.c_str());
   writer->SetInputConnection(volNode->GetImageDataConnection());
   writer->SetUseCompression(this->GetUseCompression());
+  writer->SetNumberOfThreads(this->GetNumberOfWriteThreads());
+  switch (this->GetCompressionPreset())
+    {
+    case CompressionFastest:
+      writer->SetCompressionLevel(1);
+      break;
+    case CompressionMinimumSize:
+      writer->SetCompressionLevel(9);
+      break;
+    default:
+      // zlib default level
+      writer->SetCompressionLevel(-1);
+      break;
+    }
 
   // set volume attributes
   writer->SetIJKToRASMatrix(ijkToRas.GetPointer());
@@ -396,6 +454,11 @@ int vtkMRMLNRRDStorageNode::WriteDataInternal(vtkMRMLNode *refNode)
     vtkErrorMacro("ERROR writing NRRD file " << (writer->GetFileName() == NULL ? "null" : writer->GetFileName()));
     writeFlag = 0;
     }
+  else
+    {
+    vtkDebugMacro("WriteData: " << fullName << " written at "
+                  << writer->GetWriteThroughput() << "MB/s");
+    }
 
   this->StageWriteData(refNode);
 
@@ -60,6 +60,10 @@ class VTK_MRML_EXPORT vtkMRMLNRRDStorageNode : public vtkMRMLStorageNode
   /// Return true if the node can be read in.
   virtual bool CanReadInReferenceNode(vtkMRMLNode *refNode);
 
+  /// Return true if the kind of the nrrd file (scalar, vector, tensor,
+  /// DWI) matches the reference node. Only the nrrd header is read.
+  virtual bool CanReadHeader(vtkMRMLNode *refNode);
+
   ///
   /// Configure the storage node for data exchange. This is an
   /// opportunity to optimize the storage node's settings, for
@@ -24,12 +24,98 @@ Version:   $Revision: 1.14 $
 #include <vtkNew.h>
 #include <vtkPointData.h>
 
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+template <class T>
+T RoundAverage(double value)
+{
+  return static_cast<T>(std::numeric_limits<T>::is_integer ? std::floor(value + 0.5) : value);
+}
+
+//----------------------------------------------------------------------------
+// Downsample by the factors (1 or 2) of each axis, by averaging the blocks
+// of voxels (smaller on the borders of odd dimensions) or by keeping the
+// first voxel of each block.
+template <class T>
+void DownsampleImage(vtkImageData* input, vtkImageData* output, const int factors[3],
+                     bool average, T*)
+{
+  int inDims[3];
+  input->GetDimensions(inDims);
+  int outDims[3];
+  output->GetDimensions(outDims);
+  int numberOfComponents = input->GetNumberOfScalarComponents();
+  vtkIdType inIncrements[3] = { numberOfComponents,
+                                static_cast<vtkIdType>(numberOfComponents) * inDims[0],
+                                static_cast<vtkIdType>(numberOfComponents) * inDims[0] * inDims[1] };
+  const T* inPtr = static_cast<const T*>(input->GetScalarPointer());
+  T* outPtr = static_cast<T*>(output->GetScalarPointer());
+  std::vector<double> sums(numberOfComponents);
+  for (int k = 0; k < outDims[2]; ++k)
+    {
+    int k0 = k * factors[2];
+    int k1 = std::min(k0 + factors[2], inDims[2]);
+    for (int j = 0; j < outDims[1]; ++j)
+      {
+      int j0 = j * factors[1];
+      int j1 = std::min(j0 + factors[1], inDims[1]);
+      for (int i = 0; i < outDims[0]; ++i)
+        {
+        int i0 = i * factors[0];
+        const T* blockPtr = inPtr + k0 * inIncrements[2] + j0 * inIncrements[1] + i0 * inIncrements[0];
+        if (!average)
+          {
+          for (int c = 0; c < numberOfComponents; ++c)
+            {
+            *outPtr++ = blockPtr[c];
+            }
+          continue;
+          }
+        int i1 = std::min(i0 + factors[0], inDims[0]);
+        std::fill(sums.begin(), sums.end(), 0.0);
+        for (int kk = k0; kk < k1; ++kk)
+          {
+          for (int jj = j0; jj < j1; ++jj)
+            {
+            const T* voxelPtr = inPtr + kk * inIncrements[2] + jj * inIncrements[1] + i0 * inIncrements[0];
+            for (int ii = i0; ii < i1; ++ii)
+              {
+              for (int c = 0; c < numberOfComponents; ++c)
+                {
+                sums[c] += *voxelPtr++;
+                }
+              }
+            }
+          }
+        double count = static_cast<double>((k1 - k0) * (j1 - j0) * (i1 - i0));
+        for (int c = 0; c < numberOfComponents; ++c)
+          {
+          *outPtr++ = RoundAverage<T>(sums[c] / count);
+          }
+        }
+      }
+    }
+}
+
+} // end of anonymous namespace
+
 //----------------------------------------------------------------------------
 vtkMRMLNodeNewMacro(vtkMRMLScalarVolumeNode);
 
 //----------------------------------------------------------------------------
 vtkMRMLScalarVolumeNode::vtkMRMLScalarVolumeNode()
 {
+  this->ImageDataPyramidEnabled = false;
+  this->ImageDataPyramidSource = NULL;
+  this->ImageDataPyramidSourceMTime = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -41,6 +127,9 @@ vtkMRMLScalarVolumeNode::~vtkMRMLScalarVolumeNode()
 void vtkMRMLScalarVolumeNode::WriteXML(ostream& of, int nIndent)
 {
   Superclass::WriteXML(of, nIndent);
+
+  vtkIndent indent(nIndent);
+  of << indent << " imageDataPyramidEnabled=\"" << (this->ImageDataPyramidEnabled ? "true" : "false") << "\"";
 }
 
 //----------------------------------------------------------------------------
@@ -69,6 +158,10 @@ void vtkMRMLScalarVolumeNode::ReadXMLAttributes(const char** atts)
         this->SetAttribute("LabelMap", "1");
         }
       }
+    else if (!strcmp(attName, "imageDataPyramidEnabled"))
+      {
+      this->SetImageDataPyramidEnabled(!strcmp(attValue, "true"));
+      }
     }
 
   this->EndModify(disabledModify);
@@ -80,6 +173,11 @@ void vtkMRMLScalarVolumeNode::ReadXMLAttributes(const char** atts)
 void vtkMRMLScalarVolumeNode::Copy(vtkMRMLNode *anode)
 {
   Superclass::Copy(anode);
+  vtkMRMLScalarVolumeNode* node = vtkMRMLScalarVolumeNode::SafeDownCast(anode);
+  if (node)
+    {
+    this->SetImageDataPyramidEnabled(node->GetImageDataPyramidEnabled());
+    }
 }
 
 //-----------------------------------------------------------
@@ -112,6 +210,101 @@ vtkMRMLScalarVolumeDisplayNode* vtkMRMLScalarVolumeNode::GetScalarVolumeDisplayN
 void vtkMRMLScalarVolumeNode::PrintSelf(ostream& os, vtkIndent indent)
 {
   Superclass::PrintSelf(os,indent);
+  os << indent << "ImageDataPyramidEnabled: " << this->ImageDataPyramidEnabled << "\n";
+  os << indent << "ImageDataPyramids:\n";
+  for (std::map<int, std::vector<vtkSmartPointer<vtkImageData> > >::const_iterator it =
+    this->ImageDataPyramids.begin(); it != this->ImageDataPyramids.end(); ++it)
+    {
+    os << indent.GetNextIndent() << "Axes " << it->first << ": "
+       << it->second.size() << " levels built\n";
+    }
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLScalarVolumeNode::GetMaximumImageDataPyramidLevel(int axes)
+{
+  vtkImageData* imageData = this->GetImageData();
+  if (!imageData || !this->ImageDataPyramidEnabled)
+    {
+    return 0;
+    }
+  int dims[3];
+  imageData->GetDimensions(dims);
+  int largestDimension = 1;
+  for (int i = 0; i < 3; ++i)
+    {
+    if (axes & (1 << i))
+      {
+      largestDimension = std::max(largestDimension, dims[i]);
+      }
+    }
+  int level = 0;
+  while ((largestDimension + 1) / 2 >= 16)
+    {
+    largestDimension = (largestDimension + 1) / 2;
+    ++level;
+    }
+  return level;
+}
+
+//----------------------------------------------------------------------------
+vtkImageData* vtkMRMLScalarVolumeNode::GetImageDataPyramidLevel(int level, int axes)
+{
+  vtkImageData* imageData = this->GetImageData();
+  if (level == 0 || !imageData)
+    {
+    return imageData;
+    }
+  if (level < 0 || level > this->GetMaximumImageDataPyramidLevel(axes))
+    {
+    return NULL;
+    }
+
+  if (imageData != this->ImageDataPyramidSource
+    || imageData->GetMTime() != this->ImageDataPyramidSourceMTime)
+    {
+    this->ImageDataPyramids.clear();
+    this->ImageDataPyramidSource = imageData;
+    this->ImageDataPyramidSourceMTime = imageData->GetMTime();
+    }
+
+  std::vector<vtkSmartPointer<vtkImageData> >& pyramid = this->ImageDataPyramids[axes & AllAxes];
+  bool average = this->GetImageDataPyramidAveraging();
+  while (static_cast<int>(pyramid.size()) < level)
+    {
+    vtkImageData* input = pyramid.empty() ? imageData : pyramid.back().GetPointer();
+    int inDims[3];
+    input->GetDimensions(inDims);
+    double* inSpacing = input->GetSpacing();
+    double* inOrigin = input->GetOrigin();
+    int factors[3];
+    int outDims[3];
+    double outSpacing[3];
+    double outOrigin[3];
+    for (int i = 0; i < 3; ++i)
+      {
+      factors[i] = ((axes & (1 << i)) && inDims[i] > 1 ? 2 : 1);
+      outDims[i] = (inDims[i] + factors[i] - 1) / factors[i];
+      outSpacing[i] = inSpacing[i] * factors[i];
+      // averaged voxels are at the center of the blocks
+      outOrigin[i] = inOrigin[i] + (average ? (factors[i] - 1) * 0.5 * inSpacing[i] : 0.0);
+      }
+    vtkSmartPointer<vtkImageData> output = vtkSmartPointer<vtkImageData>::New();
+    output->SetDimensions(outDims);
+    output->SetSpacing(outSpacing);
+    output->SetOrigin(outOrigin);
+    output->AllocateScalars(input->GetScalarType(), input->GetNumberOfScalarComponents());
+    switch (input->GetScalarType())
+      {
+      vtkTemplateMacro(DownsampleImage(input, output, factors, average, static_cast<VTK_TT*>(0)));
+      default:
+        vtkErrorMacro("GetImageDataPyramidLevel: unsupported scalar type "
+                      << input->GetScalarTypeAsString());
+        return NULL;
+      }
+    pyramid.push_back(output);
+    }
+  return pyramid[level - 1];
 }
 
 //---------------------------------------------------------------------------
@@ -19,6 +19,13 @@
 #include "vtkMRMLVolumeNode.h"
 class vtkMRMLScalarVolumeDisplayNode;
 
+// VTK includes
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <map>
+#include <vector>
+
 /// \brief MRML node for representing a volume (image stack).
 ///
 /// Volume nodes describe data sets that can be thought of as stacks of 2D
@@ -71,9 +78,57 @@ class VTK_MRML_EXPORT vtkMRMLScalarVolumeNode : public vtkMRMLVolumeNode
   /// Create and observe default display node
   virtual void CreateDefaultDisplayNodes();
 
+  ///
+  /// Enable the multi-resolution representation of the image data, used by
+  /// the slice views to reslice a coarser image when they are zoomed out.
+  /// Disabled by default; the levels are only built when requested.
+  vtkGetMacro(ImageDataPyramidEnabled, bool);
+  vtkSetMacro(ImageDataPyramidEnabled, bool);
+  vtkBooleanMacro(ImageDataPyramidEnabled, bool);
+
+  /// IJK axes downsampled in a pyramid, can be combined.
+  enum
+    {
+    AxisI = 1,
+    AxisJ = 2,
+    AxisK = 4,
+    AllAxes = AxisI | AxisJ | AxisK
+    };
+
+  ///
+  /// Return the image data downsampled by 2^level along the given axes
+  /// (combination of AxisI, AxisJ and AxisK) that have more than one voxel,
+  /// or the image data itself for level 0. The slice views only downsample
+  /// the axes that are in the slice plane. Level n is built from level n-1
+  /// on first request and all levels are discarded when the image data is
+  /// modified. The origin and spacing of a level are set so that it covers
+  /// the same region as the image data, i.e. it can be resliced with the
+  /// same transform.
+  /// Return NULL if there is no image data, if the pyramid is disabled
+  /// and level > 0, or if level is greater than GetMaximumImageDataPyramidLevel().
+  vtkImageData* GetImageDataPyramidLevel(int level, int axes = AllAxes);
+
+  ///
+  /// Coarsest level of the pyramid of the given axes: its largest
+  /// downsampled dimension has at least 16 voxels.
+  int GetMaximumImageDataPyramidLevel(int axes = AllAxes);
+
 protected:
   vtkMRMLScalarVolumeNode();
   ~vtkMRMLScalarVolumeNode();
+
+  ///
+  /// Return true if voxels are averaged when building the pyramid, false if
+  /// they are subsampled (e.g. for labels).
+  virtual bool GetImageDataPyramidAveraging() { return true; }
+
+  bool ImageDataPyramidEnabled;
+  /// Levels 1 to n of the pyramid of each combination of axes, level 0 is
+  /// the image data
+  std::map<int, std::vector<vtkSmartPointer<vtkImageData> > > ImageDataPyramids;
+  /// Image data and modification time the levels are built from
+  vtkImageData* ImageDataPyramidSource;
+  vtkMTimeType ImageDataPyramidSourceMTime;
   vtkMRMLScalarVolumeNode(const vtkMRMLScalarVolumeNode&);
   void operator=(const vtkMRMLScalarVolumeNode&);
 };
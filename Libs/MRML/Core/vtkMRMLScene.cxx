@@ -51,6 +51,8 @@ Version:   $Revision: 1.18 $
 #include "vtkMRMLSliceCompositeNode.h"
 #include "vtkMRMLSliceNode.h"
 #include "vtkMRMLSnapshotClipNode.h"
+#include "vtkMRMLStorableNode.h"
+#include "vtkMRMLStorageNode.h"
 #include "vtkMRMLTableNode.h"
 #include "vtkMRMLTableStorageNode.h"
 #include "vtkMRMLTableViewNode.h"
@@ -62,6 +64,7 @@ Version:   $Revision: 1.18 $
 #include "vtkMRMLVectorVolumeDisplayNode.h"
 #include "vtkMRMLViewNode.h"
 #include "vtkMRMLVolumeArchetypeStorageNode.h"
+#include "vtkMRMLVolumeNode.h"
 #include "vtkURIHandler.h"
 #include "vtkMRMLLayoutNode.h"
 
@@ -78,13 +81,24 @@ Version:   $Revision: 1.18 $
 #include "vtkMRMLVectorVolumeNode.h"
 #endif
 
+// SegmentationCore includes
+#include "vtkSegmentation.h"
+
 // VTK includes
 #include <vtkCallbackCommand.h>
 #include <vtkCollection.h>
+#include <vtkConditionVariable.h>
 #include <vtkDebugLeaks.h>
 #include <vtkErrorCode.h>
+#include <vtkImageData.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+#include <vtkNew.h>
 #include <vtkObjectFactory.h>
+#include <vtkPolyData.h>
 #include <vtkSmartPointer.h>
+#include <vtkTable.h>
+#include <vtkTimerLog.h>
 
 // VTKSYS includes
 #include <vtksys/RegularExpression.hxx>
@@ -92,14 +106,14 @@ Version:   $Revision: 1.18 $
 
 // STD includes
 #include <algorithm>
+#include <cstring>
+#include <map>
 #include <numeric>
+#include <set>
+#include <sstream>
 
 //#define MRMLSCENE_VERBOSE
 
-#ifdef MRMLSCENE_VERBOSE
-# include <vtkTimerLog.h>
-#endif
-
 vtkCxxSetObjectMacro(vtkMRMLScene, CacheManager, vtkCacheManager)
 vtkCxxSetObjectMacro(vtkMRMLScene, DataIOManager, vtkDataIOManager)
 vtkCxxSetObjectMacro(vtkMRMLScene, UserTagTable, vtkTagTable)
@@ -109,6 +123,8 @@ vtkCxxSetObjectMacro(vtkMRMLScene, URIHandlerCollection, vtkCollection)
 vtkMRMLScene::vtkMRMLScene()
 {
   this->NodeIDsMTime = 0;
+  this->NextNodeSequenceNumber = 1;
+  this->NodesByClassMTime = 0;
   this->SceneModifiedTime = 0;
 
   this->RegisteredNodeClasses.clear();
@@ -119,6 +135,14 @@ vtkMRMLScene::vtkMRMLScene()
   this->UndoStackSize = 100;
   this->UndoFlag = false;
   this->InUndo = false;
+  this->MaximumUndoStackMemorySize = 0;
+  this->NumberOfDiscardedUndoLevels = 0;
+  this->NumberOfWriteThreads = 0;
+  this->MaximumConcurrentWriteSize = static_cast<vtkIdType>(1024) * 1024 * 1024;
+  this->LastSaveStateForUndoTime = 0.;
+  this->LastUndoTime = 0.;
+  this->LastRedoTime = 0.;
+  this->UndoSceneNodesMTime = 0;
 
   this->NodeReferences.clear();
   this->ReferencedIDChanges.clear();
@@ -1188,10 +1212,12 @@ vtkMRMLNode*  vtkMRMLScene::AddNodeNoNotify(vtkMRMLNode *n)
     n->SetName(this->GenerateUniqueName(n).c_str());
     }
   n->SetScene( this );
+  this->UpdateNodesByClass();
   this->Nodes->vtkCollection::AddItem((vtkObject *)n);
 
   // cache the node so the whole scene cache stays up-todate
   this->AddNodeID(n);
+  this->AddNodeToNodesByClass(n);
 
   //n->OnNodeAddedToScene();
 
@@ -1321,10 +1347,12 @@ void vtkMRMLScene::RemoveNode(vtkMRMLNode *n)
     {
     n->SetScene(0);
     }
+  this->UpdateNodesByClass();
   this->Nodes->vtkCollection::RemoveItem((vtkObject *)n);
 
   std::string nid=n->GetID();
   this->RemoveNodeID(n->GetID());
+  this->RemoveNodeFromNodesByClass(n);
 
   this->InvokeEvent(vtkMRMLScene::NodeRemovedEvent, n);
 
@@ -1500,18 +1528,7 @@ int vtkMRMLScene::GetNumberOfNodesByClass(const char *className)
     vtkErrorMacro("GetNumberOfNodesByClass: class name is null.");
     return 0;
     }
-  int num=0;
-  vtkMRMLNode *node;
-  vtkCollectionSimpleIterator it;
-  for (this->Nodes->InitTraversal(it);
-       (node = (vtkMRMLNode*)this->Nodes->GetNextItemAsObject(it)) ;)
-    {
-    if (node->IsA(className))
-      {
-      num++;
-      }
-    }
-  return num;
+  return static_cast<int>(this->GetNodeClassIndex(className).Nodes.size());
 }
 
 //------------------------------------------------------------------------------
@@ -1522,15 +1539,12 @@ int vtkMRMLScene::GetNodesByClass(const char *className, std::vector<vtkMRMLNode
     vtkErrorMacro("GetNodesByClass: class name is null.");
     return 0;
     }
-  vtkMRMLNode *node;
-  vtkCollectionSimpleIterator it;
-  for (this->Nodes->InitTraversal(it);
-       (node = (vtkMRMLNode*)this->Nodes->GetNextItemAsObject(it)) ;)
+  const NodeClassIndexType& classIndex = this->GetNodeClassIndex(className);
+  nodes.reserve(nodes.size() + classIndex.Nodes.size());
+  for (std::map< unsigned long, vtkMRMLNode* >::const_iterator it = classIndex.Nodes.begin();
+       it != classIndex.Nodes.end(); ++it)
     {
-    if (node->IsA(className))
-      {
-      nodes.push_back(node);
-      }
+    nodes.push_back(it->second);
     }
   return static_cast<int>(nodes.size());
 }
@@ -1544,15 +1558,11 @@ vtkCollection* vtkMRMLScene::GetNodesByClass(const char *className)
     return 0;
     }
   vtkCollection* nodes = vtkCollection::New();
-  vtkMRMLNode *node;
-  vtkCollectionSimpleIterator it;
-  for (this->Nodes->InitTraversal(it);
-       (node = (vtkMRMLNode*)this->Nodes->GetNextItemAsObject(it)) ;)
+  const NodeClassIndexType& classIndex = this->GetNodeClassIndex(className);
+  for (std::map< unsigned long, vtkMRMLNode* >::const_iterator it = classIndex.Nodes.begin();
+       it != classIndex.Nodes.end(); ++it)
     {
-    if (node->IsA(className))
-      {
-      nodes->AddItem(node);
-      }
+    nodes->AddItem(it->second);
     }
   return nodes;
 }
@@ -1583,20 +1593,14 @@ vtkMRMLNode *vtkMRMLScene::GetNextNodeByClass(const char *className)
     return NULL;
     }
 
-  vtkMRMLNode *node = (vtkMRMLNode*)this->Nodes->GetNextItemAsObject();
-
+  // The traversal uses the collection position so that it can be mixed
+  // with GetNextNode()
+  vtkMRMLNode *node = vtkMRMLNode::SafeDownCast(this->Nodes->GetNextItemAsObject());
   while (node != NULL && !node->IsA(className))
     {
-    node = (vtkMRMLNode*)this->Nodes->GetNextItemAsObject();
-    }
-  if (node != NULL && node->IsA(className))
-    {
-    return node;
-    }
-  else
-    {
-    return NULL;
+    node = vtkMRMLNode::SafeDownCast(this->Nodes->GetNextItemAsObject());
     }
+  return node;
 }
 //------------------------------------------------------------------------------
 vtkMRMLNode* vtkMRMLScene::GetSingletonNode(const char* singletonTag, const char* className)
@@ -1612,13 +1616,12 @@ vtkMRMLNode* vtkMRMLScene::GetSingletonNode(const char* singletonTag, const char
     return NULL;
     }
 
-  vtkCollectionSimpleIterator it;
-  vtkMRMLNode* node = NULL;
-  for (this->Nodes->InitTraversal(it);
-       (node = (vtkMRMLNode*)this->Nodes->GetNextItemAsObject(it)) ;)
+  const NodeClassIndexType& classIndex = this->GetNodeClassIndex(className);
+  for (std::map< unsigned long, vtkMRMLNode* >::const_iterator it = classIndex.Nodes.begin();
+       it != classIndex.Nodes.end(); ++it)
     {
-    if (node->IsA(className) &&
-        node->GetSingletonTag() != NULL &&
+    vtkMRMLNode* node = it->second;
+    if (node->GetSingletonTag() != NULL &&
         strcmp(node->GetSingletonTag(), singletonTag) == 0)
       {
       return node;
@@ -1688,22 +1691,24 @@ vtkMRMLNode* vtkMRMLScene::GetNthNodeByClass(int n, const char *className)
     return NULL;
     }
 
-  int num=0;
-  vtkMRMLNode *node;
-  vtkCollectionSimpleIterator it;
-  for (this->Nodes->InitTraversal(it);
-       (node = (vtkMRMLNode*)this->Nodes->GetNextItemAsObject(it)) ;)
+  NodeClassIndexType& classIndex = this->GetNodeClassIndex(className);
+  if (n >= static_cast<int>(classIndex.Nodes.size()))
     {
-    if (node->IsA(className))
+    return NULL;
+    }
+  if (classIndex.NthNodeCache.size() != classIndex.Nodes.size())
+    {
+    // Callers usually iterate over all the nodes of a class, make the
+    // following calls constant time.
+    classIndex.NthNodeCache.clear();
+    classIndex.NthNodeCache.reserve(classIndex.Nodes.size());
+    for (std::map< unsigned long, vtkMRMLNode* >::const_iterator it = classIndex.Nodes.begin();
+         it != classIndex.Nodes.end(); ++it)
       {
-      if (num == n)
-        {
-        return node;
-        }
-      num++;
+      classIndex.NthNodeCache.push_back(it->second);
       }
     }
-  return NULL;
+  return classIndex.NthNodeCache[n];
 }
 
 //------------------------------------------------------------------------------
@@ -1844,11 +1849,12 @@ vtkCollection* vtkMRMLScene::GetNodesByClassByName(const char* className, const
     return nodes;
     }
 
-  vtkMRMLNode *node;
-  for (int n=0; n < this->Nodes->GetNumberOfItems(); n++)
+  const NodeClassIndexType& classIndex = this->GetNodeClassIndex(className);
+  for (std::map< unsigned long, vtkMRMLNode* >::const_iterator it = classIndex.Nodes.begin();
+       it != classIndex.Nodes.end(); ++it)
     {
-    node = (vtkMRMLNode*)this->Nodes->GetItemAsObject(n);
-    if (!strcmp(node->GetName(), name) && node->IsA(className))
+    vtkMRMLNode* node = it->second;
+    if (node->GetName() && !strcmp(node->GetName(), name))
       {
       nodes->AddItem(node);
       }
@@ -2035,6 +2041,15 @@ void vtkMRMLScene::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "ErrorCode = " << this->ErrorCode << "\n";
   os << indent << "URL = " << this->GetURL() << "\n";
   os << indent << "Root Directory = " << this->GetRootDirectory() << "\n";
+  os << indent << "UndoStackSize = " << this->UndoStackSize << "\n";
+  os << indent << "MaximumUndoStackMemorySize = " << this->MaximumUndoStackMemorySize << "\n";
+  os << indent << "UndoStackMemorySize = " << this->GetUndoStackMemorySize() << "\n";
+  os << indent << "NumberOfDiscardedUndoLevels = " << this->NumberOfDiscardedUndoLevels << "\n";
+  os << indent << "NumberOfWriteThreads = " << this->NumberOfWriteThreads << "\n";
+  os << indent << "MaximumConcurrentWriteSize = " << this->MaximumConcurrentWriteSize << "\n";
+  os << indent << "LastSaveStateForUndoTime = " << this->LastSaveStateForUndoTime << "\n";
+  os << indent << "LastUndoTime = " << this->LastUndoTime << "\n";
+  os << indent << "LastRedoTime = " << this->LastRedoTime << "\n";
 
   this->Nodes->vtkCollection::PrintSelf(os,indent);
   std::list<std::string> classes = this->GetNodeClassesList();
@@ -2268,11 +2283,24 @@ void vtkMRMLScene::RemoveReservedIDs()
 }
 
 //------------------------------------------------------------------------------
-// Pushes the current scene onto the undo stack, and makes a backup copy of the
-// passed node so that changes to the node are undoable; several signatures to handle
-// individual nodes or a vtkCollection of nodes, or a vector of nodes
-//
 void vtkMRMLScene::SaveStateForUndo (vtkMRMLNode *node)
+{
+  std::vector<vtkMRMLNode *> nodes;
+  if (node)
+    {
+    nodes.push_back(node);
+    }
+  this->SaveNodesStateForUndo(nodes);
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLScene::SaveStateForUndo (std::vector<vtkMRMLNode *> nodes)
+{
+  this->SaveNodesStateForUndo(nodes);
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLScene::SaveStateForUndo (vtkCollection* nodes)
 {
   if (!this->UndoFlag)
     {
@@ -2289,48 +2317,49 @@ void vtkMRMLScene::SaveStateForUndo (vtkMRMLNode *node)
     return;
     }
 
-  this->ClearRedoStack();
-  //this->SetUndoOn();
-  this->PushIntoUndoStack();
-  if ( node && !node->IsA("vtkMRMLSceneViewNode"))
+  if (!nodes)
+    {
+    return;
+    }
+
+  std::vector<vtkMRMLNode *> nodeVector;
+  nodeVector.reserve(nodes->GetNumberOfItems());
+  vtkObject* object;
+  vtkCollectionSimpleIterator it;
+  for (nodes->InitTraversal(it); (object = nodes->GetNextItemAsObject(it)) ;)
     {
-    this->CopyNodeInUndoStack(node);
+    vtkMRMLNode* node = vtkMRMLNode::SafeDownCast(object);
+    if (node)
+      {
+      nodeVector.push_back(node);
+      }
     }
+  this->SaveNodesStateForUndo(nodeVector);
 }
 
 //------------------------------------------------------------------------------
-void vtkMRMLScene::SaveStateForUndo (std::vector<vtkMRMLNode *> nodes)
+void vtkMRMLScene::SaveStateForUndo ()
 {
   if (!this->UndoFlag)
     {
     return;
     }
 
-  if (this->InUndo )
-    {
-    return;
-    }
   if (this->IsBatchProcessing())
     {
     return;
     }
-
-  this->ClearRedoStack();
-  //this->SetUndoOn();
-  this->PushIntoUndoStack();
-  unsigned int n;
-  for (n=0; n<nodes.size(); n++)
+  if (this->Nodes)
     {
-    vtkMRMLNode *node = nodes[n];
-    if (node && !node->IsA("vtkMRMLSceneViewNode"))
-      {
-      this->CopyNodeInUndoStack(node);
-      }
+    this->SaveStateForUndo(this->Nodes);
     }
 }
 
 //------------------------------------------------------------------------------
-void vtkMRMLScene::SaveStateForUndo (vtkCollection* nodes)
+// Pushes the current scene onto the undo stack, and makes a backup copy of the
+// passed nodes so that changes to the nodes are undoable. Nodes that have not
+// been modified since the previous state share their copy with it.
+void vtkMRMLScene::SaveNodesStateForUndo(const std::vector<vtkMRMLNode *>& nodes)
 {
   if (!this->UndoFlag)
     {
@@ -2347,99 +2376,196 @@ void vtkMRMLScene::SaveStateForUndo (vtkCollection* nodes)
     return;
     }
 
-  if (!nodes)
-    {
-    return;
-    }
+  double startTime = vtkTimerLog::GetUniversalTime();
 
   this->ClearRedoStack();
-  //this->SetUndoOn();
   this->PushIntoUndoStack();
-
-  int nnodes = nodes->GetNumberOfItems();
-
-  for (int n=0; n<nnodes; n++)
+  for (std::vector<vtkMRMLNode *>::const_iterator nodeIt = nodes.begin();
+       nodeIt != nodes.end(); ++nodeIt)
     {
-    vtkMRMLNode *node  = dynamic_cast < vtkMRMLNode *>(nodes->GetItemAsObject(n));
+    vtkMRMLNode *node = *nodeIt;
     if (node && !node->IsA("vtkMRMLSceneViewNode"))
       {
       this->CopyNodeInUndoStack(node);
       }
     }
+  this->TrimUndoStack();
+
+  this->LastSaveStateForUndoTime = vtkTimerLog::GetUniversalTime() - startTime;
 }
 
 //------------------------------------------------------------------------------
-void vtkMRMLScene::SaveStateForUndo ()
+vtkCollection* vtkMRMLScene::GetUndoSceneNodes()
 {
-  if (!this->UndoFlag)
+  if (this->UndoSceneNodes.GetPointer() == NULL
+    || this->Nodes->GetMTime() > this->UndoSceneNodesMTime)
     {
-    return;
+    // Nodes have been added or removed since the last state was pushed,
+    // the list can't be shared anymore.
+    this->UndoSceneNodes = vtkSmartPointer<vtkCollection>::New();
+    vtkMRMLNode *node;
+    vtkCollectionSimpleIterator it;
+    for (this->Nodes->InitTraversal(it);
+         (node = (vtkMRMLNode*)this->Nodes->GetNextItemAsObject(it)) ;)
+      {
+      if (!node->IsA("vtkMRMLSceneViewNode"))
+        {
+        this->UndoSceneNodes->AddItem(node);
+        }
+      }
+    this->UndoSceneNodesMTime = this->Nodes->GetMTime();
     }
+  return this->UndoSceneNodes;
+}
 
-  if (this->IsBatchProcessing())
+//------------------------------------------------------------------------------
+// Make a new state that has pointers to all the nodes in the current scene
+void vtkMRMLScene::PushIntoUndoStack()
+{
+  if (this->Nodes == NULL)
     {
     return;
     }
-  if (this->Nodes)
-    {
-    this->SaveStateForUndo(this->Nodes);
-    }
+  UndoStateType state;
+  state.SceneNodes = this->GetUndoSceneNodes();
+  this->UndoStack.push_back(state);
 }
 
 //------------------------------------------------------------------------------
-// Make a new collection that has pointers to all the nodes in the current scene
-void vtkMRMLScene::PushIntoUndoStack()
+// Make a new state that has pointers to the current scene nodes
+void vtkMRMLScene::PushIntoRedoStack()
 {
   if (this->Nodes == NULL)
     {
     return;
     }
+  UndoStateType state;
+  state.SceneNodes = this->GetUndoSceneNodes();
+  this->RedoStack.push_back(state);
+}
 
-  vtkCollection* newScene = vtkCollection::New();
-
-  vtkCollection* currentScene = this->Nodes;
-
-  int nnodes = currentScene->GetNumberOfItems();
-
-  for (int n=0; n<nnodes; n++)
+//------------------------------------------------------------------------------
+void vtkMRMLScene::GetUndoStateNodes(const UndoStateType& state,
+                                     std::vector<std::string>& ids,
+                                     std::vector<vtkMRMLNode*>& nodes)
+{
+  if (state.SceneNodes.GetPointer() == NULL)
     {
-    vtkMRMLNode *node  = dynamic_cast < vtkMRMLNode *>(currentScene->GetItemAsObject(n));
-    if (node && !node->IsA("vtkMRMLSceneViewNode"))
+    return;
+    }
+  vtkMRMLNode *node;
+  vtkCollectionSimpleIterator it;
+  for (state.SceneNodes->InitTraversal(it);
+       (node = (vtkMRMLNode*)state.SceneNodes->GetNextItemAsObject(it)) ;)
+    {
+    if (!node->GetID())
       {
-      newScene->AddItem(node);
+      continue;
       }
+    std::map< std::string, UndoNodeCopyType >::const_iterator copyIt =
+      state.NodeCopies.find(node->GetID());
+    ids.push_back(node->GetID());
+    nodes.push_back(copyIt != state.NodeCopies.end() ? copyIt->second.Node.GetPointer() : node);
     }
+}
 
-  //TODO check max stack size
-  this->UndoStack.push_back(newScene);
+//------------------------------------------------------------------------------
+namespace
+{
+vtkIdType EstimateStringMemorySize(const char* str)
+{
+  return str ? static_cast<vtkIdType>(strlen(str) + 1) : 0;
 }
 
 //------------------------------------------------------------------------------
-// Make a new collection that has pointers to the current scene nodes
-void vtkMRMLScene::PushIntoRedoStack()
+vtkIdType EstimateNodeCopyMemorySize(vtkMRMLNode* node)
 {
-  if (this->Nodes == NULL)
+  // Bulk data (polydata, image data...) is shared by the copies, only the
+  // node properties and the data objects that are deep copied are accounted
+  // for. The estimate must stay cheap as it is computed for every copy.
+  const vtkIdType nodeObjectMemorySize = 1024;
+  vtkIdType memorySize = nodeObjectMemorySize;
+  memorySize += EstimateStringMemorySize(node->GetID());
+  memorySize += EstimateStringMemorySize(node->GetName());
+  memorySize += EstimateStringMemorySize(node->GetDescription());
+  std::vector< std::string > attributeNames = node->GetAttributeNames();
+  for (std::vector< std::string >::iterator it = attributeNames.begin();
+       it != attributeNames.end(); ++it)
+    {
+    memorySize += static_cast<vtkIdType>(it->size() + 1);
+    memorySize += EstimateStringMemorySize(node->GetAttribute(it->c_str()));
+    }
+  for (int roleIndex = 0; roleIndex < node->GetNumberOfNodeReferenceRoles(); ++roleIndex)
+    {
+    const char* role = node->GetNthNodeReferenceRole(roleIndex);
+    memorySize += EstimateStringMemorySize(role);
+    for (int refIndex = 0; refIndex < node->GetNumberOfNodeReferences(role); ++refIndex)
+      {
+      memorySize += EstimateStringMemorySize(node->GetNthNodeReferenceID(role, refIndex));
+      }
+    }
+  // Tables are deep copied (see vtkMRMLTableNode::Copy)
+  vtkMRMLTableNode* tableNode = vtkMRMLTableNode::SafeDownCast(node);
+  if (tableNode && tableNode->GetTable())
     {
-    return;
+    // GetActualMemorySize() is in kibibytes
+    memorySize += static_cast<vtkIdType>(tableNode->GetTable()->GetActualMemorySize()) * 1024;
     }
+  return memorySize;
+}
+}
 
-  vtkCollection* newScene = vtkCollection::New();
-
-  vtkCollection* currentScene = this->Nodes;
-
-  int nnodes = currentScene->GetNumberOfItems();
-
-  for (int n=0; n<nnodes; n++)
+//------------------------------------------------------------------------------
+void vtkMRMLScene::CopyNodeInState(vtkMRMLNode *node, UndoStateType& state,
+                                   UndoStateType* previousState,
+                                   bool singleModifiedEvent)
+{
+  if (!node->GetID() || this->GetNodeByID(node->GetID()) != node)
     {
-    vtkMRMLNode *node  = dynamic_cast < vtkMRMLNode *>(currentScene->GetItemAsObject(n));
-    if (node && !node->IsA("vtkMRMLSceneViewNode"))
+    // node is not in the scene, there is nothing to restore
+    return;
+    }
+  std::string nodeID = node->GetID();
+  if (state.NodeCopies.find(nodeID) != state.NodeCopies.end())
+    {
+    // already saved in this state
+    return;
+    }
+  if (previousState)
+    {
+    std::map< std::string, UndoNodeCopyType >::iterator previousCopyIt =
+      previousState->NodeCopies.find(nodeID);
+    if (previousCopyIt != previousState->NodeCopies.end()
+      && previousCopyIt->second.SourceMTime == node->GetMTime()
+      && strcmp(previousCopyIt->second.Node->GetClassName(), node->GetClassName()) == 0)
       {
-      newScene->AddItem(node);
+      // The node has not been modified since the previous state, share the copy.
+      UndoNodeCopyType sharedCopy = previousCopyIt->second;
+      sharedCopy.SharedWithPreviousState = true;
+      state.NodeCopies[nodeID] = sharedCopy;
+      return;
       }
     }
 
-  //TODO check max stack size
-  this->RedoStack.push_back(newScene);
+  UndoNodeCopyType copy;
+  copy.Node = vtkSmartPointer<vtkMRMLNode>::Take(node->CreateNodeInstance());
+  if (copy.Node.GetPointer() == NULL)
+    {
+    vtkErrorMacro("CopyNodeInState: failed to create an instance of " << node->GetClassName());
+    return;
+    }
+  copy.SourceMTime = node->GetMTime();
+  if (singleModifiedEvent)
+    {
+    copy.Node->CopyWithSceneWithSingleModifiedEvent(node);
+    }
+  else
+    {
+    copy.Node->CopyWithScene(node);
+    }
+  copy.MemorySize = EstimateNodeCopyMemorySize(copy.Node);
+  state.NodeCopies[nodeID] = copy;
+  state.NodeCopiesMemorySize += copy.MemorySize;
 }
 
 //------------------------------------------------------------------------------
@@ -2452,24 +2578,16 @@ void vtkMRMLScene::CopyNodeInUndoStack(vtkMRMLNode *copyNode)
     vtkErrorMacro("CopyNodeInUndoStack: node is null");
     return;
     }
-
-  vtkMRMLNode *snode = copyNode->CreateNodeInstance();
-  if (snode != NULL)
+  if (this->UndoStack.empty())
     {
-    snode->CopyWithScene(copyNode);
+    return;
     }
-  vtkCollection* undoScene = dynamic_cast < vtkCollection *>( this->UndoStack.back() );
-  int nnodes = undoScene->GetNumberOfItems();
-  for (int n=0; n<nnodes; n++)
+  UndoStateType* previousState = NULL;
+  if (this->UndoStack.size() > 1)
     {
-    vtkMRMLNode *node  = dynamic_cast < vtkMRMLNode *>(undoScene->GetItemAsObject(n));
-    if (node == copyNode)
-      {
-      undoScene->ReplaceItem (n, snode);
-      break;
-      }
+    previousState = &(*(++this->UndoStack.rbegin()));
     }
-  snode->Delete();
+  this->CopyNodeInState(copyNode, this->UndoStack.back(), previousState, false);
 }
 
 //------------------------------------------------------------------------------
@@ -2482,23 +2600,90 @@ void vtkMRMLScene::CopyNodeInRedoStack(vtkMRMLNode *copyNode)
     vtkErrorMacro("CopyNodeInRedoStack: node is null");
     return;
     }
-  vtkMRMLNode *snode = copyNode->CreateNodeInstance();
-  if (snode != NULL)
+  if (this->RedoStack.empty())
+    {
+    return;
+    }
+  this->CopyNodeInState(copyNode, this->RedoStack.back(), NULL, true);
+}
+
+//------------------------------------------------------------------------------
+vtkIdType vtkMRMLScene::GetStackMemorySize(const UndoStackType& stack)
+{
+  vtkIdType memorySize = 0;
+  vtkCollection* previousSceneNodes = NULL;
+  for (UndoStackType::const_iterator stateIt = stack.begin(); stateIt != stack.end(); ++stateIt)
+    {
+    memorySize += sizeof(UndoStateType) + stateIt->NodeCopiesMemorySize;
+    if (stateIt->SceneNodes.GetPointer() != previousSceneNodes)
+      {
+      previousSceneNodes = stateIt->SceneNodes.GetPointer();
+      memorySize += previousSceneNodes->GetNumberOfItems() * static_cast<vtkIdType>(sizeof(vtkCollectionElement));
+      }
+    }
+  return memorySize;
+}
+
+//------------------------------------------------------------------------------
+vtkIdType vtkMRMLScene::GetUndoStackMemorySize()
+{
+  return this->GetStackMemorySize(this->UndoStack)
+    + this->GetStackMemorySize(this->RedoStack);
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLScene::SetUndoStackSize(int size)
+{
+  if (this->UndoStackSize == size)
+    {
+    return;
+    }
+  this->UndoStackSize = size;
+  this->TrimUndoStack();
+  this->Modified();
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLScene::SetMaximumUndoStackMemorySize(vtkIdType size)
+{
+  if (this->MaximumUndoStackMemorySize == size)
     {
-    snode->CopyWithSceneWithSingleModifiedEvent(copyNode);
+    return;
     }
-  vtkCollection* undoScene = dynamic_cast < vtkCollection *>( this->RedoStack.back() );
-  int nnodes = undoScene->GetNumberOfItems();
-  for (int n=0; n<nnodes; n++)
+  this->MaximumUndoStackMemorySize = size;
+  this->TrimUndoStack();
+  this->Modified();
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLScene::TrimUndoStack()
+{
+  while (this->UndoStack.size() > 1)
     {
-    vtkMRMLNode *node  = dynamic_cast < vtkMRMLNode *>(undoScene->GetItemAsObject(n));
-    if (node == copyNode)
+    bool tooManyLevels = (this->UndoStackSize > 0
+      && static_cast<int>(this->UndoStack.size()) > this->UndoStackSize);
+    bool tooMuchMemory = (this->MaximumUndoStackMemorySize > 0
+      && this->GetUndoStackMemorySize() > this->MaximumUndoStackMemorySize);
+    if (!tooManyLevels && !tooMuchMemory)
       {
-      undoScene->ReplaceItem (n, snode);
       break;
       }
+    // Discard the least recently saved state
+    this->UndoStack.pop_front();
+    ++this->NumberOfDiscardedUndoLevels;
+    // Copies that were shared with the discarded state are now owned by the
+    // oldest state.
+    UndoStateType& oldestState = this->UndoStack.front();
+    for (std::map< std::string, UndoNodeCopyType >::iterator copyIt = oldestState.NodeCopies.begin();
+         copyIt != oldestState.NodeCopies.end(); ++copyIt)
+      {
+      if (copyIt->second.SharedWithPreviousState)
+        {
+        copyIt->second.SharedWithPreviousState = false;
+        oldestState.NodeCopiesMemorySize += copyIt->second.MemorySize;
+        }
+      }
     }
-  snode->Delete();
 }
 
 //------------------------------------------------------------------------------
@@ -2516,6 +2701,8 @@ void vtkMRMLScene::Undo()
     return;
     }
 
+  double startTime = vtkTimerLog::GetUniversalTime();
+
   this->RemoveUnusedNodeReferences();
 
   this->InUndo = true;
@@ -2542,24 +2729,20 @@ void vtkMRMLScene::Undo()
       }
     }
 
-  vtkCollection* undoScene = NULL;
+  // Copy the state (node copies are shared) in case the stack is modified
+  // while restoring nodes.
+  const UndoStateType undoState = this->UndoStack.back();
   std::vector<std::string> undoIDs;
   std::vector<vtkMRMLNode*> undoNodes;
+  this->GetUndoStateNodes(undoState, undoIDs, undoNodes);
 
-  if (!this->UndoStack.empty())
+  // Index the IDs to avoid quadratic lookups in large scenes
+  std::map<std::string, size_t> currentIDIndices;
+  for (size_t i = 0; i < currentIDs.size(); ++i)
     {
-    undoScene = dynamic_cast < vtkCollection *>( this->UndoStack.back() );
-    nnodes = undoScene->GetNumberOfItems();
-    for (n=0; n<nnodes; n++)
-      {
-      vtkMRMLNode *node  = dynamic_cast < vtkMRMLNode *>(undoScene->GetItemAsObject(n));
-      if (node && !node->IsA("vtkMRMLSceneViewNode"))
-        {
-        undoIDs.push_back(node->GetID());
-        undoNodes.push_back(node);
-        }
-      }
+    currentIDIndices[currentIDs[i]] = i;
     }
+  std::set<std::string> undoIDSet(undoIDs.begin(), undoIDs.end());
 
   std::vector<std::string>::iterator iterID;
   std::vector<vtkMRMLNode*>::iterator iterNode;
@@ -2567,23 +2750,23 @@ void vtkMRMLScene::Undo()
   std::vector<vtkMRMLNode*>::iterator curIterNode;
 
   // copy back changes and add deleted nodes to the current scene
-  std::vector<vtkMRMLNode*> addNodes;
+  std::vector< vtkSmartPointer<vtkMRMLNode> > addNodes;
 
   for(iterID=undoIDs.begin(), iterNode = undoNodes.begin(); iterID != undoIDs.end(); iterID++, iterNode++)
     {
-    curIterID = std::find(currentIDs.begin(), currentIDs.end(), *iterID);
-    curIterNode = currentNodes.begin() + std::distance(currentIDs.begin(), curIterID);
-    if ( curIterID == currentIDs.end() )
+    std::map<std::string, size_t>::const_iterator currentIDIndexIt = currentIDIndices.find(*iterID);
+    if ( currentIDIndexIt == currentIDIndices.end() )
       {
       // the node was deleted, add Node back to the curreent scene
-      addNodes.push_back(*iterNode);
+      addNodes.push_back(this->GetNodeToRestore(undoState, *iterID, *iterNode));
       }
-    else if (*iterNode != *curIterNode)
+    else if (*iterNode != currentNodes[currentIDIndexIt->second])
       {
       // nodes differ, copy from undo to current scene
       // but before create a copy in redo stack from current
-      this->CopyNodeInRedoStack(*curIterNode);
-      (*curIterNode)->CopyWithSceneWithSingleModifiedEvent(*iterNode);
+      vtkMRMLNode* currentNode = currentNodes[currentIDIndexIt->second];
+      this->CopyNodeInRedoStack(currentNode);
+      currentNode->CopyWithSceneWithSingleModifiedEvent(*iterNode);
       }
     }
 
@@ -2591,9 +2774,8 @@ void vtkMRMLScene::Undo()
   std::vector<vtkMRMLNode*> removeNodes;
   for(curIterID=currentIDs.begin(), curIterNode = currentNodes.begin(); curIterID != currentIDs.end(); curIterID++, curIterNode++)
     {
-    iterID = std::find(undoIDs.begin(),undoIDs.end(), *curIterID);
     // Remove only if the node is not present in the previous state.
-    if ( iterID == undoIDs.end() )
+    if ( undoIDSet.find(*curIterID) == undoIDSet.end() )
       {
       removeNodes.push_back(*curIterNode);
       }
@@ -2614,12 +2796,6 @@ void vtkMRMLScene::Undo()
       }
     }
 
-  if (undoScene)
-    {
-    undoScene->RemoveAllItems();
-    undoScene->Delete();
-    }
-
   this->RemoveUnusedNodeReferences();
 
   if (!this->UndoStack.empty())
@@ -2629,6 +2805,8 @@ void vtkMRMLScene::Undo()
   this->Modified();
 
   this->InUndo = false;
+
+  this->LastUndoTime = vtkTimerLog::GetUniversalTime() - startTime;
 }
 
 //------------------------------------------------------------------------------
@@ -2644,6 +2822,8 @@ void vtkMRMLScene::Redo()
     return;
     }
 
+  double startTime = vtkTimerLog::GetUniversalTime();
+
   int nnodes;
   int n;
   unsigned int nn;
@@ -2668,20 +2848,13 @@ void vtkMRMLScene::Redo()
   //std::hash_map<std::string, vtkMRMLNode*> undoMap;
   std::map<std::string, vtkMRMLNode*> undoMap;
 
-  vtkCollection* undoScene = NULL;
-
-  if (!this->RedoStack.empty())
+  const UndoStateType redoState = this->RedoStack.back();
+  std::vector<std::string> redoIDs;
+  std::vector<vtkMRMLNode*> redoNodes;
+  this->GetUndoStateNodes(redoState, redoIDs, redoNodes);
+  for (size_t i = 0; i < redoIDs.size(); ++i)
     {
-    undoScene = dynamic_cast < vtkCollection *>( this->RedoStack.back() );;
-    nnodes = undoScene->GetNumberOfItems();
-    for (n=0; n<nnodes; n++)
-      {
-      vtkMRMLNode *node  = dynamic_cast < vtkMRMLNode *>(undoScene->GetItemAsObject(n));
-      if (node && !node->IsA("vtkMRMLSceneViewNode"))
-        {
-        undoMap[node->GetID()] = node;
-        }
-      }
+    undoMap[redoIDs[i]] = redoNodes[i];
     }
 
   //std::hash_map<std::string, vtkMRMLNode*>::iterator iter;
@@ -2690,7 +2863,7 @@ void vtkMRMLScene::Redo()
   std::map<std::string, vtkMRMLNode*>::iterator curIter;
 
   // copy back changes and add deleted nodes to the current scene
-  std::vector<vtkMRMLNode*> addNodes;
+  std::vector< vtkSmartPointer<vtkMRMLNode> > addNodes;
 
   for(iter=undoMap.begin(); iter != undoMap.end(); iter++)
     {
@@ -2698,7 +2871,7 @@ void vtkMRMLScene::Redo()
     if ( curIter == currentMap.end() )
       {
       // the node was deleted, add Node back to the curreent scene
-      addNodes.push_back(iter->second);
+      addNodes.push_back(this->GetNodeToRestore(redoState, iter->first, iter->second));
       }
     else if (iter->second != curIter->second)
       {
@@ -2729,38 +2902,41 @@ void vtkMRMLScene::Redo()
     this->RemoveNode(removeNodes[nn]);
     }
 
-  if (undoScene)
-    {
-    undoScene->RemoveAllItems();
-    undoScene->Delete();
-    }
-
   RedoStack.pop_back();
+  this->TrimUndoStack();
 
   this->Modified();
+
+  this->LastRedoTime = vtkTimerLog::GetUniversalTime() - startTime;
 }
 
 //------------------------------------------------------------------------------
-void vtkMRMLScene::ClearUndoStack()
+vtkSmartPointer<vtkMRMLNode> vtkMRMLScene::GetNodeToRestore(
+  const UndoStateType& state, const std::string& nodeID, vtkMRMLNode* stateNode)
 {
-  std::list< vtkCollection* >::iterator iter;
-  for(iter=this->UndoStack.begin(); iter != this->UndoStack.end(); iter++)
+  if (state.NodeCopies.find(nodeID) == state.NodeCopies.end())
     {
-    (*iter)->RemoveAllItems();
-    (*iter)->Delete();
+    // node that was removed from the scene
+    return stateNode;
     }
+  // The copy may be shared with other states, it must not be added to the
+  // scene as is because it would be modified there.
+  vtkSmartPointer<vtkMRMLNode> node = vtkSmartPointer<vtkMRMLNode>::Take(stateNode->CreateNodeInstance());
+  node->CopyWithScene(stateNode);
+  return node;
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLScene::ClearUndoStack()
+{
   this->UndoStack.clear();
+  this->UndoSceneNodes = NULL;
+  this->NumberOfDiscardedUndoLevels = 0;
 }
 
 //------------------------------------------------------------------------------
 void vtkMRMLScene::ClearRedoStack()
 {
-  std::list< vtkCollection* >::iterator iter;
-  for(iter=this->RedoStack.begin(); iter != this->RedoStack.end(); iter++)
-    {
-    (*iter)->RemoveAllItems();
-    (*iter)->Delete();
-    }
   this->RedoStack.clear();
 }
 
@@ -3086,6 +3262,114 @@ void vtkMRMLScene::ClearNodeIDs()
   }
 }
 
+//------------------------------------------------------------------------------
+void vtkMRMLScene::UpdateNodesByClass()
+{
+  if (this->Nodes->GetMTime() <= this->NodesByClassMTime)
+    {
+    return;
+    }
+  // The collection has been modified without updating the index (e.g. node
+  // inserted in the middle of the scene), rebuild the index from scratch.
+  // Keep the classes that have been queried so far.
+  std::vector<std::string> classNames;
+  for (NodesByClassType::const_iterator it = this->NodesByClass.begin();
+       it != this->NodesByClass.end(); ++it)
+    {
+    classNames.push_back(it->first);
+    }
+  this->ClearNodesByClass();
+  for (std::vector<std::string>::const_iterator it = classNames.begin();
+       it != classNames.end(); ++it)
+    {
+    this->NodesByClass[*it];
+    }
+
+  vtkMRMLNode *node;
+  vtkCollectionSimpleIterator it;
+  for (this->Nodes->InitTraversal(it);
+       (node = (vtkMRMLNode*)this->Nodes->GetNextItemAsObject(it)) ;)
+    {
+    this->AddNodeToNodesByClass(node);
+    }
+  this->NodesByClassMTime = this->Nodes->GetMTime();
+}
+
+//------------------------------------------------------------------------------
+vtkMRMLScene::NodeClassIndexType& vtkMRMLScene::GetNodeClassIndex(const char* className)
+{
+  this->UpdateNodesByClass();
+  NodesByClassType::iterator classIt = this->NodesByClass.find(className);
+  if (classIt != this->NodesByClass.end())
+    {
+    return classIt->second;
+    }
+  // First time the class is queried: the only time the scene is traversed.
+  NodeClassIndexType& classIndex = this->NodesByClass[className];
+  vtkMRMLNode *node;
+  vtkCollectionSimpleIterator it;
+  for (this->Nodes->InitTraversal(it);
+       (node = (vtkMRMLNode*)this->Nodes->GetNextItemAsObject(it)) ;)
+    {
+    if (node->IsA(className))
+      {
+      classIndex.Nodes[this->NodeSequenceNumbers[node]] = node;
+      }
+    }
+  return classIndex;
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLScene::AddNodeToNodesByClass(vtkMRMLNode *node)
+{
+  if (node == NULL)
+    {
+    return;
+    }
+  unsigned long sequenceNumber = this->NextNodeSequenceNumber++;
+  this->NodeSequenceNumbers[node] = sequenceNumber;
+  for (NodesByClassType::iterator it = this->NodesByClass.begin();
+       it != this->NodesByClass.end(); ++it)
+    {
+    if (node->IsA(it->first.c_str()))
+      {
+      it->second.Nodes[sequenceNumber] = node;
+      it->second.NthNodeCache.clear();
+      }
+    }
+  this->NodesByClassMTime = this->Nodes->GetMTime();
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLScene::RemoveNodeFromNodesByClass(vtkMRMLNode *node)
+{
+  std::map< vtkMRMLNode*, unsigned long >::iterator sequenceIt =
+    this->NodeSequenceNumbers.find(node);
+  if (sequenceIt != this->NodeSequenceNumbers.end())
+    {
+    unsigned long sequenceNumber = sequenceIt->second;
+    this->NodeSequenceNumbers.erase(sequenceIt);
+    for (NodesByClassType::iterator it = this->NodesByClass.begin();
+         it != this->NodesByClass.end(); ++it)
+      {
+      if (it->second.Nodes.erase(sequenceNumber) > 0)
+        {
+        it->second.NthNodeCache.clear();
+        }
+      }
+    }
+  this->NodesByClassMTime = this->Nodes->GetMTime();
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLScene::ClearNodesByClass()
+{
+  this->NodesByClass.clear();
+  this->NodeSequenceNumbers.clear();
+  this->NextNodeSequenceNumber = 1;
+  this->NodesByClassMTime = this->Nodes->GetMTime();
+}
+
 //------------------------------------------------------------------------------
 void vtkMRMLScene::AddURIHandler(vtkURIHandler *handler)
 {
@@ -3350,6 +3634,491 @@ SetStorableNodesModifiedSinceRead(vtkCollection* storableNodes)
     }
 }
 
+//-----------------------------------------------------------------------------
+namespace
+{
+
+//-----------------------------------------------------------------------------
+// Error or warning event invoked by a node while it was written
+struct vtkMRMLSceneWriteMessage
+{
+  vtkObject* Caller;
+  unsigned long Event;
+  std::string Text;
+};
+
+//-----------------------------------------------------------------------------
+struct vtkMRMLSceneWriteJob
+{
+  vtkMRMLStorableNode* Node;
+  vtkMRMLStorageNode* StorageNode;
+  vtkIdType Size;
+  // Index of the node in the nodes passed to WriteStorableNodes()
+  size_t Index;
+  // The file is written by a library that is not thread safe
+  bool Serialized;
+  bool Started;
+  bool Finished;
+  // Messages have been reported by the calling thread
+  bool Reported;
+  int Success;
+  double Progress;
+  std::vector<vtkMRMLSceneWriteMessage> Messages;
+  vtkSmartPointer<vtkCallbackCommand> EventCallback;
+};
+
+//-----------------------------------------------------------------------------
+bool IsLargerWriteJob(const vtkMRMLSceneWriteJob& job1, const vtkMRMLSceneWriteJob& job2)
+{
+  return job1.Size > job2.Size;
+}
+
+//-----------------------------------------------------------------------------
+vtkIdType GetDataObjectSize(vtkDataObject* data)
+{
+  return data ? static_cast<vtkIdType>(data->GetActualMemorySize()) * 1024 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Approximate size in bytes of the data written for the node. Only volumes,
+// models, segmentations and tables are accounted for, the data of the other
+// nodes is small.
+vtkIdType EstimateStorableNodeDataSize(vtkMRMLStorableNode* node)
+{
+  if (vtkMRMLVolumeNode* volumeNode = vtkMRMLVolumeNode::SafeDownCast(node))
+    {
+    return GetDataObjectSize(volumeNode->GetImageData());
+    }
+  if (vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(node))
+    {
+    return GetDataObjectSize(modelNode->GetPolyData());
+    }
+  if (vtkMRMLTableNode* tableNode = vtkMRMLTableNode::SafeDownCast(node))
+    {
+    return GetDataObjectSize(tableNode->GetTable());
+    }
+  vtkMRMLSegmentationNode* segmentationNode = vtkMRMLSegmentationNode::SafeDownCast(node);
+  vtkSegmentation* segmentation = segmentationNode ? segmentationNode->GetSegmentation() : 0;
+  if (!segmentation)
+    {
+    return 0;
+    }
+  // Only the master representation is written. Segments may share their
+  // labelmap, it is counted once.
+  std::string masterRepresentationName = segmentation->GetMasterRepresentationName();
+  std::set<vtkDataObject*> representations;
+  vtkIdType size = 0;
+  for (int i = 0; i < segmentation->GetNumberOfSegments(); ++i)
+    {
+    vtkDataObject* representation =
+      segmentation->GetNthSegment(i)->GetRepresentation(masterRepresentationName);
+    if (representation && representations.insert(representation).second)
+      {
+      size += GetDataObjectSize(representation);
+      }
+    }
+  return size;
+}
+
+//-----------------------------------------------------------------------------
+// The nrrd readers and writers of teem (and of ITK) report errors in a global
+// state (biff), only one nrrd file can be written at a time.
+bool IsWriteSerialized(vtkMRMLStorageNode* storageNode)
+{
+  if (!storageNode->GetFileName())
+    {
+    return false;
+    }
+  std::string extension = vtksys::SystemTools::LowerCase(
+    vtksys::SystemTools::GetFilenameLastExtension(storageNode->GetFileName()));
+  return extension == ".nrrd" || extension == ".nhdr";
+}
+
+//-----------------------------------------------------------------------------
+struct vtkMRMLSceneWriteThreadData
+{
+  std::vector<vtkMRMLSceneWriteJob>* Jobs;
+  int NumberOfRunningJobs;
+  bool SerializedJobRunning;
+  vtkIdType RunningJobsSize;
+  vtkIdType MaximumConcurrentWriteSize;
+  // Set when a job finished or reported an event, reset by the calling thread
+  bool JobsChanged;
+  vtkSimpleMutexLock Lock;
+  // Broadcast when JobsChanged is set
+  vtkSimpleConditionVariable JobsChangedCondition;
+};
+
+//-----------------------------------------------------------------------------
+struct vtkMRMLSceneWriteJobEventData
+{
+  vtkMRMLSceneWriteJob* Job;
+  vtkMRMLSceneWriteThreadData* ThreadData;
+};
+
+//-----------------------------------------------------------------------------
+// Observers of the nodes may not be thread safe (e.g. GUI): error, warning
+// and progress events invoked by a node while it is written by a worker
+// thread are recorded and not passed to the other observers.
+void CollectWriteJobEvent(vtkObject* caller, unsigned long event,
+                          void* clientData, void* callData)
+{
+  vtkMRMLSceneWriteJobEventData* eventData = static_cast<vtkMRMLSceneWriteJobEventData*>(clientData);
+  vtkMRMLSceneWriteJob* job = eventData->Job;
+  eventData->ThreadData->Lock.Lock();
+  if (event == vtkCommand::ProgressEvent)
+    {
+    if (callData)
+      {
+      job->Progress = *static_cast<double*>(callData);
+      }
+    }
+  else
+    {
+    vtkMRMLSceneWriteMessage message;
+    message.Caller = caller;
+    message.Event = event;
+    message.Text = callData ? static_cast<const char*>(callData) : "";
+    job->Messages.push_back(message);
+    }
+  eventData->ThreadData->JobsChanged = true;
+  eventData->ThreadData->JobsChangedCondition.Broadcast();
+  eventData->ThreadData->Lock.Unlock();
+  job->EventCallback->AbortFlagOn();
+}
+
+//-----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE WriteStorableNodesThreadFunction(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  vtkMRMLSceneWriteThreadData* threadData =
+    static_cast<vtkMRMLSceneWriteThreadData*>(threadInfo->UserData);
+  std::vector<vtkMRMLSceneWriteJob>& jobs = *threadData->Jobs;
+  threadData->Lock.Lock();
+  while (true)
+    {
+    // Take the largest job whose data fits in the budget
+    vtkMRMLSceneWriteJob* job = 0;
+    bool remainingJobs = false;
+    for (std::vector<vtkMRMLSceneWriteJob>::iterator jobIt = jobs.begin(); jobIt != jobs.end(); ++jobIt)
+      {
+      if (jobIt->Started)
+        {
+        continue;
+        }
+      remainingJobs = true;
+      if ((jobIt->Serialized && threadData->SerializedJobRunning)
+        || (threadData->NumberOfRunningJobs > 0
+            && threadData->MaximumConcurrentWriteSize > 0
+            && threadData->RunningJobsSize + jobIt->Size > threadData->MaximumConcurrentWriteSize))
+        {
+        continue;
+        }
+      job = &(*jobIt);
+      break;
+      }
+    if (job)
+      {
+      job->Started = true;
+      ++threadData->NumberOfRunningJobs;
+      threadData->RunningJobsSize += job->Size;
+      threadData->SerializedJobRunning = threadData->SerializedJobRunning || job->Serialized;
+      }
+    if (!remainingJobs)
+      {
+      break;
+      }
+    if (!job)
+      {
+      // wait for a running job to finish
+      threadData->JobsChangedCondition.Wait(threadData->Lock);
+      continue;
+      }
+    threadData->Lock.Unlock();
+
+    int success = job->StorageNode->WriteData(job->Node);
+
+    threadData->Lock.Lock();
+    job->Success = success;
+    job->Finished = true;
+    --threadData->NumberOfRunningJobs;
+    threadData->RunningJobsSize -= job->Size;
+    if (job->Serialized)
+      {
+      threadData->SerializedJobRunning = false;
+      }
+    threadData->JobsChanged = true;
+    threadData->JobsChangedCondition.Broadcast();
+    }
+  threadData->Lock.Unlock();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//-----------------------------------------------------------------------------
+void RemoveWriteJobObservers(vtkMRMLSceneWriteJob& job)
+{
+  job.Node->RemoveObserver(job.EventCallback);
+  job.StorageNode->RemoveObserver(job.EventCallback);
+}
+
+//-----------------------------------------------------------------------------
+// Report the events collected while the job was written in another thread
+void ReportWriteJobMessages(vtkMRMLSceneWriteJob& job)
+{
+  for (std::vector<vtkMRMLSceneWriteMessage>::iterator messageIt = job.Messages.begin();
+       messageIt != job.Messages.end(); ++messageIt)
+    {
+    // Same as vtkErrorMacro and vtkWarningMacro: the message goes to the
+    // output window if the node is not observed.
+    if (messageIt->Caller->HasObserver(messageIt->Event))
+      {
+      messageIt->Caller->InvokeEvent(messageIt->Event, const_cast<char*>(messageIt->Text.c_str()));
+      }
+    else if (messageIt->Event == vtkCommand::ErrorEvent)
+      {
+      vtkOutputWindowDisplayErrorText(messageIt->Text.c_str());
+      }
+    else
+      {
+      vtkOutputWindowDisplayWarningText(messageIt->Text.c_str());
+      }
+    }
+  job.Messages.clear();
+}
+
+} // end of anonymous namespace
+
+//-----------------------------------------------------------------------------
+bool vtkMRMLScene::WriteStorableNodes(const std::vector<vtkMRMLStorableNode*>& nodes,
+                                      std::vector<int>* writeSuccess)
+{
+  double startTime = vtkTimerLog::GetUniversalTime();
+  std::vector<vtkMRMLSceneWriteJob> concurrentJobs;
+  std::vector<vtkMRMLSceneWriteJob> sequentialJobs;
+
+  // Files written by several nodes are written in order
+  std::map<std::string, int> fileNameCounts;
+  for (std::vector<vtkMRMLStorableNode*>::const_iterator nodeIt = nodes.begin(); nodeIt != nodes.end(); ++nodeIt)
+    {
+    vtkMRMLStorageNode* storageNode = *nodeIt ? (*nodeIt)->GetStorageNode() : 0;
+    if (storageNode && storageNode->GetFileName())
+      {
+      ++fileNameCounts[storageNode->GetFileName()];
+      }
+    }
+
+  std::vector<int> success(nodes.size(), 0);
+  for (size_t i = 0; i < nodes.size(); ++i)
+    {
+    vtkMRMLStorableNode* node = nodes[i];
+    vtkMRMLStorageNode* storageNode = node ? node->GetStorageNode() : 0;
+    if (!storageNode)
+      {
+      vtkErrorMacro("WriteStorableNodes: no storage node for node "
+                    << (node && node->GetID() ? node->GetID() : "(null)"));
+      continue;
+      }
+    vtkMRMLSceneWriteJob job;
+    job.Node = node;
+    job.StorageNode = storageNode;
+    job.Size = EstimateStorableNodeDataSize(node);
+    job.Index = i;
+    job.Serialized = IsWriteSerialized(storageNode);
+    job.Started = false;
+    job.Finished = false;
+    job.Reported = false;
+    job.Success = 0;
+    job.Progress = 0.;
+    // Remote files are queued on the data IO manager, which is not thread safe
+    bool remote = storageNode->GetURI() && strlen(storageNode->GetURI()) > 0;
+    bool sharedFile = storageNode->GetFileName() && fileNameCounts[storageNode->GetFileName()] > 1;
+    if (remote || sharedFile)
+      {
+      sequentialJobs.push_back(job);
+      }
+    else
+      {
+      concurrentJobs.push_back(job);
+      }
+    }
+  // Start with the largest nodes so that the threads finish at about the same time
+  std::stable_sort(concurrentJobs.begin(), concurrentJobs.end(), IsLargerWriteJob);
+
+  // Observers are notified from this thread only
+  std::vector<std::pair<vtkMRMLNode*, int> > disabledModifies;
+  for (int jobList = 0; jobList < 2; ++jobList)
+    {
+    std::vector<vtkMRMLSceneWriteJob>& jobs = jobList == 0 ? concurrentJobs : sequentialJobs;
+    for (std::vector<vtkMRMLSceneWriteJob>::iterator jobIt = jobs.begin(); jobIt != jobs.end(); ++jobIt)
+      {
+      disabledModifies.push_back(std::make_pair(jobIt->Node, jobIt->Node->StartModify()));
+      disabledModifies.push_back(std::make_pair(jobIt->StorageNode, jobIt->StorageNode->StartModify()));
+      }
+    }
+
+  int numberOfThreads = this->NumberOfWriteThreads;
+  if (numberOfThreads <= 0)
+    {
+    numberOfThreads = std::min(vtkMultiThreader::GetGlobalDefaultNumberOfThreads(), 4);
+    }
+  numberOfThreads = std::max(1, std::min(numberOfThreads, static_cast<int>(concurrentJobs.size())));
+
+  vtkMRMLSceneWriteThreadData threadData;
+  threadData.Jobs = &concurrentJobs;
+  threadData.NumberOfRunningJobs = 0;
+  threadData.SerializedJobRunning = false;
+  threadData.RunningJobsSize = 0;
+  threadData.MaximumConcurrentWriteSize = this->MaximumConcurrentWriteSize;
+  threadData.JobsChanged = false;
+  if (numberOfThreads == 1)
+    {
+    // Avoid the overhead of starting a thread
+    vtkMultiThreader::ThreadInfo threadInfo;
+    threadInfo.ThreadID = 0;
+    threadInfo.NumberOfThreads = 1;
+    threadInfo.UserData = &threadData;
+    WriteStorableNodesThreadFunction(&threadInfo);
+    }
+  else
+    {
+    // The nodes written at the same time share the processors
+    int numberOfThreadsPerWrite =
+      std::max(1, vtkMultiThreader::GetGlobalDefaultNumberOfThreads() / numberOfThreads);
+    std::vector<int> numberOfWriteThreads;
+    std::vector<vtkMRMLSceneWriteJobEventData> eventData(concurrentJobs.size());
+    vtkIdType totalSize = 0;
+    for (size_t i = 0; i < concurrentJobs.size(); ++i)
+      {
+      vtkMRMLSceneWriteJob& job = concurrentJobs[i];
+      numberOfWriteThreads.push_back(job.StorageNode->GetNumberOfWriteThreads());
+      job.StorageNode->SetNumberOfWriteThreads(numberOfThreadsPerWrite);
+      eventData[i].Job = &job;
+      eventData[i].ThreadData = &threadData;
+      job.EventCallback = vtkSmartPointer<vtkCallbackCommand>::New();
+      job.EventCallback->SetCallback(CollectWriteJobEvent);
+      job.EventCallback->SetClientData(&eventData[i]);
+      // Called before the other observers
+      const float priority = 1000.;
+      job.StorageNode->AddObserver(vtkCommand::ErrorEvent, job.EventCallback, priority);
+      job.StorageNode->AddObserver(vtkCommand::WarningEvent, job.EventCallback, priority);
+      job.StorageNode->AddObserver(vtkCommand::ProgressEvent, job.EventCallback, priority);
+      job.Node->AddObserver(vtkCommand::ErrorEvent, job.EventCallback, priority);
+      job.Node->AddObserver(vtkCommand::WarningEvent, job.EventCallback, priority);
+      job.Node->AddObserver(vtkCommand::ProgressEvent, job.EventCallback, priority);
+      totalSize += job.Size;
+      }
+
+    vtkNew<vtkMultiThreader> threader;
+    std::vector<int> threadIDs;
+    for (int i = 0; i < numberOfThreads; ++i)
+      {
+      threadIDs.push_back(threader->SpawnThread(WriteStorableNodesThreadFunction, &threadData));
+      }
+
+    // Report the messages of the written nodes and the progress from this
+    // thread while the worker threads write the nodes
+    double lastProgress = -1.;
+    while (true)
+      {
+      std::vector<vtkMRMLSceneWriteJob*> finishedJobs;
+      double writtenSize = 0.;
+      size_t numberOfFinishedJobs = 0;
+      threadData.Lock.Lock();
+      threadData.JobsChanged = false;
+      for (std::vector<vtkMRMLSceneWriteJob>::iterator jobIt = concurrentJobs.begin();
+           jobIt != concurrentJobs.end(); ++jobIt)
+        {
+        // Nodes of unknown size count as 1 byte
+        double jobSize = totalSize > 0 ? static_cast<double>(jobIt->Size) : 1.;
+        if (jobIt->Finished)
+          {
+          ++numberOfFinishedJobs;
+          writtenSize += jobSize;
+          if (!jobIt->Reported)
+            {
+            jobIt->Reported = true;
+            finishedJobs.push_back(&(*jobIt));
+            }
+          }
+        else if (jobIt->Started)
+          {
+          writtenSize += jobSize * std::min(std::max(jobIt->Progress, 0.), 1.);
+          }
+        }
+      threadData.Lock.Unlock();
+
+      // The worker threads do not access the nodes of finished jobs anymore
+      for (std::vector<vtkMRMLSceneWriteJob*>::iterator jobIt = finishedJobs.begin();
+           jobIt != finishedJobs.end(); ++jobIt)
+        {
+        RemoveWriteJobObservers(**jobIt);
+        ReportWriteJobMessages(**jobIt);
+        }
+      double progress = writtenSize / (totalSize > 0 ?
+        static_cast<double>(totalSize) : static_cast<double>(concurrentJobs.size()));
+      if (progress != lastProgress)
+        {
+        lastProgress = progress;
+        this->InvokeEvent(vtkCommand::ProgressEvent, &progress);
+        }
+      if (numberOfFinishedJobs == concurrentJobs.size())
+        {
+        break;
+        }
+      // Wait until a job finishes or reports progress or a message
+      threadData.Lock.Lock();
+      while (!threadData.JobsChanged)
+        {
+        threadData.JobsChangedCondition.Wait(threadData.Lock);
+        }
+      threadData.Lock.Unlock();
+      }
+    for (std::vector<int>::iterator threadIDIt = threadIDs.begin(); threadIDIt != threadIDs.end(); ++threadIDIt)
+      {
+      threader->TerminateThread(*threadIDIt);
+      }
+    for (size_t i = 0; i < concurrentJobs.size(); ++i)
+      {
+      concurrentJobs[i].StorageNode->SetNumberOfWriteThreads(numberOfWriteThreads[i]);
+      concurrentJobs[i].EventCallback = 0;
+      }
+    }
+  for (std::vector<vtkMRMLSceneWriteJob>::iterator jobIt = sequentialJobs.begin(); jobIt != sequentialJobs.end(); ++jobIt)
+    {
+    jobIt->Success = jobIt->StorageNode->WriteData(jobIt->Node);
+    }
+
+  for (std::vector<std::pair<vtkMRMLNode*, int> >::reverse_iterator disabledIt = disabledModifies.rbegin();
+       disabledIt != disabledModifies.rend(); ++disabledIt)
+    {
+    disabledIt->first->EndModify(disabledIt->second);
+    }
+
+  bool allWritten = (concurrentJobs.size() + sequentialJobs.size() == nodes.size());
+  for (int jobList = 0; jobList < 2; ++jobList)
+    {
+    std::vector<vtkMRMLSceneWriteJob>& jobs = jobList == 0 ? concurrentJobs : sequentialJobs;
+    for (std::vector<vtkMRMLSceneWriteJob>::iterator jobIt = jobs.begin(); jobIt != jobs.end(); ++jobIt)
+      {
+      success[jobIt->Index] = jobIt->Success ? 1 : 0;
+      if (!jobIt->Success)
+        {
+        allWritten = false;
+        vtkErrorMacro("WriteStorableNodes: failed to write node " << jobIt->Node->GetID()
+                      << " to " << (jobIt->StorageNode->GetFileName() ? jobIt->StorageNode->GetFileName() : "(none)"));
+        }
+      }
+    }
+  if (writeSuccess)
+    {
+    *writeSuccess = success;
+    }
+  vtkDebugMacro("WriteStorableNodes: wrote " << nodes.size() << " nodes using " << numberOfThreads
+                << " threads (" << sequentialJobs.size() << " written sequentially) in "
+                << vtkTimerLog::GetUniversalTime() - startTime << "s");
+  return allWritten;
+}
+
 //-----------------------------------------------------------------------------
 int vtkMRMLScene::GetNumberOfNodeReferences()
 {
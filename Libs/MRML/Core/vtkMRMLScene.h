@@ -43,6 +43,7 @@ class vtkGeneralTransform;
 class vtkURIHandler;
 class vtkMRMLNode;
 class vtkMRMLSceneViewNode;
+class vtkMRMLStorableNode;
 
 /// \brief A set of MRML Nodes that supports serialization and undo/redo.
 ///
@@ -185,7 +186,10 @@ public:
   /// Get next node in the scene.
   vtkMRMLNode *GetNextNode();
 
-  /// Get next node of the class in the scene.
+  /// \brief Get next node of the class in the scene.
+  ///
+  /// The traversal position is shared with GetNextNode(): both continue
+  /// from the last node returned by either of them.
   vtkMRMLNode *GetNextNodeByClass(const char* className);
 
   /// Get nodes having the specified name
@@ -296,6 +300,40 @@ public:
   /// returns number of redo steps in the history buffer
   int GetNumberOfRedoLevels() { return (int)this->RedoStack.size();};
 
+  /// \brief Maximum number of undo levels.
+  ///
+  /// When a new state is saved and the limit is exceeded, the oldest
+  /// states are discarded. Lowering the limit discards the exceeding states
+  /// immediately. Default is 100.
+  void SetUndoStackSize(int size);
+  vtkGetMacro(UndoStackSize, int);
+
+  /// \brief Maximum memory in bytes used by the undo and redo stacks.
+  ///
+  /// Unchanged nodes are shared between states, only the node copies made
+  /// by SaveStateForUndo() and the lists of scene nodes count. When the
+  /// limit is exceeded, the least recently saved undo states are discarded
+  /// (the most recent state is always kept), also immediately when the
+  /// limit is lowered. 0 means no limit (default).
+  /// \sa GetUndoStackMemorySize()
+  void SetMaximumUndoStackMemorySize(vtkIdType size);
+  vtkGetMacro(MaximumUndoStackMemorySize, vtkIdType);
+
+  /// Estimated memory in bytes currently used by the undo and redo stacks.
+  /// \sa SetMaximumUndoStackMemorySize()
+  vtkIdType GetUndoStackMemorySize();
+
+  /// Number of undo states discarded because of the UndoStackSize or
+  /// MaximumUndoStackMemorySize limits since the last ClearUndoStack().
+  vtkGetMacro(NumberOfDiscardedUndoLevels, int);
+
+  /// Time in seconds spent in the last SaveStateForUndo() call.
+  vtkGetMacro(LastSaveStateForUndoTime, double);
+  /// Time in seconds spent in the last Undo() call.
+  vtkGetMacro(LastUndoTime, double);
+  /// Time in seconds spent in the last Redo() call.
+  vtkGetMacro(LastRedoTime, double);
+
   /// Save current state in the undo buffer
   void SaveStateForUndo();
 
@@ -639,6 +677,42 @@ public:
   /// and call StorableModified() on them.
   static void SetStorableNodesModifiedSinceRead(vtkCollection* storableNodes);
 
+  /// \brief Write the data of storable nodes with their storage node,
+  /// several nodes at a time.
+  ///
+  /// The storage nodes must already be set up (file name, format...).
+  /// Nodes are written by up to NumberOfWriteThreads threads, the largest
+  /// first, and the data of the nodes written at the same time does not
+  /// exceed MaximumConcurrentWriteSize (a larger node is written alone).
+  /// Nodes with a remote URI and nodes sharing a file name are written one
+  /// after the other by the calling thread. Only one nrrd file is written
+  /// at a time because teem is not thread safe. The storage nodes written at
+  /// the same time share the processors (vtkMRMLStorageNode::NumberOfWriteThreads).
+  /// Modified events of the nodes are blocked while writing and invoked by
+  /// the calling thread once all the nodes are written. Error, warning and
+  /// progress events of the nodes written by other threads are not passed
+  /// to the observers while the nodes are written: errors and warnings are
+  /// invoked again by the calling thread once a node is written, and the
+  /// calling thread invokes vtkCommand::ProgressEvent on the scene with the
+  /// fraction of the data written. Call Commit() afterwards so that the
+  /// scene file refers to the written files.
+  ///
+  /// If \a writeSuccess is passed, it is set to 1 for each written node
+  /// and to 0 for each node that failed to be written.
+  /// Returns true if all the nodes are written.
+  bool WriteStorableNodes(const std::vector<vtkMRMLStorableNode*>& nodes,
+                          std::vector<int>* writeSuccess = 0);
+
+  /// Maximum number of threads writing the nodes in WriteStorableNodes().
+  /// 0 (default) uses the number of processors, up to 4.
+  vtkSetMacro(NumberOfWriteThreads, int);
+  vtkGetMacro(NumberOfWriteThreads, int);
+
+  /// Maximum size in bytes of the data written at the same time by
+  /// WriteStorableNodes(), 1GB by default. 0 means no limit.
+  vtkSetMacro(MaximumConcurrentWriteSize, vtkIdType);
+  vtkGetMacro(MaximumConcurrentWriteSize, vtkIdType);
+
 protected:
 
   typedef std::map< std::string, std::set<std::string> > NodeReferencesType;
@@ -646,12 +720,73 @@ protected:
   vtkMRMLScene();
   virtual ~vtkMRMLScene();
 
+  /// Scene state stored in the undo and redo stacks.
+  struct UndoNodeCopyType
+    {
+    UndoNodeCopyType() : SourceMTime(0), MemorySize(0), SharedWithPreviousState(false) {}
+    vtkSmartPointer<vtkMRMLNode> Node;
+    /// MTime of the scene node when it was copied. If the scene node has
+    /// not been modified since, the copy is reused by the next state.
+    vtkMTimeType SourceMTime;
+    /// Estimated memory in bytes used by the copy.
+    vtkIdType MemorySize;
+    /// True if the same copy is referenced by the previous state of the
+    /// stack, in which case its memory is accounted there.
+    bool SharedWithPreviousState;
+    };
+  struct UndoStateType
+    {
+    UndoStateType() : NodeCopiesMemorySize(0) {}
+    /// Nodes of the scene when the state was saved. The collection is
+    /// shared between consecutive states as long as no node is added to or
+    /// removed from the scene. It must not be modified once pushed.
+    vtkSmartPointer<vtkCollection> SceneNodes;
+    /// Copies of the nodes saved in this state, by node ID (copy-on-write:
+    /// nodes that are not copied are shared with the current scene).
+    std::map< std::string, UndoNodeCopyType > NodeCopies;
+    /// Estimated memory in bytes used by the node copies that are not
+    /// shared with the previous state.
+    vtkIdType NodeCopiesMemorySize;
+    };
+  typedef std::list< UndoStateType > UndoStackType;
+
   void PushIntoUndoStack();
   void PushIntoRedoStack();
 
+  /// Return a collection of the current scene nodes (excluding scene view
+  /// nodes) that can be shared by undo and redo states.
+  vtkCollection* GetUndoSceneNodes();
+
+  /// Get the IDs and nodes (node copy if any, scene node otherwise) of a
+  /// state, in scene order.
+  void GetUndoStateNodes(const UndoStateType& state,
+                         std::vector<std::string>& ids,
+                         std::vector<vtkMRMLNode*>& nodes);
+
+  /// Discard the oldest undo states until the UndoStackSize and
+  /// MaximumUndoStackMemorySize limits are satisfied.
+  void TrimUndoStack();
+
+  /// Estimated memory in bytes used by the states of a stack.
+  /// Node lists shared by consecutive states are counted once.
+  vtkIdType GetStackMemorySize(const UndoStackType& stack);
+
   void CopyNodeInUndoStack(vtkMRMLNode *node);
   void CopyNodeInRedoStack(vtkMRMLNode *node);
 
+  /// Store a copy of \a node in \a state unless \a previousState already
+  /// has an up-to-date copy of the node, in which case the copy is shared.
+  void CopyNodeInState(vtkMRMLNode *node, UndoStateType& state,
+                       UndoStateType* previousState, bool singleModifiedEvent);
+
+  /// Return the node to add back to the scene when restoring \a state.
+  /// Node copies are duplicated as they can be shared between states.
+  vtkSmartPointer<vtkMRMLNode> GetNodeToRestore(const UndoStateType& state,
+    const std::string& nodeID, vtkMRMLNode* stateNode);
+
+  /// Common implementation of the SaveStateForUndo() methods.
+  void SaveNodesStateForUndo(const std::vector<vtkMRMLNode *>& nodes);
+
   /// Add a node to the scene without invoking a vtkMRMLScene::NodeAddedEvent event.
   ///
   /// \warning Use with extreme caution as it might unsynchronize observer.
@@ -694,6 +829,43 @@ protected:
   /// Clear NodeIDs map used to speedup GetByID() method.
   void ClearNodeIDs();
 
+  /// Nodes of a given class (or one of its subclasses), ordered by their
+  /// position in the \a Nodes collection.
+  struct NodeClassIndexType
+    {
+    /// Map between a node sequence number and the node.
+    std::map< unsigned long, vtkMRMLNode* > Nodes;
+    /// Random access cache used by GetNthNodeByClass(). It is cleared each
+    /// time \a Nodes changes and rebuilt on demand.
+    std::vector< vtkMRMLNode* > NthNodeCache;
+    };
+  typedef std::map< std::string, NodeClassIndexType > NodesByClassType;
+
+  /// \brief Synchronize NodesByClass index used to speedup the
+  /// GetNodesByClass(), GetNumberOfNodesByClass(), GetNthNodeByClass() and
+  /// GetNextNodeByClass() methods with the \a Nodes collection.
+  ///
+  /// The index is rebuilt only if the \a Nodes collection has been modified
+  /// without going through AddNodeToNodesByClass() or
+  /// RemoveNodeFromNodesByClass() (e.g. InsertAfterNode()).
+  void UpdateNodesByClass();
+
+  /// Return the index of the nodes of class \a className in the scene.
+  /// The index is created the first time a class is queried and is kept
+  /// up-to-date afterward.
+  NodeClassIndexType& GetNodeClassIndex(const char* className);
+
+  /// Add node to the \a NodesByClass index. Must be called right after the
+  /// node is appended to the \a Nodes collection.
+  void AddNodeToNodesByClass(vtkMRMLNode *node);
+
+  /// Remove node from the \a NodesByClass index. Must be called right after
+  /// the node is removed from the \a Nodes collection.
+  void RemoveNodeFromNodesByClass(vtkMRMLNode *node);
+
+  /// Clear the \a NodesByClass index.
+  void ClearNodesByClass();
+
   /// Get a NodeReferences iterator for a node reference.
   NodeReferencesType::iterator FindNodeReference(const char* referencedId, vtkMRMLNode* referencingNode);
 
@@ -712,8 +884,22 @@ protected:
   bool UndoFlag;
   bool InUndo;
 
-  std::list< vtkCollection* >  UndoStack;
-  std::list< vtkCollection* >  RedoStack;
+  UndoStackType  UndoStack;
+  UndoStackType  RedoStack;
+
+  vtkIdType MaximumUndoStackMemorySize;
+  int NumberOfDiscardedUndoLevels;
+
+  int NumberOfWriteThreads;
+  vtkIdType MaximumConcurrentWriteSize;
+  double LastSaveStateForUndoTime;
+  double LastUndoTime;
+  double LastRedoTime;
+
+  // Last list of scene nodes pushed into the undo or redo stack, reused
+  // while the Nodes collection is not modified.
+  vtkSmartPointer<vtkCollection> UndoSceneNodes;
+  vtkMTimeType UndoSceneNodesMTime;
 
   std::string                 URL;
   std::string                 RootDirectory;
@@ -729,6 +915,15 @@ protected:
   std::map< std::string, std::string > ReferencedIDChanges;
   std::map< std::string, vtkSmartPointer<vtkMRMLNode> > NodeIDs;
 
+  // Class name based index used to speedup class queries. Each queried
+  // class name (including superclasses such as "vtkMRMLVolumeNode") is a key.
+  NodesByClassType NodesByClass;
+  // Sequence number of each node of the scene, increasing with the node
+  // position in the Nodes collection.
+  std::map< vtkMRMLNode*, unsigned long > NodeSequenceNumbers;
+  unsigned long NextNodeSequenceNumber;
+  vtkMTimeType NodesByClassMTime;
+
   // Stores default nodes. If a class is created or reset (using CreateNodeByClass or Clear) and
   // a default node is defined for it then the content of the default node will be used to initialize
   // the class. It is useful for overriding default values that are set in a node's constructor.
@@ -562,6 +562,14 @@ bool vtkMRMLSegmentationNode::GenerateMergedLabelmap(
     // Get binary labelmap from segment
     vtkOrientedImageData* representationBinaryLabelmap = vtkOrientedImageData::SafeDownCast(
       currentSegment->GetRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()) );
+    // If the labelmap is shared with other segments then only use the voxels of this segment
+    vtkSmartPointer<vtkOrientedImageData> segmentBinaryLabelmap;
+    if (representationBinaryLabelmap && this->Segmentation->IsSharedBinaryLabelmap(currentSegmentId))
+      {
+      segmentBinaryLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+      this->Segmentation->GetBinaryLabelmapRepresentation(currentSegmentId, segmentBinaryLabelmap);
+      representationBinaryLabelmap = segmentBinaryLabelmap;
+      }
     // If binary labelmap is empty then skip
     if (representationBinaryLabelmap->IsEmpty())
       {
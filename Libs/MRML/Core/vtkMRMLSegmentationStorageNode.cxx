@@ -75,6 +75,8 @@ static const std::string KEY_SEGMENT_NAME = "Name";
 static const std::string KEY_SEGMENT_COLOR = "Color";
 static const std::string KEY_SEGMENT_TAGS = "Tags";
 static const std::string KEY_SEGMENT_EXTENT = "Extent";
+static const std::string KEY_SEGMENT_LAYER = "Layer";
+static const std::string KEY_SEGMENT_LABEL_VALUE = "LabelValue";
 static const std::string KEY_SEGMENTATION_MASTER_REPRESENTATION = "MasterRepresentation";
 static const std::string KEY_SEGMENTATION_CONVERSION_PARAMETERS = "ConversionParameters";
 static const std::string KEY_SEGMENTATION_EXTENT = "Extent"; // Deprecated, kept only for being able to read legacy files.
@@ -87,6 +89,7 @@ vtkMRMLNodeNewMacro(vtkMRMLSegmentationStorageNode);
 
 //----------------------------------------------------------------------------
 vtkMRMLSegmentationStorageNode::vtkMRMLSegmentationStorageNode()
+  : SharedLabelmapLayers(false)
 {
 }
 
@@ -99,6 +102,7 @@ vtkMRMLSegmentationStorageNode::~vtkMRMLSegmentationStorageNode()
 void vtkMRMLSegmentationStorageNode::PrintSelf(ostream& os, vtkIndent indent)
 {
   vtkMRMLStorageNode::PrintSelf(os,indent);
+  os << indent << "SharedLabelmapLayers: " << (this->SharedLabelmapLayers ? "true" : "false") << "\n";
 }
 
 //----------------------------------------------------------------------------
@@ -108,6 +112,18 @@ void vtkMRMLSegmentationStorageNode::ReadXMLAttributes(const char** atts)
 
   Superclass::ReadXMLAttributes(atts);
 
+  const char* attName;
+  const char* attValue;
+  while (*atts != NULL)
+    {
+    attName = *(atts++);
+    attValue = *(atts++);
+    if (!strcmp(attName, "sharedLabelmapLayers"))
+      {
+      this->SharedLabelmapLayers = (strcmp(attValue, "true") == 0);
+      }
+    }
+
   this->EndModify(disabledModify);
 }
 
@@ -116,6 +132,7 @@ void vtkMRMLSegmentationStorageNode::WriteXML(ostream& of, int nIndent)
 {
   Superclass::WriteXML(of, nIndent);
   vtkIndent indent(nIndent);
+  of << indent << " sharedLabelmapLayers=\"" << (this->SharedLabelmapLayers ? "true" : "false") << "\"";
 }
 
 //----------------------------------------------------------------------------
@@ -126,6 +143,11 @@ void vtkMRMLSegmentationStorageNode::Copy(vtkMRMLNode *anode)
   int disabledModify = this->StartModify();
 
   Superclass::Copy(anode);
+  vtkMRMLSegmentationStorageNode* node = vtkMRMLSegmentationStorageNode::SafeDownCast(anode);
+  if (node)
+    {
+    this->SetSharedLabelmapLayers(node->GetSharedLabelmapLayers());
+    }
 
   this->EndModify(disabledModify);
 }
@@ -608,8 +630,24 @@ int vtkMRMLSegmentationStorageNode::ReadBinaryLabelmapRepresentation(vtkMRMLSegm
     containedRepresentationNames = reader->GetHeaderValue(GetSegmentationMetaDataKey(KEY_SEGMENTATION_CONTAINED_REPRESENTATION_NAMES).c_str());
     }
 
+  // If layer is specified for the segments then each frame is a labelmap layer that is shared
+  // by multiple segments, otherwise each frame contains one segment
+  bool sharedLayers = (std::find(keys.begin(), keys.end(), GetSegmentMetaDataKey(0, KEY_SEGMENT_LAYER)) != keys.end());
+  int numberOfSegments = numberOfFrames;
+  if (sharedLayers)
+    {
+    numberOfSegments = 0;
+    while (std::find(keys.begin(), keys.end(), GetSegmentMetaDataKey(numberOfSegments, KEY_SEGMENT_LAYER)) != keys.end())
+      {
+      ++numberOfSegments;
+      }
+    }
+  std::map<int, vtkSmartPointer<vtkOrientedImageData> > layerLabelmaps;
+  // Keep the layout of the file when it is written again
+  this->SetSharedLabelmapLayers(sharedLayers);
+
   // Read segment binary labelmaps
-  for (int segmentIndex = 0; segmentIndex < numberOfFrames; ++segmentIndex)
+  for (int segmentIndex = 0; segmentIndex < numberOfSegments; ++segmentIndex)
     {
     // Create segment
     vtkSmartPointer<vtkSegment> currentSegment = vtkSmartPointer<vtkSegment>::New();
@@ -661,6 +699,53 @@ int vtkMRMLSegmentationStorageNode::ReadBinaryLabelmapRepresentation(vtkMRMLSegm
       this->SetSegmentTagsFromString(currentSegment, headerValue);
       }
 
+    if (sharedLayers)
+      {
+      // Layer and label value
+      int layer = 0;
+      headerValue = reader->GetHeaderValue(GetSegmentMetaDataKey(segmentIndex, KEY_SEGMENT_LAYER).c_str());
+      if (headerValue)
+        {
+        layer = atoi(headerValue);
+        }
+      if (layer < 0 || layer >= numberOfFrames)
+        {
+        vtkErrorMacro("ReadBinaryLabelmapRepresentation: Invalid layer " << layer << " for segment " << segmentIndex);
+        continue;
+        }
+      int labelValue = 1;
+      headerValue = reader->GetHeaderValue(GetSegmentMetaDataKey(segmentIndex, KEY_SEGMENT_LABEL_VALUE).c_str());
+      if (headerValue)
+        {
+        labelValue = atoi(headerValue);
+        }
+      else
+        {
+        vtkWarningMacro("Segment label value is missing for segment " << segmentIndex);
+        }
+
+      // Each layer is read only once and shared by all the segments in it
+      vtkSmartPointer<vtkOrientedImageData>& layerLabelmap = layerLabelmaps[layer];
+      if (!layerLabelmap)
+        {
+        layerLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+        extractComponents->SetComponents(layer);
+        padder->SetOutputWholeExtent(commonGeometryExtent);
+        padder->Update();
+        layerLabelmap->DeepCopy(padder->GetOutput());
+        layerLabelmap->SetImageToWorldMatrix(imageToWorldMatrix.GetPointer());
+        }
+      currentSegment->SetLabelValue(labelValue);
+      currentSegment->AddRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName(), layerLabelmap);
+
+      if (segmentation->GetSegment(currentSegmentID) != NULL)
+        {
+        vtkErrorMacro("Segment by ID " << currentSegmentID << " already exists in segmentation.");
+        }
+      segmentation->AddSegment(currentSegment, currentSegmentID);
+      continue;
+      }
+
     // Create binary labelmap volume
     vtkSmartPointer<vtkOrientedImageData> currentBinaryLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
 
@@ -956,6 +1041,7 @@ int vtkMRMLSegmentationStorageNode::WriteBinaryLabelmapRepresentation(vtkMRMLSeg
   vtkNew<vtkNRRDWriter> writer;
   writer->SetFileName(fullName.c_str());
   writer->SetUseCompression(this->GetUseCompression());
+  writer->SetNumberOfThreads(this->GetNumberOfWriteThreads());
 
   // Create metadata dictionary
 
@@ -989,19 +1075,36 @@ int vtkMRMLSegmentationStorageNode::WriteBinaryLabelmapRepresentation(vtkMRMLSeg
   std::string containedRepresentationNames = this->SerializeContainedRepresentationNames(segmentation);
   writer->SetAttribute(GetSegmentationMetaDataKey(KEY_SEGMENTATION_CONTAINED_REPRESENTATION_NAMES).c_str(), containedRepresentationNames);
 
+  std::vector< std::string > segmentIDs;
+  segmentation->GetSegmentIDs(segmentIDs);
   vtkNew<vtkImageAppendComponents> appender;
 
-  // Dimensions of the output 4D NRRD file: (i, j, k, segment)
+  // If shared labelmap layers are enabled then non-overlapping segments are stored in the same
+  // labelmap layer, distinguished by their label value. Dimensions of the output 4D NRRD file
+  // are then (i, j, k, layer), otherwise (i, j, k, segment).
+  vtkSegmentation::SegmentLayerLabelMap segmentLayerLabels;
+  if (this->SharedLabelmapLayers)
+    {
+    std::vector<vtkSmartPointer<vtkOrientedImageData> > layers;
+    if (!segmentation->GenerateSharedLabelmapLayers(commonGeometryImage, layers, segmentLayerLabels, segmentIDs))
+      {
+      vtkErrorMacro("WriteBinaryLabelmapRepresentation: Failed to generate labelmap layers");
+      return 0;
+      }
+    for (std::vector<vtkSmartPointer<vtkOrientedImageData> >::iterator layerIt = layers.begin(); layerIt != layers.end(); ++layerIt)
+      {
+      appender->AddInputData(*layerIt);
+      }
+    }
+
   unsigned int segmentIndex = 0;
-  std::vector< std::string > segmentIDs;
-  segmentation->GetSegmentIDs(segmentIDs);
   for (std::vector< std::string >::const_iterator segmentIdIt = segmentIDs.begin(); segmentIdIt != segmentIDs.end(); ++segmentIdIt, ++segmentIndex)
     {
     std::string currentSegmentID = *segmentIdIt;
     vtkSegment* currentSegment = segmentation->GetSegment(*segmentIdIt);
 
     // Get master representation from segment
-    vtkSmartPointer<vtkOrientedImageData> currentBinaryLabelmap = vtkOrientedImageData::SafeDownCast(
+    vtkOrientedImageData* currentBinaryLabelmap = vtkOrientedImageData::SafeDownCast(
       currentSegment->GetRepresentation(segmentationNode->GetSegmentation()->GetMasterRepresentationName()));
     if (!currentBinaryLabelmap)
       {
@@ -1027,33 +1130,41 @@ int vtkMRMLSegmentationStorageNode::WriteBinaryLabelmapRepresentation(vtkMRMLSeg
         currentBinaryLabelmapExtent[i * 2] = std::max(currentBinaryLabelmapExtentInCommonGeometryImageFrame[i * 2], commonGeometryExtent[i * 2]);
         currentBinaryLabelmapExtent[i * 2 + 1] = std::min(currentBinaryLabelmapExtentInCommonGeometryImageFrame[i * 2 + 1], commonGeometryExtent[i * 2 + 1]);
         }
-      // TODO: maybe calculate effective extent to make sure the data is as compact as possible? (saving may be a good time to make segments more compact)
-
-      // Pad/resample current binary labelmap representation to common geometry
-      vtkSmartPointer<vtkOrientedImageData> resampledCurrentBinaryLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
-      bool success = vtkOrientedImageDataResample::ResampleOrientedImageToReferenceOrientedImage(
-        currentBinaryLabelmap, commonGeometryImage, resampledCurrentBinaryLabelmap);
-      if (!success)
-        {
-        vtkWarningMacro("WriteBinaryLabelmapRepresentation: Segment " << currentSegmentID << " cannot be resampled to common geometry!");
-        continue;
-        }
+      }
 
-      // currentBinaryLabelmap smart pointer will keep the temporary labelmap valid until it is needed
-      currentBinaryLabelmap = resampledCurrentBinaryLabelmap;
-      if (currentBinaryLabelmap->GetScalarType() != VTK_UNSIGNED_CHAR)
+    if (!this->SharedLabelmapLayers)
+      {
+      // One frame per segment, which only contains the voxels of the segment (even if its labelmap is shared in memory)
+      vtkSmartPointer<vtkOrientedImageData> segmentFrame = commonGeometryImage; // empty segment: commonGeometryImage is filled with 0
+      vtkSmartPointer<vtkOrientedImageData> segmentLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+      int* segmentLabelmapExtent = currentBinaryLabelmap->GetExtent();
+      if (segmentLabelmapExtent[0] <= segmentLabelmapExtent[1]
+        && segmentLabelmapExtent[2] <= segmentLabelmapExtent[3]
+        && segmentLabelmapExtent[4] <= segmentLabelmapExtent[5]
+        && segmentation->GetBinaryLabelmapRepresentation(currentSegmentID, segmentLabelmap))
         {
-        vtkNew<vtkImageCast> castFilter;
-        castFilter->SetInputData(resampledCurrentBinaryLabelmap);
-        castFilter->SetOutputScalarType(VTK_UNSIGNED_CHAR);
-        castFilter->Update();
-        currentBinaryLabelmap->ShallowCopy(castFilter->GetOutput());
+        // Pad/resample current binary labelmap representation to common geometry
+        vtkSmartPointer<vtkOrientedImageData> resampledSegmentLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+        if (!vtkOrientedImageDataResample::ResampleOrientedImageToReferenceOrientedImage(
+          segmentLabelmap, commonGeometryImage, resampledSegmentLabelmap))
+          {
+          vtkWarningMacro("WriteBinaryLabelmapRepresentation: Segment " << currentSegmentID << " cannot be resampled to common geometry!");
+          }
+        else
+          {
+          segmentFrame = resampledSegmentLabelmap;
+          }
+        if (segmentFrame->GetScalarType() != VTK_UNSIGNED_CHAR)
+          {
+          vtkNew<vtkImageCast> castFilter;
+          castFilter->SetInputData(segmentFrame);
+          castFilter->SetOutputScalarType(VTK_UNSIGNED_CHAR);
+          castFilter->Update();
+          segmentFrame = vtkSmartPointer<vtkOrientedImageData>::New();
+          segmentFrame->ShallowCopy(castFilter->GetOutput());
+          }
         }
-      }
-    else
-      {
-      // empty segment, use the commonGeometryImage (filled with 0)
-      currentBinaryLabelmap = commonGeometryImage;
+      appender->AddInputData(segmentFrame);
       }
 
     // Set metadata for current segment
@@ -1069,11 +1180,17 @@ int vtkMRMLSegmentationStorageNode::WriteBinaryLabelmapRepresentation(vtkMRMLSeg
       }
     writer->SetAttribute(GetSegmentMetaDataKey(segmentIndex, KEY_SEGMENT_EXTENT).c_str(), GetImageExtentAsString(currentBinaryLabelmapExtent));
     writer->SetAttribute(GetSegmentMetaDataKey(segmentIndex, KEY_SEGMENT_TAGS).c_str(), GetSegmentTagsAsString(currentSegment));
-
-    appender->AddInputData(currentBinaryLabelmap);
+    if (this->SharedLabelmapLayers)
+      {
+      std::stringstream ssLayer;
+      ssLayer << segmentLayerLabels[currentSegmentID].first;
+      writer->SetAttribute(GetSegmentMetaDataKey(segmentIndex, KEY_SEGMENT_LAYER).c_str(), ssLayer.str());
+      std::stringstream ssLabelValue;
+      ssLabelValue << segmentLayerLabels[currentSegmentID].second;
+      writer->SetAttribute(GetSegmentMetaDataKey(segmentIndex, KEY_SEGMENT_LABEL_VALUE).c_str(), ssLabelValue.str());
+      }
     } // For each segment
 
-
   appender->Update();
 
   writer->SetInputConnection(appender->GetOutputPort());
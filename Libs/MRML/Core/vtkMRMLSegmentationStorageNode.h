@@ -86,6 +86,14 @@ public:
   /// Reset supported write file types. Called when master representation is changed
   void ResetSupportedWriteFileTypes();
 
+  /// Store non-overlapping segments in shared labelmap layers (one frame per layer, with
+  /// the layer and label value of each segment in the header) instead of one frame per segment.
+  /// Files written this way can only be read by applications that support shared layers.
+  /// Off by default. Reading a file that uses shared layers turns it on.
+  vtkSetMacro(SharedLabelmapLayers, bool);
+  vtkGetMacro(SharedLabelmapLayers, bool);
+  vtkBooleanMacro(SharedLabelmapLayers, bool);
+
 protected:
   /// Initialize all the supported read file types
   virtual void InitializeSupportedReadFileTypes();
@@ -147,6 +155,8 @@ protected:
   vtkMRMLSegmentationStorageNode();
   ~vtkMRMLSegmentationStorageNode();
 
+  bool SharedLabelmapLayers;
+
 private:
   vtkMRMLSegmentationStorageNode(const vtkMRMLSegmentationStorageNode&);  /// Not implemented.
   void operator=(const vtkMRMLSegmentationStorageNode&);  /// Not implemented.
@@ -46,6 +46,8 @@ vtkMRMLStorageNode::vtkMRMLStorageNode()
   this->URI = NULL;
   this->URIHandler = NULL;
   this->UseCompression = 1;
+  this->CompressionPreset = CompressionNormal;
+  this->NumberOfWriteThreads = 0;
   this->ReadState = this->Idle;
   this->WriteState = this->Idle;
   this->URIHandler = NULL;
@@ -340,6 +342,7 @@ void vtkMRMLStorageNode::Copy(vtkMRMLNode *anode)
     this->AddURI(node->GetNthURI(i));
     }
   this->SetUseCompression(node->UseCompression);
+  this->SetCompressionPreset(node->CompressionPreset);
   this->SetReadState(node->ReadState);
   this->SetWriteState(node->WriteState);
   this->SetDefaultWriteFileExtension(node->GetDefaultWriteFileExtension());
@@ -366,6 +369,8 @@ void vtkMRMLStorageNode::PrintSelf(ostream& os, vtkIndent indent)
     os << indent << "URIListMember: " << this->GetNthURI(i) << "\n";
     }
   os << indent << "UseCompression:   " << this->UseCompression << "\n";
+  os << indent << "CompressionPreset: " << this->GetCompressionPresetAsString(this->CompressionPreset) << "\n";
+  os << indent << "NumberOfWriteThreads: " << this->NumberOfWriteThreads << "\n";
   os << indent << "ReadState:  " << this->GetReadStateAsString() << "\n";
   os << indent << "WriteState: " << this->GetWriteStateAsString() << "\n";
   os << indent << "SupportedWriteFileTypes: \n";
@@ -589,6 +594,37 @@ const char * vtkMRMLStorageNode::GetStateAsString(int state)
   return "(undefined)";
 }
 
+//----------------------------------------------------------------------------
+const char* vtkMRMLStorageNode::GetCompressionPresetAsString(int preset)
+{
+  switch (preset)
+    {
+    case CompressionFastest: return "Fastest";
+    case CompressionNormal: return "Normal";
+    case CompressionMinimumSize: return "MinimumSize";
+    default:
+      break;
+    }
+  return "(undefined)";
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLStorageNode::GetCompressionPresetFromString(const char* name)
+{
+  if (name == NULL)
+    {
+    return -1;
+    }
+  for (int preset = 0; preset < CompressionPreset_Last; ++preset)
+    {
+    if (strcmp(name, GetCompressionPresetAsString(preset)) == 0)
+      {
+      return preset;
+      }
+    }
+  return -1;
+}
+
 //----------------------------------------------------------------------------
 std::string vtkMRMLStorageNode::GetFullNameFromFileName()
 {
@@ -1131,6 +1167,12 @@ bool vtkMRMLStorageNode::CanWriteFromReferenceNode(vtkMRMLNode *refNode)
   return this->CanReadInReferenceNode(refNode);
 }
 
+//------------------------------------------------------------------------------
+bool vtkMRMLStorageNode::CanReadHeader(vtkMRMLNode *refNode)
+{
+  return this->CanReadInReferenceNode(refNode);
+}
+
 //------------------------------------------------------------------------------
 int vtkMRMLStorageNode::ReadData(vtkMRMLNode* refNode, bool temporary)
 {
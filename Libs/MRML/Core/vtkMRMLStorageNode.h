@@ -91,6 +91,31 @@ public:
   vtkGetMacro(UseCompression, int);
   vtkSetMacro(UseCompression, int);
 
+  ///
+  /// Speed and file size trade-off of the compression on write.
+  /// Writers that cannot select a compression level ignore it, and only
+  /// storage nodes whose writer uses it save it in the scene.
+  /// \sa UseCompression
+  enum
+  {
+    CompressionFastest = 0,
+    CompressionNormal,
+    CompressionMinimumSize,
+    CompressionPreset_Last
+  };
+  vtkSetClampMacro(CompressionPreset, int, CompressionFastest, CompressionPreset_Last - 1);
+  vtkGetMacro(CompressionPreset, int);
+  static const char* GetCompressionPresetAsString(int preset);
+  /// Return -1 if the name does not match any preset
+  static int GetCompressionPresetFromString(const char* name);
+
+  ///
+  /// Number of threads the writer may use, e.g. to compress the data.
+  /// 0 (default) lets the writer choose. It is not saved in the scene.
+  /// \sa vtkMRMLScene::WriteStorableNodes()
+  vtkSetMacro(NumberOfWriteThreads, int);
+  vtkGetMacro(NumberOfWriteThreads, int);
+
   ///
   /// Location of the remote copy of this file.
   vtkSetStringMacro(URI);
@@ -287,6 +312,13 @@ public:
   /// Subclasses can reimplement the method.
   /// \sa CanReadInReferenceNode, WriteData
   virtual bool CanWriteFromReferenceNode(vtkMRMLNode* refNode);
+  /// Return true if the file looks like it can be read into the reference
+  /// node. Only the file header is inspected, the data is not read, so it
+  /// can be used to choose a storage node before calling ReadData.
+  /// By default it returns the same than CanReadInReferenceNode.
+  /// Subclasses can reimplement the method.
+  /// \sa CanReadInReferenceNode, ReadData
+  virtual bool CanReadHeader(vtkMRMLNode* refNode);
 
   ///
   /// Configure the storage node for data exchange. This is an
@@ -333,6 +365,8 @@ protected:
   char *URI;
   vtkURIHandler *URIHandler;
   int UseCompression;
+  int CompressionPreset;
+  int NumberOfWriteThreads;
   int ReadState;
   int WriteState;
 
@@ -30,16 +30,21 @@
 #include <vtkTable.h>
 #include <vtkStringArray.h>
 #include <vtkBitArray.h>
+#include <vtkDoubleArray.h>
 #include <vtkNew.h>
 #include <vtkSQLQuery.h>
-#include <vtkRowQueryToTable.h>
 #include <vtkSQLDatabase.h>
 #include <vtkSQLiteDatabase.h>
 #include <vtkSQLiteQuery.h>
 #include <vtkSmartPointer.h>
+#include <vtkTypeInt64Array.h>
+#include <vtkVariant.h>
 
 #include <vtksys/SystemTools.hxx>
 
+// STD includes
+#include <vector>
+
 //------------------------------------------------------------------------------
 vtkMRMLNodeNewMacro(vtkMRMLTableSQLiteStorageNode);
 
@@ -104,16 +109,13 @@ int vtkMRMLTableSQLiteStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
 
   vtkSmartPointer<vtkSQLiteQuery> query = vtkSmartPointer<vtkSQLiteQuery>::Take(
                    vtkSQLiteQuery::SafeDownCast( database->GetQueryInstance()));
-  std::string queryString("select * from ");
-  queryString += std::string(this->TableName);
-  query->SetQuery(queryString.c_str());
-  query->Execute();
-
-  vtkSmartPointer<vtkRowQueryToTable> queryToTable = vtkSmartPointer<vtkRowQueryToTable>::New();
-  queryToTable->SetQuery(query);
-  queryToTable->Update();
-
-  vtkSmartPointer<vtkTable> table = queryToTable->GetOutput();
+  vtkSmartPointer<vtkTable> table = vtkSmartPointer<vtkTable>::New();
+  if (!this->ReadTable(query, this->TableName, table))
+    {
+    vtkErrorMacro("ReadData: failed to read table '" << (this->TableName ? this->TableName : "")
+                  << "' from database file '" << fullName << "'");
+    return 0;
+    }
 
   tableNode->SetAndObserveTable(table);
 
@@ -177,15 +179,11 @@ int vtkMRMLTableSQLiteStorageNode::WriteDataInternal(vtkMRMLNode *refNode)
   this->DropTable(this->TableName, database);
 
   //converting this table to SQLite will require two queries: one to create
-  //the table, and another to populate its rows with data.
+  //the table, and a prepared one to populate its rows with data.
   std::string createTableQuery = "CREATE TABLE IF NOT EXISTS ";
   createTableQuery += this->TableName;
   createTableQuery += "(";
 
-  std::string insertPreamble = "INSERT into ";
-  insertPreamble += this->TableName;
-  insertPreamble += "(";
-
   //get the columns from the vtkTable to finish the query
   vtkIdType numColumns = table->GetNumberOfColumns();
   for(vtkIdType i = 0; i < numColumns; i++)
@@ -193,7 +191,6 @@ int vtkMRMLTableSQLiteStorageNode::WriteDataInternal(vtkMRMLNode *refNode)
     //get this column's name
     std::string columnName = table->GetColumn(i)->GetName();
     createTableQuery += columnName;
-    insertPreamble += "'" + columnName + "'";
 
     //figure out what type of data is stored in this column
     std::string columnType = table->GetColumn(i)->GetClassName();
@@ -216,12 +213,10 @@ int vtkMRMLTableSQLiteStorageNode::WriteDataInternal(vtkMRMLNode *refNode)
     if(i == numColumns - 1)
       {
       createTableQuery += ");";
-      insertPreamble += ") VALUES (";
       }
     else
       {
       createTableQuery += ", ";
-      insertPreamble += ", ";
       }
     }
 
@@ -230,40 +225,273 @@ int vtkMRMLTableSQLiteStorageNode::WriteDataInternal(vtkMRMLNode *refNode)
     static_cast<vtkSQLiteQuery*>(database->GetQueryInstance());
 
   query->SetQuery(createTableQuery.c_str());
-  cout << "creating the table" << endl;
   if(!query->Execute())
     {
     vtkErrorMacro(<<"Error performing 'create table' query");
     }
 
-  //iterate over the rows of the vtkTable to complete the insert query
+  int success = this->WriteTableRows(query, this->TableName, table);
+  if (!success)
+    {
+    vtkErrorMacro("WriteData: failed to write the rows of table '"
+                  << this->TableName << "' in database file '" << fullName << "'");
+    }
+
+  //cleanup and return
+  query->Delete();
+  database->Close();
+  database->Delete();
+
+  if (success)
+    {
+    vtkDebugMacro("WriteData: successfully wrote table to database: " << fullName);
+    }
+  return success;
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLTableSQLiteStorageNode::WriteTableRows(vtkSQLiteQuery* query,
+  const char* tableName, vtkTable* table)
+{
+  if (!query || !tableName || !table)
+    {
+    return 0;
+    }
+  vtkIdType numColumns = table->GetNumberOfColumns();
   vtkIdType numRows = table->GetNumberOfRows();
-  for(vtkIdType i = 0; i < numRows; i++)
+  if (numColumns == 0 || numRows == 0)
+    {
+    return 1;
+    }
+
+  // All the rows are inserted with the same prepared statement: values are
+  // bound instead of being formatted and parsed again, and quotes in strings
+  // need no escaping.
+  std::string insertQuery = "INSERT INTO ";
+  insertQuery += tableName;
+  insertQuery += " VALUES (";
+  for (vtkIdType j = 0; j < numColumns; j++)
+    {
+    insertQuery += (j == 0 ? "?" : ", ?");
+    }
+  insertQuery += ");";
+
+  // Resolve the type of each column once instead of for each value.
+  std::vector<vtkDataArray*> realColumns(numColumns, static_cast<vtkDataArray*>(0));
+  std::vector<vtkDataArray*> integerColumns(numColumns, static_cast<vtkDataArray*>(0));
+  std::vector<vtkStringArray*> stringColumns(numColumns, static_cast<vtkStringArray*>(0));
+  for (vtkIdType j = 0; j < numColumns; j++)
+    {
+    vtkAbstractArray* column = table->GetColumn(j);
+    vtkDataArray* dataColumn = vtkDataArray::SafeDownCast(column);
+    if (dataColumn && dataColumn->GetNumberOfComponents() == 1
+        && !vtkBitArray::SafeDownCast(dataColumn))
+      {
+      if (dataColumn->GetDataType() == VTK_FLOAT || dataColumn->GetDataType() == VTK_DOUBLE)
+        {
+        realColumns[j] = dataColumn;
+        }
+      else
+        {
+        integerColumns[j] = dataColumn;
+        }
+      }
+    else
+      {
+      stringColumns[j] = vtkStringArray::SafeDownCast(column);
+      }
+    }
+
+  // Without a transaction, SQLite commits (and syncs the file) after each row.
+  if (!query->BeginTransaction())
+    {
+    vtkErrorMacro("WriteTableRows: failed to begin transaction: " << query->GetLastErrorText());
+    return 0;
+    }
+  if (!query->SetQuery(insertQuery.c_str()))
+    {
+    vtkErrorMacro("WriteTableRows: failed to prepare '" << insertQuery << "': "
+                  << query->GetLastErrorText());
+    query->RollbackTransaction();
+    return 0;
+    }
+  for (vtkIdType i = 0; i < numRows; i++)
     {
-    std::string insertQuery = insertPreamble;
     for (vtkIdType j = 0; j < numColumns; j++)
       {
-      insertQuery += "'" + table->GetValue(i, j).ToString() + "'";
-      if(j < numColumns - 1)
+      int parameter = static_cast<int>(j);
+      if (realColumns[j])
+        {
+        query->BindParameter(parameter, realColumns[j]->GetComponent(i, 0));
+        }
+      else if (integerColumns[j])
+        {
+        // GetComponent() would go through a double and round the values
+        // above 2^53 (e.g. 64-bit identifiers).
+        vtkVariant value = integerColumns[j]->GetVariantValue(i);
+        if ((value.IsUnsignedLong() || value.IsUnsignedLongLong())
+            && value.ToTypeUInt64() > static_cast<vtkTypeUInt64>(VTK_TYPE_INT64_MAX))
+          {
+          // out of the range of SQLite integers
+          query->BindParameter(parameter, value.ToString());
+          }
+        else
+          {
+          query->BindParameter(parameter, value.ToTypeInt64());
+          }
+        }
+      else if (stringColumns[j])
         {
-        insertQuery += ", ";
+        query->BindParameter(parameter, stringColumns[j]->GetValue(i));
         }
+      else
+        {
+        query->BindParameter(parameter, table->GetValue(i, j).ToString());
+        }
+      }
+    if (!query->Execute())
+      {
+      vtkErrorMacro("WriteTableRows: failed to insert row " << i << ": "
+                    << query->GetLastErrorText());
+      query->RollbackTransaction();
+      return 0;
       }
-    insertQuery += ");";
-    //perform the insert query for this row
-    query->SetQuery(insertQuery.c_str());
-    if(!query->Execute())
+    }
+  if (!query->CommitTransaction())
+    {
+    vtkErrorMacro("WriteTableRows: failed to commit transaction: " << query->GetLastErrorText());
+    return 0;
+    }
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLTableSQLiteStorageNode::ReadTable(vtkSQLiteQuery* query,
+  const char* tableName, vtkTable* table)
+{
+  if (!query || !tableName || !table)
+    {
+    return 0;
+    }
+
+  // Count the rows first so that the columns are allocated only once.
+  std::string countQuery = std::string("SELECT COUNT(*) FROM ") + tableName;
+  query->SetQuery(countQuery.c_str());
+  if (!query->Execute() || !query->NextRow())
+    {
+    vtkErrorMacro("ReadTable: '" << countQuery << "' failed: " << query->GetLastErrorText());
+    return 0;
+    }
+  vtkIdType numRows = static_cast<vtkIdType>(query->DataValue(0).ToTypeInt64());
+
+  std::string selectQuery = std::string("SELECT * FROM ") + tableName;
+  query->SetQuery(selectQuery.c_str());
+  if (!query->Execute())
+    {
+    vtkErrorMacro("ReadTable: '" << selectQuery << "' failed: " << query->GetLastErrorText());
+    return 0;
+    }
+  int numColumns = query->GetNumberOfFields();
+
+  table->Initialize();
+  bool hasRow = query->NextRow();
+
+  // The type of the columns is given by the first row, like in
+  // vtkRowQueryToTable. Values are then stored directly in typed arrays
+  // instead of building a vtkVariantArray for each row.
+  std::vector<vtkTypeInt64Array*> integerColumns(numColumns, static_cast<vtkTypeInt64Array*>(0));
+  std::vector<vtkDoubleArray*> realColumns(numColumns, static_cast<vtkDoubleArray*>(0));
+  std::vector<vtkStringArray*> stringColumns(numColumns, static_cast<vtkStringArray*>(0));
+  bool hasIntegerColumns = false;
+  for (int j = 0; j < numColumns; j++)
+    {
+    int fieldType = hasRow ? query->GetFieldType(j) : VTK_STRING;
+    vtkSmartPointer<vtkAbstractArray> column;
+    if (fieldType == VTK_INT)
+      {
+      integerColumns[j] = vtkTypeInt64Array::New();
+      column.TakeReference(integerColumns[j]);
+      hasIntegerColumns = true;
+      }
+    else if (fieldType == VTK_DOUBLE)
+      {
+      realColumns[j] = vtkDoubleArray::New();
+      column.TakeReference(realColumns[j]);
+      }
+    else
       {
-      vtkErrorMacro(<<"Error performing 'insert' query");
+      stringColumns[j] = vtkStringArray::New();
+      column.TakeReference(stringColumns[j]);
       }
+    column->SetName(query->GetFieldName(j));
+    column->SetNumberOfTuples(numRows);
+    table->AddColumn(column);
     }
 
-  //cleanup and return
-  query->Delete();
-  database->Close();
-  database->Delete();
+  if (hasIntegerColumns)
+    {
+    // vtkSQLiteQuery::DataValue() reads integers with sqlite3_column_int(),
+    // which truncates them to 32 bits. Integer columns are selected as text
+    // instead, and converted to 64-bit integers.
+    selectQuery = "SELECT ";
+    for (int j = 0; j < numColumns; j++)
+      {
+      std::string columnName = std::string("\"") + table->GetColumn(j)->GetName() + "\"";
+      selectQuery += (j == 0 ? "" : ", ");
+      selectQuery += (integerColumns[j] ? "CAST(" + columnName + " AS TEXT)" : columnName);
+      }
+    selectQuery += std::string(" FROM ") + tableName;
+    query->SetQuery(selectQuery.c_str());
+    if (!query->Execute())
+      {
+      vtkErrorMacro("ReadTable: '" << selectQuery << "' failed: " << query->GetLastErrorText());
+      return 0;
+      }
+    hasRow = query->NextRow();
+    }
 
-  vtkDebugMacro("WriteData: successfully wrote table to database: " << fullName);
+  vtkIdType row = 0;
+  for (; hasRow; hasRow = query->NextRow(), ++row)
+    {
+    if (row >= numRows)
+      {
+      // The table has been modified since it was counted
+      numRows = 2 * numRows + 1;
+      for (int j = 0; j < numColumns; j++)
+        {
+        table->GetColumn(j)->Resize(numRows);
+        table->GetColumn(j)->SetNumberOfTuples(numRows);
+        }
+      }
+    for (int j = 0; j < numColumns; j++)
+      {
+      vtkVariant value = query->DataValue(j);
+      if (integerColumns[j])
+        {
+        integerColumns[j]->SetValue(row, value.ToTypeInt64());
+        }
+      else if (realColumns[j])
+        {
+        realColumns[j]->SetValue(row, value.ToDouble());
+        }
+      else
+        {
+        stringColumns[j]->SetValue(row, value.ToString());
+        }
+      }
+    }
+  if (query->HasError())
+    {
+    vtkErrorMacro("ReadTable: failed to read row " << row << ": " << query->GetLastErrorText());
+    return 0;
+    }
+  if (row != numRows)
+    {
+    for (int j = 0; j < numColumns; j++)
+      {
+      table->GetColumn(j)->SetNumberOfTuples(row);
+      }
+    }
   return 1;
 }
 
@@ -33,6 +33,8 @@
 ///
 
 class vtkSQLiteDatabase;
+class vtkSQLiteQuery;
+class vtkTable;
 
 class VTK_MRML_EXPORT vtkMRMLTableSQLiteStorageNode : public vtkMRMLStorageNode
 {
@@ -60,6 +62,17 @@ public:
   /// Drop a specified table from the database
   static int DropTable(char *tableName, vtkSQLiteDatabase* database);
 
+  /// Insert all the rows of \a table into the existing database table
+  /// \a tableName, in a single transaction and with one prepared statement.
+  /// Returns 0 on failure, in which case no row is inserted.
+  int WriteTableRows(vtkSQLiteQuery* query, const char* tableName, vtkTable* table);
+
+  /// Replace the content of \a table by the database table \a tableName.
+  /// Columns are allocated once for all the rows and filled directly.
+  /// INTEGER columns are read into vtkTypeInt64Array.
+  /// Returns 0 on failure.
+  int ReadTable(vtkSQLiteQuery* query, const char* tableName, vtkTable* table);
+
 protected:
   vtkMRMLTableSQLiteStorageNode();
   ~vtkMRMLTableSQLiteStorageNode();
@@ -259,6 +259,56 @@ void ApplyImageSeriesReaderWorkaround(vtkMRMLVolumeArchetypeStorageNode * storag
 }
 } // end of anonymous namespace
 
+//----------------------------------------------------------------------------
+bool vtkMRMLVolumeArchetypeStorageNode::CanReadHeader(vtkMRMLNode *refNode)
+{
+  if (!this->CanReadInReferenceNode(refNode))
+    {
+    return false;
+    }
+  if (this->GetFileName() == NULL)
+    {
+    // Remote files are downloaded by ReadData, the header can't be read yet.
+    return this->GetURI() != NULL;
+    }
+  std::string fullName = this->GetFullNameFromFileName();
+  if (fullName.empty())
+    {
+    return false;
+    }
+
+  if (refNode->IsA("vtkMRMLVectorVolumeNode"))
+    {
+    // the reader is only instantiated if the header has 3 or more components
+    vtkSmartPointer<vtkITKArchetypeImageSeriesReader> vectorReader;
+    vectorReader.TakeReference(this->InstantiateVectorVolumeReader(fullName));
+    return vectorReader.GetPointer() != NULL;
+    }
+
+  // All the readers share the same header parsing, the cheapest one is used.
+  vtkNew<vtkITKArchetypeImageSeriesScalarReader> reader;
+  reader->SetSingleFile( this->GetSingleFile() );
+  reader->SetUseOrientationFromFile( this->GetUseOrientationFromFile() );
+  reader->ResetFileNames();
+  reader->SetArchetype(fullName.c_str());
+  ApplyImageSeriesReaderWorkaround(this, reader.GetPointer(), fullName);
+  try
+    {
+    reader->UpdateInformation();
+    }
+  catch ( ... )
+    {
+    return false;
+    }
+
+  unsigned int numberOfComponents = reader->GetNumberOfComponents();
+  if (refNode->IsA("vtkMRMLDiffusionTensorVolumeNode"))
+    {
+    return numberOfComponents == 6 || numberOfComponents == 9;
+    }
+  return numberOfComponents == 1;
+}
+
 //----------------------------------------------------------------------------
 int vtkMRMLVolumeArchetypeStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
 {
@@ -76,6 +76,12 @@ public:
   virtual bool CanReadInReferenceNode(vtkMRMLNode* refNode);
   virtual bool CanWriteFromReferenceNode(vtkMRMLNode* refNode);
 
+  /// Return true if the number of components of the image found in the
+  /// file header matches the reference node (1 for scalar volumes, 3 or
+  /// more for vector volumes, 6 or 9 for tensor volumes).
+  /// The image data is not read.
+  virtual bool CanReadHeader(vtkMRMLNode* refNode);
+
   ///
   /// Configure the storage node for data exchange. This is an
   /// opportunity to optimize the storage node's settings, for
@@ -0,0 +1,207 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH)
+  All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Program:   3D Slicer
+
+=========================================================================auto=*/
+
+// MRMLIDImageIO includes
+#include "itkMRMLSharedMemoryImageIO.h"
+
+// ITK includes
+#include <itkImage.h>
+#include <itkImageFileReader.h>
+#include <itkImageFileWriter.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIterator.h>
+
+// STD includes
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace
+{
+typedef itk::Image<short, 3> ImageType;
+
+//----------------------------------------------------------------------------
+ImageType::Pointer CreateImage()
+{
+  ImageType::Pointer image = ImageType::New();
+  ImageType::SizeType size;
+  size[0] = 7;
+  size[1] = 5;
+  size[2] = 3;
+  ImageType::RegionType region;
+  region.SetSize(size);
+  image->SetRegions(region);
+  image->Allocate();
+
+  ImageType::SpacingType spacing;
+  spacing[0] = 0.5;
+  spacing[1] = 1.5;
+  spacing[2] = 2.5;
+  image->SetSpacing(spacing);
+  ImageType::PointType origin;
+  origin[0] = -10.0;
+  origin[1] = 20.0;
+  origin[2] = 30.5;
+  image->SetOrigin(origin);
+  // axes are permuted and flipped so that rows and columns cannot be mixed up
+  ImageType::DirectionType direction;
+  direction.Fill(0.0);
+  direction[0][1] = 1.0;
+  direction[1][2] = -1.0;
+  direction[2][0] = 1.0;
+  image->SetDirection(direction);
+
+  short value = -100;
+  itk::ImageRegionIterator<ImageType> it(image, region);
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+    {
+    it.Set(value);
+    value += 7;
+    }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+bool WriteImage(ImageType* image, const std::string& fileName)
+{
+  typedef itk::ImageFileWriter<ImageType> WriterType;
+  WriterType::Pointer writer = WriterType::New();
+  writer->SetImageIO(itk::MRMLSharedMemoryImageIO::New());
+  writer->SetFileName(fileName);
+  writer->SetInput(image);
+  try
+    {
+    writer->Update();
+    }
+  catch (itk::ExceptionObject&)
+    {
+    return false;
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int itkMRMLSharedMemoryImageIOTest1(int, char * [])
+{
+  if (!itk::MRMLSharedMemoryImageIO::IsSharedMemorySupported())
+    {
+    std::cout << "Shared memory is not supported on this platform, test skipped." << std::endl;
+    return EXIT_SUCCESS;
+    }
+
+  itk::MRMLSharedMemoryImageIO::Pointer io = itk::MRMLSharedMemoryImageIO::New();
+  if (io->CanWriteFile("/tmp/image.nrrd") || io->CanWriteFile("shm:/invalid/name"))
+    {
+    std::cerr << __LINE__ << ": CanWriteFile accepted an invalid segment name" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::ostringstream fileNameStream;
+  fileNameStream << "shm:/slicer-test-";
+#ifndef _WIN32
+  fileNameStream << getpid();
+#endif
+  std::string fileName = fileNameStream.str();
+  // segment left by a previous run that crashed
+  itk::MRMLSharedMemoryImageIO::RemoveSegment(fileName.c_str());
+
+  ImageType::Pointer image = CreateImage();
+  if (!WriteImage(image, fileName))
+    {
+    std::cerr << __LINE__ << ": Failed to write " << fileName << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Existing segments are never reused
+  if (WriteImage(image, fileName))
+    {
+    std::cerr << __LINE__ << ": Writing into an existing segment succeeded" << std::endl;
+    itk::MRMLSharedMemoryImageIO::RemoveSegment(fileName.c_str());
+    return EXIT_FAILURE;
+    }
+
+  typedef itk::ImageFileReader<ImageType> ReaderType;
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetImageIO(itk::MRMLSharedMemoryImageIO::New());
+  reader->SetFileName(fileName);
+  try
+    {
+    reader->Update();
+    }
+  catch (itk::ExceptionObject& exc)
+    {
+    std::cerr << __LINE__ << ": Failed to read " << fileName << ": " << exc << std::endl;
+    itk::MRMLSharedMemoryImageIO::RemoveSegment(fileName.c_str());
+    return EXIT_FAILURE;
+    }
+  ImageType::Pointer readImage = reader->GetOutput();
+
+  // The image is copied out of the segment, it stays valid after removal
+  if (!itk::MRMLSharedMemoryImageIO::RemoveSegment(fileName.c_str()))
+    {
+    std::cerr << __LINE__ << ": Failed to remove " << fileName << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (io->CanReadFile(fileName.c_str())
+    || itk::MRMLSharedMemoryImageIO::RemoveSegment(fileName.c_str()))
+    {
+    std::cerr << __LINE__ << ": Segment " << fileName << " still exists after removal" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  if (readImage->GetLargestPossibleRegion() != image->GetLargestPossibleRegion())
+    {
+    std::cerr << __LINE__ << ": Region mismatch: " << readImage->GetLargestPossibleRegion()
+              << " instead of " << image->GetLargestPossibleRegion() << std::endl;
+    return EXIT_FAILURE;
+    }
+  for (unsigned int i = 0; i < 3; ++i)
+    {
+    if (readImage->GetSpacing()[i] != image->GetSpacing()[i]
+      || readImage->GetOrigin()[i] != image->GetOrigin()[i])
+      {
+      std::cerr << __LINE__ << ": Geometry mismatch along axis " << i << ": spacing "
+                << readImage->GetSpacing()[i] << ", origin " << readImage->GetOrigin()[i] << std::endl;
+      return EXIT_FAILURE;
+      }
+    for (unsigned int j = 0; j < 3; ++j)
+      {
+      if (std::fabs(readImage->GetDirection()[i][j] - image->GetDirection()[i][j]) > 1e-12)
+        {
+        std::cerr << __LINE__ << ": Direction mismatch: " << readImage->GetDirection()
+                  << " instead of " << image->GetDirection() << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    }
+
+  itk::ImageRegionConstIterator<ImageType> it(image, image->GetLargestPossibleRegion());
+  itk::ImageRegionConstIterator<ImageType> readIt(readImage, readImage->GetLargestPossibleRegion());
+  for (it.GoToBegin(), readIt.GoToBegin(); !it.IsAtEnd(); ++it, ++readIt)
+    {
+    if (it.Get() != readIt.Get())
+      {
+      std::cerr << __LINE__ << ": Voxel mismatch at " << it.GetIndex() << ": "
+                << readIt.Get() << " instead of " << it.Get() << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  std::cout << "Shared memory ImageIO test passed." << std::endl;
+  return EXIT_SUCCESS;
+}
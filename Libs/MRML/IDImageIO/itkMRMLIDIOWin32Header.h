@@ -31,4 +31,14 @@
 #define MRMLIDImageIO_EXPORT
 #endif
 
+#if defined(WIN32) && !defined(MRMLIDIO_STATIC)
+#if defined(MRMLSharedMemoryIO_EXPORTS)
+#define MRMLSharedMemoryIO_EXPORT __declspec( dllexport )
+#else
+#define MRMLSharedMemoryIO_EXPORT __declspec( dllimport )
+#endif
+#else
+#define MRMLSharedMemoryIO_EXPORT
+#endif
+
 #endif
@@ -0,0 +1,25 @@
+#ifndef __itkMRMLSharedMemoryIOPlugin_h
+#define __itkMRMLSharedMemoryIOPlugin_h
+
+#include "itkObjectFactoryBase.h"
+
+#ifdef WIN32
+#ifdef MRMLSharedMemoryIOPlugin_EXPORTS
+#define MRMLSharedMemoryIOPlugin_EXPORT __declspec(dllexport)
+#else
+#define MRMLSharedMemoryIOPlugin_EXPORT __declspec(dllimport)
+#endif
+#else
+#define MRMLSharedMemoryIOPlugin_EXPORT
+#endif
+
+/**
+ * Routine that is called when the shared library is loaded by
+ * itk::ObjectFactoryBase::LoadDynamicFactories().
+ *
+ * itkLoad() is C (not C++) function.
+ */
+extern "C" {
+    MRMLSharedMemoryIOPlugin_EXPORT itk::ObjectFactoryBase* itkLoad();
+}
+#endif
@@ -0,0 +1,387 @@
+/*=auto=========================================================================
+
+Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+See COPYRIGHT.txt
+or http://www.slicer.org/copyright/copyright.txt for details.
+
+Program:   3D Slicer
+Module:    $RCSfile: itkMRMLSharedMemoryImageIO.cxx,v $
+
+=========================================================================auto=*/
+
+#include "itkMRMLSharedMemoryImageIO.h"
+
+// STD includes
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+const char MRMLSharedMemoryImageMagic[8] = "SLCRSHM";
+const char MRMLSharedMemoryImageScheme[] = "shm:";
+
+// Voxels start on their own page, which also leaves room for the header.
+const unsigned long long MRMLSharedMemoryImageDataOffset = 4096;
+
+//----------------------------------------------------------------------------
+std::string GetSegmentName(const char* fileName)
+{
+  if (!itk::MRMLSharedMemoryImageIO::IsSharedMemoryFileName(fileName))
+    {
+    return std::string();
+    }
+  // POSIX requires the name to start with a single slash
+  std::string name(fileName + strlen(MRMLSharedMemoryImageScheme));
+  if (name.size() < 2 || name[0] != '/' || name.find('/', 1) != std::string::npos)
+    {
+    return std::string();
+    }
+  return name;
+}
+
+//----------------------------------------------------------------------------
+bool IsValidHeader(const itk::MRMLSharedMemoryImageHeader& header)
+{
+  return memcmp(header.Magic, MRMLSharedMemoryImageMagic, sizeof(header.Magic)) == 0
+    && header.HeaderSize == sizeof(itk::MRMLSharedMemoryImageHeader)
+    && header.DataOffset == MRMLSharedMemoryImageDataOffset
+    && header.NumberOfDimensions == 3;
+}
+
+} // end of anonymous namespace
+
+namespace itk {
+//----------------------------------------------------------------------------
+MRMLSharedMemoryImageIO
+::MRMLSharedMemoryImageIO()
+{
+}
+
+//----------------------------------------------------------------------------
+MRMLSharedMemoryImageIO
+::~MRMLSharedMemoryImageIO()
+{
+}
+
+//----------------------------------------------------------------------------
+bool
+MRMLSharedMemoryImageIO
+::IsSharedMemorySupported()
+{
+#ifdef _WIN32
+  return false;
+#else
+  return true;
+#endif
+}
+
+//----------------------------------------------------------------------------
+bool
+MRMLSharedMemoryImageIO
+::IsSharedMemoryFileName(const char* fileName)
+{
+  return fileName != NULL
+    && strncmp(fileName, MRMLSharedMemoryImageScheme, strlen(MRMLSharedMemoryImageScheme)) == 0;
+}
+
+//----------------------------------------------------------------------------
+void
+MRMLSharedMemoryImageIO
+::InitializeHeader(MRMLSharedMemoryImageHeader& header)
+{
+  memset(&header, 0, sizeof(header));
+  memcpy(header.Magic, MRMLSharedMemoryImageMagic, sizeof(header.Magic));
+  header.HeaderSize = sizeof(MRMLSharedMemoryImageHeader);
+  header.NumberOfDimensions = 3;
+  header.DataOffset = MRMLSharedMemoryImageDataOffset;
+}
+
+//----------------------------------------------------------------------------
+void*
+MRMLSharedMemoryImageIO
+::CreateSegment(const char* fileName, const MRMLSharedMemoryImageHeader& header)
+{
+#ifdef _WIN32
+  (void)fileName;
+  (void)header;
+  return NULL;
+#else
+  std::string name = GetSegmentName(fileName);
+  if (name.empty() || !IsValidHeader(header))
+    {
+    return NULL;
+    }
+  size_t size = static_cast<size_t>(header.DataOffset + header.DataSize);
+
+  // Never reuse an existing segment: it could have been created by another
+  // user to feed data to the module. Only the owner can access the segment.
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+  if (fd < 0)
+    {
+    return NULL;
+    }
+  if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+    close(fd);
+    shm_unlink(name.c_str());
+    return NULL;
+    }
+  void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  // the mapping stays valid after the descriptor is closed
+  close(fd);
+  if (base == MAP_FAILED)
+    {
+    shm_unlink(name.c_str());
+    return NULL;
+    }
+  memcpy(base, &header, sizeof(header));
+  return static_cast<char*>(base) + header.DataOffset;
+#endif
+}
+
+//----------------------------------------------------------------------------
+const void*
+MRMLSharedMemoryImageIO
+::OpenSegment(const char* fileName, MRMLSharedMemoryImageHeader& header)
+{
+#ifdef _WIN32
+  (void)fileName;
+  (void)header;
+  return NULL;
+#else
+  std::string name = GetSegmentName(fileName);
+  if (name.empty())
+    {
+    return NULL;
+    }
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    {
+    return NULL;
+    }
+  struct stat segmentStat;
+  if (fstat(fd, &segmentStat) != 0
+    || static_cast<unsigned long long>(segmentStat.st_size) < MRMLSharedMemoryImageDataOffset)
+    {
+    close(fd);
+    return NULL;
+    }
+
+  // Map the header alone first: the size of the segment may have been
+  // rounded up to a page by the system.
+  void* headerPage = mmap(NULL, static_cast<size_t>(MRMLSharedMemoryImageDataOffset),
+                          PROT_READ, MAP_SHARED, fd, 0);
+  if (headerPage == MAP_FAILED)
+    {
+    close(fd);
+    return NULL;
+    }
+  memcpy(&header, headerPage, sizeof(header));
+  munmap(headerPage, static_cast<size_t>(MRMLSharedMemoryImageDataOffset));
+  if (!IsValidHeader(header)
+    || header.DataOffset + header.DataSize > static_cast<unsigned long long>(segmentStat.st_size))
+    {
+    close(fd);
+    return NULL;
+    }
+
+  size_t size = static_cast<size_t>(header.DataOffset + header.DataSize);
+  void* base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    {
+    return NULL;
+    }
+  return static_cast<const char*>(base) + header.DataOffset;
+#endif
+}
+
+//----------------------------------------------------------------------------
+void
+MRMLSharedMemoryImageIO
+::ReleaseSegment(const void* data)
+{
+#ifdef _WIN32
+  (void)data;
+#else
+  if (!data)
+    {
+    return;
+    }
+  char* base = const_cast<char*>(static_cast<const char*>(data)) - MRMLSharedMemoryImageDataOffset;
+  const MRMLSharedMemoryImageHeader* header =
+    reinterpret_cast<const MRMLSharedMemoryImageHeader*>(base);
+  munmap(base, static_cast<size_t>(header->DataOffset + header->DataSize));
+#endif
+}
+
+//----------------------------------------------------------------------------
+bool
+MRMLSharedMemoryImageIO
+::RemoveSegment(const char* fileName)
+{
+#ifdef _WIN32
+  (void)fileName;
+  return false;
+#else
+  std::string name = GetSegmentName(fileName);
+  if (name.empty())
+    {
+    return false;
+    }
+  return shm_unlink(name.c_str()) == 0;
+#endif
+}
+
+//----------------------------------------------------------------------------
+bool
+MRMLSharedMemoryImageIO
+::CanReadFile(const char* fileName)
+{
+  MRMLSharedMemoryImageHeader header;
+  const void* data = MRMLSharedMemoryImageIO::OpenSegment(fileName, header);
+  if (!data)
+    {
+    return false;
+    }
+  MRMLSharedMemoryImageIO::ReleaseSegment(data);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void
+MRMLSharedMemoryImageIO
+::ReadImageInformation()
+{
+  MRMLSharedMemoryImageHeader header;
+  const void* data = MRMLSharedMemoryImageIO::OpenSegment(m_FileName.c_str(), header);
+  if (!data)
+    {
+    itkExceptionMacro("Cannot open shared memory segment " << m_FileName);
+    }
+  MRMLSharedMemoryImageIO::ReleaseSegment(data);
+
+  this->SetNumberOfDimensions(3);
+  for (unsigned int i = 0; i < 3; ++i)
+    {
+    this->SetDimensions(i, static_cast<unsigned int>(header.Dimensions[i]));
+    this->SetSpacing(i, header.Spacing[i]);
+    this->SetOrigin(i, header.Origin[i]);
+    std::vector<double> direction(3);
+    for (unsigned int j = 0; j < 3; ++j)
+      {
+      direction[j] = header.Direction[j][i];
+      }
+    this->SetDirection(i, direction);
+    }
+  this->SetComponentType(static_cast<IOComponentType>(header.ComponentType));
+  this->SetNumberOfComponents(header.NumberOfComponents);
+  this->SetPixelType(header.NumberOfComponents == 1 ? SCALAR : VECTOR);
+}
+
+//----------------------------------------------------------------------------
+void
+MRMLSharedMemoryImageIO
+::Read(void* buffer)
+{
+  MRMLSharedMemoryImageHeader header;
+  const void* data = MRMLSharedMemoryImageIO::OpenSegment(m_FileName.c_str(), header);
+  if (!data)
+    {
+    itkExceptionMacro("Cannot open shared memory segment " << m_FileName);
+    }
+  if (header.DataSize != static_cast<unsigned long long>(this->GetImageSizeInBytes()))
+    {
+    MRMLSharedMemoryImageIO::ReleaseSegment(data);
+    itkExceptionMacro("Shared memory segment " << m_FileName << " contains "
+                      << header.DataSize << " bytes, expected "
+                      << this->GetImageSizeInBytes());
+    }
+  // ITK allocates the buffer of the image, the voxels are copied out of the
+  // segment so that the image remains valid after the segment is removed.
+  memcpy(buffer, data, static_cast<size_t>(header.DataSize));
+  MRMLSharedMemoryImageIO::ReleaseSegment(data);
+}
+
+//----------------------------------------------------------------------------
+bool
+MRMLSharedMemoryImageIO
+::CanWriteFile(const char* fileName)
+{
+  return MRMLSharedMemoryImageIO::IsSharedMemorySupported()
+    && !GetSegmentName(fileName).empty();
+}
+
+//----------------------------------------------------------------------------
+void
+MRMLSharedMemoryImageIO
+::WriteImageInformation()
+{
+}
+
+//----------------------------------------------------------------------------
+void
+MRMLSharedMemoryImageIO
+::Write(const void* buffer)
+{
+  unsigned int numberOfDimensions = this->GetNumberOfDimensions();
+  if (numberOfDimensions > 3)
+    {
+    itkExceptionMacro("Cannot write " << numberOfDimensions
+                      << "D image to shared memory segment " << m_FileName);
+    }
+
+  MRMLSharedMemoryImageHeader header;
+  MRMLSharedMemoryImageIO::InitializeHeader(header);
+  header.ComponentType = this->GetComponentType();
+  header.NumberOfComponents = this->GetNumberOfComponents();
+  for (unsigned int i = 0; i < 3; ++i)
+    {
+    bool imageAxis = (i < numberOfDimensions);
+    header.Dimensions[i] = imageAxis ? this->GetDimensions(i) : 1;
+    header.Spacing[i] = imageAxis ? this->GetSpacing(i) : 1.0;
+    header.Origin[i] = imageAxis ? this->GetOrigin(i) : 0.0;
+    for (unsigned int j = 0; j < 3; ++j)
+      {
+      if (imageAxis)
+        {
+        header.Direction[j][i] = (j < numberOfDimensions ? this->GetDirection(i)[j] : 0.0);
+        }
+      else
+        {
+        header.Direction[j][i] = (i == j ? 1.0 : 0.0);
+        }
+      }
+    }
+  header.DataSize = this->GetImageSizeInBytes();
+
+  void* data = MRMLSharedMemoryImageIO::CreateSegment(m_FileName.c_str(), header);
+  if (!data)
+    {
+    itkExceptionMacro("Cannot create shared memory segment " << m_FileName);
+    }
+  // The buffer belongs to the image written by ITK, it cannot be shared with
+  // another process.
+  memcpy(data, buffer, static_cast<size_t>(header.DataSize));
+  MRMLSharedMemoryImageIO::ReleaseSegment(data);
+}
+
+//----------------------------------------------------------------------------
+void
+MRMLSharedMemoryImageIO
+::PrintSelf(std::ostream& os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  os << indent << "SharedMemorySupported: "
+     << MRMLSharedMemoryImageIO::IsSharedMemorySupported() << std::endl;
+}
+
+} // end namespace itk
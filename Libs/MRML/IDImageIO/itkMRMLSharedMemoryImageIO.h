@@ -0,0 +1,147 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Program:   MRML
+  Module:    $RCSfile: itkMRMLSharedMemoryImageIO.h,v $
+
+=========================================================================auto=*/
+
+#ifndef __itkMRMLSharedMemoryImageIO_h
+#define __itkMRMLSharedMemoryImageIO_h
+
+#ifdef _MSC_VER
+#pragma warning ( disable : 4786 )
+#endif
+
+#include "itkMRMLIDIOWin32Header.h"
+
+#include "itkImageIOBase.h"
+
+namespace itk
+{
+/** \struct MRMLSharedMemoryImageHeader
+ * \brief Header placed at the beginning of a shared memory image segment.
+ *
+ * Geometry is stored in LPS, the way ITK expects it. Direction[i][j]
+ * is the i-th component of the direction of the j-th image axis.
+ * The voxels follow the header at DataOffset bytes from the start of
+ * the segment.
+ */
+struct MRMLSharedMemoryImageHeader
+{
+  char Magic[8];
+  unsigned int HeaderSize;
+  int ComponentType;
+  unsigned int NumberOfComponents;
+  unsigned int NumberOfDimensions;
+  unsigned long long Dimensions[3];
+  double Spacing[3];
+  double Origin[3];
+  double Direction[3][3];
+  unsigned long long DataOffset;
+  unsigned long long DataSize;
+};
+
+/** \class MRMLSharedMemoryImageIO
+ * \brief ImageIO object for exchanging images through POSIX shared memory
+ *
+ * MRMLSharedMemoryImageIO lets Slicer and an executable command line
+ * module exchange images without writing them to the temporary
+ * directory. Slicer creates one shared memory segment per input image
+ * and passes its name to the module instead of a filename; the module
+ * reads it with a standard ITK ImageFileReader. Output images are
+ * written by the module into segments named by Slicer, which maps them
+ * back once the module exits.
+ *
+ * The "filename" specified looks like:
+ *     <code>shm:/\<segment name\></code>
+ *
+ * This ImageIO only depends on ITK so that it can be loaded as a
+ * plugin by executables without pulling VTK or MRML into them. On
+ * platforms without POSIX shared memory, IsSharedMemorySupported()
+ * returns false and callers are expected to use files instead.
+ */
+class MRMLSharedMemoryIO_EXPORT MRMLSharedMemoryImageIO : public ImageIOBase
+{
+public:
+  /** Standard class typedefs. */
+  typedef MRMLSharedMemoryImageIO  Self;
+  typedef ImageIOBase              Superclass;
+  typedef SmartPointer<Self>       Pointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(MRMLSharedMemoryImageIO, ImageIOBase);
+
+  /** Determine the file type. Returns true if this ImageIO can read the
+   * file specified. */
+  virtual bool CanReadFile(const char*) ITK_OVERRIDE;
+
+  /** Set the spacing and dimension information for the set filename. */
+  virtual void ReadImageInformation() ITK_OVERRIDE;
+
+  /** Reads the data from the shared memory segment into the memory
+   * buffer provided. */
+  virtual void Read(void* buffer) ITK_OVERRIDE;
+
+  /** Determine the file type. Returns true if this ImageIO can write the
+   * file specified. */
+  virtual bool CanWriteFile(const char*) ITK_OVERRIDE;
+
+  /** Header is written together with the data in Write(). */
+  virtual void WriteImageInformation() ITK_OVERRIDE;
+
+  /** Creates the shared memory segment and copies the buffer in it. */
+  virtual void Write(const void* buffer) ITK_OVERRIDE;
+
+  /** Return true if shared memory segments can be created on this
+   * platform. */
+  static bool IsSharedMemorySupported();
+
+  /** Return true if fileName uses the "shm:" scheme. */
+  static bool IsSharedMemoryFileName(const char* fileName);
+
+  /** Initialize the magic string, header size and data offset of a
+   * header. */
+  static void InitializeHeader(MRMLSharedMemoryImageHeader& header);
+
+  /** Create the segment designated by fileName, large enough for
+   * header.DataSize bytes of voxels, and copy the header in it. The
+   * segment is only accessible by the current user. Fails if the segment
+   * already exists. Return a writable pointer to the voxels or NULL on
+   * failure. The segment must be released with ReleaseSegment() and
+   * removed with RemoveSegment(). */
+  static void* CreateSegment(const char* fileName,
+                             const MRMLSharedMemoryImageHeader& header);
+
+  /** Map an existing segment and validate its header. Return a pointer
+   * to the voxels or NULL on failure. The segment must be released with
+   * ReleaseSegment(). */
+  static const void* OpenSegment(const char* fileName,
+                                 MRMLSharedMemoryImageHeader& header);
+
+  /** Unmap a segment returned by CreateSegment() or OpenSegment(). The
+   * segment content is kept until RemoveSegment() is called. */
+  static void ReleaseSegment(const void* data);
+
+  /** Remove the segment designated by fileName. */
+  static bool RemoveSegment(const char* fileName);
+
+protected:
+  MRMLSharedMemoryImageIO();
+  ~MRMLSharedMemoryImageIO();
+  void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
+
+private:
+  MRMLSharedMemoryImageIO(const Self&); //purposely not implemented
+  void operator=(const Self&); //purposely not implemented
+};
+
+} /// end namespace itk
+#endif /// __itkMRMLSharedMemoryImageIO_h
@@ -0,0 +1,49 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkMRMLSharedMemoryImageIOFactory.cxx,v $
+  Language:  C++
+  Date:      $Date: 2004/07/15 16:26:40 $
+  Version:   $Revision: 1.1 $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkMRMLSharedMemoryImageIOFactory.h"
+#include "itkVersion.h"
+
+
+namespace itk
+{
+MRMLSharedMemoryImageIOFactory::MRMLSharedMemoryImageIOFactory()
+{
+  this->RegisterOverride("itkImageIOBase",
+                         "itkMRMLSharedMemoryImageIO",
+                         "ImageIO to exchange images through shared memory.",
+                         1,
+                         CreateObjectFunction<MRMLSharedMemoryImageIO>::New());
+}
+
+MRMLSharedMemoryImageIOFactory::~MRMLSharedMemoryImageIOFactory()
+{
+}
+
+const char*
+MRMLSharedMemoryImageIOFactory::GetITKSourceVersion(void) const
+{
+  return ITK_SOURCE_VERSION;
+}
+
+const char*
+MRMLSharedMemoryImageIOFactory::GetDescription() const
+{
+  return "ImageIOFactory that imports/exports data to a shared memory segment.";
+}
+
+} // end namespace itk
+
@@ -0,0 +1,72 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkMRMLSharedMemoryImageIOFactory.h,v $
+  Language:  C++
+  Date:      $Date: 2004/07/15 16:26:40 $
+  Version:   $Revision: 1.1 $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkMRMLSharedMemoryImageIOFactory_h
+#define __itkMRMLSharedMemoryImageIOFactory_h
+
+#include "itkObjectFactoryBase.h"
+#include "itkImageIOBase.h"
+
+#include "itkMRMLSharedMemoryImageIO.h"
+
+#include "itkMRMLIDIOWin32Header.h"
+
+namespace itk
+{
+/** \class MRMLSharedMemoryImageIOFactory
+ * \brief Create instances of MRMLSharedMemoryImageIO objects using an object factory.
+ */
+class MRMLSharedMemoryIO_EXPORT MRMLSharedMemoryImageIOFactory : public ObjectFactoryBase
+{
+public:
+  /** Standard class typedefs. */
+  typedef MRMLSharedMemoryImageIOFactory   Self;
+  typedef ObjectFactoryBase  Superclass;
+  typedef SmartPointer<Self>  Pointer;
+  typedef SmartPointer<const Self>  ConstPointer;
+
+  /** Class methods used to interface with the registered factories. */
+  virtual const char* GetITKSourceVersion(void) const ITK_OVERRIDE;
+  virtual const char* GetDescription(void) const ITK_OVERRIDE;
+
+  /** Method for class instantiation. */
+  itkFactorylessNewMacro(Self);
+  static MRMLSharedMemoryImageIOFactory* FactoryNew() { return new MRMLSharedMemoryImageIOFactory;}
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(MRMLSharedMemoryImageIOFactory, ObjectFactoryBase);
+
+  /** Register one factory of this type  */
+  static void RegisterOneFactory(void)
+  {
+    MRMLSharedMemoryImageIOFactory::Pointer sharedMemoryFactory = MRMLSharedMemoryImageIOFactory::New();
+    ObjectFactoryBase::RegisterFactory(sharedMemoryFactory);
+  }
+
+protected:
+  MRMLSharedMemoryImageIOFactory();
+  ~MRMLSharedMemoryImageIOFactory();
+
+private:
+  MRMLSharedMemoryImageIOFactory(const Self&); //purposely not implemented
+  void operator=(const Self&); //purposely not implemented
+
+};
+
+
+} /// end namespace itk
+
+#endif
@@ -0,0 +1,234 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRMLLogic includes
+#include "vtkImageLabelOutline.h"
+#include "vtkImageResliceLabelOutline.h"
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkImageMapToColors.h>
+#include <vtkImageReslice.h>
+#include <vtkLookupTable.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+#include <vtkTransform.h>
+
+// STD includes
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Boxes of labels 1 to 7, and a label outside of the lookup table range
+vtkSmartPointer<vtkImageData> CreateLabelmap(int size)
+{
+  vtkSmartPointer<vtkImageData> labelmap = vtkSmartPointer<vtkImageData>::New();
+  labelmap->SetDimensions(size, size, size / 4 + 1);
+  labelmap->SetSpacing(1.0, 1.0, 2.0);
+  labelmap->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
+  int* dims = labelmap->GetDimensions();
+  unsigned short* ptr = static_cast<unsigned short*>(labelmap->GetScalarPointer());
+  for (int k = 0; k < dims[2]; ++k)
+    {
+    for (int j = 0; j < dims[1]; ++j)
+      {
+      for (int i = 0; i < dims[0]; ++i)
+        {
+        int box = (i * 4 / size) + 4 * (j * 2 / size);
+        *ptr++ = static_cast<unsigned short>(
+          (i + j + k) % 11 < 2 ? 0 : (box == 7 ? 1000 : box));
+        }
+      }
+    }
+  return labelmap;
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkLookupTable> CreateLookupTable()
+{
+  vtkSmartPointer<vtkLookupTable> lut = vtkSmartPointer<vtkLookupTable>::New();
+  lut->SetNumberOfTableValues(256);
+  lut->SetTableRange(0, 255);
+  lut->SetTableValue(0, 0., 0., 0., 0.);
+  for (int i = 1; i < 256; ++i)
+    {
+    lut->SetTableValue(i, (i % 7) / 6., (i % 5) / 4., (i % 3) / 2., 1.);
+    }
+  return lut;
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkTransform> CreateResliceTransform()
+{
+  vtkSmartPointer<vtkTransform> transform = vtkSmartPointer<vtkTransform>::New();
+  transform->Translate(3.3, -5.1, 7.7);
+  transform->RotateZ(23.);
+  transform->RotateX(11.);
+  transform->Scale(0.73, 0.81, 1.);
+  return transform;
+}
+
+//----------------------------------------------------------------------------
+int CompareImages(vtkImageData* expected, vtkImageData* actual, int maximumNumberOfDifferences)
+{
+  int* expectedDims = expected->GetDimensions();
+  int* actualDims = actual->GetDimensions();
+  if (expectedDims[0] != actualDims[0] || expectedDims[1] != actualDims[1]
+    || expectedDims[2] != actualDims[2]
+    || expected->GetNumberOfScalarComponents() != 4
+    || actual->GetNumberOfScalarComponents() != 4)
+    {
+    std::cerr << "Images have different dimensions or number of components" << std::endl;
+    return EXIT_FAILURE;
+    }
+  const unsigned char* expectedPtr = static_cast<unsigned char*>(expected->GetScalarPointer());
+  const unsigned char* actualPtr = static_cast<unsigned char*>(actual->GetScalarPointer());
+  vtkIdType numberOfPixels = static_cast<vtkIdType>(expectedDims[0]) * expectedDims[1] * expectedDims[2];
+  int numberOfDifferences = 0;
+  int numberOfOutlinePixels = 0;
+  for (vtkIdType i = 0; i < numberOfPixels; ++i, expectedPtr += 4, actualPtr += 4)
+    {
+    numberOfOutlinePixels += (expectedPtr[3] != 0 ? 1 : 0);
+    numberOfDifferences += (memcmp(expectedPtr, actualPtr, 4) != 0 ? 1 : 0);
+    }
+  if (numberOfOutlinePixels == 0)
+    {
+    std::cerr << "No outline in the expected image" << std::endl;
+    return EXIT_FAILURE;
+    }
+  // Samples right at the middle of two voxels may be rounded differently
+  if (numberOfDifferences > maximumNumberOfDifferences)
+    {
+    std::cerr << numberOfDifferences << " pixels differ out of " << numberOfPixels << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkImageResliceLabelOutlineTest1(int argc, char * argv[])
+{
+  vtkNew<vtkImageResliceLabelOutline> resliceLabelOutline;
+  EXERCISE_BASIC_OBJECT_METHODS(resliceLabelOutline.GetPointer());
+
+  // The comparison of the update time with the reference pipeline is not
+  // run by default. Usage: vtkImageResliceLabelOutlineTest1 --benchmark [size]
+  bool benchmark = vtkAddonTestingUtilities::IsBenchmarkRequested(argc, argv);
+  int size = 128;
+  if (benchmark)
+    {
+    size = (argc > 2 ? atoi(argv[2]) : 512);
+    }
+  vtkSmartPointer<vtkImageData> labelmap = CreateLabelmap(size);
+  vtkSmartPointer<vtkLookupTable> lut = CreateLookupTable();
+  vtkSmartPointer<vtkTransform> transform = CreateResliceTransform();
+  const int outline = 2;
+  int outputExtent[6] = { 0, 2 * size - 1, 0, size + size / 2 - 1, 0, 0 };
+
+  // Reference pipeline
+  vtkNew<vtkImageReslice> reslice;
+  reslice->SetInputData(labelmap);
+  reslice->SetBackgroundColor(0, 0, 0, 0);
+  reslice->AutoCropOutputOff();
+  reslice->SetOptimization(1);
+  reslice->SetOutputOrigin(0, 0, 0);
+  reslice->SetOutputSpacing(1, 1, 1);
+  reslice->SetOutputDimensionality(3);
+  reslice->SetOutputExtent(outputExtent);
+  reslice->SetInterpolationModeToNearestNeighbor();
+  reslice->SetResliceTransform(transform);
+
+  vtkNew<vtkImageLabelOutline> labelOutline;
+  labelOutline->SetInputConnection(reslice->GetOutputPort());
+  labelOutline->SetOutline(outline);
+
+  vtkNew<vtkImageMapToColors> mapToColors;
+  mapToColors->SetOutputFormatToRGBA();
+  mapToColors->SetLookupTable(lut);
+  mapToColors->SetInputConnection(labelOutline->GetOutputPort());
+
+  // Fused filter
+  resliceLabelOutline->SetInputData(labelmap);
+  resliceLabelOutline->SetResliceMatrix(transform->GetMatrix());
+  resliceLabelOutline->SetOutputExtent(outputExtent);
+  resliceLabelOutline->SetOutline(outline);
+  resliceLabelOutline->SetLookupTable(lut);
+
+  if (benchmark)
+    {
+    const int numberOfRuns = 10;
+    vtkNew<vtkTimerLog> timer;
+
+    timer->StartTimer();
+    for (int i = 0; i < numberOfRuns; ++i)
+      {
+      reslice->Modified();
+      mapToColors->Update();
+      }
+    timer->StopTimer();
+    vtkAddonTestingUtilities::ReportMeasurement("vtkImageReslice-vtkImageLabelOutline-vtkImageMapToColors",
+      timer->GetElapsedTime() / numberOfRuns);
+
+    timer->StartTimer();
+    for (int i = 0; i < numberOfRuns; ++i)
+      {
+      resliceLabelOutline->Modified();
+      resliceLabelOutline->Update();
+      }
+    timer->StopTimer();
+    vtkAddonTestingUtilities::ReportMeasurement("vtkImageResliceLabelOutline",
+      timer->GetElapsedTime() / numberOfRuns);
+    }
+  else
+    {
+    mapToColors->Update();
+    resliceLabelOutline->Update();
+    }
+
+  int maximumNumberOfDifferences = (outputExtent[1] + 1) * (outputExtent[3] + 1) / 1000;
+  CHECK_EXIT_SUCCESS(CompareImages(mapToColors->GetOutput(),
+                                   resliceLabelOutline->GetOutput(),
+                                   maximumNumberOfDifferences));
+
+  // Modifying the lookup table updates the output
+  lut->SetTableValue(1, 1., 1., 1., 1.);
+  mapToColors->Update();
+  resliceLabelOutline->Update();
+  CHECK_EXIT_SUCCESS(CompareImages(mapToColors->GetOutput(),
+                                   resliceLabelOutline->GetOutput(),
+                                   maximumNumberOfDifferences));
+
+  // Thicker outline
+  labelOutline->SetOutline(outline + 3);
+  resliceLabelOutline->SetOutline(outline + 3);
+  mapToColors->Update();
+  resliceLabelOutline->Update();
+  CHECK_EXIT_SUCCESS(CompareImages(mapToColors->GetOutput(),
+                                   resliceLabelOutline->GetOutput(),
+                                   maximumNumberOfDifferences));
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,273 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRMLLogic includes
+#include "vtkImageSliceCompositor.h"
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+
+// VTK includes
+#include <vtkImageBlend.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cstdlib>
+#include <string>
+
+namespace
+{
+
+int testOperations();
+int testCompareWithImageBlend();
+int testPerformance(int width, int height);
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkImageData> CreateImage(int width, int height,
+                                          int numberOfComponents, int seed)
+{
+  vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+  image->SetDimensions(width, height, 1);
+  image->AllocateScalars(VTK_UNSIGNED_CHAR, numberOfComponents);
+  unsigned char* ptr = static_cast<unsigned char*>(image->GetScalarPointer());
+  vtkIdType size = static_cast<vtkIdType>(width) * height * numberOfComponents;
+  unsigned int value = static_cast<unsigned int>(seed);
+  for (vtkIdType i = 0; i < size; ++i)
+    {
+    // simple linear congruential generator, reproducible on all platforms
+    value = value * 1103515245u + 12345u;
+    ptr[i] = static_cast<unsigned char>(value >> 16);
+    }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkImageData> CreateUniformImage(int numberOfComponents,
+                                                 const unsigned char* pixel)
+{
+  vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+  image->SetDimensions(4, 3, 1);
+  image->AllocateScalars(VTK_UNSIGNED_CHAR, numberOfComponents);
+  unsigned char* ptr = static_cast<unsigned char*>(image->GetScalarPointer());
+  for (int i = 0; i < 4 * 3; ++i)
+    {
+    for (int c = 0; c < numberOfComponents; ++c)
+      {
+      *ptr++ = pixel[c];
+      }
+    }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+int CheckPixel(vtkImageData* image, int x, int y,
+               int r, int g, int b, int a, int tolerance, int line)
+{
+  if (image->GetNumberOfScalarComponents() != 4
+    || image->GetScalarType() != VTK_UNSIGNED_CHAR)
+    {
+    std::cerr << "Line " << line << " - output is not RGBA unsigned char" << std::endl;
+    return EXIT_FAILURE;
+    }
+  unsigned char* pixel = static_cast<unsigned char*>(image->GetScalarPointer(x, y, 0));
+  int expected[4] = { r, g, b, a };
+  for (int c = 0; c < 4; ++c)
+    {
+    if (abs(pixel[c] - expected[c]) > tolerance)
+      {
+      std::cerr << "Line " << line << " - unexpected pixel (" << x << ", " << y << "):"
+                << " got (" << int(pixel[0]) << ", " << int(pixel[1]) << ", "
+                << int(pixel[2]) << ", " << int(pixel[3]) << ")"
+                << " expected (" << r << ", " << g << ", " << b << ", " << a << ")"
+                << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkImageSliceCompositorTest1(int argc, char * argv[])
+{
+  vtkNew<vtkImageSliceCompositor> compositor;
+  EXERCISE_BASIC_OBJECT_METHODS(compositor.GetPointer());
+
+  CHECK_EXIT_SUCCESS(testOperations());
+  CHECK_EXIT_SUCCESS(testCompareWithImageBlend());
+
+  // The comparison of the compositing time with vtkImageBlend is not run by
+  // default. Usage: vtkImageSliceCompositorTest1 --benchmark [width height]
+  if (vtkAddonTestingUtilities::IsBenchmarkRequested(argc, argv))
+    {
+    int width = 3840;
+    int height = 2160;
+    if (argc > 3)
+      {
+      width = atoi(argv[2]);
+      height = atoi(argv[3]);
+      }
+    CHECK_EXIT_SUCCESS(testPerformance(width, height));
+    }
+
+  return EXIT_SUCCESS;
+}
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+int testOperations()
+{
+  const unsigned char gray[1] = { 100 };
+  const unsigned char red[4] = { 200, 0, 0, 255 };
+  const unsigned char transparent[4] = { 0, 250, 0, 0 };
+  const unsigned char rgb[3] = { 100, 200, 50 };
+
+  vtkSmartPointer<vtkImageData> grayImage = CreateUniformImage(1, gray);
+  vtkSmartPointer<vtkImageData> redImage = CreateUniformImage(4, red);
+  vtkSmartPointer<vtkImageData> transparentImage = CreateUniformImage(4, transparent);
+  vtkSmartPointer<vtkImageData> rgbImage = CreateUniformImage(3, rgb);
+
+  vtkNew<vtkImageSliceCompositor> compositor;
+  CHECK_DOUBLE(compositor->GetOpacity(3), 1.0);
+  CHECK_INT(compositor->GetOperation(3), vtkImageSliceCompositor::Over);
+
+  // Single input is converted to RGBA
+  compositor->AddInputData(grayImage);
+  compositor->Update();
+  CHECK_EXIT_SUCCESS(CheckPixel(compositor->GetOutput(), 1, 1, 100, 100, 100, 255, 0, __LINE__));
+
+  // Over: half opaque red over gray, alpha of the base is preserved
+  compositor->AddInputData(redImage);
+  compositor->SetOpacity(1, 0.5);
+  compositor->Update();
+  CHECK_EXIT_SUCCESS(CheckPixel(compositor->GetOutput(), 2, 0, 150, 50, 50, 255, 1, __LINE__));
+
+  // Over: transparent pixels do not contribute
+  compositor->SetInputData(1, transparentImage);
+  compositor->SetOpacity(1, 1.0);
+  compositor->Update();
+  CHECK_EXIT_SUCCESS(CheckPixel(compositor->GetOutput(), 2, 0, 100, 100, 100, 255, 0, __LINE__));
+
+  // Add saturates
+  compositor->SetInputData(1, rgbImage);
+  compositor->SetOperation(1, vtkImageSliceCompositor::Add);
+  CHECK_INT(compositor->GetOperation(1), vtkImageSliceCompositor::Add);
+  compositor->Update();
+  CHECK_EXIT_SUCCESS(CheckPixel(compositor->GetOutput(), 0, 2, 200, 255, 150, 255, 0, __LINE__));
+
+  // Subtract removes the previous result from the input and clamps at 0
+  compositor->SetOperation(1, vtkImageSliceCompositor::Subtract);
+  compositor->Update();
+  CHECK_EXIT_SUCCESS(CheckPixel(compositor->GetOutput(), 3, 1, 0, 100, 0, 255, 0, __LINE__));
+
+  // Inputs are removed
+  compositor->RemoveInputConnection(0, 1);
+  compositor->Update();
+  CHECK_EXIT_SUCCESS(CheckPixel(compositor->GetOutput(), 1, 1, 100, 100, 100, 255, 0, __LINE__));
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int testCompareWithImageBlend()
+{
+  const int width = 67;
+  const int height = 13;
+  vtkSmartPointer<vtkImageData> background = CreateImage(width, height, 4, 1);
+  vtkSmartPointer<vtkImageData> foreground = CreateImage(width, height, 4, 2);
+  vtkSmartPointer<vtkImageData> label = CreateImage(width, height, 4, 3);
+
+  vtkNew<vtkImageBlend> blend;
+  blend->AddInputData(background);
+  blend->AddInputData(foreground);
+  blend->AddInputData(label);
+  blend->SetOpacity(1, 0.3);
+  blend->SetOpacity(2, 0.7);
+  blend->Update();
+
+  vtkNew<vtkImageSliceCompositor> compositor;
+  compositor->AddInputData(background);
+  compositor->AddInputData(foreground);
+  compositor->AddInputData(label);
+  compositor->SetOpacity(1, 0.3);
+  compositor->SetOpacity(2, 0.7);
+  compositor->Update();
+
+  vtkImageData* expected = blend->GetOutput();
+  for (int y = 0; y < height; ++y)
+    {
+    for (int x = 0; x < width; ++x)
+      {
+      unsigned char* pixel = static_cast<unsigned char*>(expected->GetScalarPointer(x, y, 0));
+      // fixed point rounding differs from vtkImageBlend by at most 2
+      CHECK_EXIT_SUCCESS(CheckPixel(compositor->GetOutput(), x, y,
+        pixel[0], pixel[1], pixel[2], pixel[3], 2, __LINE__));
+      }
+    }
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int testPerformance(int width, int height)
+{
+  vtkSmartPointer<vtkImageData> background = CreateImage(width, height, 4, 1);
+  vtkSmartPointer<vtkImageData> foreground = CreateImage(width, height, 4, 2);
+  vtkSmartPointer<vtkImageData> label = CreateImage(width, height, 4, 3);
+
+  vtkNew<vtkImageBlend> blend;
+  blend->AddInputData(background);
+  blend->AddInputData(foreground);
+  blend->AddInputData(label);
+  blend->SetOpacity(1, 0.5);
+  blend->SetOpacity(2, 0.5);
+
+  vtkNew<vtkImageSliceCompositor> compositor;
+  compositor->AddInputData(background);
+  compositor->AddInputData(foreground);
+  compositor->AddInputData(label);
+  compositor->SetOpacity(1, 0.5);
+  compositor->SetOpacity(2, 0.5);
+
+  const int numberOfRuns = 10;
+  vtkNew<vtkTimerLog> timer;
+
+  timer->StartTimer();
+  for (int i = 0; i < numberOfRuns; ++i)
+    {
+    blend->Modified();
+    blend->Update();
+    }
+  timer->StopTimer();
+  REPORT_MEASUREMENT("vtkImageBlend-" << width << "x" << height, timer->GetElapsedTime() / numberOfRuns);
+
+  timer->StartTimer();
+  for (int i = 0; i < numberOfRuns; ++i)
+    {
+    compositor->Modified();
+    compositor->Update();
+    }
+  timer->StopTimer();
+  REPORT_MEASUREMENT("vtkImageSliceCompositor-" << width << "x" << height, timer->GetElapsedTime() / numberOfRuns);
+
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
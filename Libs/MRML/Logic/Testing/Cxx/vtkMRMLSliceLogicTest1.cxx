@@ -12,6 +12,7 @@
 
 // MRMLLogic includes
 #include "vtkMRMLSliceLogic.h"
+#include "vtkImageSliceCompositor.h"
 #include "vtkMRMLSliceLayerLogic.h"
 
 // MRML includes
@@ -22,7 +23,6 @@
 #include <vtkMRMLSliceCompositeNode.h>
 
 // VTK includes
-#include <vtkImageBlend.h>
 #include <vtkNew.h>
 
 #include "vtkMRMLCoreTestingMacros.h"
@@ -0,0 +1,396 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Program:   3D Slicer
+  Module:    $RCSfile: vtkImageResliceLabelOutline.cxx,v $
+  Date:      $Date$
+  Version:   $Revision$
+
+=========================================================================auto=*/
+#include "vtkImageResliceLabelOutline.h"
+
+// VTK includes
+#include <vtkDataObject.h>
+#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkScalarsToColors.h>
+#include <vtkStreamingDemandDrivenPipeline.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+//------------------------------------------------------------------------------
+vtkStandardNewMacro(vtkImageResliceLabelOutline);
+vtkCxxSetObjectMacro(vtkImageResliceLabelOutline, ResliceMatrix, vtkMatrix4x4);
+vtkCxxSetObjectMacro(vtkImageResliceLabelOutline, LookupTable, vtkScalarsToColors);
+
+namespace
+{
+
+const int MaximumNumberOfColors = 65536;
+const unsigned char TransparentColor[4] = { 0, 0, 0, 0 };
+
+//----------------------------------------------------------------------------
+// Matrix from the output indices to the continuous input indices
+void GetOutputToInputIndexMatrix(vtkMatrix4x4* resliceMatrix,
+                                 vtkInformation* inInfo, double matrix[4][4])
+{
+  double spacing[3] = { 1.0, 1.0, 1.0 };
+  double origin[3] = { 0.0, 0.0, 0.0 };
+  inInfo->Get(vtkDataObject::SPACING(), spacing);
+  inInfo->Get(vtkDataObject::ORIGIN(), origin);
+  for (int i = 0; i < 4; ++i)
+    {
+    for (int j = 0; j < 4; ++j)
+      {
+      matrix[i][j] = resliceMatrix ? resliceMatrix->GetElement(i, j) : (i == j ? 1.0 : 0.0);
+      }
+    }
+  for (int i = 0; i < 3; ++i)
+    {
+    for (int j = 0; j < 4; ++j)
+      {
+      matrix[i][j] = (matrix[i][j] - (j == 3 ? origin[i] : 0.0)) / spacing[i];
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+template <class T>
+void vtkImageResliceLabelOutlineExecute(vtkImageResliceLabelOutline* self,
+                                        vtkImageData* inData, T* inPtr,
+                                        vtkImageData* outData, int outExt[6],
+                                        double matrix[4][4])
+{
+  const int* wholeExt = self->GetOutputExtent();
+  const int outline = std::max(0, self->GetOutline());
+  const T backgroundLabelValue = static_cast<T>(self->GetBackground());
+  const unsigned char* backgroundColor = self->GetColor(self->GetBackground());
+
+  int inExt[6];
+  inData->GetExtent(inExt);
+  vtkIdType inInc[3];
+  inData->GetIncrements(inInc);
+
+  // Labels of the rows of the output piece and of the rows around it that
+  // are within the outline
+  const int bandMin0 = std::max(wholeExt[0], outExt[0] - outline);
+  const int bandMax0 = std::min(wholeExt[1], outExt[1] + outline);
+  const int bandMin1 = std::max(wholeExt[2], outExt[2] - outline);
+  const int bandMax1 = std::min(wholeExt[3], outExt[3] + outline);
+  const int bandWidth = bandMax0 - bandMin0 + 1;
+  if (bandWidth <= 0 || bandMax1 < bandMin1)
+    {
+    return;
+    }
+  std::vector<T> band(static_cast<size_t>(bandWidth) * (bandMax1 - bandMin1 + 1));
+
+  for (int outIdx2 = outExt[4]; outIdx2 <= outExt[5]; ++outIdx2)
+    {
+    // Reslice with nearest neighbor interpolation
+    T* bandPtr = &band[0];
+    for (int outIdx1 = bandMin1; outIdx1 <= bandMax1; ++outIdx1)
+      {
+      double point[3];
+      for (int i = 0; i < 3; ++i)
+        {
+        point[i] = matrix[i][0] * bandMin0 + matrix[i][1] * outIdx1
+          + matrix[i][2] * outIdx2 + matrix[i][3];
+        }
+      for (int outIdx0 = bandMin0; outIdx0 <= bandMax0; ++outIdx0)
+        {
+        int idx0 = vtkMath::Floor(point[0] + 0.5);
+        int idx1 = vtkMath::Floor(point[1] + 0.5);
+        int idx2 = vtkMath::Floor(point[2] + 0.5);
+        if (inPtr &&
+            idx0 >= inExt[0] && idx0 <= inExt[1] &&
+            idx1 >= inExt[2] && idx1 <= inExt[3] &&
+            idx2 >= inExt[4] && idx2 <= inExt[5])
+          {
+          *bandPtr = inPtr[(idx0 - inExt[0]) * inInc[0]
+                           + (idx1 - inExt[2]) * inInc[1]
+                           + (idx2 - inExt[4]) * inInc[2]];
+          }
+        else
+          {
+          *bandPtr = backgroundLabelValue;
+          }
+        ++bandPtr;
+        point[0] += matrix[0][0];
+        point[1] += matrix[1][0];
+        point[2] += matrix[2][0];
+        }
+      }
+
+    // Outline and map to colors
+    for (int outIdx1 = outExt[2]; outIdx1 <= outExt[3]; ++outIdx1)
+      {
+      unsigned char* outPtr =
+        static_cast<unsigned char*>(outData->GetScalarPointer(outExt[0], outIdx1, outIdx2));
+      const T* rowPtr = &band[static_cast<size_t>(outIdx1 - bandMin1) * bandWidth];
+      for (int outIdx0 = outExt[0]; outIdx0 <= outExt[1]; ++outIdx0, outPtr += 4)
+        {
+        T inLabelValue = rowPtr[outIdx0 - bandMin0];
+        const unsigned char* color = backgroundColor;
+        // look at neighborhood around non-background pixels to see if there
+        // is a transition. If there is, then this is an outline pixel.
+        if (inLabelValue != backgroundLabelValue)
+          {
+          bool isOutline = false;
+          for (int hoodIdx1 = -outline; hoodIdx1 <= outline && !isOutline; ++hoodIdx1)
+            {
+            int idx1 = outIdx1 + hoodIdx1;
+            int idx0Min = outIdx0 - outline;
+            int idx0Max = outIdx0 + outline;
+            if (idx1 < wholeExt[2] || idx1 > wholeExt[3] ||
+                idx0Min < wholeExt[0] || idx0Max > wholeExt[1])
+              {
+              // neighborhood reaches outside of the slice
+              isOutline = true;
+              break;
+              }
+            const T* hoodPtr = &band[static_cast<size_t>(idx1 - bandMin1) * bandWidth
+                                     + (idx0Min - bandMin0)];
+            for (int idx0 = idx0Min; idx0 <= idx0Max; ++idx0, ++hoodPtr)
+              {
+              if (*hoodPtr != inLabelValue)
+                {
+                isOutline = true;
+                break;
+                }
+              }
+            }
+          if (isOutline)
+            {
+            color = self->GetColor(static_cast<double>(inLabelValue));
+            }
+          }
+        memcpy(outPtr, color, 4);
+        }
+      }
+    }
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+vtkImageResliceLabelOutline::vtkImageResliceLabelOutline()
+{
+  this->ResliceMatrix = NULL;
+  this->LookupTable = NULL;
+  this->OutputExtent[0] = this->OutputExtent[2] = this->OutputExtent[4] = 0;
+  this->OutputExtent[1] = this->OutputExtent[3] = this->OutputExtent[5] = 0;
+  this->Outline = 1;
+  this->Background = 0.;
+  this->ColorsMinimum = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkImageResliceLabelOutline::~vtkImageResliceLabelOutline()
+{
+  this->SetResliceMatrix(NULL);
+  this->SetLookupTable(NULL);
+}
+
+//----------------------------------------------------------------------------
+vtkMTimeType vtkImageResliceLabelOutline::GetMTime()
+{
+  vtkMTimeType mTime = this->Superclass::GetMTime();
+  if (this->ResliceMatrix)
+    {
+    mTime = std::max(mTime, this->ResliceMatrix->GetMTime());
+    }
+  if (this->LookupTable)
+    {
+    mTime = std::max(mTime, this->LookupTable->GetMTime());
+    }
+  return mTime;
+}
+
+//----------------------------------------------------------------------------
+const unsigned char* vtkImageResliceLabelOutline::GetColor(double label) const
+{
+  if (this->Colors.empty())
+    {
+    return TransparentColor;
+    }
+  double maximum = this->ColorsMinimum + static_cast<double>(this->Colors.size() / 4) - 1;
+  label = std::max(static_cast<double>(this->ColorsMinimum), std::min(maximum, label));
+  return &this->Colors[4 * (vtkMath::Floor(label) - this->ColorsMinimum)];
+}
+
+//----------------------------------------------------------------------------
+int vtkImageResliceLabelOutline::RequestInformation(
+  vtkInformation* vtkNotUsed(request),
+  vtkInformationVector** vtkNotUsed(inputVector),
+  vtkInformationVector* outputVector)
+{
+  vtkInformation* outInfo = outputVector->GetInformationObject(0);
+  double spacing[3] = { 1.0, 1.0, 1.0 };
+  double origin[3] = { 0.0, 0.0, 0.0 };
+  outInfo->Set(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), this->OutputExtent, 6);
+  outInfo->Set(vtkDataObject::SPACING(), spacing, 3);
+  outInfo->Set(vtkDataObject::ORIGIN(), origin, 3);
+  vtkDataObject::SetPointDataActiveScalarInfo(outInfo, VTK_UNSIGNED_CHAR, 4);
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkImageResliceLabelOutline::RequestUpdateExtent(
+  vtkInformation* vtkNotUsed(request),
+  vtkInformationVector** inputVector,
+  vtkInformationVector* outputVector)
+{
+  vtkInformation* inInfo = inputVector[0]->GetInformationObject(0);
+  vtkInformation* outInfo = outputVector->GetInformationObject(0);
+
+  int outExt[6];
+  outInfo->Get(vtkStreamingDemandDrivenPipeline::UPDATE_EXTENT(), outExt);
+  // The outline of a pixel depends on its neighbors within the slice
+  int outline = std::max(0, this->Outline);
+  outExt[0] = std::max(this->OutputExtent[0], outExt[0] - outline);
+  outExt[1] = std::min(this->OutputExtent[1], outExt[1] + outline);
+  outExt[2] = std::max(this->OutputExtent[2], outExt[2] - outline);
+  outExt[3] = std::min(this->OutputExtent[3], outExt[3] + outline);
+
+  int inWholeExt[6];
+  inInfo->Get(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), inWholeExt);
+
+  // Bounding box of the corners of the output extent in the input
+  double matrix[4][4];
+  GetOutputToInputIndexMatrix(this->ResliceMatrix, inInfo, matrix);
+  double bounds[6] = { VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX,
+                       VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX,
+                       VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX };
+  for (int corner = 0; corner < 8; ++corner)
+    {
+    double point[3] = { static_cast<double>(outExt[corner & 1 ? 1 : 0]),
+                        static_cast<double>(outExt[corner & 2 ? 3 : 2]),
+                        static_cast<double>(outExt[corner & 4 ? 5 : 4]) };
+    for (int i = 0; i < 3; ++i)
+      {
+      double value = matrix[i][0] * point[0] + matrix[i][1] * point[1]
+        + matrix[i][2] * point[2] + matrix[i][3];
+      bounds[2*i] = std::min(bounds[2*i], value);
+      bounds[2*i+1] = std::max(bounds[2*i+1], value);
+      }
+    }
+
+  int inExt[6];
+  bool empty = false;
+  for (int i = 0; i < 3; ++i)
+    {
+    // clamp before converting so that huge values don't overflow
+    double minimum = std::max(bounds[2*i], inWholeExt[2*i] - 1.0);
+    double maximum = std::min(bounds[2*i+1], inWholeExt[2*i+1] + 1.0);
+    inExt[2*i] = std::max(inWholeExt[2*i], vtkMath::Floor(minimum));
+    inExt[2*i+1] = std::min(inWholeExt[2*i+1], vtkMath::Ceil(maximum));
+    empty = empty || (inExt[2*i] > inExt[2*i+1]);
+    }
+  if (empty)
+    {
+    // the slice does not intersect the input: request an empty extent
+    for (int i = 0; i < 3; ++i)
+      {
+      inExt[2*i] = inWholeExt[2*i];
+      inExt[2*i+1] = inWholeExt[2*i] - 1;
+      }
+    }
+  inInfo->Set(vtkStreamingDemandDrivenPipeline::UPDATE_EXTENT(), inExt, 6);
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkImageResliceLabelOutline::RequestData(
+  vtkInformation* request,
+  vtkInformationVector** inputVector,
+  vtkInformationVector* outputVector)
+{
+  // Look up the colors before execution: lookup tables are not thread safe
+  this->Colors.clear();
+  this->ColorsMinimum = 0;
+  if (this->LookupTable)
+    {
+    this->LookupTable->Build();
+    double* range = this->LookupTable->GetRange();
+    double minimum = std::max(static_cast<double>(VTK_INT_MIN), floor(range[0]));
+    double maximum = std::min(minimum + MaximumNumberOfColors - 1, ceil(range[1]));
+    this->ColorsMinimum = static_cast<int>(minimum);
+    int numberOfColors = static_cast<int>(maximum - minimum) + 1;
+    this->Colors.resize(4 * std::max(numberOfColors, 1));
+    for (int i = 0; i < numberOfColors; ++i)
+      {
+      memcpy(&this->Colors[4 * i], this->LookupTable->MapValue(this->ColorsMinimum + i), 4);
+      }
+    }
+  else
+    {
+    vtkErrorMacro("RequestData: no lookup table is set");
+    }
+  return this->Superclass::RequestData(request, inputVector, outputVector);
+}
+
+//----------------------------------------------------------------------------
+void vtkImageResliceLabelOutline::ThreadedRequestData(
+  vtkInformation* vtkNotUsed(request),
+  vtkInformationVector** inputVector,
+  vtkInformationVector* vtkNotUsed(outputVector),
+  vtkImageData*** inData,
+  vtkImageData** outData,
+  int outExt[6], int vtkNotUsed(threadId))
+{
+  vtkImageData* input = inData[0][0];
+  vtkImageData* output = outData[0];
+  if (input->GetNumberOfScalarComponents() != 1)
+    {
+    vtkErrorMacro(<< "Input has " << input->GetNumberOfScalarComponents()
+                  << " instead of 1 scalar component.");
+    return;
+    }
+
+  double matrix[4][4];
+  GetOutputToInputIndexMatrix(this->ResliceMatrix,
+                              inputVector[0]->GetInformationObject(0), matrix);
+
+  void* inPtr = input->GetPointData()->GetScalars() ? input->GetScalarPointer() : 0;
+  switch (input->GetScalarType())
+    {
+    vtkTemplateMacro(vtkImageResliceLabelOutlineExecute(
+      this, input, static_cast<VTK_TT*>(inPtr), output, outExt, matrix));
+    default:
+      vtkErrorMacro(<< "Execute: Unknown input ScalarType");
+      return;
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkImageResliceLabelOutline::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "OutputExtent: " << this->OutputExtent[0];
+  for (int i = 1; i < 6; ++i)
+    {
+    os << ", " << this->OutputExtent[i];
+    }
+  os << "\n";
+  os << indent << "Outline: " << this->Outline << "\n";
+  os << indent << "Background: " << this->Background << "\n";
+  os << indent << "ResliceMatrix: " << this->ResliceMatrix << "\n";
+  if (this->ResliceMatrix)
+    {
+    this->ResliceMatrix->PrintSelf(os, indent.GetNextIndent());
+    }
+  os << indent << "LookupTable: " << this->LookupTable << "\n";
+}
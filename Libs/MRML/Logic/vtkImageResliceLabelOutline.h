@@ -0,0 +1,125 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Program:   3D Slicer
+  Module:    $RCSfile: vtkImageResliceLabelOutline.h,v $
+  Date:      $Date$
+  Version:   $Revision$
+
+=========================================================================auto=*/
+
+#ifndef __vtkImageResliceLabelOutline_h
+#define __vtkImageResliceLabelOutline_h
+
+#include <vtkThreadedImageAlgorithm.h>
+
+#include "vtkMRMLLogicWin32Header.h"
+
+// STD includes
+#include <vector>
+
+class vtkMatrix4x4;
+class vtkScalarsToColors;
+
+/// \brief Reslice a labelmap and display the outline of its labels.
+///
+/// vtkImageResliceLabelOutline produces in a single pass the same image as
+/// the vtkImageReslice (nearest neighbor), vtkImageLabelOutline and
+/// vtkImageMapToColors (RGBA) pipeline used to display label layers with
+/// outlines: there is no intermediate image between the stages.
+///
+/// The reslice matrix maps output coordinates into input coordinates, as the
+/// matrix of a linear reslice transform of vtkImageReslice. The output has
+/// an origin of 0 and a spacing of 1, and its extent is OutputExtent.
+/// Output pixels that sample outside of the input are set to Background.
+///
+/// A pixel is an outline pixel if it is not Background and if a pixel of a
+/// different label, or the border of the output, is in the square of
+/// half-size Outline around it. Outline pixels are mapped through the lookup
+/// table, all the others have the color of Background.
+class VTK_MRML_LOGIC_EXPORT vtkImageResliceLabelOutline : public vtkThreadedImageAlgorithm
+{
+public:
+  static vtkImageResliceLabelOutline *New();
+  vtkTypeMacro(vtkImageResliceLabelOutline, vtkThreadedImageAlgorithm);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  ///
+  /// Matrix from the output coordinates to the input coordinates.
+  /// Identity if NULL.
+  virtual void SetResliceMatrix(vtkMatrix4x4*);
+  vtkGetObjectMacro(ResliceMatrix, vtkMatrix4x4);
+
+  ///
+  /// Extent of the output image
+  vtkSetVector6Macro(OutputExtent, int);
+  vtkGetVector6Macro(OutputExtent, int);
+
+  ///
+  /// Thickness of the outline. Default is 1.
+  vtkSetMacro(Outline, int);
+  vtkGetMacro(Outline, int);
+
+  ///
+  /// Background pixel value in the image (usually 0)
+  vtkSetMacro(Background, double);
+  vtkGetMacro(Background, double);
+
+  ///
+  /// Lookup table that maps label values to colors. The colors of the
+  /// (at most 65536) integer values of its range are looked up before
+  /// execution; labels outside of the range are clamped.
+  virtual void SetLookupTable(vtkScalarsToColors*);
+  vtkGetObjectMacro(LookupTable, vtkScalarsToColors);
+
+  ///
+  /// Take the reslice matrix and the lookup table into account
+  vtkMTimeType GetMTime();
+
+  /// Internal method to look up the color of a label value.
+  const unsigned char* GetColor(double label) const;
+
+protected:
+  vtkImageResliceLabelOutline();
+  ~vtkImageResliceLabelOutline();
+
+  virtual int RequestInformation(vtkInformation *,
+                                 vtkInformationVector **,
+                                 vtkInformationVector *);
+
+  virtual int RequestUpdateExtent(vtkInformation *,
+                                  vtkInformationVector **,
+                                  vtkInformationVector *);
+
+  virtual int RequestData(vtkInformation *,
+                          vtkInformationVector **,
+                          vtkInformationVector *);
+
+  virtual void ThreadedRequestData(vtkInformation *request,
+                                   vtkInformationVector **inputVector,
+                                   vtkInformationVector *outputVector,
+                                   vtkImageData ***inData,
+                                   vtkImageData **outData,
+                                   int outExt[6], int threadId);
+
+  vtkMatrix4x4* ResliceMatrix;
+  vtkScalarsToColors* LookupTable;
+  int OutputExtent[6];
+  int Outline;
+  double Background;
+
+  /// RGBA colors of the labels between ColorsMinimum and
+  /// ColorsMinimum + Colors.size() / 4 - 1, filled before execution.
+  std::vector<unsigned char> Colors;
+  int ColorsMinimum;
+
+private:
+  vtkImageResliceLabelOutline(const vtkImageResliceLabelOutline&);  // Not implemented.
+  void operator=(const vtkImageResliceLabelOutline&);  // Not implemented.
+};
+
+#endif
@@ -0,0 +1,473 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Program:   3D Slicer
+  Module:    $RCSfile: vtkImageSliceCompositor.cxx,v $
+  Date:      $Date$
+  Version:   $Revision$
+
+=========================================================================auto=*/
+#include "vtkImageSliceCompositor.h"
+
+// VTK includes
+#include <vtkAlgorithm.h>
+#include <vtkDataObject.h>
+#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkStreamingDemandDrivenPipeline.h>
+
+// STD includes
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VTK_IMAGE_SLICE_COMPOSITOR_USE_SSE2
+#endif
+
+//------------------------------------------------------------------------------
+vtkStandardNewMacro(vtkImageSliceCompositor);
+
+namespace
+{
+
+// Weights are fixed point numbers between 0 and 256 (256 meaning 1.0): the
+// products of 8 bit values with weights fit in 16 bits.
+const int FullWeight = 256;
+
+//----------------------------------------------------------------------------
+inline int OpacityToWeight(double opacity)
+{
+  opacity = std::max(0.0, std::min(1.0, opacity));
+  return static_cast<int>(opacity * FullWeight + 0.5);
+}
+
+//----------------------------------------------------------------------------
+/// Convert a row of 1 to 4 components into RGBA
+void ConvertRowToRGBA(const unsigned char* in, int inC,
+                      unsigned char* out, int numberOfPixels)
+{
+  switch (inC)
+    {
+    case 1:
+      for (int i = 0; i < numberOfPixels; ++i, in += 1, out += 4)
+        {
+        out[0] = out[1] = out[2] = in[0];
+        out[3] = 255;
+        }
+      break;
+    case 2:
+      for (int i = 0; i < numberOfPixels; ++i, in += 2, out += 4)
+        {
+        out[0] = out[1] = out[2] = in[0];
+        out[3] = in[1];
+        }
+      break;
+    case 3:
+      for (int i = 0; i < numberOfPixels; ++i, in += 3, out += 4)
+        {
+        out[0] = in[0];
+        out[1] = in[1];
+        out[2] = in[2];
+        out[3] = 255;
+        }
+      break;
+    default:
+      memcpy(out, in, 4 * numberOfPixels);
+      break;
+    }
+}
+
+//----------------------------------------------------------------------------
+inline unsigned char Lerp(int out, int in, int weight)
+{
+  return static_cast<unsigned char>((out * (FullWeight - weight) + in * weight) >> 8);
+}
+
+//----------------------------------------------------------------------------
+inline int AlphaToWeight(int alpha, int opacityWeight)
+{
+  // map [0, 255] to [0, 256] so that an opaque pixel replaces the output
+  int weight = alpha + (alpha >> 7);
+  if (opacityWeight < FullWeight)
+    {
+    weight = (weight * opacityWeight) >> 8;
+    }
+  return weight;
+}
+
+#ifdef VTK_IMAGE_SLICE_COMPOSITOR_USE_SSE2
+//----------------------------------------------------------------------------
+// Lerp of 2 RGBA pixels stored as 16 bit values
+inline __m128i Lerp16(__m128i out, __m128i in, __m128i weight)
+{
+  const __m128i fullWeight = _mm_set1_epi16(FullWeight);
+  __m128i sum = _mm_add_epi16(
+    _mm_mullo_epi16(out, _mm_sub_epi16(fullWeight, weight)),
+    _mm_mullo_epi16(in, weight));
+  return _mm_srli_epi16(sum, 8);
+}
+
+//----------------------------------------------------------------------------
+// Broadcast the alpha of 2 RGBA pixels stored as 16 bit values and convert
+// them into weights
+inline __m128i AlphaToWeight16(__m128i pixels, int opacityWeight)
+{
+  __m128i alpha = _mm_shufflehi_epi16(
+    _mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+  __m128i weight = _mm_add_epi16(alpha, _mm_srli_epi16(alpha, 7));
+  if (opacityWeight < FullWeight)
+    {
+    weight = _mm_srli_epi16(
+      _mm_mullo_epi16(weight, _mm_set1_epi16(static_cast<short>(opacityWeight))), 8);
+    }
+  return weight;
+}
+
+//----------------------------------------------------------------------------
+// Keep the RGB of rgb and the alpha of alpha
+inline __m128i MergeAlpha(__m128i rgb, __m128i alpha)
+{
+  const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+  return _mm_or_si128(_mm_and_si128(rgbMask, rgb), _mm_andnot_si128(rgbMask, alpha));
+}
+#endif
+
+//----------------------------------------------------------------------------
+void CompositeRowOver(const unsigned char* in, unsigned char* out,
+                      int numberOfPixels, int opacityWeight)
+{
+  int i = 0;
+#ifdef VTK_IMAGE_SLICE_COMPOSITOR_USE_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 4 <= numberOfPixels; i += 4, in += 16, out += 16)
+    {
+    __m128i inPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    __m128i outPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out));
+    __m128i inLo = _mm_unpacklo_epi8(inPixels, zero);
+    __m128i inHi = _mm_unpackhi_epi8(inPixels, zero);
+    __m128i resultLo = Lerp16(_mm_unpacklo_epi8(outPixels, zero), inLo,
+                              AlphaToWeight16(inLo, opacityWeight));
+    __m128i resultHi = Lerp16(_mm_unpackhi_epi8(outPixels, zero), inHi,
+                              AlphaToWeight16(inHi, opacityWeight));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                     MergeAlpha(_mm_packus_epi16(resultLo, resultHi), outPixels));
+    }
+#endif
+  for (; i < numberOfPixels; ++i, in += 4, out += 4)
+    {
+    int weight = AlphaToWeight(in[3], opacityWeight);
+    out[0] = Lerp(out[0], in[0], weight);
+    out[1] = Lerp(out[1], in[1], weight);
+    out[2] = Lerp(out[2], in[2], weight);
+    }
+}
+
+//----------------------------------------------------------------------------
+template <bool Subtract>
+void CompositeRowArithmetic(const unsigned char* in, unsigned char* out,
+                            int numberOfPixels, int opacityWeight)
+{
+  int i = 0;
+#ifdef VTK_IMAGE_SLICE_COMPOSITOR_USE_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i weight = _mm_set1_epi16(static_cast<short>(opacityWeight));
+  for (; i + 4 <= numberOfPixels; i += 4, in += 16, out += 16)
+    {
+    __m128i inPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    __m128i outPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out));
+    __m128i result = Subtract ?
+      _mm_subs_epu8(inPixels, outPixels) : _mm_adds_epu8(outPixels, inPixels);
+    if (opacityWeight < FullWeight)
+      {
+      result = _mm_packus_epi16(
+        Lerp16(_mm_unpacklo_epi8(outPixels, zero), _mm_unpacklo_epi8(result, zero), weight),
+        Lerp16(_mm_unpackhi_epi8(outPixels, zero), _mm_unpackhi_epi8(result, zero), weight));
+      }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                     MergeAlpha(result, _mm_max_epu8(inPixels, outPixels)));
+    }
+#endif
+  for (; i < numberOfPixels; ++i, in += 4, out += 4)
+    {
+    for (int c = 0; c < 3; ++c)
+      {
+      int result = Subtract ?
+        std::max(0, in[c] - out[c]) : std::min(255, out[c] + in[c]);
+      out[c] = Lerp(out[c], result, opacityWeight);
+      }
+    out[3] = std::max(out[3], in[3]);
+    }
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+vtkImageSliceCompositor::vtkImageSliceCompositor()
+{
+}
+
+//----------------------------------------------------------------------------
+vtkImageSliceCompositor::~vtkImageSliceCompositor()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkImageSliceCompositor::SetOpacity(int idx, double opacity)
+{
+  if (idx < 0)
+    {
+    vtkErrorMacro("SetOpacity: invalid input index " << idx);
+    return;
+    }
+  opacity = std::max(0.0, std::min(1.0, opacity));
+  if (idx >= static_cast<int>(this->Opacities.size()))
+    {
+    this->Opacities.resize(idx + 1, 1.0);
+    }
+  if (this->Opacities[idx] != opacity)
+    {
+    this->Opacities[idx] = opacity;
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+double vtkImageSliceCompositor::GetOpacity(int idx)
+{
+  if (idx < 0 || idx >= static_cast<int>(this->Opacities.size()))
+    {
+    return 1.0;
+    }
+  return this->Opacities[idx];
+}
+
+//----------------------------------------------------------------------------
+void vtkImageSliceCompositor::SetOperation(int idx, int operation)
+{
+  if (idx < 0 || operation < Over || operation > Subtract)
+    {
+    vtkErrorMacro("SetOperation: invalid operation " << operation
+                  << " for input " << idx);
+    return;
+    }
+  if (idx >= static_cast<int>(this->Operations.size()))
+    {
+    this->Operations.resize(idx + 1, Over);
+    }
+  if (this->Operations[idx] != operation)
+    {
+    this->Operations[idx] = operation;
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+int vtkImageSliceCompositor::GetOperation(int idx)
+{
+  if (idx < 0 || idx >= static_cast<int>(this->Operations.size()))
+    {
+    return Over;
+    }
+  return this->Operations[idx];
+}
+
+//----------------------------------------------------------------------------
+int vtkImageSliceCompositor::FillInputPortInformation(int port, vtkInformation* info)
+{
+  if (!this->Superclass::FillInputPortInformation(port, info))
+    {
+    return 0;
+    }
+  info->Set(vtkAlgorithm::INPUT_IS_REPEATABLE(), 1);
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkImageSliceCompositor::RequestInformation(
+  vtkInformation* vtkNotUsed(request),
+  vtkInformationVector** vtkNotUsed(inputVector),
+  vtkInformationVector* outputVector)
+{
+  // The whole extent, spacing and origin are the ones of the first input
+  vtkInformation* outInfo = outputVector->GetInformationObject(0);
+  vtkDataObject::SetPointDataActiveScalarInfo(outInfo, VTK_UNSIGNED_CHAR, 4);
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkImageSliceCompositor::RequestUpdateExtent(
+  vtkInformation* vtkNotUsed(request),
+  vtkInformationVector** inputVector,
+  vtkInformationVector* outputVector)
+{
+  int outExt[6];
+  outputVector->GetInformationObject(0)->Get(
+    vtkStreamingDemandDrivenPipeline::UPDATE_EXTENT(), outExt);
+
+  // Request the part of each input that overlaps the output
+  int numberOfInputs = this->GetNumberOfInputConnections(0);
+  for (int idx = 0; idx < numberOfInputs; ++idx)
+    {
+    vtkInformation* inInfo = inputVector[0]->GetInformationObject(idx);
+    int inWholeExt[6];
+    inInfo->Get(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), inWholeExt);
+    int inExt[6];
+    for (int i = 0; i < 3; ++i)
+      {
+      inExt[2*i] = std::max(outExt[2*i], inWholeExt[2*i]);
+      inExt[2*i+1] = std::min(outExt[2*i+1], inWholeExt[2*i+1]);
+      if (inExt[2*i] > inExt[2*i+1])
+        {
+        // no overlap: request an empty extent
+        inExt[2*i] = inWholeExt[2*i];
+        inExt[2*i+1] = inWholeExt[2*i] - 1;
+        }
+      }
+    inInfo->Set(vtkStreamingDemandDrivenPipeline::UPDATE_EXTENT(), inExt, 6);
+    }
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkImageSliceCompositor::ThreadedRequestData(
+  vtkInformation* vtkNotUsed(request),
+  vtkInformationVector** vtkNotUsed(inputVector),
+  vtkInformationVector* vtkNotUsed(outputVector),
+  vtkImageData*** inData,
+  vtkImageData** outData,
+  int outExt[6], int threadId)
+{
+  vtkImageData* output = outData[0];
+  if (output->GetScalarType() != VTK_UNSIGNED_CHAR
+      || output->GetNumberOfScalarComponents() != 4)
+    {
+    vtkErrorMacro("ThreadedRequestData: output must be RGBA unsigned char");
+    return;
+    }
+
+  int rowLength = outExt[1] - outExt[0] + 1;
+  if (rowLength <= 0)
+    {
+    return;
+    }
+  // Buffer for the inputs that are not RGBA
+  std::vector<unsigned char> rgbaRow(4 * rowLength);
+
+  // Start from a transparent black output in case the first input does not
+  // cover it entirely
+  vtkImageData* firstInput = this->GetNumberOfInputConnections(0) > 0 ? inData[0][0] : 0;
+  int* firstInputExt = firstInput ? firstInput->GetExtent() : 0;
+  if (!firstInput || !firstInput->GetPointData()->GetScalars()
+      || firstInputExt[0] > outExt[0] || firstInputExt[1] < outExt[1]
+      || firstInputExt[2] > outExt[2] || firstInputExt[3] < outExt[3]
+      || firstInputExt[4] > outExt[4] || firstInputExt[5] < outExt[5])
+    {
+    for (int z = outExt[4]; z <= outExt[5]; ++z)
+      {
+      for (int y = outExt[2]; y <= outExt[3]; ++y)
+        {
+        memset(output->GetScalarPointer(outExt[0], y, z), 0, 4 * rowLength);
+        }
+      }
+    }
+
+  int numberOfInputs = this->GetNumberOfInputConnections(0);
+  for (int idx = 0; idx < numberOfInputs; ++idx)
+    {
+    vtkImageData* input = inData[0][idx];
+    if (!input || !input->GetPointData()->GetScalars())
+      {
+      continue;
+      }
+    if (input->GetScalarType() != VTK_UNSIGNED_CHAR)
+      {
+      if (threadId == 0)
+        {
+        vtkErrorMacro("ThreadedRequestData: input " << idx << " is of type "
+                      << input->GetScalarTypeAsString() << ", unsigned char is expected");
+        }
+      continue;
+      }
+    int inC = input->GetNumberOfScalarComponents();
+    if (inC < 1 || inC > 4)
+      {
+      if (threadId == 0)
+        {
+        vtkErrorMacro("ThreadedRequestData: input " << idx << " has "
+                      << inC << " components, 1 to 4 are expected");
+        }
+      continue;
+      }
+
+    // Composite only where the input overlaps the piece of output
+    int ext[6];
+    int* inExt = input->GetExtent();
+    bool empty = false;
+    for (int i = 0; i < 3; ++i)
+      {
+      ext[2*i] = std::max(outExt[2*i], inExt[2*i]);
+      ext[2*i+1] = std::min(outExt[2*i+1], inExt[2*i+1]);
+      empty = empty || (ext[2*i] > ext[2*i+1]);
+      }
+    if (empty)
+      {
+      continue;
+      }
+    int numberOfPixels = ext[1] - ext[0] + 1;
+
+    int operation = this->GetOperation(idx);
+    int opacityWeight = OpacityToWeight(this->GetOpacity(idx));
+    for (int z = ext[4]; z <= ext[5]; ++z)
+      {
+      for (int y = ext[2]; y <= ext[3]; ++y)
+        {
+        const unsigned char* inRow =
+          static_cast<unsigned char*>(input->GetScalarPointer(ext[0], y, z));
+        unsigned char* outRow =
+          static_cast<unsigned char*>(output->GetScalarPointer(ext[0], y, z));
+        if (idx == 0)
+          {
+          // the first input initializes the output
+          ConvertRowToRGBA(inRow, inC, outRow, numberOfPixels);
+          continue;
+          }
+        if (inC != 4)
+          {
+          ConvertRowToRGBA(inRow, inC, &rgbaRow[0], numberOfPixels);
+          inRow = &rgbaRow[0];
+          }
+        switch (operation)
+          {
+          case Add:
+            CompositeRowArithmetic<false>(inRow, outRow, numberOfPixels, opacityWeight);
+            break;
+          case Subtract:
+            CompositeRowArithmetic<true>(inRow, outRow, numberOfPixels, opacityWeight);
+            break;
+          default:
+            CompositeRowOver(inRow, outRow, numberOfPixels, opacityWeight);
+            break;
+          }
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkImageSliceCompositor::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  for (int idx = 0; idx < this->GetNumberOfInputConnections(0); ++idx)
+    {
+    os << indent << "Input " << idx << ": Opacity: " << this->GetOpacity(idx)
+       << ", Operation: " << this->GetOperation(idx) << "\n";
+    }
+}
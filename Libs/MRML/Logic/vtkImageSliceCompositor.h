@@ -0,0 +1,96 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Program:   3D Slicer
+  Module:    $RCSfile: vtkImageSliceCompositor.h,v $
+  Date:      $Date$
+  Version:   $Revision$
+
+=========================================================================auto=*/
+
+#ifndef __vtkImageSliceCompositor_h
+#define __vtkImageSliceCompositor_h
+
+#include <vtkThreadedImageAlgorithm.h>
+
+#include "vtkMRMLLogicWin32Header.h"
+
+// STD includes
+#include <vector>
+
+/// \brief Composite the RGBA layers of a slice view.
+///
+/// vtkImageSliceCompositor is a replacement of vtkImageBlend dedicated to the
+/// layers displayed in slice views (background, foreground and label).
+/// Inputs must be unsigned char images with 1 (luminance), 2 (luminance and
+/// alpha), 3 (RGB) or 4 (RGBA) components; the output is always RGBA.
+///
+/// The first input is copied into the output, then each following input is
+/// composited over the result with its own operation and opacity:
+/// - Over: the input is alpha blended, weighted by its alpha and opacity
+/// - Add: the input is added to the result (saturated)
+/// - Subtract: the result is subtracted from the input (saturated at 0)
+/// The alpha of the output is the alpha of the first input for Over, and
+/// the maximum of both alphas for Add and Subtract.
+///
+/// Rows are processed in parallel and, on x86, the RGBA kernels use SSE2
+/// (available on every x86-64 processor) with fixed point arithmetic. The
+/// portable kernels use the same arithmetic and give identical results.
+class VTK_MRML_LOGIC_EXPORT vtkImageSliceCompositor : public vtkThreadedImageAlgorithm
+{
+public:
+  static vtkImageSliceCompositor *New();
+  vtkTypeMacro(vtkImageSliceCompositor, vtkThreadedImageAlgorithm);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  enum Operations
+    {
+    Over = 0,
+    Add,
+    Subtract
+    };
+
+  /// Set/Get the opacity of an input, between 0 and 1.
+  /// The opacity of the first input is ignored. Default is 1.
+  void SetOpacity(int idx, double opacity);
+  double GetOpacity(int idx);
+
+  /// Set/Get how an input is composited with the previous inputs.
+  /// The operation of the first input is ignored. Default is Over.
+  void SetOperation(int idx, int operation);
+  int GetOperation(int idx);
+
+protected:
+  vtkImageSliceCompositor();
+  ~vtkImageSliceCompositor();
+
+  virtual int RequestInformation(vtkInformation *,
+                                 vtkInformationVector **,
+                                 vtkInformationVector *);
+
+  virtual int RequestUpdateExtent(vtkInformation *,
+                                  vtkInformationVector **,
+                                  vtkInformationVector *);
+
+  virtual void ThreadedRequestData(vtkInformation *request,
+                                   vtkInformationVector **inputVector,
+                                   vtkInformationVector *outputVector,
+                                   vtkImageData ***inData,
+                                   vtkImageData **outData,
+                                   int outExt[6], int threadId);
+
+  virtual int FillInputPortInformation(int port, vtkInformation *info);
+
+  std::vector<double> Opacities;
+  std::vector<int> Operations;
+
+private:
+  vtkImageSliceCompositor(const vtkImageSliceCompositor&);  // Not implemented.
+  void operator=(const vtkImageSliceCompositor&);  // Not implemented.
+};
+
+#endif
@@ -641,6 +641,10 @@ bool vtkMRMLApplicationLogic::SaveSceneToSlicerDataBundleDirectory(const char *s
   this->OriginalStorageNodeFileNames.clear();
 
   std::map<std::string, vtkMRMLNode *> storableNodes;
+  // nodes of the scene, written all together before the scene
+  std::vector<vtkMRMLStorableNode*> nodesToWrite;
+  // full paths of the data files, not all written yet
+  std::set<std::string> dataFileNames;
 
   int numNodes = this->GetMRMLScene()->GetNumberOfNodes();
   for (int i = 0; i < numNodes; ++i)
@@ -657,7 +661,10 @@ bool vtkMRMLApplicationLogic::SaveSceneToSlicerDataBundleDirectory(const char *s
       // and store them in the map by ID to avoid duplicates for the scene views
       vtkMRMLStorableNode *storableNode = vtkMRMLStorableNode::SafeDownCast(mrmlNode);
 
-      this->SaveStorableNodeToSlicerDataBundleDirectory(storableNode, dataDir);
+      if (this->SaveStorableNodeToSlicerDataBundleDirectory(storableNode, dataDir, dataFileNames))
+        {
+        nodesToWrite.push_back(storableNode);
+        }
 
       storableNodes[std::string(storableNode->GetID())] = storableNode;
     }
@@ -678,7 +685,11 @@ bool vtkMRMLApplicationLogic::SaveSceneToSlicerDataBundleDirectory(const char *s
           // save only new storable nodes
           storableNode->SetAddToScene(1);
           storableNode->UpdateScene(this->GetMRMLScene());
-          this->SaveStorableNodeToSlicerDataBundleDirectory(storableNode, dataDir);
+          // the storage node is found only while the node is added to the scene
+          if (this->SaveStorableNodeToSlicerDataBundleDirectory(storableNode, dataDir, dataFileNames))
+            {
+            storableNode->GetStorageNode()->WriteData(storableNode);
+            }
 
           storableNodes[std::string(storableNode->GetID())] = storableNode;
           storableNode->SetAddToScene(0);
@@ -700,6 +711,10 @@ bool vtkMRMLApplicationLogic::SaveSceneToSlicerDataBundleDirectory(const char *s
         }
       }
   }
+
+  // write the data of the scene nodes, several files at a time
+  this->GetMRMLScene()->WriteStorableNodes(nodesToWrite);
+
   //
   // create a scene view, using the snapshot passed in if any
   //
@@ -828,12 +843,13 @@ bool vtkMRMLApplicationLogic::SaveSceneToSlicerDataBundleDirectory(const char *s
 }
 
 //----------------------------------------------------------------------------
-void vtkMRMLApplicationLogic::SaveStorableNodeToSlicerDataBundleDirectory(vtkMRMLStorableNode *storableNode,
-                                                                          std::string &dataDir)
+bool vtkMRMLApplicationLogic::SaveStorableNodeToSlicerDataBundleDirectory(vtkMRMLStorableNode *storableNode,
+                                                                          std::string &dataDir,
+                                                                          std::set<std::string> &fileNames)
 {
   if (!storableNode || !storableNode->GetSaveWithScene())
     {
-    return;
+    return false;
     }
   // adjust the file paths for storable nodes
   vtkMRMLStorageNode *storageNode = storableNode->GetStorageNode();
@@ -845,7 +861,7 @@ void vtkMRMLApplicationLogic::SaveStorableNodeToSlicerDataBundleDirectory(vtkMRM
     if (!storageNode)
       {
       // no need for storage node to store this node
-      return;
+      return false;
       }
     }
 
@@ -907,9 +923,24 @@ void vtkMRMLApplicationLogic::SaveStorableNodeToSlicerDataBundleDirectory(vtkMRM
     vtkDebugMacro("found unique file name " << uniqueFileName.c_str());
     storageNode->SetFileName(uniqueFileName.c_str());
     }
+  // the files of the other nodes may not be written yet
+  if (fileNames.find(storageNode->GetFullNameFromFileName()) != fileNames.end())
+    {
+    std::string fileBaseName = storageNode->GetFileNameWithoutExtension();
+    std::string extension = storageNode->GetSupportedFileExtension();
+    for (int v = 1; fileNames.find(storageNode->GetFullNameFromFileName()) != fileNames.end()
+           || vtksys::SystemTools::FileExists(storageNode->GetFullNameFromFileName().c_str(), true); ++v)
+      {
+      std::stringstream ss;
+      ss << fileBaseName << v << extension;
+      storageNode->SetFileName(ss.str().c_str());
+      }
+    vtkDebugMacro("found unique file name " << storageNode->GetFileName());
+    }
+  fileNames.insert(storageNode->GetFullNameFromFileName());
 
-  storageNode->WriteData(storableNode);
- }
+  return true;
+}
 
 //----------------------------------------------------------------------------
 std::string vtkMRMLApplicationLogic::CreateUniqueFileName(std::string &filename)
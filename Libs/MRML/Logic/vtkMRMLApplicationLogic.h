@@ -41,6 +41,7 @@ class vtkCollection;
 class vtkImageData;
 
 // STD includes
+#include <set>
 #include <vector>
 
 class VTK_MRML_LOGIC_EXPORT vtkMRMLApplicationLogic
@@ -210,8 +211,13 @@ protected:
   void SetSelectionNode(vtkMRMLSelectionNode* );
   void SetInteractionNode(vtkMRMLInteractionNode* );
 
-  void SaveStorableNodeToSlicerDataBundleDirectory(vtkMRMLStorableNode *storableNode,
-                                                 std::string &dataDir);
+  /// Set the storage node of the storable node to write into \a dataDir
+  /// with a file name not already in \a fileNames, then add it to
+  /// \a fileNames. The data is not written.
+  /// Returns true if the data of the node must be written.
+  bool SaveStorableNodeToSlicerDataBundleDirectory(vtkMRMLStorableNode *storableNode,
+                                                   std::string &dataDir,
+                                                   std::set<std::string> &fileNames);
 
 
 
@@ -46,6 +46,7 @@
 
 //
 #include "vtkImageLabelOutline.h"
+#include "vtkImageResliceLabelOutline.h"
 
 // STD includes
 #include <algorithm>
@@ -125,6 +126,8 @@ vtkMRMLSliceLayerLogic::vtkMRMLSliceLayerLogic()
   this->ResliceUVW = vtkImageReslice::New();
   this->LabelOutline = vtkImageLabelOutline::New();
   this->LabelOutlineUVW = vtkImageLabelOutline::New();
+  this->ResliceLabelOutline = vtkImageResliceLabelOutline::New();
+  this->ResliceLabelOutlineUVW = vtkImageResliceLabelOutline::New();
 
   //
   // Set parameters that won't change based on input
@@ -146,6 +149,12 @@ vtkMRMLSliceLayerLogic::vtkMRMLSliceLayerLogic()
   this->ResliceUVW->GenerateStencilOutputOn();
 
   this->UpdatingTransforms = 0;
+  this->ImageDataPyramidLevel = 0;
+  this->ImageDataPyramidAxes = 0;
+  for (int i = 0; i < 3; ++i)
+    {
+    this->ImageDataPyramidVoxelsPerPixel[i] = 0.0;
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -173,12 +182,16 @@ vtkMRMLSliceLayerLogic::~vtkMRMLSliceLayerLogic()
   this->ResliceUVW->SetInputConnection( 0 );
   this->LabelOutline->SetInputConnection( 0 );
   this->LabelOutlineUVW->SetInputConnection( 0 );
+  this->ResliceLabelOutline->SetInputConnection( 0 );
+  this->ResliceLabelOutlineUVW->SetInputConnection( 0 );
 
   this->Reslice->Delete();
   this->ResliceUVW->Delete();
 
   this->LabelOutline->Delete();
   this->LabelOutlineUVW->Delete();
+  this->ResliceLabelOutline->Delete();
+  this->ResliceLabelOutlineUVW->Delete();
 
   this->AssignAttributeTensorsToScalars->Delete();
   this->AssignAttributeScalarsToTensors->Delete();
@@ -257,6 +270,19 @@ void vtkMRMLSliceLayerLogic::ProcessMRMLNodesEvents(vtkObject * caller,
         this->UpdateLogic();
         }
       break;
+    case vtkMRMLVolumeNode::ImageDataModifiedEvent:
+      // A pyramid level is a copy of the image data: it would be stale after
+      // an in place modification. Reslice the image data until the level is
+      // requested again by UpdateImageDisplay() instead of rebuilding it
+      // after each modification (e.g. while painting).
+      if (caller == this->VolumeNode && this->ImageDataPyramidLevel > 0)
+        {
+        this->ImageDataPyramidLevel = 0;
+        this->ImageDataPyramidAxes = 0;
+        this->Reslice->SetInputData(this->VolumeNode->GetImageData());
+        this->Modified();
+        }
+      break;
     default:
       this->Superclass::ProcessMRMLNodesEvents(caller, event, callData);
       break;
@@ -313,6 +339,7 @@ void vtkMRMLSliceLayerLogic::SetVolumeNode(vtkMRMLVolumeNode *volumeNode)
   vtkIntArray *events = vtkIntArray::New();
   events->InsertNextValue(vtkMRMLTransformableNode::TransformModifiedEvent);
   events->InsertNextValue(vtkCommand::ModifiedEvent);
+  events->InsertNextValue(vtkMRMLVolumeNode::ImageDataModifiedEvent);
   vtkSetAndObserveMRMLNodeEventsMacro(this->VolumeNode, volumeNode, events );
   events->Delete();
 
@@ -499,6 +526,11 @@ void vtkMRMLSliceLayerLogic::UpdateTransforms()
   this->XYToIJKTransform->PostMultiply();
   this->UVWToIJKTransform->PostMultiply();
 
+  for (int i = 0; i < 3; ++i)
+    {
+    this->ImageDataPyramidVoxelsPerPixel[i] = 0.0;
+    }
+
   if (this->SliceNode)
     {
     vtkMatrix4x4::Multiply4x4(this->SliceNode->GetXYToRAS(), xyToIJK.GetPointer(), xyToIJK.GetPointer());
@@ -540,6 +572,17 @@ void vtkMRMLSliceLayerLogic::UpdateTransforms()
       {
       SnapToPermuteMatrix(linearXYToIJKTransform);
       this->Reslice->SetResliceTransform(linearXYToIJKTransform);
+      this->ResliceLabelOutline->SetResliceMatrix(linearXYToIJKTransform->GetMatrix());
+
+      // Number of voxels along each IJK axis spanned by a pixel, used to
+      // choose the pyramid level. It is ~0 along the axes normal to the
+      // slice plane.
+      vtkMatrix4x4* matrix = linearXYToIJKTransform->GetMatrix();
+      for (int i = 0; i < 3; ++i)
+        {
+        this->ImageDataPyramidVoxelsPerPixel[i] = std::max(
+          fabs(matrix->GetElement(i, 0)), fabs(matrix->GetElement(i, 1)));
+        }
       }
     else
       {
@@ -550,6 +593,7 @@ void vtkMRMLSliceLayerLogic::UpdateTransforms()
       {
       SnapToPermuteMatrix(linearUVWToIJKTransform);
       this->ResliceUVW->SetResliceTransform( linearUVWToIJKTransform );
+      this->ResliceLabelOutlineUVW->SetResliceMatrix(linearUVWToIJKTransform->GetMatrix());
       }
     else
       {
@@ -584,6 +628,9 @@ void vtkMRMLSliceLayerLogic::UpdateTransforms()
                                      0, dimensionsUVW[1]-1,
                                      0, dimensionsUVW[2]-1);
 
+  this->ResliceLabelOutline->SetOutputExtent(this->Reslice->GetOutputExtent());
+  this->ResliceLabelOutlineUVW->SetOutputExtent(this->ResliceUVW->GetOutputExtent());
+
   this->UpdatingTransforms = 0;
 
   //if (transformModified || transformModifiedUVW)
@@ -599,6 +646,10 @@ vtkImageData* vtkMRMLSliceLayerLogic::GetImageData()
     {
     return NULL;
     }
+  if (this->IsResliceLabelOutlineUsed(this->VolumeDisplayNode, this->Reslice))
+    {
+    return this->ResliceLabelOutline->GetOutput();
+    }
   return this->GetVolumeDisplayNode()->GetOutputImageData();
 }
 
@@ -609,6 +660,10 @@ vtkAlgorithmOutput* vtkMRMLSliceLayerLogic::GetImageDataConnection()
     {
     return NULL;
     }
+  if (this->IsResliceLabelOutlineUsed(this->VolumeDisplayNode, this->Reslice))
+    {
+    return this->ResliceLabelOutline->GetOutputPort();
+    }
   return this->GetVolumeDisplayNode()->GetOutputImageDataConnection();
 }
 
@@ -619,6 +674,10 @@ vtkImageData* vtkMRMLSliceLayerLogic::GetImageDataUVW()
     {
     return NULL;
     }
+  if (this->IsResliceLabelOutlineUsed(this->VolumeDisplayNodeUVW, this->ResliceUVW))
+    {
+    return this->ResliceLabelOutlineUVW->GetOutput();
+    }
   return this->GetVolumeDisplayNodeUVW()->GetOutputImageData();
 }
 
@@ -629,6 +688,10 @@ vtkAlgorithmOutput* vtkMRMLSliceLayerLogic::GetImageDataConnectionUVW()
     {
     return NULL;
     }
+  if (this->IsResliceLabelOutlineUsed(this->VolumeDisplayNodeUVW, this->ResliceUVW))
+    {
+    return this->ResliceLabelOutlineUVW->GetOutputPort();
+    }
   return this->GetVolumeDisplayNodeUVW()->GetOutputImageDataConnection();
 }
 
@@ -651,6 +714,8 @@ void vtkMRMLSliceLayerLogic::UpdateImageDisplay()
   vtkMTimeType oldAssign = this->AssignAttributeTensorsToScalars->GetMTime();
   vtkMTimeType oldLabel = this->LabelOutline->GetMTime();
   vtkMTimeType oldLabelUVW = this->LabelOutlineUVW->GetMTime();
+  vtkMTimeType oldResliceLabel = this->ResliceLabelOutline->GetMTime();
+  vtkMTimeType oldResliceLabelUVW = this->ResliceLabelOutlineUVW->GetMTime();
 
   if ( (this->VolumeNode->GetImageData() && labelMapVolumeDisplayNode) ||
        (scalarVolumeDisplayNode && scalarVolumeDisplayNode->GetInterpolate() == 0))
@@ -736,7 +801,7 @@ void vtkMRMLSliceLayerLogic::UpdateImageDisplay()
 //      {
 //      volumeNode->GetImageData()->Print(std::cout);
 //      }
-    this->Reslice->SetInputData(volumeNode->GetImageData());
+    this->Reslice->SetInputData(this->GetResliceInputImageData());
     this->ResliceUVW->SetInputData(volumeNode->GetImageData());
     // use the label outline if we have a label map volume, this is the label
     // layer (turned on in slice logic when the label layer is instantiated)
@@ -758,11 +823,23 @@ void vtkMRMLSliceLayerLogic::UpdateImageDisplay()
         {
         this->LabelOutlineUVW->SetInputConnection( 0 );
         }
+      // Fused pipeline used when the reslice transform is linear
+      vtkMRMLLabelMapVolumeDisplayNode* labelMapVolumeDisplayNodeUVW =
+        vtkMRMLLabelMapVolumeDisplayNode::SafeDownCast(this->VolumeDisplayNodeUVW);
+      this->ResliceLabelOutline->SetInputData(volumeNode->GetImageData());
+      this->ResliceLabelOutline->SetOutline(outlineThickness);
+      this->ResliceLabelOutline->SetLookupTable(labelMapVolumeDisplayNode->GetLookupTable());
+      this->ResliceLabelOutlineUVW->SetInputData(volumeNode->GetImageData());
+      this->ResliceLabelOutlineUVW->SetOutline(outlineThickness);
+      this->ResliceLabelOutlineUVW->SetLookupTable(
+        labelMapVolumeDisplayNodeUVW ? labelMapVolumeDisplayNodeUVW->GetLookupTable() : 0);
       }
     else
       {
         this->LabelOutline->SetInputConnection(0);
         this->LabelOutlineUVW->SetInputConnection(0);
+        this->ResliceLabelOutline->SetInputConnection(0);
+        this->ResliceLabelOutlineUVW->SetInputConnection(0);
       }
     }
 
@@ -790,6 +867,8 @@ void vtkMRMLSliceLayerLogic::UpdateImageDisplay()
        oldAssign != this->AssignAttributeTensorsToScalars->GetMTime() ||
        oldLabel != this->LabelOutline->GetMTime() ||
        oldLabelUVW != this->LabelOutlineUVW->GetMTime() ||
+       oldResliceLabel != this->ResliceLabelOutline->GetMTime() ||
+       oldResliceLabelUVW != this->ResliceLabelOutlineUVW->GetMTime() ||
        (volumeNode != 0 && (volumeNode->GetMTime() > oldReSliceMTime)) ||
        (volumeDisplayNode != 0 && (volumeDisplayNode->GetMTime() > oldReSliceMTime)) ||
        (volumeDisplayNodeUVW != 0 && (volumeDisplayNodeUVW->GetMTime() > oldReSliceUVWMTime))
@@ -837,6 +916,74 @@ vtkAlgorithmOutput* vtkMRMLSliceLayerLogic::GetSliceImageDataConnectionUVW()
   return this->ResliceUVW->GetOutputPort();
 }
 
+//----------------------------------------------------------------------------
+bool vtkMRMLSliceLayerLogic::IsResliceLabelOutlineUsed(
+  vtkMRMLVolumeDisplayNode* displayNode, vtkImageReslice* reslice)
+{
+  vtkMRMLLabelMapVolumeDisplayNode* labelMapVolumeDisplayNode =
+    vtkMRMLLabelMapVolumeDisplayNode::SafeDownCast(displayNode);
+  // non linear transforms are resliced by vtkImageReslice only
+  return this->GetIsLabelLayer() &&
+         labelMapVolumeDisplayNode && labelMapVolumeDisplayNode->GetLookupTable() &&
+         this->SliceNode && this->SliceNode->GetUseLabelOutline() &&
+         this->VolumeNode && this->VolumeNode->GetImageData() &&
+         vtkTransform::SafeDownCast(reslice->GetResliceTransform()) != 0;
+}
+
+//----------------------------------------------------------------------------
+vtkImageData* vtkMRMLSliceLayerLogic::GetResliceInputImageData()
+{
+  this->ImageDataPyramidLevel = 0;
+  this->ImageDataPyramidAxes = 0;
+  vtkImageData* imageData = this->VolumeNode ? this->VolumeNode->GetImageData() : NULL;
+
+  // Averaged voxels are only displayed when the volume is interpolated.
+  // Labels are never averaged.
+  vtkMRMLScalarVolumeNode* scalarVolumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(this->VolumeNode);
+  vtkMRMLScalarVolumeDisplayNode* scalarVolumeDisplayNode =
+    vtkMRMLScalarVolumeDisplayNode::SafeDownCast(this->VolumeDisplayNode);
+  if (!imageData || !scalarVolumeNode || !scalarVolumeNode->GetImageDataPyramidEnabled() ||
+      vtkMRMLLabelMapVolumeNode::SafeDownCast(this->VolumeNode) ||
+      scalarVolumeNode->IsA("vtkMRMLDiffusionTensorVolumeNode") ||
+      !scalarVolumeDisplayNode || !scalarVolumeDisplayNode->GetInterpolate() ||
+      vtkMRMLLabelMapVolumeDisplayNode::SafeDownCast(this->VolumeDisplayNode))
+    {
+    return imageData;
+    }
+
+  // Downsample the axes in the slice plane, as long as a pixel still spans
+  // at least one voxel of the level along each of them.
+  int axes = 0;
+  double voxelsPerPixel = VTK_DOUBLE_MAX;
+  for (int i = 0; i < 3; ++i)
+    {
+    if (this->ImageDataPyramidVoxelsPerPixel[i] >= 2.0)
+      {
+      axes |= (1 << i);
+      voxelsPerPixel = std::min(voxelsPerPixel, this->ImageDataPyramidVoxelsPerPixel[i]);
+      }
+    }
+  if (axes == 0)
+    {
+    return imageData;
+    }
+  int level = 0;
+  int maximumLevel = scalarVolumeNode->GetMaximumImageDataPyramidLevel(axes);
+  while (voxelsPerPixel >= 2.0 && level < maximumLevel)
+    {
+    voxelsPerPixel /= 2.0;
+    ++level;
+    }
+  vtkImageData* levelImageData = scalarVolumeNode->GetImageDataPyramidLevel(level, axes);
+  if (!levelImageData)
+    {
+    return imageData;
+    }
+  this->ImageDataPyramidLevel = level;
+  this->ImageDataPyramidAxes = (level > 0 ? axes : 0);
+  return levelImageData;
+}
+
 //----------------------------------------------------------------------------
 void vtkMRMLSliceLayerLogic::UpdateGlyphs()
 {
@@ -973,6 +1120,8 @@ void vtkMRMLSliceLayerLogic::PrintSelf(ostream& os, vtkIndent indent)
     }
 
   os << indent << "IsLabelLayer: " << this->GetIsLabelLayer() << "\n";
+  os << indent << "ImageDataPyramidLevel: " << this->ImageDataPyramidLevel << "\n";
+  os << indent << "ImageDataPyramidAxes: " << this->ImageDataPyramidAxes << "\n";
   os << indent << "LabelOutline:\n";
   if (this->LabelOutline)
     {
@@ -992,4 +1141,24 @@ void vtkMRMLSliceLayerLogic::PrintSelf(ostream& os, vtkIndent indent)
     {
     os << indent << " (0)\n";
     }
+
+  os << indent << "ResliceLabelOutline:\n";
+  if (this->ResliceLabelOutline)
+    {
+    this->ResliceLabelOutline->PrintSelf(os, nextIndent);
+    }
+  else
+    {
+    os << indent << " (0)\n";
+    }
+
+  os << indent << "ResliceLabelOutlineUVW:\n";
+  if (this->ResliceLabelOutlineUVW)
+    {
+    this->ResliceLabelOutlineUVW->PrintSelf(os, nextIndent);
+    }
+  else
+    {
+    os << indent << " (0)\n";
+    }
 }
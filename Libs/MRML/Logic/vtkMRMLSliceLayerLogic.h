@@ -55,6 +55,7 @@ class vtkGeneralTransform;
 //#include <cstdlib>
 
 class vtkImageLabelOutline;
+class vtkImageResliceLabelOutline;
 class vtkTransform;
 
 class VTK_MRML_LOGIC_EXPORT vtkMRMLSliceLayerLogic
@@ -100,6 +101,12 @@ public:
   /// The filter that turns the label map into an outline
   vtkGetObjectMacro (LabelOutline, vtkImageLabelOutline);
 
+  ///
+  /// The filter that reslices the label map, outlines and colors it in a
+  /// single pass. It is the output of label layers displayed with outlines
+  /// when the reslice transform is linear.
+  vtkGetObjectMacro (ResliceLabelOutline, vtkImageResliceLabelOutline);
+
   ///
   /// Get the output of the pipeline for this layer
   vtkImageData *GetImageData();
@@ -129,6 +136,21 @@ public:
   /// The current reslice transform XYToIJK
   vtkGetObjectMacro (XYToIJKTransform, vtkGeneralTransform);
 
+  ///
+  /// Level of the image data pyramid of the scalar volume that is resliced
+  /// in the XY pipeline. It is greater than 0 when the pyramid of the volume
+  /// is enabled, the volume is interpolated and the slice view is zoomed
+  /// out so that a screen pixel spans at least 2^level voxels. Label maps
+  /// are always resliced at full resolution.
+  /// \sa vtkMRMLScalarVolumeNode::GetImageDataPyramidLevel()
+  vtkGetMacro (ImageDataPyramidLevel, int);
+
+  ///
+  /// IJK axes downsampled in the resliced pyramid level, i.e. the axes in
+  /// the slice plane. 0 if ImageDataPyramidLevel is 0.
+  /// \sa vtkMRMLScalarVolumeNode::AxisI
+  vtkGetMacro (ImageDataPyramidAxes, int);
+
 
 protected:
   vtkMRMLSliceLayerLogic();
@@ -153,9 +175,19 @@ protected:
   vtkAlgorithmOutput* GetSliceImageDataConnection();
   vtkAlgorithmOutput* GetSliceImageDataConnectionUVW();
 
+  /// Return true if the output of the layer is computed by the fused
+  /// reslice and outline filter instead of the display node pipeline.
+  bool IsResliceLabelOutlineUsed(vtkMRMLVolumeDisplayNode* displayNode,
+                                 vtkImageReslice* reslice);
+
   // Copy VolumeDisplayNodeObserved into VolumeDisplayNode
   void UpdateVolumeDisplayNode();
 
+  /// Choose ImageDataPyramidLevel and ImageDataPyramidAxes and return the
+  /// image data resliced in the XY pipeline: the image data of the volume
+  /// node, or that level of its pyramid (built if needed).
+  vtkImageData* GetResliceInputImageData();
+
   ///
   /// the MRML Nodes that define this Logic's parameters
   vtkMRMLVolumeNode *VolumeNode;
@@ -170,6 +202,8 @@ protected:
   vtkImageReslice *ResliceUVW;
   vtkImageLabelOutline *LabelOutline;
   vtkImageLabelOutline *LabelOutlineUVW;
+  vtkImageResliceLabelOutline *ResliceLabelOutline;
+  vtkImageResliceLabelOutline *ResliceLabelOutlineUVW;
 
   vtkAssignAttribute* AssignAttributeTensorsToScalars;
   vtkAssignAttribute* AssignAttributeScalarsToTensors;
@@ -182,6 +216,12 @@ protected:
   int IsLabelLayer;
 
   int UpdatingTransforms;
+
+  int ImageDataPyramidLevel;
+  int ImageDataPyramidAxes;
+  /// Voxels spanned by a pixel along each IJK axis, 0 if the XY reslice
+  /// transform is not linear
+  double ImageDataPyramidVoxelsPerPixel[3];
 };
 
 #endif
@@ -15,6 +15,7 @@
 // MRMLLogic includes
 #include "vtkMRMLSliceLogic.h"
 #include "vtkMRMLSliceLayerLogic.h"
+#include "vtkImageSliceCompositor.h"
 
 // MRML includes
 #include <vtkEventBroker.h>
@@ -32,11 +33,8 @@
 #include <vtkAlgorithmOutput.h>
 #include <vtkCallbackCommand.h>
 #include <vtkCollection.h>
-#include <vtkImageBlend.h>
 #include <vtkImageResample.h>
-#include <vtkImageCast.h>
 #include <vtkImageData.h>
-#include <vtkImageMathematics.h>
 #include <vtkImageReslice.h>
 #include <vtkInformation.h>
 #include <vtkMath.h>
@@ -50,6 +48,7 @@
 #include <vtkVersion.h>
 
 // STD includes
+#include <vector>
 
 //----------------------------------------------------------------------------
 // Convenient macros
@@ -80,8 +79,8 @@ vtkMRMLSliceLogic::vtkMRMLSliceLogic()
   this->LabelLayer = 0;
   this->SliceNode = 0;
   this->SliceCompositeNode = 0;
-  this->Blend = vtkImageBlend::New();
-  this->BlendUVW = vtkImageBlend::New();
+  this->Blend = vtkImageSliceCompositor::New();
+  this->BlendUVW = vtkImageSliceCompositor::New();
 
   this->ExtractModelTexture = vtkImageReslice::New();
   this->ExtractModelTexture->SetOutputDimensionality (2);
@@ -846,6 +845,43 @@ void vtkMRMLSliceLogic::UpdateImageData ()
     }
 }
 
+//----------------------------------------------------------------------------
+namespace
+{
+// Update the inputs of the compositor only where they changed so that its
+// modification time reflects actual changes. Null ports are skipped.
+void SetCompositorInputs(vtkImageSliceCompositor* compositor,
+                         const std::vector<vtkAlgorithmOutput*>& ports,
+                         const std::vector<double>& opacities,
+                         const std::vector<int>& operations)
+{
+  int layerIndex = 0;
+  for (size_t i = 0; i < ports.size(); ++i)
+    {
+    if (!ports[i])
+      {
+      continue;
+      }
+    if (layerIndex < compositor->GetNumberOfInputConnections(0))
+      {
+      compositor->SetNthInputConnection(0, layerIndex, ports[i]);
+      }
+    else
+      {
+      compositor->AddInputConnection(0, ports[i]);
+      }
+    compositor->SetOpacity(layerIndex, opacities[i]);
+    compositor->SetOperation(layerIndex, operations[i]);
+    ++layerIndex;
+    }
+  while (compositor->GetNumberOfInputConnections(0) > layerIndex)
+    {
+    // it decreases the number of inputs
+    compositor->RemoveInputConnection(0, compositor->GetNumberOfInputConnections(0) - 1);
+    }
+}
+} // end of anonymous namespace
+
 //----------------------------------------------------------------------------
 void vtkMRMLSliceLogic::UpdatePipeline()
 {
@@ -954,135 +990,47 @@ void vtkMRMLSliceLogic::UpdatePipeline()
     vtkMTimeType oldBlendMTime = this->Blend->GetMTime();
     vtkMTimeType oldBlendUVWMTime = this->BlendUVW->GetMTime();
 
-    int layerIndex = 0;
-    int layerIndexUVW = 0;
-
+    std::vector<vtkAlgorithmOutput*> layerPorts;
+    std::vector<vtkAlgorithmOutput*> layerPortsUVW;
+    std::vector<double> layerOpacities;
+    std::vector<int> layerOperations;
     if (!alphaBlending)
       {
-      vtkNew<vtkImageMathematics> tempMath;
-      if (sliceCompositing == vtkMRMLSliceCompositeNode::Add)
-        {
-        // add the foreground and background
-        tempMath->SetOperationToAdd();
-        }
-      else if (sliceCompositing == vtkMRMLSliceCompositeNode::Subtract)
-        {
-        // subtract the foreground and background
-        tempMath->SetOperationToSubtract();
-        }
-      tempMath->SetInputConnection(0, foregroundImagePort );
-      tempMath->SetInputConnection(1, backgroundImagePort );
-      vtkInformation *tempMathOutInfo = tempMath->GetOutputInformation(0);
-      vtkDataObject::SetPointDataActiveScalarInfo(tempMathOutInfo, VTK_SHORT,
-        vtkImageData::GetNumberOfScalarComponents(tempMathOutInfo));
-
-      vtkNew<vtkImageCast> tempCast;
-      tempCast->SetInputConnection( tempMath->GetOutputPort() );
-      tempCast->SetOutputScalarTypeToUnsignedChar();
-
-      this->Blend->SetInputConnection( tempCast->GetOutputPort() );
-      this->Blend->SetOpacity( layerIndex++, 1.0 );
-
-      // UVW pipeline
-      vtkNew<vtkImageMathematics> tempMathUVW;
-      if (sliceCompositing == vtkMRMLSliceCompositeNode::Add)
-        {
-        // add the foreground and background
-        tempMathUVW->SetOperationToAdd();
-        }
-      else if (sliceCompositing == vtkMRMLSliceCompositeNode::Subtract)
-        {
-        // subtract the foreground and background
-        tempMathUVW->SetOperationToSubtract();
-        }
-
-      tempMathUVW->SetInputConnection(0, foregroundImagePortUVW );
-      tempMathUVW->SetInputConnection(1, backgroundImagePortUVW );
-      vtkInformation *tempMathUVWOutInfo = tempMathUVW->GetOutputInformation(0);
-      vtkDataObject::SetPointDataActiveScalarInfo(tempMathUVWOutInfo, VTK_SHORT,
-        vtkImageData::GetNumberOfScalarComponents(tempMathUVWOutInfo));
-
-      vtkNew<vtkImageCast> tempCastUVW;
-      tempCastUVW->SetInputConnection( tempMathUVW->GetOutputPort() );
-      tempCastUVW->SetOutputScalarTypeToUnsignedChar();
-
-      this->BlendUVW->AddInputConnection( tempCastUVW->GetOutputPort() );
-      this->BlendUVW->SetOpacity( layerIndexUVW++, 1.0 );
+      // the foreground is added to or subtracted from the background
+      layerPorts.push_back(backgroundImagePort);
+      layerPortsUVW.push_back(backgroundImagePortUVW);
+      layerOpacities.push_back(1.0);
+      layerOperations.push_back(vtkImageSliceCompositor::Over);
+      layerPorts.push_back(foregroundImagePort);
+      layerPortsUVW.push_back(foregroundImagePortUVW);
+      layerOpacities.push_back(1.0);
+      layerOperations.push_back(
+        sliceCompositing == vtkMRMLSliceCompositeNode::Subtract ?
+        vtkImageSliceCompositor::Subtract : vtkImageSliceCompositor::Add);
       }
     else
       {
-      this->Blend->RemoveAllInputs();
-      this->BlendUVW->RemoveAllInputs();
-      if (sliceCompositing ==  vtkMRMLSliceCompositeNode::Alpha)
-        {
-        if ( backgroundImagePort )
-          {
-          this->Blend->AddInputConnection( backgroundImagePort );
-          this->Blend->SetOpacity( layerIndex++, 1.0 );
-          }
-        if ( foregroundImagePort )
-          {
-          this->Blend->AddInputConnection( foregroundImagePort );
-          this->Blend->SetOpacity( layerIndex++, this->SliceCompositeNode->GetForegroundOpacity() );
-          }
-        if ( backgroundImagePortUVW )
-          {
-          this->BlendUVW->AddInputConnection( backgroundImagePortUVW );
-          this->BlendUVW->SetOpacity( layerIndexUVW++, 1.0 );
-          }
-        if ( foregroundImagePortUVW )
-          {
-          this->BlendUVW->AddInputConnection( foregroundImagePortUVW );
-          this->BlendUVW->SetOpacity( layerIndexUVW++, this->SliceCompositeNode->GetForegroundOpacity() );
-          }
-        }
-      else if (sliceCompositing == vtkMRMLSliceCompositeNode::ReverseAlpha)
-        {
-        if ( foregroundImagePort )
-          {
-          this->Blend->AddInputConnection( foregroundImagePort );
-          this->Blend->SetOpacity( layerIndex++, 1.0 );
-          }
-        if ( backgroundImagePort )
-          {
-          this->Blend->AddInputConnection( backgroundImagePort );
-          this->Blend->SetOpacity( layerIndex++, this->SliceCompositeNode->GetForegroundOpacity() );
-          }
-        if ( foregroundImagePortUVW )
-          {
-          this->BlendUVW->AddInputConnection( foregroundImagePortUVW );
-          this->BlendUVW->SetOpacity( layerIndexUVW++, 1.0 );
-          }
-        if ( backgroundImagePortUVW )
-          {
-          this->BlendUVW->AddInputConnection( backgroundImagePortUVW );
-          this->BlendUVW->SetOpacity( layerIndexUVW++, this->SliceCompositeNode->GetForegroundOpacity() );
-          }
-        }
+      bool reverse = (sliceCompositing == vtkMRMLSliceCompositeNode::ReverseAlpha);
+      layerPorts.push_back(reverse ? foregroundImagePort : backgroundImagePort);
+      layerPortsUVW.push_back(reverse ? foregroundImagePortUVW : backgroundImagePortUVW);
+      layerOpacities.push_back(1.0);
+      layerOperations.push_back(vtkImageSliceCompositor::Over);
+      layerPorts.push_back(reverse ? backgroundImagePort : foregroundImagePort);
+      layerPortsUVW.push_back(reverse ? backgroundImagePortUVW : foregroundImagePortUVW);
+      layerOpacities.push_back(this->SliceCompositeNode->GetForegroundOpacity());
+      layerOperations.push_back(vtkImageSliceCompositor::Over);
       }
     // always blending the label layer
     vtkAlgorithmOutput* labelImagePort = this->LabelLayer ? this->LabelLayer->GetImageDataConnection() : 0;
     vtkAlgorithmOutput* labelImagePortUVW = this->LabelLayer ? this->LabelLayer->GetImageDataConnectionUVW() : 0;
-    if ( labelImagePort )
-      {
-      this->Blend->AddInputConnection( labelImagePort );
-      this->Blend->SetOpacity( layerIndex++, this->SliceCompositeNode->GetLabelOpacity() );
-      }
-    if ( labelImagePortUVW )
-      {
-      this->BlendUVW->AddInputConnection( labelImagePortUVW );
-      this->BlendUVW->SetOpacity( layerIndexUVW++, this->SliceCompositeNode->GetLabelOpacity() );
-      }
-    while (this->Blend->GetNumberOfInputConnections(0) > layerIndex)
-      {
-      // it decreases the number of inputs
-      this->Blend->RemoveInputConnection(0, this->Blend->GetNumberOfInputConnections(0) - 1);
-      }
-    while (this->BlendUVW->GetNumberOfInputConnections(0) > layerIndexUVW)
-      {
-      // it decreases the number of inputs
-      this->BlendUVW->RemoveInputConnection(0, this->BlendUVW->GetNumberOfInputConnections(0) - 1);
-      }
+    layerPorts.push_back(labelImagePort);
+    layerPortsUVW.push_back(labelImagePortUVW);
+    layerOpacities.push_back(this->SliceCompositeNode->GetLabelOpacity());
+    layerOperations.push_back(vtkImageSliceCompositor::Over);
+
+    SetCompositorInputs(this->Blend, layerPorts, layerOpacities, layerOperations);
+    SetCompositorInputs(this->BlendUVW, layerPortsUVW, layerOpacities, layerOperations);
+
     if (this->Blend->GetMTime() > oldBlendMTime)
       {
       modified = 1;
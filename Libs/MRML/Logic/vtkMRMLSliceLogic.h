@@ -32,7 +32,7 @@ class vtkMRMLVolumeNode;
 
 class vtkAlgorithmOutput;
 class vtkCollection;
-class vtkImageBlend;
+class vtkImageSliceCompositor;
 class vtkTransform;
 class vtkImageData;
 class vtkImageReslice;
@@ -127,9 +127,16 @@ public:
 
   ///
   /// The compositing filter
+  /// \note Before Slicer 4.7, GetBlend() and GetBlendUVW() returned a
+  /// vtkImageBlend. C++ code that stores the result in a vtkImageBlend
+  /// pointer must use vtkImageSliceCompositor instead. Its SetOpacity() and
+  /// GetOpacity() have the same signatures as in vtkImageBlend, so Python
+  /// code that only sets opacities or connects the output port still works.
+  /// Blend modes and stencils of vtkImageBlend are not supported.
+  /// To get the composited image, prefer GetImageDataConnection().
   /// TODO: this will eventually be generalized to a per-layer compositing function
-  vtkGetObjectMacro(Blend, vtkImageBlend);
-  vtkGetObjectMacro(BlendUVW, vtkImageBlend);
+  vtkGetObjectMacro(Blend, vtkImageSliceCompositor);
+  vtkGetObjectMacro(BlendUVW, vtkImageSliceCompositor);
 
   ///
   /// The offset to the correct slice for lightbox mode
@@ -393,8 +400,8 @@ protected:
   vtkMRMLSliceLayerLogic *    LabelLayer;
 
 
-  vtkImageBlend *   Blend;
-  vtkImageBlend *   BlendUVW;
+  vtkImageSliceCompositor * Blend;
+  vtkImageSliceCompositor * BlendUVW;
   vtkImageReslice * ExtractModelTexture;
   vtkAlgorithmOutput *    ImageDataConnection;
   vtkTransform *    ActiveSliceTransform;
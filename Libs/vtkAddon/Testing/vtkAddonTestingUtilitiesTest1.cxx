@@ -21,6 +21,9 @@
 // vtkAddon includes
 #include "vtkAddonTestingUtilities.h"
 
+// STD includes
+#include <sstream>
+
 using namespace vtkAddonTestingUtilities;
 
 //----------------------------------------------------------------------------
@@ -29,6 +32,8 @@ bool TestCheckNotNull();
 bool TestCheckNull();
 bool TestCheckPointer();
 bool TestCheckString();
+bool TestIsBenchmarkRequested();
+bool TestReportMeasurement();
 
 //----------------------------------------------------------------------------
 int vtkAddonTestingUtilitiesTest1(int , char * [] )
@@ -39,6 +44,8 @@ int vtkAddonTestingUtilitiesTest1(int , char * [] )
   res = res && TestCheckNull();
   res = res && TestCheckPointer();
   res = res && TestCheckString();
+  res = res && TestIsBenchmarkRequested();
+  res = res && TestReportMeasurement();
   return res ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
@@ -109,3 +116,42 @@ bool TestCheckString()
     }
   return true;
 }
+
+//----------------------------------------------------------------------------
+bool TestIsBenchmarkRequested()
+{
+  char arg0[] = "Test";
+  char arg1[] = "--benchmark";
+  char arg2[] = "/tmp";
+  char* argv[] = {arg0, arg1, arg2};
+  if (!IsBenchmarkRequested(2, argv)
+      || IsBenchmarkRequested(1, argv)
+      || IsBenchmarkRequested(3, argv, 2)
+      || IsBenchmarkRequested(3, argv, 3))
+    {
+    std::cerr << "Line " << __LINE__ << " - TestIsBenchmarkRequested failed" << std::endl;
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool TestReportMeasurement()
+{
+  std::ostringstream output;
+  std::streambuf* coutBuffer = std::cout.rdbuf(output.rdbuf());
+  ReportMeasurement("Time", 1.5);
+  ReportMeasurement("Size", 42, "numeric/integer");
+  std::cout.rdbuf(coutBuffer);
+  std::string expected =
+    "<DartMeasurement name=\"Time\" type=\"numeric/double\">1.5</DartMeasurement>\n"
+    "<DartMeasurement name=\"Size\" type=\"numeric/integer\">42</DartMeasurement>\n";
+  if (output.str() != expected)
+    {
+    std::cerr << "Line " << __LINE__ << " - TestReportMeasurement failed"
+              << "\n\tcurrent :" << output.str()
+              << "\n\texpected:" << expected << std::endl;
+    return false;
+    }
+  return true;
+}
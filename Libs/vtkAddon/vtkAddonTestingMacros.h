@@ -24,6 +24,9 @@
 // vtkAddon includes
 #include <vtkAddonTestingUtilities.h>
 
+// STD includes
+#include <sstream>
+
 /// Convenience macros for unit tests.
 ///
 /// The macro returns from the current method with EXIT_FAILURE if the check fails.
@@ -201,6 +204,33 @@
     } \
   }
 
+/// Prints a measurement that CTest adds to the test results on the dashboard.
+/// The name can be a stream expression.
+///
+/// Example:
+///
+/// \code{.cpp}
+/// if (vtkAddonTestingUtilities::IsBenchmarkRequested(argc, argv))
+///   {
+///   REPORT_MEASUREMENT("vtkImageReslice-" << size, timer->GetElapsedTime());
+///   }
+/// \endcode
+#define REPORT_MEASUREMENT(name, value) \
+  { \
+  std::ostringstream measurementName; \
+  measurementName << name; \
+  vtkAddonTestingUtilities::ReportMeasurement(measurementName.str(), (value)); \
+  }
+
+/// Prints an integer measurement (e.g. a memory size) that CTest adds to the
+/// test results on the dashboard. The name can be a stream expression.
+#define REPORT_INTEGER_MEASUREMENT(name, value) \
+  { \
+  std::ostringstream measurementName; \
+  measurementName << name; \
+  vtkAddonTestingUtilities::ReportMeasurement(measurementName.str(), (value), "numeric/integer"); \
+  }
+
 // Commonly used headers in tests
 #include "vtkNew.h"
 #include "vtkTestingOutputWindow.h"
@@ -96,4 +96,10 @@ bool CheckString(int line, const std::string& description,
   return true;
 }
 
+//----------------------------------------------------------------------------
+bool IsBenchmarkRequested(int argc, char* argv[], int argIndex /* = 1 */)
+{
+  return argIndex < argc && strcmp(argv[argIndex], "--benchmark") == 0;
+}
+
 } // namespace vtkAddonTestingUtilities
@@ -62,6 +62,16 @@ VTK_ADDON_EXPORT
 bool CheckString(int line, const std::string& description,
                  const char* current, const char* expected, bool errorIfDifferent = true );
 
+/// Returns true if argument argIndex of the test is "--benchmark".
+/// Timings on large data are slow and are only run when requested.
+VTK_ADDON_EXPORT
+bool IsBenchmarkRequested(int argc, char* argv[], int argIndex = 1);
+
+/// Prints a measurement that CTest adds to the test results on the dashboard.
+template<typename TYPE>
+void ReportMeasurement(const std::string& name, TYPE value,
+                       const std::string& type = "numeric/double");
+
 } // namespace vtkAddonTestingUtilities
 
 #include "vtkAddonTestingUtilities.txx"
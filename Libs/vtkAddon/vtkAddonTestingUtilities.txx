@@ -64,6 +64,15 @@ bool Check(int line, const std::string& description,
   return true;
 }
 
+//----------------------------------------------------------------------------
+template<typename TYPE>
+void ReportMeasurement(const std::string& name, TYPE value,
+                       const std::string& type /* = "numeric/double" */)
+{
+  std::cout << "<DartMeasurement name=\"" << name.c_str() << "\" type=\"" << type.c_str() << "\">"
+            << value << "</DartMeasurement>" << std::endl;
+}
+
 } // namespace vtkAddonTestingUtilities
 
 #endif
@@ -0,0 +1,104 @@
+#include <vtkITKTimeSeriesDatabase.h>
+
+// VTK includes
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <iostream>
+
+namespace
+{
+
+typedef itk::TimeSeriesDatabaseHelper::LRUCache<unsigned long, int> CacheType;
+
+//----------------------------------------------------------------------------
+int CheckCache(CacheType& cache, unsigned long key, bool expectedCached, int line)
+{
+  int* value = cache.find(key);
+  if ((value != 0) != expectedCached)
+    {
+    std::cout << "ERROR line " << line << ": key " << key
+              << (expectedCached ? " is not" : " is") << " cached" << std::endl;
+    return 1;
+    }
+  if (value && *value != static_cast<int>(10 * key))
+    {
+    std::cout << "ERROR line " << line << ": key " << key << " has value " << *value << std::endl;
+    return 1;
+    }
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int CheckSize(CacheType& cache, size_t expectedSize, int line)
+{
+  if (cache.size() != expectedSize)
+    {
+    std::cout << "ERROR line " << line << ": cache holds " << cache.size()
+              << " elements instead of " << expectedSize << std::endl;
+    return 1;
+    }
+  return 0;
+}
+
+} // end of anonymous namespace
+
+int main(int vtkNotUsed(argc), char * vtkNotUsed(argv)[])
+{
+  CacheType cache(2);
+  cache.insert(1, 10);
+  cache.insert(2, 20);
+  // 1 is now the most recently used, 2 is evicted first
+  if (CheckCache(cache, 1, true, __LINE__)
+    || CheckSize(cache, 2, __LINE__))
+    {
+    return 1;
+    }
+  cache.insert(3, 30);
+  if (CheckSize(cache, 2, __LINE__)
+    || CheckCache(cache, 2, false, __LINE__)
+    || CheckCache(cache, 1, true, __LINE__)
+    || CheckCache(cache, 3, true, __LINE__))
+    {
+    return 1;
+    }
+
+  // Lowering the size limit evicts the least recently used elements at once
+  cache.set_maxsize(4);
+  cache.insert(4, 40);
+  cache.insert(5, 50);
+  if (CheckSize(cache, 4, __LINE__)
+    || CheckCache(cache, 1, true, __LINE__))
+    {
+    return 1;
+    }
+  cache.set_maxsize(2);
+  if (CheckSize(cache, 2, __LINE__)
+    || CheckCache(cache, 1, true, __LINE__)
+    || CheckCache(cache, 5, true, __LINE__)
+    || CheckCache(cache, 3, false, __LINE__)
+    || CheckCache(cache, 4, false, __LINE__))
+    {
+    return 1;
+    }
+
+  // The cache never grows past its limit
+  cache.set_maxsize(0);
+  cache.insert(6, 60);
+  if (CheckSize(cache, 0, __LINE__))
+    {
+    return 1;
+    }
+
+  // The cache size is stored in whole blocks
+  vtkSmartPointer<vtkITKTimeSeriesDatabase> database = vtkSmartPointer<vtkITKTimeSeriesDatabase>::New();
+  database->SetCacheSizeInMiB(1.0);
+  if (database->GetCacheSizeInMiB() != 1.0)
+    {
+    std::cout << "ERROR: cache size is " << database->GetCacheSizeInMiB() << " MiB instead of 1 MiB" << std::endl;
+    return 1;
+    }
+
+  std::cout << "TimeSeriesDatabase cache test passed." << std::endl;
+  return 0;
+}
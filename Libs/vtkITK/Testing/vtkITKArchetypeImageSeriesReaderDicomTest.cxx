@@ -0,0 +1,224 @@
+#include <vtkITKArchetypeImageSeriesScalarReader.h>
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkSmartPointer.h>
+
+// ITK includes
+#include <itkConfigure.h>
+#include <itkFactoryRegistration.h>
+#include <itkGDCMImageIO.h>
+#include <itkMetaDataObject.h>
+
+// ITKSYS includes
+#include <itksys/SystemTools.hxx>
+
+// STD includes
+#include <cstdio>
+#include <iostream>
+#include <set>
+#include <string>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkITKArchetypeImageSeriesReader> AnalyzeHeaders(const char* archetype)
+{
+  vtkSmartPointer<vtkITKArchetypeImageSeriesReader> reader =
+    vtkSmartPointer<vtkITKArchetypeImageSeriesScalarReader>::New();
+  reader->SetArchetype(archetype);
+  reader->SetOutputScalarTypeToNative();
+  reader->SetDesiredCoordinateOrientationToNative();
+  reader->UpdateInformation();
+  return reader;
+}
+
+//----------------------------------------------------------------------------
+// The tags are read one file at a time with GDCMImageIO, the way the headers
+// were analyzed before they were read in parallel.
+int CompareWithGDCMImageIO(vtkITKArchetypeImageSeriesReader* reader)
+{
+  if (reader->GetNumberOfFileNames() < 2)
+    {
+    std::cout << "ERROR: the series has " << reader->GetNumberOfFileNames() << " files" << std::endl;
+    return 1;
+    }
+  std::set<std::string> seriesInstanceUIDs;
+  std::set<std::string> contentTimes;
+  std::set<std::string> imagePositions;
+  itk::GDCMImageIO::Pointer gdcmIO = itk::GDCMImageIO::New();
+  for (unsigned int f = 0; f < reader->GetNumberOfFileNames(); ++f)
+    {
+    gdcmIO->SetFileName(reader->GetFileName(f));
+    gdcmIO->ReadImageInformation();
+    itk::MetaDataDictionary& dict = gdcmIO->GetMetaDataDictionary();
+    std::string tagValue;
+
+    tagValue.clear(); itk::ExposeMetaData<std::string>(dict, "0020|000e", tagValue);
+    if (tagValue.length() > 0)
+      {
+      seriesInstanceUIDs.insert(tagValue);
+      if (reader->ExistSeriesInstanceUID(tagValue.c_str()) < 0)
+        {
+        std::cout << "ERROR: series instance UID " << tagValue << " of "
+                  << reader->GetFileName(f) << " is missing" << std::endl;
+        return 1;
+        }
+      }
+
+    tagValue.clear(); itk::ExposeMetaData<std::string>(dict, "0008|0033", tagValue);
+    if (tagValue.length() > 0)
+      {
+      contentTimes.insert(tagValue);
+      if (reader->ExistContentTime(tagValue.c_str()) < 0)
+        {
+        std::cout << "ERROR: content time " << tagValue << " of "
+                  << reader->GetFileName(f) << " is missing" << std::endl;
+        return 1;
+        }
+      }
+
+    tagValue.clear(); itk::ExposeMetaData<std::string>(dict, "0020|0032", tagValue);
+    float position[3];
+    if (tagValue.length() > 0
+      && sscanf(tagValue.c_str(), "%f\\%f\\%f", &position[0], &position[1], &position[2]) == 3)
+      {
+      imagePositions.insert(tagValue);
+      if (reader->ExistImagePositionPatient(position) < 0)
+        {
+        std::cout << "ERROR: image position " << tagValue << " of "
+                  << reader->GetFileName(f) << " is missing" << std::endl;
+        return 1;
+        }
+      }
+    }
+
+  if (reader->GetNumberOfSeriesInstanceUIDs() != seriesInstanceUIDs.size()
+    || reader->GetNumberOfContentTime() != contentTimes.size()
+    || reader->GetNumberOfImagePositionPatient() != imagePositions.size())
+    {
+    std::cout << "ERROR: found " << reader->GetNumberOfSeriesInstanceUIDs() << " series, "
+              << reader->GetNumberOfContentTime() << " content times and "
+              << reader->GetNumberOfImagePositionPatient() << " image positions instead of "
+              << seriesInstanceUIDs.size() << ", " << contentTimes.size() << " and "
+              << imagePositions.size() << std::endl;
+    return 1;
+    }
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int CompareReaders(vtkITKArchetypeImageSeriesReader* reader1, vtkITKArchetypeImageSeriesReader* reader2)
+{
+  if (reader1->GetNumberOfFileNames() != reader2->GetNumberOfFileNames()
+    || reader1->GetNumberOfImagePositionPatient() != reader2->GetNumberOfImagePositionPatient())
+    {
+    std::cout << "ERROR: the files are not grouped the same way" << std::endl;
+    return 1;
+    }
+  for (unsigned int f = 0; f < reader1->GetNumberOfFileNames(); ++f)
+    {
+    if (std::string(reader1->GetFileName(f)) != reader2->GetFileName(f))
+      {
+      std::cout << "ERROR: file " << f << " is " << reader2->GetFileName(f)
+                << " instead of " << reader1->GetFileName(f) << std::endl;
+      return 1;
+      }
+    }
+  for (unsigned int k = 0; k < reader1->GetNumberOfImagePositionPatient(); ++k)
+    {
+    if (reader2->ExistImagePositionPatient(reader1->GetNthImagePositionPatient(k)) != static_cast<int>(k))
+      {
+      std::cout << "ERROR: image position " << k << " differs" << std::endl;
+      return 1;
+      }
+    }
+  return 0;
+}
+
+} // end of anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  itk::itkFactoryRegistration();
+
+  if (argc < 3)
+    {
+    std::cout << "ERROR: need to specify a DICOM file of a series and a temporary directory on the command line." << std::endl;
+    return 1;
+    }
+  std::cout << "Analyzing the DICOM series of '" << argv[1] << "'" << std::endl;
+
+  // Make sure that the headers are read by several threads
+  int defaultNumberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  vtkMultiThreader::SetGlobalDefaultNumberOfThreads(4);
+
+  vtkITKArchetypeImageSeriesReader::ClearDICOMHeaderCache();
+  vtkSmartPointer<vtkITKArchetypeImageSeriesReader> reader = AnalyzeHeaders(argv[1]);
+  if (CompareWithGDCMImageIO(reader) != 0)
+    {
+    vtkMultiThreader::SetGlobalDefaultNumberOfThreads(defaultNumberOfThreads);
+    return 1;
+    }
+
+  // Headers are now read from the cache
+  vtkSmartPointer<vtkITKArchetypeImageSeriesReader> cachedReader = AnalyzeHeaders(argv[1]);
+  if (CompareReaders(reader, cachedReader) != 0)
+    {
+    vtkMultiThreader::SetGlobalDefaultNumberOfThreads(defaultNumberOfThreads);
+    return 1;
+    }
+
+  // Headers are kept in the cache file and loaded in the next session
+  std::string cacheFileName = std::string(argv[2]) + "/vtkITKArchetypeImageSeriesReaderDicomTest.cache";
+  itksys::SystemTools::RemoveFile(cacheFileName.c_str());
+  vtkITKArchetypeImageSeriesReader::SetDICOMHeaderCacheFileName(cacheFileName.c_str());
+  AnalyzeHeaders(argv[1]);
+  vtkITKArchetypeImageSeriesReader::SetDICOMHeaderCacheFileName("");
+  if (!itksys::SystemTools::FileExists(cacheFileName.c_str(), true)
+    || vtkITKArchetypeImageSeriesReader::GetNumberOfCachedDICOMHeaders() != 0)
+    {
+    std::cout << "ERROR: the cache file " << cacheFileName << " is not written" << std::endl;
+    vtkMultiThreader::SetGlobalDefaultNumberOfThreads(defaultNumberOfThreads);
+    return 1;
+    }
+  vtkITKArchetypeImageSeriesReader::SetDICOMHeaderCacheFileName(cacheFileName.c_str());
+  if (vtkITKArchetypeImageSeriesReader::GetNumberOfCachedDICOMHeaders()
+    != static_cast<int>(reader->GetNumberOfFileNames()))
+    {
+    std::cout << "ERROR: " << vtkITKArchetypeImageSeriesReader::GetNumberOfCachedDICOMHeaders()
+              << " headers are loaded from the cache file instead of "
+              << reader->GetNumberOfFileNames() << std::endl;
+    vtkMultiThreader::SetGlobalDefaultNumberOfThreads(defaultNumberOfThreads);
+    return 1;
+    }
+  vtkSmartPointer<vtkITKArchetypeImageSeriesReader> persistentCacheReader = AnalyzeHeaders(argv[1]);
+  vtkITKArchetypeImageSeriesReader::ClearDICOMHeaderCache();
+  bool cacheFileRemoved = !itksys::SystemTools::FileExists(cacheFileName.c_str(), true);
+  vtkITKArchetypeImageSeriesReader::SetDICOMHeaderCacheFileName("");
+  if (CompareReaders(reader, persistentCacheReader) != 0)
+    {
+    vtkMultiThreader::SetGlobalDefaultNumberOfThreads(defaultNumberOfThreads);
+    return 1;
+    }
+  if (!cacheFileRemoved)
+    {
+    std::cout << "ERROR: the cache file is not removed when the cache is cleared" << std::endl;
+    vtkMultiThreader::SetGlobalDefaultNumberOfThreads(defaultNumberOfThreads);
+    return 1;
+    }
+
+  // Fewer threads
+  vtkITKArchetypeImageSeriesReader::ClearDICOMHeaderCache();
+  vtkMultiThreader::SetGlobalDefaultNumberOfThreads(1);
+  vtkSmartPointer<vtkITKArchetypeImageSeriesReader> fewerThreadsReader = AnalyzeHeaders(argv[1]);
+  vtkMultiThreader::SetGlobalDefaultNumberOfThreads(defaultNumberOfThreads);
+  if (CompareReaders(reader, fewerThreadsReader) != 0)
+    {
+    return 1;
+    }
+
+  std::cout << "Analyzed " << reader->GetNumberOfFileNames() << " files" << std::endl;
+  return 0;
+}
@@ -5,6 +5,8 @@
 #include <itkImage.h>
 #include <itkArray.h>
 #include <itkImageSource.h>
+#include <itkMutexLockHolder.h>
+#include <itkSimpleFastMutexLock.h>
 #include <iostream>
 #include <fstream>
 #include <itkTimeSeriesDatabaseHelper.h>
@@ -24,6 +26,12 @@ namespace itk
  * The main idea behind TimeSeriesDatabase is to have a representation of a 4 dimensional dataset that
  * is larger than main memory, but may still be accessed in a rapid manner.  Though not strictly
  * ITK conforming, this initial pass is strictly 4 dimensional datasets.
+ *
+ * The database files are memory mapped when possible, and blocks are read
+ * through a cache that may be accessed from several threads at once.  After
+ * an image is generated, the same blocks of the next PrefetchCount images
+ * are prefetched so that playing the series through time does not wait on
+ * the disk.
  */
 template <class TPixel> class TimeSeriesDatabase : public ImageSource<Image<TPixel,3> > {
 public:
@@ -84,9 +92,15 @@ public:
   itkGetMacro ( OutputOrigin, typename OutputImageType::PointType );
   itkGetMacro ( OutputDirection, typename OutputImageType::DirectionType );
 
+  /** Set the number of images following the current image whose blocks
+   * are prefetched after the current image is generated.  The series
+   * wraps around, as a cine does.  0 disables prefetching.  Default is 2.
+   */
+  itkSetMacro ( PrefetchCount, unsigned int );
+  itkGetMacro ( PrefetchCount, unsigned int );
+
   /** Standard method for a ImageSource object */
   virtual void GenerateOutputInformation(void) ITK_OVERRIDE;
-  virtual void GenerateData(void) ITK_OVERRIDE;
 
   /** A convience method for reading a voxel's time course
    * Subsequent calls to voxels in the immediate region of this will be
@@ -101,11 +115,24 @@ public:
    */
   float GetCacheSizeInMiB ();
 
+  /** Number of block reads that were served from, or had to be
+   * loaded into, the cache since the last ResetCacheStatistics call.
+   */
+  unsigned long GetCacheHits() const;
+  unsigned long GetCacheMisses() const;
+  void ResetCacheStatistics();
 
 protected:
   TimeSeriesDatabase();
   ~TimeSeriesDatabase();
   virtual void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
+
+  typedef typename OutputImageType::RegionType OutputImageRegionType;
+  virtual void BeforeThreadedGenerateData() ITK_OVERRIDE;
+  virtual void ThreadedGenerateData ( const OutputImageRegionType& outputRegionForThread,
+                                      ThreadIdType threadId ) ITK_OVERRIDE;
+  virtual void AfterThreadedGenerateData() ITK_OVERRIDE;
+
   Array<unsigned int> m_Dimensions;
   Array<unsigned int> m_BlocksPerImage;
 
@@ -114,6 +141,7 @@ protected:
   typename OutputImageType::PointType m_OutputOrigin;
   typename OutputImageType::DirectionType m_OutputDirection;
   typedef itk::TimeSeriesDatabaseHelper::counted_ptr<std::fstream> StreamPtr;
+  typedef itk::TimeSeriesDatabaseHelper::counted_ptr<TimeSeriesDatabaseHelper::mapped_file> MappedFilePtr;
 
   static std::streampos CalculatePosition ( unsigned long index, unsigned long BlocksPerFile );
 
@@ -126,14 +154,20 @@ protected:
   bool CalculateIntersection ( Size<3> BlockIndex, typename OutputImageType::RegionType RequestedRegion,
                                typename OutputImageType::RegionType& BlockRegion,
                                typename OutputImageType::RegionType& ImageRegion );
+  /// First block and number of blocks along each axis covering Region
+  static void CalculateBlockRange ( const typename OutputImageType::RegionType& Region,
+                                    Size<3>& BlockStart, Size<3>& BlockCount );
   bool IsOpen() const;
 
   /// How many pixels are in the last block?
   Array<unsigned int> m_PixelRemainder;
   std::string m_Filename;
   unsigned int m_CurrentImage;
+  unsigned int m_PrefetchCount;
 
   std::vector<StreamPtr> m_DatabaseFiles;
+  /// Mappings of the database files, closed if a file could not be mapped
+  std::vector<MappedFilePtr> m_MappedFiles;
   std::vector<std::string> m_DatabaseFileNames;
   unsigned long m_BlocksPerFile;
 
@@ -143,7 +177,17 @@ protected:
     TPixel data[TimeSeriesBlockSize*TimeSeriesBlockSize*TimeSeriesBlockSize];
   };
   TimeSeriesDatabaseHelper::LRUCache<unsigned long, CacheBlock> m_Cache;
-  CacheBlock* GetCacheBlock ( unsigned long index );
+  /// Guards m_Cache, the statistics and the (not thread safe) streams
+  mutable SimpleFastMutexLock m_CacheLock;
+  unsigned long m_CacheHits;
+  unsigned long m_CacheMisses;
+
+  /// Copy the block at index into Block.  Safe to call from several threads.
+  void ReadBlock ( unsigned long index, CacheBlock& Block );
+  /// Return the mapped block at index, or 0 if it is not mapped
+  const TPixel* GetMappedBlock ( unsigned long index ) const;
+  /// Ask the operating system to read ahead the block at index
+  void PrefetchBlock ( unsigned long index ) const;
 };
 
 } // end namespace itk
@@ -9,6 +9,7 @@
 #include <itkImageFileReader.h>
 #include <itksys/SystemTools.hxx>
 #include "itkArchetypeSeriesFileNames.h"
+#include <cstring>
 #include <fstream>
 #include <vector>
 
@@ -65,7 +66,12 @@ void TimeSeriesDatabase<TPixel>::Disconnect ()
     this->m_DatabaseFiles[idx]->close();
     }
   this->m_DatabaseFiles.clear();
+  this->m_MappedFiles.clear();
   this->m_DatabaseFileNames.clear();
+  // Blocks of another database must not be returned
+  this->m_CacheLock.Lock();
+  this->m_Cache.clear();
+  this->m_CacheLock.Unlock();
 }
 
 template <class TPixel>
@@ -121,6 +127,7 @@ void TimeSeriesDatabase<TPixel>::Connect ( const char* filename )
   // Read the "Filenames:" line
   o >> dummy;
   this->m_DatabaseFiles.clear();
+  this->m_MappedFiles.clear();
   this->m_DatabaseFileNames.clear();
   // Read and open the files
   for ( int idx = 0; idx < NumberOfFiles; idx++ )
@@ -130,6 +137,10 @@ void TimeSeriesDatabase<TPixel>::Connect ( const char* filename )
     // std::cout << "Reading file " << idx << " " << Filename << std::endl;
     this->m_DatabaseFileNames.push_back ( Filename );
     this->m_DatabaseFiles.push_back ( StreamPtr ( new std::fstream ( Filename.c_str(), ::std::ios::in | ::std::ios::binary ) ) );
+    // Blocks of unmapped files are read from the stream
+    MappedFilePtr mapped ( new TimeSeriesDatabaseHelper::mapped_file );
+    mapped->open ( Filename.c_str() );
+    this->m_MappedFiles.push_back ( mapped );
     }
   /*
   std::cout << "ImageSize: " << m_OutputRegion.GetSize() << endl;
@@ -184,20 +195,65 @@ template <class TPixel>
 
 
 template <class TPixel>
-typename TimeSeriesDatabase<TPixel>::CacheBlock* TimeSeriesDatabase<TPixel>::GetCacheBlock ( unsigned long index )
+const TPixel* TimeSeriesDatabase<TPixel>::GetMappedBlock ( unsigned long index ) const
 {
+  unsigned int FileIdx = CalculateFileIndex ( index, this->m_BlocksPerFile );
+  if ( FileIdx >= this->m_MappedFiles.size() || !this->m_MappedFiles[FileIdx]->is_open() )
+    {
+    return 0;
+    }
+  const TimeSeriesDatabaseHelper::mapped_file* mapped = this->m_MappedFiles[FileIdx].get();
+  size_t position = static_cast<size_t> ( ( index % this->m_BlocksPerFile ) * sizeof ( TPixel ) * TimeSeriesVolumeBlockSize );
+  if ( position + sizeof ( CacheBlock ) > mapped->size() )
+    {
+    // Truncated file
+    return 0;
+    }
+  return reinterpret_cast<const TPixel*> ( mapped->data() + position );
+}
+
+template <class TPixel>
+void TimeSeriesDatabase<TPixel>::PrefetchBlock ( unsigned long index ) const
+{
+  unsigned int FileIdx = CalculateFileIndex ( index, this->m_BlocksPerFile );
+  if ( FileIdx < this->m_MappedFiles.size() )
+    {
+    this->m_MappedFiles[FileIdx]->will_need (
+      static_cast<size_t> ( ( index % this->m_BlocksPerFile ) * sizeof ( TPixel ) * TimeSeriesVolumeBlockSize ),
+      sizeof ( CacheBlock ) );
+    }
+}
+
+template <class TPixel>
+void TimeSeriesDatabase<TPixel>::ReadBlock ( unsigned long index, CacheBlock& Block )
+{
+  // The cache may evict a block as soon as the lock is released, so the
+  // block is copied out instead of returning a pointer into the cache.
+  MutexLockHolder<SimpleFastMutexLock> holder ( this->m_CacheLock );
   CacheBlock* Buffer = this->m_Cache.find ( index );
-  if ( Buffer == 0 ) {
-    // Fill it in
-    CacheBlock B;
+  if ( Buffer != 0 )
+    {
+    this->m_CacheHits++;
+    Block = *Buffer;
+    return;
+    }
+  this->m_CacheMisses++;
+  const TPixel* mapped = this->GetMappedBlock ( index );
+  if ( mapped != 0 )
+    {
+    // Page faults are resolved while other threads use the cache
+    this->m_CacheLock.Unlock();
+    memcpy ( Block.data, mapped, sizeof ( Block.data ) );
+    this->m_CacheLock.Lock();
+    }
+  else
+    {
     int FileIdx = this->CalculateFileIndex ( index );
-
+    this->m_DatabaseFiles[FileIdx]->clear();
     this->m_DatabaseFiles[FileIdx]->seekg ( this->CalculatePosition ( index, this->m_BlocksPerFile ) );
-    this->m_DatabaseFiles[FileIdx]->read ( reinterpret_cast<char*> ( B.data ), TimeSeriesVolumeBlockSize * sizeof ( TPixel ) );
-    this->m_Cache.insert ( index, B );
-    Buffer = this->m_Cache.find ( index );
-  }
-  return Buffer;
+    this->m_DatabaseFiles[FileIdx]->read ( reinterpret_cast<char*> ( Block.data ), TimeSeriesVolumeBlockSize * sizeof ( TPixel ) );
+    }
+  this->m_Cache.insert ( index, Block );
 }
 
 
@@ -209,17 +265,39 @@ void TimeSeriesDatabase<TPixel>::GetVoxelTimeSeries ( typename OutputImageType::
   Size<3> CurrentBlock;
   Size<3> Offset;
   for ( int i = 0; i < 3; i++ ) {
-    if ( idx[i] < 0 || idx[i] > this->m_OutputRegion.Size[i] ) {
-      throw 1;
+    if ( idx[i] < 0 || idx[i] >= static_cast<IndexValueType> ( this->m_Dimensions[i] ) ) {
+      itkExceptionMacro ( "TimeSeriesDatabase::GetVoxelTimeSeries: index " << idx << " is outside of the image" );
     }
-    CurrentBlock[i] = reinterpret_cast<unsigned long> ( idx[i] / (double)TimeSeriesBlockSize );
+    CurrentBlock[i] = idx[i] / TimeSeriesBlockSize;
     Offset[i] = idx[i] % TimeSeriesBlockSize;
   }
+  if ( !this->IsOpen() )
+  {
+    itkExceptionMacro ( "TimeSeriesDatabase::GetVoxelTimeSeries: not open for reading" );
+  }
   unsigned long offset = Offset[0] + Offset[1] * TimeSeriesBlockSize + Offset[2] * TimeSeriesBlockSizeP2;
-  array = ArrayType ( this->m_Dimensions[3] );
-  for ( int volume = 0; volume < this->m_Dimensions[3]; volume++ ) {
-    CacheBlock* cache = this->GetCacheBlock ( CurrentBlock, volume );
-    array[volume] = cache->data[offset];
+  unsigned int NumberOfVolumes = this->m_Dimensions[3];
+  array = ArrayType ( NumberOfVolumes );
+  // The blocks of a voxel are spread along the files: request them all
+  // before reading them one after another.
+  for ( unsigned int volume = 0; volume < NumberOfVolumes; volume++ ) {
+    this->PrefetchBlock ( this->CalculateIndex ( CurrentBlock, volume ) );
+  }
+  CacheBlock Block;
+  for ( unsigned int volume = 0; volume < NumberOfVolumes; volume++ ) {
+    this->ReadBlock ( this->CalculateIndex ( CurrentBlock, volume ), Block );
+    array[volume] = Block.data[offset];
+  }
+}
+
+
+template <class TPixel>
+void TimeSeriesDatabase<TPixel>::CalculateBlockRange ( const typename OutputImageType::RegionType& Region,
+                                                       Size<3>& BlockStart, Size<3>& BlockCount )
+{
+  for ( unsigned int i = 0; i < 3; i++ ) {
+    BlockStart[i] = (int) floor ( Region.GetIndex(i) / (double)TimeSeriesBlockSize );
+    BlockCount[i] = (int) TSD_MAX ( 1.0, ceil ( (Region.GetIndex(i)+Region.GetSize(i)) / (double)TimeSeriesBlockSize ) - BlockStart[i] );
   }
 }
 
@@ -235,62 +313,40 @@ void TimeSeriesDatabase<TPixel>::GenerateOutputInformation ( )
 }
 
 template <class TPixel>
-void TimeSeriesDatabase<TPixel>::GenerateData()
+void TimeSeriesDatabase<TPixel>::BeforeThreadedGenerateData()
 {
-  typename OutputImageType::Pointer output = this->GetOutput();
-  typename OutputImageType::RegionType Region;
-  itkDebugMacro ( << "TimeSeriesDatabase::GenerateData()  Allocating" );
-  Region = output->GetRequestedRegion();
-  output->SetBufferedRegion ( Region );
-  output->Allocate();
-
   if ( !this->IsOpen() )
   {
-    itkGenericExceptionMacro ( "TimeSeriesDatabase::GenerateOutputInformation: not open for reading" );
+    itkGenericExceptionMacro ( "TimeSeriesDatabase::GenerateData: not open for reading" );
   }
+}
 
-  Size<3> BlockStart, BlockCount;
-  for ( unsigned int i = 0; i < 3; i++ ) {
-    BlockStart[i] = (int) floor ( Region.GetIndex(i) / (double)TimeSeriesBlockSize );
-    BlockCount[i] = (int) TSD_MAX ( 1.0, ceil ( (Region.GetIndex(i)+Region.GetSize(i)) / (double)TimeSeriesBlockSize ) - BlockStart[i] );
-  }
+template <class TPixel>
+void TimeSeriesDatabase<TPixel>::ThreadedGenerateData ( const OutputImageRegionType& Region,
+                                                        ThreadIdType itkNotUsed(threadId) )
+{
+  typename OutputImageType::Pointer output = this->GetOutput();
 
-  bool print = Region.GetIndex(0) == 0 && Region.GetIndex(1) == 0 && Region.GetIndex(2) == 80;
-  print = false;
-  if ( print )
-    {
-    std::cout << "GenerateData for " << output->GetRequestedRegion() << std::endl;
-    output->Print ( std::cout );
-    }
+  Size<3> BlockStart, BlockCount;
+  this->CalculateBlockRange ( Region, BlockStart, BlockCount );
 
   Size<3> CurrentBlock;
-  // Now, read our data, caching as we go, in future, make this thread safe
-  Size<3> BlockSize = { {TimeSeriesBlockSize, TimeSeriesBlockSize, TimeSeriesBlockSize }};
-  ImageRegion<3> BlockRegion;
-  BlockRegion.SetSize ( BlockSize );
+  // Now, read our data, caching as we go.  Blocks at the boundary between
+  // the regions of two threads are read twice, the second time from the cache.
+  CacheBlock Buffer;
   // Fetch only the blocks we need
   for ( CurrentBlock[2] = BlockStart[2]; CurrentBlock[2] < BlockStart[2] + BlockCount[2]; CurrentBlock[2]++ ) {
     for ( CurrentBlock[1] = BlockStart[1]; CurrentBlock[1] < BlockStart[1] + BlockCount[1]; CurrentBlock[1]++ ) {
       for ( CurrentBlock[0] = BlockStart[0]; CurrentBlock[0] < BlockStart[0] + BlockCount[0]; CurrentBlock[0]++ ) {
         typename OutputImageType::RegionType BR, IR;
-        if ( print ) {  std::cout << "For Block Index: " << CurrentBlock << std::endl; }
         unsigned long index = this->CalculateIndex ( CurrentBlock, this->m_CurrentImage );
-        CacheBlock* Buffer = this->GetCacheBlock ( index );
+        this->ReadBlock ( index, Buffer );
         if ( this->CalculateIntersection ( CurrentBlock, Region, BR, IR ) ) {
           // Just iterate over whole block
           // Good we can use an iterator!
-          if ( print ) {
-            std::cout << "The easy way! " << std::endl;
-            std::cout << "Block Region: " << BR;
-            std::cout << "Image Region: " << IR;
-          }
-          Index<3> BlockIndex = {{ static_cast<IndexValueType>( CurrentBlock[0] * TimeSeriesBlockSize),
-                                   static_cast<IndexValueType>( CurrentBlock[1] * TimeSeriesBlockSize),
-                                   static_cast<IndexValueType>( CurrentBlock[2] * TimeSeriesBlockSize) }};
-          BlockRegion.SetIndex ( BlockIndex );
           ImageRegionIterator<OutputImageType> it ( output, IR );
           it.GoToBegin();
-          TPixel* ptr = Buffer->data;
+          TPixel* ptr = Buffer.data;
           while ( !it.IsAtEnd() ) {
             it.Set ( *ptr );
             ++it;
@@ -300,13 +356,6 @@ void TimeSeriesDatabase<TPixel>::GenerateData()
           // Now we do it the hard way...
           Index<3> ImageIndex;
           Size<3> Count = BR.GetSize();
-          if ( print ) {
-            std::cout << "The Hard way" << std::endl;
-            std::cout << "Count: " << Count << std::endl;
-            std::cout << "Block Region: " << BR;
-            std::cout << "Image Region: " << IR;
-            std::cout << "First voxel: " << Buffer->data[0] << std::endl;
-          }
           unsigned int bx, by, bz, x, y, z;
           for ( z = 0; z < Count[2]; z++ ) {
             ImageIndex[2] = IR.GetIndex(2) + z;
@@ -317,15 +366,7 @@ void TimeSeriesDatabase<TPixel>::GenerateData()
               for ( x = 0; x < Count[0]; x++ ) {
                 ImageIndex[0] = IR.GetIndex(0) + x;
                 bx = BR.GetIndex(0) + x;
-                /*
-                int BufferIndex = bx + TimeSeriesBlockSize*by + TimeSeriesBlockSize*TimeSeriesBlockSize*bz;
-                if ( ImageIndex[0] == 45 && ImageIndex[1] == 0 && ImageIndex[2] == 0 ) {
-                  std::cout << "Index: " << ImageIndex << " Volume Value: " << output->GetPixel ( ImageIndex ) << " buffer: " << Buffer->data[BufferIndex] << std::endl;
-                std::cout << "Index: " << ImageIndex << " From " << BufferIndex << " ( " << bx << ", " << by << ", " << bz << " )\n" << std::endl;
-                }
-                */
-
-                output->SetPixel ( ImageIndex, Buffer->data[bx + TimeSeriesBlockSize*by + TimeSeriesBlockSize*TimeSeriesBlockSize*bz] );
+                output->SetPixel ( ImageIndex, Buffer.data[bx + TimeSeriesBlockSize*by + TimeSeriesBlockSize*TimeSeriesBlockSize*bz] );
                 }
               }
             }
@@ -337,6 +378,32 @@ void TimeSeriesDatabase<TPixel>::GenerateData()
   return;
 }
 
+template <class TPixel>
+void TimeSeriesDatabase<TPixel>::AfterThreadedGenerateData()
+{
+  // Prefetch the same region in the next images, the pages are read in
+  // the background while the current image is processed or displayed.
+  unsigned int NumberOfVolumes = this->m_Dimensions[3];
+  if ( this->m_PrefetchCount == 0 || NumberOfVolumes < 2 )
+    {
+    return;
+    }
+  unsigned int PrefetchCount = TSD_MIN ( this->m_PrefetchCount, NumberOfVolumes - 1 );
+  Size<3> BlockStart, BlockCount;
+  this->CalculateBlockRange ( this->GetOutput()->GetRequestedRegion(), BlockStart, BlockCount );
+  Size<3> CurrentBlock;
+  for ( unsigned int i = 1; i <= PrefetchCount; i++ ) {
+    unsigned int image = ( this->m_CurrentImage + i ) % NumberOfVolumes;
+    for ( CurrentBlock[2] = BlockStart[2]; CurrentBlock[2] < BlockStart[2] + BlockCount[2]; CurrentBlock[2]++ ) {
+      for ( CurrentBlock[1] = BlockStart[1]; CurrentBlock[1] < BlockStart[1] + BlockCount[1]; CurrentBlock[1]++ ) {
+        for ( CurrentBlock[0] = BlockStart[0]; CurrentBlock[0] < BlockStart[0] + BlockCount[0]; CurrentBlock[0]++ ) {
+          this->PrefetchBlock ( this->CalculateIndex ( CurrentBlock, image ) );
+        }
+      }
+    }
+  }
+}
+
 
 template <class TPixel>
 void TimeSeriesDatabase<TPixel>::CreateFromFileArchetype ( const char* TSDFilename, const char* archetype )
@@ -560,6 +627,7 @@ void TimeSeriesDatabase<TPixel>::CreateFromFileArchetype ( const char* TSDFilena
 template <class TPixel>
 float TimeSeriesDatabase<TPixel>::GetCacheSizeInMiB()
 {
+  MutexLockHolder<SimpleFastMutexLock> holder ( this->m_CacheLock );
   unsigned cachesize = this->m_Cache.get_maxsize();
   return (float) cachesize * sizeof ( TPixel ) * TimeSeriesVolumeBlockSize / ( 1024*1024.);
 }
@@ -569,14 +637,42 @@ void TimeSeriesDatabase<TPixel>::SetCacheSizeInMiB ( float sz )
 {
   // How many blocks is this?
   double BlockSizeInMiB = sizeof ( TPixel ) * TimeSeriesVolumeBlockSize / ( 1024*1024.);
-  unsigned long int blocks = (unsigned long int) ceil ( sz * BlockSizeInMiB );
+  unsigned long int blocks = (unsigned long int) ceil ( sz / BlockSizeInMiB );
+  MutexLockHolder<SimpleFastMutexLock> holder ( this->m_CacheLock );
   this->m_Cache.set_maxsize ( blocks );
 }
 
+template <class TPixel>
+unsigned long TimeSeriesDatabase<TPixel>::GetCacheHits() const
+{
+  MutexLockHolder<SimpleFastMutexLock> holder ( this->m_CacheLock );
+  return this->m_CacheHits;
+}
+
+template <class TPixel>
+unsigned long TimeSeriesDatabase<TPixel>::GetCacheMisses() const
+{
+  MutexLockHolder<SimpleFastMutexLock> holder ( this->m_CacheLock );
+  return this->m_CacheMisses;
+}
+
+template <class TPixel>
+void TimeSeriesDatabase<TPixel>::ResetCacheStatistics()
+{
+  MutexLockHolder<SimpleFastMutexLock> holder ( this->m_CacheLock );
+  this->m_CacheHits = 0;
+  this->m_CacheMisses = 0;
+}
+
 
 
 template <class TPixel>
 TimeSeriesDatabase<TPixel>::TimeSeriesDatabase () : m_Cache ( 1024 ){
+  this->m_CurrentImage = 0;
+  this->m_PrefetchCount = 2;
+  this->m_BlocksPerFile = 1;
+  this->m_CacheHits = 0;
+  this->m_CacheMisses = 0;
   this->m_Dimensions.SetSize ( 4 );
   this->m_BlocksPerImage.SetSize ( 4 );
 }
@@ -613,7 +709,10 @@ TimeSeriesDatabase<TPixel>
     os << indent << "Database is closed." << "\n";
   }
 
-  this->m_Cache.statistics ( os );
+  os << indent << "CurrentImage: " << this->m_CurrentImage << "\n";
+  os << indent << "PrefetchCount: " << this->m_PrefetchCount << "\n";
+  os << indent << "CacheHits: " << this->GetCacheHits() << "\n";
+  os << indent << "CacheMisses: " << this->GetCacheMisses() << "\n";
 }
 
 
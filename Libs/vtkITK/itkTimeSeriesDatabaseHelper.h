@@ -6,6 +6,16 @@
 #include <string>
 #include <cstdarg>
 #include <cassert>
+#include <cstddef>
+
+#ifdef _WIN32
+#include "itkWindows.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace itk {
   namespace TimeSeriesDatabaseHelper {
@@ -85,6 +95,123 @@ namespace itk {
         }
       };
 
+    /// Read-only memory mapping of a whole file.
+    ///
+    /// The mapped bytes may be read concurrently from any thread; pages
+    /// are loaded by the operating system on first access and stay in
+    /// its page cache, so no file position needs to be shared between
+    /// readers. open() returns false if the file cannot be mapped (e.g.
+    /// not enough address space), callers then fall back to streams.
+    class mapped_file
+      {
+      public:
+        mapped_file() : itsData(0), itsSize(0)
+#ifdef _WIN32
+          , itsFile(INVALID_HANDLE_VALUE), itsMapping(0)
+#endif
+          {}
+        ~mapped_file()
+          {close();}
+
+        bool open(const char* filename)
+        {
+          close();
+#ifdef _WIN32
+          itsFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0,
+                                OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, 0);
+          LARGE_INTEGER size;
+          if (itsFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(itsFile, &size)
+              || size.QuadPart == 0
+              || static_cast<unsigned long long>(size.QuadPart) > static_cast<size_t>(-1))
+            {
+              close();
+              return false;
+            }
+          itsMapping = CreateFileMappingA(itsFile, 0, PAGE_READONLY, 0, 0, 0);
+          void* data = itsMapping ? MapViewOfFile(itsMapping, FILE_MAP_READ, 0, 0, 0) : 0;
+          if (!data)
+            {
+              close();
+              return false;
+            }
+          itsSize = static_cast<size_t>(size.QuadPart);
+#else
+          int fd = ::open(filename, O_RDONLY);
+          if (fd < 0)
+            {
+              return false;
+            }
+          struct stat st;
+          if (fstat(fd, &st) != 0 || st.st_size <= 0
+              || static_cast<unsigned long long>(st.st_size) > static_cast<size_t>(-1))
+            {
+              ::close(fd);
+              return false;
+            }
+          // The mapping keeps its own reference to the file
+          void* data = mmap(0, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+          ::close(fd);
+          if (data == MAP_FAILED)
+            {
+              return false;
+            }
+          itsSize = static_cast<size_t>(st.st_size);
+#endif
+          itsData = static_cast<const char*>(data);
+          return true;
+        }
+
+        void close()
+        {
+#ifdef _WIN32
+          if (itsData) UnmapViewOfFile(itsData);
+          if (itsMapping) CloseHandle(itsMapping);
+          if (itsFile != INVALID_HANDLE_VALUE) CloseHandle(itsFile);
+          itsFile = INVALID_HANDLE_VALUE;
+          itsMapping = 0;
+#else
+          if (itsData) munmap(const_cast<char*>(itsData), itsSize);
+#endif
+          itsData = 0;
+          itsSize = 0;
+        }
+
+        bool is_open() const  {return itsData != 0;}
+        const char* data() const  {return itsData;}
+        size_t size() const  {return itsSize;}
+
+        /// Hint that [offset, offset + length) is going to be read soon.
+        /// The pages are read ahead asynchronously, the call does not block.
+        void will_need(size_t offset, size_t length) const
+        {
+#ifndef _WIN32
+          if (!itsData || offset >= itsSize)
+            {
+              return;
+            }
+          // madvise needs a page aligned address
+          static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+          size_t start = offset - offset % page;
+          size_t end = offset + length < itsSize ? offset + length : itsSize;
+          madvise(const_cast<char*>(itsData) + start, end - start, MADV_WILLNEED);
+#else
+          (void)offset;
+          (void)length;
+#endif
+        }
+
+      private:
+        mapped_file(const mapped_file&);  /// Not implemented.
+        void operator=(const mapped_file&);  /// Not implemented.
+
+        const char* itsData;
+        size_t itsSize;
+#ifdef _WIN32
+        HANDLE itsFile;
+        HANDLE itsMapping;
+#endif
+      };
+
     /// LRU Cache
 
     using namespace std;
@@ -128,8 +255,12 @@ namespace itk {
       {
       }
 
+      /// Set the maximal size of the cache.  LRU elements are
+      /// removed until the cache fits.
+      ///
       void set_maxsize ( unsigned maxsize_ ) {
         maxsize = maxsize_;
+        trim();
       }
 
       unsigned get_maxsize () {
@@ -193,16 +324,9 @@ namespace itk {
             table.insert(make_pair(key, cv));
 
             /// If the maximal size was exceeded, clean up
-            /// LRU element.
+            /// LRU elements.
             //
-            if (lru_list.size() > maxsize)
-              {
-                key_type lru_key = lru_list.back();
-                table.erase(lru_key);
-                lru_list.pop_back();
-
-                IF_DEBUG(stats.removed++);
-              }
+            trim();
           }
       }
 
@@ -334,6 +458,21 @@ namespace itk {
       ///
       map<key_type, cached_value> table;
 
+      /// Removes LRU elements until the cache is not larger
+      /// than its maximal size.
+      ///
+      void trim()
+      {
+        while (lru_list.size() > maxsize)
+          {
+            key_type lru_key = lru_list.back();
+            table.erase(lru_key);
+            lru_list.pop_back();
+
+            IF_DEBUG(stats.removed++);
+          }
+      }
+
 #ifndef NDEBUG
 
       struct cache_statistics
@@ -16,11 +16,14 @@
 #include "vtkITKArchetypeImageSeriesReader.h"
 
 // VTK includes
+#include <vtkCriticalSection.h>
 #include <vtkImageData.h>
 #include <vtkMath.h>
 #include <vtkMatrix4x4.h>
 #include <vtkInformation.h>
 #include <vtkInformationVector.h>
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
 #include <vtkObjectFactory.h>
 #include <vtkStreamingDemandDrivenPipeline.h>
 
@@ -30,7 +33,19 @@
 #include <itkMetaDataObject.h>
 #include <itkTimeProbe.h>
 
+// GDCM includes
+#include <gdcmReader.h>
+#include <gdcmStringFilter.h>
+#include <gdcmTag.h>
+
+// ITKSYS includes
+#include <itksys/SystemTools.hxx>
+
 // STD includes
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <set>
 #include <vector>
 
 #include "itkArchetypeSeriesFileNames.h"
@@ -935,6 +950,317 @@ void vtkITKArchetypeImageSeriesReader::GroupFiles ( int idxSeriesInstanceUID,
   return;
 }
 
+//----------------------------------------------------------------------------
+namespace
+{
+
+/// Tags used to group the files of a DICOM series
+enum
+{
+  SeriesInstanceUIDTag = 0,
+  ContentTimeTag,
+  TriggerTimeTag,
+  EchoNumbersTag,
+  DiffusionGradientOrientationTag,
+  SliceLocationTag,
+  ImageOrientationPatientTag,
+  ImagePositionPatientTag,
+  NumberOfAnalyzedTags
+};
+
+const gdcm::Tag AnalyzedTags[NumberOfAnalyzedTags] =
+{
+  gdcm::Tag(0x0020, 0x000e),
+  gdcm::Tag(0x0008, 0x0033),
+  gdcm::Tag(0x0018, 0x1060),
+  gdcm::Tag(0x0018, 0x0086),
+  gdcm::Tag(0x0010, 0x9089),
+  gdcm::Tag(0x0020, 0x1041),
+  gdcm::Tag(0x0020, 0x0037),
+  gdcm::Tag(0x0020, 0x0032)
+};
+
+/// Values of the analyzed tags of a file, empty if the tag is missing
+struct DICOMHeader
+{
+  std::string Values[NumberOfAnalyzedTags];
+};
+
+/// Headers of the files already analyzed, reused as long as the files are
+/// not modified. Shared by all the readers of the process.
+struct CachedDICOMHeader
+{
+  long int ModifiedTime;
+  unsigned long FileLength;
+  DICOMHeader Header;
+};
+typedef std::map<std::string, CachedDICOMHeader> DICOMHeaderCacheType;
+DICOMHeaderCacheType DICOMHeaderCache;
+vtkSimpleCriticalSection DICOMHeaderCacheLock;
+/// File where the cache is kept between sessions, empty if the cache is
+/// only kept in memory
+std::string DICOMHeaderCacheFileName;
+/// True if the cache has changed since it was read from or written to the file
+bool DICOMHeaderCacheModified = false;
+
+/// The cache is cleared when it grows larger than this number of files
+const size_t MaximumNumberOfCachedDICOMHeaders = 200000;
+
+/// First line of the cache file, changed if the analyzed tags change
+const char DICOMHeaderCacheFileSignature[] = "vtkITKDICOMHeaderCache 1";
+
+//----------------------------------------------------------------------------
+/// Load the cache file into the cache. Each entry is the file name, then
+/// the modification time and size, then one line per analyzed tag.
+/// DICOMHeaderCacheLock must be locked.
+void ReadDICOMHeaderCacheFile()
+{
+  std::ifstream stream(DICOMHeaderCacheFileName.c_str(), std::ios::binary);
+  std::string line;
+  if (!stream || !std::getline(stream, line) || line != DICOMHeaderCacheFileSignature)
+    {
+    return;
+    }
+  std::string fileName;
+  while (std::getline(stream, fileName) && std::getline(stream, line))
+    {
+    CachedDICOMHeader cachedHeader;
+    if (sscanf(line.c_str(), "%ld %lu", &cachedHeader.ModifiedTime, &cachedHeader.FileLength) != 2)
+      {
+      break;
+      }
+    int tag = 0;
+    for (; tag < NumberOfAnalyzedTags && std::getline(stream, cachedHeader.Header.Values[tag]); ++tag)
+      {
+      }
+    if (tag < NumberOfAnalyzedTags)
+      {
+      break;
+      }
+    DICOMHeaderCache[fileName] = cachedHeader;
+    }
+}
+
+//----------------------------------------------------------------------------
+/// Replace the cache file by the content of the cache. The file is written
+/// under a temporary name first so that it is never left incomplete.
+/// DICOMHeaderCacheLock must be locked.
+void WriteDICOMHeaderCacheFile()
+{
+  std::string temporaryFileName = DICOMHeaderCacheFileName + ".tmp";
+  std::ofstream stream(temporaryFileName.c_str(), std::ios::binary | std::ios::trunc);
+  if (!stream)
+    {
+    return;
+    }
+  stream << DICOMHeaderCacheFileSignature << "\n";
+  for (DICOMHeaderCacheType::const_iterator it = DICOMHeaderCache.begin();
+       it != DICOMHeaderCache.end(); ++it)
+    {
+    // Entries are separated by new lines, which never appear in the
+    // analyzed tags, but may in a file name
+    bool valid = (it->first.find('\n') == std::string::npos);
+    for (int tag = 0; tag < NumberOfAnalyzedTags && valid; ++tag)
+      {
+      valid = (it->second.Header.Values[tag].find('\n') == std::string::npos);
+      }
+    if (!valid)
+      {
+      continue;
+      }
+    stream << it->first << "\n"
+           << it->second.ModifiedTime << " " << it->second.FileLength << "\n";
+    for (int tag = 0; tag < NumberOfAnalyzedTags; ++tag)
+      {
+      stream << it->second.Header.Values[tag] << "\n";
+      }
+    }
+  stream.close();
+  if (stream.fail())
+    {
+    itksys::SystemTools::RemoveFile(temporaryFileName.c_str());
+    return;
+    }
+  // rename() does not replace an existing file on Windows
+  if (rename(temporaryFileName.c_str(), DICOMHeaderCacheFileName.c_str()) != 0)
+    {
+    itksys::SystemTools::RemoveFile(DICOMHeaderCacheFileName.c_str());
+    if (rename(temporaryFileName.c_str(), DICOMHeaderCacheFileName.c_str()) != 0)
+      {
+      itksys::SystemTools::RemoveFile(temporaryFileName.c_str());
+      return;
+      }
+    }
+  DICOMHeaderCacheModified = false;
+}
+
+//----------------------------------------------------------------------------
+/// Write the cache file if new headers have been analyzed
+void SaveDICOMHeaderCache()
+{
+  DICOMHeaderCacheLock.Lock();
+  if (DICOMHeaderCacheModified && !DICOMHeaderCacheFileName.empty())
+    {
+    WriteDICOMHeaderCacheFile();
+    }
+  DICOMHeaderCacheLock.Unlock();
+}
+
+//----------------------------------------------------------------------------
+void ReadDICOMHeader(const std::string& fileName, DICOMHeader& header)
+{
+  long int modifiedTime = itksys::SystemTools::ModifiedTime(fileName.c_str());
+  unsigned long fileLength = itksys::SystemTools::FileLength(fileName.c_str());
+
+  DICOMHeaderCacheLock.Lock();
+  DICOMHeaderCacheType::const_iterator it = DICOMHeaderCache.find(fileName);
+  bool cached = (it != DICOMHeaderCache.end()
+    && it->second.ModifiedTime == modifiedTime
+    && it->second.FileLength == fileLength);
+  if (cached)
+    {
+    header = it->second.Header;
+    }
+  DICOMHeaderCacheLock.Unlock();
+  if (cached)
+    {
+    return;
+    }
+
+  // Parsing stops after the last analyzed tag, pixel data is never read
+  std::set<gdcm::Tag> tags(AnalyzedTags, AnalyzedTags + NumberOfAnalyzedTags);
+  gdcm::Reader reader;
+  reader.SetFileName(fileName.c_str());
+  if (!reader.ReadSelectedTags(tags))
+    {
+    return;
+    }
+  gdcm::StringFilter stringFilter;
+  stringFilter.SetFile(reader.GetFile());
+  const gdcm::DataSet& dataSet = reader.GetFile().GetDataSet();
+  for (int i = 0; i < NumberOfAnalyzedTags; ++i)
+    {
+    if (dataSet.FindDataElement(AnalyzedTags[i]))
+      {
+      header.Values[i] = stringFilter.ToString(AnalyzedTags[i]);
+      }
+    }
+
+  DICOMHeaderCacheLock.Lock();
+  if (DICOMHeaderCache.size() >= MaximumNumberOfCachedDICOMHeaders)
+    {
+    DICOMHeaderCache.clear();
+    }
+  CachedDICOMHeader& cachedHeader = DICOMHeaderCache[fileName];
+  cachedHeader.ModifiedTime = modifiedTime;
+  cachedHeader.FileLength = fileLength;
+  cachedHeader.Header = header;
+  DICOMHeaderCacheModified = true;
+  DICOMHeaderCacheLock.Unlock();
+}
+
+//----------------------------------------------------------------------------
+struct ReadDICOMHeadersThreadData
+{
+  const std::vector<std::string>* FileNames;
+  std::vector<DICOMHeader>* Headers;
+  size_t NextFileIndex;
+  vtkSimpleCriticalSection Lock;
+};
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE ReadDICOMHeadersThreadFunction(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  ReadDICOMHeadersThreadData* threadData =
+    static_cast<ReadDICOMHeadersThreadData*>(threadInfo->UserData);
+  while (true)
+    {
+    // Take the next file that has not been read yet
+    threadData->Lock.Lock();
+    size_t fileIndex = threadData->NextFileIndex++;
+    threadData->Lock.Unlock();
+    if (fileIndex >= threadData->FileNames->size())
+      {
+      break;
+      }
+    ReadDICOMHeader((*threadData->FileNames)[fileIndex], (*threadData->Headers)[fileIndex]);
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+void ReadDICOMHeaders(const std::vector<std::string>& fileNames, std::vector<DICOMHeader>& headers)
+{
+  ReadDICOMHeadersThreadData threadData;
+  threadData.FileNames = &fileNames;
+  threadData.Headers = &headers;
+  threadData.NextFileIndex = 0;
+
+  // Reading headers is mostly waiting for the disk or the network, use
+  // more threads than cores
+  int numberOfThreads = std::min(2 * vtkMultiThreader::GetGlobalDefaultNumberOfThreads(),
+                                 static_cast<int>(fileNames.size()));
+  if (numberOfThreads <= 1)
+    {
+    // Avoid the overhead of starting a thread
+    vtkMultiThreader::ThreadInfo threadInfo;
+    threadInfo.ThreadID = 0;
+    threadInfo.NumberOfThreads = 1;
+    threadInfo.UserData = &threadData;
+    ReadDICOMHeadersThreadFunction(&threadInfo);
+    return;
+    }
+  vtkNew<vtkMultiThreader> threader;
+  threader->SetNumberOfThreads(numberOfThreads);
+  threader->SetSingleMethod(ReadDICOMHeadersThreadFunction, &threadData);
+  threader->SingleMethodExecute();
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+void vtkITKArchetypeImageSeriesReader::ClearDICOMHeaderCache()
+{
+  DICOMHeaderCacheLock.Lock();
+  DICOMHeaderCache.clear();
+  DICOMHeaderCacheModified = false;
+  if (!DICOMHeaderCacheFileName.empty())
+    {
+    itksys::SystemTools::RemoveFile(DICOMHeaderCacheFileName.c_str());
+    }
+  DICOMHeaderCacheLock.Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkITKArchetypeImageSeriesReader::SetDICOMHeaderCacheFileName(const char* fileName)
+{
+  DICOMHeaderCacheLock.Lock();
+  DICOMHeaderCacheFileName = (fileName ? fileName : "");
+  DICOMHeaderCache.clear();
+  DICOMHeaderCacheModified = false;
+  if (!DICOMHeaderCacheFileName.empty())
+    {
+    ReadDICOMHeaderCacheFile();
+    }
+  DICOMHeaderCacheLock.Unlock();
+}
+
+//----------------------------------------------------------------------------
+const char* vtkITKArchetypeImageSeriesReader::GetDICOMHeaderCacheFileName()
+{
+  return DICOMHeaderCacheFileName.c_str();
+}
+
+//----------------------------------------------------------------------------
+int vtkITKArchetypeImageSeriesReader::GetNumberOfCachedDICOMHeaders()
+{
+  DICOMHeaderCacheLock.Lock();
+  int numberOfCachedHeaders = static_cast<int>(DICOMHeaderCache.size());
+  DICOMHeaderCacheLock.Unlock();
+  return numberOfCachedHeaders;
+}
+
 //----------------------------------------------------------------------------
 void vtkITKArchetypeImageSeriesReader::AnalyzeDicomHeaders()
 {
@@ -1040,17 +1366,18 @@ void vtkITKArchetypeImageSeriesReader::AnalyzeDicomHeaders()
     return;
     }
 
-  // if Archetype is a Dicom File
-  gdcmIO->SetFileName( this->Archetype );
+  // if Archetype is a Dicom File, read the tags of all the files in
+  // parallel, then index their values in the order of the files
+  std::vector<DICOMHeader> headers( nFiles );
+  ReadDICOMHeaders( this->AllFileNames, headers );
+  SaveDICOMHeaderCache();
   for (int f = 0; f < nFiles; f++)
   {
-    gdcmIO->SetFileName( this->AllFileNames[f] );
-    gdcmIO->ReadImageInformation();
-    itk::MetaDataDictionary &dict = gdcmIO->GetMetaDataDictionary();
+    const DICOMHeader& header = headers[f];
     std::string tagValue;
 
     // series instance UID
-    tagValue.clear(); itk::ExposeMetaData<std::string>( dict, "0020|000e", tagValue );
+    tagValue = header.Values[SeriesInstanceUIDTag];
     if ( tagValue.length() > 0 )
     {
       int idx = InsertSeriesInstanceUIDs( tagValue.c_str() );
@@ -1062,7 +1389,7 @@ void vtkITKArchetypeImageSeriesReader::AnalyzeDicomHeaders()
     }
 
     // content time
-    tagValue.clear(); itk::ExposeMetaData<std::string>( dict, "0008|0033", tagValue );
+    tagValue = header.Values[ContentTimeTag];
     if ( tagValue.length() > 0 )
     {
       int idx = InsertContentTime( tagValue.c_str() );
@@ -1074,7 +1401,7 @@ void vtkITKArchetypeImageSeriesReader::AnalyzeDicomHeaders()
     }
 
     // trigger time
-    tagValue.clear(); itk::ExposeMetaData<std::string>( dict, "0018|1060", tagValue );
+    tagValue = header.Values[TriggerTimeTag];
     if ( tagValue.length() > 0 )
     {
       int idx = InsertTriggerTime( tagValue.c_str() );
@@ -1086,7 +1413,7 @@ void vtkITKArchetypeImageSeriesReader::AnalyzeDicomHeaders()
     }
 
     // echo numbers
-    tagValue.clear(); itk::ExposeMetaData<std::string>( dict, "0018|0086", tagValue );
+    tagValue = header.Values[EchoNumbersTag];
     if ( tagValue.length() > 0 )
     {
       int idx = InsertEchoNumbers( tagValue.c_str() );
@@ -1098,7 +1425,7 @@ void vtkITKArchetypeImageSeriesReader::AnalyzeDicomHeaders()
     }
 
     // diffision gradient orientation
-    tagValue.clear(); itk::ExposeMetaData<std::string>( dict, "0010|9089", tagValue );
+    tagValue = header.Values[DiffusionGradientOrientationTag];
     if ( tagValue.length() > 0 )
     {
       float a[3];
@@ -1112,7 +1439,7 @@ void vtkITKArchetypeImageSeriesReader::AnalyzeDicomHeaders()
     }
 
     // slice location
-    tagValue.clear(); itk::ExposeMetaData<std::string>( dict, "0020|1041", tagValue );
+    tagValue = header.Values[SliceLocationTag];
     if ( tagValue.length() > 0 )
     {
       float a;
@@ -1126,7 +1453,7 @@ void vtkITKArchetypeImageSeriesReader::AnalyzeDicomHeaders()
     }
 
     // image orientation patient
-    tagValue.clear(); itk::ExposeMetaData<std::string>( dict, "0020|0037", tagValue );
+    tagValue = header.Values[ImageOrientationPatientTag];
     if ( tagValue.length() > 0 )
     {
       float a[6];
@@ -1139,7 +1466,7 @@ void vtkITKArchetypeImageSeriesReader::AnalyzeDicomHeaders()
       this->IndexImageOrientationPatient[f] = -1;
     }
     // image position patient
-    tagValue.clear(); itk::ExposeMetaData<std::string>( dict, "0020|0032", tagValue );
+    tagValue = header.Values[ImagePositionPatientTag];
     if( tagValue.length() > 0 )
     {
         float a[3];
@@ -105,6 +105,26 @@ public:
   ///  is the given file name a NRRD file?
   virtual int CanReadFile(const char* filename);
 
+  ///
+  /// Forget the DICOM headers read by all the readers. The tags used to
+  /// group DICOM files are cached by file name and reused until the file
+  /// is modified, so that loading the same study again is fast.
+  /// The cache file is removed too.
+  static void ClearDICOMHeaderCache();
+
+  ///
+  /// File where the DICOM header cache is kept between sessions. Setting
+  /// it replaces the cached headers by the content of the file, and the
+  /// file is rewritten after new headers are analyzed. Entries are reused
+  /// only if the modification time and size of the DICOM file match.
+  /// Empty by default: the cache is only kept in memory.
+  static void SetDICOMHeaderCacheFileName(const char* fileName);
+  static const char* GetDICOMHeaderCacheFileName();
+
+  ///
+  /// Number of DICOM files whose headers are cached
+  static int GetNumberOfCachedDICOMHeaders();
+
   ///
   /// Set the orientation of the output image
   void SetDesiredCoordinateOrientationToAxial ()
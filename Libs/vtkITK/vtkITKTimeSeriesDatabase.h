@@ -43,7 +43,13 @@ class VTK_ITK_EXPORT vtkITKTimeSeriesDatabase : public vtkImageAlgorithm
 public:
   /// vtkStandardNewMacro ( vtkITKTimeSeriesDatabase );
   static vtkITKTimeSeriesDatabase *New();
-  void PrintSelf(ostream& os, vtkIndent indent){ Superclass::PrintSelf(os, indent);};
+  void PrintSelf(ostream& os, vtkIndent indent)
+  {
+    Superclass::PrintSelf(os, indent);
+    os << indent << "PrefetchCount: " << this->m_Filter->GetPrefetchCount() << "\n";
+    os << indent << "CacheHits: " << this->m_Filter->GetCacheHits() << "\n";
+    os << indent << "CacheMisses: " << this->m_Filter->GetCacheMisses() << "\n";
+  };
   vtkTypeMacro(vtkITKTimeSeriesDatabase,vtkImageAlgorithm);
 
 public:
@@ -66,6 +72,26 @@ public:
   int GetNumberOfVolumes()
   { DelegateITKOutputMacro ( GetNumberOfVolumes ); };
 
+  /// Get/Set the number of images after the current image to prefetch
+  void SetPrefetchCount ( unsigned int value )
+  { DelegateITKInputMacro ( SetPrefetchCount, value ); };
+  unsigned int GetPrefetchCount()
+  { DelegateITKOutputMacro ( GetPrefetchCount ); };
+
+  /// Get/Set the size of the block cache in MiB
+  void SetCacheSizeInMiB ( float value )
+  { DelegateITKInputMacro ( SetCacheSizeInMiB, value ); };
+  float GetCacheSizeInMiB()
+  { DelegateITKOutputMacro ( GetCacheSizeInMiB ); };
+
+  /// Cache hit/miss statistics of the block reads
+  unsigned long GetCacheHits()
+  { DelegateITKOutputMacro ( GetCacheHits ); };
+  unsigned long GetCacheMisses()
+  { DelegateITKOutputMacro ( GetCacheMisses ); };
+  void ResetCacheStatistics()
+  { this->m_Filter->ResetCacheStatistics(); };
+
 protected:
   vtkITKTimeSeriesDatabase()
     {
@@ -0,0 +1,435 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkFeatureEdges.h>
+#include <vtkNew.h>
+#include <vtkMath.h>
+#include <vtkPointData.h>
+#include <vtkPointLocator.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+// vtkAddon includes
+#include "vtkAddonTestingMacros.h"
+
+// SegmentationCore includes
+#include "vtkBinaryLabelmapToClosedSurfaceConversionRule.h"
+#include "vtkOrientedImageData.h"
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const int LABELMAP_SIZE = 100;
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkOrientedImageData> CreateSphereLabelmap(int segmentIndex)
+{
+  vtkSmartPointer<vtkOrientedImageData> labelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+  labelmap->SetExtent(0, LABELMAP_SIZE - 1, 0, LABELMAP_SIZE - 1, 0, LABELMAP_SIZE - 1);
+  labelmap->SetSpacing(0.5, 0.5, 1.0);
+  labelmap->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  // Small spheres at different positions, the last one touches the labelmap boundary
+  int center[3] = { 10 + segmentIndex * 10, 50, 50 };
+  int radius = 5 + segmentIndex % 3;
+  for (int z = 0; z < LABELMAP_SIZE; ++z)
+    {
+    for (int y = 0; y < LABELMAP_SIZE; ++y)
+      {
+      for (int x = 0; x < LABELMAP_SIZE; ++x)
+        {
+        int dx = x - center[0];
+        int dy = y - center[1];
+        int dz = z - center[2];
+        *static_cast<unsigned char*>(labelmap->GetScalarPointer(x, y, z)) =
+          (dx * dx + dy * dy + dz * dz <= radius * radius ? 1 : 0);
+        }
+      }
+    }
+  return labelmap;
+}
+
+//----------------------------------------------------------------------------
+vtkIdType GetNumberOfBoundaryEdges(vtkPolyData* surface)
+{
+  vtkNew<vtkFeatureEdges> featureEdges;
+  featureEdges->SetInputData(surface);
+  featureEdges->BoundaryEdgesOn();
+  featureEdges->FeatureEdgesOff();
+  featureEdges->ManifoldEdgesOff();
+  featureEdges->NonManifoldEdgesOff();
+  featureEdges->Update();
+  return featureEdges->GetOutput()->GetNumberOfCells();
+}
+
+//----------------------------------------------------------------------------
+/// Compare the time of updating the surface of a large sphere after painting small boxes
+/// on it with the time of converting the whole labelmap
+int BenchmarkIncrementalUpdate(int size)
+{
+  vtkSmartPointer<vtkOrientedImageData> labelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+  labelmap->SetExtent(0, size - 1, 0, size - 1, 0, size - 1);
+  labelmap->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  int radius = size * 2 / 5;
+  int center = size / 2;
+  for (int z = 0; z < size; ++z)
+    {
+    for (int y = 0; y < size; ++y)
+      {
+      for (int x = 0; x < size; ++x)
+        {
+        int dx = x - center;
+        int dy = y - center;
+        int dz = z - center;
+        *static_cast<unsigned char*>(labelmap->GetScalarPointer(x, y, z)) =
+          (dx * dx + dy * dy + dz * dz <= radius * radius ? 1 : 0);
+        }
+      }
+    }
+
+  vtkNew<vtkBinaryLabelmapToClosedSurfaceConversionRule> rule;
+  vtkNew<vtkPolyData> incrementalSurface;
+  int noModification[6] = { 0, -1, 0, -1, 0, -1 };
+  if (!rule->ConvertModifiedExtent(labelmap, 0, noModification, incrementalSurface.GetPointer()))
+    {
+    std::cerr << __LINE__ << ": Failed to create surface from bricks!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const int numberOfStrokes = 10;
+  vtkNew<vtkTimerLog> timer;
+  double incrementalTime = 0.0;
+  double fullTime = 0.0;
+  vtkNew<vtkPolyData> fullSurface;
+  for (int stroke = 0; stroke < numberOfStrokes; ++stroke)
+    {
+    // Paint a small box on the surface of the sphere
+    int paintedExtent[6] = { 0, -1, 0, -1, 0, -1 };
+    paintedExtent[0] = center + radius - 3;
+    paintedExtent[1] = center + radius + 3;
+    paintedExtent[2] = center - 30 + stroke * 6;
+    paintedExtent[3] = paintedExtent[2] + 6;
+    paintedExtent[4] = center - 3;
+    paintedExtent[5] = center + 3;
+    for (int z = paintedExtent[4]; z <= paintedExtent[5]; ++z)
+      {
+      for (int y = paintedExtent[2]; y <= paintedExtent[3]; ++y)
+        {
+        for (int x = paintedExtent[0]; x <= paintedExtent[1]; ++x)
+          {
+          *static_cast<unsigned char*>(labelmap->GetScalarPointer(x, y, z)) = 1;
+          }
+        }
+      }
+    labelmap->Modified();
+
+    timer->StartTimer();
+    if (!rule->ConvertModifiedExtent(labelmap, 0, paintedExtent, incrementalSurface.GetPointer()))
+      {
+      std::cerr << __LINE__ << ": Failed to update modified region!" << std::endl;
+      return EXIT_FAILURE;
+      }
+    timer->StopTimer();
+    incrementalTime += timer->GetElapsedTime();
+
+    timer->StartTimer();
+    if (!rule->Convert(labelmap, fullSurface.GetPointer()))
+      {
+      std::cerr << __LINE__ << ": Failed to convert labelmap!" << std::endl;
+      return EXIT_FAILURE;
+      }
+    timer->StopTimer();
+    fullTime += timer->GetElapsedTime();
+    }
+  if (incrementalSurface->GetNumberOfPolys() != fullSurface->GetNumberOfPolys())
+    {
+    std::cerr << __LINE__ << ": Incremental update result has " << incrementalSurface->GetNumberOfPolys()
+      << " polygons instead of " << fullSurface->GetNumberOfPolys() << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  REPORT_MEASUREMENT("vtkBinaryLabelmapToClosedSurfaceConversionRule-StrokeIncrementalUpdate-" << size,
+    incrementalTime / numberOfStrokes);
+  REPORT_MEASUREMENT("vtkBinaryLabelmapToClosedSurfaceConversionRule-StrokeFullConversion-" << size,
+    fullTime / numberOfStrokes);
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkBinaryLabelmapToClosedSurfaceConversionRuleTest1(int argc, char* argv[])
+{
+  // The conversion times are only reported on request.
+  // Usage: vtkBinaryLabelmapToClosedSurfaceConversionRuleTest1 --benchmark [size]
+  bool benchmark = vtkAddonTestingUtilities::IsBenchmarkRequested(argc, argv);
+  const int numberOfSegments = 10;
+
+  std::vector<vtkSmartPointer<vtkOrientedImageData> > labelmaps;
+  std::vector<vtkSmartPointer<vtkPolyData> > sequentialSurfaces;
+  std::vector<vtkSmartPointer<vtkPolyData> > parallelSurfaces;
+  std::vector<vtkDataObject*> sources;
+  std::vector<vtkDataObject*> targets;
+  std::vector<int> labelValues;
+  for (int i = 0; i < numberOfSegments; ++i)
+    {
+    labelmaps.push_back(CreateSphereLabelmap(i));
+    sequentialSurfaces.push_back(vtkSmartPointer<vtkPolyData>::New());
+    parallelSurfaces.push_back(vtkSmartPointer<vtkPolyData>::New());
+    sources.push_back(labelmaps[i]);
+    targets.push_back(parallelSurfaces[i]);
+    labelValues.push_back(0);
+    }
+  // Empty labelmap
+  vtkSmartPointer<vtkOrientedImageData> emptyLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+  emptyLabelmap->SetExtent(0, 9, 0, 9, 0, 9);
+  emptyLabelmap->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  emptyLabelmap->GetPointData()->GetScalars()->FillComponent(0, 0);
+  vtkNew<vtkPolyData> emptySurface;
+  sources.push_back(emptyLabelmap);
+  targets.push_back(emptySurface.GetPointer());
+  labelValues.push_back(0);
+
+  vtkNew<vtkBinaryLabelmapToClosedSurfaceConversionRule> rule;
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  for (int i = 0; i < numberOfSegments; ++i)
+    {
+    if (!rule->Convert(labelmaps[i], sequentialSurfaces[i]))
+      {
+      std::cerr << __LINE__ << ": Failed to convert segment " << i << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  timer->StopTimer();
+  if (benchmark)
+    {
+    vtkAddonTestingUtilities::ReportMeasurement("vtkBinaryLabelmapToClosedSurfaceConversionRule-SequentialConversion",
+      timer->GetElapsedTime());
+    }
+
+  rule->SetNumberOfThreads(4);
+  rule->ResetStageTimes();
+  timer->StartTimer();
+  if (!rule->ConvertMultiple(sources, labelValues, targets))
+    {
+    std::cerr << __LINE__ << ": ConvertMultiple failed!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  timer->StopTimer();
+  if (benchmark)
+    {
+    vtkAddonTestingUtilities::ReportMeasurement("vtkBinaryLabelmapToClosedSurfaceConversionRule-ParallelConversion",
+      timer->GetElapsedTime());
+    for (int stage = 0; stage < vtkBinaryLabelmapToClosedSurfaceConversionRule::StageLast; ++stage)
+      {
+      std::cout << "  " << vtkBinaryLabelmapToClosedSurfaceConversionRule::GetStageName(stage) << ": "
+        << rule->GetStageTime(stage) << "s" << std::endl;
+      }
+    }
+  if (rule->GetStageTime(vtkBinaryLabelmapToClosedSurfaceConversionRule::StageMarchingCubes) <= 0.0)
+    {
+    std::cerr << __LINE__ << ": Marching cubes time is not measured!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Parallel conversion must give the same result as sequential conversion
+  for (int i = 0; i < numberOfSegments; ++i)
+    {
+    if (sequentialSurfaces[i]->GetNumberOfPoints() == 0
+      || parallelSurfaces[i]->GetNumberOfPoints() != sequentialSurfaces[i]->GetNumberOfPoints()
+      || parallelSurfaces[i]->GetNumberOfPolys() != sequentialSurfaces[i]->GetNumberOfPolys())
+      {
+      std::cerr << __LINE__ << ": Surface of segment " << i << " is different in parallel conversion: "
+        << parallelSurfaces[i]->GetNumberOfPoints() << " points instead of "
+        << sequentialSurfaces[i]->GetNumberOfPoints() << std::endl;
+      return EXIT_FAILURE;
+      }
+    double sequentialBounds[6] = { 0.0, -1.0, 0.0, -1.0, 0.0, -1.0 };
+    double parallelBounds[6] = { 0.0, -1.0, 0.0, -1.0, 0.0, -1.0 };
+    sequentialSurfaces[i]->GetBounds(sequentialBounds);
+    parallelSurfaces[i]->GetBounds(parallelBounds);
+    for (int j = 0; j < 6; ++j)
+      {
+      if (fabs(sequentialBounds[j] - parallelBounds[j]) > 1e-6)
+        {
+        std::cerr << __LINE__ << ": Bounds of segment " << i << " are different in parallel conversion" << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    }
+  if (emptySurface->GetNumberOfPoints() != 0)
+    {
+    std::cerr << __LINE__ << ": Empty labelmap resulted in non-empty surface!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Incremental update of the modified region gives the same result as meshing all bricks
+
+  // Two spheres far apart: the post-processed surface of the first one is reused
+  // when the box is painted on the second one
+  vtkSmartPointer<vtkOrientedImageData> editedLabelmap = CreateSphereLabelmap(0);
+  vtkSmartPointer<vtkOrientedImageData> secondSphereLabelmap = CreateSphereLabelmap(8);
+  for (int z = 0; z < LABELMAP_SIZE; ++z)
+    {
+    for (int y = 0; y < LABELMAP_SIZE; ++y)
+      {
+      for (int x = 0; x < LABELMAP_SIZE; ++x)
+        {
+        *static_cast<unsigned char*>(editedLabelmap->GetScalarPointer(x, y, z)) |=
+          *static_cast<unsigned char*>(secondSphereLabelmap->GetScalarPointer(x, y, z));
+        }
+      }
+    }
+  vtkNew<vtkPolyData> incrementalSurface;
+  rule->SetBrickSize(8);
+  int noModification[6] = { 0, -1, 0, -1, 0, -1 };
+  if (!rule->ConvertModifiedExtent(editedLabelmap, 0, noModification, incrementalSurface.GetPointer())
+    || incrementalSurface->GetNumberOfPoints() == 0)
+    {
+    std::cerr << __LINE__ << ": Failed to create surface from bricks!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Paint a box that touches the second sphere
+  int modifiedExtent[6] = { 78, 88, 45, 55, 45, 55 };
+  for (int z = modifiedExtent[4]; z <= modifiedExtent[5]; ++z)
+    {
+    for (int y = modifiedExtent[2]; y <= modifiedExtent[3]; ++y)
+      {
+      for (int x = modifiedExtent[0]; x <= modifiedExtent[1]; ++x)
+        {
+        *static_cast<unsigned char*>(editedLabelmap->GetScalarPointer(x, y, z)) = 1;
+        }
+      }
+    }
+  editedLabelmap->Modified();
+  timer->StartTimer();
+  if (!rule->ConvertModifiedExtent(editedLabelmap, 0, modifiedExtent, incrementalSurface.GetPointer()))
+    {
+    std::cerr << __LINE__ << ": Failed to update modified region!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  timer->StopTimer();
+  if (benchmark)
+    {
+    vtkAddonTestingUtilities::ReportMeasurement("vtkBinaryLabelmapToClosedSurfaceConversionRule-IncrementalUpdate",
+      timer->GetElapsedTime());
+    }
+
+  vtkNew<vtkPolyData> allBricksSurface;
+  if (!rule->ConvertModifiedExtent(editedLabelmap, 0, noModification, allBricksSurface.GetPointer()))
+    {
+    std::cerr << __LINE__ << ": Failed to create surface from bricks!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (incrementalSurface->GetNumberOfPoints() != allBricksSurface->GetNumberOfPoints()
+    || incrementalSurface->GetNumberOfPolys() != allBricksSurface->GetNumberOfPolys())
+    {
+    std::cerr << __LINE__ << ": Incremental update result is different: " << incrementalSurface->GetNumberOfPolys()
+      << " polygons instead of " << allBricksSurface->GetNumberOfPolys() << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Surface assembled from the bricks is closed and it is the same as the surface of the whole labelmap
+  vtkNew<vtkPolyData> fullSurface;
+  if (!rule->Convert(editedLabelmap, fullSurface.GetPointer()))
+    {
+    std::cerr << __LINE__ << ": Failed to convert edited labelmap!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  vtkIdType numberOfBoundaryEdges = GetNumberOfBoundaryEdges(incrementalSurface.GetPointer());
+  if (numberOfBoundaryEdges != 0)
+    {
+    std::cerr << __LINE__ << ": Surface assembled from bricks has " << numberOfBoundaryEdges << " boundary edges" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (incrementalSurface->GetNumberOfPoints() != fullSurface->GetNumberOfPoints()
+    || incrementalSurface->GetNumberOfPolys() != fullSurface->GetNumberOfPolys())
+    {
+    std::cerr << __LINE__ << ": Surface assembled from bricks has " << incrementalSurface->GetNumberOfPoints() << " points and "
+      << incrementalSurface->GetNumberOfPolys() << " polygons instead of " << fullSurface->GetNumberOfPoints() << " and "
+      << fullSurface->GetNumberOfPolys() << std::endl;
+    return EXIT_FAILURE;
+    }
+  double incrementalBounds[6] = { 0.0, -1.0, 0.0, -1.0, 0.0, -1.0 };
+  double fullBounds[6] = { 0.0, -1.0, 0.0, -1.0, 0.0, -1.0 };
+  incrementalSurface->GetBounds(incrementalBounds);
+  fullSurface->GetBounds(fullBounds);
+  for (int i = 0; i < 6; ++i)
+    {
+    // Points are merged in a different order, smoothing results may differ by rounding errors
+    if (fabs(incrementalBounds[i] - fullBounds[i]) > 1e-3)
+      {
+      std::cerr << __LINE__ << ": Bounds of the surface assembled from bricks are different: "
+        << incrementalBounds[i] << " instead of " << fullBounds[i] << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // Normals of the surface assembled from bricks point in the same direction as the normals
+  // of the whole surface (polygon orientation is made consistent over the whole surface)
+  vtkDataArray* incrementalNormals = incrementalSurface->GetPointData()->GetNormals();
+  vtkDataArray* fullNormals = fullSurface->GetPointData()->GetNormals();
+  if (!incrementalNormals || !fullNormals)
+    {
+    std::cerr << __LINE__ << ": Surface normals are not computed!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  vtkNew<vtkPointLocator> pointLocator;
+  pointLocator->SetDataSet(fullSurface.GetPointer());
+  pointLocator->BuildLocator();
+  vtkIdType numberOfFlippedNormals = 0;
+  for (vtkIdType pointId = 0; pointId < incrementalSurface->GetNumberOfPoints(); ++pointId)
+    {
+    vtkIdType fullPointId = pointLocator->FindClosestPoint(incrementalSurface->GetPoint(pointId));
+    double incrementalNormal[3] = { 0.0, 0.0, 0.0 };
+    double fullNormal[3] = { 0.0, 0.0, 0.0 };
+    incrementalNormals->GetTuple(pointId, incrementalNormal);
+    fullNormals->GetTuple(fullPointId, fullNormal);
+    if (vtkMath::Dot(incrementalNormal, fullNormal) <= 0.0)
+      {
+      ++numberOfFlippedNormals;
+      }
+    }
+  if (numberOfFlippedNormals > 0)
+    {
+    std::cerr << __LINE__ << ": Surface assembled from bricks has " << numberOfFlippedNormals
+      << " normals that are flipped compared to the whole surface" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Time of the update after a paint stroke on a large segment
+  if (benchmark)
+    {
+    int size = (argc > 2 ? atoi(argv[2]) : 256);
+    if (BenchmarkIncrementalUpdate(size) != EXIT_SUCCESS)
+      {
+      return EXIT_FAILURE;
+      }
+    }
+
+  std::cout << "Binary labelmap to closed surface conversion test passed." << std::endl;
+  return EXIT_SUCCESS;
+}
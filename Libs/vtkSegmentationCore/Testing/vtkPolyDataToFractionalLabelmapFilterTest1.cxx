@@ -0,0 +1,192 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VTK includes
+#include <vtkAppendPolyData.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkRegularPolygonSource.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+#include <vtkTimerLog.h>
+
+// vtkAddon includes
+#include "vtkAddonTestingMacros.h"
+
+// SegmentationCore includes
+#include "vtkOrientedImageData.h"
+#include "vtkPolyDataToFractionalLabelmapFilter.h"
+
+// STD includes
+#include <cmath>
+#include <cstring>
+#include <string>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkOrientedImageData> ConvertToFractionalLabelmap(
+  vtkPolyData* closedSurface, vtkMatrix4x4* imageToWorldMatrix, int extent[6], int numberOfThreads,
+  bool benchmark)
+{
+  vtkNew<vtkPolyDataToFractionalLabelmapFilter> filter;
+  filter->SetInputData(closedSurface);
+  filter->SetOutputImageToWorldMatrix(imageToWorldMatrix);
+  filter->SetOutputWholeExtent(extent);
+  filter->SetNumberOfOffsets(6);
+  filter->SetNumberOfThreads(numberOfThreads);
+
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  filter->Update();
+  timer->StopTimer();
+  if (benchmark)
+    {
+    REPORT_MEASUREMENT("vtkPolyDataToFractionalLabelmapFilter-"
+      << (numberOfThreads == 1 ? "SingleThread" : "MultiThread"), timer->GetElapsedTime());
+    }
+
+  vtkSmartPointer<vtkOrientedImageData> fractionalLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+  fractionalLabelmap->DeepCopy(filter->GetOutput());
+  return fractionalLabelmap;
+}
+
+//----------------------------------------------------------------------------
+bool HaveSameScalars(vtkOrientedImageData* labelmap1, vtkOrientedImageData* labelmap2)
+{
+  int* extent = labelmap1->GetExtent();
+  vtkIdType numberOfVoxels = static_cast<vtkIdType>(extent[1] - extent[0] + 1)
+    * (extent[3] - extent[2] + 1) * (extent[5] - extent[4] + 1);
+  return memcmp(labelmap1->GetScalarPointer(), labelmap2->GetScalarPointer(),
+    numberOfVoxels * labelmap1->GetScalarSize()) == 0;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkPolyDataToFractionalLabelmapFilterTest1(int argc, char* argv[])
+{
+  // The single and multi-threaded rasterization times are only reported on request.
+  // Usage: vtkPolyDataToFractionalLabelmapFilterTest1 --benchmark
+  bool benchmark = vtkAddonTestingUtilities::IsBenchmarkRequested(argc, argv);
+
+  // Finely tessellated sphere
+  const double radius = 20.0;
+  vtkNew<vtkSphereSource> sphere;
+  sphere->SetRadius(radius);
+  sphere->SetCenter(1.3, -2.1, 0.7);
+  sphere->SetThetaResolution(300);
+  sphere->SetPhiResolution(300);
+  sphere->Update();
+
+  // Anisotropic voxels
+  const double spacing[3] = { 0.5, 0.5, 1.0 };
+  vtkNew<vtkMatrix4x4> imageToWorldMatrix;
+  imageToWorldMatrix->SetElement(0, 0, spacing[0]);
+  imageToWorldMatrix->SetElement(1, 1, spacing[1]);
+  imageToWorldMatrix->SetElement(2, 2, spacing[2]);
+  imageToWorldMatrix->SetElement(0, 3, -25.0);
+  imageToWorldMatrix->SetElement(1, 3, -25.0);
+  imageToWorldMatrix->SetElement(2, 3, -25.0);
+  int extent[6] = { 0, 99, 0, 99, 0, 49 };
+
+  vtkSmartPointer<vtkOrientedImageData> singleThreadLabelmap =
+    ConvertToFractionalLabelmap(sphere->GetOutput(), imageToWorldMatrix.GetPointer(), extent, 1, benchmark);
+  vtkSmartPointer<vtkOrientedImageData> multiThreadLabelmap =
+    ConvertToFractionalLabelmap(sphere->GetOutput(), imageToWorldMatrix.GetPointer(), extent, 4, benchmark);
+
+  int* outputExtent = singleThreadLabelmap->GetExtent();
+  for (int i = 0; i < 6; ++i)
+    {
+    if (outputExtent[i] != extent[i])
+      {
+      std::cerr << "Unexpected output extent" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // Results must not depend on the number of threads
+  vtkIdType numberOfVoxels = static_cast<vtkIdType>(extent[1] + 1) * (extent[3] + 1) * (extent[5] + 1);
+  if (!HaveSameScalars(singleThreadLabelmap, multiThreadLabelmap))
+    {
+    std::cerr << "Single and multi-threaded results differ" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Voxel at the center is inside, voxel at the corner is outside
+  FRACTIONAL_DATA_TYPE centerValue = *static_cast<FRACTIONAL_DATA_TYPE*>(singleThreadLabelmap->GetScalarPointer(53, 46, 26));
+  FRACTIONAL_DATA_TYPE cornerValue = *static_cast<FRACTIONAL_DATA_TYPE*>(singleThreadLabelmap->GetScalarPointer(0, 0, 0));
+  if (centerValue != FRACTIONAL_MAX || cornerValue != FRACTIONAL_MIN)
+    {
+    std::cerr << "Unexpected voxel values: center " << double(centerValue) << " corner " << double(cornerValue) << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Sum of fractions is the volume of the sphere
+  const FRACTIONAL_DATA_TYPE* voxelPointer = static_cast<FRACTIONAL_DATA_TYPE*>(singleThreadLabelmap->GetScalarPointer());
+  double volume = 0.0;
+  for (vtkIdType i = 0; i < numberOfVoxels; ++i)
+    {
+    volume += (double(voxelPointer[i]) - FRACTIONAL_MIN) / (FRACTIONAL_MAX - FRACTIONAL_MIN);
+    }
+  volume *= spacing[0] * spacing[1] * spacing[2];
+  double expectedVolume = 4.0 / 3.0 * vtkMath::Pi() * radius * radius * radius;
+  if (fabs(volume - expectedVolume) > 0.01 * expectedVolume)
+    {
+    std::cerr << "Volume of fractional labelmap is " << volume << ", expected " << expectedVolume << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Planar contours of the same sphere, one per slice, are selected instead of cut
+  vtkNew<vtkAppendPolyData> contours;
+  for (int k = extent[4]; k <= extent[5]; ++k)
+    {
+    double z = -25.0 + k * spacing[2];
+    double dz = z - sphere->GetCenter()[2];
+    if (fabs(dz) >= radius)
+      {
+      continue;
+      }
+    vtkNew<vtkRegularPolygonSource> contour;
+    contour->SetCenter(sphere->GetCenter()[0], sphere->GetCenter()[1], z);
+    contour->SetRadius(sqrt(radius * radius - dz * dz));
+    contour->SetNumberOfSides(100);
+    contour->GeneratePolygonOff();
+    contour->GeneratePolylineOn();
+    contours->AddInputConnection(contour->GetOutputPort());
+    }
+  contours->Update();
+
+  vtkSmartPointer<vtkOrientedImageData> singleThreadContourLabelmap =
+    ConvertToFractionalLabelmap(contours->GetOutput(), imageToWorldMatrix.GetPointer(), extent, 1, benchmark);
+  vtkSmartPointer<vtkOrientedImageData> multiThreadContourLabelmap =
+    ConvertToFractionalLabelmap(contours->GetOutput(), imageToWorldMatrix.GetPointer(), extent, 4, benchmark);
+  if (!HaveSameScalars(singleThreadContourLabelmap, multiThreadContourLabelmap))
+    {
+    std::cerr << "Single and multi-threaded results of contours differ" << std::endl;
+    return EXIT_FAILURE;
+    }
+  FRACTIONAL_DATA_TYPE contourCenterValue =
+    *static_cast<FRACTIONAL_DATA_TYPE*>(singleThreadContourLabelmap->GetScalarPointer(53, 46, 26));
+  if (contourCenterValue == FRACTIONAL_MIN)
+    {
+    std::cerr << "Voxel at the center of the contours is outside" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
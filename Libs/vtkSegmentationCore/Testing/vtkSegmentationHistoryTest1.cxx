@@ -0,0 +1,241 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// vtkAddon includes
+#include "vtkAddonTestingUtilities.h"
+
+// SegmentationCore includes
+#include "vtkOrientedImageData.h"
+#include "vtkSegment.h"
+#include "vtkSegmentation.h"
+#include "vtkSegmentationConverter.h"
+#include "vtkSegmentationHistory.h"
+
+// STD includes
+#include <string>
+
+namespace
+{
+
+const int LABELMAP_SIZE = 128;
+
+//----------------------------------------------------------------------------
+void FillBox(vtkOrientedImageData* imageData, int boxMin, int boxMax, unsigned char value)
+{
+  for (int z = boxMin; z <= boxMax; ++z)
+    {
+    for (int y = boxMin; y <= boxMax; ++y)
+      {
+      for (int x = boxMin; x <= boxMax; ++x)
+        {
+        *static_cast<unsigned char*>(imageData->GetScalarPointer(x, y, z)) = value;
+        }
+      }
+    }
+  imageData->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkOrientedImageData* GetLabelmap(vtkSegmentation* segmentation, const std::string& segmentID)
+{
+  vtkSegment* segment = segmentation->GetSegment(segmentID);
+  if (!segment)
+    {
+    return NULL;
+    }
+  return vtkOrientedImageData::SafeDownCast(segment->GetRepresentation(
+    vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()));
+}
+
+//----------------------------------------------------------------------------
+unsigned char GetVoxel(vtkOrientedImageData* imageData, int x, int y, int z)
+{
+  return *static_cast<unsigned char*>(imageData->GetScalarPointer(x, y, z));
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkSegmentationHistoryTest1(int argc, char* argv[])
+{
+  // The restore time is only reported on request.
+  // Usage: vtkSegmentationHistoryTest1 --benchmark
+  bool benchmark = vtkAddonTestingUtilities::IsBenchmarkRequested(argc, argv);
+  const int numberOfSegments = 10;
+
+  vtkNew<vtkSegmentation> segmentation;
+  segmentation->SetMasterRepresentationName(
+    vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+  vtkIdType labelmapMemorySize = 0;
+  for (int i = 0; i < numberOfSegments; ++i)
+    {
+    vtkSmartPointer<vtkOrientedImageData> labelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+    labelmap->SetExtent(0, LABELMAP_SIZE - 1, 0, LABELMAP_SIZE - 1, 0, LABELMAP_SIZE - 1);
+    labelmap->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+    FillBox(labelmap, 0, LABELMAP_SIZE - 1, 0);
+    FillBox(labelmap, 32 + i, 95 - i, 1);
+    labelmapMemorySize = static_cast<vtkIdType>(labelmap->GetActualMemorySize()) * 1024;
+
+    vtkNew<vtkSegment> segment;
+    segment->AddRepresentation(
+      vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName(), labelmap);
+    segmentation->AddSegment(segment.GetPointer());
+    }
+  std::vector<std::string> segmentIDs;
+  segmentation->GetSegmentIDs(segmentIDs);
+  if (segmentIDs.size() != static_cast<size_t>(numberOfSegments))
+    {
+    std::cerr << __LINE__ << ": Failed to add segments to segmentation!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtkNew<vtkSegmentationHistory> history;
+  history->SetSegmentation(segmentation.GetPointer());
+
+  //////////////////////////////////////////////////////////////////////////
+  // Memory used by the first state: labelmaps are stored compressed
+
+  history->SaveState();
+  vtkIdType firstStateMemorySize = history->GetMemorySize();
+  vtkAddonTestingUtilities::ReportMeasurement("vtkSegmentationHistory-FirstStateMemorySize",
+    firstStateMemorySize, "numeric/integer");
+  if (firstStateMemorySize <= 0 || firstStateMemorySize > numberOfSegments * labelmapMemorySize / 10)
+    {
+    std::cerr << __LINE__ << ": Unexpected memory size of the first state: " << firstStateMemorySize
+      << " (uncompressed size: " << numberOfSegments * labelmapMemorySize << ")" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Memory used by an additional state: only the modified slices of the modified segment are stored
+
+  vtkOrientedImageData* modifiedLabelmap = GetLabelmap(segmentation.GetPointer(), segmentIDs[0]);
+  FillBox(modifiedLabelmap, 40, 44, 0);
+  history->SaveState();
+  vtkIdType secondStateMemorySize = history->GetMemorySize() - firstStateMemorySize;
+  vtkAddonTestingUtilities::ReportMeasurement("vtkSegmentationHistory-ModifiedStateMemorySize",
+    secondStateMemorySize, "numeric/integer");
+  if (secondStateMemorySize <= 0 || secondStateMemorySize > labelmapMemorySize / 50)
+    {
+    std::cerr << __LINE__ << ": Unexpected memory size of the second state: " << secondStateMemorySize
+      << " (uncompressed labelmap size: " << labelmapMemorySize << ")" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Saving an unchanged segmentation must not store any labelmap data again
+  history->SaveState();
+  vtkIdType thirdStateMemorySize = history->GetMemorySize() - firstStateMemorySize - secondStateMemorySize;
+  if (thirdStateMemorySize > secondStateMemorySize)
+    {
+    std::cerr << __LINE__ << ": Unexpected memory size of the unchanged state: " << thirdStateMemorySize << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Restore
+
+  FillBox(GetLabelmap(segmentation.GetPointer(), segmentIDs[0]), 50, 52, 0);
+  if (!history->RestorePreviousState())
+    {
+    std::cerr << __LINE__ << ": RestorePreviousState failed!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (benchmark)
+    {
+    vtkAddonTestingUtilities::ReportMeasurement("vtkSegmentationHistory-RestoreStateTime",
+      history->GetLastRestoreStateTime());
+    }
+  vtkOrientedImageData* restoredLabelmap = GetLabelmap(segmentation.GetPointer(), segmentIDs[0]);
+  if (!restoredLabelmap || GetVoxel(restoredLabelmap, 51, 51, 51) != 1 || GetVoxel(restoredLabelmap, 42, 42, 42) != 0)
+    {
+    std::cerr << __LINE__ << ": Restored labelmap is invalid!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  int restoredExtent[6] = {0, -1, 0, -1, 0, -1};
+  restoredLabelmap->GetExtent(restoredExtent);
+  if (restoredExtent[0] != 0 || restoredExtent[1] != LABELMAP_SIZE - 1 || restoredExtent[5] != LABELMAP_SIZE - 1)
+    {
+    std::cerr << __LINE__ << ": Restored labelmap extent is invalid!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  history->RestorePreviousState();
+  history->RestorePreviousState();
+  restoredLabelmap = GetLabelmap(segmentation.GetPointer(), segmentIDs[0]);
+  if (!restoredLabelmap || GetVoxel(restoredLabelmap, 42, 42, 42) != 1 || GetVoxel(restoredLabelmap, 0, 0, 0) != 0)
+    {
+    std::cerr << __LINE__ << ": Restored first state is invalid!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  for (int i = 1; i < numberOfSegments; ++i)
+    {
+    vtkOrientedImageData* labelmap = GetLabelmap(segmentation.GetPointer(), segmentIDs[i]);
+    if (!labelmap || GetVoxel(labelmap, 31 + i, 64, 64) != 0 || GetVoxel(labelmap, 32 + i, 64, 64) != 1)
+      {
+      std::cerr << __LINE__ << ": Restored segment " << i << " is invalid!" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // Redo
+  history->RestoreNextState();
+  history->RestoreNextState();
+  history->RestoreNextState();
+  restoredLabelmap = GetLabelmap(segmentation.GetPointer(), segmentIDs[0]);
+  if (!restoredLabelmap || GetVoxel(restoredLabelmap, 51, 51, 51) != 0 || GetVoxel(restoredLabelmap, 42, 42, 42) != 0)
+    {
+    std::cerr << __LINE__ << ": Redo failed!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Slices are still shared when the non-zero extent shrinks
+
+  vtkOrientedImageData* shrunkLabelmap = GetLabelmap(segmentation.GetPointer(), segmentIDs[1]);
+  *static_cast<unsigned char*>(shrunkLabelmap->GetScalarPointer(100, 100, 64)) = 1;
+  shrunkLabelmap->Modified();
+  history->SaveState();
+  vtkIdType beforeShrinkMemorySize = history->GetMemorySize();
+  *static_cast<unsigned char*>(shrunkLabelmap->GetScalarPointer(100, 100, 64)) = 0;
+  shrunkLabelmap->Modified();
+  history->SaveState();
+  vtkIdType shrunkStateMemorySize = history->GetMemorySize() - beforeShrinkMemorySize;
+  if (shrunkStateMemorySize <= 0 || shrunkStateMemorySize > labelmapMemorySize / 200)
+    {
+    std::cerr << __LINE__ << ": Unexpected memory size of the state with a shrunk extent: " << shrunkStateMemorySize
+      << " (uncompressed labelmap size: " << labelmapMemorySize << ")" << std::endl;
+    return EXIT_FAILURE;
+    }
+  history->RestorePreviousState();
+  if (GetVoxel(GetLabelmap(segmentation.GetPointer(), segmentIDs[1]), 100, 100, 64) != 1)
+    {
+    std::cerr << __LINE__ << ": Restored state before shrinking is invalid!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  history->RestoreNextState();
+  shrunkLabelmap = GetLabelmap(segmentation.GetPointer(), segmentIDs[1]);
+  if (GetVoxel(shrunkLabelmap, 100, 100, 64) != 0 || GetVoxel(shrunkLabelmap, 33, 33, 33) != 1)
+    {
+    std::cerr << __LINE__ << ": Restored shrunk state is invalid!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "Segmentation history test passed." << std::endl;
+  return EXIT_SUCCESS;
+}
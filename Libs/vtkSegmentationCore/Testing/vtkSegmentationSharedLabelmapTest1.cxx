@@ -0,0 +1,265 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// SegmentationCore includes
+#include "vtkBinaryLabelmapToClosedSurfaceConversionRule.h"
+#include "vtkOrientedImageData.h"
+#include "vtkSegment.h"
+#include "vtkSegmentation.h"
+#include "vtkSegmentationConverter.h"
+#include "vtkSegmentationHistory.h"
+
+namespace
+{
+
+const int LABELMAP_SIZE = 64;
+
+//----------------------------------------------------------------------------
+void FillBox(vtkOrientedImageData* imageData, const int box[6], unsigned char value)
+{
+  for (int z = box[4]; z <= box[5]; ++z)
+    {
+    for (int y = box[2]; y <= box[3]; ++y)
+      {
+      for (int x = box[0]; x <= box[1]; ++x)
+        {
+        *static_cast<unsigned char*>(imageData->GetScalarPointer(x, y, z)) = value;
+        }
+      }
+    }
+  imageData->Modified();
+}
+
+//----------------------------------------------------------------------------
+void GetSegmentBox(int segmentIndex, int box[6])
+{
+  box[0] = segmentIndex * 6 + 1;
+  box[1] = segmentIndex * 6 + 3;
+  box[2] = 10;
+  box[3] = 20;
+  box[4] = 10;
+  box[5] = 20;
+}
+
+//----------------------------------------------------------------------------
+vtkOrientedImageData* GetLabelmap(vtkSegmentation* segmentation, const std::string& segmentID)
+{
+  vtkSegment* segment = segmentation->GetSegment(segmentID);
+  if (!segment)
+    {
+    return NULL;
+    }
+  return vtkOrientedImageData::SafeDownCast(segment->GetRepresentation(
+    vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()));
+}
+
+//----------------------------------------------------------------------------
+int GetVoxel(vtkOrientedImageData* imageData, int x, int y, int z)
+{
+  return static_cast<int>(imageData->GetScalarComponentAsDouble(x, y, z, 0));
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkSegmentationSharedLabelmapTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  // Segments 0..numberOfSegments-2 do not overlap, the last segment overlaps with the first one
+  const int numberOfSegments = 6;
+
+  vtkNew<vtkSegmentation> segmentation;
+  segmentation->SetMasterRepresentationName(
+    vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+  for (int i = 0; i < numberOfSegments; ++i)
+    {
+    vtkSmartPointer<vtkOrientedImageData> labelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+    labelmap->SetExtent(0, LABELMAP_SIZE - 1, 0, LABELMAP_SIZE - 1, 0, LABELMAP_SIZE - 1);
+    labelmap->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+    int wholeBox[6] = { 0, LABELMAP_SIZE - 1, 0, LABELMAP_SIZE - 1, 0, LABELMAP_SIZE - 1 };
+    FillBox(labelmap, wholeBox, 0);
+    int box[6] = { 0, -1, 0, -1, 0, -1 };
+    GetSegmentBox(i < numberOfSegments - 1 ? i : 0, box);
+    FillBox(labelmap, box, 1);
+
+    vtkNew<vtkSegment> segment;
+    segment->AddRepresentation(
+      vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName(), labelmap);
+    segmentation->AddSegment(segment.GetPointer());
+    }
+  std::vector<std::string> segmentIDs;
+  segmentation->GetSegmentIDs(segmentIDs);
+  if (segmentIDs.size() != static_cast<size_t>(numberOfSegments)
+    || segmentation->GetNumberOfLayers() != numberOfSegments
+    || segmentation->IsSharedBinaryLabelmap(segmentIDs[0]))
+    {
+    std::cerr << __LINE__ << ": Failed to add segments to segmentation!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Collapse: overlapping segment is placed into a separate layer
+
+  if (!segmentation->CollapseBinaryLabelmaps())
+    {
+    std::cerr << __LINE__ << ": CollapseBinaryLabelmaps failed!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (segmentation->GetNumberOfLayers() != 2)
+    {
+    std::cerr << __LINE__ << ": Unexpected number of layers: " << segmentation->GetNumberOfLayers() << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::vector<std::string> sharedSegmentIDs;
+  segmentation->GetSegmentIDsSharingBinaryLabelmapRepresentation(segmentIDs[0], sharedSegmentIDs);
+  if (sharedSegmentIDs.size() != static_cast<size_t>(numberOfSegments - 1)
+    || !segmentation->IsSharedBinaryLabelmap(segmentIDs[1])
+    || GetLabelmap(segmentation.GetPointer(), segmentIDs[0]) == GetLabelmap(segmentation.GetPointer(), segmentIDs[numberOfSegments - 1]))
+    {
+    std::cerr << __LINE__ << ": Segments are not shared as expected!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Each segment can still be retrieved separately
+  for (int i = 0; i < numberOfSegments; ++i)
+    {
+    vtkNew<vtkOrientedImageData> segmentLabelmap;
+    int box[6] = { 0, -1, 0, -1, 0, -1 };
+    GetSegmentBox(i < numberOfSegments - 1 ? i : 0, box);
+    if (!segmentation->GetBinaryLabelmapRepresentation(segmentIDs[i], segmentLabelmap.GetPointer())
+      || GetVoxel(segmentLabelmap.GetPointer(), box[0], 15, 15) != 1
+      || GetVoxel(segmentLabelmap.GetPointer(), box[0] + 6, 15, 15) != 0)
+      {
+      std::cerr << __LINE__ << ": Invalid labelmap of segment " << i << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Conversion only uses the voxels of the segment
+
+  vtkNew<vtkBinaryLabelmapToClosedSurfaceConversionRule> rule;
+  vtkNew<vtkPolyData> closedSurface;
+  vtkSegment* convertedSegment = segmentation->GetSegment(segmentIDs[2]);
+  if (!rule->ConvertSharedLabelmap(GetLabelmap(segmentation.GetPointer(), segmentIDs[2]),
+    convertedSegment->GetLabelValue(), closedSurface.GetPointer())
+    || closedSurface->GetNumberOfPoints() == 0)
+    {
+    std::cerr << __LINE__ << ": Failed to convert shared labelmap!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  double bounds[6] = { 0.0, -1.0, 0.0, -1.0, 0.0, -1.0 };
+  closedSurface->GetBounds(bounds);
+  if (bounds[0] < 2 * 6 || bounds[1] > 2 * 6 + 5)
+    {
+    std::cerr << __LINE__ << ": Closed surface contains other segments: x bounds = "
+      << bounds[0] << ", " << bounds[1] << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Deep copy preserves shared layers
+
+  vtkNew<vtkSegmentation> segmentationCopy;
+  segmentationCopy->DeepCopy(segmentation.GetPointer());
+  if (segmentationCopy->GetNumberOfLayers() != 2)
+    {
+    std::cerr << __LINE__ << ": Deep copy did not preserve layers!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Undo/redo preserves shared layers
+
+  vtkNew<vtkSegmentationHistory> history;
+  history->SetSegmentation(segmentation.GetPointer());
+  history->SaveState();
+  vtkOrientedImageData* layer = GetLabelmap(segmentation.GetPointer(), segmentIDs[1]);
+  int segment1Box[6] = { 0, -1, 0, -1, 0, -1 };
+  GetSegmentBox(1, segment1Box);
+  FillBox(layer, segment1Box, 0);
+  history->RestorePreviousState();
+  if (segmentation->GetNumberOfLayers() != 2)
+    {
+    std::cerr << __LINE__ << ": Restored state has " << segmentation->GetNumberOfLayers() << " layers instead of 2" << std::endl;
+    return EXIT_FAILURE;
+    }
+  layer = GetLabelmap(segmentation.GetPointer(), segmentIDs[1]);
+  if (GetVoxel(layer, segment1Box[0], 15, 15) != segmentation->GetSegment(segmentIDs[1])->GetLabelValue())
+    {
+    std::cerr << __LINE__ << ": Restored layer is invalid!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Separate segment from its layer
+
+  int segment1LabelValue = segmentation->GetSegment(segmentIDs[1])->GetLabelValue();
+  if (!segmentation->SeparateSegmentLabelmap(segmentIDs[1])
+    || segmentation->GetNumberOfLayers() != 3
+    || segmentation->IsSharedBinaryLabelmap(segmentIDs[1])
+    || segmentation->GetSegment(segmentIDs[1])->GetLabelValue() != 1)
+    {
+    std::cerr << __LINE__ << ": Failed to separate segment!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  // The former shared labelmap is not modified, the remaining segments get a copy of it
+  vtkOrientedImageData* remainingLayer = GetLabelmap(segmentation.GetPointer(), segmentIDs[0]);
+  if (GetVoxel(layer, segment1Box[0], 15, 15) != segment1LabelValue
+    || remainingLayer == layer
+    || remainingLayer != GetLabelmap(segmentation.GetPointer(), segmentIDs[2])
+    || GetVoxel(remainingLayer, segment1Box[0], 15, 15) != 0
+    || GetVoxel(GetLabelmap(segmentation.GetPointer(), segmentIDs[1]), segment1Box[0], 15, 15) != 1)
+    {
+    std::cerr << __LINE__ << ": Separated segment (label " << segment1LabelValue << ") is invalid!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Removed segment is cleared from its layer and keeps its own voxels
+
+  int segment2Box[6] = { 0, -1, 0, -1, 0, -1 };
+  GetSegmentBox(2, segment2Box);
+  int segment3Box[6] = { 0, -1, 0, -1, 0, -1 };
+  GetSegmentBox(3, segment3Box);
+  vtkSmartPointer<vtkSegment> removedSegment = segmentation->GetSegment(segmentIDs[2]);
+  segmentation->RemoveSegment(segmentIDs[2]);
+  vtkOrientedImageData* remainingLayerAfterRemove = GetLabelmap(segmentation.GetPointer(), segmentIDs[3]);
+  if (GetVoxel(remainingLayerAfterRemove, segment2Box[0], 15, 15) != 0
+    || GetVoxel(remainingLayerAfterRemove, segment3Box[0], 15, 15) != segmentation->GetSegment(segmentIDs[3])->GetLabelValue()
+    || !segmentation->IsSharedBinaryLabelmap(segmentIDs[3]))
+    {
+    std::cerr << __LINE__ << ": Removed segment is not cleared from the shared layer!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  vtkOrientedImageData* removedLabelmap = vtkOrientedImageData::SafeDownCast(removedSegment->GetRepresentation(
+    vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()));
+  if (!removedLabelmap
+    || removedLabelmap == remainingLayerAfterRemove
+    || removedSegment->GetLabelValue() != 1
+    || GetVoxel(removedLabelmap, segment2Box[0], 15, 15) != 1
+    || GetVoxel(removedLabelmap, segment3Box[0], 15, 15) != 0)
+    {
+    std::cerr << __LINE__ << ": Removed segment does not keep its own labelmap!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "Shared labelmap test passed." << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -22,22 +22,276 @@
 #include "vtkBinaryLabelmapToClosedSurfaceConversionRule.h"
 
 #include "vtkOrientedImageData.h"
+#include "vtkOrientedImageDataResample.h"
 
 // VTK includes
+#include <vtkCellArray.h>
+#include <vtkCriticalSection.h>
 #include <vtkDecimatePro.h>
 #include <vtkDiscreteMarchingCubes.h>
 #include <vtkImageChangeInformation.h>
 #include <vtkImageConstantPad.h>
 #include <vtkImageThreshold.h>
+#include <vtkMatrix4x4.h>
+#include <vtkMergePoints.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
 #include <vtkPolyData.h>
 #include <vtkPolyDataNormals.h>
+#include <vtkTimerLog.h>
 #include <vtkTransform.h>
 #include <vtkTransformPolyDataFilter.h>
 #include <vtkVersion.h>
+#include <vtkWeakPointer.h>
 #include <vtkWindowedSincPolyDataFilter.h>
 
+// STD includes
+#include <algorithm>
+#include <map>
+#include <sstream>
+
+//----------------------------------------------------------------------------
+struct vtkBinaryLabelmapToClosedSurfaceConversionJob
+{
+  vtkSmartPointer<vtkOrientedImageData> Labelmap;
+  int LabelValue;
+  vtkPolyData* ClosedSurface;
+  vtkIdType NumberOfVoxels;
+  /// If valid then only the cells of this point extent are meshed, see \sa CreateClosedSurface
+  int BrickExtent[6];
+  bool Success;
+};
+
+//----------------------------------------------------------------------------
+struct vtkBinaryLabelmapToClosedSurfaceConversionThreadData
+{
+  vtkBinaryLabelmapToClosedSurfaceConversionRule* Rule;
+  std::vector<vtkBinaryLabelmapToClosedSurfaceConversionJob>* Jobs;
+  size_t NextJobIndex;
+};
+
+namespace
+{
+
+/// Number of iterations of the windowed sinc smoothing filter
+const int SMOOTHING_ITERATIONS = 20;
+
+//----------------------------------------------------------------------------
+bool IsLargerJob(const vtkBinaryLabelmapToClosedSurfaceConversionJob& lhs, const vtkBinaryLabelmapToClosedSurfaceConversionJob& rhs)
+{
+  return lhs.NumberOfVoxels > rhs.NumberOfVoxels;
+}
+
+//----------------------------------------------------------------------------
+bool IsExtentValid(const int extent[6])
+{
+  return extent[0] <= extent[1] && extent[2] <= extent[3] && extent[4] <= extent[5];
+}
+
+//----------------------------------------------------------------------------
+/// Division that rounds towards negative infinity, so that negative voxel indices are assigned to the correct brick
+int FloorDivide(int value, int divisor)
+{
+  return (value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor));
+}
+
+//----------------------------------------------------------------------------
+struct BrickIndex
+{
+  int Index[3];
+  bool operator<(const BrickIndex& other) const
+    {
+    for (int i = 0; i < 3; ++i)
+      {
+      if (this->Index[i] != other.Index[i])
+        {
+        return this->Index[i] < other.Index[i];
+        }
+      }
+    return false;
+    }
+};
+
+//----------------------------------------------------------------------------
+/// Surface patches of the bricks of a closed surface that was created by ConvertModifiedExtent
+struct BrickSurfaceCache
+{
+  vtkWeakPointer<vtkPolyData> ClosedSurface;
+  /// Modified time of the closed surface after the last update. If the surface was modified
+  /// since then (or it is a different object at the same address) then the cache is invalid.
+  vtkMTimeType ClosedSurfaceMTime;
+  vtkSmartPointer<vtkMatrix4x4> ImageToWorldMatrix;
+  int LabelValue;
+  int BrickSize;
+  std::string ConversionParameters;
+  /// Raw marching cubes surface of each non-empty brick, in IJK coordinates
+  std::map<BrickIndex, vtkSmartPointer<vtkPolyData> > BrickSurfaces;
+  /// Post-processed surface of each non-empty brick, in world coordinates. It has the same points
+  /// in the same order as the raw surface of the brick. Not used if the surface is decimated.
+  std::map<BrickIndex, vtkSmartPointer<vtkPolyData> > ProcessedBrickSurfaces;
+};
+
+//----------------------------------------------------------------------------
+/// Append brick patches into a single surface. The raw marching cubes patches of neighbor bricks
+/// have points at the same IJK positions on their common face, these points are merged so that the
+/// surface is closed. Point positions, point data and cells are taken from valuePatches, which have
+/// the same points in the same order as the corresponding rawPatches (they can be the same patches).
+/// mergedPointIds[patchIndex][pointId] is set to the id of the point in the merged surface.
+void MergeBrickPatches(const std::vector<vtkPolyData*>& rawPatches, const std::vector<vtkPolyData*>& valuePatches,
+  vtkPolyData* mergedSurface, std::vector<std::vector<vtkIdType> >& mergedPointIds)
+{
+  mergedSurface->Initialize();
+  mergedPointIds.assign(rawPatches.size(), std::vector<vtkIdType>());
+  if (rawPatches.empty())
+    {
+    return;
+    }
+
+  double bounds[6] = { VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN };
+  vtkIdType numberOfPoints = 0;
+  vtkIdType numberOfCells = 0;
+  for (size_t patchIndex = 0; patchIndex < rawPatches.size(); ++patchIndex)
+    {
+    double patchBounds[6] = { 0.0, -1.0, 0.0, -1.0, 0.0, -1.0 };
+    rawPatches[patchIndex]->GetBounds(patchBounds);
+    for (int i = 0; i < 3; ++i)
+      {
+      bounds[i * 2] = std::min(bounds[i * 2], patchBounds[i * 2]);
+      bounds[i * 2 + 1] = std::max(bounds[i * 2 + 1], patchBounds[i * 2 + 1]);
+      }
+    numberOfPoints += rawPatches[patchIndex]->GetNumberOfPoints();
+    numberOfCells += valuePatches[patchIndex]->GetNumberOfPolys();
+    }
+
+  // Raw points are at voxel corners or edge midpoints, so shared points have exactly the same coordinates
+  vtkNew<vtkPoints> rawMergedPoints;
+  vtkNew<vtkMergePoints> pointLocator;
+  pointLocator->InitPointInsertion(rawMergedPoints.GetPointer(), bounds, numberOfPoints);
+
+  vtkNew<vtkPoints> points;
+  points->SetDataType(valuePatches[0]->GetPoints()->GetDataType());
+  points->Allocate(numberOfPoints);
+  vtkPointData* mergedPointData = mergedSurface->GetPointData();
+  mergedPointData->CopyAllocate(valuePatches[0]->GetPointData(), numberOfPoints);
+  vtkNew<vtkCellArray> polys;
+  polys->Allocate(polys->EstimateSize(numberOfCells, 3));
+
+  std::vector<vtkIdType> cellPointIds;
+  for (size_t patchIndex = 0; patchIndex < rawPatches.size(); ++patchIndex)
+    {
+    vtkPoints* rawPoints = rawPatches[patchIndex]->GetPoints();
+    vtkPolyData* valuePatch = valuePatches[patchIndex];
+    std::vector<vtkIdType>& patchMergedPointIds = mergedPointIds[patchIndex];
+    patchMergedPointIds.resize(rawPatches[patchIndex]->GetNumberOfPoints());
+    for (vtkIdType pointId = 0; pointId < static_cast<vtkIdType>(patchMergedPointIds.size()); ++pointId)
+      {
+      vtkIdType mergedPointId = -1;
+      if (pointLocator->InsertUniquePoint(rawPoints->GetPoint(pointId), mergedPointId))
+        {
+        points->InsertPoint(mergedPointId, valuePatch->GetPoint(pointId));
+        mergedPointData->CopyData(valuePatch->GetPointData(), pointId, mergedPointId);
+        }
+      patchMergedPointIds[pointId] = mergedPointId;
+      }
+    vtkCellArray* patchPolys = valuePatch->GetPolys();
+    vtkIdType npts = 0;
+    vtkIdType* pts = NULL;
+    for (patchPolys->InitTraversal(); patchPolys->GetNextCell(npts, pts); )
+      {
+      cellPointIds.resize(npts);
+      for (vtkIdType i = 0; i < npts; ++i)
+        {
+        cellPointIds[i] = patchMergedPointIds[pts[i]];
+        }
+      polys->InsertNextCell(npts, &cellPointIds[0]);
+      }
+    }
+  mergedSurface->SetPoints(points.GetPointer());
+  mergedSurface->SetPolys(polys.GetPointer());
+}
+
+//----------------------------------------------------------------------------
+/// Split a surface that was created by MergeBrickPatches (and then post-processed without changing
+/// its points and the order of its cells) into patches. Only the patches marked in extractPatch are
+/// created. The points of each patch are in the same order as in its raw patch.
+void SplitBrickPatches(vtkPolyData* mergedSurface, const std::vector<vtkPolyData*>& rawPatches,
+  const std::vector<std::vector<vtkIdType> >& mergedPointIds, const std::vector<bool>& extractPatch,
+  std::vector<vtkSmartPointer<vtkPolyData> >& patches)
+{
+  patches.assign(rawPatches.size(), vtkSmartPointer<vtkPolyData>());
+  vtkCellArray* mergedPolys = mergedSurface->GetPolys();
+  mergedPolys->InitTraversal();
+  vtkIdType npts = 0;
+  vtkIdType* pts = NULL;
+  std::vector<vtkIdType> cellPointIds;
+  for (size_t patchIndex = 0; patchIndex < rawPatches.size(); ++patchIndex)
+    {
+    vtkIdType numberOfCells = rawPatches[patchIndex]->GetNumberOfPolys();
+    if (!extractPatch[patchIndex])
+      {
+      for (vtkIdType cellIndex = 0; cellIndex < numberOfCells; ++cellIndex)
+        {
+        mergedPolys->GetNextCell(npts, pts);
+        }
+      continue;
+      }
+
+    const std::vector<vtkIdType>& patchMergedPointIds = mergedPointIds[patchIndex];
+    vtkIdType numberOfPoints = static_cast<vtkIdType>(patchMergedPointIds.size());
+    std::map<vtkIdType, vtkIdType> patchPointIds;
+    vtkSmartPointer<vtkPolyData> patch = vtkSmartPointer<vtkPolyData>::New();
+    vtkNew<vtkPoints> points;
+    points->SetDataType(mergedSurface->GetPoints()->GetDataType());
+    points->SetNumberOfPoints(numberOfPoints);
+    patch->GetPointData()->CopyAllocate(mergedSurface->GetPointData(), numberOfPoints);
+    for (vtkIdType pointId = 0; pointId < numberOfPoints; ++pointId)
+      {
+      points->SetPoint(pointId, mergedSurface->GetPoint(patchMergedPointIds[pointId]));
+      patch->GetPointData()->CopyData(mergedSurface->GetPointData(), patchMergedPointIds[pointId], pointId);
+      patchPointIds[patchMergedPointIds[pointId]] = pointId;
+      }
+    vtkNew<vtkCellArray> polys;
+    polys->Allocate(polys->EstimateSize(numberOfCells, 3));
+    for (vtkIdType cellIndex = 0; cellIndex < numberOfCells; ++cellIndex)
+      {
+      mergedPolys->GetNextCell(npts, pts);
+      cellPointIds.resize(npts);
+      for (vtkIdType i = 0; i < npts; ++i)
+        {
+        cellPointIds[i] = patchPointIds[pts[i]];
+        }
+      polys->InsertNextCell(npts, &cellPointIds[0]);
+      }
+    patch->SetPoints(points.GetPointer());
+    patch->SetPolys(polys.GetPointer());
+    patches[patchIndex] = patch;
+    }
+}
+
+//----------------------------------------------------------------------------
+bool IsBrickInRange(const BrickIndex& brickIndex, const int brickRange[6])
+{
+  for (int i = 0; i < 3; ++i)
+    {
+    if (brickIndex.Index[i] < brickRange[i * 2] || brickIndex.Index[i] > brickRange[i * 2 + 1])
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+class vtkBinaryLabelmapToClosedSurfaceConversionRule::vtkInternal
+{
+public:
+  std::vector<BrickSurfaceCache> BrickSurfaceCaches;
+};
+
 //----------------------------------------------------------------------------
 vtkSegmentationConverterRuleNewMacro(vtkBinaryLabelmapToClosedSurfaceConversionRule);
 
@@ -52,11 +306,93 @@ vtkBinaryLabelmapToClosedSurfaceConversionRule::vtkBinaryLabelmapToClosedSurface
   this->ConversionParameters[GetComputeSurfaceNormalsParameterName()] = std::make_pair("1",
     "Compute surface normals. 1 (default) = surface normals are computed. "
     "0 = surface normals are not computed (slightly faster but produces less smooth surface display).");
+
+  this->NumberOfThreads = 0;
+  this->BrickSize = 32;
+  this->Lock = new vtkSimpleCriticalSection();
+  this->Internal = new vtkInternal();
+  this->ResetStageTimes();
 }
 
 //----------------------------------------------------------------------------
 vtkBinaryLabelmapToClosedSurfaceConversionRule::~vtkBinaryLabelmapToClosedSurfaceConversionRule()
 {
+  delete this->Lock;
+  this->Lock = NULL;
+  delete this->Internal;
+  this->Internal = NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkBinaryLabelmapToClosedSurfaceConversionRule::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << "\n";
+  os << indent << "BrickSize: " << this->BrickSize << "\n";
+  os << indent << "StageTimes:\n";
+  for (int stage = 0; stage < StageLast; ++stage)
+    {
+    os << indent.GetNextIndent() << GetStageName(stage) << ": " << this->StageTimes[stage] << "s\n";
+    }
+}
+
+//----------------------------------------------------------------------------
+const char* vtkBinaryLabelmapToClosedSurfaceConversionRule::GetStageName(int stage)
+{
+  switch (stage)
+    {
+    case StageCropAndPad: return "Crop and pad";
+    case StageMarchingCubes: return "Marching cubes";
+    case StageDecimation: return "Decimation";
+    case StageSmoothing: return "Smoothing";
+    case StageTransformAndNormals: return "Transform and normals";
+    default: return "";
+    }
+}
+
+//----------------------------------------------------------------------------
+double vtkBinaryLabelmapToClosedSurfaceConversionRule::GetStageTime(int stage)
+{
+  if (stage < 0 || stage >= StageLast)
+    {
+    vtkErrorMacro("GetStageTime: Invalid stage " << stage);
+    return 0.0;
+    }
+  this->Lock->Lock();
+  double stageTime = this->StageTimes[stage];
+  this->Lock->Unlock();
+  return stageTime;
+}
+
+//----------------------------------------------------------------------------
+void vtkBinaryLabelmapToClosedSurfaceConversionRule::ResetStageTimes()
+{
+  this->Lock->Lock();
+  for (int stage = 0; stage < StageLast; ++stage)
+    {
+    this->StageTimes[stage] = 0.0;
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkBinaryLabelmapToClosedSurfaceConversionRule::AddStageTime(int stage, double elapsedTimeSec)
+{
+  this->Lock->Lock();
+  this->StageTimes[stage] += elapsedTimeSec;
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+std::string vtkBinaryLabelmapToClosedSurfaceConversionRule::GetConversionParameterValue(const std::string& name)
+{
+  // Unlike operator[], find does not modify the map, so it is safe to call from multiple threads
+  ConversionParameterListType::const_iterator parameterIt = this->ConversionParameters.find(name);
+  if (parameterIt == this->ConversionParameters.end())
+    {
+    return "";
+    }
+  return parameterIt->second.first;
 }
 
 //----------------------------------------------------------------------------
@@ -112,45 +448,521 @@ bool vtkBinaryLabelmapToClosedSurfaceConversionRule::Convert(vtkDataObject* sour
     vtkErrorMacro("Convert: Source representation is not oriented image data");
     return false;
     }
-  vtkSmartPointer<vtkImageData> binaryLabelMap = vtkImageData::SafeDownCast(sourceRepresentation);
-  if (!binaryLabelMap.GetPointer())
+  vtkPolyData* closedSurfacePolyData = vtkPolyData::SafeDownCast(targetRepresentation);
+  if (!closedSurfacePolyData)
+    {
+    vtkErrorMacro("Convert: Target representation is not poly data");
+    return false;
+    }
+
+  // All non-zero voxels belong to the segment, use the maximum value as the surface label
+  int labelValue = static_cast<int>(orientedBinaryLabelMap->GetScalarRange()[1]);
+  return this->CreateClosedSurface(orientedBinaryLabelMap, labelValue, closedSurfacePolyData);
+}
+
+//----------------------------------------------------------------------------
+bool vtkBinaryLabelmapToClosedSurfaceConversionRule::ConvertSharedLabelmap(vtkDataObject* sourceRepresentation,
+  int labelValue, vtkDataObject* targetRepresentation)
+{
+  // The shared labelmap is processed directly, discrete marching cubes only extracts the requested label
+  vtkOrientedImageData* orientedSharedLabelMap = vtkOrientedImageData::SafeDownCast(sourceRepresentation);
+  if (!orientedSharedLabelMap)
     {
-    vtkErrorMacro("Convert: Source representation is not image data");
+    vtkErrorMacro("ConvertSharedLabelmap: Source representation is not oriented image data");
     return false;
     }
   vtkPolyData* closedSurfacePolyData = vtkPolyData::SafeDownCast(targetRepresentation);
   if (!closedSurfacePolyData)
     {
-    vtkErrorMacro("Convert: Target representation is not poly data");
+    vtkErrorMacro("ConvertSharedLabelmap: Target representation is not poly data");
+    return false;
+    }
+  return this->CreateClosedSurface(orientedSharedLabelMap, labelValue, closedSurfacePolyData);
+}
+
+//----------------------------------------------------------------------------
+bool vtkBinaryLabelmapToClosedSurfaceConversionRule::ConvertMultiple(const std::vector<vtkDataObject*>& sourceRepresentations,
+  const std::vector<int>& labelValues, const std::vector<vtkDataObject*>& targetRepresentations)
+{
+  if (sourceRepresentations.size() != targetRepresentations.size() || sourceRepresentations.size() != labelValues.size())
+    {
+    vtkErrorMacro("ConvertMultiple: Number of source representations, label values, and target representations must be the same");
     return false;
     }
 
-  // Pad labelmap if it has non-background border voxels
+  // Prepare the jobs in the main thread. Each thread gets its own shallow copy of the
+  // input labelmap so that the pipelines of the threads are independent.
+  bool success = true;
+  std::vector<vtkBinaryLabelmapToClosedSurfaceConversionJob> jobs;
+  for (size_t i = 0; i < sourceRepresentations.size(); ++i)
+    {
+    vtkOrientedImageData* orientedBinaryLabelMap = vtkOrientedImageData::SafeDownCast(sourceRepresentations[i]);
+    vtkPolyData* closedSurfacePolyData = vtkPolyData::SafeDownCast(targetRepresentations[i]);
+    if (!orientedBinaryLabelMap || !closedSurfacePolyData)
+      {
+      vtkErrorMacro("ConvertMultiple: Source representation is not oriented image data or target representation is not poly data");
+      success = false;
+      continue;
+      }
+    vtkBinaryLabelmapToClosedSurfaceConversionJob job;
+    job.Labelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+    job.Labelmap->ShallowCopy(orientedBinaryLabelMap);
+    // Scalar range is computed here, as computing it in multiple threads on the same array is not safe
+    job.LabelValue = (labelValues[i] != 0 ? labelValues[i] : static_cast<int>(orientedBinaryLabelMap->GetScalarRange()[1]));
+    job.ClosedSurface = closedSurfacePolyData;
+    job.NumberOfVoxels = orientedBinaryLabelMap->GetNumberOfPoints();
+    job.BrickExtent[0] = job.BrickExtent[2] = job.BrickExtent[4] = 0;
+    job.BrickExtent[1] = job.BrickExtent[3] = job.BrickExtent[5] = -1;
+    job.Success = false;
+    jobs.push_back(job);
+    }
+
+  return this->ExecuteConversionJobs(jobs) && success;
+}
+
+//----------------------------------------------------------------------------
+bool vtkBinaryLabelmapToClosedSurfaceConversionRule::ConvertModifiedExtent(vtkDataObject* sourceRepresentation,
+  int labelValue, const int modifiedExtent[6], vtkDataObject* targetRepresentation)
+{
+  vtkOrientedImageData* orientedBinaryLabelMap = vtkOrientedImageData::SafeDownCast(sourceRepresentation);
+  if (!orientedBinaryLabelMap)
+    {
+    vtkErrorMacro("ConvertModifiedExtent: Source representation is not oriented image data");
+    return false;
+    }
+  vtkPolyData* closedSurfacePolyData = vtkPolyData::SafeDownCast(targetRepresentation);
+  if (!closedSurfacePolyData)
+    {
+    vtkErrorMacro("ConvertModifiedExtent: Target representation is not poly data");
+    return false;
+    }
+  if (labelValue == 0)
+    {
+    labelValue = static_cast<int>(orientedBinaryLabelMap->GetScalarRange()[1]);
+    }
+  int brickSize = std::max(this->BrickSize, 2);
+
+  vtkNew<vtkMatrix4x4> imageToWorldMatrix;
+  orientedBinaryLabelMap->GetImageToWorldMatrix(imageToWorldMatrix.GetPointer());
+  std::stringstream conversionParametersStream;
+  conversionParametersStream << this->GetConversionParameterValue(GetDecimationFactorParameterName()) << "|"
+    << this->GetConversionParameterValue(GetSmoothingFactorParameterName()) << "|"
+    << this->GetConversionParameterValue(GetComputeSurfaceNormalsParameterName());
+  std::string conversionParameters = conversionParametersStream.str();
+
+  // Find the bricks of the surface from the previous update. Remove caches of deleted surfaces.
+  BrickSurfaceCache* cache = NULL;
+  std::vector<BrickSurfaceCache>& caches = this->Internal->BrickSurfaceCaches;
+  for (std::vector<BrickSurfaceCache>::iterator cacheIt = caches.begin(); cacheIt != caches.end(); )
+    {
+    if (cacheIt->ClosedSurface.GetPointer() == NULL)
+      {
+      cacheIt = caches.erase(cacheIt);
+      continue;
+      }
+    if (cacheIt->ClosedSurface.GetPointer() == closedSurfacePolyData)
+      {
+      cache = &(*cacheIt);
+      }
+    ++cacheIt;
+    }
+  bool cacheValid = (cache != NULL
+    && cache->ClosedSurfaceMTime == closedSurfacePolyData->GetMTime()
+    && cache->LabelValue == labelValue
+    && cache->BrickSize == brickSize
+    && cache->ConversionParameters == conversionParameters
+    && vtkOrientedImageDataResample::IsEqual(cache->ImageToWorldMatrix, imageToWorldMatrix.GetPointer()));
+  if (!cache)
+    {
+    caches.push_back(BrickSurfaceCache());
+    cache = &caches.back();
+    cache->ClosedSurface = closedSurfacePolyData;
+    cache->ImageToWorldMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    }
+
+  // Determine the range of bricks that has to be meshed again. The cells that have a modified
+  // voxel as corner point have to be updated, which start one voxel before the modified voxels.
+  int updatedRegion[6] = { 0, -1, 0, -1, 0, -1 };
+  if (cacheValid)
+    {
+    if (!IsExtentValid(modifiedExtent))
+      {
+      // nothing has changed
+      return true;
+      }
+    for (int i = 0; i < 6; ++i)
+      {
+      updatedRegion[i] = modifiedExtent[i];
+      }
+    }
+  else
+    {
+    // Surface was not created by incremental update or conversion settings have changed, mesh all bricks
+    cache->BrickSurfaces.clear();
+    cache->ProcessedBrickSurfaces.clear();
+    cache->LabelValue = labelValue;
+    cache->BrickSize = brickSize;
+    cache->ConversionParameters = conversionParameters;
+    cache->ImageToWorldMatrix->DeepCopy(imageToWorldMatrix.GetPointer());
+    if (!vtkOrientedImageDataResample::CalculateEffectiveExtent(orientedBinaryLabelMap, updatedRegion))
+      {
+      updatedRegion[0] = updatedRegion[2] = updatedRegion[4] = 0;
+      updatedRegion[1] = updatedRegion[3] = updatedRegion[5] = -1;
+      }
+    }
+  int labelmapExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  orientedBinaryLabelMap->GetExtent(labelmapExtent);
+
+  std::vector<vtkBinaryLabelmapToClosedSurfaceConversionJob> jobs;
+  std::vector<BrickIndex> jobBrickIndices;
+  std::vector<vtkSmartPointer<vtkPolyData> > brickSurfaces;
+  // Range of meshed bricks (first and last brick index along each axis)
+  int meshedBricks[6] = { 0, -1, 0, -1, 0, -1 };
+  if (IsExtentValid(updatedRegion))
+    {
+    for (int i = 0; i < 3; ++i)
+      {
+      meshedBricks[i * 2] = FloorDivide(updatedRegion[i * 2] - 1, brickSize);
+      meshedBricks[i * 2 + 1] = FloorDivide(updatedRegion[i * 2 + 1], brickSize);
+      }
+    BrickIndex brickIndex;
+    for (brickIndex.Index[2] = meshedBricks[4]; brickIndex.Index[2] <= meshedBricks[5]; ++brickIndex.Index[2])
+      {
+      for (brickIndex.Index[1] = meshedBricks[2]; brickIndex.Index[1] <= meshedBricks[3]; ++brickIndex.Index[1])
+        {
+        for (brickIndex.Index[0] = meshedBricks[0]; brickIndex.Index[0] <= meshedBricks[1]; ++brickIndex.Index[0])
+          {
+          // Point extent of the brick: cells of the brick and the voxels shared with the next bricks
+          int brickExtent[6] = { 0, -1, 0, -1, 0, -1 };
+          bool brickInLabelmap = true;
+          for (int i = 0; i < 3; ++i)
+            {
+            brickExtent[i * 2] = brickIndex.Index[i] * brickSize;
+            brickExtent[i * 2 + 1] = (brickIndex.Index[i] + 1) * brickSize;
+            if (brickExtent[i * 2 + 1] < labelmapExtent[i * 2] || brickExtent[i * 2] > labelmapExtent[i * 2 + 1])
+              {
+              brickInLabelmap = false;
+              }
+            }
+          // Bricks outside the labelmap are empty now, only their previous surface has to be removed
+          bool brickRemoved = (cache->BrickSurfaces.erase(brickIndex) > 0);
+          if (!brickInLabelmap)
+            {
+            continue;
+            }
+          vtkSmartPointer<vtkPolyData> brickSurface = vtkSmartPointer<vtkPolyData>::New();
+          vtkBinaryLabelmapToClosedSurfaceConversionJob job;
+          job.Labelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+          job.Labelmap->ShallowCopy(orientedBinaryLabelMap);
+          job.LabelValue = labelValue;
+          job.ClosedSurface = brickSurface;
+          // Previously non-empty bricks are more likely to contain many voxels
+          job.NumberOfVoxels = (brickRemoved ? 1 : 0);
+          for (int i = 0; i < 6; ++i)
+            {
+            job.BrickExtent[i] = brickExtent[i];
+            }
+          job.Success = false;
+          jobs.push_back(job);
+          jobBrickIndices.push_back(brickIndex);
+          brickSurfaces.push_back(brickSurface);
+          }
+        }
+      }
+    }
+
+  // ExecuteConversionJobs reorders the jobs, therefore brick surfaces are stored before that
+  for (size_t jobIndex = 0; jobIndex < jobs.size(); ++jobIndex)
+    {
+    cache->BrickSurfaces[jobBrickIndices[jobIndex]] = brickSurfaces[jobIndex];
+    }
+  bool success = this->ExecuteConversionJobs(jobs);
+
+  // Remove the bricks that became empty
+  for (std::map<BrickIndex, vtkSmartPointer<vtkPolyData> >::iterator brickIt = cache->BrickSurfaces.begin();
+    brickIt != cache->BrickSurfaces.end(); )
+    {
+    if (brickIt->second->GetNumberOfPoints() == 0)
+      {
+      cache->BrickSurfaces.erase(brickIt++);
+      continue;
+      }
+    ++brickIt;
+    }
+  for (std::map<BrickIndex, vtkSmartPointer<vtkPolyData> >::iterator brickIt = cache->ProcessedBrickSurfaces.begin();
+    brickIt != cache->ProcessedBrickSurfaces.end(); )
+    {
+    if (cache->BrickSurfaces.find(brickIt->first) == cache->BrickSurfaces.end())
+      {
+      cache->ProcessedBrickSurfaces.erase(brickIt++);
+      continue;
+      }
+    ++brickIt;
+    }
+
+  double decimationFactor = vtkVariant(this->GetConversionParameterValue(GetDecimationFactorParameterName())).ToDouble();
+  double smoothingFactor = vtkVariant(this->GetConversionParameterValue(GetSmoothingFactorParameterName())).ToDouble();
+  if (cache->BrickSurfaces.empty())
+    {
+    cache->ProcessedBrickSurfaces.clear();
+    closedSurfacePolyData->Reset();
+    }
+  else if (decimationFactor > 0.0)
+    {
+    // Decimation is not a local operation: merge the patches of all bricks and then
+    // post-process the whole surface at once, the same way as in Convert
+    cache->ProcessedBrickSurfaces.clear();
+    std::vector<vtkPolyData*> rawPatches;
+    for (std::map<BrickIndex, vtkSmartPointer<vtkPolyData> >::iterator brickIt = cache->BrickSurfaces.begin();
+      brickIt != cache->BrickSurfaces.end(); ++brickIt)
+      {
+      rawPatches.push_back(brickIt->second);
+      }
+    double stageStartTime = vtkTimerLog::GetUniversalTime();
+    vtkNew<vtkPolyData> mergedSurface;
+    std::vector<std::vector<vtkIdType> > mergedPointIds;
+    MergeBrickPatches(rawPatches, rawPatches, mergedSurface.GetPointer(), mergedPointIds);
+    this->AddStageTime(StageMarchingCubes, vtkTimerLog::GetUniversalTime() - stageStartTime);
+    this->PostProcessClosedSurface(mergedSurface.GetPointer(), imageToWorldMatrix.GetPointer(), closedSurfacePolyData);
+    }
+  else
+    {
+    // Smoothing moves a point based on the points within SMOOTHING_ITERATIONS edges of it. An edge of
+    // the marching cubes surface is at most sqrt(2) voxels long, so changes propagate at most
+    // contextSize voxels from the meshed bricks.
+    // The bricks within contextSize voxels are post-processed again, and to get the same result as
+    // when post-processing the whole surface, the bricks within another contextSize voxels are included
+    // in the post-processed region. The result of these outer bricks is not used, as the boundary of
+    // the post-processed region (which is kept fixed by the smoothing) affects them.
+    int contextSize = (smoothingFactor > 0.0 ? (SMOOTHING_ITERATIONS * 3 + 1) / 2 : 0) + 2;
+    int contextBricks = (contextSize + brickSize - 1) / brickSize;
+    int updatedBricks[6] = { 0, -1, 0, -1, 0, -1 };
+    int processedBricks[6] = { 0, -1, 0, -1, 0, -1 };
+    for (int i = 0; i < 3; ++i)
+      {
+      updatedBricks[i * 2] = meshedBricks[i * 2] - contextBricks;
+      updatedBricks[i * 2 + 1] = meshedBricks[i * 2 + 1] + contextBricks;
+      processedBricks[i * 2] = meshedBricks[i * 2] - 2 * contextBricks;
+      processedBricks[i * 2 + 1] = meshedBricks[i * 2 + 1] + 2 * contextBricks;
+      }
+    // The cached result is only used for the bricks outside of the updated range
+    bool updateAllBricks = !cacheValid;
+    for (std::map<BrickIndex, vtkSmartPointer<vtkPolyData> >::iterator brickIt = cache->BrickSurfaces.begin();
+      brickIt != cache->BrickSurfaces.end() && !updateAllBricks; ++brickIt)
+      {
+      if (!IsBrickInRange(brickIt->first, updatedBricks)
+        && cache->ProcessedBrickSurfaces.find(brickIt->first) == cache->ProcessedBrickSurfaces.end())
+        {
+        updateAllBricks = true;
+        }
+      }
+
+    std::vector<BrickIndex> brickIndices;
+    std::vector<vtkPolyData*> rawPatches;
+    std::vector<bool> updatePatch;
+    for (std::map<BrickIndex, vtkSmartPointer<vtkPolyData> >::iterator brickIt = cache->BrickSurfaces.begin();
+      brickIt != cache->BrickSurfaces.end(); ++brickIt)
+      {
+      if (updateAllBricks || IsBrickInRange(brickIt->first, processedBricks))
+        {
+        brickIndices.push_back(brickIt->first);
+        rawPatches.push_back(brickIt->second);
+        updatePatch.push_back(updateAllBricks || IsBrickInRange(brickIt->first, updatedBricks));
+        }
+      }
+    if (!rawPatches.empty())
+      {
+      double stageStartTime = vtkTimerLog::GetUniversalTime();
+      vtkNew<vtkPolyData> mergedSurface;
+      std::vector<std::vector<vtkIdType> > mergedPointIds;
+      MergeBrickPatches(rawPatches, rawPatches, mergedSurface.GetPointer(), mergedPointIds);
+      this->AddStageTime(StageMarchingCubes, vtkTimerLog::GetUniversalTime() - stageStartTime);
+
+      // Smoothing does not change the points or the order of the cells. Normals are computed
+      // after stitching, as their orientation is made consistent over each connected region
+      // of the whole surface.
+      vtkNew<vtkPolyData> processedSurface;
+      this->PostProcessClosedSurface(mergedSurface.GetPointer(), imageToWorldMatrix.GetPointer(),
+        processedSurface.GetPointer(), false);
+      std::vector<vtkSmartPointer<vtkPolyData> > processedPatches;
+      SplitBrickPatches(processedSurface.GetPointer(), rawPatches, mergedPointIds, updatePatch, processedPatches);
+      for (size_t patchIndex = 0; patchIndex < brickIndices.size(); ++patchIndex)
+        {
+        if (updatePatch[patchIndex])
+          {
+          cache->ProcessedBrickSurfaces[brickIndices[patchIndex]] = processedPatches[patchIndex];
+          }
+        }
+      }
+
+    // Stitch the post-processed patches of all bricks into the closed surface. Points are merged
+    // by their position in the raw patches, as the same point may have been post-processed
+    // in different updates.
+    double stageStartTime = vtkTimerLog::GetUniversalTime();
+    std::vector<vtkPolyData*> allRawPatches;
+    std::vector<vtkPolyData*> allProcessedPatches;
+    for (std::map<BrickIndex, vtkSmartPointer<vtkPolyData> >::iterator brickIt = cache->BrickSurfaces.begin();
+      brickIt != cache->BrickSurfaces.end(); ++brickIt)
+      {
+      allRawPatches.push_back(brickIt->second);
+      allProcessedPatches.push_back(cache->ProcessedBrickSurfaces[brickIt->first]);
+      }
+    vtkNew<vtkPolyData> stitchedSurface;
+    std::vector<std::vector<vtkIdType> > stitchedPointIds;
+    MergeBrickPatches(allRawPatches, allProcessedPatches, stitchedSurface.GetPointer(), stitchedPointIds);
+    if (vtkVariant(this->GetConversionParameterValue(GetComputeSurfaceNormalsParameterName())).ToInt() > 0)
+      {
+      this->ComputeSurfaceNormals(stitchedSurface.GetPointer(), closedSurfacePolyData);
+      }
+    else
+      {
+      closedSurfacePolyData->ShallowCopy(stitchedSurface.GetPointer());
+      }
+    this->AddStageTime(StageTransformAndNormals, vtkTimerLog::GetUniversalTime() - stageStartTime);
+    }
+  cache->ClosedSurfaceMTime = closedSurfacePolyData->GetMTime();
+
+  vtkDebugMacro("ConvertModifiedExtent: Updated " << jobs.size() << " of " << cache->BrickSurfaces.size() << " bricks");
+  return success;
+}
+
+//----------------------------------------------------------------------------
+bool vtkBinaryLabelmapToClosedSurfaceConversionRule::ExecuteConversionJobs(std::vector<vtkBinaryLabelmapToClosedSurfaceConversionJob>& jobs)
+{
+  if (jobs.empty())
+    {
+    return true;
+    }
+
+  // Start with the largest labelmaps so that the threads finish at about the same time
+  std::stable_sort(jobs.begin(), jobs.end(), IsLargerJob);
+
+  int numberOfThreads = this->NumberOfThreads;
+  if (numberOfThreads <= 0)
+    {
+    numberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+    }
+  numberOfThreads = std::max(1, std::min(numberOfThreads, static_cast<int>(jobs.size())));
+
+  double startTime = vtkTimerLog::GetUniversalTime();
+  vtkBinaryLabelmapToClosedSurfaceConversionThreadData threadData;
+  threadData.Rule = this;
+  threadData.Jobs = &jobs;
+  threadData.NextJobIndex = 0;
+  if (numberOfThreads == 1)
+    {
+    // Avoid the overhead of starting a thread
+    vtkMultiThreader::ThreadInfo threadInfo;
+    threadInfo.ThreadID = 0;
+    threadInfo.NumberOfThreads = 1;
+    threadInfo.UserData = &threadData;
+    ConvertMultipleThreadFunction(&threadInfo);
+    }
+  else
+    {
+    vtkNew<vtkMultiThreader> threader;
+    threader->SetNumberOfThreads(numberOfThreads);
+    threader->SetSingleMethod(ConvertMultipleThreadFunction, &threadData);
+    threader->SingleMethodExecute();
+    }
+
+  bool success = true;
+  for (std::vector<vtkBinaryLabelmapToClosedSurfaceConversionJob>::iterator jobIt = jobs.begin(); jobIt != jobs.end(); ++jobIt)
+    {
+    success = success && jobIt->Success;
+    }
+  vtkDebugMacro("ExecuteConversionJobs: Converted " << jobs.size() << " labelmaps using " << numberOfThreads << " threads in "
+    << vtkTimerLog::GetUniversalTime() - startTime << "s (crop and pad: " << this->GetStageTime(StageCropAndPad)
+    << "s, marching cubes: " << this->GetStageTime(StageMarchingCubes)
+    << "s, decimation: " << this->GetStageTime(StageDecimation)
+    << "s, smoothing: " << this->GetStageTime(StageSmoothing)
+    << "s, transform and normals: " << this->GetStageTime(StageTransformAndNormals) << "s)");
+  return success;
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkBinaryLabelmapToClosedSurfaceConversionRule::ConvertMultipleThreadFunction(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  vtkBinaryLabelmapToClosedSurfaceConversionThreadData* threadData =
+    static_cast<vtkBinaryLabelmapToClosedSurfaceConversionThreadData*>(threadInfo->UserData);
+  vtkBinaryLabelmapToClosedSurfaceConversionRule* self = threadData->Rule;
+  while (true)
+    {
+    // Take the next job that has not been processed yet
+    self->Lock->Lock();
+    size_t jobIndex = threadData->NextJobIndex++;
+    self->Lock->Unlock();
+    if (jobIndex >= threadData->Jobs->size())
+      {
+      break;
+      }
+    vtkBinaryLabelmapToClosedSurfaceConversionJob& job = (*threadData->Jobs)[jobIndex];
+    job.Success = self->CreateClosedSurface(job.Labelmap, job.LabelValue, job.ClosedSurface,
+      IsExtentValid(job.BrickExtent) ? job.BrickExtent : NULL);
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+bool vtkBinaryLabelmapToClosedSurfaceConversionRule::CreateClosedSurface(vtkOrientedImageData* orientedBinaryLabelMap,
+  int labelValue, vtkPolyData* closedSurfacePolyData, const int brickExtent[6]/*=NULL*/)
+{
+  double stageStartTime = vtkTimerLog::GetUniversalTime();
+  vtkSmartPointer<vtkImageData> binaryLabelMap = orientedBinaryLabelMap;
+
   int *binaryLabelMapExtent = binaryLabelMap->GetExtent();
   if (binaryLabelMapExtent[0] > binaryLabelMapExtent[1]
     || binaryLabelMapExtent[2] > binaryLabelMapExtent[3]
     || binaryLabelMapExtent[4] > binaryLabelMapExtent[5])
     {
     // empty labelmap
-    vtkDebugMacro("Convert: No polygons can be created, input image extent is empty");
     closedSurfacePolyData->Reset();
     return true;
     }
 
-  /// If input labelmap has non-background border voxels, then those regions remain open in the output closed surface.
-  /// This function adds a 1 voxel padding to the labelmap in these cases.
-  bool paddingNecessary = this->IsLabelmapPaddingNecessary(binaryLabelMap);
-  if (paddingNecessary)
+  int outputExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  if (brickExtent)
     {
-    vtkSmartPointer<vtkImageConstantPad> padder = vtkSmartPointer<vtkImageConstantPad>::New();
-    padder->SetInputData(binaryLabelMap);
-    int extent[6] = { 0, -1, 0, -1, 0, -1 };
-    binaryLabelMap->GetExtent(extent);
-    // Set the output extent to the new size
-    padder->SetOutputWholeExtent(extent[0] - 1, extent[1] + 1, extent[2] - 1, extent[3] + 1, extent[4] - 1, extent[5] + 1);
-    padder->Update();
-    binaryLabelMap = padder->GetOutput();
+    // Only the cells of the brick are meshed. Voxels on the brick boundary are shared with
+    // the neighbor bricks, therefore the patches of neighbor bricks have the same points on
+    // their common face.
+    for (int i = 0; i < 6; ++i)
+      {
+      outputExtent[i] = brickExtent[i];
+      }
     }
+  else
+    {
+    // Only process the region that contains non-empty voxels. Typically a segment occupies
+    // a small portion of the labelmap, so this makes all the subsequent steps much faster.
+    int effectiveExtent[6] = { 0, -1, 0, -1, 0, -1 };
+    if (!vtkOrientedImageDataResample::CalculateEffectiveExtent(orientedBinaryLabelMap, effectiveExtent)
+      || !IsExtentValid(effectiveExtent))
+      {
+      // no foreground voxels
+      closedSurfacePolyData->Reset();
+      this->AddStageTime(StageCropAndPad, vtkTimerLog::GetUniversalTime() - stageStartTime);
+      return true;
+      }
+    // Add a 1 voxel padding, otherwise regions touching the boundary would remain open in the output closed surface
+    for (int i = 0; i < 3; ++i)
+      {
+      outputExtent[i * 2] = effectiveExtent[i * 2] - 1;
+      outputExtent[i * 2 + 1] = effectiveExtent[i * 2 + 1] + 1;
+      }
+    }
+
+  // Crop the labelmap to the output extent (voxels outside the labelmap are set to background)
+  vtkSmartPointer<vtkImageConstantPad> padder = vtkSmartPointer<vtkImageConstantPad>::New();
+  padder->SetInputData(binaryLabelMap);
+  padder->SetOutputWholeExtent(outputExtent);
+  // Segments are already processed in parallel, do not start more threads
+  padder->SetNumberOfThreads(1);
+  padder->Update();
+  binaryLabelMap = padder->GetOutput();
+  this->AddStageTime(StageCropAndPad, vtkTimerLog::GetUniversalTime() - stageStartTime);
+
   // Clone labelmap and set identity geometry so that the whole transform can be done in IJK space and then
   // the whole transform can be applied on the poly data to transform it to the world coordinate system
   vtkSmartPointer<vtkImageData> binaryLabelmapWithIdentityGeometry = vtkSmartPointer<vtkImageData>::New();
@@ -158,31 +970,53 @@ bool vtkBinaryLabelmapToClosedSurfaceConversionRule::Convert(vtkDataObject* sour
   binaryLabelmapWithIdentityGeometry->SetOrigin(0, 0, 0);
   binaryLabelmapWithIdentityGeometry->SetSpacing(1.0, 1.0, 1.0);
 
-  // Get conversion parameters
-  double decimationFactor = vtkVariant(this->ConversionParameters[GetDecimationFactorParameterName()].first).ToDouble();
-  double smoothingFactor = vtkVariant(this->ConversionParameters[GetSmoothingFactorParameterName()].first).ToDouble();
-  int computeSurfaceNormals = vtkVariant(this->ConversionParameters[GetComputeSurfaceNormalsParameterName()].first).ToInt();
-
   // Run marching cubes
+  stageStartTime = vtkTimerLog::GetUniversalTime();
   vtkSmartPointer<vtkDiscreteMarchingCubes> marchingCubes = vtkSmartPointer<vtkDiscreteMarchingCubes>::New();
   marchingCubes->SetInputData(binaryLabelmapWithIdentityGeometry);
-  const int labelmapFillValue = binaryLabelmapWithIdentityGeometry->GetScalarRange()[1]; // max value
-  marchingCubes->GenerateValues(1, labelmapFillValue, labelmapFillValue);
+  marchingCubes->GenerateValues(1, labelValue, labelValue);
   marchingCubes->ComputeGradientsOff();
   marchingCubes->ComputeNormalsOff();
   marchingCubes->ComputeScalarsOff();
   marchingCubes->Update();
   vtkSmartPointer<vtkPolyData> processingResult = marchingCubes->GetOutput();
+  this->AddStageTime(StageMarchingCubes, vtkTimerLog::GetUniversalTime() - stageStartTime);
   if (processingResult->GetNumberOfPolys() == 0)
     {
-    vtkDebugMacro("Convert: No polygons can be created, probably all voxels are empty");
+    // No polygons can be created, probably all voxels are empty
     closedSurfacePolyData->Reset();
     return true;
     }
 
+  if (brickExtent)
+    {
+    // Patches of the bricks are post-processed after they are merged, see ConvertModifiedExtent
+    closedSurfacePolyData->ShallowCopy(processingResult);
+    return true;
+    }
+
+  vtkNew<vtkMatrix4x4> labelmapImageToWorldMatrix;
+  orientedBinaryLabelMap->GetImageToWorldMatrix(labelmapImageToWorldMatrix.GetPointer());
+  this->PostProcessClosedSurface(processingResult, labelmapImageToWorldMatrix.GetPointer(), closedSurfacePolyData);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkBinaryLabelmapToClosedSurfaceConversionRule::PostProcessClosedSurface(vtkPolyData* surfaceIjk,
+  vtkMatrix4x4* imageToWorldMatrix, vtkPolyData* closedSurfacePolyData, bool computeNormals/*=true*/)
+{
+  // Get conversion parameters
+  double decimationFactor = vtkVariant(this->GetConversionParameterValue(GetDecimationFactorParameterName())).ToDouble();
+  double smoothingFactor = vtkVariant(this->GetConversionParameterValue(GetSmoothingFactorParameterName())).ToDouble();
+  int computeSurfaceNormals = vtkVariant(this->GetConversionParameterValue(GetComputeSurfaceNormalsParameterName())).ToInt();
+
+  vtkSmartPointer<vtkPolyData> processingResult = surfaceIjk;
+  double stageStartTime = 0.0;
+
   // Decimate
   if (decimationFactor > 0.0)
     {
+    stageStartTime = vtkTimerLog::GetUniversalTime();
     vtkSmartPointer<vtkDecimatePro> decimator = vtkSmartPointer<vtkDecimatePro>::New();
     decimator->SetInputData(processingResult);
     decimator->SetFeatureAngle(60);
@@ -192,13 +1026,15 @@ bool vtkBinaryLabelmapToClosedSurfaceConversionRule::Convert(vtkDataObject* sour
     decimator->SetTargetReduction(decimationFactor);
     decimator->Update();
     processingResult = decimator->GetOutput();
+    this->AddStageTime(StageDecimation, vtkTimerLog::GetUniversalTime() - stageStartTime);
     }
 
   if (smoothingFactor>0)
     {
+    stageStartTime = vtkTimerLog::GetUniversalTime();
     vtkSmartPointer<vtkWindowedSincPolyDataFilter> smoother = vtkSmartPointer<vtkWindowedSincPolyDataFilter>::New();
     smoother->SetInputData(processingResult);
-    smoother->SetNumberOfIterations(20); // based on VTK documentation ("Ten or twenty iterations is all the is usually necessary")
+    smoother->SetNumberOfIterations(SMOOTHING_ITERATIONS); // based on VTK documentation ("Ten or twenty iterations is all the is usually necessary")
     // This formula maps 0.0 -> 1.0 (almost no smoothing), 0.25 -> 0.01 (average smoothing),
     // 0.5 -> 0.001 (more smoothing), 1.0 -> 0.0001 (very strong smoothing).
     double passBand = pow(10.0, -4.0*smoothingFactor);
@@ -209,35 +1045,42 @@ bool vtkBinaryLabelmapToClosedSurfaceConversionRule::Convert(vtkDataObject* sour
     smoother->NormalizeCoordinatesOn();
     smoother->Update();
     processingResult = smoother->GetOutput();
+    this->AddStageTime(StageSmoothing, vtkTimerLog::GetUniversalTime() - stageStartTime);
     }
 
   // Transform the result surface from labelmap IJK to world coordinate system
+  stageStartTime = vtkTimerLog::GetUniversalTime();
   vtkSmartPointer<vtkTransform> labelmapGeometryTransform = vtkSmartPointer<vtkTransform>::New();
-  vtkSmartPointer<vtkMatrix4x4> labelmapImageToWorldMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  orientedBinaryLabelMap->GetImageToWorldMatrix(labelmapImageToWorldMatrix);
-  labelmapGeometryTransform->SetMatrix(labelmapImageToWorldMatrix);
+  labelmapGeometryTransform->SetMatrix(imageToWorldMatrix);
 
   vtkSmartPointer<vtkTransformPolyDataFilter> transformPolyDataFilter = vtkSmartPointer<vtkTransformPolyDataFilter>::New();
   transformPolyDataFilter->SetInputData(processingResult);
   transformPolyDataFilter->SetTransform(labelmapGeometryTransform);
 
-  if (computeSurfaceNormals>0)
+  transformPolyDataFilter->Update();
+  if (computeNormals && computeSurfaceNormals>0)
     {
-    vtkSmartPointer<vtkPolyDataNormals> polyDataNormals = vtkSmartPointer<vtkPolyDataNormals>::New();
-    polyDataNormals->SetInputConnection(transformPolyDataFilter->GetOutputPort());
-    polyDataNormals->ConsistencyOn(); // discrete marching cubes may generate inconsistent surface
-    // We almost always perform smoothing, so splitting would not be able to preserve any sharp features
-    // (and sharp edges would look like artifacts in the smooth surface).
-    polyDataNormals->SplittingOff();
-    polyDataNormals->Update();
-    closedSurfacePolyData->ShallowCopy(polyDataNormals->GetOutput());
+    this->ComputeSurfaceNormals(transformPolyDataFilter->GetOutput(), closedSurfacePolyData);
     }
   else
     {
-    transformPolyDataFilter->Update();
     closedSurfacePolyData->ShallowCopy(transformPolyDataFilter->GetOutput());
     }
-  return true;
+  this->AddStageTime(StageTransformAndNormals, vtkTimerLog::GetUniversalTime() - stageStartTime);
+}
+
+//----------------------------------------------------------------------------
+void vtkBinaryLabelmapToClosedSurfaceConversionRule::ComputeSurfaceNormals(vtkPolyData* surface,
+  vtkPolyData* closedSurfacePolyData)
+{
+  vtkSmartPointer<vtkPolyDataNormals> polyDataNormals = vtkSmartPointer<vtkPolyDataNormals>::New();
+  polyDataNormals->SetInputData(surface);
+  polyDataNormals->ConsistencyOn(); // discrete marching cubes may generate inconsistent surface
+  // We almost always perform smoothing, so splitting would not be able to preserve any sharp features
+  // (and sharp edges would look like artifacts in the smooth surface).
+  polyDataNormals->SplittingOff();
+  polyDataNormals->Update();
+  closedSurfacePolyData->ShallowCopy(polyDataNormals->GetOutput());
 }
 
 //----------------------------------------------------------------------------
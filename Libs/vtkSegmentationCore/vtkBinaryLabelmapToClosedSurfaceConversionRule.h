@@ -27,11 +27,21 @@
 
 #include "vtkSegmentationCoreConfigure.h"
 
+// VTK includes
+#include <vtkMultiThreader.h>
+
+class vtkMatrix4x4;
+class vtkOrientedImageData;
+class vtkPolyData;
+class vtkSimpleCriticalSection;
+struct vtkBinaryLabelmapToClosedSurfaceConversionJob;
+
 /// \ingroup SegmentationCore
 /// \brief Convert binary labelmap representation (vtkOrientedImageData type) to
 ///   closed surface representation (vtkPolyData type). The conversion algorithm
 ///   performs a marching cubes operation on the image data followed by an optional
-///   decimation step.
+///   decimation step. Each labelmap is cropped to its non-empty extent before the
+///   marching cubes step, and multiple segments are converted in parallel.
 class vtkSegmentationCore_EXPORT vtkBinaryLabelmapToClosedSurfaceConversionRule
   : public vtkSegmentationConverterRule
 {
@@ -43,6 +53,17 @@ public:
   /// Conversion parameter: compute surface normals
   static const std::string GetComputeSurfaceNormalsParameterName() { return "Compute surface normals"; };
 
+  /// Processing stages of the conversion, used for reporting the time spent in each stage
+  enum ConversionStage
+    {
+    StageCropAndPad = 0,
+    StageMarchingCubes,
+    StageDecimation,
+    StageSmoothing,
+    StageTransformAndNormals,
+    StageLast // must be last
+    };
+
 public:
   static vtkBinaryLabelmapToClosedSurfaceConversionRule* New();
   vtkTypeMacro(vtkBinaryLabelmapToClosedSurfaceConversionRule, vtkSegmentationConverterRule);
@@ -61,6 +82,28 @@ public:
   /// Update the target representation based on the source representation
   virtual bool Convert(vtkDataObject* sourceRepresentation, vtkDataObject* targetRepresentation);
 
+  /// Update the target representation from a labelmap shared between multiple segments.
+  /// The surface is generated directly from the shared labelmap, without extracting the segment.
+  virtual bool ConvertSharedLabelmap(vtkDataObject* sourceRepresentation, int labelValue, vtkDataObject* targetRepresentation);
+
+  /// Update multiple target representations. Segments are distributed between NumberOfThreads threads,
+  /// largest labelmaps first, and each segment is processed by a single thread.
+  virtual bool ConvertMultiple(const std::vector<vtkDataObject*>& sourceRepresentations, const std::vector<int>& labelValues,
+    const std::vector<vtkDataObject*>& targetRepresentations);
+
+  /// Update the target representation after the source labelmap was modified within modifiedExtent.
+  /// The labelmap is divided into bricks of BrickSize voxels, and only the surface of the bricks that
+  /// intersect the modified extent is generated again. The surface of the other bricks is kept from the
+  /// previous update. If the target was not created by this method or conversion parameters changed
+  /// since then, then the surface of all bricks is generated.
+  /// The post-processed surface of each brick is cached as well. After an update, only the bricks near
+  /// the meshed bricks are smoothed again and their normals recomputed, with enough neighbor bricks around
+  /// them that the result is the same as post-processing the whole surface (see \sa Convert). The patches
+  /// are then stitched into the closed surface. If decimation is enabled, then the merged patches are
+  /// post-processed as a whole, as decimation is not a local operation.
+  virtual bool ConvertModifiedExtent(vtkDataObject* sourceRepresentation, int labelValue, const int modifiedExtent[6],
+    vtkDataObject* targetRepresentation);
+
   /// Get the cost of the conversion.
   virtual unsigned int GetConversionCost(vtkDataObject* sourceRepresentation=NULL, vtkDataObject* targetRepresentation=NULL);
 
@@ -73,11 +116,70 @@ public:
   /// Human-readable name of the target representation
   virtual const char* GetTargetRepresentationName() { return vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName(); };
 
+  /// Maximum number of threads used in \sa ConvertMultiple.
+  /// If 0 (default) then the global default number of threads of vtkMultiThreader is used.
+  vtkSetMacro(NumberOfThreads, int);
+  vtkGetMacro(NumberOfThreads, int);
+
+  /// Size of the bricks (number of voxels along each axis) that are meshed separately in
+  /// \sa ConvertModifiedExtent. Default is 32.
+  vtkSetMacro(BrickSize, int);
+  vtkGetMacro(BrickSize, int);
+
+  /// Get the total time (in seconds) spent in a conversion stage since the last \sa ResetStageTimes.
+  /// When multiple threads are used then the times of all threads are summed.
+  double GetStageTime(int stage);
+  /// Get human-readable name of a conversion stage
+  static const char* GetStageName(int stage);
+  /// Reset the time measurements of all conversion stages
+  void ResetStageTimes();
+
+  virtual void PrintSelf(ostream& os, vtkIndent indent);
+
 protected:
   /// If input labelmap has non-background border voxels, then those regions remain open in the output closed surface.
   /// This function checks whether this is the case.
   bool IsLabelmapPaddingNecessary(vtkImageData* binaryLabelMap);
 
+  /// Generate the closed surface of the voxels that have labelValue in the labelmap
+  /// The labelmap is cropped to its effective extent. If brickExtent is specified then only the cells within
+  /// that point extent are processed and the output is the raw marching cubes surface in IJK coordinates
+  /// (see \sa PostProcessClosedSurface). Can be called from multiple threads at the same time.
+  bool CreateClosedSurface(vtkOrientedImageData* orientedBinaryLabelMap, int labelValue, vtkPolyData* closedSurfacePolyData,
+    const int brickExtent[6]=NULL);
+
+  /// Decimate and smooth a marching cubes surface, transform it from IJK to world coordinates
+  /// and compute its normals, as specified by the conversion parameters. Without decimation,
+  /// the points of the surface and the order of its cells are preserved.
+  /// If computeNormals is false then normals are not computed regardless of the parameters.
+  void PostProcessClosedSurface(vtkPolyData* surfaceIjk, vtkMatrix4x4* imageToWorldMatrix, vtkPolyData* closedSurfacePolyData,
+    bool computeNormals=true);
+
+  /// Compute point normals of a closed surface. Polygons are reoriented to be consistent within
+  /// each connected region, so the normals must be computed on the whole surface.
+  void ComputeSurfaceNormals(vtkPolyData* surface, vtkPolyData* closedSurfacePolyData);
+
+  /// Run conversion jobs using multiple threads
+  bool ExecuteConversionJobs(std::vector<vtkBinaryLabelmapToClosedSurfaceConversionJob>& jobs);
+
+  /// Get conversion parameter value without modifying the parameter list (can be called from multiple threads)
+  std::string GetConversionParameterValue(const std::string& name);
+
+  /// Add elapsed time to a conversion stage (thread safe)
+  void AddStageTime(int stage, double elapsedTimeSec);
+
+  /// Thread function of \sa ConvertMultiple
+  static VTK_THREAD_RETURN_TYPE ConvertMultipleThreadFunction(void* arg);
+
+protected:
+  int NumberOfThreads;
+  int BrickSize;
+  double StageTimes[StageLast];
+  vtkSimpleCriticalSection* Lock;
+
+  class vtkInternal;
+  vtkInternal* Internal;
+
 protected:
   vtkBinaryLabelmapToClosedSurfaceConversionRule();
   ~vtkBinaryLabelmapToClosedSurfaceConversionRule();
@@ -1313,3 +1313,85 @@ void vtkOrientedImageDataResample::FillImage(vtkImageData* image, double fillVal
     vtkGenericWarningMacro("vtkOrientedImageDataResample::FillImage: Unknown ScalarType");
     }
 }
+
+//----------------------------------------------------------------------------
+template <typename T> void ExtractLabelGeneric(vtkImageData* inputImage, T labelValue, vtkImageData* outputImage)
+{
+  T* inputPtr = static_cast<T*>(inputImage->GetScalarPointer());
+  T* outputPtr = static_cast<T*>(outputImage->GetScalarPointer());
+  if (!inputPtr || !outputPtr)
+    {
+    return;
+    }
+  vtkIdType numberOfVoxels = inputImage->GetNumberOfPoints();
+  for (vtkIdType i = 0; i < numberOfVoxels; ++i)
+    {
+    outputPtr[i] = (inputPtr[i] == labelValue ? 1 : 0);
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkOrientedImageDataResample::ExtractLabel(vtkOrientedImageData* inputImage, int labelValue, vtkOrientedImageData* outputImage)
+{
+  if (!inputImage || !outputImage || inputImage == outputImage)
+    {
+    vtkGenericWarningMacro("vtkOrientedImageDataResample::ExtractLabel: Invalid inputs");
+    return false;
+    }
+  if (inputImage->GetPointData() == NULL || inputImage->GetPointData()->GetScalars() == NULL
+    || inputImage->GetNumberOfScalarComponents() != 1)
+    {
+    vtkGenericWarningMacro("vtkOrientedImageDataResample::ExtractLabel: Input image must have a single scalar component");
+    return false;
+    }
+
+  outputImage->SetExtent(inputImage->GetExtent());
+  vtkSmartPointer<vtkMatrix4x4> imageToWorldMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  inputImage->GetImageToWorldMatrix(imageToWorldMatrix);
+  outputImage->SetImageToWorldMatrix(imageToWorldMatrix);
+  outputImage->AllocateScalars(inputImage->GetScalarType(), 1);
+
+  switch (inputImage->GetScalarType())
+    {
+    vtkTemplateMacro(ExtractLabelGeneric<VTK_TT>(inputImage, static_cast<VTK_TT>(labelValue), outputImage));
+  default:
+    vtkGenericWarningMacro("vtkOrientedImageDataResample::ExtractLabel: Unknown ScalarType");
+    return false;
+    }
+  outputImage->Modified();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+template <typename T> void ReplaceLabelGeneric(vtkImageData* image, T labelValue, T newValue)
+{
+  T* imagePtr = static_cast<T*>(image->GetScalarPointer());
+  if (!imagePtr)
+    {
+    return;
+    }
+  vtkIdType numberOfScalars = image->GetNumberOfPoints() * image->GetNumberOfScalarComponents();
+  for (vtkIdType i = 0; i < numberOfScalars; ++i)
+    {
+    if (imagePtr[i] == labelValue)
+      {
+      imagePtr[i] = newValue;
+      }
+    }
+  image->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkOrientedImageDataResample::ReplaceLabel(vtkImageData* image, int labelValue, int newValue)
+{
+  if (!image || image->GetPointData() == NULL || image->GetPointData()->GetScalars() == NULL)
+    {
+    return;
+    }
+  switch (image->GetScalarType())
+    {
+    vtkTemplateMacro(ReplaceLabelGeneric<VTK_TT>(image, static_cast<VTK_TT>(labelValue), static_cast<VTK_TT>(newValue)));
+  default:
+    vtkGenericWarningMacro("vtkOrientedImageDataResample::ReplaceLabel: Unknown ScalarType");
+    }
+}
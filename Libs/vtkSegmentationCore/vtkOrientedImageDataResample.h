@@ -100,6 +100,14 @@ public:
   /// \param extent The whole extent is filled if extent is not specified
   static void FillImage(vtkImageData* image, double fillValue, const int extent[6]=NULL);
 
+  /// Creates a binary labelmap from the voxels of a multi-label image that have the specified value.
+  /// Output voxels are 1 where the input voxel is labelValue and 0 elsewhere.
+  /// Geometry, extent, and scalar type of the output are the same as the input.
+  static bool ExtractLabel(vtkOrientedImageData* inputImage, int labelValue, vtkOrientedImageData* outputImage);
+
+  /// Replaces all voxels that have labelValue with newValue in-place
+  static void ReplaceLabel(vtkImageData* image, int labelValue, int newValue);
+
 public:
   /// Calculate effective extent of an image: the IJK extent where non-zero voxels are located
   static bool CalculateEffectiveExtent(vtkOrientedImageData* image, int effectiveExtent[6]);
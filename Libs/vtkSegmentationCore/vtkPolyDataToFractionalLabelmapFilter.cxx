@@ -27,6 +27,7 @@
 
 // VTK includes
 #include <vtkTransform.h>
+#include <vtkCriticalSection.h>
 #include <vtkImageStencilData.h>
 #include <vtkPolyData.h>
 #include <vtkInformation.h>
@@ -35,28 +36,46 @@
 #include <vtkTransformPolyDataFilter.h>
 #include <vtkNew.h>
 #include <vtkPolyDataNormals.h>
+#include <vtkTimerLog.h>
 #include <vtkTriangleFilter.h>
-#include <vtkStripper.h>
-#include <vtkImageStencil.h>
-#include <vtkImageCast.h>
 
 // std includes
+#include <algorithm>
+#include <cmath>
 #include <map>
 
 vtkStandardNewMacro(vtkPolyDataToFractionalLabelmapFilter);
 
+//----------------------------------------------------------------------------
+struct vtkPolyDataToFractionalLabelmapThreadData
+{
+  vtkPolyDataToFractionalLabelmapFilter* Filter;
+  /// Closed surface in IJK coordinates
+  vtkPolyData* ClosedSurface;
+  /// Closed surface of each thread, used for polyline input.
+  /// Thread 0 uses ClosedSurface, the other threads use their own deep copy.
+  std::vector<vtkSmartPointer<vtkPolyData> > ThreadClosedSurfaces;
+  /// Point coordinates of the closed surface (3 values per point)
+  std::vector<double> Points;
+  /// Point ids of the triangles of the closed surface (3 values per triangle)
+  std::vector<vtkIdType> TrianglePointIds;
+  /// Ids of the triangles that may intersect the cutting planes of an output slice.
+  /// Triangles of slice idxZ are stored from SliceTriangleOffsets[idxZ-Extent[4]]
+  /// to SliceTriangleOffsets[idxZ-Extent[4]+1] in SliceTriangleIds.
+  std::vector<vtkIdType> SliceTriangleOffsets;
+  std::vector<vtkIdType> SliceTriangleIds;
+  FRACTIONAL_DATA_TYPE* OutputPointer;
+  int Extent[6];
+  int NextSliceIndex;
+  int NumberOfCompletedSlices;
+};
+
 //----------------------------------------------------------------------------
 vtkPolyDataToFractionalLabelmapFilter::vtkPolyDataToFractionalLabelmapFilter()
 {
   this->NumberOfOffsets = 6;
-
-  this->LinesCache = std::map<double, vtkSmartPointer<vtkCellArray> >();
-  this->SliceCache = std::map<double, vtkSmartPointer<vtkPolyData> >();
-  this->PointIdsCache = std::map<double, vtkIdType*>();
-  this->NptsCache = std::map<double, vtkIdType>();
-  this->PointNeighborCountsCache = std::map<double,  vtkSmartPointer<vtkIdTypeArray> >();
-
-  this->CellLocator = vtkCellLocator::New();
+  this->NumberOfThreads = 0;
+  this->Lock = new vtkSimpleCriticalSection();
 
   this->OutputImageTransformData = vtkOrientedImageData::New();
 
@@ -72,7 +91,7 @@ vtkPolyDataToFractionalLabelmapFilter::vtkPolyDataToFractionalLabelmapFilter()
 vtkPolyDataToFractionalLabelmapFilter::~vtkPolyDataToFractionalLabelmapFilter()
 {
   this->OutputImageTransformData->Delete();
-  this->CellLocator->Delete();
+  delete this->Lock;
 }
 
 //----------------------------------------------------------------------------
@@ -163,7 +182,7 @@ public:
   // if a new point was added to the locator.  The values i0, i1, v0, v1
   // are the edge endpoints and scalar values, respectively.
   bool InterpolateEdge(
-    vtkPoints *inPoints, vtkPoints *outPoints,
+    const double *inPoints, vtkPoints *outPoints,
     vtkIdType i0, vtkIdType i1, double v0, double v1,
     vtkIdType &i);
 };
@@ -229,7 +248,7 @@ bool EdgeLocator::InsertUniqueEdge(
 }
 
 bool EdgeLocator::InterpolateEdge(
-  vtkPoints *points, vtkPoints *outPoints,
+  const double *points, vtkPoints *outPoints,
   vtkIdType i0, vtkIdType i1, double v0, double v1,
   vtkIdType &i)
 {
@@ -254,9 +273,9 @@ bool EdgeLocator::InterpolateEdge(
     }
 
   // Get the edge and interpolate the new point
-  double p0[3], p1[3], p[3];
-  points->GetPoint(i0, p0);
-  points->GetPoint(i1, p1);
+  const double* p0 = points + 3*i0;
+  const double* p1 = points + 3*i1;
+  double p[3];
 
   double f = v0/(v0 - v1);
   double s = 1.0 - f;
@@ -334,6 +353,12 @@ void vtkPolyDataToFractionalLabelmapFilter::SetOutputSpacing(double x, double y,
   this->OutputImageTransformData->SetSpacing(x, y, z);
 }
 
+//----------------------------------------------------------------------------
+void vtkPolyDataToFractionalLabelmapFilter::DeleteCache()
+{
+  // Slices are no longer cached between updates, there is nothing to delete.
+}
+
 
 //----------------------------------------------------------------------------
 vtkOrientedImageData* vtkPolyDataToFractionalLabelmapFilter::AllocateOutputData(
@@ -410,480 +435,505 @@ int vtkPolyDataToFractionalLabelmapFilter::RequestData(
   // Make sure that we have a clean triangle polydata
   vtkNew<vtkTriangleFilter> triangle;
   triangle->SetInputConnection(normalFilter->GetOutputPort());
-
-  // Convert to triangle strip
-  vtkSmartPointer<vtkStripper> stripper = vtkSmartPointer<vtkStripper>::New();
-  stripper->SetInputConnection(triangle->GetOutputPort());
-  stripper->Update();
+  triangle->Update();
 
   // PolyData of the closed surface in IJK space
-  vtkSmartPointer<vtkPolyData> transformedClosedSurface = stripper->GetOutput();
-
-  this->CellLocator->SetDataSet(transformedClosedSurface);
-  this->CellLocator->BuildLocator();
+  vtkSmartPointer<vtkPolyData> transformedClosedSurface = triangle->GetOutput();
 
   int extent[6];
   outputData->GetExtent(extent);
+  if (extent[0] > extent[1] || extent[2] > extent[3] || extent[4] > extent[5]
+    || transformedClosedSurface->GetNumberOfPoints() == 0)
+    {
+    return 1;
+    }
 
-  vtkSmartPointer<vtkImageData> emptyImageData = vtkSmartPointer<vtkImageData>::New();
-  emptyImageData->SetExtent(extent);
-  emptyImageData->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
-
-  void* emptyImageDataPointer = emptyImageData->GetScalarPointerForExtent(emptyImageData->GetExtent());
-  if (!emptyImageDataPointer)
-  {
-    vtkErrorMacro("Convert: Failed to allocate memory for output labelmap image!");
-    return false;
-  }
-  else
-  {
-    memset(emptyImageDataPointer, 0, ((extent[1]-extent[0]+1)*(extent[3]-extent[2]+1)*(extent[5]-extent[4]+1) * emptyImageData->GetScalarSize() * emptyImageData->GetNumberOfScalarComponents()));
-  }
-
+  vtkPolyDataToFractionalLabelmapThreadData threadData;
+  threadData.Filter = this;
+  threadData.ClosedSurface = transformedClosedSurface;
+  threadData.OutputPointer = static_cast<FRACTIONAL_DATA_TYPE*>(outputData->GetScalarPointerForExtent(extent));
+  for (int i = 0; i < 6; ++i)
+    {
+    threadData.Extent[i] = extent[i];
+    }
+  threadData.NextSliceIndex = 0;
+  threadData.NumberOfCompletedSlices = 0;
+
+  // Copy the points and triangles to flat arrays, so that they can be
+  // accessed from multiple threads without going through vtkPolyData
+  vtkPoints* points = transformedClosedSurface->GetPoints();
+  vtkIdType numberOfPoints = points->GetNumberOfPoints();
+  threadData.Points.resize(3 * numberOfPoints);
+  for (vtkIdType pointId = 0; pointId < numberOfPoints; ++pointId)
+    {
+    points->GetPoint(pointId, &threadData.Points[3 * pointId]);
+    }
+  vtkCellArray* polys = transformedClosedSurface->GetPolys();
+  threadData.TrianglePointIds.reserve(3 * polys->GetNumberOfCells());
+  vtkIdType npts = 0;
+  vtkIdType *pointIds = 0;
+  vtkIdType count = polys->GetNumberOfConnectivityEntries();
+  for (vtkIdType loc = 0; loc < count; loc += npts + 1)
+    {
+    polys->GetCell(loc, npts, pointIds);
+    if (npts == 3)
+      {
+      threadData.TrianglePointIds.insert(threadData.TrianglePointIds.end(), pointIds, pointIds + 3);
+      }
+    }
+  vtkIdType numberOfTriangles = static_cast<vtkIdType>(threadData.TrianglePointIds.size() / 3);
 
-  // The magnitude of the offset step size ( n-1 / 2n )
+  // Sort the triangles into the output slices whose cutting planes they may intersect.
+  // Cutting planes of slice idxZ are within idxZ +/- offsetStepSize. The range is
+  // rounded outwards, triangles that do not intersect a plane are skipped by the cutter.
   double offsetStepSize = (double)(this->NumberOfOffsets-1.0)/(2 * this->NumberOfOffsets);
-
-  vtkSmartPointer<vtkImageStencilData> imageStencilData = vtkSmartPointer<vtkImageStencilData>::New();
-  imageStencilData->SetExtent(extent);
-  imageStencilData->SetSpacing(1.0, 1.0, 1.0);
-
-  vtkNew<vtkImageStencil> imageStencil;
-  imageStencil->SetInputData(emptyImageData);
-  imageStencil->SetStencilData(imageStencilData);
-  imageStencil->ReverseStencilOn();
-  imageStencil->SetBackgroundValue(1); // General foreground value is 1 (background value because of reverse stencil)
-
-  vtkNew<vtkImageCast> imageCast;
-  imageCast->SetInputConnection(imageStencil->GetOutputPort());
-  imageCast->SetOutputScalarTypeToUnsignedChar();
-
-  // Iterate through "NumberOfOffsets" in each of the dimensions and create a binary labelmap at each offset
-  for (int k = 0; k < this->NumberOfOffsets; ++k)
-  {
-    double kOffset = ( (double) k / this->NumberOfOffsets - offsetStepSize );
-
-    for (int j = 0; j < this->NumberOfOffsets; ++j)
+  int numberOfSlices = extent[5] - extent[4] + 1;
+  std::vector<int> triangleSliceRanges(2 * numberOfTriangles);
+  threadData.SliceTriangleOffsets.assign(numberOfSlices + 1, 0);
+  for (vtkIdType triangleId = 0; triangleId < numberOfTriangles; ++triangleId)
     {
-      double jOffset = ( (double) j / this->NumberOfOffsets - offsetStepSize );
-
-      for (int i = 0; i < this->NumberOfOffsets; ++i)
+    const vtkIdType* trianglePointIds = &threadData.TrianglePointIds[3 * triangleId];
+    double zMin = threadData.Points[3 * trianglePointIds[0] + 2];
+    double zMax = zMin;
+    for (int i = 1; i < 3; ++i)
       {
-        double iOffset = ( (double) i / this->NumberOfOffsets - offsetStepSize );
-
-        // Create stencil for the current binary labelmap offset
-        imageStencilData->AllocateExtents();
-        imageStencilData->SetOrigin(iOffset, jOffset, kOffset);
-        this->FillImageStencilData(imageStencilData, transformedClosedSurface, extent);
-
-        // Save result to output
-        imageCast->Update();
-        this->AddBinaryLabelMapToFractionalLabelMap(imageCast->GetOutput(), outputData);
+      double z = threadData.Points[3 * trianglePointIds[i] + 2];
+      zMin = std::min(zMin, z);
+      zMax = std::max(zMax, z);
+      }
+    int firstSliceIndex = std::max(0, static_cast<int>(floor(zMin - offsetStepSize)) - extent[4]);
+    int lastSliceIndex = std::min(numberOfSlices - 1, static_cast<int>(ceil(zMax + offsetStepSize)) - extent[4]);
+    triangleSliceRanges[2 * triangleId] = firstSliceIndex;
+    triangleSliceRanges[2 * triangleId + 1] = lastSliceIndex;
+    for (int sliceIndex = firstSliceIndex; sliceIndex <= lastSliceIndex; ++sliceIndex)
+      {
+      threadData.SliceTriangleOffsets[sliceIndex + 1]++;
+      }
+    }
+  for (int sliceIndex = 0; sliceIndex < numberOfSlices; ++sliceIndex)
+    {
+    threadData.SliceTriangleOffsets[sliceIndex + 1] += threadData.SliceTriangleOffsets[sliceIndex];
+    }
+  threadData.SliceTriangleIds.resize(threadData.SliceTriangleOffsets[numberOfSlices]);
+  std::vector<vtkIdType> sliceTriangleEnds(threadData.SliceTriangleOffsets.begin(), threadData.SliceTriangleOffsets.end() - 1);
+  for (vtkIdType triangleId = 0; triangleId < numberOfTriangles; ++triangleId)
+    {
+    for (int sliceIndex = triangleSliceRanges[2 * triangleId]; sliceIndex <= triangleSliceRanges[2 * triangleId + 1]; ++sliceIndex)
+      {
+      threadData.SliceTriangleIds[sliceTriangleEnds[sliceIndex]++] = triangleId;
+      }
+    }
 
-        this->UpdateProgress(((i+1)*(j+1)*(k+1))/(this->NumberOfOffsets*this->NumberOfOffsets*this->NumberOfOffsets));
+  int numberOfThreads = this->NumberOfThreads;
+  if (numberOfThreads <= 0)
+    {
+    numberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+    }
+  numberOfThreads = std::max(1, std::min(numberOfThreads, numberOfSlices));
+  if (numberOfTriangles == 0)
+    {
+    // Polyline input is cut by vtkPolyDataToImageStencil::PolyDataSelector,
+    // which traverses the cells of the polydata. Each thread gets its own
+    // copy, so that no polydata is accessed from more than one thread.
+    threadData.ThreadClosedSurfaces.push_back(transformedClosedSurface);
+    for (int threadId = 1; threadId < numberOfThreads; ++threadId)
+      {
+      vtkSmartPointer<vtkPolyData> threadClosedSurface = vtkSmartPointer<vtkPolyData>::New();
+      threadClosedSurface->DeepCopy(transformedClosedSurface);
+      threadData.ThreadClosedSurfaces.push_back(threadClosedSurface);
+      }
+    }
 
-      } // i
-    } // j
-  } // k
+  double startTime = vtkTimerLog::GetUniversalTime();
+  if (numberOfThreads == 1)
+    {
+    // Avoid the overhead of starting a thread
+    vtkMultiThreader::ThreadInfo threadInfo;
+    threadInfo.ThreadID = 0;
+    threadInfo.NumberOfThreads = 1;
+    threadInfo.UserData = &threadData;
+    FillSlicesThreadFunction(&threadInfo);
+    }
+  else
+    {
+    vtkNew<vtkMultiThreader> threader;
+    threader->SetNumberOfThreads(numberOfThreads);
+    threader->SetSingleMethod(FillSlicesThreadFunction, &threadData);
+    threader->SingleMethodExecute();
+    }
+  vtkDebugMacro("RequestData: Filled " << numberOfSlices << " slices using " << numberOfThreads << " threads in "
+    << vtkTimerLog::GetUniversalTime() - startTime << "s");
 
   return 1;
 }
 
 //----------------------------------------------------------------------------
-void vtkPolyDataToFractionalLabelmapFilter::AddBinaryLabelMapToFractionalLabelMap(vtkImageData* binaryLabelMap, vtkImageData* fractionalLabelMap)
+VTK_THREAD_RETURN_TYPE vtkPolyDataToFractionalLabelmapFilter::FillSlicesThreadFunction(void* arg)
 {
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  vtkPolyDataToFractionalLabelmapThreadData* threadData =
+    static_cast<vtkPolyDataToFractionalLabelmapThreadData*>(threadInfo->UserData);
+  vtkPolyDataToFractionalLabelmapFilter* self = threadData->Filter;
+  int numberOfSlices = threadData->Extent[5] - threadData->Extent[4] + 1;
+  vtkSmartPointer<vtkImageStencilData> stencil = vtkSmartPointer<vtkImageStencilData>::New();
+  while (true)
+    {
+    // Take the next slice that has not been processed yet
+    self->Lock->Lock();
+    int sliceIndex = threadData->NextSliceIndex++;
+    self->Lock->Unlock();
+    if (sliceIndex >= numberOfSlices)
+      {
+      break;
+      }
+    self->FillSlice(threadData, threadInfo->ThreadID, threadData->Extent[4] + sliceIndex, stencil);
 
-  if (!binaryLabelMap)
-  {
-    vtkErrorMacro("AddBinaryLabelMapToFractionalLabelMap: Invalid vtkImageData!");
-    return;
-  }
-
-  if (!fractionalLabelMap)
-  {
-    vtkErrorMacro("AddBinaryLabelMapToFractionalLabelMap: Invalid vtkImageData!");
-    return;
-  }
-
-  int binaryExtent[6] = {0,-1,0,-1,0,-1};
-  binaryLabelMap->GetExtent(binaryExtent);
-
-  int fractionalExtent[6] = {0,-1,0,-1,0,-1};
-  fractionalLabelMap->GetExtent(fractionalExtent);
-
-  // Get points to the extent in both the binary and fractional labelmaps
-  char* binaryLabelMapPointer = (char*)binaryLabelMap->GetScalarPointerForExtent(binaryExtent);
-  FRACTIONAL_DATA_TYPE* fractionalLabelMapPointer = (FRACTIONAL_DATA_TYPE*)fractionalLabelMap->GetScalarPointerForExtent(fractionalExtent);
-
-  int dimensions[6] = {0,0,0};
-  fractionalLabelMap->GetDimensions(dimensions);
-
-  int numberOfVoxels = dimensions[0]*dimensions[1]*dimensions[2];
-
-  for (int i = 0; i < numberOfVoxels; ++i)
-  {
-    (*fractionalLabelMapPointer) += (*binaryLabelMapPointer) * FRACTIONAL_STEP_SIZE;
-    ++binaryLabelMapPointer;
-    ++fractionalLabelMapPointer;
-  }
-
+    self->Lock->Lock();
+    int numberOfCompletedSlices = ++threadData->NumberOfCompletedSlices;
+    self->Lock->Unlock();
+    if (threadInfo->ThreadID == 0)
+      {
+      // Thread 0 runs in the calling thread, so observers can be invoked safely
+      self->UpdateProgress(static_cast<double>(numberOfCompletedSlices) / numberOfSlices);
+      }
+    }
+  return VTK_THREAD_RETURN_VALUE;
 }
 
 //----------------------------------------------------------------------------
-void vtkPolyDataToFractionalLabelmapFilter::FillImageStencilData(
-  vtkImageStencilData *data, vtkPolyData* closedSurface,
-  int extent[6])
+void vtkPolyDataToFractionalLabelmapFilter::FillSlice(
+  vtkPolyDataToFractionalLabelmapThreadData* threadData, int threadId, int idxZ, vtkImageStencilData* stencil)
 {
   // Description of algorithm:
-  // 1) cut the polydata at each z slice to create polylines
+  // 1) cut the polydata at each z offset of the slice to create polylines
   // 2) find all "loose ends" and connect them to make polygons
   //    (if the input polydata is closed, there will be no loose ends)
-  // 3) go through all line segments, and for each integer y value on
-  //    a line segment, store the x value at that point in a bucket
-  // 4) for each z integer index, find all the stored x values
-  //    and use them to create one z slice of the vtkStencilData
-
-  // the spacing and origin of the generated stencil
-  double *spacing = data->GetSpacing();
-  double *origin = data->GetOrigin();
-
-  // if we have no data then return
-  if (!this->GetInput()->GetNumberOfPoints())
+  // 3) for each x and y offset, go through all line segments, and for each
+  //    integer y value on a line segment, store the x value at that point in a bucket
+  // 4) for each y integer index, find all the stored x values and use them to
+  //    create the stencil of the slice, then add the voxels inside the stencil
+  //    to the output slice
+  // Steps 1 and 2 are only done once for all x and y offsets.
+
+  int* extent = threadData->Extent;
+  int sliceIndex = idxZ - extent[4];
+  vtkIdType firstTriangle = threadData->SliceTriangleOffsets[sliceIndex];
+  vtkIdType numberOfTriangles = threadData->SliceTriangleOffsets[sliceIndex + 1] - firstTriangle;
+  bool cutTriangles = !threadData->TrianglePointIds.empty();
+  if (cutTriangles && numberOfTriangles == 0)
     {
+    // the slice is entirely outside of the surface
     return;
     }
+  const vtkIdType* triangleIds = (numberOfTriangles > 0 ? &threadData->SliceTriangleIds[firstTriangle] : NULL);
 
-  // Only divide once
-  double invspacing[3];
-  invspacing[0] = 1.0/spacing[0];
-  invspacing[1] = 1.0/spacing[1];
-  invspacing[2] = 1.0/spacing[2];
+  int rowSize = extent[1] - extent[0] + 1;
+  FRACTIONAL_DATA_TYPE* outputSlicePointer = threadData->OutputPointer
+    + static_cast<vtkIdType>(sliceIndex) * rowSize * (extent[3] - extent[2] + 1);
 
-  // get the input data
-  vtkPolyData *input = closedSurface;
-
-  // the output produced by cutting the polydata with the Z plane
-  vtkSmartPointer<vtkPolyData> slice;
+  // The offset step size ( n-1 / 2n )
+  double offsetStepSize = (double)(this->NumberOfOffsets-1.0)/(2 * this->NumberOfOffsets);
 
   // This raster stores all line segments by recording all "x"
   // positions on the surface for each y integer position.
   vtkImageStencilRaster raster(&extent[2]);
   raster.SetTolerance(this->Tolerance);
 
-  // The extent for one slice of the image
+  // The extent for the slice of the image
   int sliceExtent[6];
   sliceExtent[0] = extent[0]; sliceExtent[1] = extent[1];
   sliceExtent[2] = extent[2]; sliceExtent[3] = extent[3];
-  sliceExtent[4] = extent[4]; sliceExtent[5] = extent[4];
+  sliceExtent[4] = idxZ; sliceExtent[5] = idxZ;
+  stencil->SetExtent(sliceExtent);
 
-  // Loop through the slices
-  for (int idxZ = extent[4]; idxZ <= extent[5]; idxZ++)
-    {
-
-    double z = idxZ*spacing[2] + origin[2];
+  // the output produced by cutting the polydata with the Z plane
+  vtkSmartPointer<vtkPolyData> slice = vtkSmartPointer<vtkPolyData>::New();
+  std::vector<vtkIdType> pointNeighborCounts;
 
-    raster.PrepareForNewData();
+  for (int k = 0; k < this->NumberOfOffsets; ++k)
+    {
+    double z = idxZ + ( (double) k / this->NumberOfOffsets - offsetStepSize );
 
-    if ( this->SliceCache.count(z) == 0 )
+    // Step 1: Cut the data into slices
+    if (cutTriangles)
       {
-
-      slice = vtkSmartPointer<vtkPolyData>::New();
-
-      // Step 1: Cut the data into slices
-      if (input->GetNumberOfPolys() > 0 || input->GetNumberOfStrips() > 0)
-        {
-
-        this->PolyDataCutter(input, slice, z);
-        }
-      else
-        {
-        // if no polys, select polylines instead
-        this->PolyDataSelector(input, slice, z, spacing[2]);
-        }
-
-      if (!slice->GetNumberOfLines())
-        {
-        continue;
-        }
-
-      this->SliceCache.insert(std::pair<double, vtkPolyData*>(z, slice));
-
+      this->PolyDataCutter(threadData, triangleIds, numberOfTriangles, z, slice);
+      }
+    else
+      {
+      // if no polys, select polylines instead
+      this->PolyDataSelector(threadData->ThreadClosedSurfaces[threadId], slice, z, 1.0);
       }
 
-    slice = this->SliceCache[z];
-
-    // convert to structured coords via origin and spacing
-    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
-    points->DeepCopy(slice->GetPoints());
-    vtkIdType numberOfPoints = points->GetNumberOfPoints();
-
-    for (vtkIdType j = 0; j < numberOfPoints; j++)
+    if (!slice->GetNumberOfLines())
       {
-      double tempPoint[3];
-      points->GetPoint(j, tempPoint);
-      tempPoint[0] = (tempPoint[0] - origin[0])*invspacing[0];
-      tempPoint[1] = (tempPoint[1] - origin[1])*invspacing[1];
-      tempPoint[2] = (tempPoint[2] - origin[2])*invspacing[2];
-      points->SetPoint(j, tempPoint);
+      continue;
       }
 
-    if (this->LinesCache.count(z) == 0)
-    {
+    // Step 2: Find and connect all the loose ends
+    this->ConnectLooseEnds(slice, pointNeighborCounts);
 
-      // Step 2: Find and connect all the loose ends
-      std::vector<vtkIdType> pointNeighbors(numberOfPoints);
-      vtkSmartPointer<vtkIdTypeArray> pointNeighborCountsArray = vtkSmartPointer<vtkIdTypeArray>::New();
-      pointNeighborCountsArray->Allocate(numberOfPoints, 1);
-      vtkIdType* pointNeighborCounts = pointNeighborCountsArray->GetPointer(0);
-      memset(pointNeighborCounts, 0, numberOfPoints*sizeof(vtkIdType));
-
-      // get the connectivity count for each point
-      vtkSmartPointer<vtkCellArray> lines = slice->GetLines();
-      vtkIdType npts = 0;
-      vtkIdType *pointIds = 0;
-      vtkIdType count = lines->GetNumberOfConnectivityEntries();
-      for (vtkIdType loc = 0; loc < count; loc += npts + 1)
-        {
-        lines->GetCell(loc, npts, pointIds);
-        if (npts > 0)
-          {
-          pointNeighborCounts[pointIds[0]] += 1;
-          for (vtkIdType j = 1; j < npts-1; j++)
-            {
-            pointNeighborCounts[pointIds[j]] += 2;
-            }
-          pointNeighborCounts[pointIds[npts-1]] += 1;
-          if (pointIds[0] != pointIds[npts-1])
-            {
-            // store the neighbors for end points, because these are
-            // potentially loose ends that will have to be dealt with later
-            pointNeighbors[pointIds[0]] = pointIds[1];
-            pointNeighbors[pointIds[npts-1]] = pointIds[npts-2];
-            }
-          }
-        }
+    vtkPoints* points = slice->GetPoints();
+    vtkCellArray* lines = slice->GetLines();
+    vtkIdType count = lines->GetNumberOfConnectivityEntries();
 
-      // use connectivity count to identify loose ends and branch points
-      std::vector<vtkIdType> looseEndIds;
-      std::vector<vtkIdType> branchIds;
+    for (int j = 0; j < this->NumberOfOffsets; ++j)
+      {
+      double jOffset = ( (double) j / this->NumberOfOffsets - offsetStepSize );
 
-      for (vtkIdType j = 0; j < numberOfPoints; j++)
+      for (int i = 0; i < this->NumberOfOffsets; ++i)
         {
-        if (pointNeighborCounts[j] == 1)
-          {
-          looseEndIds.push_back(j);
-          }
-        else if (pointNeighborCounts[j] > 2)
-          {
-          branchIds.push_back(j);
-          }
-        }
+        double iOffset = ( (double) i / this->NumberOfOffsets - offsetStepSize );
 
-      // remove any spurs
-      for (size_t b = 0; b < branchIds.size(); b++)
-        {
-        for (size_t i = 0; i < looseEndIds.size(); i++)
+        raster.PrepareForNewData();
+
+        // Step 3: Go through all the line segments for this slice,
+        // and for each integer y position on the line segment,
+        // drop the corresponding x position into the y raster line.
+        vtkIdType npts = 0;
+        vtkIdType *pointIds = 0;
+        for (vtkIdType loc = 0; loc < count; loc += npts + 1)
           {
-          if (pointNeighbors[looseEndIds[i]] == branchIds[b])
+          lines->GetCell(loc, npts, pointIds);
+          if (npts > 0)
             {
-            // mark this pointId as removed
-            pointNeighborCounts[looseEndIds[i]] = 0;
-            looseEndIds.erase(looseEndIds.begin() + i);
-            i--;
-            if (--pointNeighborCounts[branchIds[b]] <= 2)
+            vtkIdType pointId0 = pointIds[0];
+            double point0[3];
+            points->GetPoint(pointId0, point0);
+            point0[0] -= iOffset;
+            point0[1] -= jOffset;
+            for (vtkIdType pointIndex = 1; pointIndex < npts; pointIndex++)
               {
-              break;
+              vtkIdType pointId1 = pointIds[pointIndex];
+              double point1[3];
+              points->GetPoint(pointId1, point1);
+              point1[0] -= iOffset;
+              point1[1] -= jOffset;
+
+              // make sure points aren't flagged for removal
+              if (pointNeighborCounts[pointId0] > 0 &&
+                  pointNeighborCounts[pointId1] > 0)
+                {
+                raster.InsertLine(point0, point1);
+                }
+
+              pointId0 = pointId1;
+              point0[0] = point1[0];
+              point0[1] = point1[1];
+              point0[2] = point1[2];
               }
             }
           }
-        }
-
-      // join any loose ends
-      while (looseEndIds.size() >= 2)
-        {
-        size_t n = looseEndIds.size();
-
-        // search for the two closest loose ends
-        double maxval = -VTK_FLOAT_MAX;
-        vtkIdType firstIndex = 0;
-        vtkIdType secondIndex = 1;
-        bool isCoincident = false;
-        bool isOnHull = false;
 
-        for (size_t i = 0; i < n && !isCoincident; i++)
+        // Step 4: Use the x values stored in the xy raster to create
+        // the stencil of the slice, and add the voxels inside to the output
+        stencil->AllocateExtents();
+        raster.FillStencilData(stencil, sliceExtent);
+        FRACTIONAL_DATA_TYPE* outputRowPointer = outputSlicePointer;
+        for (int idxY = extent[2]; idxY <= extent[3]; ++idxY, outputRowPointer += rowSize)
           {
-          // first loose end
-          vtkIdType firstLooseEndId = looseEndIds[i];
-          vtkIdType neighborId = pointNeighbors[firstLooseEndId];
-
-          double firstLooseEnd[3];
-          slice->GetPoint(firstLooseEndId, firstLooseEnd);
-          double neighbor[3];
-          slice->GetPoint(neighborId, neighbor);
-
-          for (size_t j = i+1; j < n; j++)
+          int iter = 0;
+          int r1 = 0;
+          int r2 = 0;
+          while (stencil->GetNextExtent(r1, r2, extent[0], extent[1], idxY, idxZ, iter))
             {
-            vtkIdType secondLooseEndId = looseEndIds[j];
-            if (secondLooseEndId != neighborId)
+            for (FRACTIONAL_DATA_TYPE* voxelPointer = outputRowPointer + (r1 - extent[0]);
+              voxelPointer <= outputRowPointer + (r2 - extent[0]); ++voxelPointer)
               {
-              double currentLooseEnd[3];
-              slice->GetPoint(secondLooseEndId, currentLooseEnd);
-
-              // When connecting loose ends, use dot product to favor
-              // continuing in same direction as the line already
-              // connected to the loose end, but also favour short
-              // distances by dividing dotprod by square of distance.
-              double v1[2], v2[2];
-              v1[0] = firstLooseEnd[0] - neighbor[0];
-              v1[1] = firstLooseEnd[1] - neighbor[1];
-              v2[0] = currentLooseEnd[0] - firstLooseEnd[0];
-              v2[1] = currentLooseEnd[1] - firstLooseEnd[1];
-              double dotprod = v1[0]*v2[0] + v1[1]*v2[1];
-              double distance2 = v2[0]*v2[0] + v2[1]*v2[1];
-
-              // check if points are coincident
-              if (distance2 == 0)
-                {
-                firstIndex = i;
-                secondIndex = j;
-                isCoincident = true;
-                break;
-                }
-
-              // prefer adding segments that lie on hull
-              double midpoint[2], normal[2];
-              midpoint[0] = 0.5*(currentLooseEnd[0] + firstLooseEnd[0]);
-              midpoint[1] = 0.5*(currentLooseEnd[1] + firstLooseEnd[1]);
-              normal[0] = currentLooseEnd[1] - firstLooseEnd[1];
-              normal[1] = -(currentLooseEnd[0] - firstLooseEnd[0]);
-              double sidecheck = 0.0;
-              bool checkOnHull = true;
-              for (size_t k = 0; k < n; k++)
-                {
-                if (k != i && k != j)
-                  {
-                  double checkEnd[3];
-                  slice->GetPoint(looseEndIds[k], checkEnd);
-                  double dotprod2 = ((checkEnd[0] - midpoint[0])*normal[0] +
-                                     (checkEnd[1] - midpoint[1])*normal[1]);
-                  if (dotprod2*sidecheck < 0)
-                    {
-                    checkOnHull = false;
-                    }
-                  sidecheck = dotprod2;
-                  }
-                }
-
-              // check if new candidate is better than previous one
-              if ((checkOnHull && !isOnHull) ||
-                  (checkOnHull == isOnHull && dotprod > maxval*distance2))
-                {
-                firstIndex = i;
-                secondIndex = j;
-                isOnHull |= checkOnHull;
-                maxval = dotprod/distance2;
-                }
+              (*voxelPointer) += FRACTIONAL_STEP_SIZE;
               }
             }
           }
+        } // i
+      } // j
+    } // k
+}
 
-        // get info about the two loose ends and their neighbors
-        vtkIdType firstLooseEndId = looseEndIds[firstIndex];
-        vtkIdType neighborId = pointNeighbors[firstLooseEndId];
-        double firstLooseEnd[3];
-        slice->GetPoint(firstLooseEndId, firstLooseEnd);
-        double neighbor[3];
-        slice->GetPoint(neighborId, neighbor);
-
-        vtkIdType secondLooseEndId = looseEndIds[secondIndex];
-        vtkIdType secondNeighborId = pointNeighbors[secondLooseEndId];
-        double secondLooseEnd[3];
-        slice->GetPoint(secondLooseEndId, secondLooseEnd);
-        double secondNeighbor[3];
-        slice->GetPoint(secondNeighborId, secondNeighbor);
-
-        // remove these loose ends from the list
-        looseEndIds.erase(looseEndIds.begin() + secondIndex);
-        looseEndIds.erase(looseEndIds.begin() + firstIndex);
-
-        if (!isCoincident)
-          {
-          // create a new line segment by connecting these two points
-          lines->InsertNextCell(2);
-          lines->InsertCellPoint(firstLooseEndId);
-          lines->InsertCellPoint(secondLooseEndId);
-          }
+//----------------------------------------------------------------------------
+void vtkPolyDataToFractionalLabelmapFilter::ConnectLooseEnds(
+  vtkPolyData* slice, std::vector<vtkIdType>& pointNeighborCountsVector)
+{
+  vtkIdType numberOfPoints = slice->GetNumberOfPoints();
+  std::vector<vtkIdType> pointNeighbors(numberOfPoints);
+  pointNeighborCountsVector.assign(numberOfPoints, 0);
+  vtkIdType* pointNeighborCounts = (numberOfPoints > 0 ? &pointNeighborCountsVector[0] : NULL);
+
+  // get the connectivity count for each point
+  vtkCellArray* lines = slice->GetLines();
+  vtkIdType npts = 0;
+  vtkIdType *pointIds = 0;
+  vtkIdType count = lines->GetNumberOfConnectivityEntries();
+  for (vtkIdType loc = 0; loc < count; loc += npts + 1)
+    {
+    lines->GetCell(loc, npts, pointIds);
+    if (npts > 0)
+      {
+      pointNeighborCounts[pointIds[0]] += 1;
+      for (vtkIdType j = 1; j < npts-1; j++)
+        {
+        pointNeighborCounts[pointIds[j]] += 2;
+        }
+      pointNeighborCounts[pointIds[npts-1]] += 1;
+      if (pointIds[0] != pointIds[npts-1])
+        {
+        // store the neighbors for end points, because these are
+        // potentially loose ends that will have to be dealt with later
+        pointNeighbors[pointIds[0]] = pointIds[1];
+        pointNeighbors[pointIds[npts-1]] = pointIds[npts-2];
         }
+      }
+    }
 
-        this->LinesCache.insert(std::pair<double, vtkCellArray*>(z, lines));
-        this->NptsCache.insert(std::pair<double, vtkIdType>(z, npts));
-        this->PointNeighborCountsCache.insert(std::pair<double, vtkSmartPointer<vtkIdTypeArray> >(z, pointNeighborCountsArray));
+  // use connectivity count to identify loose ends and branch points
+  std::vector<vtkIdType> looseEndIds;
+  std::vector<vtkIdType> branchIds;
 
+  for (vtkIdType j = 0; j < numberOfPoints; j++)
+    {
+    if (pointNeighborCounts[j] == 1)
+      {
+      looseEndIds.push_back(j);
+      }
+    else if (pointNeighborCounts[j] > 2)
+      {
+      branchIds.push_back(j);
       }
+    }
 
-   if (this->LinesCache.count(z) == 0)
+  // remove any spurs
+  for (size_t b = 0; b < branchIds.size(); b++)
     {
-     continue;
+    for (size_t i = 0; i < looseEndIds.size(); i++)
+      {
+      if (pointNeighbors[looseEndIds[i]] == branchIds[b])
+        {
+        // mark this pointId as removed
+        pointNeighborCounts[looseEndIds[i]] = 0;
+        looseEndIds.erase(looseEndIds.begin() + i);
+        i--;
+        if (--pointNeighborCounts[branchIds[b]] <= 2)
+          {
+          break;
+          }
+        }
+      }
     }
 
-    vtkCellArray* lines = this->LinesCache[z];
-    vtkIdType count = lines->GetNumberOfConnectivityEntries();
-    vtkIdType* pointIds = this->PointIdsCache[z];
-    vtkIdType npts = this->NptsCache[z];
-    vtkIdTypeArray* pointNeighborCountsArray = this->PointNeighborCountsCache[z];
-    vtkIdType* pointNeighborCounts = pointNeighborCountsArray->GetPointer(0);
-
-    // Step 3: Go through all the line segments for this slice,
-    // and for each integer y position on the line segment,
-    // drop the corresponding x position into the y raster line.
-    for (vtkIdType loc = 0; loc < count; loc += npts + 1)
+  // join any loose ends
+  while (looseEndIds.size() >= 2)
+    {
+    size_t n = looseEndIds.size();
+
+    // search for the two closest loose ends
+    double maxval = -VTK_FLOAT_MAX;
+    vtkIdType firstIndex = 0;
+    vtkIdType secondIndex = 1;
+    bool isCoincident = false;
+    bool isOnHull = false;
+
+    for (size_t i = 0; i < n && !isCoincident; i++)
       {
-      lines->GetCell(loc, npts, pointIds);
-      if (npts > 0)
+      // first loose end
+      vtkIdType firstLooseEndId = looseEndIds[i];
+      vtkIdType neighborId = pointNeighbors[firstLooseEndId];
+
+      double firstLooseEnd[3];
+      slice->GetPoint(firstLooseEndId, firstLooseEnd);
+      double neighbor[3];
+      slice->GetPoint(neighborId, neighbor);
+
+      for (size_t j = i+1; j < n; j++)
         {
-        vtkIdType pointId0 = pointIds[0];
-        double point0[3];
-        points->GetPoint(pointId0, point0);
-        for (vtkIdType j = 1; j < npts; j++)
+        vtkIdType secondLooseEndId = looseEndIds[j];
+        if (secondLooseEndId != neighborId)
           {
-          vtkIdType pointId1 = pointIds[j];
-          double point1[3];
-          points->GetPoint(pointId1, point1);
+          double currentLooseEnd[3];
+          slice->GetPoint(secondLooseEndId, currentLooseEnd);
+
+          // When connecting loose ends, use dot product to favor
+          // continuing in same direction as the line already
+          // connected to the loose end, but also favour short
+          // distances by dividing dotprod by square of distance.
+          double v1[2], v2[2];
+          v1[0] = firstLooseEnd[0] - neighbor[0];
+          v1[1] = firstLooseEnd[1] - neighbor[1];
+          v2[0] = currentLooseEnd[0] - firstLooseEnd[0];
+          v2[1] = currentLooseEnd[1] - firstLooseEnd[1];
+          double dotprod = v1[0]*v2[0] + v1[1]*v2[1];
+          double distance2 = v2[0]*v2[0] + v2[1]*v2[1];
+
+          // check if points are coincident
+          if (distance2 == 0)
+            {
+            firstIndex = i;
+            secondIndex = j;
+            isCoincident = true;
+            break;
+            }
 
-          // make sure points aren't flagged for removal
-          if (pointNeighborCounts[pointId0] > 0 &&
-              pointNeighborCounts[pointId1] > 0)
+          // prefer adding segments that lie on hull
+          double midpoint[2], normal[2];
+          midpoint[0] = 0.5*(currentLooseEnd[0] + firstLooseEnd[0]);
+          midpoint[1] = 0.5*(currentLooseEnd[1] + firstLooseEnd[1]);
+          normal[0] = currentLooseEnd[1] - firstLooseEnd[1];
+          normal[1] = -(currentLooseEnd[0] - firstLooseEnd[0]);
+          double sidecheck = 0.0;
+          bool checkOnHull = true;
+          for (size_t k = 0; k < n; k++)
             {
-            raster.InsertLine(point0, point1);
+            if (k != i && k != j)
+              {
+              double checkEnd[3];
+              slice->GetPoint(looseEndIds[k], checkEnd);
+              double dotprod2 = ((checkEnd[0] - midpoint[0])*normal[0] +
+                                 (checkEnd[1] - midpoint[1])*normal[1]);
+              if (dotprod2*sidecheck < 0)
+                {
+                checkOnHull = false;
+                }
+              sidecheck = dotprod2;
+              }
             }
 
-          pointId0 = pointId1;
-          point0[0] = point1[0];
-          point0[1] = point1[1];
-          point0[2] = point1[2];
+          // check if new candidate is better than previous one
+          if ((checkOnHull && !isOnHull) ||
+              (checkOnHull == isOnHull && dotprod > maxval*distance2))
+            {
+            firstIndex = i;
+            secondIndex = j;
+            isOnHull |= checkOnHull;
+            maxval = dotprod/distance2;
+            }
           }
         }
       }
 
-    // Step 4: Use the x values stored in the xy raster to create
-    // one z slice of the vtkStencilData
-    sliceExtent[4] = idxZ;
-    sliceExtent[5] = idxZ;
-    raster.FillStencilData(data, sliceExtent);
+    // get info about the two loose ends and their neighbors
+    vtkIdType firstLooseEndId = looseEndIds[firstIndex];
+    vtkIdType secondLooseEndId = looseEndIds[secondIndex];
 
-    }
+    // remove these loose ends from the list
+    looseEndIds.erase(looseEndIds.begin() + secondIndex);
+    looseEndIds.erase(looseEndIds.begin() + firstIndex);
 
+    if (!isCoincident)
+      {
+      // create a new line segment by connecting these two points
+      lines->InsertNextCell(2);
+      lines->InsertCellPoint(firstLooseEndId);
+      lines->InsertCellPoint(secondLooseEndId);
+      }
+    }
 }
 
 //----------------------------------------------------------------------------
 void vtkPolyDataToFractionalLabelmapFilter::PolyDataCutter(
-  vtkPolyData *input, vtkPolyData *output, double z)
+  vtkPolyDataToFractionalLabelmapThreadData* threadData,
+  const vtkIdType* triangleIds, vtkIdType numberOfTriangles, double z, vtkPolyData *output)
 {
-  vtkPoints *points = input->GetPoints();
-  vtkCellArray *inputPolys = input->GetPolys();
-  vtkCellArray *inputStrips = input->GetStrips();
+  const double* points = &threadData->Points[0];
   vtkPoints *newPoints = vtkPoints::New();
-  newPoints->SetDataType(points->GetDataType());
+  newPoints->SetDataTypeToDouble();
   newPoints->Allocate(333);
   vtkCellArray *newLines = vtkCellArray::New();
   newLines->Allocate(1000);
@@ -891,92 +941,49 @@ void vtkPolyDataToFractionalLabelmapFilter::PolyDataCutter(
   // An edge locator to avoid point duplication while clipping
   EdgeLocator edgeLocator;
 
-  vtkSmartPointer<vtkIdList> cells = vtkSmartPointer<vtkIdList>::New();
-  cells->Initialize();
-
-  double bounds[6] = {0,0,0,0,0,0};
-  input->GetBounds(bounds);
-  bounds[4] = z;
-  bounds[5] = z;
-
-  // Find cells that intersect with the current slice.
-  this->CellLocator->FindCellsWithinBounds(bounds, cells);
-
-  // Go through all cells and clip them.
-  vtkIdType numCells = cells->GetNumberOfIds();
-
-
-  vtkIdType loc = 0;
-  vtkCellArray *cellArray = inputPolys;
-  for (vtkIdType cellId = 0; cellId < numCells; cellId++)
+  // Go through all triangles that may intersect the plane and clip them.
+  for (vtkIdType triangleIndex = 0; triangleIndex < numberOfTriangles; triangleIndex++)
     {
+    const vtkIdType* ptIds = &threadData->TrianglePointIds[3 * triangleIds[triangleIndex]];
+    const vtkIdType npts = 3;
 
-    vtkIdType id = cells->GetId(cellId);
+    vtkIdType i1 = ptIds[npts-1];
+    double v1 = points[3*i1 + 2] - z;
+    bool c1 = (v1 > 0);
 
-    if (input->GetCellType(id) != VTK_TRIANGLE &&
-        input->GetCellType(id) != VTK_TRIANGLE_STRIP)
-      {
-        continue;
-      }
-
-    vtkIdType npts, *ptIds;
-    input->GetCellPoints(id, npts, ptIds);
-    loc += npts + 1;
-
-    vtkIdType numSubCells = 1;
-    if (input->GetCellType(id) == VTK_TRIANGLE_STRIP)
-      {
-      numSubCells = npts - 2;
-      npts = 3;
-      }
+    // To store the ids of the contour line
+    vtkIdType linePts[2];
+    linePts[0] = 0;
+    linePts[1] = 0;
 
-    for (vtkIdType subId = 0; subId < numSubCells; subId++)
+    for (vtkIdType i = 0; i < npts; i++)
       {
-      vtkIdType i1 = ptIds[npts-1];
-      double point[3];
-      points->GetPoint(i1, point);
-      double v1 = point[2] - z;
-      bool c1 = (v1 > 0);
-      bool odd = ((subId & 1) != 0);
-
-      // To store the ids of the contour line
-      vtkIdType linePts[2];
-      linePts[0] = 0;
-      linePts[1] = 0;
-
-      for (vtkIdType i = 0; i < npts; i++)
+      // Save previous point info
+      vtkIdType i0 = i1;
+      double v0 = v1;
+      bool c0 = c1;
+
+      // Generate new point info
+      i1 = ptIds[i];
+      v1 = points[3*i1 + 2] - z;
+      c1 = (v1 > 0);
+
+      // If at least one edge end point wasn't clipped
+      if ( (c0 | c1) )
         {
-        // Save previous point info
-        vtkIdType i0 = i1;
-        double v0 = v1;
-        bool c0 = c1;
-
-        // Generate new point info
-        i1 = ptIds[i];
-        points->GetPoint(i1, point);
-        v1 = point[2] - z;
-        c1 = (v1 > 0);
-
-        // If at least one edge end point wasn't clipped
-        if ( (c0 | c1) )
+        // If only one end was clipped, interpolate new point
+        if ( (c0 ^ c1) )
           {
-          // If only one end was clipped, interpolate new point
-          if ( (c0 ^ c1) )
-            {
-            edgeLocator.InterpolateEdge(
-              points, newPoints, i0, i1, v0, v1, linePts[c0 ^ odd]);
-            }
+          edgeLocator.InterpolateEdge(
+            points, newPoints, i0, i1, v0, v1, linePts[c0]);
           }
         }
+      }
 
-      // Insert the contour line if one was created
-      if (linePts[0] != linePts[1])
-        {
-        newLines->InsertNextCell(2, linePts);
-        }
-
-      // Increment to get to the next triangle, if cell is a strip
-      ptIds++;
+    // Insert the contour line if one was created
+    if (linePts[0] != linePts[1])
+      {
+      newLines->InsertNextCell(2, linePts);
       }
     }
 
@@ -985,15 +992,3 @@ void vtkPolyDataToFractionalLabelmapFilter::PolyDataCutter(
   newPoints->Delete();
   newLines->Delete();
 }
-
-//----------------------------------------------------------------------------
-void vtkPolyDataToFractionalLabelmapFilter::DeleteCache()
-{
-
-  this->SliceCache.clear();
-  this->LinesCache.clear();
-  this->NptsCache.clear();
-  this->PointIdsCache.clear();
-  this->PointNeighborCountsCache.clear();
-
-}
@@ -30,16 +30,19 @@
 #include <vtkCellArray.h>
 #include <vtkSetGet.h>
 #include <vtkMatrix4x4.h>
-#include <vtkCellLocator.h>
+#include <vtkMultiThreader.h>
 
 // Segmentations includes
 #include <vtkOrientedImageData.h>
 
 // std includes
-#include <map>
+#include <vector>
 
 #include "vtkSegmentationCoreConfigure.h"
 
+class vtkSimpleCriticalSection;
+struct vtkPolyDataToFractionalLabelmapThreadData;
+
 // Define the datatype and fractional constants for fractional labelmap conversion based on the value of VTK_FRACTIONAL_DATA_TYPE
 #define VTK_FRACTIONAL_DATA_TYPE VTK_CHAR
 
@@ -64,16 +67,10 @@ class vtkSegmentationCore_EXPORT vtkPolyDataToFractionalLabelmapFilter :
   public vtkPolyDataToImageStencil
 {
 private:
-  std::map<double, vtkSmartPointer<vtkCellArray> > LinesCache;
-  std::map<double, vtkSmartPointer<vtkPolyData> > SliceCache;
-  std::map<double, vtkIdType*> PointIdsCache;
-  std::map<double, vtkIdType> NptsCache;
-  std::map<double,  vtkSmartPointer<vtkIdTypeArray> > PointNeighborCountsCache;
-
-  vtkCellLocator* CellLocator;
-
   vtkOrientedImageData* OutputImageTransformData;
   int NumberOfOffsets;
+  int NumberOfThreads;
+  vtkSimpleCriticalSection* Lock;
 
 public:
   static vtkPolyDataToFractionalLabelmapFilter* New();
@@ -97,13 +94,18 @@ public:
   void SetOutputSpacing(double spacing[3]);
   void SetOutputSpacing(double x, double y, double z);
 
-
-  /// This method deletes the currently stored cache variables
+  /// \deprecated The filter no longer keeps a cache between updates, this method does nothing.
+  /// It is kept for backward compatibility only.
   void DeleteCache();
 
   vtkSetMacro(NumberOfOffsets, int);
   vtkGetMacro(NumberOfOffsets, int);
 
+  /// Maximum number of threads used for filling the output slices.
+  /// If 0 (default) then the global default number of threads of vtkMultiThreader is used.
+  vtkSetMacro(NumberOfThreads, int);
+  vtkGetMacro(NumberOfThreads, int);
+
 protected:
   vtkPolyDataToFractionalLabelmapFilter();
   ~vtkPolyDataToFractionalLabelmapFilter();
@@ -113,25 +115,34 @@ protected:
   vtkOrientedImageData *AllocateOutputData(vtkDataObject *out, int* updateExt);
   virtual int FillOutputPortInformation(int, vtkInformation*);
 
-  /// Create a binary image stencil for the closed surface within the current extent
+  /// Add the contributions of all sub-voxel offsets to one z slice of the output.
+  /// The surface is cut once for each z offset, and the resulting contour lines
+  /// are rasterized at all x and y offsets. Can be called from multiple threads
+  /// at the same time, as each call only writes to its own output slice.
   /// This method is a modified version of vtkPolyDataToImageStencil::ThreadedExecute
-  /// \param output Output stencil data
-  /// \param closedSurface The input surface to be converted
-  /// \param extent The extent region that is being converted
-  void FillImageStencilData(vtkImageStencilData *output, vtkPolyData* closedSurface, int extent[6]);
-
-  /// Add the values of the binary labelmap to the fractional labelmap.
-  /// \param binaryLabelMap Binary labelmap that will be added to the fractional labelmap
-  /// \param fractionalLabelMap The fractional labelmap that the binary labelmap is added to
-  void AddBinaryLabelMapToFractionalLabelMap(vtkImageData* binaryLabelMap, vtkImageData* fractionalLabelMap);
-
-  /// Clip the polydata at the specified z coordinate to create a planar contour.
+  /// \param threadData Closed surface and output shared by all threads
+  /// \param threadId Index of the calling thread
+  /// \param idxZ The z index of the output slice
+  /// \param stencil Stencil buffer of the calling thread
+  void FillSlice(vtkPolyDataToFractionalLabelmapThreadData* threadData, int threadId, int idxZ, vtkImageStencilData* stencil);
+
+  /// Find all loose ends of the contour lines and connect them to make polygons.
+  /// \param slice Contour lines of one slice. Connecting lines are added to its lines.
+  /// \param pointNeighborCounts Number of line segments connected to each point. Points of removed spurs have 0.
+  void ConnectLooseEnds(vtkPolyData* slice, std::vector<vtkIdType>& pointNeighborCounts);
+
+  /// Clip the triangles at the specified z coordinate to create a planar contour.
   /// This method is a modified version of vtkPolyDataToImageStencil::PolyDataCutter to decrease execution time
-  /// \param input The closed surface that is being cut
-  /// \param output Polydata containing the contour lines
+  /// \param threadData Triangles of the closed surface that is being cut
+  /// \param triangleIds The triangles that may intersect the cutting plane
+  /// \param numberOfTriangles Number of values in triangleIds
   /// \param z The z coordinate for the cutting plane
-  void PolyDataCutter(vtkPolyData *input, vtkPolyData *output,
-                             double z);
+  /// \param output Polydata containing the contour lines
+  void PolyDataCutter(vtkPolyDataToFractionalLabelmapThreadData* threadData,
+    const vtkIdType* triangleIds, vtkIdType numberOfTriangles, double z, vtkPolyData *output);
+
+  /// Thread function that fills the output slices one by one
+  static VTK_THREAD_RETURN_TYPE FillSlicesThreadFunction(void* arg);
 
 private:
   vtkPolyDataToFractionalLabelmapFilter(const vtkPolyDataToFractionalLabelmapFilter&);  // Not implemented.
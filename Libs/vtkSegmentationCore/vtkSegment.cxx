@@ -55,6 +55,7 @@ vtkSegment::vtkSegment()
   this->Color[0] = SEGMENT_COLOR_INVALID[0];
   this->Color[1] = SEGMENT_COLOR_INVALID[1];
   this->Color[2] = SEGMENT_COLOR_INVALID[2];
+  this->LabelValue = 1;
 }
 
 //----------------------------------------------------------------------------
@@ -75,6 +76,7 @@ void vtkSegment::PrintSelf(ostream& os, vtkIndent indent)
 
   os << indent << "Name: " << (this->Name ? this->Name : "NULL") << "\n";
   os << indent << "Color: (" << this->Color[0] << ", " << this->Color[1] << ", " << this->Color[2] << ")\n";
+  os << indent << "Label value: " << this->LabelValue << "\n";
 
   RepresentationMap::iterator reprIt;
   os << indent << "Representations:\n";
@@ -200,6 +202,7 @@ void vtkSegment::DeepCopyMetadata(vtkSegment* source)
   this->SetName(source->Name);
   this->SetColor(source->Color);
   this->Tags = source->Tags;
+  this->SetLabelValue(source->LabelValue);
 }
 
 
@@ -121,6 +121,12 @@ public:
   vtkGetVector3Macro(Color, double);
   vtkSetVector3Macro(Color, double);
 
+  /// Value of the voxels that belong to this segment in its binary labelmap representation.
+  /// If the binary labelmap is shared with other segments (see \sa vtkSegmentation::CollapseBinaryLabelmaps)
+  /// then only voxels with this value belong to the segment, otherwise all non-zero voxels do.
+  vtkGetMacro(LabelValue, int);
+  vtkSetMacro(LabelValue, int);
+
 protected:
   vtkSegment();
   ~vtkSegment();
@@ -141,6 +147,9 @@ protected:
 
   /// Tags (for grouping and selection)
   std::map<std::string,std::string> Tags;
+
+  /// Label value of the segment in its binary labelmap representation
+  int LabelValue;
 };
 
 #endif // __vtkSegment_h
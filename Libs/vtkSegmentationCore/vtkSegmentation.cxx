@@ -39,12 +39,14 @@
 #include <vtkMatrix4x4.h>
 #include <vtkTransform.h>
 #include <vtkPolyData.h>
+#include <vtkPointData.h>
 #include <vtkTransformPolyDataFilter.h>
 
 // STD includes
 #include <sstream>
 #include <algorithm>
 #include <functional>
+#include <set>
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSegmentation);
@@ -145,11 +147,29 @@ void vtkSegmentation::DeepCopy(vtkSegmentation* aSegmentation)
   // Copy conversion parameters
   this->Converter->DeepCopy(aSegmentation->Converter);
 
-  // Deep copy segments list
+  // Deep copy segments list. Labelmaps that are shared between segments are copied only once
+  // and the copy is shared between the same segments.
+  std::map<vtkDataObject*, vtkDataObject*> sharedLabelmapCopies;
   for (std::deque< std::string >::iterator segmentIdIt = aSegmentation->SegmentIds.begin(); segmentIdIt != aSegmentation->SegmentIds.end(); ++segmentIdIt)
     {
+    vtkSegment* sourceSegment = aSegmentation->Segments[*segmentIdIt];
     vtkSmartPointer<vtkSegment> segment = vtkSmartPointer<vtkSegment>::New();
-    segment->DeepCopy(aSegmentation->Segments[*segmentIdIt]);
+    segment->DeepCopy(sourceSegment);
+    vtkDataObject* sourceLabelmap = sourceSegment->GetRepresentation(
+      vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+    if (sourceLabelmap)
+      {
+      std::map<vtkDataObject*, vtkDataObject*>::iterator copyIt = sharedLabelmapCopies.find(sourceLabelmap);
+      if (copyIt == sharedLabelmapCopies.end())
+        {
+        sharedLabelmapCopies[sourceLabelmap] = segment->GetRepresentation(
+          vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+        }
+      else
+        {
+        segment->AddRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName(), copyIt->second);
+        }
+      }
     this->AddSegment(segment);
     }
 }
@@ -508,6 +528,16 @@ void vtkSegmentation::RemoveSegment(SegmentMap::iterator segmentIt)
 
   std::string segmentId(segmentIt->first);
 
+  // If the labelmap remains in use by other segments then the removed segment gets its own labelmap,
+  // so that neither the removed segment (which may still be used by the caller) nor the remaining
+  // segments contain the voxels of the other.
+  std::vector<std::string> sharedSegmentIds;
+  this->GetSegmentIDsSharingBinaryLabelmapRepresentation(segmentId, sharedSegmentIds, false);
+  if (!sharedSegmentIds.empty())
+    {
+    this->SeparateSegmentLabelmap(segmentId);
+    }
+
   // Remove observation of segment modified event
   segmentIt->second.GetPointer()->RemoveObservers(vtkCommand::ModifiedEvent, this->SegmentCallbackCommand);
   // Remove observation of master representation of removed segment
@@ -740,7 +770,9 @@ void vtkSegmentation::ApplyLinearTransform(vtkAbstractTransform* transform)
   this->Converter->ApplyTransformOnReferenceImageGeometry(transform);
 
   // Apply linear transform for each segment:
-  // Harden transform on master representation if poly data, apply directions if oriented image data
+  // Harden transform on master representation if poly data, apply directions if oriented image data.
+  // Representations shared by multiple segments are transformed only once.
+  std::set<vtkDataObject*> transformedRepresentations;
   for (SegmentMap::iterator it = this->Segments.begin(); it != this->Segments.end(); ++it)
     {
     vtkDataObject* currentMasterRepresentation = it->second->GetRepresentation(this->MasterRepresentationName);
@@ -749,6 +781,10 @@ void vtkSegmentation::ApplyLinearTransform(vtkAbstractTransform* transform)
       vtkErrorMacro("ApplyLinearTransform: Cannot get master representation (" << this->MasterRepresentationName << ") from segment!");
       return;
       }
+    if (!transformedRepresentations.insert(currentMasterRepresentation).second)
+      {
+      continue;
+      }
 
     vtkPolyData* currentMasterRepresentationPolyData = vtkPolyData::SafeDownCast(currentMasterRepresentation);
     vtkOrientedImageData* currentMasterRepresentationOrientedImageData = vtkOrientedImageData::SafeDownCast(currentMasterRepresentation);
@@ -787,7 +823,9 @@ void vtkSegmentation::ApplyNonLinearTransform(vtkAbstractTransform* transform)
   // Apply transform on reference image geometry conversion parameter (to preserve validity of merged labelmap)
   this->Converter->ApplyTransformOnReferenceImageGeometry(transform);
 
-  // Harden transform on master representation (both image data and poly data) for each segment individually
+  // Harden transform on master representation (both image data and poly data) for each segment individually.
+  // Representations shared by multiple segments are transformed only once.
+  std::set<vtkDataObject*> transformedRepresentations;
   for (SegmentMap::iterator it = this->Segments.begin(); it != this->Segments.end(); ++it)
     {
     vtkDataObject* currentMasterRepresentation = it->second->GetRepresentation(this->MasterRepresentationName);
@@ -796,6 +834,10 @@ void vtkSegmentation::ApplyNonLinearTransform(vtkAbstractTransform* transform)
       vtkErrorMacro("ApplyNonLinearTransform: Cannot get master representation (" << this->MasterRepresentationName << ") from segment!");
       return;
       }
+    if (!transformedRepresentations.insert(currentMasterRepresentation).second)
+      {
+      continue;
+      }
 
     vtkPolyData* currentMasterRepresentationPolyData = vtkPolyData::SafeDownCast(currentMasterRepresentation);
     vtkOrientedImageData* currentMasterRepresentationOrientedImageData = vtkOrientedImageData::SafeDownCast(currentMasterRepresentation);
@@ -823,6 +865,19 @@ void vtkSegmentation::ApplyNonLinearTransform(vtkAbstractTransform* transform)
 //-----------------------------------------------------------------------------
 bool vtkSegmentation::ConvertSegmentUsingPath(vtkSegment* segment, vtkSegmentationConverter::ConversionPathType path, bool overwriteExisting/*=false*/)
 {
+  std::vector<vtkSegment*> segments;
+  segments.push_back(segment);
+  return this->ConvertSegmentsUsingPath(segments, path, overwriteExisting);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSegmentation::ConvertSegmentsUsingPath(const std::vector<vtkSegment*>& segments,
+  vtkSegmentationConverter::ConversionPathType path, bool overwriteExisting/*=false*/, const int modifiedExtent[6]/*=NULL*/)
+{
+  // Segments whose labelmap is shared are converted from their own label only
+  std::map<vtkDataObject*, int> labelmapUseCounts;
+  this->GetBinaryLabelmapUseCounts(labelmapUseCounts);
+
   // Execute each conversion step in the selected path
   vtkSegmentationConverter::ConversionPathType::iterator pathIt;
   for (pathIt = path.begin(); pathIt != path.end(); ++pathIt)
@@ -830,40 +885,84 @@ bool vtkSegmentation::ConvertSegmentUsingPath(vtkSegment* segment, vtkSegmentati
     vtkSegmentationConverterRule* currentConversionRule = (*pathIt);
     if (!currentConversionRule)
       {
-      vtkErrorMacro("ConvertSegmentUsingPath: Invalid converter rule!");
+      vtkErrorMacro("ConvertSegmentsUsingPath: Invalid converter rule!");
       return false;
       }
+    bool sourceIsBinaryLabelmap = !strcmp(currentConversionRule->GetSourceRepresentationName(),
+      vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+
+    // Collect the segments that need to be converted in this step
+    std::vector<vtkSegment*> convertedSegments;
+    std::vector<vtkDataObject*> sourceRepresentations;
+    std::vector<int> labelValues;
+    std::vector<vtkDataObject*> targetRepresentations;
+    std::vector<vtkSmartPointer<vtkDataObject> > targetRepresentationsReferences;
+    for (std::vector<vtkSegment*>::const_iterator segmentIt = segments.begin(); segmentIt != segments.end(); ++segmentIt)
+      {
+      vtkSegment* segment = (*segmentIt);
+
+      // Get source representation from segment. It is expected to exist
+      vtkDataObject* sourceRepresentation = segment->GetRepresentation(
+        currentConversionRule->GetSourceRepresentationName() );
+      if (!sourceRepresentation)
+        {
+        vtkErrorMacro("ConvertSegmentsUsingPath: Source representation does not exist!");
+        return false;
+        }
+
+      // Get target representation
+      vtkSmartPointer<vtkDataObject> targetRepresentation = segment->GetRepresentation(
+        currentConversionRule->GetTargetRepresentationName() );
+      // If target representation exists and we do not overwrite existing representations,
+      // then no conversion is necessary with this conversion rule
+      if (targetRepresentation.GetPointer() && !overwriteExisting)
+        {
+        continue;
+        }
+      // Create an empty target representation if it does not exist
+      if (!targetRepresentation.GetPointer())
+        {
+        targetRepresentation = vtkSmartPointer<vtkDataObject>::Take(
+          currentConversionRule->ConstructRepresentationObjectByRepresentation(currentConversionRule->GetTargetRepresentationName()) );
+        }
 
-    // Get source representation from segment. It is expected to exist
-    vtkDataObject* sourceRepresentation = segment->GetRepresentation(
-      currentConversionRule->GetSourceRepresentationName() );
-    if (!sourceRepresentation)
+      // If the source labelmap is shared with other segments then only the voxels of this segment are converted
+      int labelValue = 0;
+      if (sourceIsBinaryLabelmap && (labelmapUseCounts[sourceRepresentation] > 1 || segment->GetLabelValue() != 1))
+        {
+        labelValue = segment->GetLabelValue();
+        }
+
+      convertedSegments.push_back(segment);
+      sourceRepresentations.push_back(sourceRepresentation);
+      labelValues.push_back(labelValue);
+      targetRepresentations.push_back(targetRepresentation);
+      targetRepresentationsReferences.push_back(targetRepresentation);
+      }
+    if (convertedSegments.empty())
       {
-      vtkErrorMacro("ConvertSegmentUsingPath: Source representation does not exist!");
-      return false;
+      continue;
       }
 
-    // Get target representation
-    vtkSmartPointer<vtkDataObject> targetRepresentation = segment->GetRepresentation(
-      currentConversionRule->GetTargetRepresentationName() );
-    // If target representation exists and we do not overwrite existing representations,
-    // then no conversion is necessary with this conversion rule
-    if (targetRepresentation.GetPointer() && !overwriteExisting)
+    // Perform conversion step. Only the first step converts from the master representation,
+    // so the modified extent is only known for that step.
+    if (modifiedExtent && pathIt == path.begin())
       {
-      continue;
+      for (size_t i = 0; i < convertedSegments.size(); ++i)
+        {
+        currentConversionRule->ConvertModifiedExtent(sourceRepresentations[i], labelValues[i], modifiedExtent, targetRepresentations[i]);
+        }
       }
-    // Create an empty target representation if it does not exist
-    if (!targetRepresentation.GetPointer())
+    else
       {
-      targetRepresentation = vtkSmartPointer<vtkDataObject>::Take(
-        currentConversionRule->ConstructRepresentationObjectByRepresentation(currentConversionRule->GetTargetRepresentationName()) );
+      currentConversionRule->ConvertMultiple(sourceRepresentations, labelValues, targetRepresentations);
       }
 
-    // Perform conversion step
-    currentConversionRule->Convert(sourceRepresentation, targetRepresentation);
-
-    // Add representation to segment
-    segment->AddRepresentation(currentConversionRule->GetTargetRepresentationName(), targetRepresentation);
+    // Add representation to segments
+    for (size_t i = 0; i < convertedSegments.size(); ++i)
+      {
+      convertedSegments[i]->AddRepresentation(currentConversionRule->GetTargetRepresentationName(), targetRepresentations[i]);
+      }
     }
 
   return true;
@@ -931,17 +1030,28 @@ bool vtkSegmentation::CreateRepresentation(const std::string& targetRepresentati
     }
 
   // Perform conversion on all segments (no overwrites)
+  std::vector<vtkSegment*> segments;
+  std::vector<vtkDataObject*> representationsBefore;
+  std::vector<vtkMTimeType> representationMTimesBefore;
   for (SegmentMap::iterator segmentIt = this->Segments.begin(); segmentIt != this->Segments.end(); ++segmentIt)
     {
     vtkDataObject* representationBefore = segmentIt->second->GetRepresentation(targetRepresentationName);
-    if (!this->ConvertSegmentUsingPath(segmentIt->second, cheapestPath, alwaysConvert))
-      {
-      vtkErrorMacro("CreateRepresentation: Conversion failed");
-      return false;
-      }
+    segments.push_back(segmentIt->second);
+    representationsBefore.push_back(representationBefore);
+    representationMTimesBefore.push_back(representationBefore ? representationBefore->GetMTime() : 0);
+    }
+  if (!this->ConvertSegmentsUsingPath(segments, cheapestPath, alwaysConvert))
+    {
+    vtkErrorMacro("CreateRepresentation: Conversion failed");
+    return false;
+    }
+  int segmentIndex = 0;
+  for (SegmentMap::iterator segmentIt = this->Segments.begin(); segmentIt != this->Segments.end(); ++segmentIt, ++segmentIndex)
+    {
+    vtkDataObject* representationBefore = representationsBefore[segmentIndex];
     vtkDataObject* representationAfter = segmentIt->second->GetRepresentation(targetRepresentationName);
     if (representationBefore != representationAfter
-      || (representationBefore != NULL && representationAfter != NULL && representationBefore->GetMTime() != representationAfter->GetMTime()) )
+      || (representationBefore != NULL && representationAfter != NULL && representationMTimesBefore[segmentIndex] != representationAfter->GetMTime()) )
       {
       // representation has been modified
       const char* segmentId = segmentIt->first.c_str();
@@ -971,13 +1081,18 @@ bool vtkSegmentation::CreateRepresentation(vtkSegmentationConverter::ConversionP
   this->Converter->SetConversionParameters(parameters);
 
   // Perform conversion on all segments (do overwrites)
+  std::vector<vtkSegment*> segments;
+  for (SegmentMap::iterator segmentIt = this->Segments.begin(); segmentIt != this->Segments.end(); ++segmentIt)
+    {
+    segments.push_back(segmentIt->second);
+    }
+  if (!this->ConvertSegmentsUsingPath(segments, path, true))
+    {
+    vtkErrorMacro("CreateRepresentation: Conversion failed");
+    return false;
+    }
   for (SegmentMap::iterator segmentIt = this->Segments.begin(); segmentIt != this->Segments.end(); ++segmentIt)
     {
-    if (!this->ConvertSegmentUsingPath(segmentIt->second, path, true))
-      {
-      vtkErrorMacro("CreateRepresentation: Conversion failed");
-      return false;
-      }
     const char* segmentId = segmentIt->first.c_str();
     this->InvokeEvent(vtkSegmentation::RepresentationModified, (void*)segmentId);
     }
@@ -1215,6 +1330,16 @@ bool vtkSegmentation::CopySegmentFromSegmentation(vtkSegmentation* fromSegmentat
     {
     vtkSmartPointer<vtkSegment> segmentCopy = vtkSmartPointer<vtkSegment>::New();
     segmentCopy->DeepCopy(segment);
+    if (fromSegmentation->IsSegmentBinaryLabelmapShared(segment))
+      {
+      // Only copy the voxels of the segment from the shared labelmap
+      vtkSmartPointer<vtkOrientedImageData> labelmapCopy = vtkSmartPointer<vtkOrientedImageData>::New();
+      fromSegmentation->GetBinaryLabelmapRepresentation(segmentId, labelmapCopy);
+      vtkSmartPointer<vtkOrientedImageData> separateLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+      separateLabelmap->DeepCopy(labelmapCopy);
+      segmentCopy->SetLabelValue(1);
+      segmentCopy->AddRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName(), separateLabelmap);
+      }
     if (!this->AddSegment(segmentCopy, targetSegmentId))
       {
       vtkErrorMacro("CopySegmentFromSegmentation: Failed to add segment '" << targetSegmentId << "' to segmentation");
@@ -1224,6 +1349,8 @@ bool vtkSegmentation::CopySegmentFromSegmentation(vtkSegmentation* fromSegmentat
   // If move, then just add segment to target and remove from source (ownership is transferred)
   else
     {
+    // Labelmap shared with other segments of the source cannot be moved
+    fromSegmentation->SeparateSegmentLabelmap(segmentId);
     if (!this->AddSegment(segment, targetSegmentId))
       {
       vtkErrorMacro("CopySegmentFromSegmentation: Failed to add segment '" << targetSegmentId << "' to segmentation");
@@ -1235,6 +1362,396 @@ bool vtkSegmentation::CopySegmentFromSegmentation(vtkSegmentation* fromSegmentat
   return true;
 }
 
+//-----------------------------------------------------------------------------
+namespace
+{
+
+//-----------------------------------------------------------------------------
+template <class T>
+bool LabelmapOverlapsLayerGeneric(vtkImageData* labelmap, T*, vtkImageData* layer, const int extent[6])
+{
+  for (int k = extent[4]; k <= extent[5]; ++k)
+    {
+    for (int j = extent[2]; j <= extent[3]; ++j)
+      {
+      T* labelmapPtr = static_cast<T*>(labelmap->GetScalarPointer(extent[0], j, k));
+      unsigned char* layerPtr = static_cast<unsigned char*>(layer->GetScalarPointer(extent[0], j, k));
+      for (int i = extent[0]; i <= extent[1]; ++i, ++labelmapPtr, ++layerPtr)
+        {
+        if (*labelmapPtr != 0 && *layerPtr != 0)
+          {
+          return true;
+          }
+        }
+      }
+    }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+template <class T>
+void PaintLabelmapToLayerGeneric(vtkImageData* labelmap, T*, vtkImageData* layer, unsigned char labelValue, const int extent[6])
+{
+  for (int k = extent[4]; k <= extent[5]; ++k)
+    {
+    for (int j = extent[2]; j <= extent[3]; ++j)
+      {
+      T* labelmapPtr = static_cast<T*>(labelmap->GetScalarPointer(extent[0], j, k));
+      unsigned char* layerPtr = static_cast<unsigned char*>(layer->GetScalarPointer(extent[0], j, k));
+      for (int i = extent[0]; i <= extent[1]; ++i, ++labelmapPtr, ++layerPtr)
+        {
+        if (*labelmapPtr != 0)
+          {
+          *layerPtr = labelValue;
+          }
+        }
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Compute the intersection of two extents. Returns false if the intersection is empty.
+bool IntersectExtents(const int extent1[6], const int extent2[6], int intersection[6])
+{
+  for (int i = 0; i < 3; ++i)
+    {
+    intersection[2*i] = std::max(extent1[2*i], extent2[2*i]);
+    intersection[2*i+1] = std::min(extent1[2*i+1], extent2[2*i+1]);
+    if (intersection[2*i] > intersection[2*i+1])
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//---------------------------------------------------------------------------
+void vtkSegmentation::GetBinaryLabelmapUseCounts(std::map<vtkDataObject*, int>& useCounts)
+{
+  useCounts.clear();
+  for (SegmentMap::iterator segmentIt = this->Segments.begin(); segmentIt != this->Segments.end(); ++segmentIt)
+    {
+    vtkDataObject* labelmap = segmentIt->second->GetRepresentation(
+      vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+    if (labelmap)
+      {
+      useCounts[labelmap]++;
+      }
+    }
+}
+
+//---------------------------------------------------------------------------
+bool vtkSegmentation::IsSegmentBinaryLabelmapShared(vtkSegment* segment)
+{
+  if (!segment)
+    {
+    return false;
+    }
+  vtkDataObject* labelmap = segment->GetRepresentation(
+    vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+  if (!labelmap)
+    {
+    return false;
+    }
+  if (segment->GetLabelValue() != 1)
+    {
+    return true;
+    }
+  for (SegmentMap::iterator segmentIt = this->Segments.begin(); segmentIt != this->Segments.end(); ++segmentIt)
+    {
+    if (segmentIt->second.GetPointer() != segment && segmentIt->second->GetRepresentation(
+      vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()) == labelmap)
+      {
+      return true;
+      }
+    }
+  return false;
+}
+
+//---------------------------------------------------------------------------
+bool vtkSegmentation::IsSharedBinaryLabelmap(const std::string& segmentId)
+{
+  return this->IsSegmentBinaryLabelmapShared(this->GetSegment(segmentId));
+}
+
+//---------------------------------------------------------------------------
+void vtkSegmentation::GetSegmentIDsSharingBinaryLabelmapRepresentation(const std::string& segmentId,
+  std::vector<std::string>& sharedSegmentIds, bool includeOriginalSegmentId/*=true*/)
+{
+  sharedSegmentIds.clear();
+  vtkSegment* segment = this->GetSegment(segmentId);
+  if (!segment)
+    {
+    vtkErrorMacro("GetSegmentIDsSharingBinaryLabelmapRepresentation: Failed to get segment " << segmentId);
+    return;
+    }
+  vtkDataObject* labelmap = segment->GetRepresentation(
+    vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+  if (!labelmap)
+    {
+    return;
+    }
+  for (std::deque<std::string>::iterator segmentIdIt = this->SegmentIds.begin(); segmentIdIt != this->SegmentIds.end(); ++segmentIdIt)
+    {
+    if (!includeOriginalSegmentId && *segmentIdIt == segmentId)
+      {
+      continue;
+      }
+    if (this->Segments[*segmentIdIt]->GetRepresentation(
+      vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()) == labelmap)
+      {
+      sharedSegmentIds.push_back(*segmentIdIt);
+      }
+    }
+}
+
+//---------------------------------------------------------------------------
+int vtkSegmentation::GetNumberOfLayers()
+{
+  std::map<vtkDataObject*, int> useCounts;
+  this->GetBinaryLabelmapUseCounts(useCounts);
+  return static_cast<int>(useCounts.size());
+}
+
+//---------------------------------------------------------------------------
+bool vtkSegmentation::GetBinaryLabelmapRepresentation(const std::string& segmentId, vtkOrientedImageData* outputBinaryLabelmap)
+{
+  if (!outputBinaryLabelmap)
+    {
+    vtkErrorMacro("GetBinaryLabelmapRepresentation: Invalid output labelmap");
+    return false;
+    }
+  vtkSegment* segment = this->GetSegment(segmentId);
+  if (!segment)
+    {
+    vtkErrorMacro("GetBinaryLabelmapRepresentation: Failed to get segment " << segmentId);
+    return false;
+    }
+  vtkOrientedImageData* labelmap = vtkOrientedImageData::SafeDownCast(segment->GetRepresentation(
+    vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()));
+  if (!labelmap)
+    {
+    return false;
+    }
+  if (!this->IsSegmentBinaryLabelmapShared(segment))
+    {
+    outputBinaryLabelmap->ShallowCopy(labelmap);
+    return true;
+    }
+  return vtkOrientedImageDataResample::ExtractLabel(labelmap, segment->GetLabelValue(), outputBinaryLabelmap);
+}
+
+//---------------------------------------------------------------------------
+bool vtkSegmentation::GenerateSharedLabelmapLayers(vtkOrientedImageData* commonGeometryImage,
+  std::vector<vtkSmartPointer<vtkOrientedImageData> >& layers, SegmentLayerLabelMap& segmentLayerLabels,
+  const std::vector<std::string>& segmentIDs/*=std::vector<std::string>()*/)
+{
+  layers.clear();
+  segmentLayerLabels.clear();
+  if (!commonGeometryImage)
+    {
+    vtkErrorMacro("GenerateSharedLabelmapLayers: Invalid common geometry image");
+    return false;
+    }
+
+  std::vector<std::string> mergedSegmentIDs = segmentIDs;
+  if (mergedSegmentIDs.empty())
+    {
+    this->GetSegmentIDs(mergedSegmentIDs);
+    }
+
+  vtkSmartPointer<vtkMatrix4x4> imageToWorldMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  commonGeometryImage->GetImageToWorldMatrix(imageToWorldMatrix);
+  int commonExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  commonGeometryImage->GetExtent(commonExtent);
+
+  // Number of labels already used in each layer
+  std::vector<int> layerLabelCounts;
+  for (std::vector<std::string>::iterator segmentIdIt = mergedSegmentIDs.begin(); segmentIdIt != mergedSegmentIDs.end(); ++segmentIdIt)
+    {
+    vtkSegment* segment = this->GetSegment(*segmentIdIt);
+    if (!segment)
+      {
+      vtkErrorMacro("GenerateSharedLabelmapLayers: Failed to get segment " << (*segmentIdIt));
+      return false;
+      }
+
+    // Get the voxels of the segment in the common geometry
+    vtkSmartPointer<vtkOrientedImageData> labelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+    if (!this->GetBinaryLabelmapRepresentation(*segmentIdIt, labelmap))
+      {
+      vtkErrorMacro("GenerateSharedLabelmapLayers: Segment " << (*segmentIdIt) << " does not contain binary labelmap representation");
+      return false;
+      }
+    if (!vtkOrientedImageDataResample::DoGeometriesMatch(commonGeometryImage, labelmap))
+      {
+      vtkSmartPointer<vtkOrientedImageData> resampledLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+      if (!vtkOrientedImageDataResample::ResampleOrientedImageToReferenceOrientedImage(labelmap, commonGeometryImage, resampledLabelmap))
+        {
+        vtkErrorMacro("GenerateSharedLabelmapLayers: Failed to resample segment " << (*segmentIdIt) << " to common geometry");
+        return false;
+        }
+      labelmap = resampledLabelmap;
+      }
+    int labelmapExtent[6] = { 0, -1, 0, -1, 0, -1 };
+    int effectiveExtent[6] = { 0, -1, 0, -1, 0, -1 };
+    labelmap->GetExtent(labelmapExtent);
+    bool emptySegment = (labelmap->GetPointData()->GetScalars() == NULL
+      || labelmap->GetNumberOfScalarComponents() != 1
+      || !IntersectExtents(labelmapExtent, commonExtent, effectiveExtent));
+
+    // Find the first layer that has a free label and no overlap with the segment
+    int layerIndex = 0;
+    for (; layerIndex < static_cast<int>(layers.size()); ++layerIndex)
+      {
+      if (layerLabelCounts[layerIndex] >= VTK_UNSIGNED_CHAR_MAX)
+        {
+        continue;
+        }
+      if (emptySegment)
+        {
+        break;
+        }
+      bool overlap = false;
+      switch (labelmap->GetScalarType())
+        {
+        vtkTemplateMacro(overlap = LabelmapOverlapsLayerGeneric(labelmap, static_cast<VTK_TT*>(NULL), layers[layerIndex], effectiveExtent));
+        default:
+          vtkErrorMacro("GenerateSharedLabelmapLayers: Unknown scalar type");
+          return false;
+        }
+      if (!overlap)
+        {
+        break;
+        }
+      }
+    if (layerIndex == static_cast<int>(layers.size()))
+      {
+      vtkSmartPointer<vtkOrientedImageData> layer = vtkSmartPointer<vtkOrientedImageData>::New();
+      layer->SetExtent(commonExtent);
+      layer->SetImageToWorldMatrix(imageToWorldMatrix);
+      layer->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+      vtkOrientedImageDataResample::FillImage(layer, 0);
+      layers.push_back(layer);
+      layerLabelCounts.push_back(0);
+      }
+
+    // Assign the next label value of the layer to the segment
+    int labelValue = ++layerLabelCounts[layerIndex];
+    segmentLayerLabels[*segmentIdIt] = std::make_pair(layerIndex, labelValue);
+    if (emptySegment)
+      {
+      continue;
+      }
+    switch (labelmap->GetScalarType())
+      {
+      vtkTemplateMacro(PaintLabelmapToLayerGeneric(labelmap, static_cast<VTK_TT*>(NULL), layers[layerIndex],
+        static_cast<unsigned char>(labelValue), effectiveExtent));
+      default:
+        vtkErrorMacro("GenerateSharedLabelmapLayers: Unknown scalar type");
+        return false;
+      }
+    }
+
+  return true;
+}
+
+//---------------------------------------------------------------------------
+bool vtkSegmentation::CollapseBinaryLabelmaps()
+{
+  if (this->MasterRepresentationName != vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName())
+    {
+    vtkErrorMacro("CollapseBinaryLabelmaps: Master representation must be binary labelmap");
+    return false;
+    }
+  if (this->Segments.empty())
+    {
+    return true;
+    }
+
+  std::string commonGeometryString = this->DetermineCommonLabelmapGeometry(EXTENT_UNION_OF_EFFECTIVE_SEGMENTS);
+  vtkSmartPointer<vtkOrientedImageData> commonGeometryImage = vtkSmartPointer<vtkOrientedImageData>::New();
+  if (!vtkSegmentationConverter::DeserializeImageGeometry(commonGeometryString, commonGeometryImage, false))
+    {
+    vtkErrorMacro("CollapseBinaryLabelmaps: Failed to determine common labelmap geometry");
+    return false;
+    }
+
+  std::vector<vtkSmartPointer<vtkOrientedImageData> > layers;
+  SegmentLayerLabelMap segmentLayerLabels;
+  if (!this->GenerateSharedLabelmapLayers(commonGeometryImage, layers, segmentLayerLabels))
+    {
+    return false;
+    }
+
+  // The contents of the segments do not change, therefore other representations remain valid
+  bool wasMasterRepresentationModifiedEnabled = this->SetMasterRepresentationModifiedEnabled(false);
+  for (SegmentLayerLabelMap::iterator labelIt = segmentLayerLabels.begin(); labelIt != segmentLayerLabels.end(); ++labelIt)
+    {
+    vtkSegment* segment = this->GetSegment(labelIt->first);
+    segment->SetLabelValue(labelIt->second.second);
+    segment->AddRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName(),
+      layers[labelIt->second.first]);
+    }
+  this->SetMasterRepresentationModifiedEnabled(wasMasterRepresentationModifiedEnabled);
+
+  this->Modified();
+  return true;
+}
+
+//---------------------------------------------------------------------------
+bool vtkSegmentation::SeparateSegmentLabelmap(const std::string& segmentId)
+{
+  vtkSegment* segment = this->GetSegment(segmentId);
+  if (!segment)
+    {
+    vtkErrorMacro("SeparateSegmentLabelmap: Failed to get segment " << segmentId);
+    return false;
+    }
+  if (!this->IsSegmentBinaryLabelmapShared(segment))
+    {
+    return true;
+    }
+  vtkOrientedImageData* sharedLabelmap = vtkOrientedImageData::SafeDownCast(segment->GetRepresentation(
+    vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()));
+
+  vtkSmartPointer<vtkOrientedImageData> separateLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+  if (!vtkOrientedImageDataResample::ExtractLabel(sharedLabelmap, segment->GetLabelValue(), separateLabelmap))
+    {
+    vtkErrorMacro("SeparateSegmentLabelmap: Failed to extract segment " << segmentId);
+    return false;
+    }
+
+  // The shared labelmap may also be referenced outside of this segmentation (e.g. by a segment that
+  // was copied or removed earlier), therefore it is not modified in place: the other segments get
+  // a copy of it without the voxels of this segment.
+  std::vector<std::string> sharedSegmentIds;
+  this->GetSegmentIDsSharingBinaryLabelmapRepresentation(segmentId, sharedSegmentIds, false);
+  vtkSmartPointer<vtkOrientedImageData> remainingLabelmap;
+  if (!sharedSegmentIds.empty())
+    {
+    remainingLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+    remainingLabelmap->DeepCopy(sharedLabelmap);
+    vtkOrientedImageDataResample::ReplaceLabel(remainingLabelmap, segment->GetLabelValue(), 0);
+    }
+
+  // Moving the segment does not change the contents of any segment
+  bool wasMasterRepresentationModifiedEnabled = this->SetMasterRepresentationModifiedEnabled(false);
+  for (std::vector<std::string>::iterator sharedSegmentIdIt = sharedSegmentIds.begin();
+    sharedSegmentIdIt != sharedSegmentIds.end(); ++sharedSegmentIdIt)
+    {
+    this->GetSegment(*sharedSegmentIdIt)->AddRepresentation(
+      vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName(), remainingLabelmap);
+    }
+  segment->SetLabelValue(1);
+  segment->AddRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName(), separateLabelmap);
+  this->SetMasterRepresentationModifiedEnabled(wasMasterRepresentationModifiedEnabled);
+
+  return true;
+}
+
 //-----------------------------------------------------------------------------
 std::string vtkSegmentation::DetermineCommonLabelmapGeometry(int extentComputationMode, vtkStringArray* segmentIds)
 {
@@ -1448,7 +1965,8 @@ void vtkSegmentation::DetermineCommonLabelmapExtent(int commonGeometryExtent[6],
 }
 
 //----------------------------------------------------------------------------
-bool vtkSegmentation::ConvertSingleSegment(std::string segmentId, std::string targetRepresentationName)
+bool vtkSegmentation::ConvertSingleSegment(std::string segmentId, std::string targetRepresentationName,
+  const int modifiedExtent[6]/*=NULL*/)
 {
   vtkSegment* segment = this->GetSegment(segmentId);
   if (!segment)
@@ -1468,7 +1986,9 @@ bool vtkSegmentation::ConvertSingleSegment(std::string segmentId, std::string ta
     }
 
   // Perform conversion (overwrite if exists)
-  if (!this->ConvertSegmentUsingPath(segment, cheapestPath, true))
+  std::vector<vtkSegment*> segments;
+  segments.push_back(segment);
+  if (!this->ConvertSegmentsUsingPath(segments, cheapestPath, true, modifiedExtent))
     {
     vtkErrorMacro("ConvertSingleSegment: Conversion failed!");
     return false;
@@ -255,6 +255,57 @@ public:
   /// \return Success flag
   bool CopySegmentFromSegmentation(vtkSegmentation* fromSegmentation, std::string segmentId, bool removeFromSource=false);
 
+// Shared labelmap related methods
+
+  /// Merge the binary labelmap representations of the segments into shared labelmap layers.
+  /// Segments in the same layer reference the same vtkOrientedImageData object and are distinguished
+  /// by their label value (\sa vtkSegment::GetLabelValue). A segment is placed into the first layer in
+  /// which it does not overlap with other segments, therefore overlapping segments are split into
+  /// separate layers automatically.
+  /// Master representation must be binary labelmap.
+  /// \return Success flag
+  bool CollapseBinaryLabelmaps();
+
+  /// Move the binary labelmap of a segment that shares its labelmap with other segments into
+  /// a separate labelmap. Does nothing if the labelmap of the segment is not shared.
+  /// The shared labelmap is not modified: the segments that shared it get a copy of it without
+  /// the voxels of this segment. Must be called before the labelmap of a segment is edited in place.
+  /// \return Success flag
+  bool SeparateSegmentLabelmap(const std::string& segmentId);
+
+  /// Determine if the binary labelmap representation of a segment is shared with other segments
+  bool IsSharedBinaryLabelmap(const std::string& segmentId);
+
+  /// Get IDs of the segments that share the binary labelmap representation with the specified segment
+  void GetSegmentIDsSharingBinaryLabelmapRepresentation(const std::string& segmentId,
+    std::vector<std::string>& sharedSegmentIds, bool includeOriginalSegmentId=true);
+
+  /// Get number of distinct binary labelmap objects (layers) in the segmentation
+  int GetNumberOfLayers();
+
+  /// Get binary labelmap of a single segment, in which only the voxels of the segment are non-zero.
+  /// If the labelmap of the segment is not shared then the output is a shallow copy of it,
+  /// otherwise the voxels of the segment are extracted from the shared labelmap.
+  /// \return Success flag
+  bool GetBinaryLabelmapRepresentation(const std::string& segmentId, vtkOrientedImageData* outputBinaryLabelmap);
+
+#ifndef __VTK_WRAP__
+//BTX
+  /// Label assignment of a segment in shared labelmap layers: (layer index, label value)
+  typedef std::map<std::string, std::pair<int, int> > SegmentLayerLabelMap;
+
+  /// Generate shared labelmap layers from the binary labelmaps of the segments without modifying the segmentation.
+  /// \param commonGeometryImage Defines the geometry and extent of the generated layers
+  /// \param layers Output labelmap layers (unsigned char), each contains one or more segments
+  /// \param segmentLayerLabels Output layer index and label value of each segment
+  /// \param segmentIDs Segments to include. If empty then all segments are included.
+  /// \return Success flag
+  bool GenerateSharedLabelmapLayers(vtkOrientedImageData* commonGeometryImage,
+    std::vector<vtkSmartPointer<vtkOrientedImageData> >& layers, SegmentLayerLabelMap& segmentLayerLabels,
+    const std::vector<std::string>& segmentIDs = std::vector<std::string>());
+//ETX
+#endif // __VTK_WRAP__
+
 // Representation related methods
 
   /// Get representation names present in this segmentation in an output string vector
@@ -362,8 +413,28 @@ protected:
   /// \return Success flag
   bool ConvertSegmentUsingPath(vtkSegment* segment, vtkSegmentationConverter::ConversionPathType path, bool overwriteExisting=false);
 
+  /// Convert multiple segments along a specified path. Each conversion step is performed on all
+  /// the segments at once, which allows conversion rules to process the segments in parallel
+  /// (\sa vtkSegmentationConverterRule::ConvertMultiple).
+  /// \param modifiedExtent If specified then the master representation was only modified within this
+  ///   IJK extent since the last conversion, which allows the first conversion step to update only the
+  ///   modified region of its target (\sa vtkSegmentationConverterRule::ConvertModifiedExtent).
+  /// \return Success flag
+  bool ConvertSegmentsUsingPath(const std::vector<vtkSegment*>& segments, vtkSegmentationConverter::ConversionPathType path,
+    bool overwriteExisting=false, const int modifiedExtent[6]=NULL);
+
   /// Converts a single segment to a representation.
-  bool ConvertSingleSegment(std::string segmentId, std::string targetRepresentationName);
+  /// \param modifiedExtent If specified then the master representation was only modified within this extent
+  ///   since the last conversion (\sa ConvertSegmentsUsingPath).
+  bool ConvertSingleSegment(std::string segmentId, std::string targetRepresentationName, const int modifiedExtent[6]=NULL);
+
+  /// Get the number of segments that use each binary labelmap object
+  void GetBinaryLabelmapUseCounts(std::map<vtkDataObject*, int>& useCounts);
+
+  /// Determine if only the voxels with the label value of the segment belong to the segment in its
+  /// binary labelmap. It is the case if the labelmap is used by other segments as well or the
+  /// label value is not the default.
+  bool IsSegmentBinaryLabelmapShared(vtkSegment* segment);
 
   /// Remove segment by iterator. The two \sa RemoveSegment methods call this function after
   /// finding the iterator based on their different input arguments.
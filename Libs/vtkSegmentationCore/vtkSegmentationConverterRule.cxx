@@ -20,9 +20,12 @@
 
 // Segmentations includes
 #include "vtkSegmentationConverterRule.h"
+#include "vtkOrientedImageData.h"
+#include "vtkOrientedImageDataResample.h"
 
 // VTK includes
 #include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
 
 //----------------------------------------------------------------------------
 vtkSegmentationConverterRule::vtkSegmentationConverterRule()
@@ -43,6 +46,55 @@ vtkSegmentationConverterRule* vtkSegmentationConverterRule::Clone()
   return clone;
 }
 
+//----------------------------------------------------------------------------
+bool vtkSegmentationConverterRule::ConvertSharedLabelmap(vtkDataObject* sourceRepresentation, int labelValue, vtkDataObject* targetRepresentation)
+{
+  vtkOrientedImageData* sharedLabelmap = vtkOrientedImageData::SafeDownCast(sourceRepresentation);
+  if (!sharedLabelmap)
+    {
+    vtkErrorMacro("ConvertSharedLabelmap: Source representation is not oriented image data");
+    return false;
+    }
+  vtkSmartPointer<vtkOrientedImageData> binaryLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+  if (!vtkOrientedImageDataResample::ExtractLabel(sharedLabelmap, labelValue, binaryLabelmap))
+    {
+    vtkErrorMacro("ConvertSharedLabelmap: Failed to extract label " << labelValue << " from source representation");
+    return false;
+    }
+  return this->Convert(binaryLabelmap, targetRepresentation);
+}
+
+//----------------------------------------------------------------------------
+bool vtkSegmentationConverterRule::ConvertMultiple(const std::vector<vtkDataObject*>& sourceRepresentations,
+  const std::vector<int>& labelValues, const std::vector<vtkDataObject*>& targetRepresentations)
+{
+  if (sourceRepresentations.size() != targetRepresentations.size() || sourceRepresentations.size() != labelValues.size())
+    {
+    vtkErrorMacro("ConvertMultiple: Number of source representations, label values, and target representations must be the same");
+    return false;
+    }
+  bool success = true;
+  for (size_t i = 0; i < sourceRepresentations.size(); ++i)
+    {
+    bool converted = (labelValues[i] == 0
+      ? this->Convert(sourceRepresentations[i], targetRepresentations[i])
+      : this->ConvertSharedLabelmap(sourceRepresentations[i], labelValues[i], targetRepresentations[i]));
+    success = success && converted;
+    }
+  return success;
+}
+
+//----------------------------------------------------------------------------
+bool vtkSegmentationConverterRule::ConvertModifiedExtent(vtkDataObject* sourceRepresentation, int labelValue,
+  const int vtkNotUsed(modifiedExtent)[6], vtkDataObject* targetRepresentation)
+{
+  if (labelValue == 0)
+    {
+    return this->Convert(sourceRepresentation, targetRepresentation);
+    }
+  return this->ConvertSharedLabelmap(sourceRepresentation, labelValue, targetRepresentation);
+}
+
 //----------------------------------------------------------------------------
 void vtkSegmentationConverterRule::GetRuleConversionParameters(ConversionParameterListType& conversionParameters)
 {
@@ -29,6 +29,7 @@
 // STD includes
 #include <map>
 #include <string>
+#include <vector>
 
 class vtkDataObject;
 
@@ -83,6 +84,28 @@ public:
   /// Update the target representation based on the source representation
   virtual bool Convert(vtkDataObject* sourceRepresentation, vtkDataObject* targetRepresentation) = 0;
 
+  /// Update the target representation based on a source labelmap that is shared between multiple segments.
+  /// Only voxels of the source that have labelValue belong to the converted segment.
+  /// The default implementation extracts the voxels of the segment into a temporary binary labelmap
+  /// and converts that using \sa Convert. Rules that can process a shared labelmap directly should override it.
+  virtual bool ConvertSharedLabelmap(vtkDataObject* sourceRepresentation, int labelValue, vtkDataObject* targetRepresentation);
+
+  /// Update the target representations of multiple segments.
+  /// If a label value is 0 then the source is converted using \sa Convert, otherwise the source
+  /// is a shared labelmap and it is converted using \sa ConvertSharedLabelmap with that label value.
+  /// The default implementation converts the segments one after the other. Rules that can convert
+  /// multiple segments faster (for example in parallel) should override it.
+  /// \return Success flag. False if any of the conversions failed.
+  virtual bool ConvertMultiple(const std::vector<vtkDataObject*>& sourceRepresentations, const std::vector<int>& labelValues,
+    const std::vector<vtkDataObject*>& targetRepresentations);
+
+  /// Update the target representation after the source representation was modified only within
+  /// modifiedExtent (IJK extent of the source labelmap). Label value has the same meaning as in
+  /// \sa ConvertMultiple. The default implementation converts the whole source representation.
+  /// Rules that can update only the modified region of the target should override it.
+  virtual bool ConvertModifiedExtent(vtkDataObject* sourceRepresentation, int labelValue, const int modifiedExtent[6],
+    vtkDataObject* targetRepresentation);
+
   /// Get the cost of the conversion.
   /// \return Expected duration of the conversion in milliseconds. If the arguments are omitted, then a rough average can be
   ///   given just to indicate the relative computational cost of the algorithm. If the objects are given, then a more educated
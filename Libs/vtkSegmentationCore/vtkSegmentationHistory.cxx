@@ -22,11 +22,148 @@
 #include "vtkSegmentationHistory.h"
 #include "vtkSegmentationConverterFactory.h"
 #include "vtkSegmentation.h"
+#include "vtkOrientedImageData.h"
 
 // VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkFieldData.h>
+#include <vtkMatrix4x4.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
-#include <vtkCallbackCommand.h>
+#include <vtkPointData.h>
+#include <vtkTimerLog.h>
+#include <vtkUnsignedCharArray.h>
+
+// STD includes
+#include <cstring>
+#include <set>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+/// Compute the extent of the non-zero voxels. Unlike vtkOrientedImageDataResample::CalculateEffectiveExtent,
+/// negative voxel values are considered as foreground, as they must be preserved in the history.
+template <class T>
+void CalculateNonZeroExtentGeneric(vtkImageData* image, int effectiveExtent[6])
+{
+  int* extent = image->GetExtent();
+  effectiveExtent[0] = extent[1] + 1;
+  effectiveExtent[1] = extent[0] - 1;
+  effectiveExtent[2] = extent[3] + 1;
+  effectiveExtent[3] = extent[2] - 1;
+  effectiveExtent[4] = extent[5] + 1;
+  effectiveExtent[5] = extent[4] - 1;
+  for (int z = extent[4]; z <= extent[5]; ++z)
+    {
+    for (int y = extent[2]; y <= extent[3]; ++y)
+      {
+      T* voxelPtr = static_cast<T*>(image->GetScalarPointer(extent[0], y, z));
+      for (int x = extent[0]; x <= extent[1]; ++x, ++voxelPtr)
+        {
+        if (*voxelPtr == 0)
+          {
+          continue;
+          }
+        if (x < effectiveExtent[0]) { effectiveExtent[0] = x; }
+        if (x > effectiveExtent[1]) { effectiveExtent[1] = x; }
+        if (y < effectiveExtent[2]) { effectiveExtent[2] = y; }
+        if (y > effectiveExtent[3]) { effectiveExtent[3] = y; }
+        if (z < effectiveExtent[4]) { effectiveExtent[4] = z; }
+        if (z > effectiveExtent[5]) { effectiveExtent[5] = z; }
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+template <class T>
+void AppendRun(std::vector<unsigned char>& buffer, T value, vtkTypeUInt32 runLength)
+{
+  size_t offset = buffer.size();
+  buffer.resize(offset + sizeof(T) + sizeof(vtkTypeUInt32));
+  memcpy(&buffer[offset], &value, sizeof(T));
+  memcpy(&buffer[offset + sizeof(T)], &runLength, sizeof(vtkTypeUInt32));
+}
+
+//----------------------------------------------------------------------------
+/// Run-length encode slice z of the effective extent. Runs may continue across rows.
+template <class T>
+void EncodeSliceGeneric(vtkImageData* image, const int effectiveExtent[6], int z, std::vector<unsigned char>& buffer)
+{
+  buffer.clear();
+  T runValue = 0;
+  vtkTypeUInt32 runLength = 0;
+  for (int y = effectiveExtent[2]; y <= effectiveExtent[3]; ++y)
+    {
+    T* voxelPtr = static_cast<T*>(image->GetScalarPointer(effectiveExtent[0], y, z));
+    for (int x = effectiveExtent[0]; x <= effectiveExtent[1]; ++x, ++voxelPtr)
+      {
+      if (runLength > 0 && *voxelPtr == runValue)
+        {
+        ++runLength;
+        continue;
+        }
+      if (runLength > 0)
+        {
+        AppendRun<T>(buffer, runValue, runLength);
+        }
+      runValue = *voxelPtr;
+      runLength = 1;
+      }
+    }
+  if (runLength > 0)
+    {
+    AppendRun<T>(buffer, runValue, runLength);
+    }
+}
+
+//----------------------------------------------------------------------------
+template <class T>
+void DecodeSliceGeneric(vtkUnsignedCharArray* encodedSlice, vtkImageData* image, const int effectiveExtent[6], int z)
+{
+  const unsigned char* runPtr = encodedSlice->GetPointer(0);
+  const unsigned char* runEndPtr = runPtr + encodedSlice->GetNumberOfTuples();
+  T runValue = 0;
+  vtkTypeUInt32 runLength = 0;
+  for (int y = effectiveExtent[2]; y <= effectiveExtent[3]; ++y)
+    {
+    T* voxelPtr = static_cast<T*>(image->GetScalarPointer(effectiveExtent[0], y, z));
+    for (int x = effectiveExtent[0]; x <= effectiveExtent[1]; ++x, ++voxelPtr)
+      {
+      if (runLength == 0)
+        {
+        if (runPtr + sizeof(T) + sizeof(vtkTypeUInt32) > runEndPtr)
+          {
+          // corrupted data, leave the rest of the slice empty
+          return;
+          }
+        memcpy(&runValue, runPtr, sizeof(T));
+        memcpy(&runLength, runPtr + sizeof(T), sizeof(vtkTypeUInt32));
+        runPtr += sizeof(T) + sizeof(vtkTypeUInt32);
+        }
+      *voxelPtr = runValue;
+      --runLength;
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+bool IsSameEncodedSlice(vtkUnsignedCharArray* slice1, vtkUnsignedCharArray* slice2)
+{
+  if (slice1 == NULL || slice2 == NULL)
+    {
+    return false;
+    }
+  vtkIdType size = slice1->GetNumberOfTuples();
+  if (size != slice2->GetNumberOfTuples())
+    {
+    return false;
+    }
+  return size == 0 || memcmp(slice1->GetPointer(0), slice2->GetPointer(0), size) == 0;
+}
+
+} // end of anonymous namespace
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSegmentationHistory);
@@ -41,6 +178,9 @@ vtkSegmentationHistory::vtkSegmentationHistory()
   this->LastRestoredState = 0;
   this->RestoreStateInProgress = false;
 
+  this->LastSaveStateTime = 0.0;
+  this->LastRestoreStateTime = 0.0;
+
   this->SegmentationModifiedCallbackCommand = vtkCallbackCommand::New();
   this->SegmentationModifiedCallbackCommand->SetClientData( reinterpret_cast<void *>(this) );
   this->SegmentationModifiedCallbackCommand->SetCallback(vtkSegmentationHistory::OnSegmentationModified);
@@ -95,6 +235,9 @@ void vtkSegmentationHistory::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "Modified Time: " << this->GetMTime() << "\n";
 
   os << indent << "Number of saved states:  " << this->SegmentationStates.size() << "\n";
+  os << indent << "Memory size of saved states:  " << this->GetMemorySize() << "\n";
+  os << indent << "Last save state time:  " << this->LastSaveStateTime << "\n";
+  os << indent << "Last restore state time:  " << this->LastRestoreStateTime << "\n";
 }
 
 //---------------------------------------------------------------------------
@@ -112,9 +255,13 @@ bool vtkSegmentationHistory::SaveState()
     return false;
     }
 
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+
   this->RemoveAllNextStates();
 
   SegmentationState newSegmentationState;
+  CompressedLabelmapCache compressedLabelmapCache;
 
   std::vector<std::string> segmentIDs;
   this->Segmentation->GetSegmentIDs(segmentIDs);
@@ -129,16 +276,24 @@ bool vtkSegmentationHistory::SaveState()
     // Previous saved state of the segment
     // (if the new state has exactly the same representation then only a shallow copy will be made)
     vtkSegment* baselineSegment = NULL;
+    const CompressedLabelmapsMap* baselineLabelmaps = NULL;
     if (this->SegmentationStates.size() > 0)
       {
-      SegmentsMap::iterator baselineSegmentIt = this->SegmentationStates.back().Segments.find(*segmentIDIt);
-      if (baselineSegmentIt != this->SegmentationStates.back().Segments.end())
+      SegmentationState& baselineState = this->SegmentationStates.back();
+      SegmentsMap::iterator baselineSegmentIt = baselineState.Segments.find(*segmentIDIt);
+      if (baselineSegmentIt != baselineState.Segments.end())
         {
         baselineSegment = baselineSegmentIt->second.GetPointer();
         }
+      std::map<std::string, CompressedLabelmapsMap>::iterator baselineLabelmapsIt = baselineState.Labelmaps.find(*segmentIDIt);
+      if (baselineLabelmapsIt != baselineState.Labelmaps.end())
+        {
+        baselineLabelmaps = &(baselineLabelmapsIt->second);
+        }
       }
     vtkSmartPointer<vtkSegment> segmentClone = vtkSmartPointer<vtkSegment>::New();
-    CopySegment(segmentClone, segment, baselineSegment);
+    CopySegment(segmentClone, segment, baselineSegment, newSegmentationState.Labelmaps[*segmentIDIt], baselineLabelmaps,
+      compressedLabelmapCache);
     newSegmentationState.Segments[*segmentIDIt] = segmentClone;
     }
   this->SegmentationStates.push_back(newSegmentationState);
@@ -147,12 +302,17 @@ bool vtkSegmentationHistory::SaveState()
   this->LastRestoredState = this->SegmentationStates.size();
   this->RemoveAllObsoleteStates();
 
+  timer->StopTimer();
+  this->LastSaveStateTime = timer->GetElapsedTime();
+
   this->Modified();
   return true;
 }
 
 //---------------------------------------------------------------------------
-void vtkSegmentationHistory::CopySegment(vtkSegment* destination, vtkSegment* source, vtkSegment* baseline)
+void vtkSegmentationHistory::CopySegment(vtkSegment* destination, vtkSegment* source, vtkSegment* baseline,
+  CompressedLabelmapsMap& destinationLabelmaps, const CompressedLabelmapsMap* baselineLabelmaps,
+  CompressedLabelmapCache& compressedLabelmapCache)
 {
   destination->RemoveAllRepresentations();
   destination->DeepCopyMetadata(source);
@@ -164,6 +324,49 @@ void vtkSegmentationHistory::CopySegment(vtkSegment* destination, vtkSegment* so
     representationNameIt != representationNames.end(); ++representationNameIt)
     {
     vtkDataObject* sourceRepresentation = source->GetRepresentation(*representationNameIt);
+
+    // Labelmaps are stored compressed, sharing unchanged slices with the baseline
+    vtkOrientedImageData* sourceLabelmap = vtkOrientedImageData::SafeDownCast(sourceRepresentation);
+    if (sourceLabelmap)
+      {
+      CompressedLabelmapCache::iterator cachedLabelmapIt = compressedLabelmapCache.find(sourceLabelmap);
+      if (cachedLabelmapIt != compressedLabelmapCache.end())
+        {
+        // the labelmap is shared with a segment that has been already stored
+        destinationLabelmaps[*representationNameIt] = cachedLabelmapIt->second;
+        continue;
+        }
+      const CompressedLabelmap* baselineLabelmap = NULL;
+      if (baselineLabelmaps)
+        {
+        CompressedLabelmapsMap::const_iterator baselineLabelmapIt = baselineLabelmaps->find(*representationNameIt);
+        if (baselineLabelmapIt != baselineLabelmaps->end())
+          {
+          baselineLabelmap = &(baselineLabelmapIt->second);
+          }
+        }
+      CompressedLabelmap compressedLabelmap;
+      bool compressed = false;
+      if (baselineLabelmap && baselineLabelmap->SourceMTime == sourceLabelmap->GetMTime())
+        {
+        // the labelmap has not changed since the baseline was saved
+        compressedLabelmap = *baselineLabelmap;
+        compressed = true;
+        }
+      else
+        {
+        compressed = this->CompressLabelmap(sourceLabelmap, compressedLabelmap, baselineLabelmap);
+        }
+      if (compressed)
+        {
+        compressedLabelmap.Layer = static_cast<int>(compressedLabelmapCache.size());
+        compressedLabelmapCache[sourceLabelmap] = compressedLabelmap;
+        destinationLabelmaps[*representationNameIt] = compressedLabelmap;
+        continue;
+        }
+      // the labelmap cannot be compressed, store a copy
+      }
+
     vtkDataObject* baselineRepresentation = NULL;
     if (baseline)
       {
@@ -242,25 +445,35 @@ bool vtkSegmentationHistory::RestoreNextState()
 //---------------------------------------------------------------------------
 bool vtkSegmentationHistory::RestoreState(unsigned int stateIndex)
 {
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+
   this->RestoreStateInProgress = true;
 
   SegmentationState restoredState = this->SegmentationStates[stateIndex];
+  RestoredLabelmapCache restoredLabelmapCache;
 
   std::set<std::string> segmentIDsToKeep;
   for (SegmentsMap::iterator restoredSegmentsIt = restoredState.Segments.begin();
     restoredSegmentsIt != restoredState.Segments.end(); ++restoredSegmentsIt)
     {
     segmentIDsToKeep.insert(restoredSegmentsIt->first);
+    const CompressedLabelmapsMap* restoredLabelmaps = NULL;
+    std::map<std::string, CompressedLabelmapsMap>::iterator restoredLabelmapsIt = restoredState.Labelmaps.find(restoredSegmentsIt->first);
+    if (restoredLabelmapsIt != restoredState.Labelmaps.end())
+      {
+      restoredLabelmaps = &(restoredLabelmapsIt->second);
+      }
     vtkSegment* segment = this->Segmentation->GetSegment(restoredSegmentsIt->first);
     if (segment != NULL)
       {
-      segment->DeepCopy(restoredSegmentsIt->second);
+      this->RestoreSegment(segment, restoredSegmentsIt->second, restoredLabelmaps, restoredLabelmapCache);
       segment->Modified();
       }
     else
       {
       vtkSmartPointer<vtkSegment> newSegment = vtkSmartPointer<vtkSegment>::New();
-      newSegment->DeepCopy(restoredSegmentsIt->second);
+      this->RestoreSegment(newSegment, restoredSegmentsIt->second, restoredLabelmaps, restoredLabelmapCache);
       this->Segmentation->AddSegment(newSegment);
       }
     }
@@ -281,10 +494,200 @@ bool vtkSegmentationHistory::RestoreState(unsigned int stateIndex)
   this->LastRestoredState = stateIndex;
 
   this->RestoreStateInProgress = false;
+
+  timer->StopTimer();
+  this->LastRestoreStateTime = timer->GetElapsedTime();
+
   this->Modified();
   return true;
 }
 
+//---------------------------------------------------------------------------
+void vtkSegmentationHistory::RestoreSegment(vtkSegment* destination, vtkSegment* source, const CompressedLabelmapsMap* labelmaps,
+  RestoredLabelmapCache& restoredLabelmapCache)
+{
+  // Representations that are not labelmaps are stored as full copies
+  destination->DeepCopy(source);
+  if (!labelmaps)
+    {
+    return;
+    }
+  for (CompressedLabelmapsMap::const_iterator labelmapIt = labelmaps->begin(); labelmapIt != labelmaps->end(); ++labelmapIt)
+    {
+    vtkSmartPointer<vtkOrientedImageData>& labelmap = restoredLabelmapCache[labelmapIt->second.Layer];
+    if (!labelmap)
+      {
+      labelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+      this->DecompressLabelmap(labelmapIt->second, labelmap);
+      }
+    destination->AddRepresentation(labelmapIt->first, labelmap);
+    }
+}
+
+//---------------------------------------------------------------------------
+bool vtkSegmentationHistory::CompressLabelmap(vtkOrientedImageData* labelmap, CompressedLabelmap& compressedLabelmap,
+  const CompressedLabelmap* baselineCompressedLabelmap)
+{
+  if (!labelmap || !labelmap->GetPointData() || !labelmap->GetPointData()->GetScalars()
+    || labelmap->GetNumberOfScalarComponents() != 1)
+    {
+    return false;
+    }
+  int* extent = labelmap->GetExtent();
+  if (extent[0] > extent[1] || extent[2] > extent[3] || extent[4] > extent[5])
+    {
+    return false;
+    }
+
+  compressedLabelmap.SourceMTime = labelmap->GetMTime();
+  compressedLabelmap.ScalarType = labelmap->GetScalarType();
+  labelmap->GetExtent(compressedLabelmap.Extent);
+  vtkNew<vtkMatrix4x4> imageToWorldMatrix;
+  labelmap->GetImageToWorldMatrix(imageToWorldMatrix.GetPointer());
+  vtkMatrix4x4::DeepCopy(compressedLabelmap.ImageToWorldMatrix, imageToWorldMatrix.GetPointer());
+  if (labelmap->GetFieldData() && labelmap->GetFieldData()->GetNumberOfArrays() > 0)
+    {
+    compressedLabelmap.FieldData = vtkSmartPointer<vtkFieldData>::New();
+    compressedLabelmap.FieldData->DeepCopy(labelmap->GetFieldData());
+    }
+
+  switch (compressedLabelmap.ScalarType)
+    {
+    vtkTemplateMacro(CalculateNonZeroExtentGeneric<VTK_TT>(labelmap, compressedLabelmap.EffectiveExtent));
+    default:
+      vtkErrorMacro("CompressLabelmap: Unknown scalar type");
+      return false;
+    }
+  int* effectiveExtent = compressedLabelmap.EffectiveExtent;
+  compressedLabelmap.Slices.clear();
+  if (effectiveExtent[0] > effectiveExtent[1])
+    {
+    // empty labelmap, no slices need to be stored
+    return true;
+    }
+
+  // Slices of the baseline can only be reused if they cover the same rows.
+  // If the non-zero region did not grow out of the rows of the baseline (e.g. after
+  // erasing or painting inside the segment), the baseline rows are used: encoding the
+  // empty margin only costs one run per slice.
+  bool baselineSlicesCompatible = baselineCompressedLabelmap
+    && baselineCompressedLabelmap->ScalarType == compressedLabelmap.ScalarType
+    && baselineCompressedLabelmap->EffectiveExtent[0] <= baselineCompressedLabelmap->EffectiveExtent[1]
+    && baselineCompressedLabelmap->EffectiveExtent[0] <= effectiveExtent[0]
+    && baselineCompressedLabelmap->EffectiveExtent[1] >= effectiveExtent[1]
+    && baselineCompressedLabelmap->EffectiveExtent[2] <= effectiveExtent[2]
+    && baselineCompressedLabelmap->EffectiveExtent[3] >= effectiveExtent[3]
+    && baselineCompressedLabelmap->EffectiveExtent[0] >= extent[0]
+    && baselineCompressedLabelmap->EffectiveExtent[1] <= extent[1]
+    && baselineCompressedLabelmap->EffectiveExtent[2] >= extent[2]
+    && baselineCompressedLabelmap->EffectiveExtent[3] <= extent[3];
+  if (baselineSlicesCompatible)
+    {
+    for (int i = 0; i < 4; ++i)
+      {
+      effectiveExtent[i] = baselineCompressedLabelmap->EffectiveExtent[i];
+      }
+    }
+
+  std::vector<unsigned char> buffer;
+  for (int z = effectiveExtent[4]; z <= effectiveExtent[5]; ++z)
+    {
+    switch (compressedLabelmap.ScalarType)
+      {
+      vtkTemplateMacro(EncodeSliceGeneric<VTK_TT>(labelmap, effectiveExtent, z, buffer));
+      }
+    vtkSmartPointer<vtkUnsignedCharArray> encodedSlice = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    encodedSlice->SetNumberOfTuples(static_cast<vtkIdType>(buffer.size()));
+    if (!buffer.empty())
+      {
+      memcpy(encodedSlice->GetPointer(0), &buffer[0], buffer.size());
+      }
+    if (baselineSlicesCompatible
+      && z >= baselineCompressedLabelmap->EffectiveExtent[4] && z <= baselineCompressedLabelmap->EffectiveExtent[5])
+      {
+      vtkUnsignedCharArray* baselineSlice = baselineCompressedLabelmap->Slices[z - baselineCompressedLabelmap->EffectiveExtent[4]];
+      if (IsSameEncodedSlice(encodedSlice, baselineSlice))
+        {
+        // share the slice with the baseline
+        encodedSlice = baselineSlice;
+        }
+      }
+    compressedLabelmap.Slices.push_back(encodedSlice);
+    }
+  return true;
+}
+
+//---------------------------------------------------------------------------
+void vtkSegmentationHistory::DecompressLabelmap(const CompressedLabelmap& compressedLabelmap, vtkOrientedImageData* labelmap)
+{
+  labelmap->SetExtent(const_cast<int*>(compressedLabelmap.Extent));
+  vtkNew<vtkMatrix4x4> imageToWorldMatrix;
+  imageToWorldMatrix->DeepCopy(compressedLabelmap.ImageToWorldMatrix);
+  labelmap->SetImageToWorldMatrix(imageToWorldMatrix.GetPointer());
+  labelmap->AllocateScalars(compressedLabelmap.ScalarType, 1);
+  if (compressedLabelmap.FieldData)
+    {
+    labelmap->GetFieldData()->DeepCopy(compressedLabelmap.FieldData);
+    }
+
+  // Voxels outside of the effective extent are empty
+  void* voxelsPtr = labelmap->GetScalarPointer();
+  memset(voxelsPtr, 0, labelmap->GetScalarSize() * labelmap->GetNumberOfPoints());
+
+  const int* effectiveExtent = compressedLabelmap.EffectiveExtent;
+  for (int z = effectiveExtent[4]; z <= effectiveExtent[5] && effectiveExtent[0] <= effectiveExtent[1]; ++z)
+    {
+    vtkUnsignedCharArray* encodedSlice = compressedLabelmap.Slices[z - effectiveExtent[4]];
+    switch (compressedLabelmap.ScalarType)
+      {
+      vtkTemplateMacro(DecodeSliceGeneric<VTK_TT>(encodedSlice, labelmap, effectiveExtent, z));
+      }
+    }
+}
+
+//---------------------------------------------------------------------------
+vtkIdType vtkSegmentationHistory::GetMemorySize()
+{
+  vtkIdType memorySize = 0;
+  std::set<vtkObjectBase*> countedObjects;
+  for (std::deque<SegmentationState>::iterator stateIt = this->SegmentationStates.begin();
+    stateIt != this->SegmentationStates.end(); ++stateIt)
+    {
+    for (SegmentsMap::iterator segmentIt = stateIt->Segments.begin(); segmentIt != stateIt->Segments.end(); ++segmentIt)
+      {
+      std::vector<std::string> representationNames;
+      segmentIt->second->GetContainedRepresentationNames(representationNames);
+      for (std::vector<std::string>::iterator representationNameIt = representationNames.begin();
+        representationNameIt != representationNames.end(); ++representationNameIt)
+        {
+        vtkDataObject* representation = segmentIt->second->GetRepresentation(*representationNameIt);
+        if (representation && countedObjects.insert(representation).second)
+          {
+          memorySize += static_cast<vtkIdType>(representation->GetActualMemorySize()) * 1024;
+          }
+        }
+      }
+    for (std::map<std::string, CompressedLabelmapsMap>::iterator segmentLabelmapsIt = stateIt->Labelmaps.begin();
+      segmentLabelmapsIt != stateIt->Labelmaps.end(); ++segmentLabelmapsIt)
+      {
+      for (CompressedLabelmapsMap::iterator labelmapIt = segmentLabelmapsIt->second.begin();
+        labelmapIt != segmentLabelmapsIt->second.end(); ++labelmapIt)
+        {
+        memorySize += sizeof(CompressedLabelmap);
+        std::vector<vtkSmartPointer<vtkUnsignedCharArray> >& slices = labelmapIt->second.Slices;
+        for (std::vector<vtkSmartPointer<vtkUnsignedCharArray> >::iterator sliceIt = slices.begin(); sliceIt != slices.end(); ++sliceIt)
+          {
+          if (countedObjects.insert(sliceIt->GetPointer()).second)
+            {
+            memorySize += (*sliceIt)->GetNumberOfTuples();
+            }
+          }
+        }
+      }
+    }
+  return memorySize;
+}
+
 //---------------------------------------------------------------------------
 bool vtkSegmentationHistory::IsRestorePreviousStateAvailable()
 {
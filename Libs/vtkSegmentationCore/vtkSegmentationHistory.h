@@ -28,12 +28,17 @@
 // STD includes
 #include <deque>
 #include <map>
+#include <vector>
 
 #include "vtkSegmentationCoreConfigure.h"
 
 class vtkCallbackCommand;
+class vtkDataObject;
+class vtkFieldData;
+class vtkOrientedImageData;
 class vtkSegment;
 class vtkSegmentation;
+class vtkUnsignedCharArray;
 
 /// \ingroup SegmentationCore
 class vtkSegmentationCore_EXPORT vtkSegmentationHistory : public vtkObject
@@ -81,6 +86,16 @@ public:
   /// Get the limit of how many states may be stored.
   vtkGetMacro(MaximumNumberOfStates, unsigned int);
 
+  /// Get the number of bytes used by all the stored states.
+  /// Data that is shared between states is only counted once.
+  vtkIdType GetMemorySize();
+
+  /// Get the time in seconds it took to save the last state.
+  vtkGetMacro(LastSaveStateTime, double);
+
+  /// Get the time in seconds it took to restore the last restored state.
+  vtkGetMacro(LastRestoreStateTime, double);
+
 protected:
   /// Callback function called when the segmentation has been modified.
   /// It clears all states that are more recent than the last restored state.
@@ -96,22 +111,75 @@ protected:
   bool RestoreState(unsigned int stateIndex);
 
 protected:
-  vtkSegmentationHistory();
-  ~vtkSegmentationHistory();
-  void operator=(const vtkSegmentationHistory&);
-
-  /// Deep copies source segment to destination segment. If the same representation is found in baseline
-  /// with up-to-date timestamp then the representation is reused from baseline.
-  void CopySegment(vtkSegment* destination, vtkSegment* source, vtkSegment* baseline);
-
-protected:  /// Container type for segments. Maps segment IDs to segment objects
+  /// Container type for segments. Maps segment IDs to segment objects
   typedef std::map<std::string, vtkSmartPointer<vtkSegment> > SegmentsMap;
 
+  /// Run-length encoded copy of a labelmap representation.
+  /// Only the extent that contains non-zero voxels is stored, voxels outside of it are zero.
+  /// The rows of the previous state are kept if they still contain all the non-zero voxels,
+  /// so that the slices can be shared after an edit that shrinks the non-zero extent.
+  /// Each slice (along the third axis) is encoded into a separate array so that slices
+  /// that have not changed since the previous state are shared with that state instead of
+  /// being stored again.
+  struct CompressedLabelmap
+    {
+    int Extent[6];
+    int EffectiveExtent[6];
+    double ImageToWorldMatrix[16];
+    int ScalarType;
+    /// Modified time of the source labelmap at the time it was compressed
+    vtkMTimeType SourceMTime;
+    vtkSmartPointer<vtkFieldData> FieldData;
+    /// Encoded slices of EffectiveExtent, each is a sequence of (value, run length) pairs
+    std::vector<vtkSmartPointer<vtkUnsignedCharArray> > Slices;
+    /// Index of the labelmap object within the state. Segments that shared the same
+    /// labelmap object (layer) have the same index and share the restored labelmap as well.
+    int Layer;
+    };
+  /// Maps representation names to compressed labelmaps
+  typedef std::map<std::string, CompressedLabelmap> CompressedLabelmapsMap;
+  /// Maps labelmap objects of the segmentation to their compressed form in a state
+  typedef std::map<vtkDataObject*, CompressedLabelmap> CompressedLabelmapCache;
+  /// Maps layer indices of a state to the restored labelmap objects
+  typedef std::map<int, vtkSmartPointer<vtkOrientedImageData> > RestoredLabelmapCache;
+
   struct SegmentationState
     {
+    /// Segments without their labelmap representations
     SegmentsMap Segments;
+    /// Maps segment IDs to the compressed labelmap representations of the segment
+    std::map<std::string, CompressedLabelmapsMap> Labelmaps;
     };
 
+protected:
+  vtkSegmentationHistory();
+  ~vtkSegmentationHistory();
+  void operator=(const vtkSegmentationHistory&);
+
+  /// Deep copies source segment to destination segment. If the same representation is found in baseline
+  /// with up-to-date timestamp then the representation is reused from baseline.
+  /// Labelmap representations are not copied into the destination but stored in
+  /// destinationLabelmaps as compressed labelmaps. Labelmaps that are shared between
+  /// segments are compressed only once, using compressedLabelmapCache.
+  void CopySegment(vtkSegment* destination, vtkSegment* source, vtkSegment* baseline,
+    CompressedLabelmapsMap& destinationLabelmaps, const CompressedLabelmapsMap* baselineLabelmaps,
+    CompressedLabelmapCache& compressedLabelmapCache);
+
+  /// Deep copies a stored segment and decompresses its labelmaps into the destination segment.
+  /// Labelmaps of the same layer are decompressed only once and shared, using restoredLabelmapCache.
+  void RestoreSegment(vtkSegment* destination, vtkSegment* source, const CompressedLabelmapsMap* labelmaps,
+    RestoredLabelmapCache& restoredLabelmapCache);
+
+  /// Compresses a labelmap. Slices that are the same in the baseline are shared with it.
+  /// \return Success flag. Returns false if the image cannot be compressed (it has no scalars
+  ///   or it has multiple components), in which case it has to be deep-copied.
+  bool CompressLabelmap(vtkOrientedImageData* labelmap, CompressedLabelmap& compressedLabelmap,
+    const CompressedLabelmap* baselineCompressedLabelmap);
+
+  /// Creates a labelmap from its compressed form.
+  void DecompressLabelmap(const CompressedLabelmap& compressedLabelmap, vtkOrientedImageData* labelmap);
+
+protected:
   vtkSegmentation* Segmentation;
   vtkCallbackCommand* SegmentationModifiedCallbackCommand;
   std::deque<SegmentationState> SegmentationStates;
@@ -123,6 +191,9 @@ protected:  /// Container type for segments. Maps segment IDs to segment objects
   unsigned int LastRestoredState;
 
   bool RestoreStateInProgress;
+
+  double LastSaveStateTime;
+  double LastRestoreStateTime;
 };
 
 #endif // __vtkSegmentation_h
@@ -0,0 +1,544 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// vtkAddon includes
+#include <vtkAddonTestingMacros.h>
+
+// vtkTeem includes
+#include <vtkDiffusionTensorMathematics.h>
+
+// VTK includes
+#include <vtkFloatArray.h>
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Random rotation R and m = R diag(w) R^T
+void CreateTensor(const double w[3], double m[3][3])
+{
+  double quaternion[4];
+  for (int i = 0; i < 4; ++i)
+    {
+    quaternion[i] = vtkMath::Random(-1., 1.);
+    }
+  double norm = sqrt(quaternion[0]*quaternion[0] + quaternion[1]*quaternion[1]
+                     + quaternion[2]*quaternion[2] + quaternion[3]*quaternion[3]);
+  for (int i = 0; i < 4; ++i)
+    {
+    quaternion[i] /= norm;
+    }
+  double rotation[3][3];
+  vtkMath::QuaternionToMatrix3x3(quaternion, rotation);
+  for (int i = 0; i < 3; ++i)
+    {
+    for (int j = 0; j < 3; ++j)
+      {
+      m[i][j] = 0.;
+      for (int k = 0; k < 3; ++k)
+        {
+        m[i][j] += rotation[i][k] * w[k] * rotation[j][k];
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Diffusivities of 2mm DTI: eigenvalues of the order of 1e-3 mm^2/s,
+// well separated unless the shape makes some of them equal.
+void RandomEigenvalues(int shape, double w[3])
+{
+  w[0] = vtkMath::Random(1e-3, 3e-3);
+  w[1] = w[0] * vtkMath::Random(0.2, 0.8);
+  w[2] = w[1] * vtkMath::Random(0.2, 0.8);
+  switch (shape)
+    {
+    case 1: // linear
+      w[2] = w[1];
+      break;
+    case 2: // planar
+      w[1] = w[0];
+      break;
+    case 3: // isotropic
+      w[1] = w[2] = w[0];
+      break;
+    }
+}
+
+//----------------------------------------------------------------------------
+int CheckEigensystem(double m[3][3], double w[3], double **v)
+{
+  const double scale = std::max(fabs(w[0]), fabs(w[2]));
+  if (w[0] < w[1] || w[1] < w[2])
+    {
+    std::cerr << "Eigenvalues are not sorted: " << w[0] << " " << w[1] << " " << w[2] << std::endl;
+    return EXIT_FAILURE;
+    }
+  for (int k = 0; k < 3; ++k)
+    {
+    for (int l = 0; l < 3; ++l)
+      {
+      double dot = v[0][k]*v[0][l] + v[1][k]*v[1][l] + v[2][k]*v[2][l];
+      if (fabs(dot - (k == l ? 1. : 0.)) > 1e-9)
+        {
+        std::cerr << "Eigenvectors are not orthonormal: " << dot << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    double residual = 0.;
+    for (int i = 0; i < 3; ++i)
+      {
+      double mv = m[i][0]*v[0][k] + m[i][1]*v[1][k] + m[i][2]*v[2][k];
+      residual += (mv - w[k]*v[i][k]) * (mv - w[k]*v[i][k]);
+      }
+    if (sqrt(residual) > 1e-7 * scale)
+      {
+      std::cerr << "Eigenvector " << k << " has a residual of " << sqrt(residual) << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+// Compare the closed-form solver with the teem solver
+int TestEigenSolver()
+{
+  double m0[3], m1[3], m2[3];
+  double *m[3] = {m0, m1, m2};
+  double v0[3], v1[3], v2[3];
+  double *v[3] = {v0, v1, v2};
+  double teemV0[3], teemV1[3], teemV2[3];
+  double *teemV[3] = {teemV0, teemV1, teemV2};
+  for (int test = 0; test < 10000; ++test)
+    {
+    int shape = test % 4;
+    double eigenvalues[3];
+    double tensor[3][3];
+    RandomEigenvalues(shape, eigenvalues);
+    CreateTensor(eigenvalues, tensor);
+    for (int i = 0; i < 3; ++i)
+      {
+      for (int j = 0; j < 3; ++j)
+        {
+        m[i][j] = tensor[i][j];
+        }
+      }
+    double w[3];
+    vtkDiffusionTensorMathematics::ClosedFormEigenSolver(m, w, v);
+    if (CheckEigensystem(tensor, w, v) != EXIT_SUCCESS)
+      {
+      std::cerr << "Shape " << shape << " failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+    double teemW[3];
+    vtkDiffusionTensorMathematics::TeemEigenSolver(m, teemW, teemV);
+    const double scale = teemW[0];
+    for (int k = 0; k < 3; ++k)
+      {
+      if (fabs(w[k] - teemW[k]) > 1e-7 * scale)
+        {
+        std::cerr << "Eigenvalue " << k << " is " << w[k] << ", teem: " << teemW[k] << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    // Eigenvectors of distinct eigenvalues are unique up to the sign
+    if (shape == 0)
+      {
+      for (int k = 0; k < 3; ++k)
+        {
+        double dot = v[0][k]*teemV[0][k] + v[1][k]*teemV[1][k] + v[2][k]*teemV[2][k];
+        if (fabs(fabs(dot) - 1.) > 1e-6)
+          {
+          std::cerr << "Eigenvector " << k << " differs from teem: " << dot << std::endl;
+          return EXIT_FAILURE;
+          }
+        }
+      }
+    }
+
+  // Eigenvalues only
+  double w[3];
+  m[0][0] = 3.; m[0][1] = 1.; m[0][2] = 0.;
+  m[1][0] = 1.; m[1][1] = 3.; m[1][2] = 0.;
+  m[2][0] = 0.; m[2][1] = 0.; m[2][2] = 1.;
+  vtkDiffusionTensorMathematics::ClosedFormEigenSolver(m, w, NULL);
+  if (fabs(w[0] - 4.) > 1e-12 || fabs(w[1] - 2.) > 1e-12 || fabs(w[2] - 1.) > 1e-12)
+    {
+    std::cerr << "Wrong eigenvalues: " << w[0] << " " << w[1] << " " << w[2] << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+// Compare the closed-form solver with the teem solver and with the exact
+// eigenvalues for tensors with two nearly equal eigenvalues, for which the
+// closed-form eigenvalues lose precision.
+int TestNearlyRepeatedEigenvalues()
+{
+  double m0[3], m1[3], m2[3];
+  double *m[3] = {m0, m1, m2};
+  double v0[3], v1[3], v2[3];
+  double *v[3] = {v0, v1, v2};
+  double teemV0[3], teemV1[3], teemV2[3];
+  double *teemV[3] = {teemV0, teemV1, teemV2};
+  const double gaps[5] = {1e-6, 1e-7, 1e-8, 1e-9, 1e-10};
+  for (int gap = 0; gap < 5; ++gap)
+    {
+    for (int test = 0; test < 1000; ++test)
+      {
+      // linear (medium ~ minor) or planar (major ~ medium)
+      const bool linear = (test % 2 == 0);
+      double eigenvalues[3];
+      eigenvalues[0] = vtkMath::Random(1e-3, 3e-3);
+      if (linear)
+        {
+        eigenvalues[1] = eigenvalues[0] * vtkMath::Random(0.2, 0.8);
+        eigenvalues[2] = eigenvalues[1] * (1. - gaps[gap] * vtkMath::Random(0.5, 1.));
+        }
+      else
+        {
+        eigenvalues[1] = eigenvalues[0] * (1. - gaps[gap] * vtkMath::Random(0.5, 1.));
+        eigenvalues[2] = eigenvalues[1] * vtkMath::Random(0.2, 0.8);
+        }
+      double tensor[3][3];
+      CreateTensor(eigenvalues, tensor);
+      for (int i = 0; i < 3; ++i)
+        {
+        for (int j = 0; j < 3; ++j)
+          {
+          m[i][j] = tensor[i][j];
+          }
+        }
+      double w[3];
+      vtkDiffusionTensorMathematics::ClosedFormEigenSolver(m, w, v);
+      if (CheckEigensystem(tensor, w, v) != EXIT_SUCCESS)
+        {
+        std::cerr << "Relative gap " << gaps[gap] << " failed" << std::endl;
+        return EXIT_FAILURE;
+        }
+      double teemW[3];
+      vtkDiffusionTensorMathematics::TeemEigenSolver(m, teemW, teemV);
+      const double scale = eigenvalues[0];
+      for (int k = 0; k < 3; ++k)
+        {
+        if (fabs(w[k] - eigenvalues[k]) > 5e-8 * scale
+          || fabs(w[k] - teemW[k]) > 1e-7 * scale)
+          {
+          std::cerr << "Relative gap " << gaps[gap] << ": eigenvalue " << k << " is " << w[k]
+                    << ", exact: " << eigenvalues[k] << ", teem: " << teemW[k] << std::endl;
+          return EXIT_FAILURE;
+          }
+        }
+      // Only the eigenvector of the distinct eigenvalue is unique (up to
+      // the sign), it defines the plane of the two others.
+      const int k = linear ? 0 : 2;
+      double dot = v[0][k]*teemV[0][k] + v[1][k]*teemV[1][k] + v[2][k]*teemV[2][k];
+      if (fabs(fabs(dot) - 1.) > 1e-9)
+        {
+        std::cerr << "Relative gap " << gaps[gap] << ": eigenvector " << k
+                  << " differs from teem: " << dot << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    }
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+// Trigonometric solution with the libm functions, as reference for the
+// polynomial approximations of ClosedFormEigenvalues.
+void LibmEigenvalues(int n, double* const t[6], double* const w[3])
+{
+  const double twoPiOver3 = 2.0943951023931954923;
+  for (int i = 0; i < n; ++i)
+    {
+    const double m = (t[0][i] + t[3][i] + t[5][i]) / 3.;
+    const double a = t[0][i] - m;
+    const double d = t[3][i] - m;
+    const double f = t[5][i] - m;
+    const double b = t[1][i];
+    const double c = t[2][i];
+    const double e = t[4][i];
+    const double p2 = (a*a + d*d + f*f + 2.*(b*b + c*c + e*e)) / 6.;
+    const double halfDet = (a*(d*f - e*e) - b*(b*f - e*c) + c*(b*e - d*c)) / 2.;
+    const double p = sqrt(p2);
+    double r = p2 > 0. ? halfDet / (p2 * p) : 0.;
+    r = std::min(1., std::max(-1., r));
+    const double phi = acos(r) / 3.;
+    w[0][i] = m + 2.*p*cos(phi);
+    w[2][i] = m + 2.*p*cos(phi + twoPiOver3);
+    w[1][i] = 3.*m - w[0][i] - w[2][i];
+    }
+}
+
+//----------------------------------------------------------------------------
+// Compare ClosedFormEigenvalues with the libm functions. The number of
+// tensors is 3 modulo 4 so that the AVX, SSE2 and scalar loops are all
+// used when they are enabled.
+int TestClosedFormEigenvalues(bool benchmark)
+{
+  const int n = 100003;
+  std::vector<double> buffer(12 * static_cast<size_t>(n));
+  double* t[6];
+  double* w[3];
+  double* libmW[3];
+  for (int i = 0; i < 6; ++i)
+    {
+    t[i] = &buffer[i * static_cast<size_t>(n)];
+    }
+  for (int i = 0; i < 3; ++i)
+    {
+    w[i] = &buffer[(6 + i) * static_cast<size_t>(n)];
+    libmW[i] = &buffer[(9 + i) * static_cast<size_t>(n)];
+    }
+  for (int i = 0; i < n; ++i)
+    {
+    double eigenvalues[3];
+    double tensor[3][3];
+    RandomEigenvalues(i % 4, eigenvalues);
+    CreateTensor(eigenvalues, tensor);
+    t[0][i] = tensor[0][0];
+    t[1][i] = tensor[0][1];
+    t[2][i] = tensor[0][2];
+    t[3][i] = tensor[1][1];
+    t[4][i] = tensor[1][2];
+    t[5][i] = tensor[2][2];
+    }
+
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  LibmEigenvalues(n, t, libmW);
+  timer->StopTimer();
+  double libmTime = timer->GetElapsedTime();
+  timer->StartTimer();
+  vtkDiffusionTensorMathematics::ClosedFormEigenvalues(n, t, w);
+  timer->StopTimer();
+  double closedFormTime = timer->GetElapsedTime();
+  if (benchmark)
+    {
+    vtkAddonTestingUtilities::ReportMeasurement("vtkDiffusionTensorMathematics-Eigenvalues-Libm", libmTime);
+    vtkAddonTestingUtilities::ReportMeasurement("vtkDiffusionTensorMathematics-Eigenvalues-ClosedForm", closedFormTime);
+    }
+
+  for (int i = 0; i < n; ++i)
+    {
+    const double scale = libmW[0][i];
+    for (int k = 0; k < 3; ++k)
+      {
+      if (fabs(w[k][i] - libmW[k][i]) > 1e-14 * scale)
+        {
+        std::cerr << "Tensor " << i << ": eigenvalue " << k << " is " << w[k][i]
+                  << ", with libm: " << libmW[k][i] << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    if (w[0][i] < w[1][i] || w[1][i] < w[2][i])
+      {
+      std::cerr << "Tensor " << i << ": eigenvalues are not sorted" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkImageData> CreateTensorImage(int size)
+{
+  vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+  image->SetDimensions(size, size, size / 2);
+  vtkNew<vtkFloatArray> tensors;
+  tensors->SetNumberOfComponents(9);
+  tensors->SetNumberOfTuples(image->GetNumberOfPoints());
+  for (vtkIdType i = 0; i < image->GetNumberOfPoints(); ++i)
+    {
+    double eigenvalues[3];
+    double tensor[3][3];
+    RandomEigenvalues(i % 4, eigenvalues);
+    CreateTensor(eigenvalues, tensor);
+    float* ptr = tensors->GetPointer(9 * i);
+    for (int j = 0; j < 9; ++j)
+      {
+      ptr[j] = static_cast<float>(tensor[j / 3][j % 3]);
+      }
+    }
+  image->GetPointData()->SetTensors(tensors.GetPointer());
+  return image;
+}
+
+//----------------------------------------------------------------------------
+// If uniqueMajorEigenvector is true, the planar and isotropic tensors of
+// CreateTensorImage are skipped.
+double MaximumDifference(vtkImageData* image1, int component1,
+                         vtkImageData* image2, int component2,
+                         bool uniqueMajorEigenvector = false)
+{
+  vtkDataArray* scalars1 = image1->GetPointData()->GetScalars();
+  vtkDataArray* scalars2 = image2->GetPointData()->GetScalars();
+  double difference = 0.;
+  for (vtkIdType i = 0; i < scalars1->GetNumberOfTuples(); ++i)
+    {
+    if (uniqueMajorEigenvector && i % 4 >= 2)
+      {
+      continue;
+      }
+    difference = std::max(difference, fabs(scalars1->GetComponent(i, component1)
+                                           - scalars2->GetComponent(i, component2)));
+    }
+  return difference;
+}
+
+//----------------------------------------------------------------------------
+// Compare the outputs and the speed of the filter with both solvers
+int TestFilter(bool benchmark)
+{
+  vtkSmartPointer<vtkImageData> tensorImage = CreateTensorImage(64);
+
+  const int operations[4] = {
+    vtkDiffusionTensorMathematics::VTK_TENS_FRACTIONAL_ANISOTROPY,
+    vtkDiffusionTensorMathematics::VTK_TENS_MODE,
+    vtkDiffusionTensorMathematics::VTK_TENS_MIN_EIGENVALUE,
+    vtkDiffusionTensorMathematics::VTK_TENS_MAX_EIGENVALUE_PROJZ};
+  const char* names[4] = {"FA", "Mode", "MinEigenvalue", "MaxEigenvalueProjectionZ"};
+  // output values of the order of 1
+  const double scaleFactors[4] = {1., 1., 1000., 1000.};
+
+  vtkNew<vtkDiffusionTensorMathematics> teem;
+  teem->SetInputData(tensorImage);
+  if (teem->GetUseClosedFormEigenSolver())
+    {
+    std::cerr << "The teem solver is not the default" << std::endl;
+    return EXIT_FAILURE;
+    }
+  vtkNew<vtkDiffusionTensorMathematics> closedForm;
+  closedForm->SetInputData(tensorImage);
+  closedForm->UseClosedFormEigenSolverOn();
+
+  vtkNew<vtkTimerLog> timer;
+  for (int i = 0; i < 4; ++i)
+    {
+    teem->SetOperation(operations[i]);
+    teem->SetScaleFactor(scaleFactors[i]);
+    closedForm->SetOperation(operations[i]);
+    closedForm->SetScaleFactor(scaleFactors[i]);
+
+    timer->StartTimer();
+    teem->Update();
+    timer->StopTimer();
+    double teemTime = timer->GetElapsedTime();
+    timer->StartTimer();
+    closedForm->Update();
+    timer->StopTimer();
+    double closedFormTime = timer->GetElapsedTime();
+    if (benchmark)
+      {
+      REPORT_MEASUREMENT("vtkDiffusionTensorMathematics-" << names[i] << "-Teem", teemTime);
+      REPORT_MEASUREMENT("vtkDiffusionTensorMathematics-" << names[i] << "-ClosedForm", closedFormTime);
+      }
+
+    double difference = MaximumDifference(teem->GetOutput(), 0, closedForm->GetOutput(), 0,
+      operations[i] == vtkDiffusionTensorMathematics::VTK_TENS_MAX_EIGENVALUE_PROJZ);
+    if (difference > 1e-4)
+      {
+      std::cerr << names[i] << " differs from teem by " << difference << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // Several operations in one pass
+  vtkNew<vtkDiffusionTensorMathematics> operationsFilter;
+  operationsFilter->SetInputData(tensorImage);
+  operationsFilter->UseClosedFormEigenSolverOn();
+  operationsFilter->SetScaleFactor(1000.);
+  operationsFilter->AddOperation(vtkDiffusionTensorMathematics::VTK_TENS_TRACE);
+  operationsFilter->AddOperation(vtkDiffusionTensorMathematics::VTK_TENS_MIN_EIGENVALUE);
+  operationsFilter->AddOperation(vtkDiffusionTensorMathematics::VTK_TENS_MAX_EIGENVALUE_PROJZ);
+  if (operationsFilter->GetNumberOfOperations() != 3
+    || operationsFilter->GetNthOperation(1) != vtkDiffusionTensorMathematics::VTK_TENS_MIN_EIGENVALUE)
+    {
+    std::cerr << "Failed to add operations" << std::endl;
+    return EXIT_FAILURE;
+    }
+  timer->StartTimer();
+  operationsFilter->Update();
+  timer->StopTimer();
+  if (benchmark)
+    {
+    vtkAddonTestingUtilities::ReportMeasurement("vtkDiffusionTensorMathematics-3Operations", timer->GetElapsedTime());
+    }
+  vtkImageData* output = operationsFilter->GetOutput();
+  if (output->GetNumberOfScalarComponents() != 3 || output->GetScalarType() != VTK_FLOAT)
+    {
+    std::cerr << "Wrong output for 3 operations: " << output->GetNumberOfScalarComponents()
+              << " components of type " << output->GetScalarTypeAsString() << std::endl;
+    return EXIT_FAILURE;
+    }
+  for (int i = 0; i < 3; ++i)
+    {
+    closedForm->SetOperation(operationsFilter->GetNthOperation(i));
+    closedForm->SetScaleFactor(1000.);
+    closedForm->Update();
+    double difference = MaximumDifference(closedForm->GetOutput(), 0, output, i);
+    if (difference > 1e-5)
+      {
+      std::cerr << "Operation " << operationsFilter->GetNthOperation(i)
+                << " differs by " << difference << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  operationsFilter->RemoveAllOperations();
+  operationsFilter->SetOperationToColorByOrientation();
+  operationsFilter->Update();
+  if (operationsFilter->GetOutput()->GetNumberOfScalarComponents() != 4)
+    {
+    std::cerr << "Operation is ignored after RemoveAllOperations" << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+// Usage: vtkDiffusionTensorMathematicsTest2 [--benchmark]
+int vtkDiffusionTensorMathematicsTest2(int argc, char* argv[])
+{
+  bool benchmark = vtkAddonTestingUtilities::IsBenchmarkRequested(argc, argv);
+  vtkMath::RandomSeed(1);
+  if (TestEigenSolver() != EXIT_SUCCESS
+    || TestNearlyRepeatedEigenvalues() != EXIT_SUCCESS
+    || TestClosedFormEigenvalues(benchmark) != EXIT_SUCCESS
+    || TestFilter(benchmark) != EXIT_SUCCESS)
+    {
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,196 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// vtkAddon includes
+#include <vtkAddonTestingMacros.h>
+
+// vtkTeem includes
+#include <vtkNRRDReader.h>
+#include <vtkNRRDWriter.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+short GetValue(int i, int j, int k, int c)
+{
+  return static_cast<short>(i + 7 * j - 13 * k + 1000 * c);
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkImageData> CreateImage(int numberOfComponents)
+{
+  vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+  image->SetDimensions(128, 96, 40);
+  image->AllocateScalars(VTK_SHORT, numberOfComponents);
+  int* dims = image->GetDimensions();
+  short* ptr = static_cast<short*>(image->GetScalarPointer());
+  for (int k = 0; k < dims[2]; ++k)
+    {
+    for (int j = 0; j < dims[1]; ++j)
+      {
+      for (int i = 0; i < dims[0]; ++i)
+        {
+        for (int c = 0; c < numberOfComponents; ++c)
+          {
+          *ptr++ = GetValue(i, j, k, c);
+          }
+        }
+      }
+    }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+int CheckExtent(vtkNRRDReader* reader, const int extent[6], int numberOfComponents)
+{
+  reader->UpdateExtent(extent);
+  vtkImageData* output = reader->GetOutput();
+  int* outputExtent = output->GetExtent();
+  for (int i = 0; i < 6; ++i)
+    {
+    if (outputExtent[i] != extent[i])
+      {
+      std::cerr << "Unexpected output extent: " << outputExtent[0] << " " << outputExtent[1]
+                << " " << outputExtent[2] << " " << outputExtent[3]
+                << " " << outputExtent[4] << " " << outputExtent[5] << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  if (output->GetNumberOfScalarComponents() != numberOfComponents)
+    {
+    std::cerr << "Unexpected number of components: "
+              << output->GetNumberOfScalarComponents() << std::endl;
+    return EXIT_FAILURE;
+    }
+  for (int k = extent[4]; k <= extent[5]; ++k)
+    {
+    for (int j = extent[2]; j <= extent[3]; ++j)
+      {
+      for (int i = extent[0]; i <= extent[1]; ++i)
+        {
+        short* voxel = static_cast<short*>(output->GetScalarPointer(i, j, k));
+        for (int c = 0; c < numberOfComponents; ++c)
+          {
+          if (voxel[c] != GetValue(i, j, k, c))
+            {
+            std::cerr << "Unexpected value at (" << i << ", " << j << ", " << k << ", " << c
+                      << "): " << voxel[c] << " expected " << GetValue(i, j, k, c) << std::endl;
+            return EXIT_FAILURE;
+            }
+          }
+        }
+      }
+    }
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int TestFile(const std::string& fileName, int numberOfComponents, bool compressed, bool benchmark)
+{
+  vtkSmartPointer<vtkImageData> image = CreateImage(numberOfComponents);
+  vtkNew<vtkNRRDWriter> writer;
+  writer->SetInputData(image);
+  writer->SetFileName(fileName.c_str());
+  writer->SetUseCompression(compressed ? 1 : 0);
+  writer->Write();
+  if (writer->GetWriteError())
+    {
+    std::cerr << "Failed to write " << fileName << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtkNew<vtkNRRDReader> reader;
+  reader->SetFileName(fileName.c_str());
+  if (!reader->CanReadDataExtent())
+    {
+    std::cerr << fileName << " should be read by extent" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // single slice, sub-volume and whole volume
+  const int sliceExtent[6] = { 0, 127, 0, 95, 21, 21 };
+  const int subExtent[6] = { 3, 64, 10, 11, 5, 38 };
+  const int wholeExtent[6] = { 0, 127, 0, 95, 0, 39 };
+  if (CheckExtent(reader.GetPointer(), sliceExtent, numberOfComponents) != EXIT_SUCCESS
+    || CheckExtent(reader.GetPointer(), subExtent, numberOfComponents) != EXIT_SUCCESS
+    || CheckExtent(reader.GetPointer(), wholeExtent, numberOfComponents) != EXIT_SUCCESS)
+    {
+    std::cerr << "Failed to read " << fileName << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  if (!benchmark)
+    {
+    return EXIT_SUCCESS;
+    }
+
+  // Compare reading a slice with reading the whole volume
+  vtkNew<vtkTimerLog> timer;
+  const int numberOfRuns = 5;
+  const int* extents[2] = { sliceExtent, wholeExtent };
+  const char* names[2] = { "Slice", "Volume" };
+  for (int e = 0; e < 2; ++e)
+    {
+    timer->StartTimer();
+    for (int i = 0; i < numberOfRuns; ++i)
+      {
+      reader->Modified();
+      reader->UpdateExtent(extents[e]);
+      }
+    timer->StopTimer();
+    REPORT_MEASUREMENT("vtkNRRDReader-" << names[e] << (compressed ? "-gzip" : "-raw") << "-" << numberOfComponents,
+      timer->GetElapsedTime() / numberOfRuns);
+    }
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkNRRDReaderTest1(int argc, char * argv[])
+{
+  if (argc < 2)
+    {
+    std::cerr << "Usage: " << argv[0] << " /path/to/temp [--benchmark]" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::string tempDir = argv[1];
+  // The read times are only reported on request
+  bool benchmark = vtkAddonTestingUtilities::IsBenchmarkRequested(argc, argv, 2);
+
+  if (TestFile(tempDir + "/vtkNRRDReaderTest1_raw.nrrd", 1, false, benchmark) != EXIT_SUCCESS
+    || TestFile(tempDir + "/vtkNRRDReaderTest1_detached.nhdr", 1, false, benchmark) != EXIT_SUCCESS
+    || TestFile(tempDir + "/vtkNRRDReaderTest1_gzip.nrrd", 1, true, benchmark) != EXIT_SUCCESS
+    || TestFile(tempDir + "/vtkNRRDReaderTest1_vector.nrrd", 3, false, benchmark) != EXIT_SUCCESS
+    || TestFile(tempDir + "/vtkNRRDReaderTest1_vector_gzip.nhdr", 3, true, benchmark) != EXIT_SUCCESS)
+    {
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
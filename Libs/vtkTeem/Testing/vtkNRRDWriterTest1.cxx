@@ -0,0 +1,178 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// vtkAddon includes
+#include <vtkAddonTestingMacros.h>
+
+// vtkTeem includes
+#include <vtkNRRDReader.h>
+#include <vtkNRRDWriter.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// Teem includes
+#include <teem/nrrd.h>
+
+// STD includes
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Smooth gradient with some noise, compressible but not trivially
+vtkSmartPointer<vtkImageData> CreateImage()
+{
+  vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+  image->SetDimensions(128, 128, 64);
+  image->AllocateScalars(VTK_SHORT, 1);
+  short* ptr = static_cast<short*>(image->GetScalarPointer());
+  unsigned int seed = 1;
+  for (vtkIdType i = 0; i < image->GetNumberOfPoints(); ++i)
+    {
+    seed = seed * 1103515245 + 12345;
+    ptr[i] = static_cast<short>((i / 7) % 2000 + (seed >> 16) % 16);
+    }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+std::string ReadFile(const std::string& fileName)
+{
+  std::ifstream file(fileName.c_str(), std::ios::binary);
+  std::stringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+//----------------------------------------------------------------------------
+int Write(vtkImageData* image, const std::string& fileName,
+          int level, int numberOfThreads, int blockSize, bool benchmark = false)
+{
+  vtkNew<vtkNRRDWriter> writer;
+  writer->SetInputData(image);
+  writer->SetFileName(fileName.c_str());
+  writer->SetUseCompression(1);
+  writer->SetCompressionLevel(level);
+  writer->SetNumberOfThreads(numberOfThreads);
+  writer->SetCompressionBlockSize(blockSize);
+  writer->Write();
+  if (writer->GetWriteError())
+    {
+    std::cerr << "Failed to write " << fileName << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (benchmark)
+    {
+    REPORT_MEASUREMENT("vtkNRRDWriter-level" << level << "-threads" << numberOfThreads << "-MBps",
+      writer->GetWriteThroughput());
+    }
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+// The file is read by vtkNRRDReader and by teem
+int CheckFile(vtkImageData* image, const std::string& fileName)
+{
+  size_t size = image->GetNumberOfPoints() * sizeof(short);
+
+  vtkNew<vtkNRRDReader> reader;
+  reader->SetFileName(fileName.c_str());
+  reader->Update();
+  vtkImageData* output = reader->GetOutput();
+  if (output->GetNumberOfPoints() != image->GetNumberOfPoints()
+    || memcmp(output->GetScalarPointer(), image->GetScalarPointer(), size) != 0)
+    {
+    std::cerr << "vtkNRRDReader failed to read " << fileName << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  Nrrd* nrrd = nrrdNew();
+  bool loaded = !nrrdLoad(nrrd, fileName.c_str(), NULL);
+  bool same = loaded && nrrdElementNumber(nrrd) * nrrdElementSize(nrrd) == size
+    && memcmp(nrrd->data, image->GetScalarPointer(), size) == 0;
+  nrrdNuke(nrrd);
+  if (!same)
+    {
+    std::cerr << "teem failed to read " << fileName << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkNRRDWriterTest1(int argc, char * argv[])
+{
+  if (argc < 2)
+    {
+    std::cerr << "Usage: " << argv[0] << " /path/to/temp [--benchmark]" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::string tempDir = argv[1];
+  // The write throughputs are only reported on request
+  bool benchmark = vtkAddonTestingUtilities::IsBenchmarkRequested(argc, argv, 2);
+  vtkSmartPointer<vtkImageData> image = CreateImage();
+  // 2MB of data in 8 blocks
+  const int blockSize = 256 * 1024;
+
+  const int levels[3] = { 1, -1, 9 };
+  for (int l = 0; l < 3; ++l)
+    {
+    std::stringstream prefix;
+    prefix << tempDir << "/vtkNRRDWriterTest1_level" << levels[l];
+    std::string singleThreadFileName = prefix.str() + "_1.nrrd";
+    std::string multiThreadFileName = prefix.str() + "_4.nrrd";
+    if (Write(image, singleThreadFileName, levels[l], 1, blockSize, benchmark) != EXIT_SUCCESS
+      || Write(image, multiThreadFileName, levels[l], 4, blockSize, benchmark) != EXIT_SUCCESS
+      || CheckFile(image, multiThreadFileName) != EXIT_SUCCESS)
+      {
+      return EXIT_FAILURE;
+      }
+    // The blocks do not depend on the number of threads
+    if (ReadFile(singleThreadFileName) != ReadFile(multiThreadFileName))
+      {
+      std::cerr << "Level " << levels[l] << ": files written with 1 and 4 threads differ" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // A single member stream
+  std::string singleMemberFileName = tempDir + "/vtkNRRDWriterTest1_single.nrrd";
+  if (Write(image, singleMemberFileName, -1, 4, 16 * 1024 * 1024) != EXIT_SUCCESS
+    || CheckFile(image, singleMemberFileName) != EXIT_SUCCESS)
+    {
+    return EXIT_FAILURE;
+    }
+
+  // The data file of a detached header is compressed by teem
+  std::string detachedFileName = tempDir + "/vtkNRRDWriterTest1_detached.nhdr";
+  if (Write(image, detachedFileName, -1, 4, blockSize) != EXIT_SUCCESS
+    || CheckFile(image, detachedFileName) != EXIT_SUCCESS)
+    {
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -49,6 +49,7 @@ vtkDiffusionTensorGlyph::vtkDiffusionTensorGlyph()
 
   this->MaskGlyphs = 0;
   this->Mask = NULL;
+  this->UseClosedFormEigenSolver = 0;
 
   // Default to highest rendering resolution
   this->Resolution = 1;
@@ -439,8 +440,15 @@ int vtkDiffusionTensorGlyph::RequestData(
           }
 
         //vtkMath::Jacobi(m, w, v);
-        // Use superior eigensolve from teem.
-        vtkDiffusionTensorMathematics::TeemEigenSolver(m,w,v);
+        if ( this->UseClosedFormEigenSolver )
+          {
+          vtkDiffusionTensorMathematics::ClosedFormEigenSolver(m,w,v);
+          }
+        else
+          {
+          // Use superior eigensolve from teem.
+          vtkDiffusionTensorMathematics::TeemEigenSolver(m,w,v);
+          }
 
         //copy eigenvectors
         xv[0] = v[0][0]; xv[1] = v[1][0]; xv[2] = v[2][0];
@@ -761,6 +769,7 @@ void vtkDiffusionTensorGlyph::PrintSelf(ostream& os, vtkIndent indent)
 
   os << indent << "Color Glyphs by Scalar Invariant: " << this->ScalarInvariant << "\n";
   os << indent << "Mask Glyphs: " << (this->MaskGlyphs ? "On\n" : "Off\n");
+  os << indent << "Use Closed Form Eigen Solver: " << (this->UseClosedFormEigenSolver ? "On\n" : "Off\n");
   os << indent << "Resolution: " << this->Resolution << endl;
 
   // print objects
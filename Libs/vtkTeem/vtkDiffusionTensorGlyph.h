@@ -86,6 +86,15 @@ public:
   vtkSetMacro(MaskGlyphs, int);
   vtkGetMacro(MaskGlyphs, int);
 
+  ///
+  /// Extract eigenvalues with the closed-form solver of
+  /// vtkDiffusionTensorMathematics instead of the teem solver, which is
+  /// faster but less precise for nearly repeated eigenvalues.
+  /// Default is off.
+  vtkBooleanMacro(UseClosedFormEigenSolver, int);
+  vtkSetMacro(UseClosedFormEigenSolver, int);
+  vtkGetMacro(UseClosedFormEigenSolver, int);
+
   ///
   /// Input scalars are a binary mask: 0 prevents display
   /// of polydata at that point
@@ -177,6 +186,7 @@ protected:
 
   int ScalarInvariant;  /// which function of eigenvalues to use for coloring
   int MaskGlyphs;  /// mask glyphs outside of the brain for example, using the Mask
+  int UseClosedFormEigenSolver;
   int Resolution; /// allows skipping some tensors for lower resolution glyphing
 
   int DimensionResolution[2];
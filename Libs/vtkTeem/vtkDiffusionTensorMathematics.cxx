@@ -38,6 +38,17 @@ extern "C" {
 
 #include <ctime>
 #include <limits>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VTK_DIFFUSION_TENSOR_MATHEMATICS_USE_SSE2
+#endif
+// AVX is only used if the compiler targets it (e.g. -mavx or /arch:AVX)
+#if defined(__AVX__)
+#include <immintrin.h>
+#define VTK_DIFFUSION_TENSOR_MATHEMATICS_USE_AVX
+#endif
 
 #define VTK_EPS 1e-16
 #define DOUBLE_NAN (std::numeric_limits<double>::quiet_NaN())
@@ -61,6 +72,7 @@ vtkDiffusionTensorMathematics::vtkDiffusionTensorMathematics()
 
   this->ScaleFactor = 1.0;
   this->ExtractEigenvalues = 1;
+  this->UseClosedFormEigenSolver = 0;
   this->TensorRotationMatrix = NULL;
   this->ScalarMask = NULL;
   this->MaskWithScalars = 0;
@@ -107,7 +119,13 @@ int vtkDiffusionTensorMathematics::RequestInformation (
 
 
   // We always want to output float, unless it is color
-  if (this->Operation == VTK_TENS_COLOR_ORIENTATION)
+  if (!this->Operations.empty())
+    {
+    // one component per operation
+    vtkDataObject::SetPointDataActiveScalarInfo(outInfo, VTK_FLOAT,
+      static_cast<int>(this->Operations.size()));
+    }
+  else if (this->Operation == VTK_TENS_COLOR_ORIENTATION)
     {
     // output color (RGBA)
     vtkDataObject::SetPointDataActiveScalarInfo(outInfo, VTK_UNSIGNED_CHAR, 4);
@@ -126,6 +144,47 @@ int vtkDiffusionTensorMathematics::RequestInformation (
 
 
 
+//----------------------------------------------------------------------------
+void vtkDiffusionTensorMathematics::AddOperation(int op)
+{
+  if (op < VTK_TENS_TRACE || op > VTK_TENS_PERPENDICULAR_DIFFUSIVITY
+      || op == VTK_TENS_COLOR_ORIENTATION || op == VTK_TENS_COLOR_MODE)
+    {
+    vtkErrorMacro(<< "AddOperation: " << op << " is not a scalar operation");
+    return;
+    }
+  this->Operations.push_back(op);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkDiffusionTensorMathematics::RemoveAllOperations()
+{
+  if (this->Operations.empty())
+    {
+    return;
+    }
+  this->Operations.clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkDiffusionTensorMathematics::GetNumberOfOperations()
+{
+  return static_cast<int>(this->Operations.size());
+}
+
+//----------------------------------------------------------------------------
+int vtkDiffusionTensorMathematics::GetNthOperation(int n)
+{
+  if (n < 0 || n >= static_cast<int>(this->Operations.size()))
+    {
+    vtkErrorMacro(<< "GetNthOperation: " << n << " is out of range");
+    return -1;
+    }
+  return this->Operations[n];
+}
+
 //----------------------------------------------------------------------------
 int vtkDiffusionTensorMathematics::FillInputPortInformation(
   int port, vtkInformation* info)
@@ -193,6 +252,99 @@ static void GetContinuousIncrements(vtkImageData* img, int extent[6], vtkIdType
   incZ = inc[2] - (e3 - e2 + 1)*inc[1];
 }
 
+//----------------------------------------------------------------------------
+static bool vtkDiffusionTensorMathematicsNeedsEigenvalues(int op)
+{
+  return op != vtkDiffusionTensorMathematics::VTK_TENS_D11
+    && op != vtkDiffusionTensorMathematics::VTK_TENS_D22
+    && op != vtkDiffusionTensorMathematics::VTK_TENS_D33
+    && op != vtkDiffusionTensorMathematics::VTK_TENS_TRACE
+    && op != vtkDiffusionTensorMathematics::VTK_TENS_DETERMINANT;
+}
+
+//----------------------------------------------------------------------------
+static bool vtkDiffusionTensorMathematicsNeedsEigenvectors(int op)
+{
+  switch (op)
+    {
+    case vtkDiffusionTensorMathematics::VTK_TENS_COLOR_ORIENTATION:
+    case vtkDiffusionTensorMathematics::VTK_TENS_COLOR_ORIENTATION_MIDDLE_EIGENVECTOR:
+    case vtkDiffusionTensorMathematics::VTK_TENS_COLOR_ORIENTATION_MIN_EIGENVECTOR:
+    case vtkDiffusionTensorMathematics::VTK_TENS_MAX_EIGENVALUE_PROJX:
+    case vtkDiffusionTensorMathematics::VTK_TENS_MAX_EIGENVALUE_PROJY:
+    case vtkDiffusionTensorMathematics::VTK_TENS_MAX_EIGENVALUE_PROJZ:
+    case vtkDiffusionTensorMathematics::VTK_TENS_RAI_MAX_EIGENVEC_PROJX:
+    case vtkDiffusionTensorMathematics::VTK_TENS_RAI_MAX_EIGENVEC_PROJY:
+    case vtkDiffusionTensorMathematics::VTK_TENS_RAI_MAX_EIGENVEC_PROJZ:
+    case vtkDiffusionTensorMathematics::VTK_TENS_MAX_EIGENVEC_PROJX:
+    case vtkDiffusionTensorMathematics::VTK_TENS_MAX_EIGENVEC_PROJY:
+    case vtkDiffusionTensorMathematics::VTK_TENS_MAX_EIGENVEC_PROJZ:
+      return true;
+    default:
+      return false;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Buffers for the upper triangles and the eigenvalues of a row of tensors,
+// as expected by vtkDiffusionTensorMathematics::ClosedFormEigenvalues.
+class vtkDiffusionTensorMathematicsRow
+{
+public:
+  vtkDiffusionTensorMathematicsRow(int length)
+    : Length(length), Buffer(9 * static_cast<size_t>(length))
+    {
+    for (int i = 0; i < 9; ++i)
+      {
+      double* component = length > 0 ? &this->Buffer[i * static_cast<size_t>(length)] : NULL;
+      if (i < 6)
+        {
+        this->T[i] = component;
+        }
+      else
+        {
+        this->W[i - 6] = component;
+        }
+      }
+    }
+
+  /// Compute the eigenvalues of the Length tensors starting at inPtr
+  void ComputeEigenvalues(const float* inPtr)
+    {
+    // the transposed tensor, as passed to TeemEigenSolver
+    for (int i = 0; i < this->Length; ++i, inPtr += 9)
+      {
+      this->T[0][i] = inPtr[0];
+      this->T[1][i] = inPtr[3];
+      this->T[2][i] = inPtr[6];
+      this->T[3][i] = inPtr[4];
+      this->T[4][i] = inPtr[7];
+      this->T[5][i] = inPtr[8];
+      }
+    vtkDiffusionTensorMathematics::ClosedFormEigenvalues(this->Length, this->T, this->W);
+    }
+
+  /// Eigensystem of the tensor i. v may be NULL.
+  void GetEigensystem(int i, double w[3], double **v)
+    {
+    w[0] = this->W[0][i];
+    w[1] = this->W[1][i];
+    w[2] = this->W[2][i];
+    if (v)
+      {
+      const double t[6] = {this->T[0][i], this->T[1][i], this->T[2][i],
+                           this->T[3][i], this->T[4][i], this->T[5][i]};
+      vtkDiffusionTensorMathematics::ClosedFormEigenvectors(t, w, v);
+      }
+    }
+
+protected:
+  int Length;
+  std::vector<double> Buffer;
+  double* T[6];
+  double* W[3];
+};
+
 //----------------------------------------------------------------------------
 // This templated function executes the filter for any type of data.
 // Handles the one input operations.
@@ -451,6 +603,9 @@ static void vtkDiffusionTensorMathematicsExecute1Eigen(vtkDiffusionTensorMathema
 
   // decide whether to extract eigenfunctions or just use input cols
   extractEigenvalues = self->GetExtractEigenvalues();
+  const bool useClosedForm = extractEigenvalues && self->GetUseClosedFormEigenSolver();
+  const bool needsEigenvectors = vtkDiffusionTensorMathematicsNeedsEigenvectors(op);
+  vtkDiffusionTensorMathematicsRow row(useClosedForm ? rowLength : 0);
 
   // transformation of tensor orientations for coloring
   vtkTransform *trans = vtkTransform::New();
@@ -494,6 +649,11 @@ static void vtkDiffusionTensorMathematicsExecute1Eigen(vtkDiffusionTensorMathema
         count++;
         }
 
+      if (useClosedForm)
+        {
+        row.ComputeEigenvalues(inPtr);
+        }
+
       for (idxR = 0; idxR < rowLength; idxR++)
         {
         if (doMasking && *inMaskPtr != self->GetMaskLabelValue())
@@ -524,7 +684,11 @@ static void vtkDiffusionTensorMathematicsExecute1Eigen(vtkDiffusionTensorMathema
           tensor[2][2] = static_cast<double>(inPtr[8]);
 
           // get eigenvalues and eigenvectors appropriately
-          if (extractEigenvalues)
+          if (useClosedForm)
+            {
+            row.GetEigensystem(idxR, w, needsEigenvectors ? v : NULL);
+            }
+          else if (extractEigenvalues)
             {
             for (j=0; j<3; j++)
               {
@@ -798,6 +962,248 @@ static void vtkDiffusionTensorMathematicsExecute1Eigen(vtkDiffusionTensorMathema
 #endif
 }
 
+//----------------------------------------------------------------------------
+// Value of the scalar operation op for a tensor and its eigensystem.
+static double vtkDiffusionTensorMathematicsScalar(int op, double tensor[3][3],
+                                                  double w[3], double **v)
+{
+  switch (op)
+    {
+    case vtkDiffusionTensorMathematics::VTK_TENS_D11:
+      return tensor[0][0];
+    case vtkDiffusionTensorMathematics::VTK_TENS_D22:
+      return tensor[1][1];
+    case vtkDiffusionTensorMathematics::VTK_TENS_D33:
+      return tensor[2][2];
+    case vtkDiffusionTensorMathematics::VTK_TENS_TRACE:
+      return vtkDiffusionTensorMathematics::Trace(tensor);
+    case vtkDiffusionTensorMathematics::VTK_TENS_DETERMINANT:
+      return vtkDiffusionTensorMathematics::Determinant(tensor);
+    case vtkDiffusionTensorMathematics::VTK_TENS_RELATIVE_ANISOTROPY:
+      return vtkDiffusionTensorMathematics::RelativeAnisotropy(w);
+    case vtkDiffusionTensorMathematics::VTK_TENS_FRACTIONAL_ANISOTROPY:
+      return vtkDiffusionTensorMathematics::FractionalAnisotropy(w);
+    case vtkDiffusionTensorMathematics::VTK_TENS_LINEAR_MEASURE:
+      return vtkDiffusionTensorMathematics::LinearMeasure(w);
+    case vtkDiffusionTensorMathematics::VTK_TENS_PLANAR_MEASURE:
+      return vtkDiffusionTensorMathematics::PlanarMeasure(w);
+    case vtkDiffusionTensorMathematics::VTK_TENS_SPHERICAL_MEASURE:
+      return vtkDiffusionTensorMathematics::SphericalMeasure(w);
+    case vtkDiffusionTensorMathematics::VTK_TENS_MAX_EIGENVALUE:
+      return w[0];
+    case vtkDiffusionTensorMathematics::VTK_TENS_MID_EIGENVALUE:
+      return w[1];
+    case vtkDiffusionTensorMathematics::VTK_TENS_MIN_EIGENVALUE:
+      return w[2];
+    case vtkDiffusionTensorMathematics::VTK_TENS_PARALLEL_DIFFUSIVITY:
+      return vtkDiffusionTensorMathematics::ParallelDiffusivity(w);
+    case vtkDiffusionTensorMathematics::VTK_TENS_PERPENDICULAR_DIFFUSIVITY:
+      return vtkDiffusionTensorMathematics::PerpendicularDiffusivity(w);
+    case vtkDiffusionTensorMathematics::VTK_TENS_MAX_EIGENVALUE_PROJX:
+      return vtkDiffusionTensorMathematics::MaxEigenvalueProjectionX(v,w);
+    case vtkDiffusionTensorMathematics::VTK_TENS_MAX_EIGENVALUE_PROJY:
+      return vtkDiffusionTensorMathematics::MaxEigenvalueProjectionY(v,w);
+    case vtkDiffusionTensorMathematics::VTK_TENS_MAX_EIGENVALUE_PROJZ:
+      return vtkDiffusionTensorMathematics::MaxEigenvalueProjectionZ(v,w);
+    case vtkDiffusionTensorMathematics::VTK_TENS_RAI_MAX_EIGENVEC_PROJX:
+      return vtkDiffusionTensorMathematics::RAIMaxEigenvecX(v,w);
+    case vtkDiffusionTensorMathematics::VTK_TENS_RAI_MAX_EIGENVEC_PROJY:
+      return vtkDiffusionTensorMathematics::RAIMaxEigenvecY(v,w);
+    case vtkDiffusionTensorMathematics::VTK_TENS_RAI_MAX_EIGENVEC_PROJZ:
+      return vtkDiffusionTensorMathematics::RAIMaxEigenvecZ(v,w);
+    case vtkDiffusionTensorMathematics::VTK_TENS_MAX_EIGENVEC_PROJX:
+      return vtkDiffusionTensorMathematics::MaxEigenvecX(v,w);
+    case vtkDiffusionTensorMathematics::VTK_TENS_MAX_EIGENVEC_PROJY:
+      return vtkDiffusionTensorMathematics::MaxEigenvecY(v,w);
+    case vtkDiffusionTensorMathematics::VTK_TENS_MAX_EIGENVEC_PROJZ:
+      return vtkDiffusionTensorMathematics::MaxEigenvecZ(v,w);
+    case vtkDiffusionTensorMathematics::VTK_TENS_MODE:
+      return vtkDiffusionTensorMathematics::Mode(w);
+    default:
+      return 0.;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Computes all the operations added with AddOperation in one pass, the
+// output has one float component per operation.
+static void vtkDiffusionTensorMathematicsExecuteOperations(vtkDiffusionTensorMathematics *self,
+                                                          vtkImageData *in1Data,
+                                                          vtkImageData *outData,
+                                                          float *outPtr,
+                                                          int outExt[6], int id)
+{
+  vtkDataArray* inTensors = in1Data->GetPointData()->GetTensors();
+  if ( !inTensors || in1Data->GetNumberOfPoints() < 1 )
+    {
+    vtkGenericWarningMacro(<<"No input tensor data to filter!");
+    return;
+    }
+  if (self->GetScalarMask() && self->GetScalarMask()->GetScalarType() != VTK_SHORT)
+    {
+    vtkGenericWarningMacro(<<"scalr type for mask must be short!");
+    return;
+    }
+
+  const int numberOfOperations = self->GetNumberOfOperations();
+  std::vector<int> ops(numberOfOperations);
+  bool needsEigenvalues = false;
+  bool needsEigenvectors = false;
+  for (int i = 0; i < numberOfOperations; ++i)
+    {
+    ops[i] = self->GetNthOperation(i);
+    needsEigenvalues |= vtkDiffusionTensorMathematicsNeedsEigenvalues(ops[i]);
+    needsEigenvectors |= vtkDiffusionTensorMathematicsNeedsEigenvectors(ops[i]);
+    }
+  const double scaleFactor = self->GetScaleFactor();
+  const int extractEigenvalues = self->GetExtractEigenvalues();
+  const bool useClosedForm = needsEigenvalues && extractEigenvalues
+    && self->GetUseClosedFormEigenSolver();
+  vtkDiffusionTensorMathematicsRow row(useClosedForm ? outExt[1] - outExt[0] + 1 : 0);
+
+  // progress
+  const int rowLength = outExt[1] - outExt[0] + 1;
+  const int maxY = outExt[3] - outExt[2];
+  const int maxZ = outExt[5] - outExt[4];
+  unsigned long count = 0;
+  unsigned long target = (unsigned long)((maxZ+1)*(maxY+1)/50.0);
+  target++;
+
+  vtkIdType outIncX, outIncY, outIncZ;
+  vtkIdType inIncX, inIncY, inIncZ;
+  outData->GetContinuousIncrements(outExt, outIncX, outIncY, outIncZ);
+  GetContinuousIncrements(in1Data, outExt, inIncX, inIncY, inIncZ);
+  float* inPtr = reinterpret_cast<float*>(in1Data->GetArrayPointerForExtent(inTensors, outExt));
+
+  bool doMasking = false;
+  short * inMaskPtr = 0;
+  vtkIdType maskIncX = 0;
+  vtkIdType maskIncY = 0;
+  vtkIdType maskIncZ = 0;
+  if (self->GetMaskWithScalars() && self->GetScalarMask())
+    {
+    self->GetScalarMask()->GetContinuousIncrements(outExt, maskIncX, maskIncY, maskIncZ);
+    inMaskPtr = reinterpret_cast<short *>(self->GetScalarMask()->GetScalarPointerForExtent(outExt));
+    doMasking = self->GetScalarMask()->GetPointData()->GetScalars() != 0;
+    }
+
+  double tensor[3][3];
+  double *m[3], w[3] = {0., 0., 0.}, *v[3];
+  double m0[3], m1[3], m2[3];
+  double v0[3], v1[3], v2[3];
+  m[0] = m0; m[1] = m1; m[2] = m2;
+  v[0] = v0; v[1] = v1; v[2] = v2;
+
+  for (int idxZ = 0; idxZ <= maxZ; idxZ++)
+    {
+    for (int idxY = 0; idxY <= maxY; idxY++)
+      {
+      if (!id)
+        {
+        if (!(count%target))
+          {
+          self->UpdateProgress(count/(50.0*target));
+          }
+        count++;
+        }
+
+      if (useClosedForm)
+        {
+        row.ComputeEigenvalues(inPtr);
+        }
+
+      for (int idxR = 0; idxR < rowLength; idxR++)
+        {
+        if (doMasking && *inMaskPtr != self->GetMaskLabelValue())
+          {
+          for (int i = 0; i < numberOfOperations; ++i)
+            {
+            outPtr[i] = 0.f;
+            }
+          }
+        else
+          {
+          for (int i = 0; i < 3; i++)
+            {
+            for (int j = 0; j < 3; j++)
+              {
+              tensor[i][j] = static_cast<double>(inPtr[3*i + j]);
+              }
+            }
+
+          if (useClosedForm)
+            {
+            row.GetEigensystem(idxR, w, needsEigenvectors ? v : NULL);
+            }
+          else if (needsEigenvalues && extractEigenvalues)
+            {
+            for (int j = 0; j < 3; j++)
+              {
+              for (int i = 0; i < 3; i++)
+                {
+                m[i][j] = tensor[j][i];
+                }
+              }
+            vtkDiffusionTensorMathematics::TeemEigenSolver(m,w,v);
+            }
+          else if (needsEigenvalues)
+            {
+            // tensor columns are evectors scaled by evals
+            for (int i = 0; i < 3; i++)
+              {
+              v0[i] = tensor[i][0];
+              v1[i] = tensor[i][1];
+              v2[i] = tensor[i][2];
+              }
+            w[0] = vtkMath::Normalize(v0);
+            w[1] = vtkMath::Normalize(v1);
+            w[2] = vtkMath::Normalize(v2);
+            }
+
+          // Same correction of negative eigenvalues as for a single operation
+          if (self->GetFixNegativeEigenvalues()==1)
+            {
+            const double min_eval = MIN3(w[0], w[1], w[2]);
+            if (min_eval < 0)
+              {
+              const double add_to_eval = -min_eval + VTK_EPS;
+              w[0] += add_to_eval;
+              w[1] += add_to_eval;
+              w[2] += add_to_eval;
+              }
+            }
+          else
+            {
+            for (int i = 0; i < 3; i++)
+              {
+              if (w[i] < 0)
+                {
+                w[i] = DOUBLE_NAN;
+                }
+              }
+            }
+
+          for (int i = 0; i < numberOfOperations; ++i)
+            {
+            outPtr[i] = static_cast<float>(
+              scaleFactor * vtkDiffusionTensorMathematicsScalar(ops[i], tensor, w, v));
+            }
+          }
+
+        outPtr += numberOfOperations;
+        inPtr+=9;
+        inMaskPtr++;
+        }
+      outPtr += outIncY;
+      inPtr += inIncY;
+      inMaskPtr += maskIncY;
+      }
+    outPtr += outIncZ;
+    inPtr += inIncZ;
+    inMaskPtr += maskIncZ;
+    }
+}
+
 //----------------------------------------------------------------------------
 // This method computes the increments from the MemoryOrder and the extent.
 void vtkDiffusionTensorMathematics::ComputeTensorIncrements(vtkImageData *imageData, vtkIdType incr[3])
@@ -850,6 +1256,18 @@ void vtkDiffusionTensorMathematics::ThreadedRequestData(
   // single input only for now
   vtkDebugMacro ("In Threaded Execute. scalar type is " << inData[0][0]->GetScalarType() << "op is: " << this->Operation);
 
+  if (!this->Operations.empty())
+    {
+    if (outData[0]->GetScalarType() != VTK_FLOAT)
+      {
+      vtkErrorMacro(<< "Execute: output must be float to compute several operations");
+      return;
+      }
+    vtkDiffusionTensorMathematicsExecuteOperations(this, inData[0][0], outData[0],
+                                                   static_cast<float*>(outPtr), outExt, id);
+    return;
+    }
+
   switch (this->GetOperation())
     {
 
@@ -1149,6 +1567,14 @@ void vtkDiffusionTensorMathematics::PrintSelf(ostream& os, vtkIndent indent)
   this->Superclass::PrintSelf(os,indent);
 
   os << indent << "Operation: " << this->Operation << "\n";
+  os << indent << "Operations:";
+  for (size_t i = 0; i < this->Operations.size(); ++i)
+    {
+    os << " " << this->Operations[i];
+    }
+  os << "\n";
+  os << indent << "ExtractEigenvalues: " << this->ExtractEigenvalues << "\n";
+  os << indent << "UseClosedFormEigenSolver: " << this->UseClosedFormEigenSolver << "\n";
 }
 
 // Colormap: convert our mode value (-1..1) to RGB
@@ -1354,3 +1780,430 @@ int vtkDiffusionTensorMathematics::TeemEigenSolver(double **m, double *w, double
     return res;
 
 }
+
+//----------------------------------------------------------------------------
+namespace
+{
+
+//----------------------------------------------------------------------------
+// asin(z) = z + z^3 P(z^2) for |z| <= 1/2: Chebyshev interpolant of degree
+// 12 of P, accurate to 1 ulp.
+const double AsinCoefficients[13] = {
+  0.16666666666666669, 0.074999999999984371, 0.044642857146345152,
+  0.030381944139381202, 0.0223721729069488, 0.017352393570352394,
+  0.013971200096071138, 0.011479304935374576, 0.010321977335619383,
+  0.0054611167512260955, 0.017391046079305503, -0.014836549758911133,
+  0.028747411874624398};
+
+// Taylor polynomials of sin(x)/x and cos(x) in x^2, accurate to 1e-16 for
+// |x| <= pi/6.
+const double SinCoefficients[7] = {
+  1., -1./6., 1./120., -1./5040., 1./362880., -1./39916800., 1./6227020800.};
+const double CosCoefficients[8] = {
+  1., -1./2., 1./24., -1./720., 1./40320., -1./3628800., 1./479001600., -1./87178291200.};
+
+const double HalfPi = 1.5707963267948966192;
+const double Sqrt3 = 1.7320508075688772935;
+
+//----------------------------------------------------------------------------
+// asin(x) for |x| <= 1, using asin(x) = pi/2 - 2 asin(sqrt((1 - x)/2)) for
+// x > 1/2. Unlike the libm functions, the polynomial approximations have no
+// data dependent branches, so that several tensors are processed at once.
+inline double vtkDiffusionTensorMathematicsAsin(double x)
+{
+  const double a = fabs(x);
+  const bool large = a > 0.5;
+  const double u = large ? (1. - a) * 0.5 : a * a;
+  const double z = large ? sqrt(u) : a;
+  double p = AsinCoefficients[12];
+  for (int k = 11; k >= 0; --k)
+    {
+    p = p * u + AsinCoefficients[k];
+    }
+  const double asinZ = z + z * u * p;
+  const double asinA = large ? HalfPi - (asinZ + asinZ) : asinZ;
+  return x < 0. ? -asinA : asinA;
+}
+
+//----------------------------------------------------------------------------
+// sin(x) and cos(x) for |x| <= pi/6
+inline void vtkDiffusionTensorMathematicsSinCos(double x, double& s, double& c)
+{
+  const double x2 = x * x;
+  double ps = SinCoefficients[6];
+  for (int k = 5; k >= 0; --k)
+    {
+    ps = ps * x2 + SinCoefficients[k];
+    }
+  double pc = CosCoefficients[7];
+  for (int k = 6; k >= 0; --k)
+    {
+    pc = pc * x2 + CosCoefficients[k];
+    }
+  s = x * ps;
+  c = pc;
+}
+
+//----------------------------------------------------------------------------
+// Trigonometric solution of the characteristic polynomial: with
+// B = (A - mI) / p, where m = trace(A)/3 and p = sqrt(trace((A - mI)^2)/6),
+// the eigenvalues of A are m + 2 p cos(phi + 2 k pi/3), phi = acos(det(B)/2)/3.
+// With theta = pi/6 - phi = asin(det(B)/2)/3 in [-pi/6, pi/6], they are
+// m + p (sqrt(3) cos(theta) + sin(theta)), m - 2 p sin(theta) and
+// m - p (sqrt(3) cos(theta) - sin(theta)).
+inline void vtkDiffusionTensorMathematicsEigenvalues(
+  double t00, double t01, double t02, double t11, double t12, double t22,
+  double& w0, double& w1, double& w2)
+{
+  const double m = (t00 + t11 + t22) / 3.;
+  const double a = t00 - m;
+  const double d = t11 - m;
+  const double f = t22 - m;
+  const double offDiagonal = t01*t01 + t02*t02 + t12*t12;
+  const double p2 = (a*a + d*d + f*f + 2.*offDiagonal) / 6.;
+  const double halfDet = (a*(d*f - t12*t12) - t01*(t01*f - t12*t02) + t02*(t01*t12 - d*t02)) / 2.;
+  const double p = sqrt(p2);
+  // p is 0 for multiples of the identity, theta is then irrelevant
+  double r = p2 > 0. ? halfDet / (p2 * p) : 0.;
+  r = r < -1. ? -1. : (r > 1. ? 1. : r);
+  double s, c;
+  vtkDiffusionTensorMathematicsSinCos(vtkDiffusionTensorMathematicsAsin(r) / 3., s, c);
+  const double sqrt3C = Sqrt3 * c;
+  w0 = m + p * (sqrt3C + s);
+  w2 = m - p * (sqrt3C - s);
+  // keep the order when rounding breaks it for repeated eigenvalues
+  const double middle = m - 2. * p * s;
+  w1 = middle > w0 ? w0 : (middle < w2 ? w2 : middle);
+}
+
+#ifdef VTK_DIFFUSION_TENSOR_MATHEMATICS_USE_SSE2
+//----------------------------------------------------------------------------
+// SSE2 versions of the above functions, for 2 tensors at a time
+inline __m128d Select(__m128d mask, __m128d a, __m128d b)
+{
+  return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+//----------------------------------------------------------------------------
+inline __m128d vtkDiffusionTensorMathematicsAsin(__m128d x)
+{
+  const __m128d signMask = _mm_set1_pd(-0.);
+  const __m128d half = _mm_set1_pd(0.5);
+  const __m128d a = _mm_andnot_pd(signMask, x);
+  const __m128d large = _mm_cmpgt_pd(a, half);
+  const __m128d u = Select(large, _mm_mul_pd(_mm_sub_pd(_mm_set1_pd(1.), a), half), _mm_mul_pd(a, a));
+  const __m128d z = Select(large, _mm_sqrt_pd(u), a);
+  __m128d p = _mm_set1_pd(AsinCoefficients[12]);
+  for (int k = 11; k >= 0; --k)
+    {
+    p = _mm_add_pd(_mm_mul_pd(p, u), _mm_set1_pd(AsinCoefficients[k]));
+    }
+  const __m128d asinZ = _mm_add_pd(z, _mm_mul_pd(_mm_mul_pd(z, u), p));
+  const __m128d asinA = Select(large, _mm_sub_pd(_mm_set1_pd(HalfPi), _mm_add_pd(asinZ, asinZ)), asinZ);
+  return _mm_or_pd(asinA, _mm_and_pd(signMask, x));
+}
+
+//----------------------------------------------------------------------------
+inline void vtkDiffusionTensorMathematicsSinCos(__m128d x, __m128d& s, __m128d& c)
+{
+  const __m128d x2 = _mm_mul_pd(x, x);
+  __m128d ps = _mm_set1_pd(SinCoefficients[6]);
+  for (int k = 5; k >= 0; --k)
+    {
+    ps = _mm_add_pd(_mm_mul_pd(ps, x2), _mm_set1_pd(SinCoefficients[k]));
+    }
+  __m128d pc = _mm_set1_pd(CosCoefficients[7]);
+  for (int k = 6; k >= 0; --k)
+    {
+    pc = _mm_add_pd(_mm_mul_pd(pc, x2), _mm_set1_pd(CosCoefficients[k]));
+    }
+  s = _mm_mul_pd(x, ps);
+  c = pc;
+}
+
+//----------------------------------------------------------------------------
+inline void vtkDiffusionTensorMathematicsEigenvalues(
+  __m128d t00, __m128d t01, __m128d t02, __m128d t11, __m128d t12, __m128d t22,
+  __m128d& w0, __m128d& w1, __m128d& w2)
+{
+  const __m128d m = _mm_div_pd(_mm_add_pd(_mm_add_pd(t00, t11), t22), _mm_set1_pd(3.));
+  const __m128d a = _mm_sub_pd(t00, m);
+  const __m128d d = _mm_sub_pd(t11, m);
+  const __m128d f = _mm_sub_pd(t22, m);
+  const __m128d offDiagonal = _mm_add_pd(_mm_add_pd(_mm_mul_pd(t01, t01), _mm_mul_pd(t02, t02)),
+                                         _mm_mul_pd(t12, t12));
+  const __m128d p2 = _mm_div_pd(
+    _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(a, a), _mm_mul_pd(d, d)), _mm_mul_pd(f, f)),
+               _mm_add_pd(offDiagonal, offDiagonal)),
+    _mm_set1_pd(6.));
+  const __m128d det = _mm_add_pd(
+    _mm_sub_pd(_mm_mul_pd(a, _mm_sub_pd(_mm_mul_pd(d, f), _mm_mul_pd(t12, t12))),
+               _mm_mul_pd(t01, _mm_sub_pd(_mm_mul_pd(t01, f), _mm_mul_pd(t12, t02)))),
+    _mm_mul_pd(t02, _mm_sub_pd(_mm_mul_pd(t01, t12), _mm_mul_pd(d, t02))));
+  const __m128d halfDet = _mm_div_pd(det, _mm_set1_pd(2.));
+  const __m128d p = _mm_sqrt_pd(p2);
+  // the lanes of the multiples of the identity are masked out
+  __m128d r = _mm_and_pd(_mm_cmpgt_pd(p2, _mm_setzero_pd()), _mm_div_pd(halfDet, _mm_mul_pd(p2, p)));
+  r = _mm_min_pd(_mm_max_pd(r, _mm_set1_pd(-1.)), _mm_set1_pd(1.));
+  __m128d s, c;
+  vtkDiffusionTensorMathematicsSinCos(
+    _mm_div_pd(vtkDiffusionTensorMathematicsAsin(r), _mm_set1_pd(3.)), s, c);
+  const __m128d sqrt3C = _mm_mul_pd(_mm_set1_pd(Sqrt3), c);
+  w0 = _mm_add_pd(m, _mm_mul_pd(p, _mm_add_pd(sqrt3C, s)));
+  w2 = _mm_sub_pd(m, _mm_mul_pd(p, _mm_sub_pd(sqrt3C, s)));
+  const __m128d middle = _mm_sub_pd(m, _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(2.), p), s));
+  w1 = _mm_min_pd(_mm_max_pd(middle, w2), w0);
+}
+#endif
+
+#ifdef VTK_DIFFUSION_TENSOR_MATHEMATICS_USE_AVX
+//----------------------------------------------------------------------------
+// AVX versions of the above functions, for 4 tensors at a time
+inline __m256d Select(__m256d mask, __m256d a, __m256d b)
+{
+  return _mm256_blendv_pd(b, a, mask);
+}
+
+//----------------------------------------------------------------------------
+inline __m256d vtkDiffusionTensorMathematicsAsin(__m256d x)
+{
+  const __m256d signMask = _mm256_set1_pd(-0.);
+  const __m256d half = _mm256_set1_pd(0.5);
+  const __m256d a = _mm256_andnot_pd(signMask, x);
+  const __m256d large = _mm256_cmp_pd(a, half, _CMP_GT_OQ);
+  const __m256d u = Select(large, _mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(1.), a), half), _mm256_mul_pd(a, a));
+  const __m256d z = Select(large, _mm256_sqrt_pd(u), a);
+  __m256d p = _mm256_set1_pd(AsinCoefficients[12]);
+  for (int k = 11; k >= 0; --k)
+    {
+    p = _mm256_add_pd(_mm256_mul_pd(p, u), _mm256_set1_pd(AsinCoefficients[k]));
+    }
+  const __m256d asinZ = _mm256_add_pd(z, _mm256_mul_pd(_mm256_mul_pd(z, u), p));
+  const __m256d asinA = Select(large, _mm256_sub_pd(_mm256_set1_pd(HalfPi), _mm256_add_pd(asinZ, asinZ)), asinZ);
+  return _mm256_or_pd(asinA, _mm256_and_pd(signMask, x));
+}
+
+//----------------------------------------------------------------------------
+inline void vtkDiffusionTensorMathematicsSinCos(__m256d x, __m256d& s, __m256d& c)
+{
+  const __m256d x2 = _mm256_mul_pd(x, x);
+  __m256d ps = _mm256_set1_pd(SinCoefficients[6]);
+  for (int k = 5; k >= 0; --k)
+    {
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, x2), _mm256_set1_pd(SinCoefficients[k]));
+    }
+  __m256d pc = _mm256_set1_pd(CosCoefficients[7]);
+  for (int k = 6; k >= 0; --k)
+    {
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, x2), _mm256_set1_pd(CosCoefficients[k]));
+    }
+  s = _mm256_mul_pd(x, ps);
+  c = pc;
+}
+
+//----------------------------------------------------------------------------
+inline void vtkDiffusionTensorMathematicsEigenvalues(
+  __m256d t00, __m256d t01, __m256d t02, __m256d t11, __m256d t12, __m256d t22,
+  __m256d& w0, __m256d& w1, __m256d& w2)
+{
+  const __m256d m = _mm256_div_pd(_mm256_add_pd(_mm256_add_pd(t00, t11), t22), _mm256_set1_pd(3.));
+  const __m256d a = _mm256_sub_pd(t00, m);
+  const __m256d d = _mm256_sub_pd(t11, m);
+  const __m256d f = _mm256_sub_pd(t22, m);
+  const __m256d offDiagonal = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(t01, t01), _mm256_mul_pd(t02, t02)),
+                                            _mm256_mul_pd(t12, t12));
+  const __m256d p2 = _mm256_div_pd(
+    _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(d, d)), _mm256_mul_pd(f, f)),
+                  _mm256_add_pd(offDiagonal, offDiagonal)),
+    _mm256_set1_pd(6.));
+  const __m256d det = _mm256_add_pd(
+    _mm256_sub_pd(_mm256_mul_pd(a, _mm256_sub_pd(_mm256_mul_pd(d, f), _mm256_mul_pd(t12, t12))),
+                  _mm256_mul_pd(t01, _mm256_sub_pd(_mm256_mul_pd(t01, f), _mm256_mul_pd(t12, t02)))),
+    _mm256_mul_pd(t02, _mm256_sub_pd(_mm256_mul_pd(t01, t12), _mm256_mul_pd(d, t02))));
+  const __m256d halfDet = _mm256_div_pd(det, _mm256_set1_pd(2.));
+  const __m256d p = _mm256_sqrt_pd(p2);
+  // the lanes of the multiples of the identity are masked out
+  __m256d r = _mm256_and_pd(_mm256_cmp_pd(p2, _mm256_setzero_pd(), _CMP_GT_OQ),
+                            _mm256_div_pd(halfDet, _mm256_mul_pd(p2, p)));
+  r = _mm256_min_pd(_mm256_max_pd(r, _mm256_set1_pd(-1.)), _mm256_set1_pd(1.));
+  __m256d s, c;
+  vtkDiffusionTensorMathematicsSinCos(
+    _mm256_div_pd(vtkDiffusionTensorMathematicsAsin(r), _mm256_set1_pd(3.)), s, c);
+  const __m256d sqrt3C = _mm256_mul_pd(_mm256_set1_pd(Sqrt3), c);
+  w0 = _mm256_add_pd(m, _mm256_mul_pd(p, _mm256_add_pd(sqrt3C, s)));
+  w2 = _mm256_sub_pd(m, _mm256_mul_pd(p, _mm256_sub_pd(sqrt3C, s)));
+  const __m256d middle = _mm256_sub_pd(m, _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(2.), p), s));
+  w1 = _mm256_min_pd(_mm256_max_pd(middle, w2), w0);
+}
+#endif
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+void vtkDiffusionTensorMathematics::ClosedFormEigenvalues(int n, double* const t[6], double* const w[3])
+{
+  const double* t00 = t[0];
+  const double* t01 = t[1];
+  const double* t02 = t[2];
+  const double* t11 = t[3];
+  const double* t12 = t[4];
+  const double* t22 = t[5];
+  double* w0 = w[0];
+  double* w1 = w[1];
+  double* w2 = w[2];
+  int i = 0;
+#ifdef VTK_DIFFUSION_TENSOR_MATHEMATICS_USE_AVX
+  for (; i + 4 <= n; i += 4)
+    {
+    __m256d eigenvalue0, eigenvalue1, eigenvalue2;
+    vtkDiffusionTensorMathematicsEigenvalues(
+      _mm256_loadu_pd(t00 + i), _mm256_loadu_pd(t01 + i), _mm256_loadu_pd(t02 + i),
+      _mm256_loadu_pd(t11 + i), _mm256_loadu_pd(t12 + i), _mm256_loadu_pd(t22 + i),
+      eigenvalue0, eigenvalue1, eigenvalue2);
+    _mm256_storeu_pd(w0 + i, eigenvalue0);
+    _mm256_storeu_pd(w1 + i, eigenvalue1);
+    _mm256_storeu_pd(w2 + i, eigenvalue2);
+    }
+#endif
+#ifdef VTK_DIFFUSION_TENSOR_MATHEMATICS_USE_SSE2
+  for (; i + 2 <= n; i += 2)
+    {
+    __m128d eigenvalue0, eigenvalue1, eigenvalue2;
+    vtkDiffusionTensorMathematicsEigenvalues(
+      _mm_loadu_pd(t00 + i), _mm_loadu_pd(t01 + i), _mm_loadu_pd(t02 + i),
+      _mm_loadu_pd(t11 + i), _mm_loadu_pd(t12 + i), _mm_loadu_pd(t22 + i),
+      eigenvalue0, eigenvalue1, eigenvalue2);
+    _mm_storeu_pd(w0 + i, eigenvalue0);
+    _mm_storeu_pd(w1 + i, eigenvalue1);
+    _mm_storeu_pd(w2 + i, eigenvalue2);
+    }
+#endif
+  for (; i < n; ++i)
+    {
+    vtkDiffusionTensorMathematicsEigenvalues(t00[i], t01[i], t02[i], t11[i], t12[i], t22[i],
+                                             w0[i], w1[i], w2[i]);
+    }
+}
+
+//----------------------------------------------------------------------------
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Unit vector orthogonal to the null space of the rank 2 matrix t - lambda I,
+// i.e. the largest cross product of two of its rows. Return the squared norm
+// of the cross product, that measures how well v is defined, or 0 if the
+// matrix has rank < 2: the eigenvalue is repeated.
+double vtkDiffusionTensorMathematicsEigenvector(const double t[6], double lambda,
+                                              double scale, double v[3])
+{
+  const double r0[3] = {t[0] - lambda, t[1], t[2]};
+  const double r1[3] = {t[1], t[3] - lambda, t[4]};
+  const double r2[3] = {t[2], t[4], t[5] - lambda};
+  double c[3][3];
+  vtkMath::Cross(r0, r1, c[0]);
+  vtkMath::Cross(r0, r2, c[1]);
+  vtkMath::Cross(r1, r2, c[2]);
+  int best = 0;
+  double bestNorm2 = vtkMath::Dot(c[0], c[0]);
+  for (int i = 1; i < 3; ++i)
+    {
+    const double norm2 = vtkMath::Dot(c[i], c[i]);
+    if (norm2 > bestNorm2)
+      {
+      best = i;
+      bestNorm2 = norm2;
+      }
+    }
+  // The cross products are of the order of the product of the gaps between
+  // lambda and the other two eigenvalues.
+  const double scale2 = scale * scale;
+  if (bestNorm2 <= 1e-20 * scale2 * scale2)
+    {
+    return 0.;
+    }
+  const double norm = sqrt(bestNorm2);
+  v[0] = c[best][0] / norm;
+  v[1] = c[best][1] / norm;
+  v[2] = c[best][2] / norm;
+  return bestNorm2;
+}
+
+//----------------------------------------------------------------------------
+// Any unit vector orthogonal to the unit vector u
+void vtkDiffusionTensorMathematicsOrthogonal(const double u[3], double v[3])
+{
+  double axis[3] = {0., 0., 0.};
+  const double ax = fabs(u[0]);
+  const double ay = fabs(u[1]);
+  const double az = fabs(u[2]);
+  axis[(ax <= ay && ax <= az) ? 0 : (ay <= az ? 1 : 2)] = 1.;
+  vtkMath::Cross(u, axis, v);
+  vtkMath::Normalize(v);
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+// The major and minor eigenvectors are computed from the rows of A - w I,
+// the medium eigenvector completes the orthonormal basis. When the major
+// (resp. minor) eigenvalue is repeated, its eigenvector is any vector
+// orthogonal to the minor (resp. major) one.
+void vtkDiffusionTensorMathematics::ClosedFormEigenvectors(const double t[6], const double w[3], double **v)
+{
+  const double scale = MAX(fabs(w[0]), fabs(w[2]));
+  double v0[3], v1[3], v2[3];
+  const double v0Norm2 = scale > 0. ? vtkDiffusionTensorMathematicsEigenvector(t, w[0], scale, v0) : 0.;
+  const double v2Norm2 = scale > 0. ? vtkDiffusionTensorMathematicsEigenvector(t, w[2], scale, v2) : 0.;
+  const bool hasV0 = v0Norm2 > 0.;
+  const bool hasV2 = v2Norm2 > 0.;
+  if (hasV0 && hasV2)
+    {
+    // Remove the rounding errors so that the basis is orthonormal: the
+    // least well defined vector is made orthogonal to the other one.
+    double* reference = v0Norm2 >= v2Norm2 ? v0 : v2;
+    double* other = v0Norm2 >= v2Norm2 ? v2 : v0;
+    const double dot = vtkMath::Dot(reference, other);
+    other[0] -= dot * reference[0];
+    other[1] -= dot * reference[1];
+    other[2] -= dot * reference[2];
+    vtkMath::Normalize(other);
+    }
+  else if (hasV0)
+    {
+    vtkDiffusionTensorMathematicsOrthogonal(v0, v2);
+    }
+  else if (hasV2)
+    {
+    vtkDiffusionTensorMathematicsOrthogonal(v2, v0);
+    }
+  else
+    {
+    // Isotropic
+    v0[0] = 1.; v0[1] = 0.; v0[2] = 0.;
+    v2[0] = 0.; v2[1] = 0.; v2[2] = 1.;
+    }
+  vtkMath::Cross(v2, v0, v1);
+  for (int i = 0; i < 3; ++i)
+    {
+    v[i][0] = v0[i];
+    v[i][1] = v1[i];
+    v[i][2] = v2[i];
+    }
+}
+
+//----------------------------------------------------------------------------
+int vtkDiffusionTensorMathematics::ClosedFormEigenSolver(double **m, double *w, double **v)
+{
+  double t00 = m[0][0], t01 = m[0][1], t02 = m[0][2];
+  double t11 = m[1][1], t12 = m[1][2], t22 = m[2][2];
+  double* const t[6] = {&t00, &t01, &t02, &t11, &t12, &t22};
+  double* const eigenvalues[3] = {&w[0], &w[1], &w[2]};
+  vtkDiffusionTensorMathematics::ClosedFormEigenvalues(1, t, eigenvalues);
+  if (v != NULL)
+    {
+    const double tensor[6] = {t00, t01, t02, t11, t12, t22};
+    vtkDiffusionTensorMathematics::ClosedFormEigenvectors(tensor, w, v);
+    }
+  return 0;
+}
@@ -32,6 +32,9 @@
 // VTK includes
 #include <vtkThreadedImageAlgorithm.h>
 
+// STD includes
+#include <vector>
+
 class vtkMatrix4x4;
 class vtkImageData;
 class VTK_Teem_EXPORT vtkDiffusionTensorMathematics : public vtkThreadedImageAlgorithm
@@ -174,6 +177,17 @@ public:
   void SetOperationToColorByMode()
     {this->SetOperation(VTK_TENS_COLOR_MODE);};
 
+  ///
+  /// Compute several operations in one pass. When operations are added,
+  /// the output has one float component per operation, in the order they
+  /// were added, and Operation is ignored. The eigensystem of each tensor
+  /// is computed once for all the operations. Color operations can not
+  /// be added.
+  void AddOperation(int op);
+  void RemoveAllOperations();
+  int GetNumberOfOperations();
+  int GetNthOperation(int n);
+
   ///
   /// Specify scale factor to scale output (float) scalars by.
   /// This is not used when the output is RGBA (char color data).
@@ -186,6 +200,17 @@ public:
   vtkBooleanMacro(ExtractEigenvalues,int);
   vtkGetMacro(ExtractEigenvalues,int);
 
+  ///
+  /// Use ClosedFormEigenSolver instead of TeemEigenSolver to extract
+  /// eigenvalues and eigenvectors. Eigenvalues of a whole row of tensors
+  /// are computed at once and eigenvectors only for the operations that
+  /// need them. The closed-form eigenvalues lose precision when two of
+  /// them are nearly equal: their relative error is then up to ~1e-8.
+  /// Default is off.
+  vtkSetMacro(UseClosedFormEigenSolver,int);
+  vtkBooleanMacro(UseClosedFormEigenSolver,int);
+  vtkGetMacro(UseClosedFormEigenSolver,int);
+
   /// Description
   /// This matrix is only used for ColorByOrientation.
   /// We transform the tensor orientation by this matrix
@@ -267,6 +292,24 @@ public:
   //Description
   //Wrap function to teem eigen solver
   static int TeemEigenSolver(double **m, double *w, double **v);
+
+  ///
+  /// Closed-form eigen solver for symmetric matrices, with the same
+  /// conventions as TeemEigenSolver: eigenvalues are sorted in decreasing
+  /// order and eigenvectors are the columns of v. v may be NULL.
+  static int ClosedFormEigenSolver(double **m, double *w, double **v);
+  ///
+  /// Eigenvalues of n symmetric matrices given by the components m00, m01,
+  /// m02, m11, m12 and m22 of their upper triangle in 6 separate arrays.
+  /// w[0], w[1] and w[2] receive the eigenvalues in decreasing order.
+  /// Matrices are processed 2 at a time with SSE2, or 4 at a time with AVX
+  /// if the compiler targets it, with polynomial approximations of the
+  /// trigonometric functions.
+  static void ClosedFormEigenvalues(int n, double* const t[6], double* const w[3]);
+  ///
+  /// Eigenvectors (columns of v) of the symmetric matrix t (upper triangle
+  /// as in ClosedFormEigenvalues) given its eigenvalues w.
+  static void ClosedFormEigenvectors(const double t[6], const double w[3], double **v);
   void ComputeTensorIncrements(vtkImageData *imageData, vtkIdType incr[3]);
 
 protected:
@@ -276,6 +319,8 @@ protected:
   int Operation; /// math operation to perform
   double ScaleFactor; /// Scale factor for output scalars
   int ExtractEigenvalues; /// Boolean controls eigenfunction extraction
+  int UseClosedFormEigenSolver;
+  std::vector<int> Operations; /// Operations computed in one pass
 
   int MaskWithScalars;
   vtkImageData *ScalarMask;
@@ -30,6 +30,7 @@
 
 // VTK includes
 #include "vtkBitArray.h"
+#include <vtkByteSwap.h>
 #include "vtkCharArray.h"
 #include "vtkDoubleArray.h"
 #include "vtkFloatArray.h"
@@ -48,10 +49,24 @@
 #include "vtkUnsignedIntArray.h"
 #include "vtkUnsignedLongArray.h"
 #include <vtksys/SystemTools.hxx>
+#include <vtk_zlib.h>
 
 // Teem includes
 #include "teem/ten.h"
 
+// STD includes
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
 vtkStandardNewMacro(vtkNRRDReader);
 
 //----------------------------------------------------------------------------
@@ -66,6 +81,9 @@ vtkNRRDReader::vtkNRRDReader()
   this->PointDataType = -1;
   this->DataType = -1;
   this->NumberOfComponents = -1;
+  this->DataFileOffset = 0;
+  this->DataFileByteSkip = 0;
+  this->DataFileCompressed = false;
 }
 
 //----------------------------------------------------------------------------
@@ -343,6 +361,7 @@ void vtkNRRDReader::ExecuteInformation()
     return;
     }
   this->CurrentFileName = this->GetFileName();
+  this->DataFileName.clear();
 
   nrrdNuke(this->nrrd); // nuke and reallocate to reset the state
   this->nrrd = nrrdNew();
@@ -659,9 +678,118 @@ void vtkNRRDReader::ExecuteInformation()
     }
 
   this->vtkImageReader2::ExecuteInformation();
+  this->UpdateDataFileInformation(nio);
   nio = nrrdIoStateNix(nio);
 }
 
+//----------------------------------------------------------------------------
+void vtkNRRDReader::UpdateDataFileInformation(NrrdIoState* nio)
+{
+  this->DataFileName.clear();
+  this->DataFileOffset = 0;
+  this->DataFileByteSkip = 0;
+  if (nio == NULL)
+    {
+    return;
+    }
+  this->DataFileCompressed = (nio->encoding == nrrdEncodingGzip);
+
+  // Components must be interleaved and copied as is
+  unsigned int rangeAxisIdx[NRRD_DIM_MAX] = { 0 };
+  unsigned int rangeAxisNum = nrrdRangeAxesGet(this->nrrd, rangeAxisIdx);
+  if (rangeAxisNum > 1
+    || (rangeAxisNum == 1 && rangeAxisIdx[0] != 0)
+    || nrrdKind3DMaskedSymMatrix == this->nrrd->axis[0].kind
+    || nrrdKind3DSymMatrix == this->nrrd->axis[0].kind)
+    {
+    return;
+    }
+  if (nio->encoding != nrrdEncodingRaw && nio->encoding != nrrdEncodingGzip)
+    {
+    return;
+    }
+
+  // Data must be in a single file
+  if (nio->dataFNFormat || nio->dataFNArr->len > 1)
+    {
+    return;
+    }
+  bool attached = (nio->dataFNArr->len == 0);
+  std::string dataFileName = this->GetFileName();
+  if (!attached)
+    {
+    dataFileName = nio->dataFN[0];
+    if (dataFileName == "-")
+      {
+      return;
+      }
+    if (!vtksys::SystemTools::FileIsFullPath(dataFileName.c_str()) && nio->path)
+      {
+      dataFileName = std::string(nio->path) + "/" + dataFileName;
+      }
+    }
+
+  // The data starts after the header (blank line) of attached files and
+  // after the lines to skip
+  std::ifstream file(dataFileName.c_str(), std::ios::in | std::ios::binary);
+  if (!file)
+    {
+    return;
+    }
+  std::string line;
+  if (attached)
+    {
+    while (std::getline(file, line) && !line.empty() && line != "\r")
+      {
+      }
+    }
+  for (long i = 0; file && i < static_cast<long>(nio->lineSkip); ++i)
+    {
+    std::getline(file, line);
+    }
+  if (!file)
+    {
+    return;
+    }
+  vtkTypeInt64 offset = static_cast<vtkTypeInt64>(file.tellg());
+  file.seekg(0, std::ios::end);
+  vtkTypeInt64 fileLength = static_cast<vtkTypeInt64>(file.tellg());
+
+  vtkTypeInt64 dataSize = static_cast<vtkTypeInt64>(nrrdElementNumber(this->nrrd))
+    * static_cast<vtkTypeInt64>(nrrdElementSize(this->nrrd));
+  if (this->DataFileCompressed)
+    {
+    // byte skip is applied to the decompressed data
+    if (nio->byteSkip < 0)
+      {
+      return;
+      }
+    this->DataFileByteSkip = nio->byteSkip;
+    }
+  else
+    {
+    // -1 means that the data is at the end of the file
+    offset = (nio->byteSkip == -1 ? fileLength - dataSize : offset + nio->byteSkip);
+    if (offset < 0 || offset + dataSize > fileLength)
+      {
+      return;
+      }
+    }
+  this->DataFileOffset = offset;
+  this->DataFileName = dataFileName;
+}
+
+//----------------------------------------------------------------------------
+bool vtkNRRDReader::CanReadDataExtent()
+{
+  if (this->GetFileName() == NULL)
+    {
+    return false;
+    }
+  this->ExecuteInformation();
+  return !this->DataFileName.empty();
+}
+
 //----------------------------------------------------------------------------
 vtkImageData *vtkNRRDReader::AllocateOutputData(vtkDataObject *out, vtkInformation* outInfo)
 {
@@ -891,7 +1019,10 @@ int vtkNRRDReader::tenSpaceDirectionReduce(Nrrd *nout, const Nrrd *nin, double S
 // are assumed to be the same as the file extent/order.
 void vtkNRRDReader::ExecuteDataWithInformation(vtkDataObject *output, vtkInformation* outInfo)
 {
-  if (this->GetOutputInformation(0))
+  // Only the update extent is read when possible, otherwise the whole data
+  // is loaded by teem.
+  bool readDataExtent = this->CanReadDataExtent();
+  if (!readDataExtent && this->GetOutputInformation(0))
     {
     this->GetOutputInformation(0)->Set(
       vtkStreamingDemandDrivenPipeline::UPDATE_EXTENT(),
@@ -907,21 +1038,6 @@ void vtkNRRDReader::ExecuteDataWithInformation(vtkDataObject *output, vtkInforma
     return;
     }
 
-  // Read in the this->nrrd.  Yes, this means that the header is being read
-  // twice: once by ExecuteInformation, and once here
-  if ( nrrdLoad(this->nrrd, this->GetFileName(), NULL) != 0 )
-    {
-    char *err =  biffGetDone(NRRD); // would be nice to free(err)
-    vtkErrorMacro("Read: Error reading " << this->GetFileName() << ":\n" << err);
-    return;
-    }
-
-  if (this->nrrd->data == NULL)
-    {
-    vtkErrorMacro(<< "data is null.");
-    return;
-    }
-
   void *ptr = NULL;
   switch(this->PointDataType)
     {
@@ -946,6 +1062,30 @@ void vtkNRRDReader::ExecuteDataWithInformation(vtkDataObject *output, vtkInforma
     }
   this->ComputeDataIncrements();
 
+  if (readDataExtent)
+    {
+    if (ptr && !this->ReadDataExtent(ptr, imageData->GetExtent()))
+      {
+      vtkErrorMacro("Read: Error reading data of " << this->DataFileName);
+      }
+    return;
+    }
+
+  // Read in the this->nrrd.  Yes, this means that the header is being read
+  // twice: once by ExecuteInformation, and once here
+  if ( nrrdLoad(this->nrrd, this->GetFileName(), NULL) != 0 )
+    {
+    char *err =  biffGetDone(NRRD); // would be nice to free(err)
+    vtkErrorMacro("Read: Error reading " << this->GetFileName() << ":\n" << err);
+    return;
+    }
+
+  if (this->nrrd->data == NULL)
+    {
+    vtkErrorMacro(<< "data is null.");
+    return;
+    }
+
   unsigned int rangeAxisIdx[NRRD_DIM_MAX] = { 0 };
   unsigned int rangeAxisNum = nrrdRangeAxesGet(this->nrrd, rangeAxisIdx);
   if (rangeAxisNum > 1)
@@ -1092,6 +1232,259 @@ void vtkNRRDReader::ExecuteDataWithInformation(vtkDataObject *output, vtkInforma
   nrrdEmpty(this->nrrd);
 }
 
+//----------------------------------------------------------------------------
+bool vtkNRRDReader::ReadDataExtent(void* ptr, const int extent[6])
+{
+  const int* dataExtent = this->GetDataExtent();
+  for (int i = 0; i < 3; ++i)
+    {
+    if (extent[2 * i] > extent[2 * i + 1])
+      {
+      // empty extent
+      return true;
+      }
+    if (extent[2 * i] < dataExtent[2 * i] || extent[2 * i + 1] > dataExtent[2 * i + 1])
+      {
+      vtkErrorMacro("ReadDataExtent: extent is outside of the data extent");
+      return false;
+      }
+    }
+
+  unsigned char* dest = static_cast<unsigned char*>(ptr);
+  bool success = this->DataFileCompressed ?
+    this->ReadGzipDataExtent(dest, extent) : this->ReadRawDataExtent(dest, extent);
+
+  size_t elementSize = nrrdElementSize(this->nrrd);
+  if (success && this->GetSwapBytes() && elementSize > 1)
+    {
+    vtkIdType numberOfElements = static_cast<vtkIdType>(this->NumberOfComponents)
+      * (extent[1] - extent[0] + 1) * (extent[3] - extent[2] + 1) * (extent[5] - extent[4] + 1);
+    vtkByteSwap::SwapVoidRange(ptr, numberOfElements, static_cast<int>(elementSize));
+    }
+  return success;
+}
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Position in the data of the first voxel of the rows of an extent
+struct DataRows
+{
+  DataRows(const int dataExtent[6], const int extent[6], vtkTypeInt64 voxelSize)
+  {
+    this->VoxelSize = voxelSize;
+    this->RowSize = (extent[1] - extent[0] + 1) * voxelSize;
+    this->RowIncrement = (dataExtent[1] - dataExtent[0] + 1) * voxelSize;
+    this->SliceIncrement = (dataExtent[3] - dataExtent[2] + 1) * this->RowIncrement;
+    this->Start = (extent[4] - dataExtent[4]) * this->SliceIncrement
+      + (extent[2] - dataExtent[2]) * this->RowIncrement
+      + (extent[0] - dataExtent[0]) * voxelSize;
+    this->NumberOfRows = extent[3] - extent[2] + 1;
+    this->NumberOfSlices = extent[5] - extent[4] + 1;
+  }
+
+  vtkTypeInt64 GetRowPosition(int row, int slice) const
+  {
+    return this->Start + slice * this->SliceIncrement + row * this->RowIncrement;
+  }
+
+  vtkTypeInt64 GetEnd() const
+  {
+    return this->GetRowPosition(this->NumberOfRows - 1, this->NumberOfSlices - 1) + this->RowSize;
+  }
+
+  vtkTypeInt64 VoxelSize;
+  vtkTypeInt64 RowSize;
+  vtkTypeInt64 RowIncrement;
+  vtkTypeInt64 SliceIncrement;
+  vtkTypeInt64 Start;
+  int NumberOfRows;
+  int NumberOfSlices;
+};
+
+//----------------------------------------------------------------------------
+// Sequential reader of the decompressed bytes of a gzip stream. Members of
+// multi-member streams are decoded one after the other.
+class GzipStreamReader
+{
+public:
+  GzipStreamReader(FILE* file)
+    : File(file), Initialized(false), Input(65536), Discarded(65536)
+  {
+    memset(&this->Stream, 0, sizeof(this->Stream));
+    // 15 + 32: maximum window size with gzip or zlib header detection
+    this->Initialized = (inflateInit2(&this->Stream, 15 + 32) == Z_OK);
+  }
+  ~GzipStreamReader()
+  {
+    if (this->Initialized)
+      {
+      inflateEnd(&this->Stream);
+      }
+  }
+
+  /// Decompress length bytes into buffer, or discard them if buffer is NULL
+  bool Read(unsigned char* buffer, vtkTypeInt64 length)
+  {
+    if (!this->Initialized)
+      {
+      return false;
+      }
+    while (length > 0)
+      {
+      if (this->Stream.avail_in == 0)
+        {
+        size_t count = fread(&this->Input[0], 1, this->Input.size(), this->File);
+        if (count == 0)
+          {
+          return false;
+          }
+        this->Stream.next_in = &this->Input[0];
+        this->Stream.avail_in = static_cast<uInt>(count);
+        }
+      unsigned char* output = buffer ? buffer : &this->Discarded[0];
+      vtkTypeInt64 maximumLength = buffer ? (1 << 30) : static_cast<vtkTypeInt64>(this->Discarded.size());
+      this->Stream.next_out = output;
+      this->Stream.avail_out = static_cast<uInt>(std::min(length, maximumLength));
+      uInt availableOutput = this->Stream.avail_out;
+      int status = inflate(&this->Stream, Z_NO_FLUSH);
+      vtkTypeInt64 produced = availableOutput - this->Stream.avail_out;
+      length -= produced;
+      if (buffer)
+        {
+        buffer += produced;
+        }
+      if (status == Z_STREAM_END)
+        {
+        if (inflateReset(&this->Stream) != Z_OK)
+          {
+          return false;
+          }
+        }
+      else if (status == Z_BUF_ERROR)
+        {
+        // no progress is possible without more input
+        if (this->Stream.avail_in != 0)
+          {
+          return false;
+          }
+        }
+      else if (status != Z_OK)
+        {
+        return false;
+        }
+      }
+    return true;
+  }
+
+private:
+  FILE* File;
+  z_stream Stream;
+  bool Initialized;
+  std::vector<unsigned char> Input;
+  std::vector<unsigned char> Discarded;
+};
+
+//----------------------------------------------------------------------------
+bool SeekFile(FILE* file, vtkTypeInt64 position)
+{
+#ifdef _WIN32
+  return _fseeki64(file, position, SEEK_SET) == 0;
+#else
+  return fseeko(file, static_cast<off_t>(position), SEEK_SET) == 0;
+#endif
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+bool vtkNRRDReader::ReadRawDataExtent(unsigned char* ptr, const int extent[6])
+{
+  DataRows rows(this->GetDataExtent(), extent,
+    static_cast<vtkTypeInt64>(nrrdElementSize(this->nrrd)) * this->NumberOfComponents);
+
+#ifndef _WIN32
+  // Map only the pages that contain the extent and copy its rows
+  int fd = open(this->DataFileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    {
+    return false;
+    }
+  vtkTypeInt64 pageSize = sysconf(_SC_PAGESIZE);
+  vtkTypeInt64 begin = this->DataFileOffset + rows.Start;
+  vtkTypeInt64 mapOffset = begin - begin % pageSize;
+  size_t mapLength = static_cast<size_t>(this->DataFileOffset + rows.GetEnd() - mapOffset);
+  void* map = mmap(NULL, mapLength, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(mapOffset));
+  close(fd);
+  if (map == MAP_FAILED)
+    {
+    return false;
+    }
+  const unsigned char* data = static_cast<const unsigned char*>(map)
+    + (this->DataFileOffset - mapOffset);
+  for (int slice = 0; slice < rows.NumberOfSlices; ++slice)
+    {
+    for (int row = 0; row < rows.NumberOfRows; ++row)
+      {
+      memcpy(ptr, data + rows.GetRowPosition(row, slice), static_cast<size_t>(rows.RowSize));
+      ptr += rows.RowSize;
+      }
+    }
+  munmap(map, mapLength);
+  return true;
+#else
+  FILE* file = fopen(this->DataFileName.c_str(), "rb");
+  if (file == NULL)
+    {
+    return false;
+    }
+  bool success = true;
+  for (int slice = 0; success && slice < rows.NumberOfSlices; ++slice)
+    {
+    for (int row = 0; success && row < rows.NumberOfRows; ++row)
+      {
+      success = SeekFile(file, this->DataFileOffset + rows.GetRowPosition(row, slice))
+        && fread(ptr, 1, static_cast<size_t>(rows.RowSize), file) == static_cast<size_t>(rows.RowSize);
+      ptr += rows.RowSize;
+      }
+    }
+  fclose(file);
+  return success;
+#endif
+}
+
+//----------------------------------------------------------------------------
+bool vtkNRRDReader::ReadGzipDataExtent(unsigned char* ptr, const int extent[6])
+{
+  DataRows rows(this->GetDataExtent(), extent,
+    static_cast<vtkTypeInt64>(nrrdElementSize(this->nrrd)) * this->NumberOfComponents);
+
+  FILE* file = fopen(this->DataFileName.c_str(), "rb");
+  if (file == NULL)
+    {
+    return false;
+    }
+  // The stream is decoded up to the last row of the extent, the other rows
+  // are discarded.
+  bool success = SeekFile(file, this->DataFileOffset);
+  GzipStreamReader reader(file);
+  vtkTypeInt64 position = -this->DataFileByteSkip;
+  for (int slice = 0; success && slice < rows.NumberOfSlices; ++slice)
+    {
+    for (int row = 0; success && row < rows.NumberOfRows; ++row)
+      {
+      vtkTypeInt64 rowPosition = rows.GetRowPosition(row, slice);
+      success = reader.Read(NULL, rowPosition - position)
+        && reader.Read(ptr, rows.RowSize);
+      position = rowPosition + rows.RowSize;
+      ptr += rows.RowSize;
+      }
+    }
+  fclose(file);
+  return success;
+}
+
 //----------------------------------------------------------------------------
 void vtkNRRDReader::PrintSelf(ostream& os, vtkIndent indent)
 {
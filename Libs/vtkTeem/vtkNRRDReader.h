@@ -92,6 +92,14 @@ public:
   ///  is the given file name a NRRD file?
   virtual int CanReadFile(const char* filename);
 
+  ///
+  /// Return true if only the update extent of the current file is read.
+  /// It is the case for raw and gzip encoded data stored in a single file,
+  /// without tensors to expand and with the components on the fastest
+  /// axis. Raw data is memory mapped, gzip data is decoded up to the last
+  /// requested slice. Other files are read entirely.
+  bool CanReadDataExtent();
+
   ///
   /// Valid extentsions
   virtual const char* GetFileExtensions()
@@ -258,9 +266,28 @@ protected:
   std::map<unsigned int, std::string> AxisLabels;
   std::map<unsigned int, std::string> AxisUnits;
 
+  /// Location of the data in the file, set by ExecuteInformation.
+  /// DataFileName is empty if the data can't be read by extent.
+  /// DataFileOffset is the position of the raw data or of the gzip stream
+  /// in the file, DataFileByteSkip the number of decompressed bytes to
+  /// skip before the gzip data.
+  std::string DataFileName;
+  vtkTypeInt64 DataFileOffset;
+  vtkTypeInt64 DataFileByteSkip;
+  bool DataFileCompressed;
+
   virtual void ExecuteInformation();
   virtual void ExecuteDataWithInformation(vtkDataObject *output, vtkInformation* outInfo);
 
+  /// Find where the data of the current file is, if it can be read by
+  /// extent.
+  void UpdateDataFileInformation(NrrdIoState* nio);
+
+  /// Read the voxels of the extent into ptr and swap their bytes if needed.
+  bool ReadDataExtent(void* ptr, const int extent[6]);
+  bool ReadRawDataExtent(unsigned char* ptr, const int extent[6]);
+  bool ReadGzipDataExtent(unsigned char* ptr, const int extent[6]);
+
   int tenSpaceDirectionReduce(Nrrd *nout, const Nrrd *nin, double SD[9]);
 
 private:
@@ -1,4 +1,9 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <map>
+#include <string>
+#include <vector>
 
 #include "vtkNRRDWriter.h"
 
@@ -7,11 +12,56 @@
 #include "vtkPointData.h"
 #include "vtkObjectFactory.h"
 #include "vtkInformation.h"
+#include "vtkNew.h"
+#include "vtkTimerLog.h"
 #include <vtkVersion.h>
+#include <vtk_zlib.h>
 
 class AttributeMapType: public std::map<std::string, std::string> {};
 class AxisInfoMapType : public std::map<unsigned int, std::string> {};
 
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Blocks of a batch compressed by the threads of vtkNRRDWriter::WriteGzipData
+struct vtkNRRDWriterCompressionData
+{
+  const unsigned char* Data;
+  size_t Length;
+  size_t BlockSize;
+  size_t FirstBlock;
+  int Level;
+  std::vector<std::vector<unsigned char> > Members;
+  std::vector<char> Success;
+};
+
+//----------------------------------------------------------------------------
+// Compress data into a complete gzip member (header, deflate stream and trailer)
+bool CompressGzipMember(const unsigned char* data, size_t length, int level,
+                        std::vector<unsigned char>& member)
+{
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  // 15 + 16: maximum window size with a gzip header and trailer
+  if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+    return false;
+    }
+  // older zlib versions do not count the gzip header and trailer in the bound
+  member.resize(deflateBound(&stream, static_cast<uLong>(length)) + 32);
+  stream.next_in = const_cast<Bytef*>(data);
+  stream.avail_in = static_cast<uInt>(length);
+  stream.next_out = &member[0];
+  stream.avail_out = static_cast<uInt>(member.size());
+  int status = deflate(&stream, Z_FINISH);
+  member.resize(stream.total_out);
+  deflateEnd(&stream);
+  return status == Z_STREAM_END;
+}
+
+} // end of anonymous namespace
+
 vtkStandardNewMacro(vtkNRRDWriter);
 
 //----------------------------------------------------------------------------
@@ -23,6 +73,10 @@ vtkNRRDWriter::vtkNRRDWriter()
   this->IJKToRASMatrix = vtkMatrix4x4::New();
   this->MeasurementFrameMatrix = vtkMatrix4x4::New();
   this->UseCompression = 1;
+  this->CompressionLevel = -1;
+  this->NumberOfThreads = 0;
+  this->CompressionBlockSize = 4 * 1024 * 1024;
+  this->WriteThroughput = 0.;
   this->DiffusionWeigthedData = 0;
   this->FileType = VTK_BINARY;
   this->WriteErrorOff();
@@ -179,6 +233,7 @@ int vtkNRRDWriter::VTKToNrrdPixelType( const int vtkPixelType )
 void vtkNRRDWriter::WriteData()
 {
   this->WriteErrorOff();
+  this->WriteThroughput = 0.;
   if (this->GetFileName() == NULL)
     {
     vtkErrorMacro("FileName has not been set. Cannot save file");
@@ -342,10 +397,21 @@ void vtkNRRDWriter::WriteData()
     }
 
   // set encoding for data: compressed (raw), (uncompressed) raw, or ascii
+  bool writeGzipData = false;
   if ( this->GetUseCompression() && nrrdEncodingGzip->available() )
     {
     // this is necessarily gzip-compressed *raw* data
     nio->encoding = nrrdEncodingGzip;
+    nio->zlevel = this->CompressionLevel;
+    // teem only writes the header of attached header files, the data is
+    // compressed in parallel by WriteGzipData(). The data file of detached
+    // headers is written by teem.
+    std::string fileName = this->GetFileName();
+    std::string detachedExtension = ".nhdr";
+    writeGzipData = !(fileName.size() >= detachedExtension.size()
+      && fileName.compare(fileName.size() - detachedExtension.size(),
+                          detachedExtension.size(), detachedExtension) == 0);
+    nio->skipData = writeGzipData ? AIR_TRUE : AIR_FALSE;
     }
   else
     {
@@ -366,6 +432,8 @@ void vtkNRRDWriter::WriteData()
   nio->endian = airEndianUnknown;
 
   // Write the nrrd to file.
+  double startTime = vtkTimerLog::GetUniversalTime();
+  size_t dataSize = nrrdElementNumber(nrrd) * nrrdElementSize(nrrd);
   if (nrrdSave(this->GetFileName(), nrrd, nio))
     {
     char *err = biffGetDone(NRRD); // would be nice to free(err)
@@ -373,16 +441,126 @@ void vtkNRRDWriter::WriteData()
                       << this->GetFileName() << ":\n" << err);
     this->WriteErrorOn();
     }
+  else if (writeGzipData && !this->WriteGzipData(buffer, dataSize))
+    {
+    vtkErrorMacro("Write: Error writing compressed data to "
+                      << this->GetFileName());
+    this->WriteErrorOn();
+    }
+  double elapsedTime = vtkTimerLog::GetUniversalTime() - startTime;
+  this->WriteThroughput = (elapsedTime > 0. && !this->GetWriteError()) ?
+    dataSize / (1024. * 1024.) / elapsedTime : 0.;
+  vtkDebugMacro("Write: " << this->GetFileName() << " written at "
+                << this->WriteThroughput << "MB/s");
   // Free the nrrd struct but don't touch nrrd->data
   nrrd = nrrdNix(nrrd);
   nio = nrrdIoStateNix(nio);
   return;
 }
 
+//----------------------------------------------------------------------------
+bool vtkNRRDWriter::WriteGzipData(void *buffer, size_t length)
+{
+  FILE* file = fopen(this->GetFileName(), "r+b");
+  if (!file)
+    {
+    return false;
+    }
+  // An attached header ends with a blank line, teem may skip it without data
+  char ending[2] = { 0, 0 };
+  bool success = fseek(file, -2, SEEK_END) == 0
+    && fread(ending, 1, 2, file) == 2
+    && fseek(file, 0, SEEK_END) == 0;
+  if (success && !(ending[0] == '\n' && ending[1] == '\n'))
+    {
+    success = fputc('\n', file) != EOF;
+    }
+
+  vtkNRRDWriterCompressionData compressionData;
+  compressionData.Data = static_cast<const unsigned char*>(buffer);
+  compressionData.Length = length;
+  compressionData.BlockSize = static_cast<size_t>(this->CompressionBlockSize);
+  compressionData.Level = this->CompressionLevel;
+  // An empty stream is still a gzip member
+  size_t numberOfBlocks = std::max(static_cast<size_t>(1),
+    (length + compressionData.BlockSize - 1) / compressionData.BlockSize);
+
+  int numberOfThreads = this->NumberOfThreads;
+  if (numberOfThreads <= 0)
+    {
+    numberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+    }
+  numberOfThreads = static_cast<int>(std::max(static_cast<size_t>(1),
+    std::min(static_cast<size_t>(numberOfThreads), numberOfBlocks)));
+  vtkNew<vtkMultiThreader> threader;
+  threader->SetNumberOfThreads(numberOfThreads);
+
+  // Each thread compresses one block of the batch, then the batch is written
+  // in order. Only a batch of compressed blocks is kept in memory.
+  for (compressionData.FirstBlock = 0;
+       success && compressionData.FirstBlock < numberOfBlocks;
+       compressionData.FirstBlock += numberOfThreads)
+    {
+    size_t batchSize = std::min(static_cast<size_t>(numberOfThreads),
+                                numberOfBlocks - compressionData.FirstBlock);
+    compressionData.Members.resize(batchSize);
+    compressionData.Success.assign(batchSize, 0);
+    if (numberOfThreads == 1)
+      {
+      // Avoid the overhead of starting a thread
+      vtkMultiThreader::ThreadInfo threadInfo;
+      threadInfo.ThreadID = 0;
+      threadInfo.NumberOfThreads = 1;
+      threadInfo.UserData = &compressionData;
+      vtkNRRDWriter::CompressThreadFunction(&threadInfo);
+      }
+    else
+      {
+      threader->SetSingleMethod(vtkNRRDWriter::CompressThreadFunction, &compressionData);
+      threader->SingleMethodExecute();
+      }
+    for (size_t i = 0; success && i < batchSize; ++i)
+      {
+      std::vector<unsigned char>& member = compressionData.Members[i];
+      success = compressionData.Success[i]
+        && fwrite(&member[0], 1, member.size(), file) == member.size();
+      }
+    }
+
+  success = (fclose(file) == 0) && success;
+  return success;
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkNRRDWriter::CompressThreadFunction(void *arg)
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  vtkNRRDWriterCompressionData* compressionData =
+    static_cast<vtkNRRDWriterCompressionData*>(threadInfo->UserData);
+  size_t i = static_cast<size_t>(threadInfo->ThreadID);
+  if (i < compressionData->Members.size())
+    {
+    size_t begin = std::min((compressionData->FirstBlock + i) * compressionData->BlockSize,
+                            compressionData->Length);
+    size_t end = std::min(begin + compressionData->BlockSize, compressionData->Length);
+    compressionData->Success[i] = CompressGzipMember(
+      compressionData->Data + begin, end - begin, compressionData->Level,
+      compressionData->Members[i]) ? 1 : 0;
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
 void vtkNRRDWriter::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os,indent);
 
+  os << indent << "UseCompression: " << this->UseCompression << "\n";
+  os << indent << "CompressionLevel: " << this->CompressionLevel << "\n";
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << "\n";
+  os << indent << "CompressionBlockSize: " << this->CompressionBlockSize << "\n";
+  os << indent << "WriteThroughput: " << this->WriteThroughput << "MB/s\n";
+
   os << indent << "RAS to IJK Matrix: ";
      this->IJKToRASMatrix->PrintSelf(os,indent);
   os << indent << "Measurement frame: ";
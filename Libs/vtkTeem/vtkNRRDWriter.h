@@ -6,6 +6,7 @@
 
 #include "vtkDoubleArray.h"
 #include "vtkMatrix4x4.h"
+#include "vtkMultiThreader.h"
 #include "vtkSmartPointer.h"
 #include "teem/nrrd.h"
 
@@ -55,6 +56,32 @@ public:
   vtkGetMacro(UseCompression,int);
   vtkBooleanMacro(UseCompression,int);
 
+  ///
+  /// Compression level of the gzip encoding, from 1 (fastest) to 9
+  /// (smallest file). The default (-1) is the zlib default level.
+  vtkSetClampMacro(CompressionLevel,int,-1,9);
+  vtkGetMacro(CompressionLevel,int);
+
+  ///
+  /// Number of threads compressing the data of files with an attached
+  /// header. The data is split into blocks that are compressed independently
+  /// and written as the members of a multi-member gzip stream, which gzip
+  /// readers decode as a single stream.
+  /// 0 (default) uses vtkMultiThreader::GetGlobalDefaultNumberOfThreads().
+  vtkSetMacro(NumberOfThreads,int);
+  vtkGetMacro(NumberOfThreads,int);
+
+  ///
+  /// Size in bytes of the uncompressed blocks, 4MB by default.
+  /// The file content depends on the block size but not on the number
+  /// of threads.
+  vtkSetClampMacro(CompressionBlockSize,int,1024,VTK_INT_MAX);
+  vtkGetMacro(CompressionBlockSize,int);
+
+  ///
+  /// Uncompressed data written per second by the last write, in MB/s.
+  vtkGetMacro(WriteThroughput,double);
+
   vtkSetClampMacro(FileType,int,VTK_ASCII,VTK_BINARY);
   vtkGetMacro(FileType,int);
   void SetFileTypeToASCII() {this->SetFileType(VTK_ASCII);};
@@ -97,6 +124,10 @@ protected:
   vtkMatrix4x4* MeasurementFrameMatrix;
 
   int UseCompression;
+  int CompressionLevel;
+  int NumberOfThreads;
+  int CompressionBlockSize;
+  double WriteThroughput;
   int FileType;
 
   AttributeMapType *Attributes;
@@ -108,6 +139,9 @@ private:
   void operator=(const vtkNRRDWriter&);  /// Not implemented.
   void vtkImageDataInfoToNrrdInfo(vtkImageData *in, int &nrrdKind, size_t &numComp, int &vtkType, void **buffer);
   int VTKToNrrdPixelType( const int vtkPixelType );
+  /// Append the data to the header as a multi-member gzip stream
+  bool WriteGzipData(void *buffer, size_t length);
+  static VTK_THREAD_RETURN_TYPE CompressThreadFunction(void *arg);
   int DiffusionWeigthedData;
 };
 
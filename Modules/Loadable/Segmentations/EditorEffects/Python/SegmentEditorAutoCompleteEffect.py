@@ -149,6 +149,8 @@ a complete segmentation, taking into account the master volume content. Minimum
         logging.debug("Segmentation cancelled because an input segment was deleted")
         self.onCancel()
         return
+      # A labelmap shared with other segments is modified when any of them changes,
+      # which only results in an additional update
       segmentLabelmap = segment.GetRepresentation(vtkSegmentationCore.vtkSegmentationConverter.GetSegmentationBinaryLabelmapRepresentationName())
       if self.selectedSegmentModifiedTimes.has_key(segmentID) \
         and segmentLabelmap.GetMTime() == self.selectedSegmentModifiedTimes[segmentID]:
@@ -278,8 +280,8 @@ a complete segmentation, taking into account the master volume content. Minimum
     previewNode.GetSegmentation().GetSegmentIDs(segmentIDs)
     for index in xrange(segmentIDs.GetNumberOfValues()):
       segmentID = segmentIDs.GetValue(index)
-      previewSegment = previewNode.GetSegmentation().GetSegment(segmentID)
-      previewSegmentLabelmap = previewSegment.GetRepresentation(vtkSegmentationCore.vtkSegmentationConverter.GetSegmentationBinaryLabelmapRepresentationName())
+      previewSegmentLabelmap = vtkSegmentationCore.vtkOrientedImageData()
+      previewNode.GetSegmentation().GetBinaryLabelmapRepresentation(segmentID, previewSegmentLabelmap)
       slicer.vtkSlicerSegmentationsModuleLogic.SetBinaryLabelmapToSegment(previewSegmentLabelmap, segmentationNode, segmentID)
       previewNode.GetSegmentation().RemoveSegment(segmentID) # delete now to limit memory usage
 
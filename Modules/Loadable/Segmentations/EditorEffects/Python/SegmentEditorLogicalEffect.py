@@ -195,8 +195,9 @@ class SegmentEditorLogicalEffect(AbstractScriptedSegmentEditorEffect):
       if not modifierSegmentID:
         logging.error("Operation {0} requires a selected modifier segment".format(operation))
         return
-      modifierSegment = segmentation.GetSegment(modifierSegmentID)
-      modifierSegmentLabelmap = modifierSegment.GetRepresentation(vtkSegmentationCore.vtkSegmentationConverter.GetSegmentationBinaryLabelmapRepresentationName())
+      # If the labelmap is shared with other segments then only the voxels of the modifier segment are used
+      modifierSegmentLabelmap = vtkSegmentationCore.vtkOrientedImageData()
+      segmentation.GetBinaryLabelmapRepresentation(modifierSegmentID, modifierSegmentLabelmap)
 
       if operation == LOGICAL_COPY:
         if bypassMasking:
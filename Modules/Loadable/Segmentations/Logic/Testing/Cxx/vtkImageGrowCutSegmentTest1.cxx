@@ -0,0 +1,199 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Segmentations includes
+#include "vtkImageGrowCutSegment.h"
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cstdlib>
+#include <string>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Dark background with a bright sphere at the center and a brighter cube
+// in a corner, with some texture so that distances are not all equal.
+vtkSmartPointer<vtkImageData> CreateIntensityVolume(int size)
+{
+  vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+  image->SetDimensions(size, size, size);
+  image->AllocateScalars(VTK_SHORT, 1);
+  short* ptr = static_cast<short*>(image->GetScalarPointer());
+  int center = size / 2;
+  int radius = size / 4;
+  for (int k = 0; k < size; ++k)
+    {
+    for (int j = 0; j < size; ++j)
+      {
+      for (int i = 0; i < size; ++i)
+        {
+        short value = 50;
+        if ((i - center) * (i - center) + (j - center) * (j - center) + (k - center) * (k - center) < radius * radius)
+          {
+          value = 200;
+          }
+        else if (i < size / 5 && j < size / 5 && k < size / 5)
+          {
+          value = 400;
+          }
+        *ptr++ = static_cast<short>(value + (i * 7 + j * 13 + k * 17) % 20);
+        }
+      }
+    }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+void SetSeed(vtkImageData* seeds, int i, int j, int k, short label)
+{
+  *static_cast<short*>(seeds->GetScalarPointer(i, j, k)) = label;
+  seeds->Modified();
+}
+
+//----------------------------------------------------------------------------
+short GetLabel(vtkImageData* labels, int i, int j, int k)
+{
+  return *static_cast<short*>(labels->GetScalarPointer(i, j, k));
+}
+
+//----------------------------------------------------------------------------
+int CountDifferences(vtkImageData* expected, vtkImageData* actual)
+{
+  int* dims = expected->GetDimensions();
+  vtkIdType numberOfVoxels = static_cast<vtkIdType>(dims[0]) * dims[1] * dims[2];
+  const short* expectedPtr = static_cast<short*>(expected->GetScalarPointer());
+  const short* actualPtr = static_cast<short*>(actual->GetScalarPointer());
+  int numberOfDifferences = 0;
+  for (vtkIdType i = 0; i < numberOfVoxels; ++i)
+    {
+    numberOfDifferences += (expectedPtr[i] != actualPtr[i] ? 1 : 0);
+    }
+  return numberOfDifferences;
+}
+
+//----------------------------------------------------------------------------
+void PrintTime(const char* name, vtkTimerLog* timer, bool benchmark)
+{
+  if (!benchmark)
+    {
+    return;
+    }
+  REPORT_MEASUREMENT("vtkImageGrowCutSegment-" << name, timer->GetElapsedTime());
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkImageGrowCutSegmentTest1(int argc, char * argv[])
+{
+  vtkNew<vtkImageGrowCutSegment> growCut;
+  EXERCISE_BASIC_OBJECT_METHODS(growCut.GetPointer());
+
+  // The segmentation times are only reported on request.
+  // Usage: vtkImageGrowCutSegmentTest1 --benchmark [size]
+  bool benchmark = vtkAddonTestingUtilities::IsBenchmarkRequested(argc, argv);
+  int size = 100;
+  if (benchmark && argc > 2)
+    {
+    size = atoi(argv[2]);
+    }
+  int center = size / 2;
+  vtkSmartPointer<vtkImageData> intensityVolume = CreateIntensityVolume(size);
+
+  vtkNew<vtkImageData> seedLabelVolume;
+  seedLabelVolume->SetDimensions(size, size, size);
+  seedLabelVolume->AllocateScalars(VTK_SHORT, 1);
+  seedLabelVolume->GetPointData()->GetScalars()->FillComponent(0, 0);
+  for (int i = center - 3; i <= center + 3; ++i)
+    {
+    SetSeed(seedLabelVolume.GetPointer(), i, center, center, 1);
+    SetSeed(seedLabelVolume.GetPointer(), size - 3, i, 2, 2);
+    }
+
+  growCut->SetIntensityVolume(intensityVolume);
+  growCut->SetSeedLabelVolume(seedLabelVolume.GetPointer());
+
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  growCut->Update();
+  timer->StopTimer();
+  PrintTime("Full", timer.GetPointer(), benchmark);
+
+  vtkSmartPointer<vtkImageData> initialResult = vtkSmartPointer<vtkImageData>::New();
+  initialResult->DeepCopy(growCut->GetOutput());
+  CHECK_INT(GetLabel(initialResult, center, center, center + size / 5), 1);
+  CHECK_INT(GetLabel(initialResult, size - 3, center, 5), 2);
+
+  // Adding a seed only grows from the new seed,
+  // the bright cube is separated from the rest by a large intensity step
+  SetSeed(seedLabelVolume.GetPointer(), size / 10, size / 10, size / 10, 3);
+  timer->StartTimer();
+  growCut->Update();
+  timer->StopTimer();
+  PrintTime("AddSeed", timer.GetPointer(), benchmark);
+  CHECK_INT(GetLabel(growCut->GetOutput(), 2, 2, 2), 3);
+  CHECK_INT(GetLabel(growCut->GetOutput(), center, center, center + size / 5), 1);
+  CHECK_INT(GetLabel(growCut->GetOutput(), size - 3, center, 5), 2);
+
+  // Incremental result matches computation from scratch exactly,
+  // voxels at equal distance from two seeds get the lower label in both cases.
+  vtkNew<vtkImageGrowCutSegment> referenceGrowCut;
+  referenceGrowCut->SetIntensityVolume(intensityVolume);
+  referenceGrowCut->SetSeedLabelVolume(seedLabelVolume.GetPointer());
+  referenceGrowCut->Update();
+  CHECK_INT(CountDifferences(referenceGrowCut->GetOutput(), growCut->GetOutput()), 0);
+
+  // Seeds with a lower label added later must win ties against existing seeds.
+  // The two seeds are close to each other in the background, where many voxels
+  // are at equal distance from both.
+  SetSeed(seedLabelVolume.GetPointer(), 2, size - 3, size - 3, 5);
+  growCut->Update();
+  SetSeed(seedLabelVolume.GetPointer(), 2, size - 3, size - 7, 4);
+  growCut->Update();
+  referenceGrowCut->Reset();
+  referenceGrowCut->Modified();
+  referenceGrowCut->Update();
+  CHECK_INT(CountDifferences(referenceGrowCut->GetOutput(), growCut->GetOutput()), 0);
+  SetSeed(seedLabelVolume.GetPointer(), 2, size - 3, size - 3, 0);
+  SetSeed(seedLabelVolume.GetPointer(), 2, size - 3, size - 7, 0);
+
+  // Removing a seed recomputes the result from scratch
+  SetSeed(seedLabelVolume.GetPointer(), size / 10, size / 10, size / 10, 0);
+  timer->StartTimer();
+  growCut->Update();
+  timer->StopTimer();
+  PrintTime("RemoveSeed", timer.GetPointer(), benchmark);
+  CHECK_INT(CountDifferences(initialResult, growCut->GetOutput()), 0);
+
+  // Reset
+  growCut->Reset();
+  growCut->Modified();
+  growCut->Update();
+  CHECK_INT(CountDifferences(initialResult, growCut->GetOutput()), 0);
+
+  return EXIT_SUCCESS;
+}
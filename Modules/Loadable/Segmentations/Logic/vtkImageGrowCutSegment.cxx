@@ -1,6 +1,8 @@
 #include "vtkImageGrowCutSegment.h"
 
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <vector>
 
 #include <vtkInformation.h>
@@ -12,8 +14,6 @@
 #include <vtkStreamingDemandDrivenPipeline.h>
 #include <vtkTimerLog.h>
 
-#include "FibHeap.h"
-
 vtkStandardNewMacro(vtkImageGrowCutSegment);
 
 //----------------------------------------------------------------------------
@@ -23,56 +23,140 @@ const DistancePixelType DIST_INF = std::numeric_limits<DistancePixelType>::max()
 const DistancePixelType DIST_EPSILON = 1e-3;
 
 //----------------------------------------------------------------------------
-class HeapNode : public FibHeapNode
+// Monotone priority queue of voxel indices, keyed by voxel distance.
+// Distances are quantized into buckets of equal width. Buckets are stored in
+// a circular array that is large enough to hold all distances that can be
+// reached in one step from the current minimum. Each bucket is a doubly
+// linked list stored in flat arrays indexed by voxel index, therefore no
+// memory is allocated while the queue is used.
+// Voxels within a bucket are not sorted: if the distance of a voxel is
+// decreased after it has been removed from the queue then it is simply
+// pushed again, so computed distances are still exact.
+class BucketQueue
 {
 public:
-  HeapNode()
-  : FibHeapNode()
-  , m_Key(0)
-  , m_Index(-1)
+  BucketQueue()
+  : m_NumberOfBuckets(0)
+  , m_InverseBucketWidth(1.0)
+  , m_CurrentBucket(0)
+  , m_Size(0)
+  {
+  }
+
+  // Allocate the queue for numberOfNodes voxels. maximumStep is the largest
+  // difference between the distance of a voxel and its neighbors.
+  void Initialize(long numberOfNodes, double maximumStep)
   {
+    double bucketWidth = maximumStep / BucketsPerMaximumStep;
+    m_InverseBucketWidth = (bucketWidth > 0 ? 1.0 / bucketWidth : 1.0);
+    // A step may span one more bucket than maximumStep / bucketWidth,
+    // and one more is kept for float rounding of summed distances.
+    m_NumberOfBuckets = BucketsPerMaximumStep + 3;
+    m_BucketHeads.assign(m_NumberOfBuckets, -1);
+    m_Next.resize(numberOfNodes);
+    m_Previous.resize(numberOfNodes);
+    m_Queued.assign(numberOfNodes, 0);
+    m_CurrentBucket = 0;
+    m_Size = 0;
   }
 
-  virtual void operator =(FibHeapNode& RHS)
+  void Release()
   {
-    FHN_Assign(RHS);
-    m_Key = ((HeapNode&)RHS).m_Key;
+    std::vector<long>().swap(m_BucketHeads);
+    std::vector<long>().swap(m_Next);
+    std::vector<long>().swap(m_Previous);
+    std::vector<unsigned char>().swap(m_Queued);
+    m_NumberOfBuckets = 0;
+    m_Size = 0;
   }
 
-  virtual int operator ==(FibHeapNode& RHS)
+  inline bool IsEmpty() const { return m_Size == 0; }
+
+  // Add a voxel that is not in the queue yet
+  inline void Push(long index, DistancePixelType distance)
   {
-    if (FHN_Cmp(RHS))
+    vtkIdType bucket = GetBucket(distance);
+    if (m_Size == 0 || bucket < m_CurrentBucket)
+      {
+      m_CurrentBucket = bucket;
+      }
+    long& head = GetBucketHead(bucket);
+    m_Previous[index] = -1;
+    m_Next[index] = head;
+    if (head >= 0)
       {
-      return 0;
+      m_Previous[head] = index;
       }
-    return m_Key == ((HeapNode&)RHS).m_Key ? 1 : 0;
+    head = index;
+    m_Queued[index] = 1;
+    m_Size++;
   }
 
-  virtual int operator <(FibHeapNode& RHS)
+  // Move a voxel to the bucket of its new distance, or add it if it is not in the queue
+  inline void Update(long index, DistancePixelType oldDistance, DistancePixelType newDistance)
   {
-    int x = FHN_Cmp(RHS);
-    if (x != 0)
+    if (m_Queued[index])
       {
-      return x < 0 ? 1 : 0;
+      long previous = m_Previous[index];
+      long next = m_Next[index];
+      if (previous >= 0)
+        {
+        m_Next[previous] = next;
+        }
+      else
+        {
+        GetBucketHead(GetBucket(oldDistance)) = next;
+        }
+      if (next >= 0)
+        {
+        m_Previous[next] = previous;
+        }
+      m_Size--;
       }
-    return m_Key < ((HeapNode&)RHS).m_Key ? 1 : 0;
+    Push(index, newDistance);
   }
 
-  virtual void operator =(DistancePixelType newKeyVal)
+  // Remove a voxel from the lowest non-empty bucket. The queue must not be empty.
+  inline long Pop()
   {
-    HeapNode tmp;
-    tmp.m_Key = m_Key = newKeyVal;
-    FHN_Assign(tmp);
+    while (GetBucketHead(m_CurrentBucket) < 0)
+      {
+      m_CurrentBucket++;
+      }
+    long& head = GetBucketHead(m_CurrentBucket);
+    long index = head;
+    head = m_Next[index];
+    if (head >= 0)
+      {
+      m_Previous[head] = -1;
+      }
+    m_Queued[index] = 0;
+    m_Size--;
+    return index;
   }
 
-  inline DistancePixelType GetKeyValue() { return m_Key; }
-  inline void SetKeyValue(DistancePixelType keyValue) { m_Key = keyValue; }
-  inline long int GetIndexValue() { return m_Index; }
-  inline void SetIndexValue(long int indexValue) { m_Index = indexValue; }
-
 protected:
-  DistancePixelType m_Key;
-  long m_Index;
+  // Larger values make ordering within a bucket more accurate (fewer voxels are
+  // processed multiple times) but more empty buckets have to be skipped.
+  static const int BucketsPerMaximumStep = 1024;
+
+  inline vtkIdType GetBucket(DistancePixelType distance) const
+  {
+    return static_cast<vtkIdType>(distance * m_InverseBucketWidth);
+  }
+  inline long& GetBucketHead(vtkIdType bucket)
+  {
+    return m_BucketHeads[bucket % m_NumberOfBuckets];
+  }
+
+  std::vector<long> m_BucketHeads;
+  std::vector<long> m_Next;
+  std::vector<long> m_Previous;
+  std::vector<unsigned char> m_Queued;
+  vtkIdType m_NumberOfBuckets;
+  double m_InverseBucketWidth;
+  vtkIdType m_CurrentBucket;
+  long m_Size;
 };
 
 //----------------------------------------------------------------------------
@@ -97,31 +181,26 @@ public:
   bool ExecuteGrowCut2(vtkImageData *intensityVolume, vtkImageData *seedLabelVolume);
 
   vtkSmartPointer<vtkImageData> m_DistanceVolume;
-  vtkSmartPointer<vtkImageData> m_DistanceVolumePre;
   vtkSmartPointer<vtkImageData> m_ResultLabelVolume;
-  vtkSmartPointer<vtkImageData> m_ResultLabelVolumePre;
 
   long m_DimX;
   long m_DimY;
   long m_DimZ;
   std::vector<long> m_NeighborIndexOffsets;
   std::vector<unsigned char> m_NumberOfNeighbors;
+  // Non-zero for voxels that were seeds in the previous run
+  std::vector<unsigned char> m_SeedMask;
 
-  FibHeap *m_Heap;
-  HeapNode *m_HeapNodes;
+  BucketQueue m_Queue;
   bool m_bSegInitialized;
 };
 
 //-----------------------------------------------------------------------------
 vtkImageGrowCutSegment::vtkInternal::vtkInternal()
 {
-  m_Heap = NULL;
-  m_HeapNodes = NULL;
   m_bSegInitialized = false;
   m_DistanceVolume = vtkSmartPointer<vtkImageData>::New();
-  m_DistanceVolumePre = vtkSmartPointer<vtkImageData>::New();
   m_ResultLabelVolume = vtkSmartPointer<vtkImageData>::New();
-  m_ResultLabelVolumePre = vtkSmartPointer<vtkImageData>::New();
 };
 
 //-----------------------------------------------------------------------------
@@ -133,36 +212,35 @@ vtkImageGrowCutSegment::vtkInternal::~vtkInternal()
 //-----------------------------------------------------------------------------
 void vtkImageGrowCutSegment::vtkInternal::Reset()
 {
-  if (m_Heap != NULL)
-    {
-    delete m_Heap;
-    m_Heap = NULL;
-    }
-  if (m_HeapNodes != NULL)
-    {
-    delete[]m_HeapNodes;
-    m_HeapNodes = NULL;
-    }
+  m_Queue.Release();
+  std::vector<unsigned char>().swap(m_SeedMask);
   m_bSegInitialized = false;
   m_DistanceVolume->Initialize();
-  m_DistanceVolumePre->Initialize();
   m_ResultLabelVolume->Initialize();
-  m_ResultLabelVolumePre->Initialize();
 }
 
 //-----------------------------------------------------------------------------
 template<typename IntensityPixelType, typename LabelPixelType>
 bool vtkImageGrowCutSegment::vtkInternal::InitializationAHP(vtkImageData *intensityVolume, vtkImageData *seedLabelVolume)
 {
-  m_Heap = new FibHeap;
   long dimXYZ = m_DimX * m_DimY * m_DimZ;
-  if ((m_HeapNodes = new HeapNode[dimXYZ + 1]) == NULL)
+  LabelPixelType* seedLabelVolumePtr = static_cast<LabelPixelType*>(seedLabelVolume->GetScalarPointer());
+
+  if (m_bSegInitialized)
     {
-    vtkGenericWarningMacro("Memory allocation failed. Dimensions: " << m_DimX << "x" << m_DimY << "x" << m_DimZ);
-    return false;
+    // Previous distances can only be reused if seeds were added.
+    // Removing a seed or changing its label may change the result anywhere
+    // in the region that was grown from it, so then we start from scratch.
+    LabelPixelType* resultLabelVolumePtr = static_cast<LabelPixelType*>(m_ResultLabelVolume->GetScalarPointer());
+    for (long index = 0; index < dimXYZ; index++)
+      {
+      if (m_SeedMask[index] && seedLabelVolumePtr[index] != resultLabelVolumePtr[index])
+        {
+        m_bSegInitialized = false;
+        break;
+        }
+      }
     }
-  IntensityPixelType* imSrc = static_cast<IntensityPixelType*>(intensityVolume->GetScalarPointer());
-  LabelPixelType* seedLabelVolumePtr = static_cast<LabelPixelType*>(seedLabelVolume->GetScalarPointer());
 
   if (!m_bSegInitialized)
     {
@@ -174,10 +252,6 @@ bool vtkImageGrowCutSegment::vtkInternal::InitializationAHP(vtkImageData *intens
     m_DistanceVolume->SetSpacing(seedLabelVolume->GetSpacing());
     m_DistanceVolume->SetExtent(seedLabelVolume->GetExtent());
     m_DistanceVolume->AllocateScalars(DistancePixelTypeID, 1);
-    m_ResultLabelVolumePre->SetExtent(0, -1, 0, -1, 0, -1);
-    m_ResultLabelVolumePre->AllocateScalars(seedLabelVolume->GetScalarType(), 1);
-    m_DistanceVolumePre->SetExtent(0, -1, 0, -1, 0, -1);
-    m_DistanceVolumePre->AllocateScalars(DistancePixelTypeID, 1);
     LabelPixelType* resultLabelVolumePtr = static_cast<LabelPixelType*>(m_ResultLabelVolume->GetScalarPointer());
     DistancePixelType* distanceVolumePtr = static_cast<DistancePixelType*>(m_DistanceVolume->GetScalarPointer());
 
@@ -226,53 +300,44 @@ bool vtkImageGrowCutSegment::vtkInternal::InitializationAHP(vtkImageData *intens
         }
       }
 
+    // The distance between neighbors is the absolute intensity difference,
+    // therefore it is bounded by the intensity range
+    double* intensityRange = intensityVolume->GetScalarRange();
+    m_Queue.Initialize(dimXYZ, intensityRange[1] - intensityRange[0]);
+    m_SeedMask.resize(dimXYZ);
+
     for (long index = 0; index < dimXYZ; index++)
       {
       LabelPixelType seedValue = seedLabelVolumePtr[index];
       resultLabelVolumePtr[index] = seedValue;
       if (seedValue == 0)
         {
-        m_HeapNodes[index] = DIST_INF;
+        m_SeedMask[index] = 0;
         distanceVolumePtr[index] = DIST_INF;
         }
       else
         {
-        m_HeapNodes[index] = DIST_EPSILON;
+        m_SeedMask[index] = 1;
         distanceVolumePtr[index] = DIST_EPSILON;
+        m_Queue.Push(index, DIST_EPSILON);
         }
-      m_Heap->Insert(&m_HeapNodes[index]);
-      m_HeapNodes[index].SetIndexValue(index);
       }
     }
   else
     {
-    // Already initialized
+    // Already initialized: only grow from new seeds, all other voxels keep
+    // their distance and label from the previous run
     LabelPixelType* resultLabelVolumePtr = static_cast<LabelPixelType*>(m_ResultLabelVolume->GetScalarPointer());
-    LabelPixelType* resultLabelVolumePrePtr = static_cast<LabelPixelType*>(m_ResultLabelVolumePre->GetScalarPointer());
     DistancePixelType* distanceVolumePtr = static_cast<DistancePixelType*>(m_DistanceVolume->GetScalarPointer());
-    DistancePixelType* distanceVolumePrePtr = static_cast<DistancePixelType*>(m_DistanceVolumePre->GetScalarPointer());
-
     for (long index = 0; index < dimXYZ; index++)
       {
-      if (seedLabelVolumePtr[index] != 0)
-        {
-        // Only grow from new/changed seeds
-        if (resultLabelVolumePtr[index] != seedLabelVolumePtr[index])
-          {
-          m_HeapNodes[index] = DIST_EPSILON;
-          distanceVolumePtr[index] = DIST_EPSILON;
-          resultLabelVolumePtr[index] = seedLabelVolumePtr[index];
-          m_Heap->Insert(&m_HeapNodes[index]);
-          m_HeapNodes[index].SetIndexValue(index);
-          }
-        }
-      else
+      LabelPixelType seedValue = seedLabelVolumePtr[index];
+      if (seedValue != 0 && !m_SeedMask[index])
         {
-        m_HeapNodes[index] = DIST_INF;
-        distanceVolumePtr[index] = DIST_INF;
-        resultLabelVolumePtr[index] = 0;
-        m_Heap->Insert(&m_HeapNodes[index]);
-        m_HeapNodes[index].SetIndexValue(index);
+        m_SeedMask[index] = 1;
+        distanceVolumePtr[index] = DIST_EPSILON;
+        resultLabelVolumePtr[index] = seedValue;
+        m_Queue.Push(index, DIST_EPSILON);
         }
       }
     }
@@ -281,133 +346,44 @@ bool vtkImageGrowCutSegment::vtkInternal::InitializationAHP(vtkImageData *intens
 
 //-----------------------------------------------------------------------------
 template<typename IntensityPixelType, typename LabelPixelType>
-void vtkImageGrowCutSegment::vtkInternal::DijkstraBasedClassificationAHP(vtkImageData *intensityVolume, vtkImageData *seedLabelVolume)
+void vtkImageGrowCutSegment::vtkInternal::DijkstraBasedClassificationAHP(vtkImageData *intensityVolume, vtkImageData *vtkNotUsed(seedLabelVolume))
 {
   LabelPixelType* resultLabelVolumePtr = static_cast<LabelPixelType*>(m_ResultLabelVolume->GetScalarPointer());
+  DistancePixelType* distanceVolumePtr = static_cast<DistancePixelType*>(m_DistanceVolume->GetScalarPointer());
   IntensityPixelType* imSrc = static_cast<IntensityPixelType*>(intensityVolume->GetScalarPointer());
 
-  // Insert 0 then extract it, which will balance heap
-  HeapNode hnZero;
-  m_Heap->Insert(&hnZero);
-  m_Heap->ExtractMin();
-
-  if (!m_bSegInitialized)
+  // The queue only contains the seeds that are new since the previous run
+  // (or all seeds on the first run). Propagation stops at voxels that
+  // are already closer to another seed.
+  // Voxels at equal distance from seeds of different labels get the lowest
+  // label, so the result does not depend on the order voxels are processed in
+  // and growing from added seeds gives the same result as starting from scratch.
+  while (!m_Queue.IsEmpty())
     {
-    // Full computation
-    DistancePixelType* distanceVolumePtr = static_cast<DistancePixelType*>(m_DistanceVolume->GetScalarPointer());
-    LabelPixelType* resultLabelVolumePtr = static_cast<LabelPixelType*>(m_ResultLabelVolume->GetScalarPointer());
-
-    // Normal Dijkstra (to be used in initializing the segmenter for the current image)
-    HeapNode hnTmp;
-    while (!m_Heap->IsEmpty())
+    long index = m_Queue.Pop();
+    DistancePixelType currentDistance = distanceVolumePtr[index];
+    LabelPixelType currentLabel = resultLabelVolumePtr[index];
+
+    // Update neighbors
+    DistancePixelType pixCenter = imSrc[index];
+    unsigned char nbSize = m_NumberOfNeighbors[index];
+    for (unsigned char i = 0; i < nbSize; i++)
       {
-      HeapNode* hnMin = (HeapNode *)m_Heap->ExtractMin();
-      long index = hnMin->GetIndexValue();
-      DistancePixelType currentDistance = hnMin->GetKeyValue();
-      LabelPixelType currentLabel = resultLabelVolumePtr[index];
-      distanceVolumePtr[index] = currentDistance;
-
-      // Update neighbors
-      DistancePixelType pixCenter = imSrc[index];
-      unsigned char nbSize = m_NumberOfNeighbors[index];
-      for (unsigned char i = 0; i < nbSize; i++)
+      long indexNgbh = index + m_NeighborIndexOffsets[i];
+      DistancePixelType neighborCurrentDistance = distanceVolumePtr[indexNgbh];
+      DistancePixelType neighborNewDistance = fabs(pixCenter - imSrc[indexNgbh]) + currentDistance;
+      if (neighborCurrentDistance > neighborNewDistance
+        || (neighborCurrentDistance == neighborNewDistance && currentLabel < resultLabelVolumePtr[indexNgbh]
+            && !m_SeedMask[indexNgbh]))
         {
-        long indexNgbh = index + m_NeighborIndexOffsets[i];
-        DistancePixelType neighborCurrentDistance = distanceVolumePtr[indexNgbh];
-        DistancePixelType neighborNewDistance = fabs(pixCenter - imSrc[indexNgbh]) + currentDistance;
-        if (neighborCurrentDistance > neighborNewDistance)
-          {
-          distanceVolumePtr[indexNgbh] = neighborNewDistance;
-          resultLabelVolumePtr[indexNgbh] = currentLabel;
-
-          hnTmp = m_HeapNodes[indexNgbh];
-          hnTmp.SetKeyValue(neighborNewDistance);
-          m_Heap->DecreaseKey(&m_HeapNodes[indexNgbh], hnTmp);
-          }
+        distanceVolumePtr[indexNgbh] = neighborNewDistance;
+        resultLabelVolumePtr[indexNgbh] = currentLabel;
+        m_Queue.Update(indexNgbh, neighborCurrentDistance, neighborNewDistance);
         }
       }
     }
-  else
-    {
-    // Quick update
-
-    LabelPixelType* resultLabelVolumePrePtr = static_cast<LabelPixelType*>(m_ResultLabelVolumePre->GetScalarPointer());
 
-    // Adaptive Dijkstra
-    HeapNode hnTmp;
-    long dimXYZ = m_DimX * m_DimY * m_DimZ;
-    while (!m_Heap->IsEmpty())
-      {
-      DistancePixelType* distanceVolumePrePtr = static_cast<DistancePixelType*>(m_DistanceVolumePre->GetScalarPointer());
-      DistancePixelType* distanceVolumePtr = static_cast<DistancePixelType*>(m_DistanceVolume->GetScalarPointer());
-
-      HeapNode* hnMin = (HeapNode *)m_Heap->ExtractMin();
-      DistancePixelType currentDistance = hnMin->GetKeyValue();
-
-      // Stop of minimum value is infinite
-      if (currentDistance == DIST_INF)
-        {
-        for (long index = 0; index < dimXYZ; index++)
-          {
-          if (resultLabelVolumePtr[index] == 0)
-            {
-            resultLabelVolumePtr[index] = resultLabelVolumePrePtr[index];
-            distanceVolumePtr[index] = distanceVolumePrePtr[index];
-            }
-          }
-        break;
-        }
-
-      // Stop propagation when the new distance is larger than the previous one
-      long index = hnMin->GetIndexValue();
-      if (currentDistance > distanceVolumePrePtr[index])
-        {
-        distanceVolumePtr[index] = distanceVolumePrePtr[index];
-        resultLabelVolumePtr[index] = resultLabelVolumePrePtr[index];
-        continue;
-        }
-
-      LabelPixelType currentLabel = resultLabelVolumePtr[index];
-      distanceVolumePtr[index] = currentDistance;
-
-      // Update neighbors
-      DistancePixelType pixCenter = imSrc[index];
-      unsigned char nbSize = m_NumberOfNeighbors[index];
-      for (unsigned char i = 0; i < nbSize; i++)
-        {
-        long indexNgbh = index + m_NeighborIndexOffsets[i];
-        DistancePixelType neighborCurrentDistance = distanceVolumePtr[indexNgbh];
-        DistancePixelType neighborNewDistance = fabs(pixCenter - imSrc[indexNgbh]) + currentDistance;
-        if (neighborCurrentDistance > neighborNewDistance)
-          {
-          distanceVolumePtr[indexNgbh] = neighborNewDistance;
-          resultLabelVolumePtr[indexNgbh] = currentLabel;
-
-          hnTmp = m_HeapNodes[indexNgbh];
-          hnTmp.SetKeyValue(neighborNewDistance);
-          m_Heap->DecreaseKey(&m_HeapNodes[indexNgbh], hnTmp);
-          }
-        }
-      }
-    }
-
-  // Update previous labels and distance information
-  m_ResultLabelVolumePre->DeepCopy(m_ResultLabelVolume);
-  m_DistanceVolumePre->DeepCopy(m_DistanceVolume);
   m_bSegInitialized = true;
-
-  // Release memory
-  if (m_Heap != NULL)
-    {
-    delete m_Heap;
-    m_Heap = NULL;
-    }
-  //m_HeapNodes.clear();
-  if (m_HeapNodes != NULL)
-    {
-    delete[] m_HeapNodes;
-    m_HeapNodes = NULL;
-    }
 }
 
 //-----------------------------------------------------------------------------
@@ -558,5 +534,5 @@ void vtkImageGrowCutSegment::Reset()
 
 void vtkImageGrowCutSegment::PrintSelf(ostream &os, vtkIndent indent)
 {
-  std::cout << "This function has been found" << std::endl;
+  this->Superclass::PrintSelf(os, indent);
 }
@@ -20,7 +20,11 @@ public:
   void SetSeedLabelVolume(vtkImageData* labelImage) { this->SetInputData(1, labelImage); }
 
   // Reset to initial state. This forces full recomputation of the result label volume.
-  // This method has to be called if intensity volume changes or if seeds are deleted after initial computation.
+  // This method has to be called if intensity volume changes after initial computation.
+  // If seeds are only added between updates then the result is updated by growing
+  // only from the new seeds. If seeds are removed or their label is changed
+  // then the result is recomputed from scratch automatically.
+  // Voxels at equal distance from seeds of different labels get the lowest label.
   void Reset();
 
 protected:
@@ -685,9 +685,14 @@ bool vtkSlicerSegmentationsModuleLogic::ExportSegmentToRepresentationNode(vtkSeg
       return false;
       }
 
-    // Export binary labelmap representation into labelmap volume node
-    vtkOrientedImageData* orientedImageData = vtkOrientedImageData::SafeDownCast(
-      segment->GetRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()) );
+    // Export binary labelmap representation into labelmap volume node. If the labelmap
+    // is shared with other segments then only the voxels of this segment are exported.
+    vtkSmartPointer<vtkOrientedImageData> orientedImageData = vtkSmartPointer<vtkOrientedImageData>::New();
+    if (!segmentationNode->GetSegmentation()->GetBinaryLabelmapRepresentation(segmentId, orientedImageData))
+      {
+      vtkErrorWithObjectMacro(representationNode, "ExportSegmentToRepresentationNode: Unable to get binary labelmap representation of segment " << segmentId);
+      return false;
+      }
     bool success = vtkSlicerSegmentationsModuleLogic::CreateLabelmapVolumeFromOrientedImageData(orientedImageData, labelmapNode);
     if (!success)
       {
@@ -1264,8 +1269,17 @@ bool vtkSlicerSegmentationsModuleLogic::GetSegmentRepresentation(vtkMRMLSegmenta
   if (segmentationNode->GetSegmentation()->ContainsRepresentation(representationName))
     {
     // Get and copy representation into output data object
-    vtkDataObject* representationObject = segment->GetRepresentation(representationName);
-    if (!representationObject)
+    vtkSmartPointer<vtkDataObject> representationObject = segment->GetRepresentation(representationName);
+    if (representationObject.GetPointer()
+      && representationName == vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()
+      && segmentationNode->GetSegmentation()->IsSharedBinaryLabelmap(segmentID))
+      {
+      // Only the voxels of this segment are copied from the shared labelmap
+      vtkSmartPointer<vtkOrientedImageData> segmentLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+      segmentationNode->GetSegmentation()->GetBinaryLabelmapRepresentation(segmentID, segmentLabelmap);
+      representationObject = segmentLabelmap;
+      }
+    if (!representationObject.GetPointer())
       {
       vtkErrorWithObjectMacro(segmentationNode, "vtkSlicerSegmentationsModuleLogic::GetSegmentRepresentation: Unable to get '" << representationName << "' representation from segment with ID " << segmentID << " in segmentation " << segmentationNode->GetName());
       return false;
@@ -1350,6 +1364,8 @@ bool vtkSlicerSegmentationsModuleLogic::SetBinaryLabelmapToSegment(vtkOrientedIm
     vtkGenericWarningMacro("vtkSlicerSegmentationsModuleLogic::SetBinaryLabelmapToSegment: Invalid selected segment");
     return false;
     }
+  // Edited segment cannot share its labelmap with other segments, as the whole labelmap may be replaced
+  segmentationNode->GetSegmentation()->SeparateSegmentLabelmap(segmentID);
   vtkOrientedImageData* segmentLabelmap = vtkOrientedImageData::SafeDownCast(
     selectedSegment->GetRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()) );
   if (!segmentLabelmap)
@@ -1440,7 +1456,10 @@ bool vtkSlicerSegmentationsModuleLogic::SetBinaryLabelmapToSegment(vtkOrientedIm
     padder->Update();
     segmentLabelmap->DeepCopy(padder->GetOutput());
     }
-  // 4. Re-convert all other representations
+  // 4. Re-convert all other representations.
+  //    Voxels outside the extent are only preserved when merging, so only then can the
+  //    representations be updated in the modified region.
+  const int* modifiedExtent = (mergeMode != MODE_REPLACE ? extent : NULL);
   std::vector<std::string> representationNames;
   selectedSegment->GetContainedRepresentationNames(representationNames);
   bool conversionHappened = false;
@@ -1451,7 +1470,7 @@ bool vtkSlicerSegmentationsModuleLogic::SetBinaryLabelmapToSegment(vtkOrientedIm
     if (targetRepresentationName.compare(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()))
       {
       conversionHappened |= segmentationNode->GetSegmentation()->ConvertSingleSegment(
-        segmentID, targetRepresentationName );
+        segmentID, targetRepresentationName, modifiedExtent );
       }
     }
 
@@ -912,17 +912,31 @@ void vtkMRMLSegmentationsDisplayableManager2D::vtkInternal::UpdateDisplayNodePip
       int sliceOutputExtent[6] = { 0, dimensions[0] - 1, 0, dimensions[1] - 1, 0, dimensions[2] - 1 };
       pipeline->Reslice->SetOutputExtent(sliceOutputExtent);
 
+      // If the labelmap is shared with other segments then only show the voxels of this segment
+      bool sharedLabelmap = (shownRepresenatationName == vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()
+        && segmentation->IsSharedBinaryLabelmap(pipelineIt->first));
+
       // If ThresholdValue is not specified, then do not perform thresholding
       vtkDoubleArray* thresholdValue = vtkDoubleArray::SafeDownCast(
         imageData->GetFieldData()->GetAbstractArray(vtkSegmentationConverter::GetThresholdValueFieldName()));
-      if (thresholdValue && thresholdValue->GetNumberOfValues() == 1)
+      bool thresholdValueSpecified = (thresholdValue && thresholdValue->GetNumberOfValues() == 1);
+      if (sharedLabelmap)
+        {
+        int labelValue = segmentation->GetSegment(pipelineIt->first)->GetLabelValue();
+        pipeline->ImageThreshold->ThresholdBetween(labelValue, labelValue);
+        pipeline->ImageThreshold->SetInValue(1);
+        pipeline->ImageThreshold->SetOutValue(0);
+        }
+      else if (thresholdValueSpecified)
         {
         pipeline->ImageThreshold->ThresholdByLower(thresholdValue->GetValue(0));
+        pipeline->ImageThreshold->SetInValue(0);
+        pipeline->ImageThreshold->SetOutValue(1);
         }
 
       // Smooth the border of fractional labelmaps
       pipeline->ImageFillActor->GetMapper()->GetInputAlgorithm()->SetInputConnection(pipeline->Reslice->GetOutputPort());
-      if (this->SmoothFractionalLabelMapBorder && thresholdValue && thresholdValue->GetNumberOfValues() == 1)
+      if (sharedLabelmap || (this->SmoothFractionalLabelMapBorder && thresholdValueSpecified))
         {
           pipeline->ImageFillActor->GetMapper()->GetInputAlgorithm()->SetInputConnection(pipeline->ImageThreshold->GetOutputPort());
         }
@@ -933,7 +947,7 @@ void vtkMRMLSegmentationsDisplayableManager2D::vtkInternal::UpdateDisplayNodePip
         pipeline->LabelOutline->SetInputConnection(pipeline->Reslice->GetOutputPort());
 
         // Set the outline threshold from the ThresholdValue field if it exists
-        if (thresholdValue && thresholdValue->GetNumberOfValues() == 1)
+        if (sharedLabelmap || thresholdValueSpecified)
           {
           pipeline->LabelOutline->SetInputConnection(pipeline->ImageThreshold->GetOutputPort());
           }
@@ -1382,6 +1396,12 @@ std::string vtkMRMLSegmentationsDisplayableManager2D::GetDataProbeInfoStringForP
           }
         double voxelValue = imageData->GetScalarComponentAsDouble(
           ijk[0], ijk[1], ijk[2], 0);
+        if (shownRepresenatationName == vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()
+          && segmentation->IsSharedBinaryLabelmap(pipelineIt->first))
+          {
+          // Only voxels with the label value of the segment belong to the segment in a shared labelmap
+          voxelValue = (voxelValue == segmentation->GetSegment(pipelineIt->first)->GetLabelValue() ? 1.0 : 0.0);
+          }
 
         vtkDoubleArray* scalarRange = vtkDoubleArray::SafeDownCast(
           imageData->GetFieldData()->GetAbstractArray(vtkSegmentationConverter::GetScalarRangeFieldName()));
@@ -28,6 +28,7 @@ class SegmentationsModuleTest1(unittest.TestCase):
     self.TestSection_1_AddRemoveSegment()
     self.TestSection_2_MergeLabelmapWithDifferentGeometries()
     self.TestSection_3_ImportExportSegment()
+    self.TestSection_4_ExportSharedLabelmapSegment()
 
     logging.info('Test finished')
 
@@ -404,3 +405,60 @@ class SegmentationsModuleTest1(unittest.TestCase):
     slicer.mrmlScene.RemoveNode(bodyModelNodeTransformed)
     slicer.mrmlScene.RemoveNode(bodyLabelmapNodeTransformed)
     slicer.mrmlScene.RemoveNode(modelTransformedImportSegmentationNode)
+
+  #------------------------------------------------------------------------------
+  def TestSection_4_ExportSharedLabelmapSegment(self):
+    # Export a single segment of a shared labelmap layer
+    logging.info('Test section 4: Export segment of shared labelmap')
+
+    sharedSegmentationNode = slicer.vtkMRMLSegmentationNode()
+    sharedSegmentationNode.SetName('SharedLabelmap')
+    slicer.mrmlScene.AddNode(sharedSegmentationNode)
+    sharedSegmentation = sharedSegmentationNode.GetSegmentation()
+    sharedSegmentation.SetMasterRepresentationName(self.binaryLabelmapReprName)
+
+    # Add two non-overlapping box segments of different size
+    boxes = [[2,4,2,6,2,6], [8,12,2,6,2,6]]
+    for segmentIndex, box in enumerate(boxes):
+      labelmap = vtkSegmentationCore.vtkOrientedImageData()
+      labelmap.SetExtent(0,15,0,15,0,15)
+      labelmap.AllocateScalars(vtk.VTK_UNSIGNED_CHAR, 1)
+      labelmap.GetPointData().GetScalars().Fill(0)
+      for z in range(box[4], box[5]+1):
+        for y in range(box[2], box[3]+1):
+          for x in range(box[0], box[1]+1):
+            labelmap.SetScalarComponentFromDouble(x, y, z, 0, 1)
+      segment = vtkSegmentationCore.vtkSegment()
+      segment.SetName('Box{0}'.format(segmentIndex))
+      segment.AddRepresentation(self.binaryLabelmapReprName, labelmap)
+      sharedSegmentation.AddSegment(segment, 'Box{0}'.format(segmentIndex))
+
+    self.assertTrue(sharedSegmentation.CollapseBinaryLabelmaps())
+    self.assertTrue(sharedSegmentation.IsSharedBinaryLabelmap('Box1'))
+    self.assertEqual(sharedSegmentation.GetNumberOfLayers(), 1)
+
+    # Only the voxels of the exported segment must be in the labelmap volume
+    boxLabelmapNode = slicer.vtkMRMLLabelMapVolumeNode()
+    boxLabelmapNode.SetName('Box1Labelmap')
+    slicer.mrmlScene.AddNode(boxLabelmapNode)
+    result = slicer.vtkSlicerSegmentationsModuleLogic.ExportSegmentToRepresentationNode(
+      sharedSegmentation.GetSegment('Box1'), boxLabelmapNode)
+    self.assertTrue(result)
+    imageStat = vtk.vtkImageAccumulate()
+    imageStat.SetInputData(boxLabelmapNode.GetImageData())
+    imageStat.SetComponentExtent(0,2,0,0,0,0)
+    imageStat.SetComponentOrigin(0,0,0)
+    imageStat.SetComponentSpacing(1,1,1)
+    imageStat.Update()
+    self.assertEqual(imageStat.GetMax()[0], 1)
+    self.assertEqual(imageStat.GetOutput().GetScalarComponentAsDouble(1,0,0,0), 5*5*5)
+
+    # Segment statistics must measure each segment separately
+    import SegmentStatistics
+    statisticsLogic = SegmentStatistics.SegmentStatisticsLogic()
+    statisticsLogic.computeStatistics(sharedSegmentationNode, None, False)
+    self.assertEqual(statisticsLogic.statistics['Box0','LM voxel count'], 3*5*5)
+    self.assertEqual(statisticsLogic.statistics['Box1','LM voxel count'], 5*5*5)
+
+    slicer.mrmlScene.RemoveNode(boxLabelmapNode)
+    slicer.mrmlScene.RemoveNode(sharedSegmentationNode)
@@ -534,9 +534,9 @@ bool qMRMLSegmentEditorWidgetPrivate::updateSelectedSegmentLabelmap()
     qWarning() << Q_FUNC_INFO << " failed: Segment " << selectedSegmentID << " not found in segmentation";
     return false;
     }
-  vtkOrientedImageData* segmentLabelmap = vtkOrientedImageData::SafeDownCast(
-    selectedSegment->GetRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()));
-  if (!segmentLabelmap)
+  // If the labelmap is shared with other segments then only the voxels of the selected segment are used
+  vtkNew<vtkOrientedImageData> segmentLabelmap;
+  if (!segmentationNode->GetSegmentation()->GetBinaryLabelmapRepresentation(selectedSegmentID, segmentLabelmap.GetPointer()))
     {
     qCritical() << Q_FUNC_INFO << ": Failed to get binary labelmap representation in segmentation " << segmentationNode->GetName();
     return false;
@@ -552,7 +552,7 @@ bool qMRMLSegmentEditorWidgetPrivate::updateSelectedSegmentLabelmap()
   vtkNew<vtkOrientedImageData> referenceImage;
   vtkNew<vtkMatrix4x4> referenceImageToWorld;
   vtkSegmentationConverter::DeserializeImageGeometry(referenceImageGeometry, referenceImage.GetPointer(), false);
-  vtkOrientedImageDataResample::ResampleOrientedImageToReferenceOrientedImage(segmentLabelmap, referenceImage.GetPointer(), this->SelectedSegmentLabelmap, /*linearInterpolation=*/false);
+  vtkOrientedImageDataResample::ResampleOrientedImageToReferenceOrientedImage(segmentLabelmap.GetPointer(), referenceImage.GetPointer(), this->SelectedSegmentLabelmap, /*linearInterpolation=*/false);
 
   return true;
 }
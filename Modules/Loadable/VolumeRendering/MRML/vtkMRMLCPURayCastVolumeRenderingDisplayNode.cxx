@@ -34,6 +34,7 @@ vtkMRMLNodeNewMacro(vtkMRMLCPURayCastVolumeRenderingDisplayNode);
 vtkMRMLCPURayCastVolumeRenderingDisplayNode::vtkMRMLCPURayCastVolumeRenderingDisplayNode()
 {
   this->RaycastTechnique = vtkMRMLCPURayCastVolumeRenderingDisplayNode::Composite;
+  this->SkipTransparentBlocks = 1;
 }
 
 //----------------------------------------------------------------------------
@@ -59,6 +60,13 @@ void vtkMRMLCPURayCastVolumeRenderingDisplayNode::ReadXMLAttributes(const char**
       ss >> this->RaycastTechnique;
       continue;
       }
+    if (!strcmp(attName,"skipTransparentBlocks"))
+      {
+      std::stringstream ss;
+      ss << attValue;
+      ss >> this->SkipTransparentBlocks;
+      continue;
+      }
     }
 }
 
@@ -70,6 +78,7 @@ void vtkMRMLCPURayCastVolumeRenderingDisplayNode::WriteXML(ostream& of, int nInd
   vtkIndent indent(nIndent);
 
   of << indent << " raycastTechnique=\"" << this->RaycastTechnique << "\"";
+  of << indent << " skipTransparentBlocks=\"" << this->SkipTransparentBlocks << "\"";
 }
 
 //----------------------------------------------------------------------------
@@ -80,6 +89,7 @@ void vtkMRMLCPURayCastVolumeRenderingDisplayNode::Copy(vtkMRMLNode *anode)
   vtkMRMLCPURayCastVolumeRenderingDisplayNode *node = vtkMRMLCPURayCastVolumeRenderingDisplayNode::SafeDownCast(anode);
 
   this->SetRaycastTechnique(node->GetRaycastTechnique());
+  this->SetSkipTransparentBlocks(node->GetSkipTransparentBlocks());
 
   this->EndModify(wasModifying);
 }
@@ -90,4 +100,5 @@ void vtkMRMLCPURayCastVolumeRenderingDisplayNode::PrintSelf(ostream& os, vtkInde
   this->Superclass::PrintSelf(os,indent);
 
   os << "RaycastTechnique: " << this->RaycastTechnique << "\n";
+  os << "SkipTransparentBlocks: " << this->SkipTransparentBlocks << "\n";
 }
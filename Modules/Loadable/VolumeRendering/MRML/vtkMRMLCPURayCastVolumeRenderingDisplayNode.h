@@ -56,6 +56,13 @@ public:
   vtkGetMacro (RaycastTechnique, int);
   vtkSetMacro (RaycastTechnique, int);
 
+  // Description:
+  // Leap over the fully transparent regions of the volume instead of
+  // sampling them. It does not change the rendered image. On by default.
+  vtkGetMacro (SkipTransparentBlocks, int);
+  vtkSetMacro (SkipTransparentBlocks, int);
+  vtkBooleanMacro (SkipTransparentBlocks, int);
+
 protected:
   vtkMRMLCPURayCastVolumeRenderingDisplayNode();
   ~vtkMRMLCPURayCastVolumeRenderingDisplayNode();
@@ -71,6 +78,8 @@ protected:
    * 5: Illustrative Context Preserving Exploration
    * */
   int RaycastTechnique;
+
+  int SkipTransparentBlocks;
 };
 
 #endif
@@ -97,10 +97,14 @@ public:
   vtkGetMacro(ExpectedFPS,double);
 
   /// Quality used for PerformanceControl
+  /// Progressive renders a coarse image while interacting and refines it
+  /// in successive passes once the view stops changing. It is only
+  /// implemented by CPU ray casting, other rendering methods use Adaptative.
   enum Quality
   {
     Adaptative = 0,
-    MaximumQuality
+    MaximumQuality,
+    Progressive
   };
   vtkSetMacro(PerformanceControl,int);
   vtkGetMacro(PerformanceControl,int);
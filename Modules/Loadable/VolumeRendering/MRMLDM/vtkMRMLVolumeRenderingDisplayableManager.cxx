@@ -45,7 +45,7 @@
 // VTK includes
 #include <vtkAbstractTransform.h>
 #include <vtkCallbackCommand.h>
-#include "vtkFixedPointVolumeRayCastMapper.h"
+#include <vtkCamera.h>
 #include "vtkGPUVolumeRayCastMapper.h"
 #include "vtkImageData.h"
 #include "vtkInteractorStyle.h"
@@ -60,6 +60,7 @@
 #include "vtkRenderWindow.h"
 #include "vtkRenderWindowInteractor.h"
 #include "vtkRenderer.h"
+#include <vtkTransform.h>
 #include "vtkVolume.h"
 #include "vtkVolumeProperty.h"
 #include <vtkVersion.h>
@@ -80,6 +81,18 @@ vtkStandardNewMacro (vtkMRMLVolumeRenderingDisplayableManager);
 bool vtkMRMLVolumeRenderingDisplayableManager::First = true;
 int vtkMRMLVolumeRenderingDisplayableManager::DefaultGPUMemorySize = 256;
 
+namespace
+{
+// Progressive rendering passes, from the coarse interactive image to the
+// full quality image: distance between rays in pixels, and multiple of
+// the sample distance along the rays.
+const double ProgressiveImageSampleDistances[] = {4., 2., 1.};
+const double ProgressiveSampleDistanceFactors[] = {4., 2., 1.};
+const int NumberOfProgressivePasses = 3;
+// Delay between two passes, in ms, to let the user interact in between
+const unsigned long ProgressiveTimerDuration = 100;
+}
+
 //---------------------------------------------------------------------------
 vtkMRMLVolumeRenderingDisplayableManager::vtkMRMLVolumeRenderingDisplayableManager()
 {
@@ -109,6 +122,15 @@ vtkMRMLVolumeRenderingDisplayableManager::vtkMRMLVolumeRenderingDisplayableManag
   // 0fps is a special value that means it hasn't been set.
   this->OriginalDesiredUpdateRate = 0.;
 
+  this->ProgressivePass = 0;
+  this->ProgressiveTimerId = 0;
+  this->ProgressiveRenderingMTime = 0;
+  this->ProgressiveRenderAborted = false;
+  this->ProgressiveCallbackCommand = vtkCallbackCommand::New();
+  this->ProgressiveCallbackCommand->SetClientData(this);
+  this->ProgressiveCallbackCommand->SetCallback(
+    vtkMRMLVolumeRenderingDisplayableManager::ProgressiveRenderingCallback);
+
   this->RemoveInteractorStyleObservableEvent(vtkCommand::LeftButtonPressEvent);
   this->RemoveInteractorStyleObservableEvent(vtkCommand::LeftButtonReleaseEvent);
   this->RemoveInteractorStyleObservableEvent(vtkCommand::RightButtonPressEvent);
@@ -126,6 +148,10 @@ vtkMRMLVolumeRenderingDisplayableManager::vtkMRMLVolumeRenderingDisplayableManag
 //---------------------------------------------------------------------------
 vtkMRMLVolumeRenderingDisplayableManager::~vtkMRMLVolumeRenderingDisplayableManager()
 {
+  this->StopProgressiveRefinement();
+  this->RemoveProgressiveRenderObservers();
+  this->ProgressiveCallbackCommand->Delete();
+
   this->RemoveDisplayNodes();
 
   if (this->VolumeRenderingLogic)
@@ -203,7 +229,7 @@ void vtkMRMLVolumeRenderingDisplayableManager::Reset()
   //mapperEventsWithProgress->InsertNextValue(vtkCommand::ProgressEvent);
 
   // CPU mapper
-  vtkNew<vtkFixedPointVolumeRayCastMapper> newMapperRaycast;
+  vtkNew<vtkSlicerFixedPointVolumeRayCastMapper> newMapperRaycast;
   vtkSetAndObserveMRMLNodeEventsMacro(this->MapperRaycast,
                                       newMapperRaycast.GetPointer(),
                                       mapperEventsWithProgress.GetPointer());
@@ -359,6 +385,249 @@ double vtkMRMLVolumeRenderingDisplayableManager
   return framerate;
 }
 
+//---------------------------------------------------------------------------
+bool vtkMRMLVolumeRenderingDisplayableManager
+::IsProgressiveRenderingEnabled(vtkMRMLVolumeRenderingDisplayNode* vspNode)
+{
+  return vspNode &&
+    vspNode->IsA("vtkMRMLCPURayCastVolumeRenderingDisplayNode") &&
+    vspNode->GetPerformanceControl() == vtkMRMLVolumeRenderingDisplayNode::Progressive;
+}
+
+//---------------------------------------------------------------------------
+int vtkMRMLVolumeRenderingDisplayableManager::GetNumberOfProgressivePasses()
+{
+  return NumberOfProgressivePasses;
+}
+
+//---------------------------------------------------------------------------
+unsigned long vtkMRMLVolumeRenderingDisplayableManager::GetProgressiveRenderingMTime()
+{
+  unsigned long mtime = 0;
+  // The view transform is not modified when the clipping range is reset
+  // at each render, contrary to the camera itself.
+  vtkRenderer* renderer = this->GetRenderer();
+  if (renderer && renderer->IsActiveCameraCreated())
+    {
+    mtime = renderer->GetActiveCamera()->GetViewTransformObject()->GetMTime();
+    }
+  vtkMRMLVolumePropertyNode* volumePropertyNode = this->DisplayedNode ?
+    this->DisplayedNode->GetVolumePropertyNode() : 0;
+  if (volumePropertyNode && volumePropertyNode->GetVolumeProperty())
+    {
+    mtime = std::max(mtime, volumePropertyNode->GetVolumeProperty()->GetMTime());
+    }
+  return mtime;
+}
+
+//---------------------------------------------------------------------------
+void vtkMRMLVolumeRenderingDisplayableManager::StartProgressiveRefinement()
+{
+  if (!this->IsProgressiveRenderingEnabled(this->DisplayedNode))
+    {
+    this->StopProgressiveRefinement();
+    this->RemoveProgressiveRenderObservers();
+    return;
+    }
+  bool restart = this->ProgressivePass != 0;
+  this->ProgressivePass = 0;
+  this->ProgressiveRenderAborted = false;
+  this->ProgressiveRenderingMTime = this->GetProgressiveRenderingMTime();
+  this->SetupMapperFromParametersNode(this->DisplayedNode);
+  this->AddProgressiveRenderObservers();
+  this->StartProgressiveTimer();
+  if (restart)
+    {
+    // Show the coarse pass right away instead of keeping a finer image
+    // that is out of date until the next render
+    this->RequestRender();
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkMRMLVolumeRenderingDisplayableManager::StopProgressiveRefinement()
+{
+  vtkRenderWindowInteractor* interactor = this->GetInteractor();
+  if (interactor)
+    {
+    if (this->ProgressiveTimerId != 0)
+      {
+      interactor->DestroyTimer(this->ProgressiveTimerId);
+      }
+    interactor->RemoveObservers(vtkCommand::TimerEvent, this->ProgressiveCallbackCommand);
+    }
+  this->ProgressiveTimerId = 0;
+}
+
+//---------------------------------------------------------------------------
+void vtkMRMLVolumeRenderingDisplayableManager::StartProgressiveTimer()
+{
+  vtkRenderWindowInteractor* interactor = this->GetInteractor();
+  if (interactor && this->ProgressiveTimerId == 0)
+    {
+    interactor->RemoveObservers(vtkCommand::TimerEvent, this->ProgressiveCallbackCommand);
+    interactor->AddObserver(vtkCommand::TimerEvent, this->ProgressiveCallbackCommand);
+    this->ProgressiveTimerId = interactor->CreateRepeatingTimer(ProgressiveTimerDuration);
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkMRMLVolumeRenderingDisplayableManager::AddProgressiveRenderObservers()
+{
+  // Observed while progressive rendering is enabled, even once the
+  // refinement is complete, to catch the camera changes that do not come
+  // from an interaction.
+  vtkRenderer* renderer = this->GetRenderer();
+  if (renderer && !renderer->HasObserver(vtkCommand::StartEvent, this->ProgressiveCallbackCommand))
+    {
+    renderer->AddObserver(vtkCommand::StartEvent, this->ProgressiveCallbackCommand);
+    }
+  vtkRenderWindow* renderWindow = renderer ? renderer->GetRenderWindow() : 0;
+  if (renderWindow && !renderWindow->HasObserver(vtkCommand::AbortCheckEvent, this->ProgressiveCallbackCommand))
+    {
+    renderWindow->AddObserver(vtkCommand::AbortCheckEvent, this->ProgressiveCallbackCommand);
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkMRMLVolumeRenderingDisplayableManager::RemoveProgressiveRenderObservers()
+{
+  vtkRenderer* renderer = this->GetRenderer();
+  if (renderer)
+    {
+    renderer->RemoveObservers(vtkCommand::StartEvent, this->ProgressiveCallbackCommand);
+    if (renderer->GetRenderWindow())
+      {
+      renderer->GetRenderWindow()->RemoveObservers(
+        vtkCommand::AbortCheckEvent, this->ProgressiveCallbackCommand);
+      }
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkMRMLVolumeRenderingDisplayableManager::OnProgressiveRenderStart()
+{
+  if (!this->IsProgressiveRenderingEnabled(this->DisplayedNode))
+    {
+    return;
+    }
+  unsigned long mtime = this->GetProgressiveRenderingMTime();
+  if (mtime == this->ProgressiveRenderingMTime)
+    {
+    return;
+    }
+  // The camera or the transfer functions have changed without any
+  // interaction (e.g. set by a script or by a linked view): render this
+  // frame coarsely and refine it from the timer.
+  this->ProgressiveRenderingMTime = mtime;
+  this->ProgressiveRenderAborted = false;
+  if (this->Interaction > 0)
+    {
+    // already coarse, the refinement starts when the interaction ends
+    return;
+    }
+  if (this->ProgressivePass != 0)
+    {
+    this->ProgressivePass = 0;
+    this->SetupMapperFromParametersNode(this->DisplayedNode);
+    }
+  this->StartProgressiveTimer();
+}
+
+//---------------------------------------------------------------------------
+void vtkMRMLVolumeRenderingDisplayableManager::OnProgressiveRenderAbortCheck()
+{
+  // The coarse pass is always completed, the refinement passes are
+  // interrupted as soon as the user does something.
+  vtkRenderWindow* renderWindow = this->GetRenderer() ? this->GetRenderer()->GetRenderWindow() : 0;
+  if (!renderWindow || this->ProgressivePass == 0 ||
+      !this->IsProgressiveRenderingEnabled(this->DisplayedNode))
+    {
+    return;
+    }
+  if (this->Interaction > 0 || renderWindow->GetEventPending())
+    {
+    renderWindow->SetAbortRender(1);
+    this->ProgressiveRenderAborted = true;
+    }
+}
+
+//---------------------------------------------------------------------------
+bool vtkMRMLVolumeRenderingDisplayableManager::RefineProgressiveRendering()
+{
+  if (!this->IsProgressiveRenderingEnabled(this->DisplayedNode) ||
+      this->Interaction > 0)
+    {
+    this->StopProgressiveRefinement();
+    return false;
+    }
+  unsigned long mtime = this->GetProgressiveRenderingMTime();
+  if (mtime != this->ProgressiveRenderingMTime)
+    {
+    // The camera or the transfer functions have changed: cancel the
+    // refinement and render the coarse pass until they settle.
+    this->ProgressiveRenderingMTime = mtime;
+    this->ProgressiveRenderAborted = false;
+    if (this->ProgressivePass != 0)
+      {
+      this->ProgressivePass = 0;
+      this->SetupMapperFromParametersNode(this->DisplayedNode);
+      this->RequestRender();
+      }
+    return true;
+    }
+  if (this->ProgressiveRenderAborted)
+    {
+    // The pass was interrupted by an event, render it again
+    this->ProgressiveRenderAborted = false;
+    this->RequestRender();
+    return true;
+    }
+  if (this->ProgressivePass >= NumberOfProgressivePasses - 1)
+    {
+    this->StopProgressiveRefinement();
+    return false;
+    }
+  ++this->ProgressivePass;
+  this->SetupMapperFromParametersNode(this->DisplayedNode);
+  this->RequestRender();
+  return true;
+}
+
+//---------------------------------------------------------------------------
+void vtkMRMLVolumeRenderingDisplayableManager
+::ProgressiveRenderingCallback(vtkObject* vtkNotUsed(caller),
+                               unsigned long eid,
+                               void* clientData, void* callData)
+{
+  vtkMRMLVolumeRenderingDisplayableManager* self =
+    reinterpret_cast<vtkMRMLVolumeRenderingDisplayableManager*>(clientData);
+  if (!self)
+    {
+    return;
+    }
+  switch (eid)
+    {
+    case vtkCommand::TimerEvent:
+      {
+      int* timerId = reinterpret_cast<int*>(callData);
+      if (timerId && *timerId == self->ProgressiveTimerId)
+        {
+        self->RefineProgressiveRendering();
+        }
+      break;
+      }
+    case vtkCommand::StartEvent:
+      self->OnProgressiveRenderStart();
+      break;
+    case vtkCommand::AbortCheckEvent:
+      self->OnProgressiveRenderAbortCheck();
+      break;
+    default:
+      break;
+    }
+}
+
 //---------------------------------------------------------------------------
 double vtkMRMLVolumeRenderingDisplayableManager
 ::GetSampleDistance(vtkMRMLVolumeRenderingDisplayNode* vspNode)
@@ -387,16 +656,31 @@ void vtkMRMLVolumeRenderingDisplayableManager
 //---------------------------------------------------------------------------
 void vtkMRMLVolumeRenderingDisplayableManager
 ::UpdateCPURaycastMapper(
-  vtkFixedPointVolumeRayCastMapper* mapper,
+  vtkSlicerFixedPointVolumeRayCastMapper* mapper,
   vtkMRMLCPURayCastVolumeRenderingDisplayNode* vspNode)
 {
   this->UpdateMapper(mapper, vspNode);
   const bool highDef = vspNode->GetPerformanceControl() ==
     vtkMRMLVolumeRenderingDisplayNode::MaximumQuality;
-  mapper->SetAutoAdjustSampleDistances( highDef ? 0 : 1);
-  mapper->SetSampleDistance(this->GetSampleDistance(vspNode));
-  mapper->SetInteractiveSampleDistance(this->GetSampleDistance(vspNode));
-  mapper->SetImageSampleDistance(highDef ? 0.5 : 1.);
+  if (this->IsProgressiveRenderingEnabled(vspNode))
+    {
+    // The resolution depends on the pass, not on the render time
+    const int pass = std::min(this->ProgressivePass, NumberOfProgressivePasses - 1);
+    const double sampleDistance =
+      this->GetSampleDistance(vspNode) * ProgressiveSampleDistanceFactors[pass];
+    mapper->SetAutoAdjustSampleDistances(0);
+    mapper->SetSampleDistance(sampleDistance);
+    mapper->SetInteractiveSampleDistance(sampleDistance);
+    mapper->SetImageSampleDistance(ProgressiveImageSampleDistances[pass]);
+    }
+  else
+    {
+    mapper->SetAutoAdjustSampleDistances( highDef ? 0 : 1);
+    mapper->SetSampleDistance(this->GetSampleDistance(vspNode));
+    mapper->SetInteractiveSampleDistance(this->GetSampleDistance(vspNode));
+    mapper->SetImageSampleDistance(highDef ? 0.5 : 1.);
+    }
+  mapper->SetSkipTransparentBlocks(vspNode->GetSkipTransparentBlocks());
 
   switch(vspNode->GetRaycastTechnique())
     {
@@ -461,7 +745,7 @@ int vtkMRMLVolumeRenderingDisplayableManager
   volumeMapper->SetInputData(vtkMRMLScalarVolumeNode::SafeDownCast(
                            vspNode->GetVolumeNode())->GetImageData() );
   int supported = 0;
-  if (volumeMapper->IsA("vtkFixedPointVolumeRayCastMapper"))
+  if (volumeMapper->IsA("vtkSlicerFixedPointVolumeRayCastMapper"))
     {
     supported = 1;
     }
@@ -571,7 +855,7 @@ bool vtkMRMLVolumeRenderingDisplayableManager::UpdateMapper(
   vtkVolumeMapper* volumeMapper = this->GetVolumeMapper(vspNode);
   if (vspNode->IsA("vtkMRMLCPURayCastVolumeRenderingDisplayNode"))
     {
-    this->UpdateCPURaycastMapper(vtkFixedPointVolumeRayCastMapper::SafeDownCast(volumeMapper),
+    this->UpdateCPURaycastMapper(vtkSlicerFixedPointVolumeRayCastMapper::SafeDownCast(volumeMapper),
                                  vtkMRMLCPURayCastVolumeRenderingDisplayNode::SafeDownCast(vspNode));
     }
   else if (vspNode->IsA("vtkMRMLGPURayCastVolumeRenderingDisplayNode"))
@@ -776,6 +1060,11 @@ void vtkMRMLVolumeRenderingDisplayableManager::OnVolumeRenderingDisplayNodeModif
   bool wasVolumeVisible = this->IsVolumeInView();
 
   this->UpdatePipelineFromDisplayNode(dnode);
+  if (this->Interaction == 0)
+    {
+    // Render the new parameters coarsely first
+    this->StartProgressiveRefinement();
+    }
 
   bool hasVolumeBeenRemoved = !this->IsVolumeInView() && wasVolumeVisible;
   if (dnode->GetVisibility() ||
@@ -906,6 +1195,9 @@ void vtkMRMLVolumeRenderingDisplayableManager
         {
         interactorStyle->StartState(VTKIS_VOLUME_PROPS);
         }
+      // Coarse rendering until the interaction ends
+      this->StopProgressiveRefinement();
+      this->ProgressivePass = 0;
       }
     }
   else if (event == vtkCommand::EndEvent ||
@@ -925,6 +1217,7 @@ void vtkMRMLVolumeRenderingDisplayableManager
         this->OnVolumeRenderingDisplayNodeModified(
           vtkMRMLVolumeRenderingDisplayNode::SafeDownCast(caller));
         }
+      this->StartProgressiveRefinement();
       }
     }
   else if (event == vtkCommand::InteractionEvent)
@@ -1025,8 +1318,11 @@ void vtkMRMLVolumeRenderingDisplayableManager::OnInteractorStyleEvent(int eventi
     case vtkCommand::EndInteractionEvent:
       //this->SetExpectedFPS(0.0001);
       this->SetupMapperFromParametersNode(this->DisplayedNode);
+      this->StartProgressiveRefinement();
       break;
     case vtkCommand::StartInteractionEvent:
+      this->StopProgressiveRefinement();
+      this->ProgressivePass = 0;
       this->SetupMapperFromParametersNode(this->DisplayedNode);
       //this->SetExpectedFPS(
       //  this->DisplayedNode ? this->DisplayedNode->GetExpectedFPS() : 15);
@@ -24,12 +24,12 @@
 // VolumeRendering includes
 #include "vtkSlicerVolumeRenderingModuleMRMLDisplayableManagerExport.h"
 class vtkGPUVolumeRayCastMapper;
-class vtkFixedPointVolumeRayCastMapper;
 class vtkMRMLCPURayCastVolumeRenderingDisplayNode;
 class vtkMRMLGPURayCastVolumeRenderingDisplayNode;
 class vtkMRMLVolumeNode;
 class vtkMRMLVolumeRenderingDisplayNode;
 class vtkMRMLVolumeRenderingScenarioNode;
+class vtkSlicerFixedPointVolumeRayCastMapper;
 class vtkSlicerVolumeRenderingLogic;
 class vtkVolumeProperty;
 
@@ -37,6 +37,7 @@ class vtkVolumeProperty;
 #include <vtkMRMLAbstractThreeDViewDisplayableManager.h>
 
 // VTK includes
+class vtkCallbackCommand;
 class vtkIntArray;
 class vtkMatrix4x4;
 class vtkPlanes;
@@ -95,7 +96,7 @@ public:
 
   void UpdateMapper(vtkVolumeMapper* mapper,
                     vtkMRMLVolumeRenderingDisplayNode* vspNode);
-  void UpdateCPURaycastMapper(vtkFixedPointVolumeRayCastMapper* mapper,
+  void UpdateCPURaycastMapper(vtkSlicerFixedPointVolumeRayCastMapper* mapper,
                               vtkMRMLCPURayCastVolumeRenderingDisplayNode* vspNode);
   void UpdateGPURaycastMapper(vtkGPUVolumeRayCastMapper* mapper,
                               vtkMRMLGPURayCastVolumeRenderingDisplayNode* vspNode);
@@ -134,6 +135,27 @@ public:
 
   static int DefaultGPUMemorySize;
 
+  /// Progressive rendering (vtkMRMLVolumeRenderingDisplayNode::Progressive)
+  /// of the CPU ray cast mapper: pass 0 is the coarse image rendered while
+  /// interacting, the last pass is the full quality image.
+  static int GetNumberOfProgressivePasses();
+  vtkGetMacro(ProgressivePass, int);
+
+  /// Restart the refinement from the coarse pass, requesting a render if a
+  /// finer pass was displayed. The next passes are rendered from the
+  /// interactor timer events. A render started after the camera or the
+  /// volume property changed without interaction (e.g. from a script or a
+  /// linked view) also restarts from the coarse pass, and the refinement
+  /// passes are aborted when events are pending in the render window.
+  void StartProgressiveRefinement();
+  /// Stop refining, the current pass is kept.
+  void StopProgressiveRefinement();
+  /// Render the next pass. If the camera or the volume property has been
+  /// modified since the previous pass, the refinement starts over from the
+  /// coarse pass instead. An aborted pass is rendered again.
+  /// Return false when there is nothing left to refine.
+  bool RefineProgressiveRendering();
+
 protected:
   vtkMRMLVolumeRenderingDisplayableManager();
   ~vtkMRMLVolumeRenderingDisplayableManager();
@@ -165,8 +187,9 @@ protected:
   vtkSlicerVolumeRenderingLogic *VolumeRenderingLogic;
 
   // Description:
-  // The software accelerated software mapper
-  vtkFixedPointVolumeRayCastMapper *MapperRaycast;
+  // The software accelerated software mapper. It leaps over the transparent
+  // regions of the volume (see vtkSlicerFixedPointVolumeRayCastMapper).
+  vtkSlicerFixedPointVolumeRayCastMapper *MapperRaycast;
 
   // Description:
   // The gpu ray cast mapper.
@@ -199,6 +222,16 @@ protected:
   int Interaction;
   double OriginalDesiredUpdateRate;
 
+  /// Current pass of the progressive rendering
+  int ProgressivePass;
+  /// Interactor timer that renders the next passes, 0 if none
+  int ProgressiveTimerId;
+  vtkCallbackCommand* ProgressiveCallbackCommand;
+  /// Camera and volume property modification time of the last pass
+  unsigned long ProgressiveRenderingMTime;
+  /// The render of the current pass has been aborted
+  bool ProgressiveRenderAborted;
+
 protected:
   void OnScenarioNodeModified();
   void OnVolumeRenderingDisplayNodeModified(vtkMRMLVolumeRenderingDisplayNode* dnode);
@@ -216,6 +249,15 @@ protected:
   int ValidateDisplayNode(vtkMRMLVolumeRenderingDisplayNode* vspNode);
   double GetSampleDistance(vtkMRMLVolumeRenderingDisplayNode* vspNode);
   double GetFramerate(vtkMRMLVolumeRenderingDisplayNode* vspNode);
+  bool IsProgressiveRenderingEnabled(vtkMRMLVolumeRenderingDisplayNode* vspNode);
+  unsigned long GetProgressiveRenderingMTime();
+  void StartProgressiveTimer();
+  void AddProgressiveRenderObservers();
+  void RemoveProgressiveRenderObservers();
+  void OnProgressiveRenderStart();
+  void OnProgressiveRenderAbortCheck();
+  static void ProgressiveRenderingCallback(vtkObject* caller, unsigned long eid,
+                                           void* clientData, void* callData);
   virtual vtkIdType GetMaxMemoryInBytes(vtkVolumeMapper* mapper, vtkMRMLVolumeRenderingDisplayNode* vspNode);
 
 };
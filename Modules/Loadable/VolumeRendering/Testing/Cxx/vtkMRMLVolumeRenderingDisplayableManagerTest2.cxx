@@ -0,0 +1,224 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeRendering includes
+#include <vtkMRMLCPURayCastVolumeRenderingDisplayNode.h>
+#include <vtkMRMLVolumeRenderingDisplayableManager.h>
+#include <vtkSlicerFixedPointVolumeRayCastMapper.h>
+
+// MRMLDisplayableManager includes
+#include <vtkMRMLDisplayableManagerGroup.h>
+
+// MRMLLogic includes
+#include <vtkMRMLApplicationLogic.h>
+
+// MRML includes
+#include <vtkMRMLCoreTestingMacros.h>
+#include <vtkMRMLScalarVolumeNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLViewNode.h>
+#include <vtkMRMLVolumePropertyNode.h>
+
+// VTK includes
+#include <vtkCamera.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderWindowInteractor.h>
+#include <vtkTimerLog.h>
+#include <vtkVolumeProperty.h>
+
+// STD includes
+#include <iostream>
+#include <string>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Sphere of increasing intensity toward its center
+void SetupImageData(vtkImageData* imageData, int size)
+{
+  imageData->SetDimensions(size, size, size);
+  imageData->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  unsigned char* ptr = static_cast<unsigned char*>(imageData->GetScalarPointer());
+  const double center = (size - 1) / 2.;
+  for (int z = 0; z < size; ++z)
+    {
+    for (int y = 0; y < size; ++y)
+      {
+      for (int x = 0; x < size; ++x)
+        {
+        double r2 = ((x - center) * (x - center) + (y - center) * (y - center)
+                     + (z - center) * (z - center)) / (center * center);
+        *(ptr++) = static_cast<unsigned char>(r2 < 1. ? 255. * (1. - r2) : 0.);
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+int RenderPass(vtkRenderWindow* renderWindow,
+               vtkMRMLVolumeRenderingDisplayableManager* displayableManager,
+               vtkSlicerFixedPointVolumeRayCastMapper* mapper,
+               int expectedPass, double expectedImageSampleDistance, bool benchmark)
+{
+  CHECK_INT(displayableManager->GetProgressivePass(), expectedPass);
+  CHECK_INT(mapper->GetAutoAdjustSampleDistances(), 0);
+  CHECK_DOUBLE(mapper->GetImageSampleDistance(), expectedImageSampleDistance);
+
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  renderWindow->Render();
+  timer->StopTimer();
+  if (benchmark)
+    {
+    REPORT_MEASUREMENT("ProgressivePass" << expectedPass, timer->GetElapsedTime());
+    }
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+// Progressive rendering of the CPU ray cast mapper
+// Usage: vtkMRMLVolumeRenderingDisplayableManagerTest2 [--benchmark]
+int vtkMRMLVolumeRenderingDisplayableManagerTest2(int argc, char* argv[])
+{
+  bool benchmark = vtkAddonTestingUtilities::IsBenchmarkRequested(argc, argv);
+
+  vtkNew<vtkRenderer> renderer;
+  vtkNew<vtkRenderWindow> renderWindow;
+  vtkNew<vtkRenderWindowInteractor> renderWindowInteractor;
+  renderWindow->SetSize(400, 400);
+  renderWindow->SetMultiSamples(0);
+  renderWindow->OffScreenRenderingOn();
+  renderWindow->AddRenderer(renderer.GetPointer());
+  renderWindow->SetInteractor(renderWindowInteractor.GetPointer());
+
+  vtkNew<vtkMRMLScene> scene;
+  vtkNew<vtkMRMLApplicationLogic> applicationLogic;
+  applicationLogic->SetMRMLScene(scene.GetPointer());
+
+  vtkNew<vtkMRMLViewNode> viewNode;
+  scene->AddNode(viewNode.GetPointer());
+
+  vtkNew<vtkMRMLDisplayableManagerGroup> displayableManagerGroup;
+  displayableManagerGroup->SetRenderer(renderer.GetPointer());
+  displayableManagerGroup->SetMRMLDisplayableNode(viewNode.GetPointer());
+
+  vtkNew<vtkMRMLVolumeRenderingDisplayableManager> vrDisplayableManager;
+  vrDisplayableManager->SetMRMLApplicationLogic(applicationLogic.GetPointer());
+  displayableManagerGroup->AddDisplayableManager(vrDisplayableManager.GetPointer());
+  displayableManagerGroup->GetInteractor()->Initialize();
+
+  vtkNew<vtkImageData> imageData;
+  SetupImageData(imageData.GetPointer(), 128);
+  vtkNew<vtkMRMLScalarVolumeNode> volumeNode;
+  volumeNode->SetAndObserveImageData(imageData.GetPointer());
+  scene->AddNode(volumeNode.GetPointer());
+
+  vtkNew<vtkMRMLVolumePropertyNode> volumePropertyNode;
+  scene->AddNode(volumePropertyNode.GetPointer());
+  vtkNew<vtkPiecewiseFunction> opacity;
+  opacity->AddPoint(0., 0.);
+  opacity->AddPoint(255., 0.2);
+  volumePropertyNode->GetVolumeProperty()->SetScalarOpacity(opacity.GetPointer());
+
+  vtkNew<vtkMRMLCPURayCastVolumeRenderingDisplayNode> vrDisplayNode;
+  vrDisplayNode->SetPerformanceControl(vtkMRMLVolumeRenderingDisplayNode::Progressive);
+  vrDisplayNode->SetAndObserveVolumeNodeID(volumeNode->GetID());
+  vrDisplayNode->SetAndObserveVolumePropertyNodeID(volumePropertyNode->GetID());
+  vrDisplayNode->SetVisibility(1);
+  scene->AddNode(vrDisplayNode.GetPointer());
+
+  // The CPU ray casting uses the Slicer mapper that leaps over the
+  // transparent regions of the volume
+  vtkSlicerFixedPointVolumeRayCastMapper* mapper = vtkSlicerFixedPointVolumeRayCastMapper::SafeDownCast(
+    vrDisplayableManager->GetVolumeMapper(vrDisplayNode.GetPointer()));
+  CHECK_NOT_NULL(mapper);
+  CHECK_INT(vrDisplayNode->GetSkipTransparentBlocks(), 1);
+  CHECK_INT(mapper->GetSkipTransparentBlocks(), 1);
+  renderer->ResetCamera();
+
+  // Coarse image first, then each pass is finer until the full quality
+  const int numberOfPasses = vtkMRMLVolumeRenderingDisplayableManager::GetNumberOfProgressivePasses();
+  CHECK_INT(numberOfPasses, 3);
+  vrDisplayableManager->StartProgressiveRefinement();
+  CHECK_EXIT_SUCCESS(RenderPass(renderWindow.GetPointer(), vrDisplayableManager.GetPointer(),
+                                mapper, 0, 4., benchmark));
+  // The air around the sphere is transparent
+  CHECK_BOOL(mapper->GetNumberOfRays() > 0, true);
+  CHECK_BOOL(mapper->GetNumberOfSkippedSamples() > 0, true);
+  CHECK_BOOL(vrDisplayableManager->RefineProgressiveRendering(), true);
+  CHECK_EXIT_SUCCESS(RenderPass(renderWindow.GetPointer(), vrDisplayableManager.GetPointer(),
+                                mapper, 1, 2., benchmark));
+  CHECK_BOOL(vrDisplayableManager->RefineProgressiveRendering(), true);
+  CHECK_EXIT_SUCCESS(RenderPass(renderWindow.GetPointer(), vrDisplayableManager.GetPointer(),
+                                mapper, 2, 1., benchmark));
+  double fullQualitySampleDistance = mapper->GetSampleDistance();
+  // Nothing left to refine: the full quality is kept
+  CHECK_BOOL(vrDisplayableManager->RefineProgressiveRendering(), false);
+  CHECK_INT(vrDisplayableManager->GetProgressivePass(), 2);
+
+  // Moving the camera cancels the refinement
+  vrDisplayableManager->StartProgressiveRefinement();
+  CHECK_BOOL(vrDisplayableManager->RefineProgressiveRendering(), true);
+  CHECK_INT(vrDisplayableManager->GetProgressivePass(), 1);
+  renderer->GetActiveCamera()->Azimuth(10.);
+  CHECK_BOOL(vrDisplayableManager->RefineProgressiveRendering(), true);
+  CHECK_INT(vrDisplayableManager->GetProgressivePass(), 0);
+  CHECK_DOUBLE(mapper->GetImageSampleDistance(), 4.);
+  CHECK_DOUBLE(mapper->GetSampleDistance(), 4. * fullQualitySampleDistance);
+  // and it resumes once the camera stops
+  CHECK_BOOL(vrDisplayableManager->RefineProgressiveRendering(), true);
+  CHECK_INT(vrDisplayableManager->GetProgressivePass(), 1);
+
+  // Changing the transfer function restarts from the coarse pass
+  opacity->AddPoint(128., 0.5);
+  CHECK_INT(vrDisplayableManager->GetProgressivePass(), 0);
+  CHECK_DOUBLE(mapper->GetImageSampleDistance(), 4.);
+  CHECK_BOOL(vrDisplayableManager->RefineProgressiveRendering(), true);
+  CHECK_INT(vrDisplayableManager->GetProgressivePass(), 1);
+
+  // A camera change that does not come from an interaction (script, linked
+  // view...) is rendered coarsely first, even once the refinement is complete
+  while (vrDisplayableManager->RefineProgressiveRendering())
+    {
+    }
+  CHECK_INT(vrDisplayableManager->GetProgressivePass(), 2);
+  renderer->GetActiveCamera()->Elevation(10.);
+  renderWindow->Render();
+  CHECK_INT(vrDisplayableManager->GetProgressivePass(), 0);
+  CHECK_DOUBLE(mapper->GetImageSampleDistance(), 4.);
+  CHECK_BOOL(vrDisplayableManager->RefineProgressiveRendering(), true);
+  CHECK_INT(vrDisplayableManager->GetProgressivePass(), 1);
+
+  // Leaping over the transparent regions can be turned off
+  vrDisplayNode->SetSkipTransparentBlocksOff();
+  CHECK_INT(mapper->GetSkipTransparentBlocks(), 0);
+  vrDisplayNode->SetSkipTransparentBlocksOn();
+  CHECK_INT(mapper->GetSkipTransparentBlocks(), 1);
+
+  // Other quality modes are not progressive
+  vrDisplayNode->SetPerformanceControl(vtkMRMLVolumeRenderingDisplayNode::Adaptative);
+  CHECK_BOOL(vrDisplayableManager->RefineProgressiveRendering(), false);
+  CHECK_INT(mapper->GetAutoAdjustSampleDistances(), 1);
+  CHECK_DOUBLE(mapper->GetImageSampleDistance(), 1.);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,352 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeRenderingReplacements includes
+#include <vtkSlicerFixedPointRayCastImage.h>
+#include <vtkSlicerFixedPointVolumeRayCastMapper.h>
+
+// MRML includes
+#include <vtkMRMLCoreTestingMacros.h>
+
+// VTK includes
+#include <vtkCamera.h>
+#include <vtkColorTransferFunction.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+#include <vtkVolume.h>
+#include <vtkVolumeProperty.h>
+
+// STD includes
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Synthetic CT: air around an ellipsoid (head) or an elliptic cylinder
+// (torso) of soft tissue, with a bone shell for the skull or a spine
+// and ribs for the torso. Values are in Hounsfield units.
+vtkSmartPointer<vtkImageData> CreateCTPhantom(int size, bool torso)
+{
+  vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+  image->SetDimensions(size, size, torso ? size + size / 2 : size);
+  image->SetSpacing(1., 1., 1.);
+  image->AllocateScalars(VTK_SHORT, 1);
+  int* dims = image->GetDimensions();
+  short* ptr = static_cast<short*>(image->GetScalarPointer());
+  const double center = (size - 1) / 2.;
+  for (int k = 0; k < dims[2]; ++k)
+    {
+    double z = (k - (dims[2] - 1) / 2.) / (dims[2] / 2.);
+    for (int j = 0; j < dims[1]; ++j)
+      {
+      double y = (j - center) / (size / 2.);
+      for (int i = 0; i < dims[0]; ++i)
+        {
+        double x = (i - center) / (size / 2.);
+        short value = -1000;
+        if (torso)
+          {
+          double r = (x * x) / (0.85 * 0.85) + (y * y) / (0.6 * 0.6);
+          double spine = (x * x + (y + 0.4) * (y + 0.4)) / (0.1 * 0.1);
+          // one rib every 1/8th of the length
+          bool rib = r > 0.75 && r < 0.85 && (k * 16 / dims[2]) % 2 == 0;
+          if (r < 1.)
+            {
+            value = (spine < 1. || rib) ? 1100 : 40;
+            }
+          }
+        else
+          {
+          double r = (x * x) / (0.8 * 0.8) + (y * y) / (0.9 * 0.9) + (z * z) / (0.9 * 0.9);
+          if (r < 1.)
+            {
+            value = (r > 0.8) ? 1200 : 35;
+            }
+          }
+        *ptr++ = value;
+        }
+      }
+    }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+// Similar to the "CT-Bone" preset: air and soft tissue are transparent
+vtkSmartPointer<vtkVolumeProperty> CreateCTBoneProperty()
+{
+  vtkNew<vtkPiecewiseFunction> opacity;
+  opacity->AddPoint(-1000., 0.);
+  opacity->AddPoint(150., 0.);
+  opacity->AddPoint(400., 0.3);
+  opacity->AddPoint(1200., 0.9);
+  opacity->AddPoint(3000., 1.);
+
+  vtkNew<vtkColorTransferFunction> color;
+  color->AddRGBPoint(-1000., 0.3, 0.3, 1.);
+  color->AddRGBPoint(150., 0.9, 0.3, 0.2);
+  color->AddRGBPoint(400., 0.9, 0.7, 0.5);
+  color->AddRGBPoint(3000., 1., 1., 1.);
+
+  vtkSmartPointer<vtkVolumeProperty> property = vtkSmartPointer<vtkVolumeProperty>::New();
+  property->SetScalarOpacity(opacity.GetPointer());
+  property->SetColor(color.GetPointer());
+  property->SetInterpolationTypeToLinear();
+  property->ShadeOn();
+  return property;
+}
+
+//----------------------------------------------------------------------------
+void SetupMapper(vtkSlicerFixedPointVolumeRayCastMapper* mapper, vtkImageData* input)
+{
+  mapper->SetInputData(input);
+  mapper->AutoAdjustSampleDistancesOff();
+  mapper->SetImageSampleDistance(1.);
+  mapper->SetSampleDistance(0.5);
+}
+
+//----------------------------------------------------------------------------
+std::vector<unsigned short> CopyRayCastImage(vtkSlicerFixedPointVolumeRayCastMapper* mapper)
+{
+  vtkSlicerFixedPointRayCastImage* rayCastImage = mapper->GetRayCastImage();
+  int* memorySize = rayCastImage->GetImageMemorySize();
+  unsigned short* image = rayCastImage->GetImage();
+  return std::vector<unsigned short>(image, image + 4 * memorySize[0] * memorySize[1]);
+}
+
+//----------------------------------------------------------------------------
+struct RenderResult
+{
+  double FramesPerSecond;
+  vtkIdType NumberOfRays;
+  vtkIdType NumberOfEarlyTerminatedRays;
+  vtkIdType NumberOfSkippedSamples;
+  std::vector<std::vector<unsigned short> > Images;
+};
+
+//----------------------------------------------------------------------------
+RenderResult RenderFrames(vtkRenderWindow* renderWindow, vtkRenderer* renderer,
+                          vtkSlicerFixedPointVolumeRayCastMapper* mapper,
+                          bool skipTransparentBlocks, int numberOfFrames)
+{
+  RenderResult result;
+  result.NumberOfRays = 0;
+  result.NumberOfEarlyTerminatedRays = 0;
+  result.NumberOfSkippedSamples = 0;
+
+  mapper->SetSkipTransparentBlocks(skipTransparentBlocks ? 1 : 0);
+  // Same camera path for every run
+  vtkCamera* camera = renderer->GetActiveCamera();
+  camera->SetFocalPoint(0., 0., 0.);
+  camera->SetPosition(0., -1., 0.);
+  camera->SetViewUp(0., 0., 1.);
+  renderer->ResetCamera();
+  camera->Elevation(20.);
+  camera->OrthogonalizeViewUp();
+  // The first render builds the gradients and the min max volume
+  renderWindow->Render();
+
+  double renderTime = 0.;
+  for (int frame = 0; frame < numberOfFrames; ++frame)
+    {
+    camera->Azimuth(360. / numberOfFrames);
+    double start = vtkTimerLog::GetUniversalTime();
+    renderWindow->Render();
+    renderTime += vtkTimerLog::GetUniversalTime() - start;
+
+    result.NumberOfRays += mapper->GetNumberOfRays();
+    result.NumberOfEarlyTerminatedRays += mapper->GetNumberOfEarlyTerminatedRays();
+    result.NumberOfSkippedSamples += mapper->GetNumberOfSkippedSamples();
+    result.Images.push_back(CopyRayCastImage(mapper));
+    }
+  result.FramesPerSecond = renderTime > 0. ? numberOfFrames / renderTime : 0.;
+  return result;
+}
+
+//----------------------------------------------------------------------------
+int TestPhantom(const char* name, vtkImageData* phantom, int numberOfFrames, bool benchmark)
+{
+  vtkNew<vtkSlicerFixedPointVolumeRayCastMapper> mapper;
+  SetupMapper(mapper.GetPointer(), phantom);
+
+  vtkSmartPointer<vtkVolumeProperty> property = CreateCTBoneProperty();
+  vtkNew<vtkVolume> volume;
+  volume->SetMapper(mapper.GetPointer());
+  volume->SetProperty(property);
+
+  vtkNew<vtkRenderer> renderer;
+  renderer->AddVolume(volume.GetPointer());
+  vtkNew<vtkRenderWindow> renderWindow;
+  renderWindow->SetSize(400, 400);
+  renderWindow->SetMultiSamples(0);
+  renderWindow->OffScreenRenderingOn();
+  renderWindow->AddRenderer(renderer.GetPointer());
+
+  RenderResult stepping = RenderFrames(renderWindow.GetPointer(), renderer.GetPointer(),
+                                       mapper.GetPointer(), false, numberOfFrames);
+  RenderResult leaping = RenderFrames(renderWindow.GetPointer(), renderer.GetPointer(),
+                                      mapper.GetPointer(), true, numberOfFrames);
+
+  if (benchmark)
+    {
+    REPORT_MEASUREMENT(name << "-FPS-Stepping", stepping.FramesPerSecond);
+    REPORT_MEASUREMENT(name << "-FPS-SkipTransparentBlocks", leaping.FramesPerSecond);
+    }
+  REPORT_MEASUREMENT(name << "-EarlyTerminatedRays", (leaping.NumberOfRays ?
+    static_cast<double>(leaping.NumberOfEarlyTerminatedRays) / leaping.NumberOfRays : 0.));
+  REPORT_MEASUREMENT(name << "-SkippedSamplesPerRay", (leaping.NumberOfRays ?
+    static_cast<double>(leaping.NumberOfSkippedSamples) / leaping.NumberOfRays : 0.));
+
+  // Leaping over transparent blocks does not change the image
+  CHECK_INT(static_cast<int>(leaping.Images.size()), numberOfFrames);
+  for (size_t i = 0; i < leaping.Images.size(); ++i)
+    {
+    if (leaping.Images[i] != stepping.Images[i])
+      {
+      std::cerr << name << ": frame " << i << " differs when skipping transparent blocks" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  // The same rays are cast, and the same samples are skipped
+  CHECK_BOOL(leaping.NumberOfRays > 0, true);
+  CHECK_BOOL(leaping.NumberOfRays == stepping.NumberOfRays, true);
+  CHECK_BOOL(leaping.NumberOfEarlyTerminatedRays == stepping.NumberOfEarlyTerminatedRays, true);
+  CHECK_BOOL(leaping.NumberOfSkippedSamples == stepping.NumberOfSkippedSamples, true);
+  // Most of the air and soft tissue is skipped, the bone stops the rays
+  CHECK_BOOL(leaping.NumberOfSkippedSamples > leaping.NumberOfRays, true);
+  CHECK_BOOL(leaping.NumberOfEarlyTerminatedRays > 0, true);
+
+  // Changing the data at the same size updates the min max volume: the
+  // former air is now bone and must not be skipped anymore
+  short* voxels = static_cast<short*>(phantom->GetScalarPointer());
+  std::fill(voxels, voxels + phantom->GetNumberOfPoints(), static_cast<short>(1200));
+  phantom->Modified();
+  renderWindow->Render();
+  std::vector<unsigned short> updatedImage = CopyRayCastImage(mapper.GetPointer());
+
+  vtkNew<vtkSlicerFixedPointVolumeRayCastMapper> newMapper;
+  SetupMapper(newMapper.GetPointer(), phantom);
+  volume->SetMapper(newMapper.GetPointer());
+  renderWindow->Render();
+  if (CopyRayCastImage(newMapper.GetPointer()) != updatedImage)
+    {
+    std::cerr << name << ": the min max volume is not updated with the data" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+// Bone with a soft tissue sphere in the middle: the rays through the
+// center of the image are less opaque with the minimum intensity
+// projection than with the maximum intensity projection.
+int TestIntensityProjections()
+{
+  const int size = 32;
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(size, size, size);
+  image->AllocateScalars(VTK_SHORT, 1);
+  short* ptr = static_cast<short*>(image->GetScalarPointer());
+  const double center = (size - 1) / 2.;
+  for (int k = 0; k < size; ++k)
+    {
+    for (int j = 0; j < size; ++j)
+      {
+      for (int i = 0; i < size; ++i)
+        {
+        double r2 = (i - center) * (i - center) + (j - center) * (j - center)
+          + (k - center) * (k - center);
+        *ptr++ = (r2 < (size / 4.) * (size / 4.)) ? 400 : 1200;
+        }
+      }
+    }
+
+  vtkNew<vtkSlicerFixedPointVolumeRayCastMapper> mapper;
+  SetupMapper(mapper.GetPointer(), image.GetPointer());
+  vtkSmartPointer<vtkVolumeProperty> property = CreateCTBoneProperty();
+  property->ShadeOff();
+  vtkNew<vtkVolume> volume;
+  volume->SetMapper(mapper.GetPointer());
+  volume->SetProperty(property);
+
+  vtkNew<vtkRenderer> renderer;
+  renderer->AddVolume(volume.GetPointer());
+  vtkNew<vtkRenderWindow> renderWindow;
+  renderWindow->SetSize(100, 100);
+  renderWindow->SetMultiSamples(0);
+  renderWindow->OffScreenRenderingOn();
+  renderWindow->AddRenderer(renderer.GetPointer());
+  renderer->ResetCamera();
+
+  unsigned short centerAlpha[2];
+  const int blendModes[2] = {
+    vtkVolumeMapper::MAXIMUM_INTENSITY_BLEND, vtkVolumeMapper::MINIMUM_INTENSITY_BLEND};
+  for (int i = 0; i < 2; ++i)
+    {
+    mapper->SetBlendMode(blendModes[i]);
+    renderWindow->Render();
+    CHECK_INT(mapper->GetFlipMIPComparison(),
+              blendModes[i] == vtkVolumeMapper::MINIMUM_INTENSITY_BLEND ? 1 : 0);
+    vtkSlicerFixedPointRayCastImage* rayCastImage = mapper->GetRayCastImage();
+    int* memorySize = rayCastImage->GetImageMemorySize();
+    int* inUseSize = rayCastImage->GetImageInUseSize();
+    int centerPixel = (inUseSize[1] / 2) * memorySize[0] + inUseSize[0] / 2;
+    centerAlpha[i] = rayCastImage->GetImage()[4 * centerPixel + 3];
+    }
+  CHECK_BOOL(centerAlpha[1] > 0, true);
+  CHECK_BOOL(centerAlpha[1] < centerAlpha[0], true);
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+// Usage: vtkSlicerFixedPointVolumeRayCastMapperTest1 --benchmark [size]
+int vtkSlicerFixedPointVolumeRayCastMapperTest1(int argc, char * argv[])
+{
+  vtkNew<vtkSlicerFixedPointVolumeRayCastMapper> mapper;
+  EXERCISE_BASIC_OBJECT_METHODS(mapper.GetPointer());
+  CHECK_INT(mapper->GetSkipTransparentBlocks(), 1);
+  CHECK_INT(mapper->GetNumberOfRays(), 0);
+
+  // Small phantoms and a few frames are enough to check the images and the
+  // ray statistics, the frame rates are only reported with --benchmark
+  bool benchmark = vtkAddonTestingUtilities::IsBenchmarkRequested(argc, argv);
+  int size = 64;
+  int numberOfFrames = 4;
+  if (benchmark)
+    {
+    size = (argc > 2 ? atoi(argv[2]) : 128);
+    numberOfFrames = 10;
+    }
+
+  vtkSmartPointer<vtkImageData> head = CreateCTPhantom(size, false);
+  CHECK_EXIT_SUCCESS(TestPhantom("CTHead", head, numberOfFrames, benchmark));
+  vtkSmartPointer<vtkImageData> torso = CreateCTPhantom(size, true);
+  CHECK_EXIT_SUCCESS(TestPhantom("CTTorso", torso, numberOfFrames, benchmark));
+  CHECK_EXIT_SUCCESS(TestIntensityProjections());
+
+  return EXIT_SUCCESS;
+}
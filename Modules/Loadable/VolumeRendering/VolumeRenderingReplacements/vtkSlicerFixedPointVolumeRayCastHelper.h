@@ -632,7 +632,8 @@
   IMAGEPTR[1] = (COLOR[1]>32767)?(32767):(COLOR[1]);                            \
   IMAGEPTR[2] = (COLOR[2]>32767)?(32767):(COLOR[2]);                           \
   unsigned int tmpAlpha = (~REMAININGOPACITY)&VTKKW_FP_MASK;                    \
-  IMAGEPTR[3] = (tmpAlpha>32767)?(32767):(tmpAlpha);
+  IMAGEPTR[3] = (tmpAlpha>32767)?(32767):(tmpAlpha);                            \
+  earlyTerminatedRayCount += ( REMAININGOPACITY < 0xff );
 
 #define VTKKWRCHelper_MoveToNextSampleNN()                                      \
   if ( k < numSteps-1 )                                                         \
@@ -711,7 +712,13 @@
   unsigned int inc[3];                                                                          \
   inc[0] = components;                                                                          \
   inc[1] = dim[0]*components;                                                                   \
-  inc[2] = dim[0]*dim[1]*components;
+  inc[2] = dim[0]*dim[1]*components;                                                            \
+                                                                                                \
+  int skipTransparentBlocks         = mapper->GetSkipTransparentBlocks();                       \
+  (void)(skipTransparentBlocks);                                                                \
+  vtkIdType rayCount                = 0;                                                        \
+  vtkIdType earlyTerminatedRayCount = 0;                                                        \
+  vtkIdType skippedSampleCount      = 0;
 
 #define VTKKWRCHelper_InitializeWeights()                       \
   float weights[4];                                             \
@@ -828,6 +835,7 @@
   unsigned int   pos[3];                                \
   unsigned int   dir[3];                                \
   mapper->ComputeRayInfo( i, j, pos, dir, &numSteps );  \
+  rayCount++;                                           \
   if ( numSteps == 0 )                                  \
     {                                                   \
     *(imagePtr  ) = 0;                                  \
@@ -1060,6 +1068,11 @@
 #define VTKKWRCHelper_IncrementAndLoopEnd()                                     \
       imagePtr+=4;                                                              \
       }                                                                         \
+    mapper->AddRayCastStatistics( threadID, rayCount,                           \
+                                  earlyTerminatedRayCount, skippedSampleCount );\
+    rayCount = 0;                                                               \
+    earlyTerminatedRayCount = 0;                                                \
+    skippedSampleCount = 0;                                                     \
     if ( j%32 == 0 && threadID==0 )                                                           \
       {                                                                         \
       float fargs[1];                                                           \
@@ -1114,10 +1127,25 @@
                                                                 \
   if ( !mmvalid )                                               \
     {                                                           \
+    if ( !skipTransparentBlocks )                               \
+      {                                                         \
+      skippedSampleCount++;                                     \
+      continue;                                                 \
+      }                                                         \
+    unsigned int leapSteps =                                    \
+      mapper->ComputeSpaceLeapSteps( pos, dir );                \
+    if ( leapSteps >= numSteps - k )                            \
+      {                                                         \
+      skippedSampleCount += numSteps - k;                       \
+      break;                                                    \
+      }                                                         \
+    mapper->FixedPointIncrement( pos, dir, leapSteps - 1 );     \
+    k += leapSteps - 1;                                         \
+    skippedSampleCount += leapSteps;                            \
     continue;                                                   \
     }
 
-#define VTKKWRCHelper_MIPSpaceLeapCheck( MAXIDX, MAXIDXDEF )            \
+#define VTKKWRCHelper_MIPSpaceLeapCheck( MAXIDX, MAXIDXDEF, FLIP )      \
   if ( pos[0] >> VTKKW_FPMM_SHIFT != mmpos[0] ||                        \
        pos[1] >> VTKKW_FPMM_SHIFT != mmpos[1] ||                        \
        pos[2] >> VTKKW_FPMM_SHIFT != mmpos[2] )                         \
@@ -1126,7 +1154,7 @@
     mmpos[1] = pos[1] >> VTKKW_FPMM_SHIFT;                              \
     mmpos[2] = pos[2] >> VTKKW_FPMM_SHIFT;                              \
     mmvalid = (MAXIDXDEF)?                                              \
-     (mapper->CheckMIPMinMaxVolumeFlag( mmpos, 0, MAXIDX )):(1);        \
+     (mapper->CheckMIPMinMaxVolumeFlag( mmpos, 0, MAXIDX, FLIP )):(1);  \
     }                                                                   \
                                                                         \
   if ( !mmvalid )                                                       \
@@ -1135,7 +1163,7 @@
     }
 
 
-#define VTKKWRCHelper_MIPSpaceLeapPopulateMulti( MAXIDX )                       \
+#define VTKKWRCHelper_MIPSpaceLeapPopulateMulti( MAXIDX, FLIP )                 \
   if ( pos[0] >> VTKKW_FPMM_SHIFT != mmpos[0] ||                                \
        pos[1] >> VTKKW_FPMM_SHIFT != mmpos[1] ||                                \
        pos[2] >> VTKKW_FPMM_SHIFT != mmpos[2] )                                 \
@@ -1145,7 +1173,7 @@
     mmpos[2] = pos[2] >> VTKKW_FPMM_SHIFT;                                      \
     for ( c = 0; c < components; c++ )                                          \
       {                                                                         \
-      mmvalid[c] = mapper->CheckMIPMinMaxVolumeFlag( mmpos, c, MAXIDX[c] );     \
+      mmvalid[c] = mapper->CheckMIPMinMaxVolumeFlag( mmpos, c, MAXIDX[c], FLIP ); \
       }                                                                         \
     }
 
@@ -51,6 +51,7 @@ void vtkSlicerFixedPointMIPHelperGenerateImageOneNN( T *data,
   VTKKWRCHelper_InitializationAndLoopStartNN();
   VTKKWRCHelper_InitializeMIPOneNN();
   VTKKWRCHelper_SpaceLeapSetup();
+  int flip = mapper->GetFlipMIPComparison();
 
   if ( cropping )
     {
@@ -64,13 +65,13 @@ void vtkSlicerFixedPointMIPHelperGenerateImageOneNN( T *data,
         mapper->FixedPointIncrement( pos, dir );
         }
 
-      VTKKWRCHelper_MIPSpaceLeapCheck( maxIdx, maxValueDefined );
+      VTKKWRCHelper_MIPSpaceLeapCheck( maxIdx, maxValueDefined, flip );
 
       if ( !mapper->CheckIfCropped( pos ) )
         {
         mapper->ShiftVectorDown( pos, spos );
         dptr = data +  spos[0]*inc[0] + spos[1]*inc[1] + spos[2]*inc[2];
-        if ( !maxValueDefined || *dptr > maxValue )
+        if ( !maxValueDefined || ( flip ? (*dptr < maxValue) : (*dptr > maxValue) ) )
           {
           maxValue = *dptr;
           maxIdx = static_cast<unsigned short>((maxValue + shift[0])*scale[0]);
@@ -100,11 +101,18 @@ void vtkSlicerFixedPointMIPHelperGenerateImageOneNN( T *data,
         mapper->FixedPointIncrement( pos, dir );
         }
 
-      VTKKWRCHelper_MIPSpaceLeapCheck( maxIdx, 1 );
+      VTKKWRCHelper_MIPSpaceLeapCheck( maxIdx, 1, flip );
 
       mapper->ShiftVectorDown( pos, spos );
       dptr = data +  spos[0]*inc[0] + spos[1]*inc[1] + spos[2]*inc[2];
-      maxValue = ( *dptr > maxValue )?(*dptr):(maxValue);
+      if ( flip )
+        {
+        maxValue = ( *dptr < maxValue )?(*dptr):(maxValue);
+        }
+      else
+        {
+        maxValue = ( *dptr > maxValue )?(*dptr):(maxValue);
+        }
       maxIdx = static_cast<unsigned short>((maxValue + shift[0])*scale[0]);
       }
 
@@ -130,6 +138,7 @@ void vtkSlicerFixedPointMIPHelperGenerateImageDependentNN( T *data,
    VTKKWRCHelper_InitializationAndLoopStartNN();
   VTKKWRCHelper_InitializeMIPMultiNN();
   VTKKWRCHelper_SpaceLeapSetup();
+  int flip = mapper->GetFlipMIPComparison();
 
   int maxValueDefined = 0;
   unsigned short maxIdxS = 0;
@@ -141,12 +150,14 @@ void vtkSlicerFixedPointMIPHelperGenerateImageDependentNN( T *data,
       mapper->FixedPointIncrement( pos, dir );
       }
 
-    VTKKWRCHelper_MIPSpaceLeapCheck( maxIdxS, maxValueDefined );
+    VTKKWRCHelper_MIPSpaceLeapCheck( maxIdxS, maxValueDefined, flip );
     VTKKWRCHelper_CroppingCheckNN( pos );
 
     mapper->ShiftVectorDown( pos, spos );
     dptr = data +  spos[0]*inc[0] + spos[1]*inc[1] + spos[2]*inc[2];
-    if ( !maxValueDefined || *(dptr + components - 1) > maxValue[components-1] )
+    if ( !maxValueDefined ||
+         ( flip ? ( *(dptr + components - 1) < maxValue[components-1] ) :
+                  ( *(dptr + components - 1) > maxValue[components-1] ) ) )
       {
       for ( c = 0; c < components; c++ )
         {
@@ -193,6 +204,7 @@ void vtkSlicerFixedPointMIPHelperGenerateImageIndependentNN( T *data,
   VTKKWRCHelper_InitializationAndLoopStartNN();
   VTKKWRCHelper_InitializeMIPMultiNN();
   VTKKWRCHelper_SpaceLeapSetupMulti();
+  int flip = mapper->GetFlipMIPComparison();
 
   int maxValueDefined = 0;
   unsigned short maxIdx[4];
@@ -204,7 +216,7 @@ void vtkSlicerFixedPointMIPHelperGenerateImageIndependentNN( T *data,
       mapper->FixedPointIncrement( pos, dir );
       }
     VTKKWRCHelper_CroppingCheckNN( pos );
-    VTKKWRCHelper_MIPSpaceLeapPopulateMulti( maxIdx )
+    VTKKWRCHelper_MIPSpaceLeapPopulateMulti( maxIdx, flip )
 
     mapper->ShiftVectorDown( pos, spos );
     dptr = data +  spos[0]*inc[0] + spos[1]*inc[1] + spos[2]*inc[2];
@@ -223,7 +235,7 @@ void vtkSlicerFixedPointMIPHelperGenerateImageIndependentNN( T *data,
       for ( c = 0; c < components; c++ )
         {
         if ( VTKKWRCHelper_MIPSpaceLeapCheckMulti( c ) &&
-             *(dptr + c) > maxValue[c] )
+             ( flip ? ( *(dptr + c) < maxValue[c] ) : ( *(dptr + c) > maxValue[c] ) ) )
           {
           maxValue[c] = *(dptr+c);
           maxIdx[c] = (unsigned short)((maxValue[c] + shift[c])*scale[c]);
@@ -262,9 +274,12 @@ void vtkSlicerFixedPointMIPHelperGenerateImageOneSimpleTrilin( T *dataPtr,
   VTKKWRCHelper_InitializationAndLoopStartTrilin();
   VTKKWRCHelper_InitializeMIPOneTrilin();
   VTKKWRCHelper_SpaceLeapSetup();
+  int flip = mapper->GetFlipMIPComparison();
 
   int maxValueDefined = 0;
   unsigned short maxIdx=0;
+  // Maximum (or minimum if flip) of the cell vertex values: the
+  // interpolated values in the cell cannot be beyond it
   unsigned short maxScalar = 0;
 
   for ( k = 0; k < numSteps; k++ )
@@ -274,7 +289,7 @@ void vtkSlicerFixedPointMIPHelperGenerateImageOneSimpleTrilin( T *dataPtr,
       mapper->FixedPointIncrement( pos, dir );
       }
 
-    VTKKWRCHelper_MIPSpaceLeapCheck( maxIdx, maxValueDefined );
+    VTKKWRCHelper_MIPSpaceLeapCheck( maxIdx, maxValueDefined, flip );
     VTKKWRCHelper_CroppingCheckTrilin( pos );
 
     mapper->ShiftVectorDown( pos, spos );
@@ -288,21 +303,35 @@ void vtkSlicerFixedPointMIPHelperGenerateImageOneSimpleTrilin( T *dataPtr,
 
       dptr = dataPtr + spos[0]*inc[0] + spos[1]*inc[1] + spos[2]*inc[2];
       VTKKWRCHelper_GetCellScalarValuesSimple( dptr );
-      maxScalar = (A>B)?(A):(B);
-      maxScalar = (C>maxScalar)?(C):(maxScalar);
-      maxScalar = (D>maxScalar)?(D):(maxScalar);
-      maxScalar = (E>maxScalar)?(E):(maxScalar);
-      maxScalar = (F>maxScalar)?(F):(maxScalar);
-      maxScalar = (G>maxScalar)?(G):(maxScalar);
-      maxScalar = (H>maxScalar)?(H):(maxScalar);
+      if ( flip )
+        {
+        maxScalar = (A<B)?(A):(B);
+        maxScalar = (C<maxScalar)?(C):(maxScalar);
+        maxScalar = (D<maxScalar)?(D):(maxScalar);
+        maxScalar = (E<maxScalar)?(E):(maxScalar);
+        maxScalar = (F<maxScalar)?(F):(maxScalar);
+        maxScalar = (G<maxScalar)?(G):(maxScalar);
+        maxScalar = (H<maxScalar)?(H):(maxScalar);
+        }
+      else
+        {
+        maxScalar = (A>B)?(A):(B);
+        maxScalar = (C>maxScalar)?(C):(maxScalar);
+        maxScalar = (D>maxScalar)?(D):(maxScalar);
+        maxScalar = (E>maxScalar)?(E):(maxScalar);
+        maxScalar = (F>maxScalar)?(F):(maxScalar);
+        maxScalar = (G>maxScalar)?(G):(maxScalar);
+        maxScalar = (H>maxScalar)?(H):(maxScalar);
+        }
       }
 
-    if ( !maxValueDefined || maxScalar > maxValue )
+    if ( !maxValueDefined ||
+         ( flip ? (maxScalar < maxValue) : (maxScalar > maxValue) ) )
       {
       VTKKWRCHelper_ComputeWeights(pos);
       VTKKWRCHelper_InterpolateScalar(val);
 
-      if ( !maxValueDefined || val > maxValue )
+      if ( !maxValueDefined || ( flip ? (val < maxValue) : (val > maxValue) ) )
         {
         maxValue = val;
         maxIdx = static_cast<unsigned short>(maxValue);
@@ -343,6 +372,7 @@ void vtkSlicerFixedPointMIPHelperGenerateImageOneTrilin( T *dataPtr,
   VTKKWRCHelper_InitializationAndLoopStartTrilin();
   VTKKWRCHelper_InitializeMIPOneTrilin();
   VTKKWRCHelper_SpaceLeapSetup();
+  int flip = mapper->GetFlipMIPComparison();
 
   int maxValueDefined = 0;
   unsigned short maxIdx = 0;
@@ -354,7 +384,7 @@ void vtkSlicerFixedPointMIPHelperGenerateImageOneTrilin( T *dataPtr,
       }
 
     VTKKWRCHelper_CroppingCheckTrilin( pos );
-    VTKKWRCHelper_MIPSpaceLeapCheck( maxIdx, maxValueDefined );
+    VTKKWRCHelper_MIPSpaceLeapCheck( maxIdx, maxValueDefined, flip );
 
     mapper->ShiftVectorDown( pos, spos );
     if ( spos[0] != oldSPos[0] ||
@@ -373,7 +403,7 @@ void vtkSlicerFixedPointMIPHelperGenerateImageOneTrilin( T *dataPtr,
     VTKKWRCHelper_ComputeWeights(pos);
     VTKKWRCHelper_InterpolateScalar(val);
 
-    if ( !maxValueDefined || val > maxValue )
+    if ( !maxValueDefined || ( flip ? (val < maxValue) : (val > maxValue) ) )
       {
       maxValue = val;
       maxIdx = static_cast<unsigned short>(maxValue);
@@ -417,6 +447,7 @@ void vtkSlicerFixedPointMIPHelperGenerateImageDependentTrilin( T *dataPtr,
   VTKKWRCHelper_InitializationAndLoopStartTrilin();
   VTKKWRCHelper_InitializeMIPMultiTrilin();
   VTKKWRCHelper_SpaceLeapSetup();
+  int flip = mapper->GetFlipMIPComparison();
 
   int maxValueDefined = 0;
   unsigned short maxIdx = 0;
@@ -428,7 +459,7 @@ void vtkSlicerFixedPointMIPHelperGenerateImageDependentTrilin( T *dataPtr,
       }
 
     VTKKWRCHelper_CroppingCheckTrilin( pos );
-    VTKKWRCHelper_MIPSpaceLeapCheck( maxIdx, maxValueDefined );
+    VTKKWRCHelper_MIPSpaceLeapCheck( maxIdx, maxValueDefined, flip );
 
     mapper->ShiftVectorDown( pos, spos );
     if ( spos[0] != oldSPos[0] ||
@@ -449,7 +480,9 @@ void vtkSlicerFixedPointMIPHelperGenerateImageDependentTrilin( T *dataPtr,
     VTKKWRCHelper_ComputeWeights(pos);
     VTKKWRCHelper_InterpolateScalarComponent( val, c, components );
 
-    if ( !maxValueDefined || (val[components-1] > maxValue[components-1]) )
+    if ( !maxValueDefined ||
+         ( flip ? (val[components-1] < maxValue[components-1]) :
+                  (val[components-1] > maxValue[components-1]) ) )
       {
       for ( c= 0; c < components; c++ )
         {
@@ -495,6 +528,7 @@ void vtkSlicerFixedPointMIPHelperGenerateImageIndependentTrilin( T *dataPtr,
   VTKKWRCHelper_InitializeWeights();
   VTKKWRCHelper_InitializationAndLoopStartTrilin();
   VTKKWRCHelper_InitializeMIPMultiTrilin();
+  int flip = mapper->GetFlipMIPComparison();
 
   int maxValueDefined = 0;
   for ( k = 0; k < numSteps; k++ )
@@ -537,7 +571,7 @@ void vtkSlicerFixedPointMIPHelperGenerateImageIndependentTrilin( T *dataPtr,
       {
       for ( c= 0; c < components; c++ )
         {
-        if ( (val[c] > maxValue[c]) )
+        if ( flip ? (val[c] < maxValue[c]) : (val[c] > maxValue[c]) )
           {
           maxValue[c] = val[c];
           }
@@ -33,6 +33,7 @@ PURPOSE.  See the above copyright notice for more information.
 #include "vtkPiecewiseFunction.h"
 #include "vtkPlaneCollection.h"
 #include "vtkPointData.h"
+#include "vtkRayCastImageDisplayHelper.h"
 #include "vtkRenderWindow.h"
 #include "vtkRenderer.h"
 #include "vtkTimerLog.h"
@@ -41,6 +42,8 @@ PURPOSE.  See the above copyright notice for more information.
 #include "vtkSlicerFixedPointRayCastImage.h"
 #include <vtkVersion.h>
 
+#include <cstring>
+
 
 vtkStandardNewMacro(vtkSlicerFixedPointVolumeRayCastMapper);
 vtkCxxSetObjectMacro(vtkSlicerFixedPointVolumeRayCastMapper, RayCastImage, vtkSlicerFixedPointRayCastImage);
@@ -479,6 +482,7 @@ vtkSlicerFixedPointVolumeRayCastMapper::vtkSlicerFixedPointVolumeRayCastMapper()
 
     this->ShadingRequired              = 0;
     this->GradientOpacityRequired      = 0;
+    this->FlipMIPComparison            = 0;
 
     this->CroppingRegionMask[0] = 1;
     for ( i = 1; i < 27; i++ )
@@ -489,7 +493,7 @@ vtkSlicerFixedPointVolumeRayCastMapper::vtkSlicerFixedPointVolumeRayCastMapper()
     this->NumTransformedClippingPlanes = 0;
     this->TransformedClippingPlanes    = NULL;
 
-    this->ImageDisplayHelper  = vtkSlicerRayCastImageDisplayHelper::New();
+    this->ImageDisplayHelper  = vtkRayCastImageDisplayHelper::New();
     this->ImageDisplayHelper->PreMultipliedColorsOn();
     this->ImageDisplayHelper->SetPixelScale( 2.0 );
 
@@ -506,6 +510,18 @@ vtkSlicerFixedPointVolumeRayCastMapper::vtkSlicerFixedPointVolumeRayCastMapper()
     this->MinMaxVolumeSize[3] = 0;
     this->SavedMinMaxInput = NULL;
 
+    // Coarser level of the min max volume: one flag per 4x4x4 min max cells
+    // used to leap over large transparent regions
+    this->MinMaxBlockVolume = NULL;
+    this->MinMaxBlockVolumeSize[0] = 0;
+    this->MinMaxBlockVolumeSize[1] = 0;
+    this->MinMaxBlockVolumeSize[2] = 0;
+    this->SkipTransparentBlocks = 1;
+
+    this->NumberOfRays                = 0;
+    this->NumberOfEarlyTerminatedRays = 0;
+    this->NumberOfSkippedSamples      = 0;
+
     this->Volume = NULL;
     //SLICERADD
     this->ManualInteractive=0;
@@ -620,6 +636,7 @@ vtkSlicerFixedPointVolumeRayCastMapper::~vtkSlicerFixedPointVolumeRayCastMapper(
 
     // Delete storage used by min/max volume
     delete [] this->MinMaxVolume;
+    delete [] this->MinMaxBlockVolume;
 }
 
 float vtkSlicerFixedPointVolumeRayCastMapper::ComputeRequiredImageSampleDistance( float desiredTime,
@@ -936,29 +953,40 @@ void vtkSlicerFixedPointVolumeRayCastMapper::UpdateMinMaxVolume( vtkVolume *vol
             this->MinMaxVolumeSize[2] = targetSize[2];
             this->MinMaxVolumeSize[3] = targetSize[3];
 
-            // Initialize the structure
-            unsigned short *tmpPtr = this->MinMaxVolume;
-            for ( i = 0; i < targetSize[0] * targetSize[1] * targetSize[2]; i++ )
+            // The block volume groups 4x4x4 min max cells
+            delete [] this->MinMaxBlockVolume;
+            for ( i = 0; i < 3; i++ )
             {
-                for ( j = 0; j < targetSize[3]; j++ )
-                {
-                    *(tmpPtr++) = 0xffff;  // Min Scalar
-                    *(tmpPtr++) = 0;       // Max Scalar
-                    *(tmpPtr++) = 0;       // Max Gradient Magnitude and
-                }                      // Flag computed from transfer functions
+                this->MinMaxBlockVolumeSize[i] = ( targetSize[i] + 3 ) / 4;
             }
+            this->MinMaxBlockVolume = new unsigned char [ this->MinMaxBlockVolumeSize[0] *
+                this->MinMaxBlockVolumeSize[1] *
+                this->MinMaxBlockVolumeSize[2] ];
+        }
 
-            // Now put the scalar data values into the structure
-            int scalarType   = input->GetScalarType();
-            void *dataPtr = input->GetScalarPointer();
-
-            switch ( scalarType )
+        // Initialize the structure - whenever the data changes, even if
+        // the size of the min max volume is the same
+        unsigned short *tmpPtr = this->MinMaxVolume;
+        for ( i = 0; i < targetSize[0] * targetSize[1] * targetSize[2]; i++ )
+        {
+            for ( j = 0; j < targetSize[3]; j++ )
             {
-                vtkTemplateMacro(
-                    vtkSlicerFixedPointVolumeRayCastMapperFillInMinMaxVolume(
-                    (VTK_TT *)(dataPtr), this->MinMaxVolume, dim, targetSize,
-                    independent, components, this->TableShift, this->TableScale) );
-            }
+                *(tmpPtr++) = 0xffff;  // Min Scalar
+                *(tmpPtr++) = 0;       // Max Scalar
+                *(tmpPtr++) = 0;       // Max Gradient Magnitude and
+            }                      // Flag computed from transfer functions
+        }
+
+        // Now put the scalar data values into the structure
+        int scalarType   = input->GetScalarType();
+        void *dataPtr = input->GetScalarPointer();
+
+        switch ( scalarType )
+        {
+            vtkTemplateMacro(
+                vtkSlicerFixedPointVolumeRayCastMapperFillInMinMaxVolume(
+                (VTK_TT *)(dataPtr), this->MinMaxVolume, dim, targetSize,
+                independent, components, this->TableShift, this->TableScale) );
         }
 
         this->SavedMinMaxInput = input;
@@ -1004,6 +1032,20 @@ void vtkSlicerFixedPointVolumeRayCastMapper::UpdateMinMaxVolume( vtkVolume *vol
         minNonZeroGradientMagnitudeIndex[c] = i;
     }
 
+    // Running count of the scalar indices with non-zero opacity so that
+    // any [min, max] range of a cell can be checked in constant time
+    std::vector<unsigned int> opaqueCount[4];
+    for ( c = 0; c < this->MinMaxVolumeSize[3]; c++ )
+    {
+        opaqueCount[c].resize( 32769 );
+        opaqueCount[c][0] = 0;
+        for ( i = 0; i < 32768; i++ )
+        {
+            opaqueCount[c][i+1] = opaqueCount[c][i] +
+                ( this->ScalarOpacityTable[c][i] ? 1 : 0 );
+        }
+    }
+
     unsigned short *tmpPtr = this->MinMaxVolume;
     int zero = 0;
     int nonZero = 0;
@@ -1043,21 +1085,14 @@ void vtkSlicerFixedPointVolumeRayCastMapper::UpdateMinMaxVolume( vtkVolume *vol
                         tmpPtr[2] |= 0x0001;
                         nonZero++;
                     }
-                    // We have to search between min scalar value and the
-                    // max scalar stored in the minmax volume to look for non-zero
+                    // We have to look between min scalar value and the
+                    // max scalar stored in the minmax volume for non-zero
                     // opacity since both values must be above our first non-zero
                     // threshold so we don't have information in this area
                     else
                     {
-                        int loop;
-                        for ( loop = tmpPtr[0]; loop <= tmpPtr[1]; loop++ )
-                        {
-                            if ( this->ScalarOpacityTable[c][loop] )
-                            {
-                                break;
-                            }
-                        }
-                        if ( loop <= tmpPtr[1] )
+                        if ( tmpPtr[0] <= tmpPtr[1] &&
+                            opaqueCount[c][tmpPtr[1]+1] > opaqueCount[c][tmpPtr[0]] )
                         {
                             tmpPtr[2] &= 0xff00;
                             tmpPtr[2] |= 0x0001;
@@ -1075,10 +1110,42 @@ void vtkSlicerFixedPointVolumeRayCastMapper::UpdateMinMaxVolume( vtkVolume *vol
         }
     }
 
+    delete [] minNonZeroScalarIndex;
+    delete [] minNonZeroGradientMagnitudeIndex;
+
+    this->UpdateMinMaxBlockVolume();
+
     this->SavedMinMaxFlagTime.Modified();
 
 }
 
+// Flag each group of 4x4x4 min max cells as non-transparent if
+// any of its cells is, for any component
+void vtkSlicerFixedPointVolumeRayCastMapper::UpdateMinMaxBlockVolume()
+{
+    int blockSliceSize = this->MinMaxBlockVolumeSize[0] * this->MinMaxBlockVolumeSize[1];
+    memset( this->MinMaxBlockVolume, 0,
+            blockSliceSize * this->MinMaxBlockVolumeSize[2] * sizeof(unsigned char) );
+
+    unsigned short *tmpPtr = this->MinMaxVolume;
+    for ( int k = 0; k < this->MinMaxVolumeSize[2]; k++ )
+    {
+        for ( int j = 0; j < this->MinMaxVolumeSize[1]; j++ )
+        {
+            unsigned char *blockPtr = this->MinMaxBlockVolume +
+                (k>>2) * blockSliceSize + (j>>2) * this->MinMaxBlockVolumeSize[0];
+            for ( int i = 0; i < this->MinMaxVolumeSize[0]; i++ )
+            {
+                for ( int c = 0; c < this->MinMaxVolumeSize[3]; c++ )
+                {
+                    blockPtr[i>>2] |= static_cast<unsigned char>( tmpPtr[2]&0x00ff );
+                    tmpPtr += 3;
+                }
+            }
+        }
+    }
+}
+
 void vtkSlicerFixedPointVolumeRayCastMapper::UpdateCroppingRegions()
 {
     this->ConvertCroppingRegionPlanesToVoxels();
@@ -1123,6 +1190,11 @@ int vtkSlicerFixedPointVolumeRayCastMapper::PerImageInitialization( vtkRenderer
     this->OldImageSampleDistance = this->ImageSampleDistance;
     this->OldSampleDistance      = this->SampleDistance;
 
+    // Statistics are accumulated over all the sub volumes of the image
+    this->NumberOfRays                = 0;
+    this->NumberOfEarlyTerminatedRays = 0;
+    this->NumberOfSkippedSamples      = 0;
+
     // If we are automatically adjusting the size to achieve a desired frame
     // rate, then do that adjustment here. Base the new image sample distance
     // on the previous one and the previous render time. Don't let
@@ -1216,6 +1288,7 @@ void vtkSlicerFixedPointVolumeRayCastMapper::PerVolumeInitialization( vtkRendere
 
     this->RenderWindow = ren->GetRenderWindow();
     this->Volume = vol;
+    this->FlipMIPComparison = ( this->BlendMode == vtkVolumeMapper::MINIMUM_INTENSITY_BLEND );
 
     this->UpdateColorTable( vol );
     this->UpdateGradients( vol );
@@ -1264,7 +1337,29 @@ void vtkSlicerFixedPointVolumeRayCastMapper::RenderSubVolume()
     // then set the execution method and do it.
     this->Threader->SetSingleMethod( SlicerFixedPointVolumeRayCastMapper_CastRays,
         (void *)this);
+
+    // Each thread accumulates its statistics in its own slots
+    int numberOfThreads = this->Threader->GetNumberOfThreads();
+    this->ThreadRayCastStatistics.assign( 3 * numberOfThreads, 0 );
+
     this->Threader->SingleMethodExecute();
+
+    for ( int i = 0; i < numberOfThreads; i++ )
+    {
+        this->NumberOfRays                += this->ThreadRayCastStatistics[3*i];
+        this->NumberOfEarlyTerminatedRays += this->ThreadRayCastStatistics[3*i+1];
+        this->NumberOfSkippedSamples      += this->ThreadRayCastStatistics[3*i+2];
+    }
+}
+
+void vtkSlicerFixedPointVolumeRayCastMapper::AddRayCastStatistics( int threadID,
+                                                                  vtkIdType numberOfRays,
+                                                                  vtkIdType numberOfEarlyTerminatedRays,
+                                                                  vtkIdType numberOfSkippedSamples )
+{
+    this->ThreadRayCastStatistics[3*threadID]   += numberOfRays;
+    this->ThreadRayCastStatistics[3*threadID+1] += numberOfEarlyTerminatedRays;
+    this->ThreadRayCastStatistics[3*threadID+2] += numberOfSkippedSamples;
 }
 
 // This method displays the image that has been created
@@ -1283,8 +1378,17 @@ void vtkSlicerFixedPointVolumeRayCastMapper::DisplayRenderedImage( vtkRenderer *
 
     this->ImageDisplayHelper->
         RenderTexture( vol, ren,
-        this->RayCastImage,
-        depth );
+        this->RayCastImage->GetImageMemorySize(),
+        this->RayCastImage->GetImageViewportSize(),
+        this->RayCastImage->GetImageInUseSize(),
+        this->RayCastImage->GetImageOrigin(),
+        depth,
+        this->RayCastImage->GetImage() );
+}
+
+void vtkSlicerFixedPointVolumeRayCastMapper::ReleaseGraphicsResources( vtkWindow *window )
+{
+    this->ImageDisplayHelper->ReleaseGraphicsResources( window );
 }
 
 // This method should be called when the render is aborted to restore previous values.
@@ -1434,7 +1538,8 @@ VTK_THREAD_RETURN_TYPE SlicerFixedPointVolumeRayCastMapper_CastRays( void *arg )
     }
 
     vtkVolume *vol = me->GetVolume();
-    if ( me->GetBlendMode() == vtkVolumeMapper::MAXIMUM_INTENSITY_BLEND )
+    if ( me->GetBlendMode() == vtkVolumeMapper::MAXIMUM_INTENSITY_BLEND ||
+         me->GetBlendMode() == vtkVolumeMapper::MINIMUM_INTENSITY_BLEND )
       {
       if  (me->GetMIPHelper() == NULL)
         {
@@ -3108,10 +3213,18 @@ void vtkSlicerFixedPointVolumeRayCastMapper::PrintSelf(ostream& os, vtkIndent in
         << this->AutoAdjustSampleDistances << endl;
     os << indent << "Intermix Intersecting Geometry: "
         << (this->IntermixIntersectingGeometry ? "On\n" : "Off\n");
+    os << indent << "Skip Transparent Blocks: "
+        << (this->SkipTransparentBlocks ? "On\n" : "Off\n");
+    os << indent << "Number Of Rays: " << this->NumberOfRays << endl;
+    os << indent << "Number Of Early Terminated Rays: "
+        << this->NumberOfEarlyTerminatedRays << endl;
+    os << indent << "Number Of Skipped Samples: "
+        << this->NumberOfSkippedSamples << endl;
 
     os << indent << "ShadingRequired: " << this->ShadingRequired << endl;
     os << indent << "GradientOpacityRequired: " << this->GradientOpacityRequired
         << endl;
+    os << indent << "FlipMIPComparison: " << this->FlipMIPComparison << endl;
 
     if ( this->RayCastImage )
     {
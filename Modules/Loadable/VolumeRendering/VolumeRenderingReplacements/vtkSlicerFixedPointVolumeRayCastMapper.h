@@ -45,7 +45,8 @@
 // third unsigned short which is both the maximum gradient opacity in
 // the neighborhood (an unsigned char) and the flag that is filled
 // in for the current lookup tables to indicate whether this region
-// can be skipped.
+// can be skipped. Groups of 4x4x4 min max cells are also flagged as a
+// whole so that rays can leap over large fully transparent regions.
 
 // .SECTION see also
 // vtkVolumeMapper
@@ -56,9 +57,11 @@
 #include "vtkVolumeMapper.h"
 #include "VolumeRenderingReplacementsExport.h"
 
+#include <vector>
 
 #define VTKKW_FP_SHIFT       15
 #define VTKKW_FPMM_SHIFT     17
+#define VTKKW_FPMMB_SHIFT    19
 #define VTKKW_FP_MASK        0x7fff
 #define VTKKW_FP_SCALE       32767.0
 
@@ -80,8 +83,9 @@ class vtkSlicerFixedPointVolumeRayCastCompositeShadeHelper;
 class vtkDirectionEncoder;
 class vtkEncodedGradientShader;
 class vtkFiniteDifferenceGradientEstimator;
-#include "vtkSlicerRayCastImageDisplayHelper.h"
+class vtkRayCastImageDisplayHelper;
 class vtkSlicerFixedPointRayCastImage;
+class vtkWindow;
 
 // Forward declaration needed for use by friend declaration below.
 VTK_THREAD_RETURN_TYPE SlicerFixedPointVolumeRayCastMapper_CastRays( void *arg );
@@ -165,6 +169,24 @@ public:
   vtkGetMacro( IntermixIntersectingGeometry, int );
   vtkBooleanMacro( IntermixIntersectingGeometry, int );
 
+  // Description:
+  // If SkipTransparentBlocks is on (default), rays leap over whole min max
+  // cells (and groups of 4x4x4 cells) that are fully transparent with the
+  // current scalar opacity transfer function instead of stepping through
+  // them one sample at a time. The rendered image is the same either way.
+  vtkSetClampMacro( SkipTransparentBlocks, int, 0, 1 );
+  vtkGetMacro( SkipTransparentBlocks, int );
+  vtkBooleanMacro( SkipTransparentBlocks, int );
+
+  // Description:
+  // Statistics of the last rendered image: the number of rays cast, the
+  // number of rays that stopped early because they reached full opacity,
+  // and the number of samples skipped because they were in fully
+  // transparent regions of the volume.
+  vtkGetMacro( NumberOfRays, vtkIdType );
+  vtkGetMacro( NumberOfEarlyTerminatedRays, vtkIdType );
+  vtkGetMacro( NumberOfSkippedSamples, vtkIdType );
+
   // Description:
   // What is the image sample distance required to achieve the desired time?
   // A version of this method is provided that does not require the volume
@@ -182,16 +204,24 @@ public:
   // Initialize rendering for this volume.
   void Render( vtkRenderer *, vtkVolume * );
 
+  // Description:
+  // WARNING: INTERNAL METHOD - NOT INTENDED FOR GENERAL USE
+  // Release any graphics resources that are being consumed by this mapper.
+  void ReleaseGraphicsResources( vtkWindow * );
+
   unsigned int ToSlicerFixedPointPosition( float val );
   void ToSlicerFixedPointPosition( float in[3], unsigned int out[3] );
   unsigned int ToSlicerFixedPointDirection( float dir );
   void ToSlicerFixedPointDirection( float in[3], unsigned int out[3] );
   void FixedPointIncrement( unsigned int position[3], unsigned int increment[3] );
+  void FixedPointIncrement( unsigned int position[3], unsigned int increment[3],
+                            unsigned int count );
   void GetFloatTripleFromPointer( float v[3], float *ptr );
   void GetUIntTripleFromPointer( unsigned int v[3], unsigned int *ptr );
   void ShiftVectorDown( unsigned int in[3], unsigned int out[3] );
   int CheckMinMaxVolumeFlag( unsigned int pos[3], int c );
-  int CheckMIPMinMaxVolumeFlag( unsigned int pos[3], int c, unsigned short maxIdx );
+  int CheckMIPMinMaxVolumeFlag( unsigned int pos[3], int c, unsigned short maxIdx, int flip );
+  unsigned int ComputeSpaceLeapSteps( unsigned int pos[3], unsigned int dir[3] );
 
   void LookupColorUC( unsigned short *colorTable,
                       unsigned short *scalarOpacityTable,
@@ -223,6 +253,12 @@ public:
   vtkGetMacro( ShadingRequired, int );
   vtkGetMacro( GradientOpacityRequired, int );
 
+  // Description:
+  // WARNING: INTERNAL METHOD - NOT INTENDED FOR GENERAL USE
+  // The MIP helper looks for the minimum instead of the maximum value
+  // along the rays when the blend mode is MINIMUM_INTENSITY_BLEND.
+  vtkGetMacro( FlipMIPComparison, int );
+
   int             *GetRowBounds()                 {return this->RowBounds;}
   unsigned short  *GetColorTable(int c)           {return this->ColorTable[c];}
   unsigned short  *GetScalarOpacityTable(int c)   {return this->ScalarOpacityTable[c];}
@@ -257,6 +293,13 @@ public:
   void DisplayRenderedImage( vtkRenderer *, vtkVolume * );
   void AbortRender();
 
+  // Description:
+  // WARNING: INTERNAL METHOD - NOT INTENDED FOR GENERAL USE
+  // Accumulate the ray casting statistics of a thread.
+  void AddRayCastStatistics( int threadID, vtkIdType numberOfRays,
+                             vtkIdType numberOfEarlyTerminatedRays,
+                             vtkIdType numberOfSkippedSamples );
+
 
 protected:
 
@@ -269,8 +312,9 @@ protected:
   vtkSlicerFixedPointVolumeRayCastMapper();
   ~vtkSlicerFixedPointVolumeRayCastMapper();
 
-  // The helper class that displays the image
-  vtkSlicerRayCastImageDisplayHelper *ImageDisplayHelper;
+  // The helper class that displays the image. The VTK helper is used so
+  // that the image is displayed with the rendering backend of VTK.
+  vtkRayCastImageDisplayHelper *ImageDisplayHelper;
 
   // The distance between sample points along the ray
   float                        SampleDistance;
@@ -382,6 +426,8 @@ protected:
   int                        ShadingRequired;
   int                        GradientOpacityRequired;
 
+  int                        FlipMIPComparison;
+
   vtkRenderWindow           *RenderWindow;
   vtkVolume                 *Volume;
 
@@ -438,7 +484,21 @@ protected:
   vtkTimeStamp    SavedMinMaxGradientTime;
   vtkTimeStamp    SavedMinMaxFlagTime;
 
+  // One flag per group of 4x4x4 min max cells, set if any of the cells
+  // (for any component) is not transparent
+  unsigned char  *MinMaxBlockVolume;
+  int             MinMaxBlockVolumeSize[3];
+
+  int             SkipTransparentBlocks;
+
+  // Ray casting statistics, per thread while rendering and summed after
+  std::vector<vtkIdType> ThreadRayCastStatistics;
+  vtkIdType       NumberOfRays;
+  vtkIdType       NumberOfEarlyTerminatedRays;
+  vtkIdType       NumberOfSkippedSamples;
+
   void            UpdateMinMaxVolume( vtkVolume *vol );
+  void            UpdateMinMaxBlockVolume();
   void            FillInMaxGradientMagnitudes( int fullDim[3],
                                                int smallDim[3] );
 
@@ -511,6 +571,21 @@ inline void vtkSlicerFixedPointVolumeRayCastMapper::FixedPointIncrement( unsigne
     }
 }
 
+inline void vtkSlicerFixedPointVolumeRayCastMapper::FixedPointIncrement( unsigned int position[3], unsigned int increment[3],
+                                                                      unsigned int count )
+{
+  for ( int i = 0; i < 3; i++ )
+    {
+    if ( increment[i]&0x80000000 )
+      {
+      position[i] += count*(increment[i]&0x7fffffff);
+      }
+    else
+      {
+      position[i] -= count*increment[i];
+      }
+    }
+}
 
 inline void vtkSlicerFixedPointVolumeRayCastMapper::GetFloatTripleFromPointer( float v[3], float *ptr )
 {
@@ -546,7 +621,8 @@ inline int vtkSlicerFixedPointVolumeRayCastMapper::CheckMinMaxVolumeFlag( unsign
 }
 
 inline int vtkSlicerFixedPointVolumeRayCastMapper::CheckMIPMinMaxVolumeFlag( unsigned int mmpos[3], int c,
-                                                                       unsigned short maxIdx )
+                                                                       unsigned short maxIdx,
+                                                                       int flip )
 {
   unsigned int offset =
     this->MinMaxVolumeSize[3] *
@@ -556,7 +632,14 @@ inline int vtkSlicerFixedPointVolumeRayCastMapper::CheckMIPMinMaxVolumeFlag( uns
 
   if ( (*(this->MinMaxVolume + 3*offset + 2)&0x00ff) )
     {
-    return ( *(this->MinMaxVolume + 3*offset + 1) > maxIdx );
+    if ( flip )
+      {
+      return ( *(this->MinMaxVolume + 3*offset) < maxIdx );
+      }
+    else
+      {
+      return ( *(this->MinMaxVolume + 3*offset + 1) > maxIdx );
+      }
     }
   else
     {
@@ -564,6 +647,42 @@ inline int vtkSlicerFixedPointVolumeRayCastMapper::CheckMIPMinMaxVolumeFlag( uns
     }
 }
 
+// Number of samples, starting from pos, that are in the same fully
+// transparent min max cell - or in the same group of 4x4x4 cells if
+// they are all transparent. The result is at least 1.
+inline unsigned int vtkSlicerFixedPointVolumeRayCastMapper::ComputeSpaceLeapSteps( unsigned int pos[3],
+                                                                                unsigned int dir[3] )
+{
+  unsigned int offset =
+    (pos[2]>>VTKKW_FPMMB_SHIFT)*this->MinMaxBlockVolumeSize[0]*this->MinMaxBlockVolumeSize[1] +
+    (pos[1]>>VTKKW_FPMMB_SHIFT)*this->MinMaxBlockVolumeSize[0] +
+    (pos[0]>>VTKKW_FPMMB_SHIFT);
+  int shift = this->MinMaxBlockVolume[offset] ? VTKKW_FPMM_SHIFT : VTKKW_FPMMB_SHIFT;
+
+  unsigned int steps = 0xffffffff;
+  for ( int i = 0; i < 3; i++ )
+    {
+    unsigned int inc = (dir[i]&0x7fffffff);
+    if ( !inc )
+      {
+      continue;
+      }
+    unsigned int axisSteps;
+    if ( dir[i]&0x80000000 )
+      {
+      unsigned int next = ((pos[i]>>shift)+1)<<shift;
+      axisSteps = (next - pos[i] + inc - 1) / inc;
+      }
+    else
+      {
+      unsigned int start = (pos[i]>>shift)<<shift;
+      axisSteps = (pos[i] - start) / inc + 1;
+      }
+    steps = (axisSteps < steps)?(axisSteps):(steps);
+    }
+  return steps;
+}
+
 inline void vtkSlicerFixedPointVolumeRayCastMapper::LookupColorUC( unsigned short *colorTable,
                                                      unsigned short *scalarOpacityTable,
                                                      unsigned short index,
@@ -63,6 +63,8 @@ void qSlicerCPURayCastVolumeRenderingPropertiesWidgetPrivate
   this->populateRenderingTechniqueComboBox();
   QObject::connect(this->RenderingTechniqueComboBox, SIGNAL(currentIndexChanged(int)),
                    widget, SLOT(setRenderingTechnique(int)));
+  QObject::connect(this->SkipTransparentBlocksCheckBox, SIGNAL(toggled(bool)),
+                   widget, SLOT(setSkipTransparentBlocks(bool)));
 }
 
 // --------------------------------------------------------------------------
@@ -123,6 +125,8 @@ void qSlicerCPURayCastVolumeRenderingPropertiesWidget
     index = 0;
     }
   d->RenderingTechniqueComboBox->setCurrentIndex(index);
+  d->SkipTransparentBlocksCheckBox->setChecked(
+    this->mrmlCPURayCastDisplayNode()->GetSkipTransparentBlocks() != 0);
 }
 
 //-----------------------------------------------------------------------------
@@ -137,3 +141,14 @@ void qSlicerCPURayCastVolumeRenderingPropertiesWidget
   int technique = d->RenderingTechniqueComboBox->itemData(index).toInt();
   this->mrmlCPURayCastDisplayNode()->SetRaycastTechnique(technique);
 }
+
+//-----------------------------------------------------------------------------
+void qSlicerCPURayCastVolumeRenderingPropertiesWidget
+::setSkipTransparentBlocks(bool skip)
+{
+  if (!this->mrmlCPURayCastDisplayNode())
+    {
+    return;
+    }
+  this->mrmlCPURayCastDisplayNode()->SetSkipTransparentBlocks(skip ? 1 : 0);
+}
@@ -40,6 +40,7 @@ public:
 
 public slots:
   void setRenderingTechnique(int index);
+  void setSkipTransparentBlocks(bool skip);
 
 protected slots:
   virtual void updateWidgetFromMRML();
@@ -21,6 +21,7 @@
 // Qt includes
 #include <QDebug>
 #include <QSettings>
+#include <QStandardItemModel>
 
 // CTK includes
 #include <ctkUtils.h>
@@ -467,13 +468,31 @@ void qSlicerVolumeRenderingModuleWidget::updateFromMRMLDisplayNode()
   d->MemorySizeComboBox->setCurrentIndex(index);
   d->QualityControlComboBox->setCurrentIndex(
     d->DisplayNode ? d->DisplayNode->GetPerformanceControl() : -1);
+  // Progressive quality is only implemented by CPU ray casting, the other
+  // rendering methods use adaptive quality instead.
+  bool progressiveSupported =
+    (currentVolumeMapper == "vtkMRMLCPURayCastVolumeRenderingDisplayNode");
+  QStandardItemModel* qualityControlModel =
+    qobject_cast<QStandardItemModel*>(d->QualityControlComboBox->model());
+  QStandardItem* progressiveItem = qualityControlModel ?
+    qualityControlModel->item(vtkMRMLVolumeRenderingDisplayNode::Progressive) : 0;
+  if (progressiveItem)
+    {
+    progressiveItem->setFlags(progressiveSupported ?
+      progressiveItem->flags() | Qt::ItemIsEnabled :
+      progressiveItem->flags() & ~Qt::ItemIsEnabled);
+    progressiveItem->setToolTip(progressiveSupported ? QString() :
+      tr("Progressive quality is only available with CPU ray casting"));
+    }
   if (d->DisplayNode)
     {
     d->FramerateSliderWidget->setValue(d->DisplayNode->GetExpectedFPS());
     }
   d->FramerateSliderWidget->setEnabled(
-    d->DisplayNode && d->DisplayNode->GetPerformanceControl() ==
-    vtkMRMLVolumeRenderingDisplayNode::Adaptative);
+    d->DisplayNode && (d->DisplayNode->GetPerformanceControl() ==
+    vtkMRMLVolumeRenderingDisplayNode::Adaptative ||
+    (d->DisplayNode->GetPerformanceControl() ==
+    vtkMRMLVolumeRenderingDisplayNode::Progressive && !progressiveSupported)));
   // Opacity/color
   bool follow = d->DisplayNode ? d->DisplayNode->GetFollowVolumeDisplayNode() != 0 : false;
   if (follow)
@@ -653,6 +672,13 @@ void qSlicerVolumeRenderingModuleWidget::onCurrentRenderingMethodChanged(int ind
   displayNode->Delete();
   vtkWeakPointer<vtkMRMLVolumeRenderingDisplayNode> oldDisplayNode = d->DisplayNode;
   displayNode->vtkMRMLVolumeRenderingDisplayNode::Copy(d->DisplayNode);
+  if (displayNode->GetPerformanceControl() == vtkMRMLVolumeRenderingDisplayNode::Progressive &&
+      !displayNode->IsA("vtkMRMLCPURayCastVolumeRenderingDisplayNode"))
+    {
+    qWarning() << Q_FUNC_INFO << ": Progressive quality is only available with"
+               << "CPU ray casting, switching to adaptive quality";
+    displayNode->SetPerformanceControl(vtkMRMLVolumeRenderingDisplayNode::Adaptative);
+    }
   d->DisplayNodeComboBox->setCurrentNode(displayNode);
   if (oldDisplayNode.GetPointer())
     {
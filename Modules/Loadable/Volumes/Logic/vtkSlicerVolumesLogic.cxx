@@ -677,7 +677,9 @@ vtkMRMLVolumeNode* vtkSlicerVolumesLogic::AddArchetypeVolume (
   this->GetApplicationLogic()->SetMRMLSceneDataIO(testScene.GetPointer(),
                                                   remoteIOLogic, dataIOManagerLogic);
 
-  // Run through the factory list and test each factory until success
+  // Run through the factory list and test each factory until success.
+  // Factories are first tested on the file header, the data is only read
+  // by the first factory that accepts the header.
   for (NodeSetFactoryRegistry::const_iterator fit = volumeRegistry.begin();
        fit != volumeRegistry.end(); ++fit)
     {
@@ -694,10 +696,19 @@ vtkMRMLVolumeNode* vtkSlicerVolumesLogic::AddArchetypeVolume (
 
       this->InitializeStorageNode(nodeSet.StorageNode, filename, fileList, testScene.GetPointer());
 
-      vtkDebugMacro("Attempt to read file as a volume of type "
-                    << nodeSet.Node->GetNodeTagName() << " using "
-                    << nodeSet.Node->GetClassName() << " [filename = " << filename << "]");
-      bool success = nodeSet.StorageNode->ReadData(nodeSet.Node);
+      bool success = false;
+      if (nodeSet.StorageNode->CanReadHeader(nodeSet.Node))
+        {
+        vtkDebugMacro("Attempt to read file as a volume of type "
+                      << nodeSet.Node->GetNodeTagName() << " using "
+                      << nodeSet.Node->GetClassName() << " [filename = " << filename << "]");
+        success = nodeSet.StorageNode->ReadData(nodeSet.Node);
+        }
+      else
+        {
+        vtkDebugMacro("File header does not match a volume of type "
+                      << nodeSet.Node->GetNodeTagName() << " [filename = " << filename << "]");
+        }
 
       // disconnect the observers
       nodeSet.StorageNode->RemoveObservers(vtkCommand::ErrorEvent, errorSink.GetPointer());
@@ -729,6 +740,10 @@ vtkMRMLVolumeNode* vtkSlicerVolumesLogic::AddArchetypeVolume (
   // display any errors
   if (volumeNode == 0)
     {
+    if (!errorSink->HasErrors())
+      {
+      vtkErrorMacro("AddArchetypeVolume: No volume type matches the header of file " << filename);
+      }
     errorSink->DisplayErrors();
     }
 
@@ -102,6 +102,9 @@ public:
   /// and cross-referenced appropriately. Node types must be
   /// registered with the scene beforehand the factory is
   /// called. Factories are tested in the order they are registered.
+  /// A factory is tested by calling vtkMRMLStorageNode::CanReadHeader() on
+  /// its storage node, the data is only read by the first factory whose
+  /// storage node accepts the file header.
   void RegisterArchetypeVolumeNodeSetFactory(ArchetypeVolumeNodeSetFactory factory);
 
   /// Register a factory method that can create and configure a node
@@ -0,0 +1,219 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Volumes logic
+#include "vtkSlicerVolumesLogic.h"
+#include "vtkMRMLCoreTestingMacros.h"
+
+// MRML includes
+#include <vtkMRMLDiffusionTensorVolumeDisplayNode.h>
+#include <vtkMRMLDiffusionTensorVolumeNode.h>
+#include <vtkMRMLDiffusionWeightedVolumeDisplayNode.h>
+#include <vtkMRMLDiffusionWeightedVolumeNode.h>
+#include <vtkMRMLLabelMapVolumeDisplayNode.h>
+#include <vtkMRMLLabelMapVolumeNode.h>
+#include <vtkMRMLNRRDStorageNode.h>
+#include <vtkMRMLScalarVolumeDisplayNode.h>
+#include <vtkMRMLScalarVolumeNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLVectorVolumeDisplayNode.h>
+#include <vtkMRMLVectorVolumeNode.h>
+#include <vtkMRMLVolumeArchetypeStorageNode.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkTimerLog.h>
+
+// ITK includes
+#include <itkConfigure.h>
+#include <itkFactoryRegistration.h>
+
+// STD includes
+#include <cstring>
+#include <string>
+
+namespace
+{
+
+// Number of times the volume data (not only the header) has been read
+int NumberOfDataReads = 0;
+
+//-----------------------------------------------------------------------------
+class vtkMRMLCountingNRRDStorageNode : public vtkMRMLNRRDStorageNode
+{
+public:
+  static vtkMRMLCountingNRRDStorageNode *New();
+  vtkTypeMacro(vtkMRMLCountingNRRDStorageNode, vtkMRMLNRRDStorageNode);
+protected:
+  vtkMRMLCountingNRRDStorageNode(){}
+  virtual int ReadDataInternal(vtkMRMLNode *refNode)
+    {
+    ++NumberOfDataReads;
+    return this->Superclass::ReadDataInternal(refNode);
+    }
+};
+vtkStandardNewMacro(vtkMRMLCountingNRRDStorageNode);
+
+//-----------------------------------------------------------------------------
+class vtkMRMLCountingVolumeArchetypeStorageNode : public vtkMRMLVolumeArchetypeStorageNode
+{
+public:
+  static vtkMRMLCountingVolumeArchetypeStorageNode *New();
+  vtkTypeMacro(vtkMRMLCountingVolumeArchetypeStorageNode, vtkMRMLVolumeArchetypeStorageNode);
+protected:
+  vtkMRMLCountingVolumeArchetypeStorageNode(){}
+  virtual int ReadDataInternal(vtkMRMLNode *refNode)
+    {
+    ++NumberOfDataReads;
+    return this->Superclass::ReadDataInternal(refNode);
+    }
+};
+vtkStandardNewMacro(vtkMRMLCountingVolumeArchetypeStorageNode);
+
+//-----------------------------------------------------------------------------
+template <class VolumeNodeType, class DisplayNodeType, class StorageNodeType>
+ArchetypeVolumeNodeSet CreateNodeSet(std::string& volumeName, vtkMRMLScene* scene,
+                                     int options, bool labelMap)
+{
+  ArchetypeVolumeNodeSet nodeSet(scene);
+
+  vtkNew<DisplayNodeType> displayNode;
+  scene->AddNode(displayNode.GetPointer());
+
+  vtkNew<VolumeNodeType> volumeNode;
+  volumeNode->SetName(volumeName.c_str());
+  scene->AddNode(volumeNode.GetPointer());
+  volumeNode->SetAndObserveDisplayNodeID(displayNode->GetID());
+
+  vtkNew<StorageNodeType> storageNode;
+  storageNode->SetCenterImage(options & vtkSlicerVolumesLogic::CenterImage);
+  scene->AddNode(storageNode.GetPointer());
+  volumeNode->SetAndObserveStorageNodeID(storageNode->GetID());
+
+  nodeSet.StorageNode = storageNode.GetPointer();
+  nodeSet.DisplayNode = displayNode.GetPointer();
+  nodeSet.Node = volumeNode.GetPointer();
+  nodeSet.LabelMap = labelMap;
+  return nodeSet;
+}
+
+//-----------------------------------------------------------------------------
+// Same node sets as the default factories of vtkSlicerVolumesLogic
+ArchetypeVolumeNodeSet DiffusionWeightedFactory(std::string& volumeName, vtkMRMLScene* scene, int options)
+{
+  return CreateNodeSet<vtkMRMLDiffusionWeightedVolumeNode, vtkMRMLDiffusionWeightedVolumeDisplayNode,
+                       vtkMRMLCountingNRRDStorageNode>(volumeName, scene, options, false);
+}
+ArchetypeVolumeNodeSet DiffusionTensorFactory(std::string& volumeName, vtkMRMLScene* scene, int options)
+{
+  return CreateNodeSet<vtkMRMLDiffusionTensorVolumeNode, vtkMRMLDiffusionTensorVolumeDisplayNode,
+                       vtkMRMLCountingVolumeArchetypeStorageNode>(volumeName, scene, options, false);
+}
+ArchetypeVolumeNodeSet NRRDVectorFactory(std::string& volumeName, vtkMRMLScene* scene, int options)
+{
+  return CreateNodeSet<vtkMRMLVectorVolumeNode, vtkMRMLVectorVolumeDisplayNode,
+                       vtkMRMLCountingNRRDStorageNode>(volumeName, scene, options, false);
+}
+ArchetypeVolumeNodeSet ArchetypeVectorFactory(std::string& volumeName, vtkMRMLScene* scene, int options)
+{
+  return CreateNodeSet<vtkMRMLVectorVolumeNode, vtkMRMLVectorVolumeDisplayNode,
+                       vtkMRMLCountingVolumeArchetypeStorageNode>(volumeName, scene, options, false);
+}
+ArchetypeVolumeNodeSet LabelMapFactory(std::string& volumeName, vtkMRMLScene* scene, int options)
+{
+  return CreateNodeSet<vtkMRMLLabelMapVolumeNode, vtkMRMLLabelMapVolumeDisplayNode,
+                       vtkMRMLCountingVolumeArchetypeStorageNode>(volumeName, scene, options, true);
+}
+ArchetypeVolumeNodeSet ScalarFactory(std::string& volumeName, vtkMRMLScene* scene, int options)
+{
+  return CreateNodeSet<vtkMRMLScalarVolumeNode, vtkMRMLScalarVolumeDisplayNode,
+                       vtkMRMLCountingVolumeArchetypeStorageNode>(volumeName, scene, options, false);
+}
+
+//-----------------------------------------------------------------------------
+int TestLoading(vtkSlicerVolumesLogic* logic, const std::string& fileName,
+                int options, const char* expectedClassName, bool benchmark)
+{
+  NumberOfDataReads = 0;
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  vtkMRMLVolumeNode* volume = logic->AddArchetypeVolume(fileName.c_str(), "volume", options);
+  timer->StopTimer();
+  if (benchmark)
+    {
+    REPORT_MEASUREMENT("AddArchetypeVolume-" << expectedClassName, timer->GetElapsedTime());
+    }
+
+  if (!volume || !volume->GetImageData())
+    {
+    std::cerr << "Failed to load " << fileName << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (strcmp(volume->GetClassName(), expectedClassName) != 0)
+    {
+    std::cerr << fileName << " is loaded as a " << volume->GetClassName()
+              << " instead of a " << expectedClassName << std::endl;
+    return EXIT_FAILURE;
+    }
+  // Only the headers are read by the factories that are not used
+  if (NumberOfDataReads != 1)
+    {
+    std::cerr << fileName << " data is read " << NumberOfDataReads << " times" << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
+
+//-----------------------------------------------------------------------------
+// Usage: vtkSlicerVolumesLogicTest3 /path/to/MRMLCore/Testing/TestData [--benchmark]
+int vtkSlicerVolumesLogicTest3( int argc, char * argv[] )
+{
+  itk::itkFactoryRegistration();
+
+  if (argc < 2)
+    {
+    std::cerr << "Usage: vtkSlicerVolumesLogicTest3 /path/to/MRMLCore/Testing/TestData [--benchmark]" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::string dataDir = argv[1];
+  bool benchmark = vtkAddonTestingUtilities::IsBenchmarkRequested(argc, argv, 2);
+
+  vtkNew<vtkMRMLScene> scene;
+  vtkNew<vtkSlicerVolumesLogic> logic;
+  logic->SetMRMLScene(scene.GetPointer());
+
+  // Pre-registered factories are tested before the default ones
+  logic->PreRegisterArchetypeVolumeNodeSetFactory(ScalarFactory);
+  logic->PreRegisterArchetypeVolumeNodeSetFactory(LabelMapFactory);
+  logic->PreRegisterArchetypeVolumeNodeSetFactory(ArchetypeVectorFactory);
+  logic->PreRegisterArchetypeVolumeNodeSetFactory(NRRDVectorFactory);
+  logic->PreRegisterArchetypeVolumeNodeSetFactory(DiffusionTensorFactory);
+  logic->PreRegisterArchetypeVolumeNodeSetFactory(DiffusionWeightedFactory);
+
+  CHECK_EXIT_SUCCESS(TestLoading(logic.GetPointer(), dataDir + "/fixed.nrrd",
+                                 0, "vtkMRMLScalarVolumeNode", benchmark));
+  CHECK_EXIT_SUCCESS(TestLoading(logic.GetPointer(), dataDir + "/fixed.nrrd",
+                                 vtkSlicerVolumesLogic::LabelMap, "vtkMRMLLabelMapVolumeNode", benchmark));
+  CHECK_EXIT_SUCCESS(TestLoading(logic.GetPointer(), dataDir + "/helix-DTI.nhdr",
+                                 0, "vtkMRMLDiffusionTensorVolumeNode", benchmark));
+  CHECK_EXIT_SUCCESS(TestLoading(logic.GetPointer(), dataDir + "/helix-DWI.nhdr",
+                                 0, "vtkMRMLDiffusionWeightedVolumeNode", benchmark));
+
+  return EXIT_SUCCESS;
+}
@@ -201,8 +201,9 @@ class SegmentStatisticsLogic(ScriptedLoadableModuleLogic):
       return
 
     for segmentID in self.statistics["SegmentIDs"]:
-      segment = self.segmentationNode.GetSegmentation().GetSegment(segmentID)
-      segmentLabelmap = segment.GetRepresentation(vtkSegmentationCore.vtkSegmentationConverter.GetSegmentationBinaryLabelmapRepresentationName())
+      # Labelmaps may be shared between segments, so only extract the voxels of this segment
+      segmentLabelmap = vtkSegmentationCore.vtkOrientedImageData()
+      self.segmentationNode.GetSegmentation().GetBinaryLabelmapRepresentation(segmentID, segmentLabelmap)
 
       # We need to know exactly the value of the segment voxels, apply threshold to make force the selected label value
       labelValue = 1
@@ -282,8 +283,9 @@ class SegmentStatisticsLogic(ScriptedLoadableModuleLogic):
     ccPerCubicMM = 0.001
 
     for segmentID in self.statistics["SegmentIDs"]:
-      segment = self.segmentationNode.GetSegmentation().GetSegment(segmentID)
-      segmentLabelmap = segment.GetRepresentation(vtkSegmentationCore.vtkSegmentationConverter.GetSegmentationBinaryLabelmapRepresentationName())
+      # Labelmaps may be shared between segments, so only extract the voxels of this segment
+      segmentLabelmap = vtkSegmentationCore.vtkOrientedImageData()
+      self.segmentationNode.GetSegmentation().GetBinaryLabelmapRepresentation(segmentID, segmentLabelmap)
 
       segmentLabelmap_Reference = vtkSegmentationCore.vtkOrientedImageData()
       vtkSegmentationCore.vtkOrientedImageDataResample.ResampleOrientedImageToReferenceOrientedImage(